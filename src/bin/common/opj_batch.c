@@ -0,0 +1,285 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+#if defined(MUTEX_pthread)
+#include <pthread.h>
+#endif
+
+#include "opj_batch.h"
+
+#if defined(MUTEX_win32)
+
+typedef HANDLE opj_batch_thread_t;
+typedef CRITICAL_SECTION opj_batch_mutex_t;
+typedef CONDITION_VARIABLE opj_batch_cond_t;
+
+#define opj_batch_mutex_init(m) (InitializeCriticalSection(m), 0)
+#define opj_batch_mutex_destroy(m) DeleteCriticalSection(m)
+#define opj_batch_mutex_lock(m) EnterCriticalSection(m)
+#define opj_batch_mutex_unlock(m) LeaveCriticalSection(m)
+#define opj_batch_cond_init(c) (InitializeConditionVariable(c), 0)
+#define opj_batch_cond_destroy(c) ((void)(c))
+#define opj_batch_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define opj_batch_cond_broadcast(c) WakeAllConditionVariable(c)
+
+#elif defined(MUTEX_pthread)
+
+typedef pthread_t opj_batch_thread_t;
+typedef pthread_mutex_t opj_batch_mutex_t;
+typedef pthread_cond_t opj_batch_cond_t;
+
+#define opj_batch_mutex_init(m) pthread_mutex_init(m, NULL)
+#define opj_batch_mutex_destroy(m) pthread_mutex_destroy(m)
+#define opj_batch_mutex_lock(m) pthread_mutex_lock(m)
+#define opj_batch_mutex_unlock(m) pthread_mutex_unlock(m)
+#define opj_batch_cond_init(c) pthread_cond_init(c, NULL)
+#define opj_batch_cond_destroy(c) pthread_cond_destroy(c)
+#define opj_batch_cond_wait(c, m) pthread_cond_wait(c, m)
+#define opj_batch_cond_broadcast(c) pthread_cond_broadcast(c)
+
+#endif
+
+int opj_batch_has_thread_support(void)
+{
+#if defined(MUTEX_win32) || defined(MUTEX_pthread)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+double opj_batch_wall_clock(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return freq.QuadPart ? (double)t.QuadPart / (double)freq.QuadPart : 0;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+#endif
+}
+
+static int opj_batch_run_serial(int num_items, opj_batch_load_fn load_fn,
+                                opj_batch_process_fn process_fn,
+                                void* user_data)
+{
+    int i, num_failed = 0;
+
+    for (i = 0; i < num_items; ++i) {
+        if (process_fn(i, load_fn(i, user_data), user_data) != 0) {
+            ++num_failed;
+        }
+    }
+    return num_failed;
+}
+
+#if defined(MUTEX_win32) || defined(MUTEX_pthread)
+
+typedef struct opj_batch {
+    int num_items;
+    opj_batch_load_fn load_fn;
+    opj_batch_process_fn process_fn;
+    void* user_data;
+    /** loaded items, not yet taken by a worker */
+    void** items;
+    /** number of items loaded */
+    int num_loaded;
+    /** number of items taken by the workers */
+    int num_taken;
+    /** number of items whose processing failed */
+    int num_failed;
+    /** protects the counters and the items */
+    opj_batch_mutex_t mutex;
+    /** signaled when an item is loaded or taken */
+    opj_batch_cond_t cond;
+} opj_batch_t;
+
+static void opj_batch_worker(opj_batch_t* batch)
+{
+    for (;;) {
+        int l_index;
+        void* l_item;
+
+        opj_batch_mutex_lock(&batch->mutex);
+        while (batch->num_taken == batch->num_loaded &&
+                batch->num_taken < batch->num_items) {
+            opj_batch_cond_wait(&batch->cond, &batch->mutex);
+        }
+        if (batch->num_taken == batch->num_items) {
+            opj_batch_mutex_unlock(&batch->mutex);
+            return;
+        }
+        l_index = batch->num_taken++;
+        l_item = batch->items[l_index];
+        batch->items[l_index] = NULL;
+        /* Let the loader load the next item */
+        opj_batch_cond_broadcast(&batch->cond);
+        opj_batch_mutex_unlock(&batch->mutex);
+
+        if (batch->process_fn(l_index, l_item, batch->user_data) != 0) {
+            opj_batch_mutex_lock(&batch->mutex);
+            ++batch->num_failed;
+            opj_batch_mutex_unlock(&batch->mutex);
+        }
+    }
+}
+
+#if defined(MUTEX_win32)
+static DWORD WINAPI opj_batch_worker_main(LPVOID user_data)
+{
+    opj_batch_worker((opj_batch_t*)user_data);
+    return 0;
+}
+#else
+static void* opj_batch_worker_main(void* user_data)
+{
+    opj_batch_worker((opj_batch_t*)user_data);
+    return NULL;
+}
+#endif
+
+int opj_batch_run(int num_items, int num_workers,
+                  opj_batch_load_fn load_fn, opj_batch_process_fn process_fn,
+                  void* user_data)
+{
+    opj_batch_t batch;
+    opj_batch_thread_t* l_threads;
+    int i, l_num_threads = 0;
+
+    if (num_workers <= 1 || num_items <= 1) {
+        return opj_batch_run_serial(num_items, load_fn, process_fn, user_data);
+    }
+
+    batch.num_items = num_items;
+    batch.load_fn = load_fn;
+    batch.process_fn = process_fn;
+    batch.user_data = user_data;
+    batch.num_loaded = 0;
+    batch.num_taken = 0;
+    batch.num_failed = 0;
+    batch.items = (void**)calloc((size_t)num_items, sizeof(void*));
+    l_threads = (opj_batch_thread_t*)calloc((size_t)num_workers,
+                sizeof(opj_batch_thread_t));
+    if (batch.items == NULL || l_threads == NULL) {
+        free(batch.items);
+        free(l_threads);
+        return -1;
+    }
+    if (opj_batch_mutex_init(&batch.mutex) != 0) {
+        free(batch.items);
+        free(l_threads);
+        return -1;
+    }
+    if (opj_batch_cond_init(&batch.cond) != 0) {
+        opj_batch_mutex_destroy(&batch.mutex);
+        free(batch.items);
+        free(l_threads);
+        return -1;
+    }
+
+    for (i = 0; i < num_workers; ++i) {
+#if defined(MUTEX_win32)
+        l_threads[i] = CreateThread(NULL, 0, opj_batch_worker_main, &batch, 0,
+                                    NULL);
+        if (l_threads[i] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&l_threads[i], NULL, opj_batch_worker_main,
+                           &batch) != 0) {
+            break;
+        }
+#endif
+        ++l_num_threads;
+    }
+
+    if (l_num_threads > 0) {
+        /* Load the items, at most num_workers ahead of the workers */
+        for (i = 0; i < num_items; ++i) {
+            void* l_item;
+
+            opj_batch_mutex_lock(&batch.mutex);
+            while (batch.num_loaded - batch.num_taken >= num_workers) {
+                opj_batch_cond_wait(&batch.cond, &batch.mutex);
+            }
+            opj_batch_mutex_unlock(&batch.mutex);
+
+            l_item = load_fn(i, user_data);
+
+            opj_batch_mutex_lock(&batch.mutex);
+            batch.items[i] = l_item;
+            ++batch.num_loaded;
+            opj_batch_cond_broadcast(&batch.cond);
+            opj_batch_mutex_unlock(&batch.mutex);
+        }
+    }
+
+    for (i = 0; i < l_num_threads; ++i) {
+#if defined(MUTEX_win32)
+        WaitForSingleObject(l_threads[i], INFINITE);
+        CloseHandle(l_threads[i]);
+#else
+        pthread_join(l_threads[i], NULL);
+#endif
+    }
+
+    opj_batch_cond_destroy(&batch.cond);
+    opj_batch_mutex_destroy(&batch.mutex);
+    free(batch.items);
+    free(l_threads);
+    return l_num_threads > 0 ? batch.num_failed : -1;
+}
+
+#else /* no thread support */
+
+int opj_batch_run(int num_items, int num_workers,
+                  opj_batch_load_fn load_fn, opj_batch_process_fn process_fn,
+                  void* user_data)
+{
+    (void)num_workers;
+    return opj_batch_run_serial(num_items, load_fn, process_fn, user_data);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OPJ_BATCH_H
+#define OPJ_BATCH_H
+
+/**
+ * Loads the item of index "index" of a batch, for example by reading a file.
+ * The items are loaded in order, by a single thread.
+ *
+ * @return the loaded item, given to the processing function. NULL is also
+ * given to it, for example if the loading failed.
+ */
+typedef void* (*opj_batch_load_fn)(int index, void* user_data);
+
+/**
+ * Processes an item returned by the loading function, and frees it. Several
+ * items are processed at the same time, by different threads.
+ *
+ * @return 0 if the processing succeeded.
+ */
+typedef int (*opj_batch_process_fn)(int index, void* item, void* user_data);
+
+/**
+ * Returns whether the items of a batch can be processed by several threads.
+ */
+int opj_batch_has_thread_support(void);
+
+/**
+ * Returns the elapsed real time in seconds, from an arbitrary origin. Unlike
+ * the processor time of the process, which sums the time of all threads, the
+ * difference of two calls is the time seen by the user, also when several
+ * items are processed at once.
+ */
+double opj_batch_wall_clock(void);
+
+/**
+ * Processes the items of a batch with num_workers worker threads, so that
+ * num_workers items are in flight at once. The calling thread loads the
+ * items in order, at most num_workers items ahead of their processing, so
+ * that loading the next items overlaps with processing the current ones.
+ *
+ * Without thread support, or if num_workers <= 1, the items are loaded and
+ * processed one after the other by the calling thread.
+ *
+ * @return the number of items whose processing failed, or -1 if the worker
+ * threads could not be created.
+ */
+int opj_batch_run(int num_items, int num_workers,
+                  opj_batch_load_fn load_fn, opj_batch_process_fn process_fn,
+                  void* user_data);
+
+#endif /* OPJ_BATCH_H */
@@ -0,0 +1,85 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "openjpeg.h"
+#include "opj_inttypes.h"
+#include "opj_perf_report.h"
+
+void opj_print_perf_counters(FILE* f, int encoding)
+{
+    /* In the order of the stages when decoding, or encoding */
+    static const OPJ_PERF_STAGE decoding_stages[] = {
+        OPJ_PERF_STAGE_T2, OPJ_PERF_STAGE_T1, OPJ_PERF_STAGE_DWT,
+        OPJ_PERF_STAGE_MCT, OPJ_PERF_STAGE_OUTPUT
+    };
+    static const OPJ_PERF_STAGE encoding_stages[] = {
+        OPJ_PERF_STAGE_OUTPUT, OPJ_PERF_STAGE_MCT, OPJ_PERF_STAGE_DWT,
+        OPJ_PERF_STAGE_T1, OPJ_PERF_STAGE_RATE, OPJ_PERF_STAGE_T2
+    };
+    static const char* const stage_names[OPJ_PERF_NB_STAGES] = {
+        "T2", "T1", "DWT", "MCT", "output", "rate"
+    };
+    opj_perf_counters_t counters[OPJ_PERF_NB_STAGES];
+    const OPJ_PERF_STAGE* stages;
+    int nb_stages, i;
+
+    if (!opj_get_perf_counters(counters)) {
+        return;
+    }
+    if (encoding) {
+        stages = encoding_stages;
+        nb_stages = (int)(sizeof(encoding_stages) / sizeof(encoding_stages[0]));
+    } else {
+        stages = decoding_stages;
+        nb_stages = (int)(sizeof(decoding_stages) / sizeof(decoding_stages[0]));
+    }
+    for (i = 0; i < nb_stages; i++) {
+        if (counters[stages[i]].cycles || counters[stages[i]].instructions) {
+            break;
+        }
+    }
+    if (i == nb_stages) {
+        return;
+    }
+
+    fprintf(f, "Hardware performance counters (user space, all threads):\n");
+    fprintf(f, "%-7s %15s %15s %5s %13s %13s\n", "stage", "cycles",
+            "instructions", "IPC", "LLC misses", "branch misses");
+    for (i = 0; i < nb_stages; i++) {
+        const opj_perf_counters_t* c = &counters[stages[i]];
+        fprintf(f, "%-7s %15" PRIu64 " %15" PRIu64 " %5.2f %13" PRIu64
+                " %13" PRIu64 "\n",
+                (encoding && stages[i] == OPJ_PERF_STAGE_OUTPUT) ? "input" :
+                stage_names[stages[i]],
+                c->cycles, c->instructions,
+                c->cycles ? (double)c->instructions / (double)c->cycles : 0.0,
+                c->llc_misses, c->branch_misses);
+    }
+}
@@ -70,6 +70,8 @@
 
 #include "format_defs.h"
 #include "opj_string.h"
+#include "opj_batch.h"
+#include "opj_perf_report.h"
 
 typedef struct dircnt {
     /** Buffer for holding images read from Directory*/
@@ -231,6 +233,11 @@ static void encode_help_display(void)
     fprintf(stdout, "    Write EPH marker after each header packet.\n");
     fprintf(stdout, "-PLT\n");
     fprintf(stdout, "    Write PLT marker in tile-part header.\n");
+    fprintf(stdout, "-LazyNoDistortion\n");
+    fprintf(stdout, "    Enables BYPASS(LAZY) mode on all code-blocks, and skips the\n");
+    fprintf(stdout, "    distortion estimation of coding passes when all layers are lossless.\n");
+    fprintf(stdout, "    Faster encoding, at the expense of larger lossless codestreams and\n");
+    fprintf(stdout, "    of a lower quality of lossy ones at a given rate.\n");
     fprintf(stdout, "-M <key value>\n");
     fprintf(stdout, "    Mode switch.\n");
     fprintf(stdout, "    [1=BYPASS(LAZY) 2=RESET 4=RESTART(TERMALL)\n");
@@ -305,6 +312,13 @@ static void encode_help_display(void)
         fprintf(stdout, "  -threads <num_threads|ALL_CPUS>\n"
                 "    Number of threads to use for encoding or ALL_CPUS for all available cores.\n");
     }
+    if (opj_batch_has_thread_support()) {
+        fprintf(stdout, "  -batch <number of images>\n"
+                "    With -ImgDir, number of images encoded at once. The next input\n"
+                "    images are read while the images are encoded, and the threads\n"
+                "    of -threads are shared among the images encoded at once.\n"
+                "    A summary of the throughput is printed at the end.\n");
+    }
     /* UniPG>> */
 #ifdef USE_JPWL
     fprintf(stdout, "-W <params>\n");
@@ -584,7 +598,9 @@ static int parse_cmdline_encoder(int argc, char **argv,
                                  size_t indexfilename_size,
                                  int* pOutFramerate,
                                  OPJ_BOOL* pOutPLT,
-                                 int* pOutNumThreads)
+                                 OPJ_BOOL* pOutLazyNoDistortion,
+                                 int* pOutNumThreads,
+                                 int* pOutBatchSize)
 {
     OPJ_UINT32 i, j;
     int totlen, c;
@@ -602,7 +618,9 @@ static int parse_cmdline_encoder(int argc, char **argv,
         {"mct", REQ_ARG, NULL, 'Y'},
         {"IMF", REQ_ARG, NULL, 'Z'},
         {"PLT", NO_ARG, NULL, 'A'},
-        {"threads",   REQ_ARG, NULL, 'B'}
+        {"threads",   REQ_ARG, NULL, 'B'},
+        {"LazyNoDistortion", NO_ARG, NULL, 'G'},
+        {"batch", REQ_ARG, NULL, 'K'}
     };
 
     /* parse the command line */
@@ -1685,6 +1703,13 @@ static int parse_cmdline_encoder(int argc, char **argv,
         }
         break;
 
+        /* ------------------------------------------------------ */
+
+        case 'G': {         /* LAZY mode without distortion estimation */
+            *pOutLazyNoDistortion = OPJ_TRUE;
+        }
+        break;
+
         /* ----------------------------------------------------- */
         case 'B': { /* Number of threads */
             if (strcmp(opj_optarg, "ALL_CPUS") == 0) {
@@ -1698,6 +1723,16 @@ static int parse_cmdline_encoder(int argc, char **argv,
         }
         break;
 
+        /* ----------------------------------------------------- */
+        case 'K': { /* Number of images encoded at once */
+            if (sscanf(opj_optarg, "%d", pOutBatchSize) != 1 ||
+                    *pOutBatchSize < 1) {
+                fprintf(stderr, "[ERROR] Invalid -batch value: %s\n", opj_optarg);
+                return 1;
+            }
+        }
+        break;
+
         /* ------------------------------------------------------ */
 
 
@@ -1724,6 +1759,10 @@ static int parse_cmdline_encoder(int argc, char **argv,
             return 1;
         }
     } else {
+        if (*pOutBatchSize != 0) {
+            fprintf(stderr, "[ERROR] option -batch can only be used with -ImgDir !!\n");
+            return 1;
+        }
         if ((parameters->infile[0] == 0) || (parameters->outfile[0] == 0)) {
             fprintf(stderr, "[ERROR] Required parameters are missing\n"
                     "Example: %s -i image.pgm -o image.j2k\n", argv[0]);
@@ -1820,34 +1859,503 @@ static void info_callback(const char *msg, void *client_data)
     fprintf(stdout, "[INFO] %s", msg);
 }
 
-OPJ_FLOAT64 opj_clock(void)
+/* -------------------------------------------------------------------------- */
+
+/** Results of load_image() and compress_image() */
+#define COMPRESS_OK      0
+#define COMPRESS_SKIPPED 1
+#define COMPRESS_FAILED  2
+
+/**
+ * Reads the input image of parameters->infile.
+ *
+ * @param parameters    compression parameters, with the input file
+ * @param raw_cp        parameters of RAW input files
+ * @param p_image       the image read
+ *
+ * @return COMPRESS_OK, COMPRESS_SKIPPED if the input format is not
+ * supported, or COMPRESS_FAILED
+ */
+static int load_image(opj_cparameters_t* parameters,
+                      raw_cparameters_t* raw_cp, opj_image_t** p_image)
 {
-#ifdef _WIN32
-    /* _WIN32: use QueryPerformance (very accurate) */
-    LARGE_INTEGER freq, t ;
-    /* freq is the clock speed of the CPU */
-    QueryPerformanceFrequency(&freq) ;
-    /* cout << "freq = " << ((double) freq.QuadPart) << endl; */
-    /* t is the high resolution performance counter (see MSDN) */
-    QueryPerformanceCounter(& t) ;
-    return freq.QuadPart ? ((OPJ_FLOAT64) t.QuadPart / (OPJ_FLOAT64) freq.QuadPart)
-           : 0 ;
-#else
-    /* Unix or Linux: use resource usage */
-    struct rusage t;
-    OPJ_FLOAT64 procTime;
-    /* (1) Get the rusage data structure at this moment (man getrusage) */
-    getrusage(0, &t);
-    /* (2) What is the elapsed time ? - CPU time = User time + System time */
-    /* (2a) Get the seconds */
-    procTime = (OPJ_FLOAT64)(t.ru_utime.tv_sec + t.ru_stime.tv_sec);
-    /* (2b) More precisely! Get the microseconds part ! */
-    return (procTime + (OPJ_FLOAT64)(t.ru_utime.tv_usec + t.ru_stime.tv_usec) *
-            1e-6) ;
-#endif
+    *p_image = NULL;
+
+    switch (parameters->decod_format) {
+    case PGX_DFMT:
+        break;
+    case PXM_DFMT:
+        break;
+    case BMP_DFMT:
+        break;
+    case TIF_DFMT:
+        break;
+    case RAW_DFMT:
+    case RAWL_DFMT:
+        break;
+    case TGA_DFMT:
+        break;
+    case PNG_DFMT:
+        break;
+    default:
+        fprintf(stderr, "skipping file...\n");
+        return COMPRESS_SKIPPED;
+    }
+
+    /* decode the source image */
+    /* ----------------------- */
+
+    switch (parameters->decod_format) {
+    case PGX_DFMT:
+        *p_image = pgxtoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load pgx file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+    case PXM_DFMT:
+        *p_image = pnmtoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load pnm file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+    case BMP_DFMT:
+        *p_image = bmptoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load bmp file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+#ifdef OPJ_HAVE_LIBTIFF
+    case TIF_DFMT:
+        *p_image = tiftoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load tiff file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+#endif /* OPJ_HAVE_LIBTIFF */
+
+    case RAW_DFMT:
+        *p_image = rawtoimage(parameters->infile, parameters, raw_cp);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load raw file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+    case RAWL_DFMT:
+        *p_image = rawltoimage(parameters->infile, parameters, raw_cp);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load raw file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+    case TGA_DFMT:
+        *p_image = tgatoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load tga file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+
+#ifdef OPJ_HAVE_LIBPNG
+    case PNG_DFMT:
+        *p_image = pngtoimage(parameters->infile, parameters);
+        if (!*p_image) {
+            fprintf(stderr, "Unable to load png file\n");
+            return COMPRESS_FAILED;
+        }
+        break;
+#endif /* OPJ_HAVE_LIBPNG */
+    }
+
+    /* Can happen if input file is TIFF or PNG
+    * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
+    */
+    if (!*p_image) {
+        fprintf(stderr, "Unable to load file: got no image\n");
+        return COMPRESS_FAILED;
+    }
+    return COMPRESS_OK;
 }
 
+/**
+ * Encodes an image, and writes it to parameters->outfile.
+ *
+ * @param parameters    compression parameters, with the output file. They
+ *                      are not modified, so that each image of a directory
+ *                      starts from the parameters of the command line.
+ * @param image         the image to encode
+ * @param framerate     frame rate for the IMF checks, or 0
+ * @param PLT           whether to write PLT markers
+ * @param LazyNoDistortion whether to use LAZY mode without distortion
+ *                      estimation
+ * @param num_threads   number of threads of the encoder
+ *
+ * @return COMPRESS_OK, COMPRESS_SKIPPED if the output format is not
+ * supported, or COMPRESS_FAILED
+ */
+static int compress_image(const opj_cparameters_t* parameters,
+                          opj_image_t* image, int framerate, OPJ_BOOL PLT,
+                          OPJ_BOOL LazyNoDistortion, int num_threads)
+{
+    opj_cparameters_t l_parameters = *parameters;
+    opj_stream_t *l_stream = 00;
+    opj_codec_t* l_codec = 00;
+    OPJ_BOOL bSuccess;
+    OPJ_BOOL bUseTiles = OPJ_FALSE; /* OPJ_TRUE */
+    OPJ_UINT32 l_nb_tiles = 4;
+    OPJ_UINT32 i;
+
+    /* Decide if MCT should be used */
+    if (l_parameters.tcp_mct == (char)
+            255) { /* mct mode has not been set in commandline */
+        l_parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;
+    } else {            /* mct mode has been set in commandline */
+        if ((l_parameters.tcp_mct == 1) && (image->numcomps < 3)) {
+            fprintf(stderr, "RGB->YCC conversion cannot be used:\n");
+            fprintf(stderr, "Input image has less than 3 components\n");
+            return COMPRESS_FAILED;
+        }
+        if ((l_parameters.tcp_mct == 2) && (!l_parameters.mct_data)) {
+            fprintf(stderr, "Custom MCT has been set but no array-based MCT\n");
+            fprintf(stderr, "has been provided. Aborting.\n");
+            return COMPRESS_FAILED;
+        }
+    }
+
+    if (OPJ_IS_IMF(l_parameters.rsiz) && framerate > 0) {
+        const int mainlevel = OPJ_GET_IMF_MAINLEVEL(l_parameters.rsiz);
+        if (mainlevel > 0 && mainlevel <= OPJ_IMF_MAINLEVEL_MAX) {
+            const int limitMSamplesSec[] = {
+                0,
+                OPJ_IMF_MAINLEVEL_1_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_2_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_3_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_4_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_5_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_6_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_7_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_8_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_9_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_10_MSAMPLESEC,
+                OPJ_IMF_MAINLEVEL_11_MSAMPLESEC
+            };
+            OPJ_UINT32 avgcomponents = image->numcomps;
+            double msamplespersec;
+            if (image->numcomps == 3 &&
+                    image->comps[1].dx == 2 &&
+                    image->comps[1].dy == 2) {
+                avgcomponents = 2;
+            }
+            msamplespersec = (double)image->x1 * image->y1 * avgcomponents * framerate /
+                             1e6;
+            if (msamplespersec > limitMSamplesSec[mainlevel]) {
+                fprintf(stderr,
+                        "Warning: MSamples/sec is %f, whereas limit is %d.\n",
+                        msamplespersec,
+                        limitMSamplesSec[mainlevel]);
+            }
+        }
+    }
+
+    /* encode the destination image */
+    /* ---------------------------- */
+
+    switch (l_parameters.cod_format) {
+    case J2K_CFMT: { /* JPEG-2000 codestream */
+        /* Get a decoder handle */
+        l_codec = opj_create_compress(OPJ_CODEC_J2K);
+        break;
+    }
+    case JP2_CFMT: { /* JPEG 2000 compressed image data */
+        /* Get a decoder handle */
+        l_codec = opj_create_compress(OPJ_CODEC_JP2);
+        break;
+    }
+    default:
+        fprintf(stderr, "skipping file..\n");
+        return COMPRESS_SKIPPED;
+    }
+
+    /* catch events using our callbacks and give a local context */
+    opj_set_info_handler(l_codec, info_callback, 00);
+    opj_set_warning_handler(l_codec, warning_callback, 00);
+    opj_set_error_handler(l_codec, error_callback, 00);
+
+    if (bUseTiles) {
+        l_parameters.cp_tx0 = 0;
+        l_parameters.cp_ty0 = 0;
+        l_parameters.tile_size_on = OPJ_TRUE;
+        l_parameters.cp_tdx = 512;
+        l_parameters.cp_tdy = 512;
+    }
+    if (! opj_setup_encoder(l_codec, &l_parameters, image)) {
+        fprintf(stderr, "failed to encode image: opj_setup_encoder\n");
+        opj_destroy_codec(l_codec);
+        return COMPRESS_FAILED;
+    }
+
+    if (PLT || LazyNoDistortion) {
+        const char* options[3];
+        int nb_options = 0;
+        if (PLT) {
+            options[nb_options++] = "PLT=YES";
+        }
+        if (LazyNoDistortion) {
+            options[nb_options++] = "LAZY_NO_DISTORTION=YES";
+        }
+        options[nb_options] = NULL;
+        if (!opj_encoder_set_extra_options(l_codec, options)) {
+            fprintf(stderr, "failed to encode image: opj_encoder_set_extra_options\n");
+            opj_destroy_codec(l_codec);
+            return COMPRESS_FAILED;
+        }
+    }
+
+    if (num_threads >= 1 &&
+            !opj_codec_set_threads(l_codec, num_threads)) {
+        fprintf(stderr, "failed to set number of threads\n");
+        opj_destroy_codec(l_codec);
+        return COMPRESS_FAILED;
+    }
+
+    /* open a byte stream for writing and allocate memory for all tiles */
+    l_stream = opj_stream_create_default_file_stream(l_parameters.outfile, OPJ_FALSE);
+    if (! l_stream) {
+        opj_destroy_codec(l_codec);
+        return COMPRESS_FAILED;
+    }
+
+    /* encode the image */
+    bSuccess = opj_start_compress(l_codec, image, l_stream);
+    if (!bSuccess)  {
+        fprintf(stderr, "failed to encode image: opj_start_compress\n");
+    }
+    if (bSuccess && bUseTiles) {
+        OPJ_BYTE *l_data;
+        OPJ_UINT32 l_data_size = 512 * 512 * 3;
+        l_data = (OPJ_BYTE*) calloc(1, l_data_size);
+        if (l_data == NULL) {
+            opj_stream_destroy(l_stream);
+            opj_destroy_codec(l_codec);
+            return COMPRESS_FAILED;
+        }
+        for (i = 0; i < l_nb_tiles; ++i) {
+            if (! opj_write_tile(l_codec, i, l_data, l_data_size, l_stream)) {
+                fprintf(stderr, "ERROR -> test_tile_encoder: failed to write the tile %d!\n",
+                        i);
+                free(l_data);
+                opj_stream_destroy(l_stream);
+                opj_destroy_codec(l_codec);
+                return COMPRESS_FAILED;
+            }
+        }
+        free(l_data);
+    } else {
+        bSuccess = bSuccess && opj_encode(l_codec, l_stream);
+        if (!bSuccess)  {
+            fprintf(stderr, "failed to encode image: opj_encode\n");
+        }
+    }
+    bSuccess = bSuccess && opj_end_compress(l_codec, l_stream);
+    if (!bSuccess)  {
+        fprintf(stderr, "failed to encode image: opj_end_compress\n");
+    }
+
+    if (!bSuccess)  {
+        opj_stream_destroy(l_stream);
+        opj_destroy_codec(l_codec);
+        fprintf(stderr, "failed to encode image\n");
+        remove(l_parameters.outfile);
+        return COMPRESS_FAILED;
+    }
+    fprintf(stdout, "[INFO] Generated outfile %s\n", l_parameters.outfile);
+    /* close and free the byte stream */
+    opj_stream_destroy(l_stream);
+
+    /* free remaining compression structures */
+    opj_destroy_codec(l_codec);
+    return COMPRESS_OK;
+}
 
+/* -------------------------------------------------------------------------- */
+/* Batch mode: several images of a directory encoded at once                  */
+
+/** Result of the compression of an image in batch mode */
+typedef struct opj_compress_batch_result {
+    int status;
+    /** size of the input file */
+    OPJ_UINT64 read_bytes;
+    /** size of the output file */
+    OPJ_UINT64 written_bytes;
+} opj_compress_batch_result_t;
+
+/** Compression of the images of a directory in batch mode */
+typedef struct opj_compress_batch {
+    const opj_cparameters_t* parameters;
+    dircnt_t* dirptr;
+    img_fol_t* img_fol;
+    raw_cparameters_t* raw_cp;
+    int framerate;
+    OPJ_BOOL PLT;
+    OPJ_BOOL LazyNoDistortion;
+    /** number of threads of the encoder of each image */
+    int num_threads;
+    opj_compress_batch_result_t* results;
+} opj_compress_batch_t;
+
+/** Image read in batch mode */
+typedef struct opj_compress_batch_item {
+    opj_cparameters_t parameters;
+    opj_image_t* image;
+} opj_compress_batch_item_t;
+
+static OPJ_UINT64 get_file_size(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    long l_size = 0;
+
+    if (f) {
+        if (fseek(f, 0, SEEK_END) == 0) {
+            l_size = ftell(f);
+        }
+        fclose(f);
+    }
+    return l_size > 0 ? (OPJ_UINT64)l_size : 0;
+}
+
+static void* batch_load_image(int index, void* user_data)
+{
+    opj_compress_batch_t* batch = (opj_compress_batch_t*)user_data;
+    opj_compress_batch_result_t* l_result = &batch->results[index];
+    opj_compress_batch_item_t* l_item;
+
+    l_item = (opj_compress_batch_item_t*)malloc(sizeof(
+                 opj_compress_batch_item_t));
+    if (!l_item) {
+        l_result->status = COMPRESS_FAILED;
+        return NULL;
+    }
+    /* The comment and MCT arrays are shared by all the images */
+    l_item->parameters = *batch->parameters;
+    if (get_next_file(index, batch->dirptr, batch->img_fol,
+                      &l_item->parameters)) {
+        fprintf(stderr, "skipping file...\n");
+        l_result->status = COMPRESS_SKIPPED;
+        free(l_item);
+        return NULL;
+    }
+
+    /* The input formats are read by the calling thread only */
+    l_result->status = load_image(&l_item->parameters, batch->raw_cp,
+                                  &l_item->image);
+    if (l_result->status != COMPRESS_OK) {
+        free(l_item);
+        return NULL;
+    }
+    l_result->read_bytes = get_file_size(l_item->parameters.infile);
+    return l_item;
+}
+
+static int batch_process_image(int index, void* item, void* user_data)
+{
+    opj_compress_batch_t* batch = (opj_compress_batch_t*)user_data;
+    opj_compress_batch_result_t* l_result = &batch->results[index];
+    opj_compress_batch_item_t* l_item = (opj_compress_batch_item_t*)item;
+
+    if (l_item) {
+        l_result->status = compress_image(&l_item->parameters, l_item->image,
+                                          batch->framerate, batch->PLT,
+                                          batch->LazyNoDistortion,
+                                          batch->num_threads);
+        opj_image_destroy(l_item->image);
+        if (l_result->status == COMPRESS_OK) {
+            l_result->written_bytes = get_file_size(l_item->parameters.outfile);
+        }
+        free(l_item);
+    }
+    return l_result->status == COMPRESS_FAILED;
+}
+
+/**
+ * Compresses the images of a directory, batch_size at once.
+ *
+ * @return 1 if the compression of an image failed, 0 otherwise.
+ */
+static int compress_batch(const opj_cparameters_t* parameters,
+                          dircnt_t* dirptr, img_fol_t* img_fol,
+                          raw_cparameters_t* raw_cp, unsigned int num_images,
+                          int batch_size, int framerate, OPJ_BOOL PLT,
+                          OPJ_BOOL LazyNoDistortion, int num_threads,
+                          OPJ_SIZE_T* p_nb_compressed)
+{
+    opj_compress_batch_t batch;
+    OPJ_UINT64 l_read_bytes = 0, l_written_bytes = 0;
+    OPJ_FLOAT64 l_time;
+    unsigned int i;
+    int l_nb_failed;
+
+    if (!opj_batch_has_thread_support()) {
+        fprintf(stderr, "[WARNING] No thread support: the images are encoded "
+                "one after the other.\n");
+    }
+
+    batch.parameters = parameters;
+    batch.dirptr = dirptr;
+    batch.img_fol = img_fol;
+    batch.raw_cp = raw_cp;
+    batch.framerate = framerate;
+    batch.PLT = PLT;
+    batch.LazyNoDistortion = LazyNoDistortion;
+    /* The threads are shared among the images encoded at once, each image */
+    /* getting at least one when threads were requested */
+    batch.num_threads = num_threads / batch_size;
+    if (num_threads > 0 && batch.num_threads < 1) {
+        batch.num_threads = 1;
+    }
+    batch.results = (opj_compress_batch_result_t*)calloc(num_images,
+                    sizeof(opj_compress_batch_result_t));
+    if (!batch.results) {
+        fprintf(stderr, "[ERROR] Not enough memory\n");
+        return 1;
+    }
+
+    l_time = opj_batch_wall_clock();
+    l_nb_failed = opj_batch_run((int)num_images, batch_size, batch_load_image,
+                                batch_process_image, &batch);
+    l_time = opj_batch_wall_clock() - l_time;
+    if (l_nb_failed < 0) {
+        fprintf(stderr, "[ERROR] Failed to create the threads of the batch\n");
+        free(batch.results);
+        return 1;
+    }
+
+    for (i = 0; i < num_images; ++i) {
+        if (batch.results[i].status == COMPRESS_OK) {
+            l_read_bytes += batch.results[i].read_bytes;
+            l_written_bytes += batch.results[i].written_bytes;
+            ++(*p_nb_compressed);
+        }
+    }
+    free(batch.results);
+
+    if (l_time > 0) {
+        fprintf(stdout, "[INFO] Batch of %u images: %u encoded in %.3f s, "
+                "%.2f images/s, %.2f MB/s read, %.2f MB/s written\n",
+                num_images, (unsigned int)*p_nb_compressed, l_time,
+                (OPJ_FLOAT64)*p_nb_compressed / l_time,
+                (OPJ_FLOAT64)l_read_bytes / (1024.0 * 1024.0) / l_time,
+                (OPJ_FLOAT64)l_written_bytes / (1024.0 * 1024.0) / l_time);
+    }
+    return l_nb_failed > 0;
+}
 /* -------------------------------------------------------------------------- */
 /**
  * OPJ_COMPRESS MAIN
@@ -1858,8 +2366,6 @@ int main(int argc, char **argv)
 
     opj_cparameters_t parameters;   /* compression parameters */
 
-    opj_stream_t *l_stream = 00;
-    opj_codec_t* l_codec = 00;
     opj_image_t *image = NULL;
     raw_cparameters_t raw_cp;
     OPJ_SIZE_T num_compressed_files = 0;
@@ -1872,14 +2378,14 @@ int main(int argc, char **argv)
 
     int ret = 0;
 
-    OPJ_BOOL bSuccess;
-    OPJ_BOOL bUseTiles = OPJ_FALSE; /* OPJ_TRUE */
-    OPJ_UINT32 l_nb_tiles = 4;
     int framerate = 0;
-    OPJ_FLOAT64 t = opj_clock();
+    OPJ_FLOAT64 t = opj_batch_wall_clock();
 
     OPJ_BOOL PLT = OPJ_FALSE;
+    OPJ_BOOL LazyNoDistortion = OPJ_FALSE;
     int num_threads = 0;
+    int batch_size = 0;
+    int l_status;
 
     /* set encoding parameters to default values */
     opj_set_default_encoder_parameters(&parameters);
@@ -1900,7 +2406,7 @@ int main(int argc, char **argv)
     parameters.tcp_mct = (char)
                          255; /* This will be set later according to the input image or the provided option */
     if (parse_cmdline_encoder(argc, argv, &parameters, &img_fol, &raw_cp,
-                              indexfilename, sizeof(indexfilename), &framerate, &PLT, &num_threads) == 1) {
+                              indexfilename, sizeof(indexfilename), &framerate, &PLT, &LazyNoDistortion, &num_threads, &batch_size) == 1) {
         ret = 1;
         goto fin;
     }
@@ -1933,6 +2439,13 @@ int main(int argc, char **argv)
     } else {
         num_images = 1;
     }
+    if (img_fol.set_imgdir == 1 && batch_size > 1) {
+        ret = compress_batch(&parameters, dirptr, &img_fol, &raw_cp, num_images,
+                             batch_size, framerate, PLT, LazyNoDistortion,
+                             num_threads, &num_compressed_files);
+        goto fin;
+    }
+
     /*Encoding image one by one*/
     for (imageno = 0; imageno < num_images; imageno++) {
         image = NULL;
@@ -1945,298 +2458,35 @@ int main(int argc, char **argv)
             }
         }
 
-        switch (parameters.decod_format) {
-        case PGX_DFMT:
-            break;
-        case PXM_DFMT:
-            break;
-        case BMP_DFMT:
-            break;
-        case TIF_DFMT:
-            break;
-        case RAW_DFMT:
-        case RAWL_DFMT:
-            break;
-        case TGA_DFMT:
-            break;
-        case PNG_DFMT:
-            break;
-        default:
-            fprintf(stderr, "skipping file...\n");
-            continue;
-        }
-
         /* decode the source image */
         /* ----------------------- */
 
-        switch (parameters.decod_format) {
-        case PGX_DFMT:
-            image = pgxtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load pgx file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-        case PXM_DFMT:
-            image = pnmtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load pnm file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-        case BMP_DFMT:
-            image = bmptoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load bmp file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-#ifdef OPJ_HAVE_LIBTIFF
-        case TIF_DFMT:
-            image = tiftoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load tiff file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-#endif /* OPJ_HAVE_LIBTIFF */
-
-        case RAW_DFMT:
-            image = rawtoimage(parameters.infile, &parameters, &raw_cp);
-            if (!image) {
-                fprintf(stderr, "Unable to load raw file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-        case RAWL_DFMT:
-            image = rawltoimage(parameters.infile, &parameters, &raw_cp);
-            if (!image) {
-                fprintf(stderr, "Unable to load raw file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-        case TGA_DFMT:
-            image = tgatoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load tga file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-
-#ifdef OPJ_HAVE_LIBPNG
-        case PNG_DFMT:
-            image = pngtoimage(parameters.infile, &parameters);
-            if (!image) {
-                fprintf(stderr, "Unable to load png file\n");
-                ret = 1;
-                goto fin;
-            }
-            break;
-#endif /* OPJ_HAVE_LIBPNG */
+        l_status = load_image(&parameters, &raw_cp, &image);
+        if (l_status == COMPRESS_SKIPPED) {
+            continue;
         }
-
-        /* Can happen if input file is TIFF or PNG
-        * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
-        */
-        if (!image) {
-            fprintf(stderr, "Unable to load file: got no image\n");
+        if (l_status == COMPRESS_FAILED) {
             ret = 1;
             goto fin;
         }
 
-        /* Decide if MCT should be used */
-        if (parameters.tcp_mct == (char)
-                255) { /* mct mode has not been set in commandline */
-            parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;
-        } else {            /* mct mode has been set in commandline */
-            if ((parameters.tcp_mct == 1) && (image->numcomps < 3)) {
-                fprintf(stderr, "RGB->YCC conversion cannot be used:\n");
-                fprintf(stderr, "Input image has less than 3 components\n");
-                ret = 1;
-                goto fin;
-            }
-            if ((parameters.tcp_mct == 2) && (!parameters.mct_data)) {
-                fprintf(stderr, "Custom MCT has been set but no array-based MCT\n");
-                fprintf(stderr, "has been provided. Aborting.\n");
-                ret = 1;
-                goto fin;
-            }
-        }
-
-        if (OPJ_IS_IMF(parameters.rsiz) && framerate > 0) {
-            const int mainlevel = OPJ_GET_IMF_MAINLEVEL(parameters.rsiz);
-            if (mainlevel > 0 && mainlevel <= OPJ_IMF_MAINLEVEL_MAX) {
-                const int limitMSamplesSec[] = {
-                    0,
-                    OPJ_IMF_MAINLEVEL_1_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_2_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_3_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_4_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_5_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_6_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_7_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_8_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_9_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_10_MSAMPLESEC,
-                    OPJ_IMF_MAINLEVEL_11_MSAMPLESEC
-                };
-                OPJ_UINT32 avgcomponents = image->numcomps;
-                double msamplespersec;
-                if (image->numcomps == 3 &&
-                        image->comps[1].dx == 2 &&
-                        image->comps[1].dy == 2) {
-                    avgcomponents = 2;
-                }
-                msamplespersec = (double)image->x1 * image->y1 * avgcomponents * framerate /
-                                 1e6;
-                if (msamplespersec > limitMSamplesSec[mainlevel]) {
-                    fprintf(stderr,
-                            "Warning: MSamples/sec is %f, whereas limit is %d.\n",
-                            msamplespersec,
-                            limitMSamplesSec[mainlevel]);
-                }
-            }
-        }
-
         /* encode the destination image */
         /* ---------------------------- */
 
-        switch (parameters.cod_format) {
-        case J2K_CFMT: { /* JPEG-2000 codestream */
-            /* Get a decoder handle */
-            l_codec = opj_create_compress(OPJ_CODEC_J2K);
-            break;
-        }
-        case JP2_CFMT: { /* JPEG 2000 compressed image data */
-            /* Get a decoder handle */
-            l_codec = opj_create_compress(OPJ_CODEC_JP2);
-            break;
-        }
-        default:
-            fprintf(stderr, "skipping file..\n");
-            opj_stream_destroy(l_stream);
-            continue;
-        }
-
-        /* catch events using our callbacks and give a local context */
-        opj_set_info_handler(l_codec, info_callback, 00);
-        opj_set_warning_handler(l_codec, warning_callback, 00);
-        opj_set_error_handler(l_codec, error_callback, 00);
-
-        if (bUseTiles) {
-            parameters.cp_tx0 = 0;
-            parameters.cp_ty0 = 0;
-            parameters.tile_size_on = OPJ_TRUE;
-            parameters.cp_tdx = 512;
-            parameters.cp_tdy = 512;
-        }
-        if (! opj_setup_encoder(l_codec, &parameters, image)) {
-            fprintf(stderr, "failed to encode image: opj_setup_encoder\n");
-            opj_destroy_codec(l_codec);
-            opj_image_destroy(image);
-            ret = 1;
-            goto fin;
-        }
-
-        if (PLT) {
-            const char* const options[] = { "PLT=YES", NULL };
-            if (!opj_encoder_set_extra_options(l_codec, options)) {
-                fprintf(stderr, "failed to encode image: opj_encoder_set_extra_options\n");
-                opj_destroy_codec(l_codec);
-                opj_image_destroy(image);
-                ret = 1;
-                goto fin;
-            }
-        }
-
-        if (num_threads >= 1 &&
-                !opj_codec_set_threads(l_codec, num_threads)) {
-            fprintf(stderr, "failed to set number of threads\n");
-            opj_destroy_codec(l_codec);
-            opj_image_destroy(image);
-            ret = 1;
-            goto fin;
-        }
-
-        /* open a byte stream for writing and allocate memory for all tiles */
-        l_stream = opj_stream_create_default_file_stream(parameters.outfile, OPJ_FALSE);
-        if (! l_stream) {
+        l_status = compress_image(&parameters, image, framerate, PLT,
+                                  LazyNoDistortion, num_threads);
+        /* free image data */
+        opj_image_destroy(image);
+        if (l_status == COMPRESS_FAILED) {
             ret = 1;
             goto fin;
         }
-
-        /* encode the image */
-        bSuccess = opj_start_compress(l_codec, image, l_stream);
-        if (!bSuccess)  {
-            fprintf(stderr, "failed to encode image: opj_start_compress\n");
-        }
-        if (bSuccess && bUseTiles) {
-            OPJ_BYTE *l_data;
-            OPJ_UINT32 l_data_size = 512 * 512 * 3;
-            l_data = (OPJ_BYTE*) calloc(1, l_data_size);
-            if (l_data == NULL) {
-                ret = 1;
-                goto fin;
-            }
-            for (i = 0; i < l_nb_tiles; ++i) {
-                if (! opj_write_tile(l_codec, i, l_data, l_data_size, l_stream)) {
-                    fprintf(stderr, "ERROR -> test_tile_encoder: failed to write the tile %d!\n",
-                            i);
-                    opj_stream_destroy(l_stream);
-                    opj_destroy_codec(l_codec);
-                    opj_image_destroy(image);
-                    ret = 1;
-                    goto fin;
-                }
-            }
-            free(l_data);
-        } else {
-            bSuccess = bSuccess && opj_encode(l_codec, l_stream);
-            if (!bSuccess)  {
-                fprintf(stderr, "failed to encode image: opj_encode\n");
-            }
+        if (l_status == COMPRESS_OK) {
+            num_compressed_files++;
         }
-        bSuccess = bSuccess && opj_end_compress(l_codec, l_stream);
-        if (!bSuccess)  {
-            fprintf(stderr, "failed to encode image: opj_end_compress\n");
-        }
-
-        if (!bSuccess)  {
-            opj_stream_destroy(l_stream);
-            opj_destroy_codec(l_codec);
-            opj_image_destroy(image);
-            fprintf(stderr, "failed to encode image\n");
-            remove(parameters.outfile);
-            ret = 1;
-            goto fin;
-        }
-
-        num_compressed_files++;
-        fprintf(stdout, "[INFO] Generated outfile %s\n", parameters.outfile);
-        /* close and free the byte stream */
-        opj_stream_destroy(l_stream);
-
-        /* free remaining compression structures */
-        opj_destroy_codec(l_codec);
-
-        /* free image data */
-        opj_image_destroy(image);
-
     }
 
-    t = opj_clock() - t;
+    t = opj_batch_wall_clock() - t;
     if (num_compressed_files) {
         fprintf(stdout, "encode time: %d ms \n",
                 (int)((t * 1000.0) / (OPJ_FLOAT64)num_compressed_files));
@@ -2245,6 +2495,7 @@ int main(int argc, char **argv)
     ret = 0;
 
 fin:
+    opj_print_perf_counters(stdout, 1);
     if (parameters.cp_comment) {
         free(parameters.cp_comment);
     }
@@ -77,6 +77,8 @@
 
 #include "format_defs.h"
 #include "opj_string.h"
+#include "opj_batch.h"
+#include "opj_perf_report.h"
 
 typedef struct dircnt {
     /** Buffer for holding images read from Directory*/
@@ -150,6 +152,10 @@ typedef struct opj_decompress_params {
     int split_pnm;
     /** number of threads */
     int num_threads;
+    /** maximum number of coding passes decoded per code-block, 0 for all */
+    OPJ_UINT32 max_passes;
+    /** number of images decoded at once with -ImgDir, 0 for one at a time */
+    int batch_size;
     /* Quiet */
     int quiet;
     /** number of components to decode */
@@ -211,7 +217,11 @@ static void decode_help_display(void)
             "  -l <number of quality layers to decode>\n"
             "    Set the maximum number of quality layers to decode. If there are\n"
             "    less quality layers than the specified number, all the quality layers\n"
-            "    are decoded.\n");
+            "    are decoded.\n"
+            "  -max-passes <number of coding passes to decode>\n"
+            "    Set the maximum number of coding passes decoded per code-block, for a\n"
+            "    fast preview of the image. Decoding n bit-planes takes 3*n-2 passes.\n"
+            "    By default, all the coding passes are decoded.\n");
     fprintf(stdout, "  -x  \n"
             "    Create an index file *.Idx (-x index_name.Idx) \n"
             "  -d <x0,y0,x1,y1>\n"
@@ -245,6 +255,13 @@ static void decode_help_display(void)
         fprintf(stdout, "  -threads <num_threads|ALL_CPUS>\n"
                 "    Number of threads to use for decoding or ALL_CPUS for all available cores.\n");
     }
+    if (opj_batch_has_thread_support()) {
+        fprintf(stdout, "  -batch <number of images>\n"
+                "    With -ImgDir, number of images decoded at once. The next input\n"
+                "    files are read while the images are decoded and written, and the\n"
+                "    threads of -threads are shared among the images decoded at once.\n"
+                "    A summary of the throughput is printed at the end.\n");
+    }
     fprintf(stdout, "  -quiet\n"
             "    Disable output from the library and other output.\n");
     /* UniPG>> */
@@ -566,6 +583,8 @@ int parse_cmdline_decoder(int argc, char **argv,
         {"split-pnm", NO_ARG,  NULL, 1},
         {"threads",   REQ_ARG, NULL, 'T'},
         {"quiet", NO_ARG,  NULL, 1},
+        {"max-passes", REQ_ARG, NULL, 'M'},
+        {"batch", REQ_ARG, NULL, 'B'},
     };
 
     const char optlist[] = "i:o:r:l:x:d:t:p:c:"
@@ -718,6 +737,13 @@ int parse_cmdline_decoder(int argc, char **argv,
 
         /* ----------------------------------------------------- */
 
+        case 'M': {     /* maximum number of coding passes */
+            sscanf(opj_optarg, "%u", &(parameters->max_passes));
+        }
+        break;
+
+        /* ----------------------------------------------------- */
+
         case 'h':           /* display an help description */
             decode_help_display();
             return 1;
@@ -885,6 +911,16 @@ int parse_cmdline_decoder(int argc, char **argv,
         }
         break;
 
+        /* ----------------------------------------------------- */
+        case 'B': { /* Number of images decoded at once */
+            if (sscanf(opj_optarg, "%d", &parameters->batch_size) != 1 ||
+                    parameters->batch_size < 1) {
+                fprintf(stderr, "[ERROR] Invalid -batch value: %s\n", opj_optarg);
+                return 1;
+            }
+        }
+        break;
+
         /* ----------------------------------------------------- */
 
         default:
@@ -911,6 +947,10 @@ int parse_cmdline_decoder(int argc, char **argv,
             return 1;
         }
     } else {
+        if (parameters->batch_size != 0) {
+            fprintf(stderr, "[ERROR] option -batch can only be used with -ImgDir.\n");
+            return 1;
+        }
         if ((parameters->infile[0] == 0) || (parameters->outfile[0] == 0)) {
             fprintf(stderr, "[ERROR] Required parameters are missing\n"
                     "Example: %s -i image.j2k -o image.pgm\n", argv[0]);
@@ -954,38 +994,6 @@ int parse_DA_values(char* inArg, unsigned int *DA_x0, unsigned int *DA_y0,
     }
 }
 
-OPJ_FLOAT64 opj_clock(void)
-{
-#ifdef _WIN32
-    /* _WIN32: use QueryPerformance (very accurate) */
-    LARGE_INTEGER freq, t ;
-    /* freq is the clock speed of the CPU */
-    QueryPerformanceFrequency(&freq) ;
-    /* cout << "freq = " << ((double) freq.QuadPart) << endl; */
-    /* t is the high resolution performance counter (see MSDN) */
-    QueryPerformanceCounter(& t) ;
-    return freq.QuadPart ? ((OPJ_FLOAT64)t.QuadPart / (OPJ_FLOAT64)freq.QuadPart) :
-           0;
-#elif defined(__linux)
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    return ((OPJ_FLOAT64)ts.tv_sec + (OPJ_FLOAT64)ts.tv_nsec * 1e-9);
-#else
-    /* Unix : use resource usage */
-    /* FIXME: this counts the total CPU time, instead of the user perceived time */
-    struct rusage t;
-    OPJ_FLOAT64 procTime;
-    /* (1) Get the rusage data structure at this moment (man getrusage) */
-    getrusage(0, &t);
-    /* (2) What is the elapsed time ? - CPU time = User time + System time */
-    /* (2a) Get the seconds */
-    procTime = (OPJ_FLOAT64)(t.ru_utime.tv_sec + t.ru_stime.tv_sec);
-    /* (2b) More precisely! Get the microseconds part ! */
-    return (procTime + (OPJ_FLOAT64)(t.ru_utime.tv_usec + t.ru_stime.tv_usec) *
-            1e-6) ;
-#endif
-}
-
 /* -------------------------------------------------------------------------- */
 
 /**
@@ -1308,6 +1316,610 @@ static opj_image_t* upsample_image_components(opj_image_t* original)
     return l_new_image;
 }
 
+/* -------------------------------------------------------------------------- */
+
+/** Results of decompress_image() */
+#define DECOMPRESS_OK            0
+#define DECOMPRESS_SKIPPED       1
+#define DECOMPRESS_FAILED        2
+#define DECOMPRESS_OUTPUT_FAILED 3
+
+/**
+ * Decompresses the image of a stream, and writes the output file.
+ *
+ * @param parameters    decompression parameters, with the input and output files
+ * @param l_stream      stream of the input file
+ * @param cp_reduce     reduce factor, given to opj_set_decoded_resolution_factor()
+ *                      if USE_OPJ_SET_DECODED_RESOLUTION_FACTOR is defined
+ * @param num_threads   number of threads of the decoder
+ * @param p_decode_time set to the decoding time, if the image is decoded
+ * @return DECOMPRESS_OK, DECOMPRESS_SKIPPED if the input format is not
+ * supported, DECOMPRESS_FAILED if the decoding failed, or
+ * DECOMPRESS_OUTPUT_FAILED if the output file could not be written
+ */
+static int decompress_image(opj_decompress_parameters* parameters,
+                            opj_stream_t* l_stream, OPJ_UINT32 cp_reduce,
+                            int num_threads, OPJ_FLOAT64* p_decode_time)
+{
+    opj_image_t* image = NULL;
+    opj_codec_t* l_codec = NULL;                /* Handle to a decompressor */
+    opj_codestream_index_t* cstr_index = NULL;
+    OPJ_FLOAT64 t;
+    int l_status = DECOMPRESS_OK;
+
+    switch (parameters->decod_format) {
+    case J2K_CFMT: { /* JPEG-2000 codestream */
+        /* Get a decoder handle */
+        l_codec = opj_create_decompress(OPJ_CODEC_J2K);
+        break;
+    }
+    case JP2_CFMT: { /* JPEG 2000 compressed image data */
+        /* Get a decoder handle */
+        l_codec = opj_create_decompress(OPJ_CODEC_JP2);
+        break;
+    }
+    case JPT_CFMT: { /* JPEG 2000, JPIP */
+        /* Get a decoder handle */
+        l_codec = opj_create_decompress(OPJ_CODEC_JPT);
+        break;
+    }
+    default:
+        fprintf(stderr, "skipping file..\n");
+        return DECOMPRESS_SKIPPED;
+    }
+
+    if (parameters->quiet) {
+        /* Set all callbacks to quiet */
+        opj_set_info_handler(l_codec, quiet_callback, 00);
+        opj_set_warning_handler(l_codec, quiet_callback, 00);
+        opj_set_error_handler(l_codec, quiet_callback, 00);
+    } else {
+        /* catch events using our callbacks and give a local context */
+        opj_set_info_handler(l_codec, info_callback, 00);
+        opj_set_warning_handler(l_codec, warning_callback, 00);
+        opj_set_error_handler(l_codec, error_callback, 00);
+    }
+
+
+    t = opj_batch_wall_clock();
+
+    /* Setup the decoder decoding parameters using user parameters */
+    if (!opj_setup_decoder(l_codec, &(parameters->core))) {
+        fprintf(stderr, "ERROR -> opj_decompress: failed to setup the decoder\n");
+        opj_destroy_codec(l_codec);
+        return DECOMPRESS_FAILED;
+    }
+
+    if (num_threads >= 1 &&
+            !opj_codec_set_threads(l_codec, num_threads)) {
+        fprintf(stderr, "ERROR -> opj_decompress: failed to set number of threads\n");
+        opj_destroy_codec(l_codec);
+        return DECOMPRESS_FAILED;
+    }
+
+    if (parameters->max_passes != 0 &&
+            !opj_decoder_set_max_cblk_passes(l_codec, parameters->max_passes)) {
+        fprintf(stderr,
+                "ERROR -> opj_decompress: failed to set the maximum number of coding passes\n");
+        opj_destroy_codec(l_codec);
+        return DECOMPRESS_FAILED;
+    }
+
+    /* Read the main header of the codestream and if necessary the JP2 boxes*/
+    if (! opj_read_header(l_stream, l_codec, &image)) {
+        fprintf(stderr, "ERROR -> opj_decompress: failed to read the header\n");
+        opj_destroy_codec(l_codec);
+        opj_image_destroy(image);
+        return DECOMPRESS_FAILED;
+    }
+
+    if (parameters->numcomps) {
+        if (! opj_set_decoded_components(l_codec,
+                                         parameters->numcomps,
+                                         parameters->comps_indices,
+                                         OPJ_FALSE)) {
+            fprintf(stderr,
+                    "ERROR -> opj_decompress: failed to set the component indices!\n");
+            opj_destroy_codec(l_codec);
+            opj_image_destroy(image);
+            return DECOMPRESS_FAILED;
+        }
+    }
+
+    if (getenv("USE_OPJ_SET_DECODED_RESOLUTION_FACTOR") != NULL) {
+        /* For debugging/testing purposes, and also an illustration on how to */
+        /* use the alternative API opj_set_decoded_resolution_factor() instead */
+        /* of setting parameters->cp_reduce */
+        if (! opj_set_decoded_resolution_factor(l_codec, cp_reduce)) {
+            fprintf(stderr,
+                    "ERROR -> opj_decompress: failed to set the resolution factor tile!\n");
+            opj_destroy_codec(l_codec);
+            opj_image_destroy(image);
+            return DECOMPRESS_FAILED;
+        }
+    }
+
+    if (!parameters->nb_tile_to_decode) {
+        if (getenv("SKIP_OPJ_SET_DECODE_AREA") != NULL &&
+                parameters->DA_x0 == 0 &&
+                parameters->DA_y0 == 0 &&
+                parameters->DA_x1 == 0 &&
+                parameters->DA_y1 == 0) {
+            /* For debugging/testing purposes, */
+            /* do nothing if SKIP_OPJ_SET_DECODE_AREA env variable */
+            /* is defined and no decoded area has been set */
+        }
+        /* Optional if you want decode the entire image */
+        else if (!opj_set_decode_area(l_codec, image, (OPJ_INT32)parameters->DA_x0,
+                                      (OPJ_INT32)parameters->DA_y0, (OPJ_INT32)parameters->DA_x1,
+                                      (OPJ_INT32)parameters->DA_y1)) {
+            fprintf(stderr, "ERROR -> opj_decompress: failed to set the decoded area\n");
+            opj_destroy_codec(l_codec);
+            opj_image_destroy(image);
+            return DECOMPRESS_FAILED;
+        }
+
+        /* Get the decoded image */
+        if (!(opj_decode(l_codec, l_stream, image) &&
+                opj_end_decompress(l_codec,   l_stream))) {
+            fprintf(stderr, "ERROR -> opj_decompress: failed to decode image!\n");
+            opj_destroy_codec(l_codec);
+            opj_image_destroy(image);
+            return DECOMPRESS_FAILED;
+        }
+    } else {
+        if (!(parameters->DA_x0 == 0 &&
+                parameters->DA_y0 == 0 &&
+                parameters->DA_x1 == 0 &&
+                parameters->DA_y1 == 0)) {
+            if (!(parameters->quiet)) {
+                fprintf(stderr, "WARNING: -d option ignored when used together with -t\n");
+            }
+        }
+
+        if (!opj_get_decoded_tile(l_codec, l_stream, image, parameters->tile_index)) {
+            fprintf(stderr, "ERROR -> opj_decompress: failed to decode tile!\n");
+            opj_destroy_codec(l_codec);
+            opj_image_destroy(image);
+            return DECOMPRESS_FAILED;
+        }
+        if (!(parameters->quiet)) {
+            fprintf(stdout, "tile %d is decoded!\n\n", parameters->tile_index);
+        }
+    }
+
+    *p_decode_time = opj_batch_wall_clock() - t;
+
+    if (image->color_space != OPJ_CLRSPC_SYCC
+            && image->numcomps == 3 && image->comps[0].dx == image->comps[0].dy
+            && image->comps[1].dx != 1) {
+        image->color_space = OPJ_CLRSPC_SYCC;
+    } else if (image->numcomps <= 2) {
+        image->color_space = OPJ_CLRSPC_GRAY;
+    }
+
+    if (image->color_space == OPJ_CLRSPC_SYCC) {
+        color_sycc_to_rgb(image);
+    } else if ((image->color_space == OPJ_CLRSPC_CMYK) &&
+               (parameters->cod_format != TIF_DFMT)) {
+        color_cmyk_to_rgb(image);
+    } else if (image->color_space == OPJ_CLRSPC_EYCC) {
+        color_esycc_to_rgb(image);
+    }
+
+    if (image->icc_profile_buf) {
+#if defined(OPJ_HAVE_LIBLCMS1) || defined(OPJ_HAVE_LIBLCMS2)
+        if (image->icc_profile_len) {
+            color_apply_icc_profile(image);
+        } else {
+            color_cielab_to_rgb(image);
+        }
+#endif
+        free(image->icc_profile_buf);
+        image->icc_profile_buf = NULL;
+        image->icc_profile_len = 0;
+    }
+
+    /* Force output precision */
+    /* ---------------------- */
+    if (parameters->precision != NULL) {
+        OPJ_UINT32 compno;
+        for (compno = 0; compno < image->numcomps; ++compno) {
+            OPJ_UINT32 precno = compno;
+            OPJ_UINT32 prec;
+
+            if (precno >= parameters->nb_precision) {
+                precno = parameters->nb_precision - 1U;
+            }
+
+            prec = parameters->precision[precno].prec;
+            if (prec == 0) {
+                prec = image->comps[compno].prec;
+            }
+
+            switch (parameters->precision[precno].mode) {
+            case OPJ_PREC_MODE_CLIP:
+                clip_component(&(image->comps[compno]), prec);
+                break;
+            case OPJ_PREC_MODE_SCALE:
+                scale_component(&(image->comps[compno]), prec);
+                break;
+            default:
+                break;
+            }
+
+        }
+    }
+
+    /* Upsample components */
+    /* ------------------- */
+    if (parameters->upsample) {
+        image = upsample_image_components(image);
+        if (image == NULL) {
+            fprintf(stderr,
+                    "ERROR -> opj_decompress: failed to upsample image components!\n");
+            opj_destroy_codec(l_codec);
+            return DECOMPRESS_FAILED;
+        }
+    }
+
+    /* Force RGB output */
+    /* ---------------- */
+    if (parameters->force_rgb) {
+        switch (image->color_space) {
+        case OPJ_CLRSPC_SRGB:
+            break;
+        case OPJ_CLRSPC_GRAY:
+            image = convert_gray_to_rgb(image);
+            break;
+        default:
+            fprintf(stderr,
+                    "ERROR -> opj_decompress: don't know how to convert image to RGB colorspace!\n");
+            opj_image_destroy(image);
+            image = NULL;
+            break;
+        }
+        if (image == NULL) {
+            fprintf(stderr, "ERROR -> opj_decompress: failed to convert to RGB image!\n");
+            opj_destroy_codec(l_codec);
+            return DECOMPRESS_FAILED;
+        }
+    }
+
+    /* create output image */
+    /* ------------------- */
+    switch (parameters->cod_format) {
+    case PXM_DFMT:          /* PNM PGM PPM */
+        if (imagetopnm(image, parameters->outfile, parameters->split_pnm)) {
+            fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+
+    case PGX_DFMT:          /* PGX */
+        if (imagetopgx(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+
+    case BMP_DFMT:          /* BMP */
+        if (imagetobmp(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+#ifdef OPJ_HAVE_LIBTIFF
+    case TIF_DFMT:          /* TIFF */
+        if (imagetotif(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+#endif /* OPJ_HAVE_LIBTIFF */
+    case RAW_DFMT:          /* RAW */
+        if (imagetoraw(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Error generating raw file. Outfile %s not generated\n",
+                    parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+
+    case RAWL_DFMT:         /* RAWL */
+        if (imagetorawl(image, parameters->outfile)) {
+            fprintf(stderr,
+                    "[ERROR] Error generating rawl file. Outfile %s not generated\n",
+                    parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+
+    case TGA_DFMT:          /* TGA */
+        if (imagetotga(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Error generating tga file. Outfile %s not generated\n",
+                    parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+#ifdef OPJ_HAVE_LIBPNG
+    case PNG_DFMT:          /* PNG */
+        if (imagetopng(image, parameters->outfile)) {
+            fprintf(stderr, "[ERROR] Error generating png file. Outfile %s not generated\n",
+                    parameters->outfile);
+            l_status = DECOMPRESS_OUTPUT_FAILED;
+        } else if (!(parameters->quiet)) {
+            fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters->outfile);
+        }
+        break;
+#endif /* OPJ_HAVE_LIBPNG */
+    /* Can happen if output file is TIFF or PNG
+     * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
+    */
+    default:
+        fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters->outfile);
+        l_status = DECOMPRESS_OUTPUT_FAILED;
+    }
+
+    /* free remaining structures */
+    if (l_codec) {
+        opj_destroy_codec(l_codec);
+    }
+
+
+    /* free image data structure */
+    opj_image_destroy(image);
+
+    /* destroy the codestream index */
+    opj_destroy_cstr_index(&cstr_index);
+
+    if (l_status == DECOMPRESS_OUTPUT_FAILED) {
+        (void)remove(parameters->outfile);    /* ignore return value */
+    }
+    return l_status;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Batch mode: several images of a directory decoded at once                  */
+
+/** Result of the decompression of an image in batch mode */
+typedef struct opj_decompress_batch_result {
+    int status;
+    OPJ_FLOAT64 decode_time;
+    /** size of the input file */
+    OPJ_UINT64 read_bytes;
+    /** size of the output file */
+    OPJ_UINT64 written_bytes;
+} opj_decompress_batch_result_t;
+
+/** Decompression of the images of a directory in batch mode */
+typedef struct opj_decompress_batch {
+    const opj_decompress_parameters* parameters;
+    dircnt_t* dirptr;
+    img_fol_t* img_fol;
+    OPJ_UINT32 cp_reduce;
+    /** number of threads of the decoder of each image */
+    int num_threads;
+    opj_decompress_batch_result_t* results;
+} opj_decompress_batch_t;
+
+/** Image loaded in batch mode, whose input file is read in memory */
+typedef struct opj_decompress_batch_item {
+    opj_decompress_parameters parameters;
+    opj_stream_t* stream;
+} opj_decompress_batch_item_t;
+
+static OPJ_UINT64 get_file_size(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    long l_size = 0;
+
+    if (f) {
+        if (fseek(f, 0, SEEK_END) == 0) {
+            l_size = ftell(f);
+        }
+        fclose(f);
+    }
+    return l_size > 0 ? (OPJ_UINT64)l_size : 0;
+}
+
+/** Size of an output file, or of its components written to separate files */
+static OPJ_UINT64 get_output_size(const char* filename)
+{
+    char l_name[OPJ_PATH_LEN + 16];
+    const char* l_ext = strrchr(filename, '.');
+    OPJ_UINT64 l_size = get_file_size(filename);
+    OPJ_UINT64 l_comp_size;
+    OPJ_UINT32 compno;
+
+    if (l_size != 0 || !l_ext || strlen(filename) >= OPJ_PATH_LEN) {
+        return l_size;
+    }
+    /* PGX files, and PNM files whose components have different sizes */
+    for (compno = 0; ; ++compno) {
+        sprintf(l_name, "%.*s_%u%s", (int)(l_ext - filename), filename, compno,
+                l_ext);
+        l_comp_size = get_file_size(l_name);
+        if (l_comp_size == 0) {
+            break;
+        }
+        l_size += l_comp_size;
+    }
+    return l_size;
+}
+
+/** Reads a file into a push stream */
+static opj_stream_t* read_file_stream(const char* filename,
+                                      OPJ_UINT64* p_size)
+{
+    char l_buffer[65536];
+    opj_stream_t* l_stream;
+    FILE* f;
+    size_t l_nb_read;
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        return NULL;
+    }
+    l_stream = opj_stream_create_push_stream();
+    *p_size = 0;
+    while (l_stream &&
+            (l_nb_read = fread(l_buffer, 1, sizeof(l_buffer), f)) > 0) {
+        if (!opj_stream_push_data(l_stream, l_buffer, l_nb_read)) {
+            opj_stream_destroy(l_stream);
+            l_stream = NULL;
+        }
+        *p_size += l_nb_read;
+    }
+    if (ferror(f)) {
+        opj_stream_destroy(l_stream);
+        l_stream = NULL;
+    }
+    fclose(f);
+    return l_stream;
+}
+
+static void* batch_load_image(int index, void* user_data)
+{
+    opj_decompress_batch_t* batch = (opj_decompress_batch_t*)user_data;
+    opj_decompress_batch_result_t* l_result = &batch->results[index];
+    opj_decompress_batch_item_t* l_item;
+
+    l_item = (opj_decompress_batch_item_t*)malloc(sizeof(
+                 opj_decompress_batch_item_t));
+    if (!l_item) {
+        l_result->status = DECOMPRESS_FAILED;
+        return NULL;
+    }
+    /* The precision and component arrays are shared by all the images */
+    l_item->parameters = *batch->parameters;
+    if (get_next_file(index, batch->dirptr, batch->img_fol,
+                      &l_item->parameters)) {
+        fprintf(stderr, "skipping file...\n");
+        l_result->status = DECOMPRESS_SKIPPED;
+        free(l_item);
+        return NULL;
+    }
+
+    l_item->stream = read_file_stream(l_item->parameters.infile,
+                                      &l_result->read_bytes);
+    if (!l_item->stream) {
+        fprintf(stderr, "ERROR -> failed to read the file %s\n",
+                l_item->parameters.infile);
+        l_result->status = DECOMPRESS_FAILED;
+        free(l_item);
+        return NULL;
+    }
+    return l_item;
+}
+
+static int batch_process_image(int index, void* item, void* user_data)
+{
+    opj_decompress_batch_t* batch = (opj_decompress_batch_t*)user_data;
+    opj_decompress_batch_result_t* l_result = &batch->results[index];
+    opj_decompress_batch_item_t* l_item = (opj_decompress_batch_item_t*)item;
+
+    if (l_item) {
+        l_result->status = decompress_image(&l_item->parameters, l_item->stream,
+                                            batch->cp_reduce, batch->num_threads,
+                                            &l_result->decode_time);
+        opj_stream_destroy(l_item->stream);
+        if (l_result->status == DECOMPRESS_OK) {
+            l_result->written_bytes = get_output_size(l_item->parameters.outfile);
+        }
+        free(l_item);
+    }
+    return l_result->status == DECOMPRESS_FAILED ||
+           l_result->status == DECOMPRESS_OUTPUT_FAILED;
+}
+
+/**
+ * Decompresses the images of a directory, parameters->batch_size at once.
+ *
+ * @return 1 if the decompression of an image failed, 0 otherwise.
+ */
+static int decompress_batch(const opj_decompress_parameters* parameters,
+                            dircnt_t* dirptr, img_fol_t* img_fol,
+                            int num_images, OPJ_UINT32 cp_reduce,
+                            OPJ_FLOAT64* p_decode_time, OPJ_UINT32* p_nb_decoded)
+{
+    opj_decompress_batch_t batch;
+    OPJ_UINT64 l_read_bytes = 0, l_written_bytes = 0;
+    OPJ_UINT32 l_nb_written = 0;
+    OPJ_FLOAT64 l_time;
+    int i, l_nb_failed;
+
+    if (!opj_batch_has_thread_support() && !parameters->quiet) {
+        fprintf(stderr, "[WARNING] No thread support: the images are decoded "
+                "one after the other.\n");
+    }
+
+    batch.parameters = parameters;
+    batch.dirptr = dirptr;
+    batch.img_fol = img_fol;
+    batch.cp_reduce = cp_reduce;
+    /* The threads are shared among the images decoded at once, each image */
+    /* getting at least one when threads were requested */
+    batch.num_threads = parameters->num_threads / parameters->batch_size;
+    if (parameters->num_threads > 0 && batch.num_threads < 1) {
+        batch.num_threads = 1;
+    }
+    batch.results = (opj_decompress_batch_result_t*)calloc((size_t)num_images,
+                    sizeof(opj_decompress_batch_result_t));
+    if (!batch.results) {
+        fprintf(stderr, "[ERROR] Not enough memory\n");
+        return 1;
+    }
+
+    l_time = opj_batch_wall_clock();
+    l_nb_failed = opj_batch_run(num_images, parameters->batch_size,
+                                batch_load_image, batch_process_image, &batch);
+    l_time = opj_batch_wall_clock() - l_time;
+    if (l_nb_failed < 0) {
+        fprintf(stderr, "[ERROR] Failed to create the threads of the batch\n");
+        free(batch.results);
+        return 1;
+    }
+
+    for (i = 0; i < num_images; ++i) {
+        const opj_decompress_batch_result_t* l_result = &batch.results[i];
+        if (l_result->status == DECOMPRESS_OK ||
+                l_result->status == DECOMPRESS_OUTPUT_FAILED) {
+            *p_decode_time += l_result->decode_time;
+            ++(*p_nb_decoded);
+            l_read_bytes += l_result->read_bytes;
+        }
+        if (l_result->status == DECOMPRESS_OK) {
+            l_written_bytes += l_result->written_bytes;
+            ++l_nb_written;
+        }
+    }
+    free(batch.results);
+
+    if (!parameters->quiet && l_time > 0) {
+        fprintf(stdout, "[INFO] Batch of %d images: %u decoded in %.3f s, "
+                "%.2f images/s, %.2f MB/s read, %.2f MB/s written\n",
+                num_images, l_nb_written, l_time,
+                (OPJ_FLOAT64)l_nb_written / l_time,
+                (OPJ_FLOAT64)l_read_bytes / (1024.0 * 1024.0) / l_time,
+                (OPJ_FLOAT64)l_written_bytes / (1024.0 * 1024.0) / l_time);
+    }
+    return l_nb_failed > 0;
+}
+
 /* -------------------------------------------------------------------------- */
 /**
  * OPJ_DECOMPRESS MAIN
@@ -1321,7 +1933,7 @@ int main(int argc, char **argv)
     img_fol_t img_fol;
     dircnt_t *dirptr = NULL;
     int failed = 0;
-    OPJ_FLOAT64 t, tCumulative = 0;
+    OPJ_FLOAT64 tCumulative = 0;
     OPJ_UINT32 numDecompressedImages = 0;
     OPJ_UINT32 cp_reduce;
 
@@ -1387,12 +1999,17 @@ int main(int argc, char **argv)
         num_images = 1;
     }
 
+    if (img_fol.set_imgdir == 1 && parameters.batch_size > 1) {
+        failed = decompress_batch(&parameters, dirptr, &img_fol, num_images,
+                                  cp_reduce, &tCumulative, &numDecompressedImages);
+        goto fin;
+    }
+
     /*Decoding image one by one*/
     for (imageno = 0; imageno < num_images ; imageno++)  {
-        opj_image_t* image = NULL;
         opj_stream_t *l_stream = NULL;              /* Stream */
-        opj_codec_t* l_codec = NULL;                /* Handle to a decompressor */
-        opj_codestream_index_t* cstr_index = NULL;
+        OPJ_FLOAT64 t = 0;
+        int l_status;
 
         if (!parameters.quiet) {
             fprintf(stderr, "\n");
@@ -1401,7 +2018,6 @@ int main(int argc, char **argv)
         if (img_fol.set_imgdir == 1) {
             if (get_next_file(imageno, dirptr, &img_fol, &parameters)) {
                 fprintf(stderr, "skipping file...\n");
-                destroy_parameters(&parameters);
                 continue;
             }
         }
@@ -1420,364 +2036,20 @@ int main(int argc, char **argv)
         /* decode the JPEG2000 stream */
         /* ---------------------- */
 
-        switch (parameters.decod_format) {
-        case J2K_CFMT: { /* JPEG-2000 codestream */
-            /* Get a decoder handle */
-            l_codec = opj_create_decompress(OPJ_CODEC_J2K);
-            break;
-        }
-        case JP2_CFMT: { /* JPEG 2000 compressed image data */
-            /* Get a decoder handle */
-            l_codec = opj_create_decompress(OPJ_CODEC_JP2);
-            break;
-        }
-        case JPT_CFMT: { /* JPEG 2000, JPIP */
-            /* Get a decoder handle */
-            l_codec = opj_create_decompress(OPJ_CODEC_JPT);
-            break;
-        }
-        default:
-            fprintf(stderr, "skipping file..\n");
-            destroy_parameters(&parameters);
-            opj_stream_destroy(l_stream);
-            continue;
-        }
-
-        if (parameters.quiet) {
-            /* Set all callbacks to quiet */
-            opj_set_info_handler(l_codec, quiet_callback, 00);
-            opj_set_warning_handler(l_codec, quiet_callback, 00);
-            opj_set_error_handler(l_codec, quiet_callback, 00);
-        } else {
-            /* catch events using our callbacks and give a local context */
-            opj_set_info_handler(l_codec, info_callback, 00);
-            opj_set_warning_handler(l_codec, warning_callback, 00);
-            opj_set_error_handler(l_codec, error_callback, 00);
-        }
-
-
-        t = opj_clock();
-
-        /* Setup the decoder decoding parameters using user parameters */
-        if (!opj_setup_decoder(l_codec, &(parameters.core))) {
-            fprintf(stderr, "ERROR -> opj_decompress: failed to setup the decoder\n");
-            opj_stream_destroy(l_stream);
-            opj_destroy_codec(l_codec);
-            failed = 1;
-            goto fin;
-        }
-
-        if (parameters.num_threads >= 1 &&
-                !opj_codec_set_threads(l_codec, parameters.num_threads)) {
-            fprintf(stderr, "ERROR -> opj_decompress: failed to set number of threads\n");
-            opj_stream_destroy(l_stream);
-            opj_destroy_codec(l_codec);
-            failed = 1;
-            goto fin;
-        }
-
-        /* Read the main header of the codestream and if necessary the JP2 boxes*/
-        if (! opj_read_header(l_stream, l_codec, &image)) {
-            fprintf(stderr, "ERROR -> opj_decompress: failed to read the header\n");
-            opj_stream_destroy(l_stream);
-            opj_destroy_codec(l_codec);
-            opj_image_destroy(image);
+        l_status = decompress_image(&parameters, l_stream, cp_reduce,
+                                    parameters.num_threads, &t);
+        opj_stream_destroy(l_stream);
+        if (l_status == DECOMPRESS_FAILED) {
             failed = 1;
             goto fin;
         }
-
-        if (parameters.numcomps) {
-            if (! opj_set_decoded_components(l_codec,
-                                             parameters.numcomps,
-                                             parameters.comps_indices,
-                                             OPJ_FALSE)) {
-                fprintf(stderr,
-                        "ERROR -> opj_decompress: failed to set the component indices!\n");
-                opj_destroy_codec(l_codec);
-                opj_stream_destroy(l_stream);
-                opj_image_destroy(image);
-                failed = 1;
-                goto fin;
-            }
-        }
-
-        if (getenv("USE_OPJ_SET_DECODED_RESOLUTION_FACTOR") != NULL) {
-            /* For debugging/testing purposes, and also an illustration on how to */
-            /* use the alternative API opj_set_decoded_resolution_factor() instead */
-            /* of setting parameters.cp_reduce */
-            if (! opj_set_decoded_resolution_factor(l_codec, cp_reduce)) {
-                fprintf(stderr,
-                        "ERROR -> opj_decompress: failed to set the resolution factor tile!\n");
-                opj_destroy_codec(l_codec);
-                opj_stream_destroy(l_stream);
-                opj_image_destroy(image);
-                failed = 1;
-                goto fin;
-            }
-        }
-
-        if (!parameters.nb_tile_to_decode) {
-            if (getenv("SKIP_OPJ_SET_DECODE_AREA") != NULL &&
-                    parameters.DA_x0 == 0 &&
-                    parameters.DA_y0 == 0 &&
-                    parameters.DA_x1 == 0 &&
-                    parameters.DA_y1 == 0) {
-                /* For debugging/testing purposes, */
-                /* do nothing if SKIP_OPJ_SET_DECODE_AREA env variable */
-                /* is defined and no decoded area has been set */
-            }
-            /* Optional if you want decode the entire image */
-            else if (!opj_set_decode_area(l_codec, image, (OPJ_INT32)parameters.DA_x0,
-                                          (OPJ_INT32)parameters.DA_y0, (OPJ_INT32)parameters.DA_x1,
-                                          (OPJ_INT32)parameters.DA_y1)) {
-                fprintf(stderr, "ERROR -> opj_decompress: failed to set the decoded area\n");
-                opj_stream_destroy(l_stream);
-                opj_destroy_codec(l_codec);
-                opj_image_destroy(image);
-                failed = 1;
-                goto fin;
-            }
-
-            /* Get the decoded image */
-            if (!(opj_decode(l_codec, l_stream, image) &&
-                    opj_end_decompress(l_codec,   l_stream))) {
-                fprintf(stderr, "ERROR -> opj_decompress: failed to decode image!\n");
-                opj_destroy_codec(l_codec);
-                opj_stream_destroy(l_stream);
-                opj_image_destroy(image);
-                failed = 1;
-                goto fin;
-            }
-        } else {
-            if (!(parameters.DA_x0 == 0 &&
-                    parameters.DA_y0 == 0 &&
-                    parameters.DA_x1 == 0 &&
-                    parameters.DA_y1 == 0)) {
-                if (!(parameters.quiet)) {
-                    fprintf(stderr, "WARNING: -d option ignored when used together with -t\n");
-                }
-            }
-
-            if (!opj_get_decoded_tile(l_codec, l_stream, image, parameters.tile_index)) {
-                fprintf(stderr, "ERROR -> opj_decompress: failed to decode tile!\n");
-                opj_destroy_codec(l_codec);
-                opj_stream_destroy(l_stream);
-                opj_image_destroy(image);
-                failed = 1;
-                goto fin;
-            }
-            if (!(parameters.quiet)) {
-                fprintf(stdout, "tile %d is decoded!\n\n", parameters.tile_index);
-            }
-        }
-
-        tCumulative += opj_clock() - t;
-        numDecompressedImages++;
-
-        /* Close the byte stream */
-        opj_stream_destroy(l_stream);
-
-        if (image->color_space != OPJ_CLRSPC_SYCC
-                && image->numcomps == 3 && image->comps[0].dx == image->comps[0].dy
-                && image->comps[1].dx != 1) {
-            image->color_space = OPJ_CLRSPC_SYCC;
-        } else if (image->numcomps <= 2) {
-            image->color_space = OPJ_CLRSPC_GRAY;
-        }
-
-        if (image->color_space == OPJ_CLRSPC_SYCC) {
-            color_sycc_to_rgb(image);
-        } else if ((image->color_space == OPJ_CLRSPC_CMYK) &&
-                   (parameters.cod_format != TIF_DFMT)) {
-            color_cmyk_to_rgb(image);
-        } else if (image->color_space == OPJ_CLRSPC_EYCC) {
-            color_esycc_to_rgb(image);
-        }
-
-        if (image->icc_profile_buf) {
-#if defined(OPJ_HAVE_LIBLCMS1) || defined(OPJ_HAVE_LIBLCMS2)
-            if (image->icc_profile_len) {
-                color_apply_icc_profile(image);
-            } else {
-                color_cielab_to_rgb(image);
-            }
-#endif
-            free(image->icc_profile_buf);
-            image->icc_profile_buf = NULL;
-            image->icc_profile_len = 0;
-        }
-
-        /* Force output precision */
-        /* ---------------------- */
-        if (parameters.precision != NULL) {
-            OPJ_UINT32 compno;
-            for (compno = 0; compno < image->numcomps; ++compno) {
-                OPJ_UINT32 precno = compno;
-                OPJ_UINT32 prec;
-
-                if (precno >= parameters.nb_precision) {
-                    precno = parameters.nb_precision - 1U;
-                }
-
-                prec = parameters.precision[precno].prec;
-                if (prec == 0) {
-                    prec = image->comps[compno].prec;
-                }
-
-                switch (parameters.precision[precno].mode) {
-                case OPJ_PREC_MODE_CLIP:
-                    clip_component(&(image->comps[compno]), prec);
-                    break;
-                case OPJ_PREC_MODE_SCALE:
-                    scale_component(&(image->comps[compno]), prec);
-                    break;
-                default:
-                    break;
-                }
-
-            }
-        }
-
-        /* Upsample components */
-        /* ------------------- */
-        if (parameters.upsample) {
-            image = upsample_image_components(image);
-            if (image == NULL) {
-                fprintf(stderr,
-                        "ERROR -> opj_decompress: failed to upsample image components!\n");
-                opj_destroy_codec(l_codec);
-                failed = 1;
-                goto fin;
-            }
-        }
-
-        /* Force RGB output */
-        /* ---------------- */
-        if (parameters.force_rgb) {
-            switch (image->color_space) {
-            case OPJ_CLRSPC_SRGB:
-                break;
-            case OPJ_CLRSPC_GRAY:
-                image = convert_gray_to_rgb(image);
-                break;
-            default:
-                fprintf(stderr,
-                        "ERROR -> opj_decompress: don't know how to convert image to RGB colorspace!\n");
-                opj_image_destroy(image);
-                image = NULL;
-                break;
-            }
-            if (image == NULL) {
-                fprintf(stderr, "ERROR -> opj_decompress: failed to convert to RGB image!\n");
-                opj_destroy_codec(l_codec);
-                failed = 1;
-                goto fin;
-            }
+        if (l_status != DECOMPRESS_SKIPPED) {
+            tCumulative += t;
+            numDecompressedImages++;
         }
-
-        /* create output image */
-        /* ------------------- */
-        switch (parameters.cod_format) {
-        case PXM_DFMT:          /* PNM PGM PPM */
-            if (imagetopnm(image, parameters.outfile, parameters.split_pnm)) {
-                fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-
-        case PGX_DFMT:          /* PGX */
-            if (imagetopgx(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-
-        case BMP_DFMT:          /* BMP */
-            if (imagetobmp(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-#ifdef OPJ_HAVE_LIBTIFF
-        case TIF_DFMT:          /* TIFF */
-            if (imagetotif(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-#endif /* OPJ_HAVE_LIBTIFF */
-        case RAW_DFMT:          /* RAW */
-            if (imagetoraw(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Error generating raw file. Outfile %s not generated\n",
-                        parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-
-        case RAWL_DFMT:         /* RAWL */
-            if (imagetorawl(image, parameters.outfile)) {
-                fprintf(stderr,
-                        "[ERROR] Error generating rawl file. Outfile %s not generated\n",
-                        parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-
-        case TGA_DFMT:          /* TGA */
-            if (imagetotga(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Error generating tga file. Outfile %s not generated\n",
-                        parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-#ifdef OPJ_HAVE_LIBPNG
-        case PNG_DFMT:          /* PNG */
-            if (imagetopng(image, parameters.outfile)) {
-                fprintf(stderr, "[ERROR] Error generating png file. Outfile %s not generated\n",
-                        parameters.outfile);
-                failed = 1;
-            } else if (!(parameters.quiet)) {
-                fprintf(stdout, "[INFO] Generated Outfile %s\n", parameters.outfile);
-            }
-            break;
-#endif /* OPJ_HAVE_LIBPNG */
-        /* Can happen if output file is TIFF or PNG
-         * and OPJ_HAVE_LIBTIF or OPJ_HAVE_LIBPNG is undefined
-        */
-        default:
-            fprintf(stderr, "[ERROR] Outfile %s not generated\n", parameters.outfile);
+        if (l_status == DECOMPRESS_OUTPUT_FAILED) {
             failed = 1;
         }
-
-        /* free remaining structures */
-        if (l_codec) {
-            opj_destroy_codec(l_codec);
-        }
-
-
-        /* free image data structure */
-        opj_image_destroy(image);
-
-        /* destroy the codestream index */
-        opj_destroy_cstr_index(&cstr_index);
-
-        if (failed) {
-            (void)remove(parameters.outfile);    /* ignore return value */
-        }
     }
 fin:
     destroy_parameters(&parameters);
@@ -1797,6 +2069,9 @@ fin:
         fprintf(stdout, "decode time: %d ms\n",
                 (int)((tCumulative * 1000.0) / (OPJ_FLOAT64)numDecompressedImages));
     }
+    if (!(parameters.quiet)) {
+        opj_print_perf_counters(stdout, 0);
+    }
     return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 /*end main()*/
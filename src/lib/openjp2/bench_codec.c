@@ -0,0 +1,752 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* End-to-end benchmark of the codec through its public API. An image, */
+/* generated or decoded from a file, is encoded to memory and decoded */
+/* back from memory, without any file I/O, for each combination of the */
+/* swept parameters. The timings of each stage and the peak resident */
+/* memory are written as JSON, to be compared between two builds with */
+/* tests/performance/compare_bench_codec.py. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif /* _WIN32 */
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+#define MAX_VALUES 16
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/** List of the values of a swept parameter */
+typedef struct {
+    int values[MAX_VALUES];
+    int count;
+} value_list_t;
+
+/** In-memory stream */
+typedef struct {
+    OPJ_BYTE* data;
+    OPJ_SIZE_T size;
+    OPJ_SIZE_T capacity;
+    OPJ_SIZE_T pos;
+} mem_stream_t;
+
+/** Configuration of the codec */
+typedef struct {
+    int num_threads;
+    /** 0 for a single tile */
+    int tile_size;
+    int cblk_size;
+    OPJ_BOOL irreversible;
+    int layers;
+    /** x0, y0, x1, y1 of the region decoded, or NULL */
+    const int* region;
+} config_t;
+
+/** Timings of a configuration, in milliseconds */
+typedef struct {
+    double encode_ms;
+    double read_header_ms;
+    double decode_ms;
+    double region_decode_ms;
+    OPJ_SIZE_T codestream_bytes;
+} timings_t;
+
+static void usage(void)
+{
+    printf(
+        "bench_codec [-i file.j2k|file.jp2] [-size w h] [-num_comps val]\n");
+    printf(
+        "            [-prec val] [-num_threads list] [-tile_size list]\n");
+    printf(
+        "            [-cblk_size list] [-mode R|I|R,I] [-layers list]\n");
+    printf(
+        "            [-region x0 y0 x1 y1] [-num_iterations val] [-o out.json]\n");
+    printf(
+        "  Lists are comma separated, e.g. -num_threads 1,2,4. A tile size of 0\n");
+    printf(
+        "  encodes a single tile. -i decodes the image to encode from a file,\n");
+    printf(
+        "  instead of generating it.\n");
+    exit(1);
+}
+
+static double wallclock(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return freq.QuadPart ? (double)t.QuadPart / (double)freq.QuadPart : 0;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+#endif
+}
+
+/* Resets the peak resident memory of the process, so that it is measured */
+/* per configuration. Only possible on Linux */
+static OPJ_BOOL reset_peak_rss(void)
+{
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    OPJ_BOOL ret;
+    if (!f) {
+        return OPJ_FALSE;
+    }
+    ret = fputs("5", f) >= 0;
+    ret = (fclose(f) == 0) && ret;
+    return ret;
+#else
+    return OPJ_FALSE;
+#endif
+}
+
+/* Peak resident memory of the process, in kB */
+static long get_peak_rss_kb(void)
+{
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+        fclose(f);
+    }
+    if (kb >= 0) {
+        return kb;
+    }
+#endif
+#ifdef _WIN32
+    return -1;
+#else
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return -1;
+        }
+#ifdef __APPLE__
+        return (long)(usage.ru_maxrss / 1024);
+#else
+        return (long)usage.ru_maxrss;
+#endif
+    }
+#endif
+}
+
+static void parse_list(const char* s, value_list_t* list)
+{
+    list->count = 0;
+    while (list->count < MAX_VALUES) {
+        list->values[list->count++] = atoi(s);
+        s = strchr(s, ',');
+        if (s == NULL) {
+            break;
+        }
+        s ++;
+    }
+}
+
+static OPJ_SIZE_T mem_read(void* p_buffer, OPJ_SIZE_T p_nb_bytes,
+                           void* p_user_data)
+{
+    mem_stream_t* s = (mem_stream_t*)p_user_data;
+    OPJ_SIZE_T n;
+    if (s->pos >= s->size) {
+        return (OPJ_SIZE_T) - 1;
+    }
+    n = s->size - s->pos;
+    if (n > p_nb_bytes) {
+        n = p_nb_bytes;
+    }
+    memcpy(p_buffer, s->data + s->pos, n);
+    s->pos += n;
+    return n;
+}
+
+static OPJ_BOOL mem_reserve(mem_stream_t* s, OPJ_SIZE_T size)
+{
+    if (size > s->capacity) {
+        OPJ_SIZE_T capacity = s->capacity ? s->capacity : 65536;
+        OPJ_BYTE* data;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        data = (OPJ_BYTE*)realloc(s->data, capacity);
+        if (!data) {
+            return OPJ_FALSE;
+        }
+        s->data = data;
+        s->capacity = capacity;
+    }
+    return OPJ_TRUE;
+}
+
+static OPJ_SIZE_T mem_write(void* p_buffer, OPJ_SIZE_T p_nb_bytes,
+                            void* p_user_data)
+{
+    mem_stream_t* s = (mem_stream_t*)p_user_data;
+    if (!mem_reserve(s, s->pos + p_nb_bytes)) {
+        return (OPJ_SIZE_T) - 1;
+    }
+    memcpy(s->data + s->pos, p_buffer, p_nb_bytes);
+    s->pos += p_nb_bytes;
+    if (s->pos > s->size) {
+        s->size = s->pos;
+    }
+    return p_nb_bytes;
+}
+
+static OPJ_OFF_T mem_skip(OPJ_OFF_T p_nb_bytes, void* p_user_data)
+{
+    mem_stream_t* s = (mem_stream_t*)p_user_data;
+    if (p_nb_bytes < 0 && (OPJ_SIZE_T)(-p_nb_bytes) > s->pos) {
+        return -1;
+    }
+    s->pos = (OPJ_SIZE_T)((OPJ_OFF_T)s->pos + p_nb_bytes);
+    return p_nb_bytes;
+}
+
+static OPJ_BOOL mem_seek(OPJ_OFF_T p_nb_bytes, void* p_user_data)
+{
+    mem_stream_t* s = (mem_stream_t*)p_user_data;
+    if (p_nb_bytes < 0 || (OPJ_SIZE_T)p_nb_bytes > s->size) {
+        return OPJ_FALSE;
+    }
+    s->pos = (OPJ_SIZE_T)p_nb_bytes;
+    return OPJ_TRUE;
+}
+
+static opj_stream_t* create_mem_stream(mem_stream_t* s, OPJ_BOOL is_input)
+{
+    opj_stream_t* stream = opj_stream_create(1024 * 1024, is_input);
+    if (!stream) {
+        return NULL;
+    }
+    s->pos = 0;
+    if (is_input) {
+        opj_stream_set_read_function(stream, mem_read);
+        opj_stream_set_user_data_length(stream, s->size);
+    } else {
+        s->size = 0;
+        opj_stream_set_write_function(stream, mem_write);
+    }
+    opj_stream_set_skip_function(stream, mem_skip);
+    opj_stream_set_seek_function(stream, mem_seek);
+    opj_stream_set_user_data(stream, s, NULL);
+    return stream;
+}
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stderr, "[ERROR] %s", msg);
+}
+
+static opj_codec_t* create_decoder(const mem_stream_t* s, int num_threads)
+{
+    /* JP2 signature box, or J2K SOC marker followed by SIZ */
+    OPJ_BOOL jp2 = s->size >= 12 && memcmp(s->data + 4, "jP  ", 4) == 0;
+    opj_dparameters_t parameters;
+    opj_codec_t* codec = opj_create_decompress(jp2 ? OPJ_CODEC_JP2 :
+                         OPJ_CODEC_J2K);
+
+    if (!codec) {
+        return NULL;
+    }
+    opj_set_error_handler(codec, error_callback, NULL);
+    opj_set_default_decoder_parameters(&parameters);
+    if (!opj_setup_decoder(codec, &parameters) ||
+            (opj_has_thread_support() &&
+             !opj_codec_set_threads(codec, num_threads))) {
+        opj_destroy_codec(codec);
+        return NULL;
+    }
+    return codec;
+}
+
+/* Decodes the codestream of s, or the region x0,y0,x1,y1 of it if */
+/* region is set. The image is returned if p_image is not NULL */
+static OPJ_BOOL decode(mem_stream_t* s, int num_threads,
+                       const int* region, double* p_header_ms,
+                       double* p_decode_ms, opj_image_t** p_image)
+{
+    opj_codec_t* codec = create_decoder(s, num_threads);
+    opj_stream_t* stream = create_mem_stream(s, OPJ_TRUE);
+    opj_image_t* image = NULL;
+    OPJ_BOOL ret = OPJ_FALSE;
+    double t0 = wallclock(), t1 = 0;
+
+    if (codec && stream && opj_read_header(stream, codec, &image)) {
+        t1 = wallclock();
+        if ((!region || opj_set_decode_area(codec, image, region[0], region[1],
+                                            region[2], region[3])) &&
+                opj_decode(codec, stream, image) &&
+                opj_end_decompress(codec, stream)) {
+            ret = OPJ_TRUE;
+        }
+    }
+    if (ret) {
+        double t2 = wallclock();
+        if (p_header_ms) {
+            *p_header_ms = (t1 - t0) * 1000.0;
+        }
+        *p_decode_ms = (t2 - t1) * 1000.0;
+    }
+    opj_stream_destroy(stream);
+    opj_destroy_codec(codec);
+    if (ret && p_image) {
+        *p_image = image;
+    } else {
+        opj_image_destroy(image);
+    }
+    return ret;
+}
+
+/* Copies an image. The encoder takes the sample buffers of the image it */
+/* encodes, so each encoding needs its own copy */
+static opj_image_t* clone_image(const opj_image_t* image)
+{
+    opj_image_cmptparm_t* params;
+    opj_image_t* clone;
+    OPJ_UINT32 compno;
+
+    params = (opj_image_cmptparm_t*)calloc(image->numcomps,
+                                           sizeof(opj_image_cmptparm_t));
+    if (!params) {
+        return NULL;
+    }
+    for (compno = 0; compno < image->numcomps; ++compno) {
+        const opj_image_comp_t* comp = &image->comps[compno];
+        params[compno].dx = comp->dx;
+        params[compno].dy = comp->dy;
+        params[compno].w = comp->w;
+        params[compno].h = comp->h;
+        params[compno].x0 = comp->x0;
+        params[compno].y0 = comp->y0;
+        params[compno].prec = comp->prec;
+        params[compno].sgnd = comp->sgnd;
+    }
+    clone = opj_image_create(image->numcomps, params, image->color_space);
+    free(params);
+    if (!clone) {
+        return NULL;
+    }
+    clone->x0 = image->x0;
+    clone->y0 = image->y0;
+    clone->x1 = image->x1;
+    clone->y1 = image->y1;
+    for (compno = 0; compno < image->numcomps; ++compno) {
+        const opj_image_comp_t* comp = &image->comps[compno];
+        memcpy(clone->comps[compno].data, comp->data,
+               (size_t)comp->w * comp->h * sizeof(OPJ_INT32));
+    }
+    return clone;
+}
+
+static OPJ_BOOL encode(const opj_image_t* source, mem_stream_t* s,
+                       const config_t* config, double* p_encode_ms)
+{
+    const int layers = config->layers;
+    const int tile_size = config->tile_size;
+    opj_cparameters_t parameters;
+    opj_codec_t* codec;
+    opj_stream_t* stream;
+    opj_image_t* image = clone_image(source);
+    OPJ_UINT32 min_dim = source->x1 - source->x0;
+    OPJ_BOOL ret = OPJ_FALSE;
+    double t0;
+    int i;
+
+    if (!image) {
+        return OPJ_FALSE;
+    }
+    t0 = wallclock();
+
+    opj_set_default_encoder_parameters(&parameters);
+    parameters.tcp_numlayers = layers;
+    parameters.cp_disto_alloc = 1;
+    /* Compression ratios halving from one layer to the next, the last */
+    /* layer being lossless or of maximum quality */
+    for (i = 0; i < layers; ++i) {
+        parameters.tcp_rates[i] = (float)(5 << (layers - 1 - i));
+    }
+    parameters.tcp_rates[layers - 1] = 0;
+    parameters.irreversible = config->irreversible ? 1 : 0;
+    parameters.tcp_mct = image->numcomps >= 3 ? 1 : 0;
+    parameters.cblockw_init = config->cblk_size;
+    parameters.cblockh_init = config->cblk_size;
+    if (tile_size > 0) {
+        parameters.tile_size_on = OPJ_TRUE;
+        parameters.cp_tdx = tile_size;
+        parameters.cp_tdy = tile_size;
+    }
+    if (image->y1 - image->y0 < min_dim) {
+        min_dim = image->y1 - image->y0;
+    }
+    if (tile_size > 0 && (OPJ_UINT32)tile_size < min_dim) {
+        min_dim = (OPJ_UINT32)tile_size;
+    }
+    while (parameters.numresolution > 1 &&
+            (min_dim >> (parameters.numresolution - 1)) == 0) {
+        parameters.numresolution --;
+    }
+
+    codec = opj_create_compress(OPJ_CODEC_J2K);
+    stream = create_mem_stream(s, OPJ_FALSE);
+    if (codec && stream) {
+        opj_set_error_handler(codec, error_callback, NULL);
+        if (opj_setup_encoder(codec, &parameters, image) &&
+                (!opj_has_thread_support() ||
+                 opj_codec_set_threads(codec, config->num_threads)) &&
+                opj_start_compress(codec, image, stream) &&
+                opj_encode(codec, stream) &&
+                opj_end_compress(codec, stream)) {
+            ret = OPJ_TRUE;
+        }
+    }
+    opj_stream_destroy(stream);
+    opj_destroy_codec(codec);
+    *p_encode_ms = (wallclock() - t0) * 1000.0;
+    opj_image_destroy(image);
+    return ret;
+}
+
+static opj_image_t* generate_image(OPJ_UINT32 width, OPJ_UINT32 height,
+                                   OPJ_UINT32 numcomps, OPJ_UINT32 prec)
+{
+    opj_image_cmptparm_t* params;
+    opj_image_t* image;
+    OPJ_UINT32 compno, x, y;
+    OPJ_UINT32 state = 1;
+
+    params = (opj_image_cmptparm_t*)calloc(numcomps,
+                                           sizeof(opj_image_cmptparm_t));
+    if (!params) {
+        return NULL;
+    }
+    for (compno = 0; compno < numcomps; ++compno) {
+        params[compno].dx = 1;
+        params[compno].dy = 1;
+        params[compno].w = width;
+        params[compno].h = height;
+        params[compno].prec = prec;
+    }
+    image = opj_image_create(numcomps, params,
+                             numcomps >= 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    free(params);
+    if (!image) {
+        return NULL;
+    }
+    image->x1 = width;
+    image->y1 = height;
+    /* Smooth gradients with some noise, closer to natural images than */
+    /* pure noise */
+    for (compno = 0; compno < numcomps; ++compno) {
+        OPJ_INT32* data = image->comps[compno].data;
+        for (y = 0; y < height; ++y) {
+            for (x = 0; x < width; ++x) {
+                OPJ_UINT32 v;
+                state = state * 1103515245U + 12345U;
+                v = (x * (compno + 1) + y * 2) * 256 / (width + height) +
+                    ((state >> 16) & 15);
+                data[y * width + x] = (OPJ_INT32)((v << (prec > 8 ? prec - 8 : 0)) &
+                                                  ((1U << prec) - 1));
+            }
+        }
+    }
+    return image;
+}
+
+static opj_image_t* load_image(const char* filename)
+{
+    mem_stream_t s;
+    FILE* f = fopen(filename, "rb");
+    opj_image_t* image = NULL;
+    double header_ms, decode_ms;
+    size_t n;
+
+    memset(&s, 0, sizeof(s));
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", filename);
+        return NULL;
+    }
+    while (mem_reserve(&s, s.size + 65536) &&
+            (n = fread(s.data + s.size, 1, 65536, f)) > 0) {
+        s.size += n;
+    }
+    fclose(f);
+    if (!decode(&s, 0, NULL, &header_ms, &decode_ms, &image)) {
+        fprintf(stderr, "Cannot decode %s\n", filename);
+    }
+    free(s.data);
+    return image;
+}
+
+/* Benchmarks a configuration, and writes its result as a JSON object */
+static OPJ_BOOL bench_config(FILE* f, const opj_image_t* image,
+                             mem_stream_t* codestream, const config_t* config,
+                             int num_iterations, OPJ_BOOL per_config_rss,
+                             OPJ_BOOL first)
+{
+    timings_t best;
+    int it;
+
+    fprintf(stderr, "num_threads=%d tile_size=%d cblk_size=%d mode=%s "
+            "layers=%d\n", config->num_threads, config->tile_size,
+            config->cblk_size, config->irreversible ? "I" : "R", config->layers);
+    if (per_config_rss) {
+        reset_peak_rss();
+    }
+    memset(&best, 0, sizeof(best));
+    for (it = 0; it < num_iterations; ++it) {
+        timings_t cur;
+        memset(&cur, 0, sizeof(cur));
+        if (!encode(image, codestream, config, &cur.encode_ms) ||
+                !decode(codestream, config->num_threads, NULL,
+                        &cur.read_header_ms, &cur.decode_ms, NULL) ||
+                (config->region &&
+                 !decode(codestream, config->num_threads, config->region, NULL,
+                         &cur.region_decode_ms, NULL))) {
+            fprintf(stderr, "Encoding or decoding failed\n");
+            return OPJ_FALSE;
+        }
+        cur.codestream_bytes = codestream->size;
+        if (it == 0) {
+            best = cur;
+        } else {
+            /* Keep the fastest run of each stage */
+            best.encode_ms = MIN(best.encode_ms, cur.encode_ms);
+            best.read_header_ms = MIN(best.read_header_ms, cur.read_header_ms);
+            best.decode_ms = MIN(best.decode_ms, cur.decode_ms);
+            best.region_decode_ms = MIN(best.region_decode_ms,
+                                        cur.region_decode_ms);
+        }
+    }
+
+    fprintf(f, "%s    {\n", first ? "" : ",\n");
+    fprintf(f, "      \"num_threads\": %d,\n", config->num_threads);
+    fprintf(f, "      \"tile_size\": %d,\n", config->tile_size);
+    fprintf(f, "      \"cblk_size\": %d,\n", config->cblk_size);
+    fprintf(f, "      \"mode\": \"%s\",\n",
+            config->irreversible ? "irreversible" : "reversible");
+    fprintf(f, "      \"layers\": %d,\n", config->layers);
+    if (config->region) {
+        fprintf(f, "      \"region\": [%d, %d, %d, %d],\n", config->region[0],
+                config->region[1], config->region[2], config->region[3]);
+    }
+    fprintf(f, "      \"codestream_bytes\": %lu,\n",
+            (unsigned long)best.codestream_bytes);
+    fprintf(f, "      \"encode_ms\": %.3f,\n", best.encode_ms);
+    fprintf(f, "      \"read_header_ms\": %.3f,\n", best.read_header_ms);
+    fprintf(f, "      \"decode_ms\": %.3f,\n", best.decode_ms);
+    if (config->region) {
+        fprintf(f, "      \"region_decode_ms\": %.3f,\n", best.region_decode_ms);
+    }
+    fprintf(f, "      \"peak_rss_kb\": %ld\n", get_peak_rss_kb());
+    fprintf(f, "    }");
+    return OPJ_TRUE;
+}
+
+int main(int argc, char** argv)
+{
+    const char* input = NULL;
+    const char* output = NULL;
+    OPJ_UINT32 width = 1024, height = 1024, numcomps = 3, prec = 8;
+    value_list_t num_threads, tile_sizes, cblk_sizes, modes, layers;
+    int region[4];
+    OPJ_BOOL has_region = OPJ_FALSE;
+    OPJ_BOOL per_config_rss;
+    int num_iterations = 3;
+    opj_image_t* image;
+    mem_stream_t codestream;
+    FILE* f = stdout;
+    int i, ith, its, icb, imode, ilay;
+    int nb_results = 0;
+    int ret = 0;
+
+    num_threads.count = tile_sizes.count = cblk_sizes.count = 1;
+    num_threads.values[0] = 0;
+    tile_sizes.values[0] = 0;
+    cblk_sizes.values[0] = 64;
+    modes.count = 1;
+    modes.values[0] = 0;
+    layers.count = 1;
+    layers.values[0] = 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-size") == 0 && i + 2 < argc) {
+            width = (OPJ_UINT32)atoi(argv[i + 1]);
+            height = (OPJ_UINT32)atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-num_comps") == 0 && i + 1 < argc) {
+            numcomps = (OPJ_UINT32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-prec") == 0 && i + 1 < argc) {
+            prec = (OPJ_UINT32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-num_threads") == 0 && i + 1 < argc) {
+            parse_list(argv[++i], &num_threads);
+        } else if (strcmp(argv[i], "-tile_size") == 0 && i + 1 < argc) {
+            parse_list(argv[++i], &tile_sizes);
+        } else if (strcmp(argv[i], "-cblk_size") == 0 && i + 1 < argc) {
+            parse_list(argv[++i], &cblk_sizes);
+        } else if (strcmp(argv[i], "-layers") == 0 && i + 1 < argc) {
+            parse_list(argv[++i], &layers);
+        } else if (strcmp(argv[i], "-mode") == 0 && i + 1 < argc) {
+            const char* s = argv[++i];
+            modes.count = 0;
+            while (*s && modes.count < 2) {
+                if (*s == 'R') {
+                    modes.values[modes.count++] = 0;
+                } else if (*s == 'I') {
+                    modes.values[modes.count++] = 1;
+                } else if (*s != ',') {
+                    usage();
+                }
+                s ++;
+            }
+        } else if (strcmp(argv[i], "-region") == 0 && i + 4 < argc) {
+            region[0] = atoi(argv[i + 1]);
+            region[1] = atoi(argv[i + 2]);
+            region[2] = atoi(argv[i + 3]);
+            region[3] = atoi(argv[i + 4]);
+            has_region = OPJ_TRUE;
+            i += 4;
+        } else if (strcmp(argv[i], "-num_iterations") == 0 && i + 1 < argc) {
+            num_iterations = atoi(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+
+    if (width == 0 || height == 0 || numcomps == 0 || numcomps > 16384 ||
+            prec == 0 || prec > 16) {
+        fprintf(stderr, "Invalid image parameters. The number of components "
+                "should be <= 16384 and the precision <= 16\n");
+        exit(1);
+    }
+    for (i = 0; i < cblk_sizes.count; ++i) {
+        const int v = cblk_sizes.values[i];
+        if (v < 4 || v > 64 || (v & (v - 1)) != 0) {
+            fprintf(stderr, "Invalid code-block size. Should be a power of two "
+                    ">= 4 and <= 64\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < layers.count; ++i) {
+        if (layers.values[i] < 1 || layers.values[i] > 10) {
+            fprintf(stderr, "Invalid number of layers. Should be >= 1 and <= 10\n");
+            exit(1);
+        }
+    }
+    if (num_iterations < 1) {
+        num_iterations = 1;
+    }
+
+    image = input ? load_image(input) : generate_image(width, height, numcomps,
+            prec);
+    if (!image) {
+        exit(1);
+    }
+    if (output) {
+        f = fopen(output, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot create %s\n", output);
+            opj_image_destroy(image);
+            exit(1);
+        }
+    }
+    per_config_rss = reset_peak_rss();
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"bench_codec\",\n");
+    fprintf(f, "  \"version\": \"%s\",\n", opj_version());
+    fprintf(f, "  \"image\": { \"source\": \"%s\", \"width\": %u, "
+            "\"height\": %u, \"num_comps\": %u, \"prec\": %u },\n",
+            input ? "file" : "synthetic",
+            image->x1 - image->x0, image->y1 - image->y0, image->numcomps,
+            image->comps[0].prec);
+    fprintf(f, "  \"num_iterations\": %d,\n", num_iterations);
+    fprintf(f, "  \"peak_rss_per_config\": %s,\n",
+            per_config_rss ? "true" : "false");
+    fprintf(f, "  \"results\": [\n");
+
+    memset(&codestream, 0, sizeof(codestream));
+    for (ith = 0; ith < num_threads.count; ++ith) {
+        for (its = 0; its < tile_sizes.count; ++its) {
+            for (icb = 0; icb < cblk_sizes.count; ++icb) {
+                for (imode = 0; imode < modes.count; ++imode) {
+                    for (ilay = 0; ilay < layers.count; ++ilay) {
+                        config_t config;
+                        config.num_threads = num_threads.values[ith];
+                        config.tile_size = tile_sizes.values[its];
+                        config.cblk_size = cblk_sizes.values[icb];
+                        config.irreversible = modes.values[imode] != 0;
+                        config.layers = layers.values[ilay];
+                        config.region = has_region ? region : NULL;
+                        if (!bench_config(f, image, &codestream, &config,
+                                          num_iterations, per_config_rss,
+                                          nb_results == 0)) {
+                            ret = 1;
+                            continue;
+                        }
+                        nb_results ++;
+                    }
+                }
+            }
+        }
+    }
+    fprintf(f, "%s  ]\n}\n", nb_results ? "\n" : "");
+
+    if (f != stdout) {
+        fclose(f);
+    }
+    free(codestream.data);
+    opj_image_destroy(image);
+    return ret;
+}
@@ -264,15 +264,15 @@ int main(int argc, char** argv)
     start_wc = opj_wallclock();
     if (bench_decode) {
         if (irreversible)  {
-            opj_dwt_decode_real(&tcd, &tilec, tilec.numresolutions);
+            opj_dwt_decode_real(&tcd, tcd.thread_pool, &tilec, tilec.numresolutions);
         } else {
-            opj_dwt_decode(&tcd, &tilec, tilec.numresolutions);
+            opj_dwt_decode(&tcd, tcd.thread_pool, &tilec, tilec.numresolutions);
         }
     } else {
         if (irreversible)  {
-            opj_dwt_encode_real(&tcd, &tilec);
+            opj_dwt_encode_real(&tcd, tcd.thread_pool, &tilec);
         } else {
-            opj_dwt_encode(&tcd, &tilec);
+            opj_dwt_encode(&tcd, tcd.thread_pool, &tilec);
         }
     }
     stop = opj_clock();
@@ -305,9 +305,9 @@ int main(int argc, char** argv)
     if ((display || check) && !irreversible) {
 
         if (bench_decode) {
-            opj_dwt_encode(&tcd, &tilec);
+            opj_dwt_encode(&tcd, tcd.thread_pool, &tilec);
         } else {
-            opj_dwt_decode(&tcd, &tilec, tilec.numresolutions);
+            opj_dwt_decode(&tcd, tcd.thread_pool, &tilec, tilec.numresolutions);
         }
 
 
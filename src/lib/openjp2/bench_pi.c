@@ -0,0 +1,491 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the packet iterator. With -check, the packets are also */
+/* enumerated by a reference implementation that walks the tile sample */
+/* position by sample position, as described in B.12.1 of ISO 15444-1, */
+/* and both sequences are compared. */
+
+#include "opj_includes.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/times.h>
+#endif /* _WIN32 */
+
+typedef struct {
+    OPJ_UINT32 layno, resno, compno, precno;
+} packet_t;
+
+typedef struct {
+    packet_t* packets;
+    OPJ_UINT32 count;
+    OPJ_UINT32 size;
+    OPJ_BYTE* include;
+} packet_list_t;
+
+void usage(void)
+{
+    printf(
+        "bench_pi [-size value] [-num_resolutions val] [-num_comps val]\n");
+    printf(
+        "         [-num_layers val] [-precinct_size log2] [-subsampling dx dy]\n");
+    printf(
+        "         [-prog LRCP|RLCP|RPCL|PCRL|CPRL] [-offset x y]\n");
+    printf(
+        "         [-num_iterations val] [-check]\n");
+    exit(1);
+}
+
+OPJ_FLOAT64 opj_clock(void)
+{
+#ifdef _WIN32
+    /* _WIN32: use QueryPerformance (very accurate) */
+    LARGE_INTEGER freq, t ;
+    /* freq is the clock speed of the CPU */
+    QueryPerformanceFrequency(&freq) ;
+    /* t is the high resolution performance counter (see MSDN) */
+    QueryPerformanceCounter(& t) ;
+    return freq.QuadPart ? (t.QuadPart / (OPJ_FLOAT64) freq.QuadPart) : 0 ;
+#else
+    /* Unix or Linux: use resource usage */
+    struct rusage t;
+    OPJ_FLOAT64 procTime;
+    /* (1) Get the rusage data structure at this moment (man getrusage) */
+    getrusage(0, &t);
+    /* (2) What is the elapsed time ? - CPU time = User time + System time */
+    /* (2a) Get the seconds */
+    procTime = (OPJ_FLOAT64)(t.ru_utime.tv_sec + t.ru_stime.tv_sec);
+    /* (2b) More precisely! Get the microseconds part ! */
+    return (procTime + (OPJ_FLOAT64)(t.ru_utime.tv_usec + t.ru_stime.tv_usec) *
+            1e-6) ;
+#endif
+}
+
+static void add_packet(packet_list_t* list, const opj_pi_iterator_t* pi,
+                       OPJ_UINT32 layno, OPJ_UINT32 resno,
+                       OPJ_UINT32 compno, OPJ_UINT32 precno)
+{
+    OPJ_UINT32 index = layno * pi->step_l + resno * pi->step_r +
+                       compno * pi->step_c + precno * pi->step_p;
+    if (list->include) {
+        if (list->include[index]) {
+            return;
+        }
+        list->include[index] = 1;
+    }
+    if (list->count == list->size) {
+        list->size = list->size ? 2 * list->size : 1024;
+        list->packets = (packet_t*)opj_realloc(list->packets,
+                                               list->size * sizeof(packet_t));
+        if (!list->packets) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    list->packets[list->count].layno = layno;
+    list->packets[list->count].resno = resno;
+    list->packets[list->count].compno = compno;
+    list->packets[list->count].precno = precno;
+    list->count ++;
+}
+
+/* Smallest distance between two precinct boundaries over the given */
+/* components, in reference grid units */
+static OPJ_UINT32 ref_step(const opj_pi_iterator_t* pi, OPJ_UINT32 compno0,
+                           OPJ_UINT32 compno1, OPJ_BOOL vertical)
+{
+    OPJ_UINT32 compno, resno, step = 0;
+    for (compno = compno0; compno < compno1; compno++) {
+        const opj_pi_comp_t* comp = &pi->comps[compno];
+        for (resno = 0; resno < comp->numresolutions; resno++) {
+            const opj_pi_resolution_t* res = &comp->resolutions[resno];
+            OPJ_UINT32 sub = vertical ? comp->dy : comp->dx;
+            OPJ_UINT32 shift = (vertical ? res->pdy : res->pdx) +
+                               comp->numresolutions - 1 - resno;
+            if (shift < 32 && sub <= UINT_MAX / (1u << shift)) {
+                OPJ_UINT32 s = sub * (1u << shift);
+                step = !step ? s : opj_uint_min(step, s);
+            }
+        }
+    }
+    return step;
+}
+
+/* Whether a precinct of the given component and resolution starts at */
+/* (x, y), and which one */
+static OPJ_BOOL ref_precinct(const opj_pi_iterator_t* pi, OPJ_UINT32 compno,
+                             OPJ_UINT32 resno, OPJ_UINT32 x, OPJ_UINT32 y,
+                             OPJ_UINT32* precno)
+{
+    const opj_pi_comp_t* comp = &pi->comps[compno];
+    const opj_pi_resolution_t* res;
+    OPJ_UINT32 levelno, trx0, try0, trx1, try1, rpx, rpy;
+
+    if (resno >= comp->numresolutions) {
+        return OPJ_FALSE;
+    }
+    res = &comp->resolutions[resno];
+    levelno = comp->numresolutions - 1 - resno;
+    if (levelno >= 32 ||
+            ((comp->dx << levelno) >> levelno) != comp->dx ||
+            ((comp->dy << levelno) >> levelno) != comp->dy ||
+            (comp->dx << levelno) > INT_MAX ||
+            (comp->dy << levelno) > INT_MAX) {
+        return OPJ_FALSE;
+    }
+    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
+    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
+    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
+    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
+    rpx = res->pdx + levelno;
+    rpy = res->pdy + levelno;
+    if (rpx >= 31 || ((comp->dx << rpx) >> rpx) != comp->dx ||
+            rpy >= 31 || ((comp->dy << rpy) >> rpy) != comp->dy) {
+        return OPJ_FALSE;
+    }
+    if (!((y % (comp->dy << rpy) == 0) || ((y == pi->ty0) &&
+                                          ((try0 << levelno) % (1U << rpy))))) {
+        return OPJ_FALSE;
+    }
+    if (!((x % (comp->dx << rpx) == 0) || ((x == pi->tx0) &&
+                                          ((trx0 << levelno) % (1U << rpx))))) {
+        return OPJ_FALSE;
+    }
+    if (res->pw == 0 || res->ph == 0 || trx0 == trx1 || try0 == try1) {
+        return OPJ_FALSE;
+    }
+    *precno = (opj_uint_floordivpow2(opj_uint_ceildiv(x, (comp->dx << levelno)),
+                                     res->pdx) - opj_uint_floordivpow2(trx0, res->pdx)) +
+              (opj_uint_floordivpow2(opj_uint_ceildiv(y, (comp->dy << levelno)),
+                                     res->pdy) - opj_uint_floordivpow2(try0, res->pdy)) * res->pw;
+    return OPJ_TRUE;
+}
+
+static void ref_enumerate(const opj_pi_iterator_t* pi, packet_list_t* list)
+{
+    const opj_poc_t* poc = &pi->poc;
+    OPJ_UINT32 layno, resno, compno, precno, x, y, dx, dy;
+
+    switch (poc->prg) {
+    case OPJ_LRCP:
+    case OPJ_RLCP: {
+        OPJ_UINT32 a, b;
+        OPJ_BOOL lrcp = poc->prg == OPJ_LRCP;
+        for (a = lrcp ? poc->layno0 : poc->resno0;
+                a < (lrcp ? poc->layno1 : poc->resno1); a++) {
+            for (b = lrcp ? poc->resno0 : poc->layno0;
+                    b < (lrcp ? poc->resno1 : poc->layno1); b++) {
+                layno = lrcp ? a : b;
+                resno = lrcp ? b : a;
+                for (compno = poc->compno0; compno < poc->compno1; compno++) {
+                    const opj_pi_comp_t* comp = &pi->comps[compno];
+                    const opj_pi_resolution_t* res;
+                    if (resno >= comp->numresolutions) {
+                        continue;
+                    }
+                    res = &comp->resolutions[resno];
+                    for (precno = 0; precno < res->pw * res->ph; precno++) {
+                        add_packet(list, pi, layno, resno, compno, precno);
+                    }
+                }
+            }
+        }
+        break;
+    }
+    case OPJ_RPCL:
+        dx = ref_step(pi, 0, pi->numcomps, OPJ_FALSE);
+        dy = ref_step(pi, 0, pi->numcomps, OPJ_TRUE);
+        if (dx == 0 || dy == 0) {
+            break;
+        }
+        for (resno = poc->resno0; resno < poc->resno1; resno++) {
+            for (y = pi->ty0; y < pi->ty1; y += (dy - (y % dy))) {
+                for (x = pi->tx0; x < pi->tx1; x += (dx - (x % dx))) {
+                    for (compno = poc->compno0; compno < poc->compno1; compno++) {
+                        if (!ref_precinct(pi, compno, resno, x, y, &precno)) {
+                            continue;
+                        }
+                        for (layno = poc->layno0; layno < poc->layno1; layno++) {
+                            add_packet(list, pi, layno, resno, compno, precno);
+                        }
+                    }
+                }
+            }
+        }
+        break;
+    case OPJ_PCRL:
+        dx = ref_step(pi, 0, pi->numcomps, OPJ_FALSE);
+        dy = ref_step(pi, 0, pi->numcomps, OPJ_TRUE);
+        if (dx == 0 || dy == 0) {
+            break;
+        }
+        for (y = pi->ty0; y < pi->ty1; y += (dy - (y % dy))) {
+            for (x = pi->tx0; x < pi->tx1; x += (dx - (x % dx))) {
+                for (compno = poc->compno0; compno < poc->compno1; compno++) {
+                    for (resno = poc->resno0; resno < poc->resno1; resno++) {
+                        if (!ref_precinct(pi, compno, resno, x, y, &precno)) {
+                            continue;
+                        }
+                        for (layno = poc->layno0; layno < poc->layno1; layno++) {
+                            add_packet(list, pi, layno, resno, compno, precno);
+                        }
+                    }
+                }
+            }
+        }
+        break;
+    case OPJ_CPRL:
+        for (compno = poc->compno0; compno < poc->compno1; compno++) {
+            dx = ref_step(pi, compno, compno + 1, OPJ_FALSE);
+            dy = ref_step(pi, compno, compno + 1, OPJ_TRUE);
+            if (dx == 0 || dy == 0) {
+                break;
+            }
+            for (y = pi->ty0; y < pi->ty1; y += (dy - (y % dy))) {
+                for (x = pi->tx0; x < pi->tx1; x += (dx - (x % dx))) {
+                    for (resno = poc->resno0; resno < poc->resno1; resno++) {
+                        if (!ref_precinct(pi, compno, resno, x, y, &precno)) {
+                            continue;
+                        }
+                        for (layno = poc->layno0; layno < poc->layno1; layno++) {
+                            add_packet(list, pi, layno, resno, compno, precno);
+                        }
+                    }
+                }
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    opj_image_t image;
+    opj_image_comp_t* comps;
+    opj_cp_t cp;
+    opj_tcp_t tcp;
+    opj_tccp_t* tccps;
+    opj_event_mgr_t event_mgr;
+    opj_pi_iterator_t* pi;
+    packet_list_t list, ref_list;
+    OPJ_UINT32 size = 16384;
+    OPJ_UINT32 num_resolutions = 6;
+    OPJ_UINT32 num_comps = 3;
+    OPJ_UINT32 num_layers = 4;
+    OPJ_UINT32 precinct_size = 4;
+    OPJ_UINT32 subsampling_dx = 1, subsampling_dy = 1;
+    OPJ_UINT32 offset_x = 0, offset_y = 0;
+    OPJ_PROG_ORDER prog = OPJ_RPCL;
+    int num_iterations = 10;
+    OPJ_BOOL check = OPJ_FALSE;
+    OPJ_UINT32 compno, resno;
+    OPJ_FLOAT64 start, stop;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-check") == 0) {
+            check = OPJ_TRUE;
+        } else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+            size = (OPJ_UINT32)atoi(argv[i + 1]);
+            i ++;
+        } else if (strcmp(argv[i], "-num_resolutions") == 0 && i + 1 < argc) {
+            num_resolutions = (OPJ_UINT32)atoi(argv[i + 1]);
+            if (num_resolutions == 0 || num_resolutions > 32) {
+                fprintf(stderr, "Invalid value for num_resolutions\n");
+                exit(1);
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-num_comps") == 0 && i + 1 < argc) {
+            num_comps = (OPJ_UINT32)atoi(argv[i + 1]);
+            if (num_comps == 0) {
+                fprintf(stderr, "Invalid value for num_comps\n");
+                exit(1);
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-num_layers") == 0 && i + 1 < argc) {
+            num_layers = (OPJ_UINT32)atoi(argv[i + 1]);
+            if (num_layers == 0 || num_layers > 65535) {
+                fprintf(stderr, "Invalid value for num_layers\n");
+                exit(1);
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-precinct_size") == 0 && i + 1 < argc) {
+            precinct_size = (OPJ_UINT32)atoi(argv[i + 1]);
+            if (precinct_size == 0 || precinct_size > 15) {
+                fprintf(stderr, "Invalid value for precinct_size\n");
+                exit(1);
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-subsampling") == 0 && i + 2 < argc) {
+            subsampling_dx = (OPJ_UINT32)atoi(argv[i + 1]);
+            subsampling_dy = (OPJ_UINT32)atoi(argv[i + 2]);
+            if (subsampling_dx == 0 || subsampling_dy == 0) {
+                fprintf(stderr, "Invalid value for subsampling\n");
+                exit(1);
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "-offset") == 0 && i + 2 < argc) {
+            offset_x = (OPJ_UINT32)atoi(argv[i + 1]);
+            offset_y = (OPJ_UINT32)atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-prog") == 0 && i + 1 < argc) {
+            int prg;
+            prog = OPJ_PROG_UNKNOWN;
+            for (prg = OPJ_LRCP; prg <= OPJ_CPRL; prg++) {
+                if (strcmp(argv[i + 1],
+                           opj_j2k_convert_progression_order((OPJ_PROG_ORDER)prg)) == 0) {
+                    prog = (OPJ_PROG_ORDER)prg;
+                }
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-num_iterations") == 0 && i + 1 < argc) {
+            num_iterations = atoi(argv[i + 1]);
+            i ++;
+        } else {
+            usage();
+        }
+    }
+    if (prog == OPJ_PROG_UNKNOWN || size == 0) {
+        usage();
+    }
+
+    opj_set_default_event_handler(&event_mgr);
+
+    /* A single tile of size x size samples, the components after the */
+    /* first one being subsampled */
+    memset(&image, 0, sizeof(image));
+    image.x0 = offset_x;
+    image.y0 = offset_y;
+    image.x1 = offset_x + size;
+    image.y1 = offset_y + size;
+    image.numcomps = num_comps;
+    comps = (opj_image_comp_t*)opj_calloc(num_comps, sizeof(opj_image_comp_t));
+    tccps = (opj_tccp_t*)opj_calloc(num_comps, sizeof(opj_tccp_t));
+    if (!comps || !tccps) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    image.comps = comps;
+    for (compno = 0; compno < num_comps; compno++) {
+        comps[compno].dx = compno == 0 ? 1 : subsampling_dx;
+        comps[compno].dy = compno == 0 ? 1 : subsampling_dy;
+        tccps[compno].csty = J2K_CCP_CSTY_PRT;
+        tccps[compno].numresolutions = num_resolutions;
+        for (resno = 0; resno < num_resolutions; resno++) {
+            tccps[compno].prcw[resno] = resno == 0 ? precinct_size :
+                                        precinct_size + 1;
+            tccps[compno].prch[resno] = resno == 0 ? precinct_size :
+                                        precinct_size + 1;
+        }
+    }
+
+    memset(&tcp, 0, sizeof(tcp));
+    tcp.prg = prog;
+    tcp.numlayers = num_layers;
+    tcp.tccps = tccps;
+
+    memset(&cp, 0, sizeof(cp));
+    cp.tdx = offset_x + size;
+    cp.tdy = offset_y + size;
+    cp.tw = 1;
+    cp.th = 1;
+    cp.tcps = &tcp;
+
+    memset(&list, 0, sizeof(list));
+    memset(&ref_list, 0, sizeof(ref_list));
+
+    start = opj_clock();
+    for (i = 0; i < num_iterations; i++) {
+        pi = opj_pi_create_decode(&image, &cp, 0, &event_mgr);
+        if (!pi) {
+            fprintf(stderr, "opj_pi_create_decode() failed\n");
+            exit(1);
+        }
+        list.count = 0;
+        while (opj_pi_next(pi)) {
+            if (check && i == 0) {
+                add_packet(&list, pi, pi->layno, pi->resno, pi->compno,
+                           pi->precno);
+            } else {
+                list.count ++;
+            }
+        }
+        opj_pi_destroy(pi, 1);
+    }
+    stop = opj_clock();
+    printf("time for opj_pi_next: total = %.03f s, %u packets, %.01f ns/packet\n",
+           stop - start, list.count,
+           (stop - start) * 1e9 / ((OPJ_FLOAT64)list.count * num_iterations));
+
+    if (check) {
+        OPJ_UINT32 k;
+
+        pi = opj_pi_create_decode(&image, &cp, 0, &event_mgr);
+        if (!pi) {
+            fprintf(stderr, "opj_pi_create_decode() failed\n");
+            exit(1);
+        }
+        ref_list.include = (OPJ_BYTE*)opj_calloc(pi->include_size, 1);
+        if (!ref_list.include) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        start = opj_clock();
+        ref_enumerate(pi, &ref_list);
+        stop = opj_clock();
+        printf("time for reference: total = %.03f s, %u packets\n",
+               stop - start, ref_list.count);
+        opj_pi_destroy(pi, 1);
+
+        if (list.count != ref_list.count) {
+            printf("Packet count differs: %u vs %u\n", list.count, ref_list.count);
+            exit(1);
+        }
+        for (k = 0; k < list.count; k++) {
+            if (memcmp(&list.packets[k], &ref_list.packets[k], sizeof(packet_t)) != 0) {
+                printf("Difference found at packet %u\n", k);
+                exit(1);
+            }
+        }
+        opj_free(list.packets);
+        opj_free(ref_list.packets);
+        opj_free(ref_list.include);
+    }
+
+    opj_free(comps);
+    opj_free(tccps);
+    return 0;
+}
@@ -0,0 +1,515 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Benchmark of the Tier-1 coding of code-blocks. A band of synthetic */
+/* coefficients is split into code-blocks, which are encoded with */
+/* opj_t1_encode_cblks() and decoded back with opj_t1_decode_cblks(), */
+/* without the rest of the codec. The decoded band is checked to be */
+/* identical to the encoded one. */
+
+#include "opj_includes.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/times.h>
+#endif /* _WIN32 */
+
+#define MAX_THREAD_COUNTS 16
+
+typedef struct {
+    opj_tcd_tilecomp_t tilec;
+    opj_tcd_resolution_t resolutions[2];
+    opj_tcd_precinct_t precinct;
+    opj_tcd_band_t* band;
+    opj_tcd_tile_t tile;
+    opj_tcd_image_t tcd_image;
+    opj_image_comp_t image_comp;
+    opj_image_t image;
+    opj_tcd_t tcd;
+} bench_tile_t;
+
+void usage(void)
+{
+    printf(
+        "bench_t1 [-band LL|HL|LH|HH] [-band_size w h] [-cblk_size w h]\n");
+    printf(
+        "         [-bitdepth val] [-M mode] [-num_threads val[,val...]]\n");
+    printf(
+        "         [-num_iterations val]\n");
+    printf(
+        "  -M: code-block style, as in opj_compress: 1=BYPASS, 2=RESET,\n");
+    printf(
+        "      4=RESTART (TERMALL), 8=VSC, 16=ERTERM (PTERM), 32=SEGMARK (SEGSYM)\n");
+    exit(1);
+}
+
+OPJ_FLOAT64 opj_clock(void)
+{
+#ifdef _WIN32
+    /* _WIN32: use QueryPerformance (very accurate) */
+    LARGE_INTEGER freq, t ;
+    /* freq is the clock speed of the CPU */
+    QueryPerformanceFrequency(&freq) ;
+    /* t is the high resolution performance counter (see MSDN) */
+    QueryPerformanceCounter(& t) ;
+    return freq.QuadPart ? (t.QuadPart / (OPJ_FLOAT64) freq.QuadPart) : 0 ;
+#else
+    /* Unix or Linux: use resource usage */
+    struct rusage t;
+    OPJ_FLOAT64 procTime;
+    /* (1) Get the rusage data structure at this moment (man getrusage) */
+    getrusage(0, &t);
+    /* (2) What is the elapsed time ? - CPU time = User time + System time */
+    /* (2a) Get the seconds */
+    procTime = (OPJ_FLOAT64)(t.ru_utime.tv_sec + t.ru_stime.tv_sec);
+    /* (2b) More precisely! Get the microseconds part ! */
+    return (procTime + (OPJ_FLOAT64)(t.ru_utime.tv_usec + t.ru_stime.tv_usec) *
+            1e-6) ;
+#endif
+}
+
+static OPJ_FLOAT64 opj_wallclock(void)
+{
+#ifdef _WIN32
+    return opj_clock();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (OPJ_FLOAT64)tv.tv_sec + 1e-6 * (OPJ_FLOAT64)tv.tv_usec;
+#endif
+}
+
+static OPJ_UINT32 bench_rand(OPJ_UINT32* state)
+{
+    *state = *state * 1103515245U + 12345U;
+    return *state >> 8;
+}
+
+/* Fills the band with coefficients of about bitdepth bits: a smooth */
+/* signal for the LL band, and a sparse one, where most coefficients */
+/* are small, for the high-pass bands */
+static void fill_band(OPJ_INT32* data, OPJ_UINT32 stride,
+                      OPJ_UINT32 w, OPJ_UINT32 h,
+                      OPJ_UINT32 bandno, OPJ_UINT32 bitdepth)
+{
+    const OPJ_INT32 max_mag = (OPJ_INT32)((1U << (bitdepth - 1)) - 1);
+    OPJ_UINT32 state = 1;
+    OPJ_UINT32 x, y;
+
+    for (y = 0; y < h; ++y) {
+        for (x = 0; x < w; ++x) {
+            OPJ_UINT32 r = bench_rand(&state);
+            OPJ_INT32 val;
+            if (bandno == 0) {
+                val = (OPJ_INT32)(((x + 2 * y) * 13 + (r & 15)) %
+                                  (2U * (OPJ_UINT32)max_mag + 1)) - max_mag;
+            } else {
+                OPJ_INT32 mag = (OPJ_INT32)((r & 0xFFFF) >> (r >> 16) % 16);
+                if (bitdepth < 17) {
+                    mag >>= 17 - bitdepth;
+                } else {
+                    mag <<= bitdepth - 17;
+                }
+                mag = opj_int_min(mag, max_mag);
+                val = (r & 0x10000) ? -mag : mag;
+            }
+            data[y * stride + x] = val;
+        }
+    }
+}
+
+/* Sets up a tile component of two resolutions whose only non empty band */
+/* is band number bandno, of w x h coefficients, in a single precinct */
+static OPJ_BOOL init_tile(bench_tile_t* t, opj_tcp_t* tcp,
+                          opj_thread_pool_t* tp, OPJ_UINT32 bandno,
+                          OPJ_UINT32 w, OPJ_UINT32 h,
+                          OPJ_UINT32 cblk_w, OPJ_UINT32 cblk_h,
+                          OPJ_UINT32 bitdepth, OPJ_BOOL decoder)
+{
+    opj_tcd_resolution_t* res = &t->resolutions[bandno == 0 ? 0 : 1];
+    opj_tcd_precinct_t* prc = &t->precinct;
+    OPJ_UINT32 resno, cblkno;
+
+    memset(t, 0, sizeof(*t));
+    t->tilec.x1 = (OPJ_INT32)(2 * w);
+    t->tilec.y1 = (OPJ_INT32)(2 * h);
+    t->tilec.numresolutions = 2;
+    t->tilec.minimum_num_resolutions = 2;
+    t->tilec.resolutions = t->resolutions;
+    t->tilec.data = (OPJ_INT32*)opj_malloc(sizeof(OPJ_INT32) * 4 * w * h);
+    if (!t->tilec.data) {
+        return OPJ_FALSE;
+    }
+    for (resno = 0; resno < 2; ++resno) {
+        t->resolutions[resno].x1 = (OPJ_INT32)(w << resno);
+        t->resolutions[resno].y1 = (OPJ_INT32)(h << resno);
+        t->resolutions[resno].pw = 1;
+        t->resolutions[resno].ph = 1;
+    }
+
+    res->numbands = 1;
+    t->band = &res->bands[0];
+    t->band->x1 = (OPJ_INT32)w;
+    t->band->y1 = (OPJ_INT32)h;
+    t->band->bandno = bandno;
+    t->band->precincts = prc;
+    t->band->numbps = (OPJ_INT32)bitdepth;
+    t->band->stepsize = 1.0f;
+
+    prc->x1 = (OPJ_INT32)w;
+    prc->y1 = (OPJ_INT32)h;
+    prc->cw = (w + cblk_w - 1) / cblk_w;
+    prc->ch = (h + cblk_h - 1) / cblk_h;
+    prc->cblks.blocks = opj_calloc((size_t)prc->cw * prc->ch,
+                                   decoder ? sizeof(opj_tcd_cblk_dec_t) :
+                                   sizeof(opj_tcd_cblk_enc_t));
+    if (!prc->cblks.blocks) {
+        return OPJ_FALSE;
+    }
+    for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
+        OPJ_INT32 x0 = (OPJ_INT32)((cblkno % prc->cw) * cblk_w);
+        OPJ_INT32 y0 = (OPJ_INT32)((cblkno / prc->cw) * cblk_h);
+        OPJ_INT32 x1 = opj_int_min(x0 + (OPJ_INT32)cblk_w, (OPJ_INT32)w);
+        OPJ_INT32 y1 = opj_int_min(y0 + (OPJ_INT32)cblk_h, (OPJ_INT32)h);
+        if (decoder) {
+            opj_tcd_cblk_dec_t* cblk = &prc->cblks.dec[cblkno];
+            cblk->x0 = x0;
+            cblk->y0 = y0;
+            cblk->x1 = x1;
+            cblk->y1 = y1;
+        } else {
+            opj_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];
+            cblk->x0 = x0;
+            cblk->y0 = y0;
+            cblk->x1 = x1;
+            cblk->y1 = y1;
+            cblk->layers = (opj_tcd_layer_t*)opj_calloc(100, sizeof(opj_tcd_layer_t));
+            cblk->passes = (opj_tcd_pass_t*)opj_calloc(100, sizeof(opj_tcd_pass_t));
+            if (!cblk->layers || !cblk->passes) {
+                return OPJ_FALSE;
+            }
+        }
+    }
+
+    t->tile.x1 = t->tilec.x1;
+    t->tile.y1 = t->tilec.y1;
+    t->tile.numcomps = 1;
+    t->tile.comps = &t->tilec;
+    t->tcd_image.tiles = &t->tile;
+    t->image_comp.dx = 1;
+    t->image_comp.dy = 1;
+    t->image.numcomps = 1;
+    t->image.comps = &t->image_comp;
+    t->tcd.image = &t->image;
+    t->tcd.tcd_image = &t->tcd_image;
+    t->tcd.tcp = tcp;
+    t->tcd.thread_pool = tp;
+    t->tcd.whole_tile_decoding = OPJ_TRUE;
+    t->tcd.win_x1 = (OPJ_UINT32)t->tilec.x1;
+    t->tcd.win_y1 = (OPJ_UINT32)t->tilec.y1;
+    return OPJ_TRUE;
+}
+
+static void free_tile(bench_tile_t* t, OPJ_BOOL decoder)
+{
+    opj_tcd_precinct_t* prc = &t->precinct;
+    OPJ_UINT32 cblkno;
+
+    if (prc->cblks.blocks) {
+        for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
+            if (decoder) {
+                opj_free(prc->cblks.dec[cblkno].segs);
+                opj_free(prc->cblks.dec[cblkno].chunks);
+            } else {
+                opj_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];
+                if (cblk->data) {
+                    opj_free(cblk->data - 1);
+                }
+                opj_free(cblk->layers);
+                opj_free(cblk->passes);
+            }
+        }
+        opj_free(prc->cblks.blocks);
+    }
+    opj_free(t->tilec.data);
+    if (decoder) {
+        opj_t1_destroy_decode_jobs(t->tcd.t1_decode_jobs);
+    }
+}
+
+/* Gives the decoder the code-blocks of the encoder, as Tier-2 would do */
+/* with all their passes in a single layer: one segment per terminated */
+/* pass, and the data of the encoder as a single chunk */
+static OPJ_BOOL transfer_cblks(const bench_tile_t* enc, bench_tile_t* dec,
+                               OPJ_UINT64* p_nb_passes)
+{
+    const opj_tcd_precinct_t* prc = &enc->precinct;
+    OPJ_UINT32 cblkno, passno;
+
+    *p_nb_passes = 0;
+    for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
+        const opj_tcd_cblk_enc_t* cblk_enc = &prc->cblks.enc[cblkno];
+        opj_tcd_cblk_dec_t* cblk_dec = &dec->precinct.cblks.dec[cblkno];
+        OPJ_UINT32 seg_start = 0, seg_rate = 0;
+
+        *p_nb_passes += cblk_enc->totalpasses;
+        cblk_dec->numbps = cblk_enc->numbps;
+        cblk_dec->numsegs = 0;
+        cblk_dec->numchunks = 0;
+        if (cblk_enc->totalpasses == 0) {
+            cblk_dec->real_num_segs = 0;
+            continue;
+        }
+        if (!cblk_dec->segs) {
+            cblk_dec->segs = (opj_tcd_seg_t*)opj_calloc(100, sizeof(opj_tcd_seg_t));
+            cblk_dec->chunks = (opj_tcd_seg_data_chunk_t*)opj_calloc(1,
+                               sizeof(opj_tcd_seg_data_chunk_t));
+            if (!cblk_dec->segs || !cblk_dec->chunks) {
+                return OPJ_FALSE;
+            }
+            cblk_dec->m_current_max_segs = 100;
+            cblk_dec->numchunksalloc = 1;
+        }
+        for (passno = 0; passno < cblk_enc->totalpasses; ++passno) {
+            const opj_tcd_pass_t* pass = &cblk_enc->passes[passno];
+            if (pass->term || passno + 1 == cblk_enc->totalpasses) {
+                opj_tcd_seg_t* seg = &cblk_dec->segs[cblk_dec->numsegs++];
+                seg->len = pass->rate - seg_rate;
+                seg->numpasses = passno + 1 - seg_start;
+                seg->real_num_passes = seg->numpasses;
+                seg->maxpasses = seg->numpasses;
+                seg_start = passno + 1;
+                seg_rate = pass->rate;
+            }
+        }
+        cblk_dec->real_num_segs = cblk_dec->numsegs;
+        cblk_dec->chunks[0].data = cblk_enc->data;
+        cblk_dec->chunks[0].len = seg_rate;
+        cblk_dec->numchunks = 1;
+    }
+    return OPJ_TRUE;
+}
+
+int main(int argc, char** argv)
+{
+    static const char* const band_names[] = { "LL", "HL", "LH", "HH" };
+    int num_threads[MAX_THREAD_COUNTS];
+    int nb_thread_counts = 1;
+    opj_tcp_t tcp;
+    opj_tccp_t tccp;
+    bench_tile_t* enc;
+    bench_tile_t* dec;
+    opj_event_mgr_t event_mgr;
+    OPJ_UINT32 bandno = 1;
+    OPJ_UINT32 band_w = 1024, band_h = 1024;
+    OPJ_UINT32 cblk_w = 64, cblk_h = 64;
+    OPJ_UINT32 bitdepth = 12;
+    OPJ_UINT32 cblksty = 0;
+    OPJ_UINT32 num_iterations = 5;
+    OPJ_UINT32 x, y, iter;
+    OPJ_UINT64 nb_passes = 0;
+    int i, ret = 0;
+
+    num_threads[0] = 1;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-band") == 0 && i + 1 < argc) {
+            for (bandno = 0; bandno < 4; ++bandno) {
+                if (strcmp(argv[i + 1], band_names[bandno]) == 0) {
+                    break;
+                }
+            }
+            if (bandno == 4) {
+                usage();
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-band_size") == 0 && i + 2 < argc) {
+            band_w = (OPJ_UINT32)atoi(argv[i + 1]);
+            band_h = (OPJ_UINT32)atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-cblk_size") == 0 && i + 2 < argc) {
+            cblk_w = (OPJ_UINT32)atoi(argv[i + 1]);
+            cblk_h = (OPJ_UINT32)atoi(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "-bitdepth") == 0 && i + 1 < argc) {
+            bitdepth = (OPJ_UINT32)atoi(argv[i + 1]);
+            i ++;
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            cblksty = (OPJ_UINT32)atoi(argv[i + 1]);
+            i ++;
+        } else if (strcmp(argv[i], "-num_threads") == 0 && i + 1 < argc) {
+            const char* s = argv[i + 1];
+            nb_thread_counts = 0;
+            while (nb_thread_counts < MAX_THREAD_COUNTS) {
+                num_threads[nb_thread_counts++] = atoi(s);
+                s = strchr(s, ',');
+                if (s == NULL) {
+                    break;
+                }
+                s ++;
+            }
+            i ++;
+        } else if (strcmp(argv[i], "-num_iterations") == 0 && i + 1 < argc) {
+            num_iterations = (OPJ_UINT32)atoi(argv[i + 1]);
+            i ++;
+        } else {
+            usage();
+        }
+    }
+
+    if (band_w == 0 || band_h == 0 || band_w > 16384 || band_h > 16384) {
+        fprintf(stderr, "Invalid band size. Should be >= 1 and <= 16384\n");
+        exit(1);
+    }
+    if (cblk_w < 4 || cblk_w > 1024 || cblk_h < 4 || cblk_h > 1024 ||
+            (cblk_w & (cblk_w - 1)) != 0 || (cblk_h & (cblk_h - 1)) != 0 ||
+            cblk_w * cblk_h > 4096) {
+        fprintf(stderr, "Invalid code-block size. Should be powers of two "
+                ">= 4 and <= 1024, with w * h <= 4096\n");
+        exit(1);
+    }
+    if (bitdepth == 0 || bitdepth > 24) {
+        fprintf(stderr, "Invalid value for bitdepth. Should be >= 1 and <= 24\n");
+        exit(1);
+    }
+    if (cblksty > 63) {
+        fprintf(stderr, "Invalid value for -M. Should be >= 0 and <= 63\n");
+        exit(1);
+    }
+    if (num_iterations == 0) {
+        num_iterations = 1;
+    }
+
+    memset(&tccp, 0, sizeof(tccp));
+    tccp.cblksty = cblksty;
+    tccp.qmfbid = 1;
+    tccp.numresolutions = 2;
+    memset(&tcp, 0, sizeof(tcp));
+    tcp.tccps = &tccp;
+    opj_set_default_event_handler(&event_mgr);
+
+    enc = (bench_tile_t*)opj_malloc(sizeof(bench_tile_t));
+    dec = (bench_tile_t*)opj_malloc(sizeof(bench_tile_t));
+    if (!enc || !dec ||
+            !init_tile(enc, &tcp, NULL, bandno, band_w, band_h, cblk_w, cblk_h,
+                       bitdepth, OPJ_FALSE) ||
+            !init_tile(dec, &tcp, NULL, bandno, band_w, band_h, cblk_w, cblk_h,
+                       bitdepth, OPJ_TRUE)) {
+        fprintf(stderr, "Not enough memory\n");
+        exit(1);
+    }
+    x = (bandno & 1) ? band_w : 0;
+    y = (bandno & 2) ? band_h : 0;
+    fill_band(enc->tilec.data + y * 2 * band_w + x, 2 * band_w, band_w, band_h,
+              bandno, bitdepth);
+
+    printf("band %s of %ux%u, code-blocks of %ux%u, bit depth %u, "
+           "cblksty 0x%02x, %u iterations\n",
+           band_names[bandno], band_w, band_h, cblk_w, cblk_h, bitdepth,
+           cblksty, num_iterations);
+
+    for (i = 0; i < nb_thread_counts && ret == 0; ++i) {
+        opj_thread_pool_t* tp = opj_thread_pool_create(num_threads[i]);
+        OPJ_FLOAT64 start, start_wc, enc_time, enc_time_wc, dec_time, dec_time_wc;
+        OPJ_FLOAT64 nb_samples = (OPJ_FLOAT64)band_w * band_h * num_iterations;
+        volatile OPJ_BOOL dec_ret = OPJ_TRUE;
+
+        enc->tcd.thread_pool = tp;
+        dec->tcd.thread_pool = tp;
+
+        start = opj_clock();
+        start_wc = opj_wallclock();
+        for (iter = 0; iter < num_iterations; ++iter) {
+            if (!opj_t1_encode_cblks(&enc->tcd, &enc->tile, &tcp, NULL, 0,
+                                     OPJ_TRUE)) {
+                fprintf(stderr, "opj_t1_encode_cblks() failed\n");
+                ret = 1;
+                break;
+            }
+        }
+        enc_time = opj_clock() - start;
+        enc_time_wc = opj_wallclock() - start_wc;
+
+        if (ret == 0 && !transfer_cblks(enc, dec, &nb_passes)) {
+            fprintf(stderr, "Not enough memory\n");
+            ret = 1;
+        }
+
+        start = opj_clock();
+        start_wc = opj_wallclock();
+        for (iter = 0; iter < num_iterations && ret == 0; ++iter) {
+            opj_t1_decode_cblks(&dec->tcd, &dec_ret, &dec->tilec, &tccp,
+                                &event_mgr, NULL, OPJ_FALSE);
+            opj_t1_run_decode_jobs(&dec->tcd);
+            if (!dec_ret) {
+                fprintf(stderr, "opj_t1_decode_cblks() failed\n");
+                ret = 1;
+            }
+        }
+        dec_time = opj_clock() - start;
+        dec_time_wc = opj_wallclock() - start_wc;
+
+        if (ret == 0) {
+            OPJ_UINT32 j;
+            for (j = 0; j < band_h; ++j) {
+                const OPJ_SIZE_T off = (OPJ_SIZE_T)(y + j) * 2 * band_w + x;
+                if (memcmp(enc->tilec.data + off, dec->tilec.data + off,
+                           band_w * sizeof(OPJ_INT32)) != 0) {
+                    fprintf(stderr, "Decoded band differs from the encoded one "
+                            "at row %u\n", j);
+                    ret = 1;
+                    break;
+                }
+            }
+        }
+        if (ret == 0) {
+            OPJ_FLOAT64 passes = (OPJ_FLOAT64)nb_passes * num_iterations;
+            printf("num_threads=%d: encode: %.0f passes/s, %.2f Msamples/s "
+                   "(total = %.03f s, wallclock = %.03f s)\n",
+                   num_threads[i],
+                   passes / enc_time_wc, nb_samples / enc_time_wc / 1e6,
+                   enc_time, enc_time_wc);
+            printf("num_threads=%d: decode: %.0f passes/s, %.2f Msamples/s "
+                   "(total = %.03f s, wallclock = %.03f s)\n",
+                   num_threads[i],
+                   passes / dec_time_wc, nb_samples / dec_time_wc / 1e6,
+                   dec_time, dec_time_wc);
+        }
+        opj_thread_pool_destroy(tp);
+    }
+
+    free_tile(enc, OPJ_FALSE);
+    free_tile(dec, OPJ_TRUE);
+    opj_free(enc);
+    opj_free(dec);
+    return ret;
+}
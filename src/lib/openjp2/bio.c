@@ -50,23 +50,11 @@ Write a bit
 */
 static void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b);
 /**
-Read a bit
-@param bio BIO handle
-@return Returns the read bit
-*/
-static OPJ_UINT32 opj_bio_getbit(opj_bio_t *bio);
-/**
 Write a byte
 @param bio BIO handle
 @return Returns OPJ_TRUE if successful, returns OPJ_FALSE otherwise
 */
 static OPJ_BOOL opj_bio_byteout(opj_bio_t *bio);
-/**
-Read a byte
-@param bio BIO handle
-@return Returns OPJ_TRUE if successful, returns OPJ_FALSE otherwise
-*/
-static OPJ_BOOL opj_bio_bytein(opj_bio_t *bio);
 
 /*@}*/
 
@@ -89,17 +77,6 @@ static OPJ_BOOL opj_bio_byteout(opj_bio_t *bio)
     return OPJ_TRUE;
 }
 
-static OPJ_BOOL opj_bio_bytein(opj_bio_t *bio)
-{
-    bio->buf = (bio->buf << 8) & 0xffff;
-    bio->ct = bio->buf == 0xff00 ? 7 : 8;
-    if ((OPJ_SIZE_T)bio->bp >= (OPJ_SIZE_T)bio->end) {
-        return OPJ_FALSE;
-    }
-    bio->buf |= *bio->bp++;
-    return OPJ_TRUE;
-}
-
 static void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b)
 {
     if (bio->ct == 0) {
@@ -110,16 +87,6 @@ static void opj_bio_putbit(opj_bio_t *bio, OPJ_UINT32 b)
     bio->buf |= b << bio->ct;
 }
 
-static OPJ_UINT32 opj_bio_getbit(opj_bio_t *bio)
-{
-    if (bio->ct == 0) {
-        opj_bio_bytein(
-            bio); /* MSD: why not check the return value of this function ? */
-    }
-    bio->ct--;
-    return (bio->buf >> bio->ct) & 1;
-}
-
 /*
 ==========================================================
    Bit Input/Output interface
@@ -160,6 +127,8 @@ void opj_bio_init_dec(opj_bio_t *bio, OPJ_BYTE *bp, OPJ_UINT32 len)
     bio->bp = bp;
     bio->buf = 0;
     bio->ct = 0;
+    bio->pad = 0;
+    bio->last = 0;
 }
 
 void opj_bio_write(opj_bio_t *bio, OPJ_UINT32 v, OPJ_UINT32 n)
@@ -172,23 +141,43 @@ void opj_bio_write(opj_bio_t *bio, OPJ_UINT32 v, OPJ_UINT32 n)
     }
 }
 
+void opj_bio_fill(opj_bio_t *bio)
+{
+    /* Whole bytes are added until there are more than 56 bits. A 0xFF byte */
+    /* is followed by a stuffed bit, so only 7 bits of the next byte count */
+    while (bio->ct <= 56U) {
+        OPJ_UINT32 l_nb_bits = (bio->last == 0xff) ? 7U : 8U;
+        OPJ_UINT32 l_byte = 0;
+        if ((OPJ_SIZE_T)bio->bp < (OPJ_SIZE_T)bio->end) {
+            l_byte = *bio->bp++;
+        } else {
+            bio->pad += l_nb_bits;
+        }
+        bio->buf = (bio->buf << l_nb_bits) | (l_byte & ((1U << l_nb_bits) - 1U));
+        bio->ct += l_nb_bits;
+        bio->last = l_byte;
+    }
+}
+
 OPJ_UINT32 opj_bio_read(opj_bio_t *bio, OPJ_UINT32 n)
 {
-    OPJ_INT32 i;
     OPJ_UINT32 v;
 
     assert((n > 0U) /* && (n <= 32U)*/);
 #ifdef OPJ_UBSAN_BUILD
     /* This assert fails for some corrupted images which are gracefully rejected */
     /* Add this assert only for ubsan build. */
-    /* This is the condition for overflow not to occur below which is needed because of OPJ_NOSANITIZE */
     assert(n <= 32U);
 #endif
-    v = 0U;
-    for (i = (OPJ_INT32)n - 1; i >= 0; i--) {
-        v |= opj_bio_getbit(bio) <<
-             i; /* can't overflow, opj_bio_getbit returns 0 or 1 */
+    /* Only the 32 last bits are returned */
+    while (n > 32U) {
+        OPJ_UINT32 l_skip = opj_uint_min(n - 32U, 32U);
+        opj_bio_peek(bio, l_skip);
+        opj_bio_skip(bio, l_skip);
+        n -= l_skip;
     }
+    v = opj_bio_peek(bio, n);
+    opj_bio_skip(bio, n);
     return v;
 }
 
@@ -207,11 +196,41 @@ OPJ_BOOL opj_bio_flush(opj_bio_t *bio)
 
 OPJ_BOOL opj_bio_inalign(opj_bio_t *bio)
 {
-    if ((bio->buf & 0xff) == 0xff) {
-        if (! opj_bio_bytein(bio)) {
-            return OPJ_FALSE;
+    /* A byte counts as read as soon as one of its bits is read: give back */
+    /* the bytes that are still entirely in buf */
+    OPJ_BOOL l_ret = OPJ_TRUE;
+    if (bio->ct >= bio->pad) {
+        OPJ_UINT32 l_left = bio->ct - bio->pad;
+        while ((OPJ_SIZE_T)bio->bp > (OPJ_SIZE_T)bio->start) {
+            OPJ_UINT32 l_nb_bits = ((OPJ_SIZE_T)bio->bp - 1 > (OPJ_SIZE_T)bio->start &&
+                                    bio->bp[-2] == 0xff) ? 7U : 8U;
+            if (l_left < l_nb_bits) {
+                break;
+            }
+            l_left -= l_nb_bits;
+            bio->bp--;
         }
+        bio->last = ((OPJ_SIZE_T)bio->bp > (OPJ_SIZE_T)bio->start) ? bio->bp[-1] : 0;
+        /* Skip the byte holding the stuffed bit that follows a 0xFF byte */
+        if (bio->last == 0xff) {
+            if ((OPJ_SIZE_T)bio->bp >= (OPJ_SIZE_T)bio->end) {
+                l_ret = OPJ_FALSE;
+            } else {
+                bio->last = *bio->bp++;
+            }
+        }
+    } else {
+        /* Bits past the end of the buffer were read */
+        bio->last = 0;
     }
+    bio->buf = 0;
     bio->ct = 0;
-    return OPJ_TRUE;
+    bio->pad = 0;
+    return l_ret;
+}
+
+OPJ_BOOL opj_bio_past_end(const opj_bio_t *bio)
+{
+    /* The padding bits are the last ones put in buf */
+    return bio->ct < bio->pad;
 }
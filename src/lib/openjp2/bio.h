@@ -60,10 +60,15 @@ typedef struct opj_bio {
     OPJ_BYTE *end;
     /** pointer to the present position in the buffer */
     OPJ_BYTE *bp;
-    /** temporary place where each byte is read or written */
-    OPJ_UINT32 buf;
-    /** coder : number of bits free to write. decoder : number of bits read */
+    /** temporary place where each byte is written. The decoder keeps there */
+    /** up to 64 bits, already unstuffed, the next one to read being bit ct - 1 */
+    OPJ_UINT64 buf;
+    /** coder : number of bits free to write. decoder : number of bits left in buf */
     OPJ_UINT32 ct;
+    /** decoder : number of zero bits put in buf past the end of the buffer */
+    OPJ_UINT32 pad;
+    /** decoder : last byte put in buf (0 past the end of the buffer) */
+    OPJ_UINT32 last;
 } opj_bio_t;
 
 /** @name Exported functions */
@@ -114,6 +119,13 @@ Read bits
 */
 OPJ_UINT32 opj_bio_read(opj_bio_t *bio, OPJ_UINT32 n);
 /**
+Refill the bits of the decoder, up to 57 bits at least. Bytes are read
+whole, dropping the stuffed bit that follows each 0xFF byte, and zero bits
+are put in past the end of the buffer.
+@param bio BIO handle
+*/
+void opj_bio_fill(opj_bio_t *bio);
+/**
 Flush bits
 @param bio BIO handle
 @return Returns OPJ_TRUE if successful, returns OPJ_FALSE otherwise
@@ -125,6 +137,50 @@ Passes the ending bits (coming from flushing)
 @return Returns OPJ_TRUE if successful, returns OPJ_FALSE otherwise
 */
 OPJ_BOOL opj_bio_inalign(opj_bio_t *bio);
+/**
+Tells whether bits past the end of the buffer were read
+@param bio BIO handle
+@return Returns OPJ_TRUE if the bits read so far do not fit in the buffer
+*/
+OPJ_BOOL opj_bio_past_end(const opj_bio_t *bio);
+/**
+Read a bit. Same as opj_bio_read(bio, 1), but inlined.
+@param bio BIO handle
+@return Returns the read bit
+*/
+static INLINE OPJ_UINT32 opj_bio_read_bit(opj_bio_t *bio)
+{
+    if (bio->ct == 0) {
+        opj_bio_fill(bio);
+    }
+    bio->ct--;
+    return (OPJ_UINT32)(bio->buf >> bio->ct) & 1U;
+}
+/**
+Get the next bits without consuming them.
+@param bio BIO handle
+@param n Number of bits to get (32 at most)
+@return Returns the bits, the first one being the most significant
+*/
+static INLINE OPJ_UINT32 opj_bio_peek(opj_bio_t *bio, OPJ_UINT32 n)
+{
+    assert(n <= 32U);
+    if (bio->ct < n) {
+        opj_bio_fill(bio);
+    }
+    return (OPJ_UINT32)((bio->buf >> (bio->ct - n)) &
+                        ((((OPJ_UINT64)1U) << n) - 1U));
+}
+/**
+Consume bits previously obtained with opj_bio_peek().
+@param bio BIO handle
+@param n Number of bits to consume
+*/
+static INLINE void opj_bio_skip(opj_bio_t *bio, OPJ_UINT32 n)
+{
+    assert(n <= bio->ct);
+    bio->ct -= n;
+}
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
@@ -89,6 +89,10 @@ typedef struct dwt_local {
 
 #define NB_ELTS_V8  8
 
+/** Minimum number of samples of a job of a DWT pass. Passes over fewer
+    samples than twice this value are done by the calling thread. */
+#define OPJ_DWT_MIN_SAMPLES_PER_JOB 32768
+
 typedef union {
     OPJ_FLOAT32 f[NB_ELTS_V8];
 } opj_v8_t;
@@ -173,6 +177,9 @@ static OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
 static OPJ_UINT32 opj_dwt_max_resolution(opj_tcd_resolution_t* OPJ_RESTRICT r,
         OPJ_UINT32 i);
 
+static OPJ_UINT32 opj_dwt_get_num_jobs(int num_threads, OPJ_UINT32 nb_units,
+                                       OPJ_UINT32 samples_per_unit);
+
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
@@ -1729,7 +1736,8 @@ static INLINE OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
 
     opj_tcd_resolution_t * l_cur_res = 0;
     opj_tcd_resolution_t * l_last_res = 0;
-    const int num_threads = opj_thread_pool_get_thread_count(tp);
+    const int num_threads = tp ? opj_thread_pool_get_thread_count(tp) : 0;
+    OPJ_UINT32 num_jobs;
     OPJ_INT32 * OPJ_RESTRICT tiledp = tilec->data;
 
     w = (OPJ_UINT32)(tilec->x1 - tilec->x0);
@@ -1777,7 +1785,9 @@ static INLINE OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
         dn = (OPJ_INT32)(rh - rh1);
 
         /* Perform vertical pass */
-        if (num_threads <= 1 || rw < 2 * NB_ELTS_V8) {
+        num_jobs = opj_dwt_get_num_jobs(num_threads, rw / NB_ELTS_V8,
+                                        rh * NB_ELTS_V8);
+        if (num_jobs <= 1) {
             for (j = 0; j + NB_ELTS_V8 - 1 < rw; j += NB_ELTS_V8) {
                 p_encode_and_deinterleave_v(tiledp + j,
                                             bj,
@@ -1795,12 +1805,8 @@ static INLINE OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
                                             rw - j);
             }
         }  else {
-            OPJ_UINT32 num_jobs = (OPJ_UINT32)num_threads;
             OPJ_UINT32 step_j;
 
-            if (rw < num_jobs) {
-                num_jobs = rw;
-            }
             step_j = ((rw / num_jobs) / NB_ELTS_V8) * NB_ELTS_V8;
 
             for (j = 0; j < num_jobs; j++) {
@@ -1837,19 +1843,16 @@ static INLINE OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
         dn = (OPJ_INT32)(rw - rw1);
 
         /* Perform horizontal pass */
-        if (num_threads <= 1 || rh <= 1) {
+        num_jobs = opj_dwt_get_num_jobs(num_threads, rh, rw);
+        if (num_jobs <= 1) {
             for (j = 0; j < rh; j++) {
                 OPJ_INT32* OPJ_RESTRICT aj = tiledp + j * w;
                 (*p_encode_and_deinterleave_h_one_row)(aj, bj, rw,
                                                        cas_row == 0 ? OPJ_TRUE : OPJ_FALSE);
             }
         }  else {
-            OPJ_UINT32 num_jobs = (OPJ_UINT32)num_threads;
             OPJ_UINT32 step_j;
 
-            if (rh < num_jobs) {
-                num_jobs = rh;
-            }
             step_j = (rh / num_jobs);
 
             for (j = 0; j < num_jobs; j++) {
@@ -1897,9 +1900,11 @@ static INLINE OPJ_BOOL opj_dwt_encode_procedure(opj_thread_pool_t* tp,
 /* Forward 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
 OPJ_BOOL opj_dwt_encode(opj_tcd_t *p_tcd,
+                        opj_thread_pool_t* tp,
                         opj_tcd_tilecomp_t * tilec)
 {
-    return opj_dwt_encode_procedure(p_tcd->thread_pool, tilec,
+    (void)p_tcd;
+    return opj_dwt_encode_procedure(tp, tilec,
                                     opj_dwt_encode_and_deinterleave_v,
                                     opj_dwt_encode_and_deinterleave_h_one_row);
 }
@@ -1907,11 +1912,11 @@ OPJ_BOOL opj_dwt_encode(opj_tcd_t *p_tcd,
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
-OPJ_BOOL opj_dwt_decode(opj_tcd_t *p_tcd, opj_tcd_tilecomp_t* tilec,
-                        OPJ_UINT32 numres)
+OPJ_BOOL opj_dwt_decode(opj_tcd_t *p_tcd, opj_thread_pool_t* tp,
+                        opj_tcd_tilecomp_t* tilec, OPJ_UINT32 numres)
 {
     if (p_tcd->whole_tile_decoding) {
-        return opj_dwt_decode_tile(p_tcd->thread_pool, tilec, numres);
+        return opj_dwt_decode_tile(tp, tilec, numres);
     } else {
         return opj_dwt_decode_partial_tile(tilec, numres);
     }
@@ -1937,9 +1942,11 @@ OPJ_FLOAT64 opj_dwt_getnorm(OPJ_UINT32 level, OPJ_UINT32 orient)
 /* Forward 9-7 wavelet transform in 2-D. */
 /* </summary>                            */
 OPJ_BOOL opj_dwt_encode_real(opj_tcd_t *p_tcd,
+                             opj_thread_pool_t* tp,
                              opj_tcd_tilecomp_t * tilec)
 {
-    return opj_dwt_encode_procedure(p_tcd->thread_pool, tilec,
+    (void)p_tcd;
+    return opj_dwt_encode_procedure(tp, tilec,
                                     opj_dwt_encode_and_deinterleave_v_real,
                                     opj_dwt_encode_and_deinterleave_h_one_row_real);
 }
@@ -1960,6 +1967,293 @@ OPJ_FLOAT64 opj_dwt_getnorm_real(OPJ_UINT32 level, OPJ_UINT32 orient)
     return opj_dwt_norms_real[orient][level];
 }
 
+/* <summary>                                                        */
+/* Line-based forward wavelet transform.                            */
+/* </summary>                                                       */
+
+/** Number of rows kept in the sliding window of each decomposition level */
+#define OPJ_DWT_LINES_WINDOW 8
+
+/** Maximum number of lifting steps of a wavelet filter */
+#define OPJ_DWT_LINES_MAX_STEPS 4
+
+typedef struct opj_dwt_lines_level {
+    /** Resolution number decomposed by this level */
+    OPJ_UINT32 resno;
+    /** Width and height of the resolution decomposed by this level */
+    OPJ_UINT32 rw;
+    OPJ_UINT32 rh;
+    /** Width of the lower resolution (number of low-pass samples of a row) */
+    OPJ_UINT32 rw1;
+    /** Parity of the first column and of the first row of the resolution */
+    OPJ_UINT32 cas_row;
+    OPJ_UINT32 cas_col;
+    /** OPJ_DWT_LINES_WINDOW rows of the resolution, row n is in slot n % OPJ_DWT_LINES_WINDOW */
+    OPJ_INT32* rows;
+    /** Number of rows received (done[0]) and processed by each lifting step */
+    OPJ_UINT32 done[OPJ_DWT_LINES_MAX_STEPS + 1];
+    /** Number of rows horizontally transformed and sent to the sub-bands */
+    OPJ_UINT32 nb_emitted;
+} opj_dwt_lines_level_t;
+
+struct opj_dwt_lines_encoder {
+    /** OPJ_TRUE for the 5-3 transform, OPJ_FALSE for the 9-7 one */
+    OPJ_BOOL reversible;
+    /** Number of lifting steps of the filter */
+    OPJ_UINT32 nb_steps;
+    /** Number of decomposition levels, levels[0] decomposes the highest resolution */
+    OPJ_UINT32 nb_levels;
+    opj_dwt_lines_level_t* levels;
+    /** Temporary buffer for the horizontal pass */
+    OPJ_INT32* tmp;
+    opj_dwt_band_row_fn band_row_fn;
+    void* user_data;
+};
+
+static OPJ_BOOL opj_dwt_lines_push_row(opj_dwt_lines_encoder_t* p_enc,
+                                       OPJ_UINT32 p_levelno,
+                                       const OPJ_INT32* p_row);
+
+static INLINE OPJ_INT32* opj_dwt_lines_get_row(const opj_dwt_lines_level_t*
+        p_level, OPJ_UINT32 n)
+{
+    return p_level->rows + (OPJ_SIZE_T)(n % OPJ_DWT_LINES_WINDOW) *
+           (OPJ_SIZE_T)p_level->rw;
+}
+
+/** Applies the lifting step p_step (1-based) of the vertical pass on row n */
+static void opj_dwt_lines_lift_row(const opj_dwt_lines_encoder_t* p_enc,
+                                   const opj_dwt_lines_level_t* p_level,
+                                   OPJ_UINT32 p_step,
+                                   OPJ_UINT32 n)
+{
+    /* Symmetric extension at the borders */
+    const OPJ_UINT32 l_prev = (n > 0) ? n - 1 : n + 1;
+    const OPJ_UINT32 l_next = (n + 1 < p_level->rh) ? n + 1 : n - 1;
+    const OPJ_UINT32 l_width = p_level->rw;
+    OPJ_UINT32 i;
+
+    if (p_enc->reversible) {
+        OPJ_INT32* OPJ_RESTRICT row = opj_dwt_lines_get_row(p_level, n);
+        const OPJ_INT32* OPJ_RESTRICT prev = opj_dwt_lines_get_row(p_level, l_prev);
+        const OPJ_INT32* OPJ_RESTRICT next = opj_dwt_lines_get_row(p_level, l_next);
+        if (p_step == 1) {
+            for (i = 0; i < l_width; ++i) {
+                row[i] -= (prev[i] + next[i]) >> 1;
+            }
+        } else {
+            for (i = 0; i < l_width; ++i) {
+                row[i] += (prev[i] + next[i] + 2) >> 2;
+            }
+        }
+    } else {
+        OPJ_FLOAT32* OPJ_RESTRICT row = (OPJ_FLOAT32*)opj_dwt_lines_get_row(p_level,
+                                        n);
+        const OPJ_FLOAT32* OPJ_RESTRICT prev = (const OPJ_FLOAT32*)
+                                               opj_dwt_lines_get_row(p_level, l_prev);
+        const OPJ_FLOAT32* OPJ_RESTRICT next = (const OPJ_FLOAT32*)
+                                               opj_dwt_lines_get_row(p_level, l_next);
+        const OPJ_FLOAT32 c = (p_step == 1) ? opj_dwt_alpha :
+                              (p_step == 2) ? opj_dwt_beta :
+                              (p_step == 3) ? opj_dwt_gamma : opj_dwt_delta;
+        for (i = 0; i < l_width; ++i) {
+            row[i] += (prev[i] + next[i]) * c;
+        }
+    }
+}
+
+/** Finishes the vertical pass of row n, performs its horizontal pass and */
+/** dispatches its low-pass and high-pass parts. */
+static OPJ_BOOL opj_dwt_lines_emit_row(opj_dwt_lines_encoder_t* p_enc,
+                                       OPJ_UINT32 p_levelno,
+                                       OPJ_UINT32 n)
+{
+    const opj_dwt_lines_level_t* l_level = &p_enc->levels[p_levelno];
+    OPJ_INT32* row = opj_dwt_lines_get_row(l_level, n);
+    const OPJ_BOOL l_is_low = ((l_level->cas_col + n) & 1U) == 0;
+    OPJ_UINT32 i;
+
+    if (l_level->rh == 1) {
+        /* Same as the vertical pass of opj_dwt_encode() for a single row */
+        if (p_enc->reversible && !l_is_low) {
+            for (i = 0; i < l_level->rw; ++i) {
+                row[i] *= 2;
+            }
+        }
+    } else if (!p_enc->reversible) {
+        OPJ_FLOAT32* OPJ_RESTRICT rowf = (OPJ_FLOAT32*)row;
+        const OPJ_FLOAT32 c = l_is_low ? opj_invK : opj_K;
+        for (i = 0; i < l_level->rw; ++i) {
+            rowf[i] *= c;
+        }
+    }
+
+    if (l_level->rw > 0) {
+        if (p_enc->reversible) {
+            opj_dwt_encode_and_deinterleave_h_one_row(row, p_enc->tmp, l_level->rw,
+                    l_level->cas_row == 0 ? OPJ_TRUE : OPJ_FALSE);
+        } else {
+            opj_dwt_encode_and_deinterleave_h_one_row_real(row, p_enc->tmp,
+                    l_level->rw, l_level->cas_row == 0 ? OPJ_TRUE : OPJ_FALSE);
+        }
+    }
+
+    if (l_is_low) {
+        /* HL band, then LL to the next level */
+        if (! p_enc->band_row_fn(p_enc->user_data, l_level->resno, 0,
+                                 row + l_level->rw1)) {
+            return OPJ_FALSE;
+        }
+        if (p_levelno + 1 < p_enc->nb_levels) {
+            return opj_dwt_lines_push_row(p_enc, p_levelno + 1, row);
+        }
+        return p_enc->band_row_fn(p_enc->user_data, l_level->resno - 1, 0, row);
+    }
+    /* LH and HH bands */
+    return p_enc->band_row_fn(p_enc->user_data, l_level->resno, 1, row) &&
+           p_enc->band_row_fn(p_enc->user_data, l_level->resno, 2,
+                              row + l_level->rw1);
+}
+
+/** Adds a row to a decomposition level, and performs all the lifting steps */
+/** and horizontal passes that it makes possible. */
+static OPJ_BOOL opj_dwt_lines_push_row(opj_dwt_lines_encoder_t* p_enc,
+                                       OPJ_UINT32 p_levelno,
+                                       const OPJ_INT32* p_row)
+{
+    opj_dwt_lines_level_t* l_level = &p_enc->levels[p_levelno];
+    const OPJ_UINT32 l_nb_steps = p_enc->nb_steps;
+    OPJ_UINT32 l_step, l_end, n;
+
+    if (l_level->done[0] == l_level->rh) {
+        return OPJ_FALSE;
+    }
+    assert(l_level->done[0] - l_level->nb_emitted < OPJ_DWT_LINES_WINDOW);
+    memcpy(opj_dwt_lines_get_row(l_level, l_level->done[0]), p_row,
+           (OPJ_SIZE_T)l_level->rw * sizeof(OPJ_INT32));
+    l_level->done[0] ++;
+
+    if (l_level->rh > 1) {
+        for (l_step = 1; l_step <= l_nb_steps; ++l_step) {
+            /* Odd steps update the high-pass rows, even steps the low-pass */
+            /* ones. A row can be updated once its next neighbour has been */
+            /* processed by the previous step. */
+            const OPJ_UINT32 l_parity = (l_step & 1U) ^ l_level->cas_col;
+            const OPJ_UINT32 l_prev_done = l_level->done[l_step - 1];
+            l_end = (l_prev_done == l_level->rh) ? l_prev_done :
+                    (l_prev_done > 0) ? l_prev_done - 1 : 0;
+            for (n = l_level->done[l_step]; n < l_end; ++n) {
+                if ((n & 1U) == l_parity) {
+                    opj_dwt_lines_lift_row(p_enc, l_level, l_step, n);
+                }
+            }
+            if (l_end > l_level->done[l_step]) {
+                l_level->done[l_step] = l_end;
+            }
+        }
+    } else {
+        l_level->done[l_nb_steps] = l_level->done[0];
+    }
+
+    /* A row is final once its next neighbour went through all the steps */
+    l_end = l_level->done[l_nb_steps];
+    if (l_end < l_level->rh) {
+        l_end = (l_end > 0) ? l_end - 1 : 0;
+    }
+    while (l_level->nb_emitted < l_end) {
+        if (! opj_dwt_lines_emit_row(p_enc, p_levelno, l_level->nb_emitted)) {
+            return OPJ_FALSE;
+        }
+        l_level->nb_emitted ++;
+    }
+    return OPJ_TRUE;
+}
+
+opj_dwt_lines_encoder_t* opj_dwt_lines_encoder_create(
+    const opj_tcd_tilecomp_t * tilec,
+    OPJ_BOOL reversible,
+    opj_dwt_band_row_fn p_band_row_fn,
+    void* p_user_data)
+{
+    opj_dwt_lines_encoder_t* l_enc;
+    OPJ_UINT32 l_levelno;
+    OPJ_UINT32 l_max_width = 1;
+
+    l_enc = (opj_dwt_lines_encoder_t*) opj_calloc(1,
+            sizeof(opj_dwt_lines_encoder_t));
+    if (!l_enc) {
+        return NULL;
+    }
+    l_enc->reversible = reversible;
+    l_enc->nb_steps = reversible ? 2 : 4;
+    l_enc->band_row_fn = p_band_row_fn;
+    l_enc->user_data = p_user_data;
+    l_enc->nb_levels = tilec->numresolutions - 1;
+    if (l_enc->nb_levels > 0) {
+        l_enc->levels = (opj_dwt_lines_level_t*) opj_calloc(l_enc->nb_levels,
+                        sizeof(opj_dwt_lines_level_t));
+        if (!l_enc->levels) {
+            opj_dwt_lines_encoder_destroy(l_enc);
+            return NULL;
+        }
+    }
+
+    for (l_levelno = 0; l_levelno < l_enc->nb_levels; ++l_levelno) {
+        opj_dwt_lines_level_t* l_level = &l_enc->levels[l_levelno];
+        const OPJ_UINT32 l_resno = tilec->numresolutions - 1 - l_levelno;
+        const opj_tcd_resolution_t* l_cur_res = &tilec->resolutions[l_resno];
+        const opj_tcd_resolution_t* l_last_res = l_cur_res - 1;
+
+        l_level->resno = l_resno;
+        l_level->rw = (OPJ_UINT32)(l_cur_res->x1 - l_cur_res->x0);
+        l_level->rh = (OPJ_UINT32)(l_cur_res->y1 - l_cur_res->y0);
+        l_level->rw1 = (OPJ_UINT32)(l_last_res->x1 - l_last_res->x0);
+        l_level->cas_row = (OPJ_UINT32)(l_cur_res->x0 & 1);
+        l_level->cas_col = (OPJ_UINT32)(l_cur_res->y0 & 1);
+        l_max_width = opj_uint_max(l_max_width, l_level->rw);
+
+        l_level->rows = (OPJ_INT32*) opj_malloc(OPJ_DWT_LINES_WINDOW *
+                                                (OPJ_SIZE_T)opj_uint_max(l_level->rw, 1) * sizeof(OPJ_INT32));
+        if (!l_level->rows) {
+            opj_dwt_lines_encoder_destroy(l_enc);
+            return NULL;
+        }
+    }
+
+    l_enc->tmp = (OPJ_INT32*) opj_aligned_32_malloc((OPJ_SIZE_T)l_max_width *
+                 sizeof(OPJ_INT32));
+    if (!l_enc->tmp) {
+        opj_dwt_lines_encoder_destroy(l_enc);
+        return NULL;
+    }
+    return l_enc;
+}
+
+OPJ_BOOL opj_dwt_lines_encoder_push_row(opj_dwt_lines_encoder_t* p_enc,
+                                        const OPJ_INT32* p_row)
+{
+    if (p_enc->nb_levels == 0) {
+        return p_enc->band_row_fn(p_enc->user_data, 0, 0, p_row);
+    }
+    return opj_dwt_lines_push_row(p_enc, 0, p_row);
+}
+
+void opj_dwt_lines_encoder_destroy(opj_dwt_lines_encoder_t* p_enc)
+{
+    OPJ_UINT32 l_levelno;
+    if (!p_enc) {
+        return;
+    }
+    if (p_enc->levels) {
+        for (l_levelno = 0; l_levelno < p_enc->nb_levels; ++l_levelno) {
+            opj_free(p_enc->levels[l_levelno].rows);
+        }
+        opj_free(p_enc->levels);
+    }
+    opj_aligned_free(p_enc->tmp);
+    opj_free(p_enc);
+}
+
 void opj_dwt_calc_explicit_stepsizes(opj_tccp_t * tccp, OPJ_UINT32 prec)
 {
     OPJ_UINT32 numbands, bandno;
@@ -2004,6 +2298,30 @@ static OPJ_UINT32 opj_dwt_max_resolution(opj_tcd_resolution_t* OPJ_RESTRICT r,
     return mr ;
 }
 
+/* <summary>                                                       */
+/* Number of jobs to split a DWT pass over nb_units rows/columns   */
+/* into, so that each job has at least OPJ_DWT_MIN_SAMPLES_PER_JOB */
+/* samples. A result of 0 or 1 means the pass must not be split.   */
+/* </summary>                                                      */
+static OPJ_UINT32 opj_dwt_get_num_jobs(int num_threads, OPJ_UINT32 nb_units,
+                                       OPJ_UINT32 samples_per_unit)
+{
+    OPJ_UINT64 nb_samples = (OPJ_UINT64)nb_units * samples_per_unit;
+    OPJ_UINT32 num_jobs;
+
+    if (num_threads <= 1) {
+        return 1;
+    }
+    num_jobs = (OPJ_UINT32)num_threads;
+    if (nb_samples / OPJ_DWT_MIN_SAMPLES_PER_JOB < num_jobs) {
+        num_jobs = (OPJ_UINT32)(nb_samples / OPJ_DWT_MIN_SAMPLES_PER_JOB);
+    }
+    if (nb_units < num_jobs) {
+        num_jobs = nb_units;
+    }
+    return num_jobs;
+}
+
 typedef struct {
     opj_dwt_t h;
     OPJ_UINT32 rw;
@@ -2079,11 +2397,12 @@ static OPJ_BOOL opj_dwt_decode_tile(opj_thread_pool_t* tp,
                                 tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
     OPJ_SIZE_T h_mem_size;
     int num_threads;
+    OPJ_UINT32 num_jobs;
 
     if (numres == 1U) {
         return OPJ_TRUE;
     }
-    num_threads = opj_thread_pool_get_thread_count(tp);
+    num_threads = tp ? opj_thread_pool_get_thread_count(tp) : 0;
     h_mem_size = opj_dwt_max_resolution(tr, numres);
     /* overflow check */
     if (h_mem_size > (SIZE_MAX / PARALLEL_COLS_53 / sizeof(OPJ_INT32))) {
@@ -2116,17 +2435,14 @@ static OPJ_BOOL opj_dwt_decode_tile(opj_thread_pool_t* tp,
         h.dn = (OPJ_INT32)(rw - (OPJ_UINT32)h.sn);
         h.cas = tr->x0 % 2;
 
-        if (num_threads <= 1 || rh <= 1) {
+        num_jobs = opj_dwt_get_num_jobs(num_threads, rh, rw);
+        if (num_jobs <= 1) {
             for (j = 0; j < rh; ++j) {
                 opj_idwt53_h(&h, &tiledp[(OPJ_SIZE_T)j * w]);
             }
         } else {
-            OPJ_UINT32 num_jobs = (OPJ_UINT32)num_threads;
             OPJ_UINT32 step_j;
 
-            if (rh < num_jobs) {
-                num_jobs = rh;
-            }
             step_j = (rh / num_jobs);
 
             for (j = 0; j < num_jobs; j++) {
@@ -2167,7 +2483,8 @@ static OPJ_BOOL opj_dwt_decode_tile(opj_thread_pool_t* tp,
         v.dn = (OPJ_INT32)(rh - (OPJ_UINT32)v.sn);
         v.cas = tr->y0 % 2;
 
-        if (num_threads <= 1 || rw <= 1) {
+        num_jobs = opj_dwt_get_num_jobs(num_threads, rw, rh);
+        if (num_jobs <= 1) {
             for (j = 0; j + PARALLEL_COLS_53 <= rw;
                     j += PARALLEL_COLS_53) {
                 opj_idwt53_v(&v, &tiledp[j], (OPJ_SIZE_T)w, PARALLEL_COLS_53);
@@ -2176,12 +2493,8 @@ static OPJ_BOOL opj_dwt_decode_tile(opj_thread_pool_t* tp,
                 opj_idwt53_v(&v, &tiledp[j], (OPJ_SIZE_T)w, (OPJ_INT32)(rw - j));
             }
         } else {
-            OPJ_UINT32 num_jobs = (OPJ_UINT32)num_threads;
             OPJ_UINT32 step_j;
 
-            if (rw < num_jobs) {
-                num_jobs = rw;
-            }
             step_j = (rw / num_jobs);
 
             for (j = 0; j < num_jobs; j++) {
@@ -2558,7 +2871,8 @@ static opj_sparse_array_int32_t* opj_dwt_init_sparse_array(
     OPJ_UINT32 h = (OPJ_UINT32)(tr_max->y1 - tr_max->y0);
     OPJ_UINT32 resno, bandno, precno, cblkno;
     opj_sparse_array_int32_t* sa = opj_sparse_array_int32_create(
-                                       w, h, opj_uint_min(w, 64), opj_uint_min(h, 64));
+                                       w, h, opj_uint_min(w, OPJ_DWT_SPARSE_ARRAY_BLOCK_SIZE),
+                                       opj_uint_min(h, OPJ_DWT_SPARSE_ARRAY_BLOCK_SIZE));
     if (sa == NULL) {
         return NULL;
     }
@@ -2615,7 +2929,7 @@ static OPJ_BOOL opj_dwt_decode_partial_tile(
     OPJ_UINT32 resno;
     /* This value matches the maximum left/right extension given in tables */
     /* F.2 and F.3 of the standard. */
-    const OPJ_UINT32 filter_width = 2U;
+    const OPJ_UINT32 filter_width = OPJ_DWT_FILTER_WIDTH_53;
 
     opj_tcd_resolution_t* tr = tilec->resolutions;
     opj_tcd_resolution_t* tr_max = &(tilec->resolutions[numres - 1]);
@@ -3306,7 +3620,8 @@ OPJ_BOOL opj_dwt_decode_tile_97(opj_thread_pool_t* tp,
                                 tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
 
     OPJ_SIZE_T l_data_size;
-    const int num_threads = opj_thread_pool_get_thread_count(tp);
+    const int num_threads = tp ? opj_thread_pool_get_thread_count(tp) : 0;
+    OPJ_UINT32 num_jobs;
 
     if (numres == 1) {
         return OPJ_TRUE;
@@ -3347,7 +3662,9 @@ OPJ_BOOL opj_dwt_decode_tile_97(opj_thread_pool_t* tp,
         h.win_h_x0 = 0;
         h.win_h_x1 = (OPJ_UINT32)h.dn;
 
-        if (num_threads <= 1 || rh < 2 * NB_ELTS_V8) {
+        num_jobs = opj_dwt_get_num_jobs(num_threads, rh / NB_ELTS_V8,
+                                        rw * NB_ELTS_V8);
+        if (num_jobs <= 1) {
             for (j = 0; j + (NB_ELTS_V8 - 1) < rh; j += NB_ELTS_V8) {
                 OPJ_UINT32 k;
                 opj_v8dwt_interleave_h(&h, aj, w, NB_ELTS_V8);
@@ -3370,12 +3687,8 @@ OPJ_BOOL opj_dwt_decode_tile_97(opj_thread_pool_t* tp,
                 aj += w * NB_ELTS_V8;
             }
         } else {
-            OPJ_UINT32 num_jobs = (OPJ_UINT32)num_threads;
             OPJ_UINT32 step_j;
 
-            if ((rh / NB_ELTS_V8) < num_jobs) {
-                num_jobs = rh / NB_ELTS_V8;
-            }
             step_j = ((rh / num_jobs) / NB_ELTS_V8) * NB_ELTS_V8;
             for (j = 0; j < num_jobs; j++) {
                 opj_dwt97_decode_h_job_t* job;
@@ -3432,7 +3745,14 @@ OPJ_BOOL opj_dwt_decode_tile_97(opj_thread_pool_t* tp,
         v.win_h_x1 = (OPJ_UINT32)v.dn;
 
         aj = (OPJ_FLOAT32*) tilec->data;
-        if (num_threads <= 1 || rw < 2 * NB_ELTS_V8) {
+        /* "bench_dwt -I" shows that scaling is poor, likely due to RAM
+            transfer being the limiting factor. So limit the number of
+            threads.
+         */
+        num_jobs = opj_dwt_get_num_jobs(num_threads <= 1 ? 1 :
+                                        (int)opj_uint_max((OPJ_UINT32)num_threads / 2, 2U),
+                                        rw / NB_ELTS_V8, rh * NB_ELTS_V8);
+        if (num_jobs <= 1) {
             for (j = rw; j > (NB_ELTS_V8 - 1); j -= NB_ELTS_V8) {
                 OPJ_UINT32 k;
 
@@ -3445,16 +3765,8 @@ OPJ_BOOL opj_dwt_decode_tile_97(opj_thread_pool_t* tp,
                 aj += NB_ELTS_V8;
             }
         } else {
-            /* "bench_dwt -I" shows that scaling is poor, likely due to RAM
-                transfer being the limiting factor. So limit the number of
-                threads.
-             */
-            OPJ_UINT32 num_jobs = opj_uint_max((OPJ_UINT32)num_threads / 2, 2U);
             OPJ_UINT32 step_j;
 
-            if ((rw / NB_ELTS_V8) < num_jobs) {
-                num_jobs = rw / NB_ELTS_V8;
-            }
             step_j = ((rw / num_jobs) / NB_ELTS_V8) * NB_ELTS_V8;
             for (j = 0; j < num_jobs; j++) {
                 opj_dwt97_decode_v_job_t* job;
@@ -3520,7 +3832,7 @@ OPJ_BOOL opj_dwt_decode_partial_97(opj_tcd_tilecomp_t* OPJ_RESTRICT tilec,
     /* This value matches the maximum left/right extension given in tables */
     /* F.2 and F.3 of the standard. Note: in opj_tcd_is_subband_area_of_interest() */
     /* we currently use 3. */
-    const OPJ_UINT32 filter_width = 4U;
+    const OPJ_UINT32 filter_width = OPJ_DWT_FILTER_WIDTH_97;
 
     opj_tcd_resolution_t* tr = tilec->resolutions;
     opj_tcd_resolution_t* tr_max = &(tilec->resolutions[numres - 1]);
@@ -3745,11 +4057,12 @@ OPJ_BOOL opj_dwt_decode_partial_97(opj_tcd_tilecomp_t* OPJ_RESTRICT tilec,
 
 
 OPJ_BOOL opj_dwt_decode_real(opj_tcd_t *p_tcd,
+                             opj_thread_pool_t* tp,
                              opj_tcd_tilecomp_t* OPJ_RESTRICT tilec,
                              OPJ_UINT32 numres)
 {
     if (p_tcd->whole_tile_decoding) {
-        return opj_dwt_decode_tile_97(p_tcd->thread_pool, tilec, numres);
+        return opj_dwt_decode_tile_97(tp, tilec, numres);
     } else {
         return opj_dwt_decode_partial_97(tilec, numres);
     }
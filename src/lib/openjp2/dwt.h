@@ -49,6 +49,13 @@ DWT.C are used by some function in TCD.C.
 /** @defgroup DWT DWT - Implementation of a discrete wavelet transform */
 /*@{*/
 
+/** Width and height of the blocks of the sparse array of the partial inverse transform */
+#define OPJ_DWT_SPARSE_ARRAY_BLOCK_SIZE 64U
+/** Samples a window of the partial inverse 5-3 transform is grown by on each side */
+#define OPJ_DWT_FILTER_WIDTH_53 2U
+/** Samples a window of the partial inverse 9-7 transform is grown by on each side */
+#define OPJ_DWT_FILTER_WIDTH_97 4U
+
 
 /** @name Exported functions */
 /*@{*/
@@ -57,19 +64,23 @@ DWT.C are used by some function in TCD.C.
 Forward 5-3 wavelet transform in 2-D.
 Apply a reversible DWT transform to a component of an image.
 @param p_tcd TCD handle
+@param tp Thread pool over which the passes are split, or NULL to run them in the calling thread
 @param tilec Tile component information (current tile)
 */
 OPJ_BOOL opj_dwt_encode(opj_tcd_t *p_tcd,
+                        opj_thread_pool_t* tp,
                         opj_tcd_tilecomp_t * tilec);
 
 /**
 Inverse 5-3 wavelet transform in 2-D.
 Apply a reversible inverse DWT transform to a component of an image.
 @param p_tcd TCD handle
+@param tp Thread pool over which the passes are split, or NULL to run them in the calling thread
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decode
 */
 OPJ_BOOL opj_dwt_decode(opj_tcd_t *p_tcd,
+                        opj_thread_pool_t* tp,
                         opj_tcd_tilecomp_t* tilec,
                         OPJ_UINT32 numres);
 
@@ -84,18 +95,22 @@ OPJ_FLOAT64 opj_dwt_getnorm(OPJ_UINT32 level, OPJ_UINT32 orient);
 Forward 9-7 wavelet transform in 2-D.
 Apply an irreversible DWT transform to a component of an image.
 @param p_tcd TCD handle
+@param tp Thread pool over which the passes are split, or NULL to run them in the calling thread
 @param tilec Tile component information (current tile)
 */
 OPJ_BOOL opj_dwt_encode_real(opj_tcd_t *p_tcd,
+                             opj_thread_pool_t* tp,
                              opj_tcd_tilecomp_t * tilec);
 /**
 Inverse 9-7 wavelet transform in 2-D.
 Apply an irreversible inverse DWT transform to a component of an image.
 @param p_tcd TCD handle
+@param tp Thread pool over which the passes are split, or NULL to run them in the calling thread
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decode
 */
 OPJ_BOOL opj_dwt_decode_real(opj_tcd_t *p_tcd,
+                             opj_thread_pool_t* tp,
                              opj_tcd_tilecomp_t* OPJ_RESTRICT tilec,
                              OPJ_UINT32 numres);
 
@@ -112,6 +127,57 @@ Explicit calculation of the Quantization Stepsizes
 @param prec Precint analyzed
 */
 void opj_dwt_calc_explicit_stepsizes(opj_tccp_t * tccp, OPJ_UINT32 prec);
+
+/**
+Callback receiving the rows of a sub-band computed by the line-based forward
+wavelet transform. The rows of a given sub-band are received in increasing
+order.
+@param user_data User data given to opj_dwt_lines_encoder_create()
+@param resno Resolution number of the sub-band
+@param bandno Index of the sub-band in its resolution (0 for LL at resolution 0, 0 to 2 for HL, LH and HH otherwise)
+@param row Row of the sub-band (values are OPJ_FLOAT32 for the 9-7 transform)
+@return OPJ_FALSE to abort the transform
+*/
+typedef OPJ_BOOL(*opj_dwt_band_row_fn)(void *user_data,
+                                       OPJ_UINT32 resno,
+                                       OPJ_UINT32 bandno,
+                                       const OPJ_INT32 *row);
+
+/** Line-based forward wavelet transform of a tile component */
+typedef struct opj_dwt_lines_encoder opj_dwt_lines_encoder_t;
+
+/**
+Creates a line-based forward wavelet transform of a tile component.
+Contrary to opj_dwt_encode() / opj_dwt_encode_real(), it does not need the
+whole tile component: rows are pushed one at a time, and each decomposition
+level only keeps a small sliding window of rows. The sub-band coefficients are
+identical to the ones of the whole tile transform.
+@param tilec Tile component information (current tile). Its data is not used.
+@param reversible OPJ_TRUE for the 5-3 transform, OPJ_FALSE for the 9-7 one
+@param p_band_row_fn Callback receiving the sub-band rows
+@param p_user_data User data given to p_band_row_fn
+@return the transform, or NULL in case of memory allocation failure
+*/
+opj_dwt_lines_encoder_t* opj_dwt_lines_encoder_create(
+    const opj_tcd_tilecomp_t * tilec,
+    OPJ_BOOL reversible,
+    opj_dwt_band_row_fn p_band_row_fn,
+    void* p_user_data);
+
+/**
+Pushes the next row of the tile component to a line-based forward wavelet transform.
+@param p_enc Line-based transform
+@param p_row Row of the tile component (values are OPJ_FLOAT32 for the 9-7 transform)
+@return OPJ_FALSE if there are too many rows or if the callback failed
+*/
+OPJ_BOOL opj_dwt_lines_encoder_push_row(opj_dwt_lines_encoder_t* p_enc,
+                                        const OPJ_INT32* p_row);
+
+/**
+Destroys a line-based forward wavelet transform.
+@param p_enc Line-based transform (may be NULL)
+*/
+void opj_dwt_lines_encoder_destroy(opj_dwt_lines_encoder_t* p_enc);
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
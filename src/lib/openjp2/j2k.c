@@ -146,6 +146,14 @@ static OPJ_BOOL opj_j2k_create_tcd(opj_j2k_t *p_j2k,
                                    opj_stream_private_t *p_stream,
                                    opj_event_mgr_t * p_manager);
 
+/**
+ * Checks whether two images have the same origin, size, number of components,
+ * sub-sampling, precision and signedness, so that a compressor set up for
+ * one can be reused for the other.
+ */
+static OPJ_BOOL opj_j2k_is_same_image_geometry(const opj_image_t *p_image1,
+        const opj_image_t *p_image2);
+
 /**
  * Excutes the given procedures on the given codec.
  *
@@ -173,18 +181,47 @@ static OPJ_BOOL opj_j2k_update_rates(opj_j2k_t *p_j2k,
                                      opj_event_mgr_t * p_manager);
 
 /**
- * Copies the decoding tile parameters onto all the tile parameters.
- * Creates also the tile decoder.
+ * Creates the tile decoder, once the main header has been read.
  */
-static OPJ_BOOL opj_j2k_copy_default_tcp_and_create_tcd(opj_j2k_t * p_j2k,
+static OPJ_BOOL opj_j2k_create_decoder_tcd(opj_j2k_t * p_j2k,
         opj_stream_private_t *p_stream,
         opj_event_mgr_t * p_manager);
 
 /**
- * Destroys the memory associated with the decoding of headers.
+ * Sets the coding parameters of a tile from the default ones, the first time
+ * a SOT marker of the tile is read. The tile-component parameters, the MCT/MCC
+ * records and the MCT decoding matrix are shared with the default parameters
+ * until opj_j2k_unshare_tile_tcp() is called.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_tcp           the (zeroed) coding parameters of the tile.
  */
-static OPJ_BOOL opj_j2k_destroy_header_memory(opj_j2k_t * p_j2k,
-        opj_stream_private_t *p_stream,
+static void opj_j2k_init_tile_tcp(opj_j2k_t * p_j2k, opj_tcp_t * p_tcp);
+
+/**
+ * Gives a tile its own copy of the parameters it shares with the default ones.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_tcp           the coding parameters of the tile.
+ * @param       p_manager       the user event manager.
+ *
+ * @return      OPJ_FALSE in case of memory allocation failure.
+ */
+static OPJ_BOOL opj_j2k_unshare_tile_tcp(opj_j2k_t * p_j2k,
+        opj_tcp_t * p_tcp,
+        opj_event_mgr_t * p_manager);
+
+/**
+ * Returns the coding parameters modified by a marker of the header being
+ * read: the default ones in the main header, or those of the current tile,
+ * made private to it, in a tile-part header.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_manager       the user event manager.
+ *
+ * @return      the coding parameters, or NULL in case of memory allocation failure.
+ */
+static opj_tcp_t * opj_j2k_get_tcp_to_update(opj_j2k_t * p_j2k,
         opj_event_mgr_t * p_manager);
 
 /**
@@ -2053,7 +2090,6 @@ static OPJ_BOOL opj_j2k_read_siz(opj_j2k_t *p_j2k,
     opj_image_t *l_image = 00;
     opj_cp_t *l_cp = 00;
     opj_image_comp_t * l_img_comp = 00;
-    opj_tcp_t * l_current_tile_param = 00;
 
     /* preconditions */
     assert(p_j2k != 00);
@@ -2378,6 +2414,9 @@ static OPJ_BOOL opj_j2k_read_siz(opj_j2k_t *p_j2k,
 #endif /* USE_JPWL */
 
     /* memory allocations */
+    /* The parameters of a tile are only set from the default ones when one */
+    /* of its SOT markers is read (see opj_j2k_init_tile_tcp()), so the */
+    /* entries of tiles that are never reached are never touched. */
     l_cp->tcps = (opj_tcp_t*) opj_calloc(l_nb_tiles, sizeof(opj_tcp_t));
     if (l_cp->tcps == 00) {
         opj_event_msg(p_manager, EVT_ERROR,
@@ -2439,19 +2478,6 @@ static OPJ_BOOL opj_j2k_read_siz(opj_j2k_t *p_j2k,
         }
     }
 
-    l_current_tile_param = l_cp->tcps;
-    for (i = 0; i < l_nb_tiles; ++i) {
-        l_current_tile_param->tccps = (opj_tccp_t*) opj_calloc(l_image->numcomps,
-                                      sizeof(opj_tccp_t));
-        if (l_current_tile_param->tccps == 00) {
-            opj_event_msg(p_manager, EVT_ERROR,
-                          "Not enough memory to take in charge SIZ marker\n");
-            return OPJ_FALSE;
-        }
-
-        ++l_current_tile_param;
-    }
-
     p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_MH;
     opj_image_comp_header_update(l_image, l_cp);
 
@@ -2647,9 +2673,10 @@ static OPJ_BOOL opj_j2k_read_cod(opj_j2k_t *p_j2k,
     l_cp = &(p_j2k->m_cp);
 
     /* If we are in the first tile-part header of the current tile */
-    l_tcp = (p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH) ?
-            &l_cp->tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
 #if 0
     /* This check was added per https://github.com/uclouvain/openjpeg/commit/daed8cc9195555e101ab708a501af2dfe6d5e001 */
@@ -2908,7 +2935,6 @@ static OPJ_BOOL opj_j2k_read_coc(opj_j2k_t *p_j2k,
                                  opj_event_mgr_t * p_manager
                                 )
 {
-    opj_cp_t *l_cp = NULL;
     opj_tcp_t *l_tcp = NULL;
     opj_image_t *l_image = NULL;
     OPJ_UINT32 l_comp_room;
@@ -2919,11 +2945,10 @@ static OPJ_BOOL opj_j2k_read_coc(opj_j2k_t *p_j2k,
     assert(p_j2k != 00);
     assert(p_manager != 00);
 
-    l_cp = &(p_j2k->m_cp);
-    l_tcp = (p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH)
-            ?
-            &l_cp->tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
     l_image = p_j2k->m_private_image;
 
     l_comp_room = l_image->numcomps <= 256 ? 1 : 2;
@@ -3611,6 +3636,22 @@ static OPJ_BOOL opj_j2k_read_crg(opj_j2k_t *p_j2k,
     return OPJ_TRUE;
 }
 
+/**
+ * Forgets the tile lengths read from TLM markers, which are inconsistent
+ * with the codestream.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_manager               the user event manager.
+*/
+static void opj_j2k_ignore_tlm(opj_j2k_t *p_j2k, opj_event_mgr_t * p_manager)
+{
+    opj_event_msg(p_manager, EVT_WARNING,
+                  "Invalid TLM marker, tile lengths ignored\n");
+    opj_free(p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths);
+    p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths = 00;
+    p_j2k->m_specific_param.m_decoder.m_tlm_invalid = 1;
+}
+
 /**
  * Reads a TLM marker (Tile Length Marker)
  *
@@ -3626,14 +3667,12 @@ static OPJ_BOOL opj_j2k_read_tlm(opj_j2k_t *p_j2k,
                                 )
 {
     OPJ_UINT32 l_Ztlm, l_Stlm, l_ST, l_SP, l_tot_num_tp_remaining, l_quotient,
-               l_Ptlm_size;
+               l_Ptlm_size, l_tot_num_tp, l_nb_tiles, l_Ttlm_i, l_Ptlm_i, i;
     /* preconditions */
     assert(p_header_data != 00);
     assert(p_j2k != 00);
     assert(p_manager != 00);
 
-    OPJ_UNUSED(p_j2k);
-
     if (p_header_size < 2) {
         opj_event_msg(p_manager, EVT_ERROR, "Error reading TLM marker\n");
         return OPJ_FALSE;
@@ -3659,16 +3698,44 @@ static OPJ_BOOL opj_j2k_read_tlm(opj_j2k_t *p_j2k,
         opj_event_msg(p_manager, EVT_ERROR, "Error reading TLM marker\n");
         return OPJ_FALSE;
     }
-    /* FIXME Do not care of this at the moment since only local variables are set here */
-    /*
-    for
-            (i = 0; i < l_tot_num_tp; ++i)
-    {
-            opj_read_bytes(p_header_data,&l_Ttlm_i,l_ST);                           // Ttlm_i
+
+    /* Only the total length of each tile is kept, to estimate the amount */
+    /* of data read by a decode. Unusable markers are ignored, as they were */
+    /* before, since the tile-parts are located through the SOT markers */
+    if (p_j2k->m_specific_param.m_decoder.m_tlm_invalid) {
+        return OPJ_TRUE;
+    }
+    l_nb_tiles = p_j2k->m_cp.tw * p_j2k->m_cp.th;
+    if (l_ST == 3 || l_nb_tiles == 0) {
+        opj_j2k_ignore_tlm(p_j2k, p_manager);
+        return OPJ_TRUE;
+    }
+    if (p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths == 00) {
+        p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths =
+            (OPJ_UINT64*)opj_calloc(l_nb_tiles, sizeof(OPJ_UINT64));
+        if (p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths == 00) {
+            opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to read TLM marker\n");
+            return OPJ_FALSE;
+        }
+    }
+    l_tot_num_tp = p_header_size / l_quotient;
+    for (i = 0; i < l_tot_num_tp; ++i) {
+        if (l_ST == 0) {
+            /* Implicit tile numbers: one tile-part per tile, in order */
+            l_Ttlm_i = p_j2k->m_specific_param.m_decoder.m_tlm_nb_tile_parts;
+        } else {
+            opj_read_bytes(p_header_data, &l_Ttlm_i, l_ST);  /* Ttlm_i */
             p_header_data += l_ST;
-            opj_read_bytes(p_header_data,&l_Ptlm_i,l_Ptlm_size);            // Ptlm_i
-            p_header_data += l_Ptlm_size;
-    }*/
+        }
+        opj_read_bytes(p_header_data, &l_Ptlm_i, l_Ptlm_size); /* Ptlm_i */
+        p_header_data += l_Ptlm_size;
+        if (l_Ttlm_i >= l_nb_tiles) {
+            opj_j2k_ignore_tlm(p_j2k, p_manager);
+            return OPJ_TRUE;
+        }
+        p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths[l_Ttlm_i] += l_Ptlm_i;
+        ++p_j2k->m_specific_param.m_decoder.m_tlm_nb_tile_parts;
+    }
     return OPJ_TRUE;
 }
 
@@ -3760,13 +3827,14 @@ static OPJ_BOOL opj_j2k_read_plt(opj_j2k_t *p_j2k,
                                 )
 {
     OPJ_UINT32 l_Zplt, l_tmp, l_packet_len = 0, i;
+    opj_tcp_t *l_tcp;
 
     /* preconditions */
     assert(p_header_data != 00);
     assert(p_j2k != 00);
     assert(p_manager != 00);
 
-    OPJ_UNUSED(p_j2k);
+    l_tcp = &(p_j2k->m_cp.tcps[p_j2k->m_current_tile_number]);
 
     if (p_header_size < 1) {
         opj_event_msg(p_manager, EVT_ERROR, "Error reading PLT marker\n");
@@ -3783,9 +3851,34 @@ static OPJ_BOOL opj_j2k_read_plt(opj_j2k_t *p_j2k,
         /* take only the last seven bytes */
         l_packet_len |= (l_tmp & 0x7f);
         if (l_tmp & 0x80) {
+            if (l_packet_len > (UINT_MAX >> 7)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Error reading PLT marker\n");
+                return OPJ_FALSE;
+            }
             l_packet_len <<= 7;
         } else {
-            /* store packet length and proceed to next packet */
+            /* store packet length and proceed to next packet. The lengths */
+            /* allow opj_t2_decode_packets() to locate the packets without */
+            /* decoding the headers of the previous ones */
+            if (l_tcp->m_nb_packet_lengths == l_tcp->m_nb_max_packet_lengths) {
+                OPJ_UINT32 *l_new_lengths;
+                OPJ_UINT32 l_new_max = l_tcp->m_nb_max_packet_lengths * 2 + 64;
+
+                if (l_new_max > UINT_MAX / sizeof(OPJ_UINT32)) {
+                    opj_event_msg(p_manager, EVT_ERROR, "Too many packet lengths\n");
+                    return OPJ_FALSE;
+                }
+                l_new_lengths = (OPJ_UINT32 *) opj_realloc(l_tcp->m_packet_lengths,
+                                l_new_max * sizeof(OPJ_UINT32));
+                if (! l_new_lengths) {
+                    opj_event_msg(p_manager, EVT_ERROR,
+                                  "Not enough memory to read PLT marker\n");
+                    return OPJ_FALSE;
+                }
+                l_tcp->m_packet_lengths = l_new_lengths;
+                l_tcp->m_nb_max_packet_lengths = l_new_max;
+            }
+            l_tcp->m_packet_lengths[l_tcp->m_nb_packet_lengths++] = l_packet_len;
             l_packet_len = 0;
         }
     }
@@ -4350,6 +4443,9 @@ static OPJ_BOOL opj_j2k_read_sot(opj_j2k_t *p_j2k,
     }
 
     l_tcp = &l_cp->tcps[p_j2k->m_current_tile_number];
+    if (! l_tcp->initialized) {
+        opj_j2k_init_tile_tcp(p_j2k, l_tcp);
+    }
     l_tile_x = p_j2k->m_current_tile_number % l_cp->tw;
     l_tile_y = p_j2k->m_current_tile_number / l_cp->tw;
 
@@ -4906,9 +5002,17 @@ static OPJ_BOOL opj_j2k_read_sod(opj_j2k_t *p_j2k,
         /* Check enough bytes left in stream before allocation */
         if ((OPJ_OFF_T)p_j2k->m_specific_param.m_decoder.m_sot_length >
                 opj_stream_get_number_byte_left(p_stream)) {
-            opj_event_msg(p_manager, EVT_ERROR,
-                          "Tile part length size inconsistent with stream length\n");
-            return OPJ_FALSE;
+            if (! p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                opj_event_msg(p_manager, EVT_ERROR,
+                              "Tile part length size inconsistent with stream length\n");
+                return OPJ_FALSE;
+            }
+            /* Non strict mode: decode the data of the truncated tile-part */
+            opj_event_msg(p_manager, EVT_WARNING,
+                          "Tile part length size inconsistent with stream length, "
+                          "the codestream is truncated\n");
+            p_j2k->m_specific_param.m_decoder.m_sot_length = (OPJ_UINT32)
+                    opj_stream_get_number_byte_left(p_stream);
         }
         if (p_j2k->m_specific_param.m_decoder.m_sot_length >
                 UINT_MAX - OPJ_COMMON_CBLK_DATA_EXTRA) {
@@ -5118,7 +5222,6 @@ static OPJ_BOOL opj_j2k_read_rgn(opj_j2k_t *p_j2k,
     OPJ_UINT32 l_nb_comp;
     opj_image_t * l_image = 00;
 
-    opj_cp_t *l_cp = 00;
     opj_tcp_t *l_tcp = 00;
     OPJ_UINT32 l_comp_room, l_comp_no, l_roi_sty;
 
@@ -5141,10 +5244,10 @@ static OPJ_BOOL opj_j2k_read_rgn(opj_j2k_t *p_j2k,
         return OPJ_FALSE;
     }
 
-    l_cp = &(p_j2k->m_cp);
-    l_tcp = (p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH) ?
-            &l_cp->tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     opj_read_bytes(p_header_data, &l_comp_no, l_comp_room);         /* Crgn */
     p_header_data += l_comp_room;
@@ -5223,6 +5326,32 @@ static OPJ_BOOL opj_j2k_update_rates(opj_j2k_t *p_j2k,
     l_image = p_j2k->m_private_image;
     l_tcp = l_cp->tcps;
 
+    /* The rates are converted in place below: save them on the first */
+    /* compression, and restore them on the following ones */
+    l_rates = p_j2k->m_specific_param.m_encoder.m_setup_rates;
+    if (l_rates == 00) {
+        OPJ_SIZE_T l_nb_rates = 0;
+        for (i = 0; i < l_cp->th * l_cp->tw; ++i) {
+            l_nb_rates += l_tcp[i].numlayers;
+        }
+        l_rates = (OPJ_FLOAT32*) opj_malloc(opj_uint_max(1U,
+                                            (OPJ_UINT32)l_nb_rates) * sizeof(OPJ_FLOAT32));
+        if (l_rates == 00) {
+            opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to save rates\n");
+            return OPJ_FALSE;
+        }
+        p_j2k->m_specific_param.m_encoder.m_setup_rates = l_rates;
+        for (i = 0; i < l_cp->th * l_cp->tw; ++i) {
+            memcpy(l_rates, l_tcp[i].rates, l_tcp[i].numlayers * sizeof(OPJ_FLOAT32));
+            l_rates += l_tcp[i].numlayers;
+        }
+    } else {
+        for (i = 0; i < l_cp->th * l_cp->tw; ++i) {
+            memcpy(l_tcp[i].rates, l_rates, l_tcp[i].numlayers * sizeof(OPJ_FLOAT32));
+            l_rates += l_tcp[i].numlayers;
+        }
+    }
+
     l_bits_empty = 8 * l_image->comps->dx * l_image->comps->dy;
     l_size_pixel = l_image->numcomps * l_image->comps->prec;
     l_sot_remove = (OPJ_FLOAT32) opj_stream_tell(p_stream) / (OPJ_FLOAT32)(
@@ -5344,9 +5473,16 @@ static OPJ_BOOL opj_j2k_update_rates(opj_j2k_t *p_j2k,
         l_tile_size = UINT_MAX;
     }
 
+    if (p_j2k->m_specific_param.m_encoder.m_encoded_tile_data != 00 &&
+            p_j2k->m_specific_param.m_encoder.m_encoded_tile_size != (OPJ_UINT32)l_tile_size) {
+        opj_free(p_j2k->m_specific_param.m_encoder.m_encoded_tile_data);
+        p_j2k->m_specific_param.m_encoder.m_encoded_tile_data = 00;
+    }
     p_j2k->m_specific_param.m_encoder.m_encoded_tile_size = (OPJ_UINT32)l_tile_size;
-    p_j2k->m_specific_param.m_encoder.m_encoded_tile_data =
-        (OPJ_BYTE *) opj_malloc(p_j2k->m_specific_param.m_encoder.m_encoded_tile_size);
+    if (p_j2k->m_specific_param.m_encoder.m_encoded_tile_data == 00) {
+        p_j2k->m_specific_param.m_encoder.m_encoded_tile_data =
+            (OPJ_BYTE *) opj_malloc(p_j2k->m_specific_param.m_encoder.m_encoded_tile_size);
+    }
     if (p_j2k->m_specific_param.m_encoder.m_encoded_tile_data == 00) {
         opj_event_msg(p_manager, EVT_ERROR,
                       "Not enough memory to allocate m_encoded_tile_data. %u MB required\n",
@@ -5754,9 +5890,10 @@ static OPJ_BOOL opj_j2k_read_mct(opj_j2k_t *p_j2k,
     assert(p_header_data != 00);
     assert(p_j2k != 00);
 
-    l_tcp = p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH ?
-            &p_j2k->m_cp.tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     if (p_header_size < 2) {
         opj_event_msg(p_manager, EVT_ERROR, "Error reading MCT marker\n");
@@ -6007,9 +6144,10 @@ static OPJ_BOOL opj_j2k_read_mcc(opj_j2k_t *p_j2k,
     assert(p_j2k != 00);
     assert(p_manager != 00);
 
-    l_tcp = p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH ?
-            &p_j2k->m_cp.tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     if (p_header_size < 2) {
         opj_event_msg(p_manager, EVT_ERROR, "Error reading MCC marker\n");
@@ -6308,9 +6446,10 @@ static OPJ_BOOL opj_j2k_read_mco(opj_j2k_t *p_j2k,
     assert(p_manager != 00);
 
     l_image = p_j2k->m_private_image;
-    l_tcp = p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH ?
-            &p_j2k->m_cp.tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     if (p_header_size < 1) {
         opj_event_msg(p_manager, EVT_ERROR, "Error reading MCO marker\n");
@@ -6573,6 +6712,8 @@ void opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters)
     if (j2k && parameters) {
         j2k->m_cp.m_specific_param.m_dec.m_layer = parameters->cp_layer;
         j2k->m_cp.m_specific_param.m_dec.m_reduce = parameters->cp_reduce;
+        j2k->m_cp.m_specific_param.m_dec.m_progressive_refinement =
+            (parameters->flags & OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG) != 0;
 
         j2k->dump_state = (parameters->flags & OPJ_DPARAMETERS_DUMP_FLAG);
 #ifdef USE_JPWL
@@ -6602,6 +6743,68 @@ OPJ_BOOL opj_j2k_set_threads(opj_j2k_t *j2k, OPJ_UINT32 num_threads)
     return OPJ_FALSE;
 }
 
+OPJ_BOOL opj_j2k_set_cblk_cache_size(opj_j2k_t *j2k, OPJ_SIZE_T max_size,
+                                     opj_event_mgr_t * p_manager)
+{
+    if (max_size == 0) {
+        opj_t1_cblk_cache_destroy(j2k->m_cblk_cache);
+        j2k->m_cblk_cache = NULL;
+    } else if (j2k->m_cblk_cache) {
+        opj_t1_cblk_cache_set_max_size(j2k->m_cblk_cache, max_size);
+    } else {
+        j2k->m_cblk_cache = opj_t1_cblk_cache_create(max_size);
+        if (j2k->m_cblk_cache == NULL) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "Not enough memory to create the code-block cache\n");
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_set_max_cblk_passes(opj_j2k_t *j2k, OPJ_UINT32 max_passes,
+                                     opj_event_mgr_t * p_manager)
+{
+    OPJ_UNUSED(p_manager);
+    j2k->m_cp.m_specific_param.m_dec.m_max_passes = max_passes;
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_set_strict_mode(opj_j2k_t *j2k, OPJ_BOOL strict,
+                                 opj_event_mgr_t * p_manager)
+{
+    OPJ_UNUSED(p_manager);
+    j2k->m_cp.m_specific_param.m_dec.m_allow_truncated = !strict;
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_set_deadline(opj_j2k_t *j2k, OPJ_UINT32 deadline_ms,
+                              opj_event_mgr_t * p_manager)
+{
+    OPJ_UNUSED(p_manager);
+    j2k->m_cp.m_specific_param.m_dec.m_deadline_ms = deadline_ms;
+    return OPJ_TRUE;
+}
+
+opj_interrupt_t* opj_j2k_get_interrupt(opj_j2k_t *j2k)
+{
+    return &j2k->m_interrupt;
+}
+
+/**
+ * Starts the countdown of the deadline set by opj_j2k_set_deadline(), if any,
+ * at the beginning of a decoding.
+ *
+ * @param p_j2k the jpeg2000 codec.
+ */
+static void opj_j2k_start_deadline(opj_j2k_t *p_j2k)
+{
+    OPJ_UINT32 l_deadline_ms = p_j2k->m_cp.m_specific_param.m_dec.m_deadline_ms;
+    p_j2k->m_interrupt.deadline = l_deadline_ms ?
+                                  opj_wall_clock() + l_deadline_ms * 1e-3 : 0;
+    p_j2k->m_interrupt.cblks_skipped = OPJ_FALSE;
+}
+
 static int opj_j2k_get_default_thread_count()
 {
     const char* num_threads_str = getenv("OPJ_NUM_THREADS");
@@ -8252,6 +8455,208 @@ OPJ_BOOL opj_j2k_end_decompress(opj_j2k_t *p_j2k,
     return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_j2k_decoder_reset(opj_j2k_t *p_j2k,
+                               opj_event_mgr_t * p_manager)
+{
+    opj_decoding_param_t l_dec_param;
+    opj_tcp_t * l_default_tcp;
+    OPJ_BYTE * l_header_data;
+    OPJ_UINT32 l_header_data_size;
+#ifdef USE_JPWL
+    OPJ_BOOL l_correct;
+    int l_exp_comps;
+    OPJ_UINT32 l_max_tiles;
+#endif
+
+    /* preconditions */
+    assert(p_j2k != 00);
+    assert(p_manager != 00);
+
+    if (! p_j2k->m_is_decoder) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "opj_j2k_decoder_reset() called on a compressor\n");
+        return OPJ_FALSE;
+    }
+
+    /* Forget everything read from the previous codestream, but keep the */
+    /* decoding parameters, the thread pool, the tile decoder and the */
+    /* header buffer. The tile decoder is reused by */
+    /* opj_j2k_create_decoder_tcd() if possible */
+    opj_procedure_list_clear(p_j2k->m_procedure_list);
+    opj_procedure_list_clear(p_j2k->m_validation_list);
+
+    opj_image_destroy(p_j2k->m_private_image);
+    p_j2k->m_private_image = NULL;
+    opj_image_destroy(p_j2k->m_output_image);
+    p_j2k->m_output_image = NULL;
+
+    j2k_destroy_cstr_index(p_j2k->cstr_index);
+    p_j2k->cstr_index = opj_j2k_create_cstr_index();
+    if (! p_j2k->cstr_index) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Not enough memory to reset the decoder\n");
+        return OPJ_FALSE;
+    }
+
+    l_dec_param = p_j2k->m_cp.m_specific_param.m_dec;
+#ifdef USE_JPWL
+    l_correct = p_j2k->m_cp.correct;
+    l_exp_comps = p_j2k->m_cp.exp_comps;
+    l_max_tiles = p_j2k->m_cp.max_tiles;
+#endif
+    opj_j2k_cp_destroy(&(p_j2k->m_cp));
+    memset(&(p_j2k->m_cp), 0, sizeof(opj_cp_t));
+    p_j2k->m_cp.m_is_decoder = 1;
+    p_j2k->m_cp.allow_different_bit_depth_sign = 1;
+    p_j2k->m_cp.m_specific_param.m_dec = l_dec_param;
+#ifdef USE_JPWL
+    p_j2k->m_cp.correct = l_correct;
+    p_j2k->m_cp.exp_comps = l_exp_comps;
+    p_j2k->m_cp.max_tiles = l_max_tiles;
+#endif
+
+    l_default_tcp = p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_header_data = p_j2k->m_specific_param.m_decoder.m_header_data;
+    l_header_data_size = p_j2k->m_specific_param.m_decoder.m_header_data_size;
+    opj_j2k_tcp_destroy(l_default_tcp);
+    memset(l_default_tcp, 0, sizeof(opj_tcp_t));
+    opj_free(p_j2k->m_specific_param.m_decoder.m_comps_indices_to_decode);
+    opj_free(p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths);
+
+    memset(&(p_j2k->m_specific_param.m_decoder), 0, sizeof(opj_j2k_dec_t));
+    p_j2k->m_specific_param.m_decoder.m_default_tcp = l_default_tcp;
+    p_j2k->m_specific_param.m_decoder.m_header_data = l_header_data;
+    p_j2k->m_specific_param.m_decoder.m_header_data_size = l_header_data_size;
+    p_j2k->m_specific_param.m_decoder.m_tile_ind_to_dec = -1;
+#ifdef OPJ_DISABLE_TPSOT_FIX
+    p_j2k->m_specific_param.m_decoder.m_nb_tile_parts_correction_checked = 1;
+#endif
+
+    p_j2k->m_current_tile_number = 0;
+    p_j2k->ihdr_w = 0;
+    p_j2k->ihdr_h = 0;
+
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_j2k_probe_header(const OPJ_BYTE * p_data,
+                              OPJ_SIZE_T p_data_size,
+                              opj_header_info_t * p_info)
+{
+    const OPJ_BYTE * l_end = p_data + p_data_size;
+    OPJ_UINT32 l_marker, l_marker_size, l_tmp, i;
+    OPJ_UINT32 l_tx1, l_ty1;
+
+    /* SOC, then SIZ marker id, length and fixed fields */
+    if (p_data_size < 4 + 38) {
+        return OPJ_FALSE;
+    }
+    opj_read_bytes(p_data, &l_marker, 2);
+    if (l_marker != J2K_MS_SOC) {
+        return OPJ_FALSE;
+    }
+    opj_read_bytes(p_data + 2, &l_marker, 2);
+    if (l_marker != J2K_MS_SIZ) {
+        return OPJ_FALSE;
+    }
+    p_data += 4;
+
+    opj_read_bytes(p_data, &l_marker_size, 2);                  /* Lsiz */
+    if (l_marker_size < 38 + 3 || (l_marker_size - 38) % 3 != 0 ||
+            (OPJ_SIZE_T)(l_end - p_data) < l_marker_size) {
+        return OPJ_FALSE;
+    }
+    opj_read_bytes(p_data + 2, &l_tmp, 2);                      /* Rsiz */
+    p_info->rsiz = (OPJ_UINT16)l_tmp;
+    opj_read_bytes(p_data + 4, &p_info->x1, 4);                 /* Xsiz */
+    opj_read_bytes(p_data + 8, &p_info->y1, 4);                 /* Ysiz */
+    opj_read_bytes(p_data + 12, &p_info->x0, 4);                /* X0siz */
+    opj_read_bytes(p_data + 16, &p_info->y0, 4);                /* Y0siz */
+    opj_read_bytes(p_data + 20, &p_info->tdx, 4);               /* XTsiz */
+    opj_read_bytes(p_data + 24, &p_info->tdy, 4);               /* YTsiz */
+    opj_read_bytes(p_data + 28, &p_info->tx0, 4);               /* XT0siz */
+    opj_read_bytes(p_data + 32, &p_info->ty0, 4);               /* YT0siz */
+    opj_read_bytes(p_data + 36, &p_info->numcomps, 2);          /* Csiz */
+
+    /* Same checks as opj_j2k_read_siz() */
+    if (p_info->numcomps == 0 || p_info->numcomps > 16384 ||
+            p_info->numcomps != (l_marker_size - 38) / 3) {
+        return OPJ_FALSE;
+    }
+    if (p_info->x0 >= p_info->x1 || p_info->y0 >= p_info->y1 ||
+            p_info->tdx == 0 || p_info->tdy == 0) {
+        return OPJ_FALSE;
+    }
+    l_tx1 = opj_uint_adds(p_info->tx0, p_info->tdx);
+    l_ty1 = opj_uint_adds(p_info->ty0, p_info->tdy);
+    if (p_info->tx0 > p_info->x0 || p_info->ty0 > p_info->y0 ||
+            l_tx1 <= p_info->x0 || l_ty1 <= p_info->y0) {
+        return OPJ_FALSE;
+    }
+    p_info->tw = opj_uint_ceildiv(p_info->x1 - p_info->tx0, p_info->tdx);
+    p_info->th = opj_uint_ceildiv(p_info->y1 - p_info->ty0, p_info->tdy);
+    if (p_info->tw == 0 || p_info->th == 0 || p_info->tw > 65535 / p_info->th) {
+        return OPJ_FALSE;
+    }
+
+    p_info->same_comps = OPJ_TRUE;
+    for (i = 0; i < p_info->numcomps; ++i) {
+        const OPJ_BYTE * l_comp = p_data + 38 + 3 * i;
+        OPJ_UINT32 l_ssiz, l_dx, l_dy;
+        opj_read_bytes(l_comp, &l_ssiz, 1);                     /* Ssiz_i */
+        opj_read_bytes(l_comp + 1, &l_dx, 1);                   /* XRsiz_i */
+        opj_read_bytes(l_comp + 2, &l_dy, 1);                   /* YRsiz_i */
+        if (l_dx == 0 || l_dy == 0 || (l_ssiz & 0x7f) + 1 > 31) {
+            return OPJ_FALSE;
+        }
+        if (i == 0) {
+            p_info->prec = (l_ssiz & 0x7f) + 1;
+            p_info->sgnd = l_ssiz >> 7;
+            p_info->dx = l_dx;
+            p_info->dy = l_dy;
+        } else if ((l_ssiz & 0x7f) + 1 != p_info->prec ||
+                   l_ssiz >> 7 != p_info->sgnd ||
+                   l_dx != p_info->dx || l_dy != p_info->dy) {
+            p_info->same_comps = OPJ_FALSE;
+        }
+    }
+    p_data += l_marker_size;
+
+    /* Look for COD and QCD in the rest of the main header */
+    while ((!p_info->has_cod || !p_info->has_qcd) && l_end - p_data >= 4) {
+        opj_read_bytes(p_data, &l_marker, 2);
+        opj_read_bytes(p_data + 2, &l_marker_size, 2);
+        if (l_marker == J2K_MS_SOT || l_marker < 0xff00 || l_marker_size < 2 ||
+                (OPJ_SIZE_T)(l_end - p_data) - 2 < l_marker_size) {
+            break;
+        }
+        if (l_marker == J2K_MS_COD && !p_info->has_cod && l_marker_size >= 12) {
+            opj_read_bytes(p_data + 4, &p_info->csty, 1);           /* Scod */
+            opj_read_bytes(p_data + 5, &l_tmp, 1);                  /* SGcod (A) */
+            p_info->prg = (OPJ_PROG_ORDER)l_tmp;
+            opj_read_bytes(p_data + 6, &p_info->numlayers, 2);      /* SGcod (B) */
+            opj_read_bytes(p_data + 8, &p_info->mct, 1);            /* SGcod (C) */
+            opj_read_bytes(p_data + 9, &l_tmp, 1);                  /* SPcod (D) */
+            p_info->numresolutions = l_tmp + 1;
+            opj_read_bytes(p_data + 10, &l_tmp, 1);                 /* SPcod (E) */
+            p_info->cblkw = l_tmp + 2;
+            opj_read_bytes(p_data + 11, &l_tmp, 1);                 /* SPcod (F) */
+            p_info->cblkh = l_tmp + 2;
+            opj_read_bytes(p_data + 12, &p_info->cblksty, 1);       /* SPcod (G) */
+            opj_read_bytes(p_data + 13, &p_info->qmfbid, 1);        /* SPcod (H) */
+            p_info->has_cod = OPJ_TRUE;
+        } else if (l_marker == J2K_MS_QCD && !p_info->has_qcd && l_marker_size >= 3) {
+            opj_read_bytes(p_data + 4, &l_tmp, 1);                  /* Sqcd */
+            p_info->qntsty = l_tmp & 0x1f;
+            p_info->numgbits = l_tmp >> 5;
+            p_info->has_qcd = OPJ_TRUE;
+        }
+        p_data += 2 + l_marker_size;
+    }
+
+    return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_j2k_read_header(opj_stream_private_t *p_stream,
                              opj_j2k_t* p_j2k,
                              opj_image_t** p_image,
@@ -8328,7 +8733,7 @@ static OPJ_BOOL opj_j2k_setup_header_reading(opj_j2k_t *p_j2k,
 
     /* DEVELOPER CORNER, add your custom procedures */
     if (! opj_procedure_list_add_procedure(p_j2k->m_procedure_list,
-                                           (opj_procedure)opj_j2k_copy_default_tcp_and_create_tcd, p_manager))  {
+                                           (opj_procedure)opj_j2k_create_decoder_tcd, p_manager))  {
         return OPJ_FALSE;
     }
 
@@ -8877,139 +9282,190 @@ static OPJ_BOOL opj_j2k_exec(opj_j2k_t * p_j2k,
     return l_result;
 }
 
-/* FIXME DOC*/
-static OPJ_BOOL opj_j2k_copy_default_tcp_and_create_tcd(opj_j2k_t * p_j2k,
-        opj_stream_private_t *p_stream,
-        opj_event_mgr_t * p_manager
-                                                       )
+static void opj_j2k_init_tile_tcp(opj_j2k_t * p_j2k, opj_tcp_t * p_tcp)
 {
-    opj_tcp_t * l_tcp = 00;
-    opj_tcp_t * l_default_tcp = 00;
-    OPJ_UINT32 l_nb_tiles;
-    OPJ_UINT32 i, j;
-    opj_tccp_t *l_current_tccp = 00;
-    OPJ_UINT32 l_tccp_size;
-    OPJ_UINT32 l_mct_size;
-    opj_image_t * l_image;
+    /*Copy default coding parameters into the current tile coding parameters*/
+    memcpy(p_tcp, p_j2k->m_specific_param.m_decoder.m_default_tcp,
+           sizeof(opj_tcp_t));
+    /* Initialize some values of the current tile coding parameters*/
+    p_tcp->cod = 0;
+    p_tcp->ppt = 0;
+    p_tcp->ppt_data = 00;
+    p_tcp->m_packet_lengths = 00;
+    p_tcp->m_nb_packet_lengths = 0;
+    p_tcp->m_nb_max_packet_lengths = 0;
+    p_tcp->m_current_tile_part_number = -1;
+    p_tcp->initialized = 1;
+    /* tccps, the MCT/MCC records and the MCT decoding matrix are those of */
+    /* the default tcp until a tile-part header modifies them */
+    p_tcp->shares_default = 1;
+}
+
+static OPJ_BOOL opj_j2k_unshare_tile_tcp(opj_j2k_t * p_j2k,
+        opj_tcp_t * p_tcp,
+        opj_event_mgr_t * p_manager)
+{
+    OPJ_UINT32 j;
+    opj_image_t * l_image = p_j2k->m_private_image;
+    const opj_tcp_t * l_default_tcp =
+        p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    OPJ_UINT32 l_tccp_size = l_image->numcomps * (OPJ_UINT32)sizeof(opj_tccp_t);
+    OPJ_UINT32 l_mct_size = l_image->numcomps * l_image->numcomps *
+                            (OPJ_UINT32)sizeof(OPJ_FLOAT32);
     OPJ_UINT32 l_mcc_records_size, l_mct_records_size;
-    opj_mct_data_t * l_src_mct_rec, *l_dest_mct_rec;
-    opj_simple_mcc_decorrelation_data_t * l_src_mcc_rec, *l_dest_mcc_rec;
+    const opj_mct_data_t * l_src_mct_rec;
+    opj_mct_data_t * l_dest_mct_rec;
+    const opj_simple_mcc_decorrelation_data_t * l_src_mcc_rec;
+    opj_simple_mcc_decorrelation_data_t * l_dest_mcc_rec;
     OPJ_UINT32 l_offset;
 
-    /* preconditions */
-    assert(p_j2k != 00);
-    assert(p_stream != 00);
-    assert(p_manager != 00);
+    if (! p_tcp->shares_default) {
+        return OPJ_TRUE;
+    }
 
-    OPJ_UNUSED(p_stream);
+    /* Remove memory not owned by this tile in case of early error return. */
+    p_tcp->shares_default = 0;
+    p_tcp->tccps = 00;
+    p_tcp->m_mct_decoding_matrix = 00;
+    p_tcp->m_nb_max_mct_records = 0;
+    p_tcp->m_nb_mct_records = 0;
+    p_tcp->m_mct_records = 00;
+    p_tcp->m_nb_max_mcc_records = 0;
+    p_tcp->m_nb_mcc_records = 0;
+    p_tcp->m_mcc_records = 00;
 
-    l_image = p_j2k->m_private_image;
-    l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
-    l_tcp = p_j2k->m_cp.tcps;
-    l_tccp_size = l_image->numcomps * (OPJ_UINT32)sizeof(opj_tccp_t);
-    l_default_tcp = p_j2k->m_specific_param.m_decoder.m_default_tcp;
-    l_mct_size = l_image->numcomps * l_image->numcomps * (OPJ_UINT32)sizeof(
-                     OPJ_FLOAT32);
+    /* Copy all the dflt_tile_compo_cp to the current tile cp */
+    p_tcp->tccps = (opj_tccp_t*) opj_malloc(l_tccp_size);
+    if (! p_tcp->tccps) {
+        goto error;
+    }
+    memcpy(p_tcp->tccps, l_default_tcp->tccps, l_tccp_size);
 
-    /* For each tile */
-    for (i = 0; i < l_nb_tiles; ++i) {
-        /* keep the tile-compo coding parameters pointer of the current tile coding parameters*/
-        l_current_tccp = l_tcp->tccps;
-        /*Copy default coding parameters into the current tile coding parameters*/
-        memcpy(l_tcp, l_default_tcp, sizeof(opj_tcp_t));
-        /* Initialize some values of the current tile coding parameters*/
-        l_tcp->cod = 0;
-        l_tcp->ppt = 0;
-        l_tcp->ppt_data = 00;
-        l_tcp->m_current_tile_part_number = -1;
-        /* Remove memory not owned by this tile in case of early error return. */
-        l_tcp->m_mct_decoding_matrix = 00;
-        l_tcp->m_nb_max_mct_records = 0;
-        l_tcp->m_mct_records = 00;
-        l_tcp->m_nb_max_mcc_records = 0;
-        l_tcp->m_mcc_records = 00;
-        /* Reconnect the tile-compo coding parameters pointer to the current tile coding parameters*/
-        l_tcp->tccps = l_current_tccp;
-
-        /* Get the mct_decoding_matrix of the dflt_tile_cp and copy them into the current tile cp*/
-        if (l_default_tcp->m_mct_decoding_matrix) {
-            l_tcp->m_mct_decoding_matrix = (OPJ_FLOAT32*)opj_malloc(l_mct_size);
-            if (! l_tcp->m_mct_decoding_matrix) {
-                return OPJ_FALSE;
-            }
-            memcpy(l_tcp->m_mct_decoding_matrix, l_default_tcp->m_mct_decoding_matrix,
-                   l_mct_size);
+    /* Get the mct_decoding_matrix of the dflt_tile_cp and copy them into the current tile cp*/
+    if (l_default_tcp->m_mct_decoding_matrix) {
+        p_tcp->m_mct_decoding_matrix = (OPJ_FLOAT32*)opj_malloc(l_mct_size);
+        if (! p_tcp->m_mct_decoding_matrix) {
+            goto error;
         }
+        memcpy(p_tcp->m_mct_decoding_matrix, l_default_tcp->m_mct_decoding_matrix,
+               l_mct_size);
+    }
 
-        /* Get the mct_record of the dflt_tile_cp and copy them into the current tile cp*/
-        l_mct_records_size = l_default_tcp->m_nb_max_mct_records * (OPJ_UINT32)sizeof(
-                                 opj_mct_data_t);
-        l_tcp->m_mct_records = (opj_mct_data_t*)opj_malloc(l_mct_records_size);
-        if (! l_tcp->m_mct_records) {
-            return OPJ_FALSE;
+    /* Get the mct_record of the dflt_tile_cp and copy them into the current tile cp*/
+    l_mct_records_size = l_default_tcp->m_nb_max_mct_records * (OPJ_UINT32)sizeof(
+                             opj_mct_data_t);
+    p_tcp->m_mct_records = (opj_mct_data_t*)opj_calloc(1, l_mct_records_size);
+    if (! p_tcp->m_mct_records) {
+        goto error;
+    }
+    p_tcp->m_nb_max_mct_records = l_default_tcp->m_nb_max_mct_records;
+
+    /* Copy the mct record data from dflt_tile_cp to the current tile*/
+    l_src_mct_rec = l_default_tcp->m_mct_records;
+    l_dest_mct_rec = p_tcp->m_mct_records;
+
+    for (j = 0; j < l_default_tcp->m_nb_mct_records; ++j) {
+        *l_dest_mct_rec = *l_src_mct_rec;
+        l_dest_mct_rec->m_data = 00;
+        /* Update with each pass to free exactly what has been allocated on early return. */
+        p_tcp->m_nb_mct_records += 1;
+
+        if (l_src_mct_rec->m_data) {
+            l_dest_mct_rec->m_data = (OPJ_BYTE*) opj_malloc(l_src_mct_rec->m_data_size);
+            if (! l_dest_mct_rec->m_data) {
+                goto error;
+            }
+            memcpy(l_dest_mct_rec->m_data, l_src_mct_rec->m_data,
+                   l_src_mct_rec->m_data_size);
         }
-        memcpy(l_tcp->m_mct_records, l_default_tcp->m_mct_records, l_mct_records_size);
 
-        /* Copy the mct record data from dflt_tile_cp to the current tile*/
-        l_src_mct_rec = l_default_tcp->m_mct_records;
-        l_dest_mct_rec = l_tcp->m_mct_records;
+        ++l_src_mct_rec;
+        ++l_dest_mct_rec;
+    }
 
-        for (j = 0; j < l_default_tcp->m_nb_mct_records; ++j) {
+    /* Get the mcc_record of the dflt_tile_cp and copy them into the current tile cp*/
+    l_mcc_records_size = l_default_tcp->m_nb_max_mcc_records * (OPJ_UINT32)sizeof(
+                             opj_simple_mcc_decorrelation_data_t);
+    p_tcp->m_mcc_records = (opj_simple_mcc_decorrelation_data_t*) opj_malloc(
+                               l_mcc_records_size);
+    if (! p_tcp->m_mcc_records) {
+        goto error;
+    }
+    memcpy(p_tcp->m_mcc_records, l_default_tcp->m_mcc_records, l_mcc_records_size);
+    p_tcp->m_nb_max_mcc_records = l_default_tcp->m_nb_max_mcc_records;
+    p_tcp->m_nb_mcc_records = l_default_tcp->m_nb_mcc_records;
 
-            if (l_src_mct_rec->m_data) {
+    /* Make the mcc records point to the mct records of the current tile */
+    l_src_mcc_rec = l_default_tcp->m_mcc_records;
+    l_dest_mcc_rec = p_tcp->m_mcc_records;
 
-                l_dest_mct_rec->m_data = (OPJ_BYTE*) opj_malloc(l_src_mct_rec->m_data_size);
-                if (! l_dest_mct_rec->m_data) {
-                    return OPJ_FALSE;
-                }
-                memcpy(l_dest_mct_rec->m_data, l_src_mct_rec->m_data,
-                       l_src_mct_rec->m_data_size);
-            }
+    for (j = 0; j < l_default_tcp->m_nb_max_mcc_records; ++j) {
 
-            ++l_src_mct_rec;
-            ++l_dest_mct_rec;
-            /* Update with each pass to free exactly what has been allocated on early return. */
-            l_tcp->m_nb_max_mct_records += 1;
+        if (l_src_mcc_rec->m_decorrelation_array) {
+            l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_decorrelation_array -
+                                    l_default_tcp->m_mct_records);
+            l_dest_mcc_rec->m_decorrelation_array = p_tcp->m_mct_records + l_offset;
         }
 
-        /* Get the mcc_record of the dflt_tile_cp and copy them into the current tile cp*/
-        l_mcc_records_size = l_default_tcp->m_nb_max_mcc_records * (OPJ_UINT32)sizeof(
-                                 opj_simple_mcc_decorrelation_data_t);
-        l_tcp->m_mcc_records = (opj_simple_mcc_decorrelation_data_t*) opj_malloc(
-                                   l_mcc_records_size);
-        if (! l_tcp->m_mcc_records) {
-            return OPJ_FALSE;
+        if (l_src_mcc_rec->m_offset_array) {
+            l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_offset_array -
+                                    l_default_tcp->m_mct_records);
+            l_dest_mcc_rec->m_offset_array = p_tcp->m_mct_records + l_offset;
         }
-        memcpy(l_tcp->m_mcc_records, l_default_tcp->m_mcc_records, l_mcc_records_size);
-        l_tcp->m_nb_max_mcc_records = l_default_tcp->m_nb_max_mcc_records;
 
-        /* Copy the mcc record data from dflt_tile_cp to the current tile*/
-        l_src_mcc_rec = l_default_tcp->m_mcc_records;
-        l_dest_mcc_rec = l_tcp->m_mcc_records;
+        ++l_src_mcc_rec;
+        ++l_dest_mcc_rec;
+    }
 
-        for (j = 0; j < l_default_tcp->m_nb_max_mcc_records; ++j) {
+    return OPJ_TRUE;
 
-            if (l_src_mcc_rec->m_decorrelation_array) {
-                l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_decorrelation_array -
-                                        l_default_tcp->m_mct_records);
-                l_dest_mcc_rec->m_decorrelation_array = l_tcp->m_mct_records + l_offset;
-            }
+error:
+    opj_event_msg(p_manager, EVT_ERROR,
+                  "Not enough memory to read the tile-part header\n");
+    return OPJ_FALSE;
+}
 
-            if (l_src_mcc_rec->m_offset_array) {
-                l_offset = (OPJ_UINT32)(l_src_mcc_rec->m_offset_array -
-                                        l_default_tcp->m_mct_records);
-                l_dest_mcc_rec->m_offset_array = l_tcp->m_mct_records + l_offset;
-            }
+static opj_tcp_t * opj_j2k_get_tcp_to_update(opj_j2k_t * p_j2k,
+        opj_event_mgr_t * p_manager)
+{
+    opj_tcp_t * l_tcp;
 
-            ++l_src_mcc_rec;
-            ++l_dest_mcc_rec;
-        }
+    if (p_j2k->m_specific_param.m_decoder.m_state != J2K_STATE_TPH) {
+        return p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    }
 
-        /* Copy all the dflt_tile_compo_cp to the current tile cp */
-        memcpy(l_current_tccp, l_default_tcp->tccps, l_tccp_size);
+    l_tcp = &p_j2k->m_cp.tcps[p_j2k->m_current_tile_number];
+    if (! opj_j2k_unshare_tile_tcp(p_j2k, l_tcp, p_manager)) {
+        return 00;
+    }
+    return l_tcp;
+}
 
-        /* Move to next tile cp*/
-        ++l_tcp;
+static OPJ_BOOL opj_j2k_create_decoder_tcd(opj_j2k_t * p_j2k,
+        opj_stream_private_t *p_stream,
+        opj_event_mgr_t * p_manager
+                                          )
+{
+    opj_image_t * l_image;
+
+    /* preconditions */
+    assert(p_j2k != 00);
+    assert(p_stream != 00);
+    assert(p_manager != 00);
+
+    OPJ_UNUSED(p_stream);
+
+    l_image = p_j2k->m_private_image;
+
+    /* Reuse the tile decoder of a previous codestream (see */
+    /* opj_j2k_decoder_reset()) if it has the right number of components */
+    if (p_j2k->m_tcd != 00) {
+        if (p_j2k->m_tcd->tcd_image->tiles->numcomps == l_image->numcomps) {
+            p_j2k->m_tcd->image = l_image;
+            return OPJ_TRUE;
+        }
+        opj_tcd_destroy(p_j2k->m_tcd);
+        p_j2k->m_tcd = 00;
     }
 
     /* Create the current tile decoder*/
@@ -9064,6 +9520,9 @@ void opj_j2k_destroy(opj_j2k_t *p_j2k)
         p_j2k->m_specific_param.m_decoder.m_comps_indices_to_decode = 00;
         p_j2k->m_specific_param.m_decoder.m_numcomps_to_decode = 0;
 
+        opj_free(p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths);
+        p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths = 00;
+
     } else {
 
         if (p_j2k->m_specific_param.m_encoder.m_encoded_tile_data) {
@@ -9082,6 +9541,13 @@ void opj_j2k_destroy(opj_j2k_t *p_j2k)
             p_j2k->m_specific_param.m_encoder.m_header_tile_data = 00;
             p_j2k->m_specific_param.m_encoder.m_header_tile_data_size = 0;
         }
+
+        opj_free(p_j2k->m_specific_param.m_encoder.m_strip_data);
+        p_j2k->m_specific_param.m_encoder.m_strip_data = 00;
+        p_j2k->m_specific_param.m_encoder.m_strip_data_size = 0;
+
+        opj_free(p_j2k->m_specific_param.m_encoder.m_setup_rates);
+        p_j2k->m_specific_param.m_encoder.m_setup_rates = 00;
     }
 
     opj_tcd_destroy(p_j2k->m_tcd);
@@ -9107,6 +9573,9 @@ void opj_j2k_destroy(opj_j2k_t *p_j2k)
     opj_thread_pool_destroy(p_j2k->m_tp);
     p_j2k->m_tp = NULL;
 
+    opj_t1_cblk_cache_destroy(p_j2k->m_cblk_cache);
+    p_j2k->m_cblk_cache = NULL;
+
     opj_free(p_j2k);
 }
 
@@ -9172,6 +9641,19 @@ static void opj_j2k_tcp_destroy(opj_tcp_t *p_tcp)
         p_tcp->ppt_buffer = 00;
     }
 
+    if (p_tcp->shares_default) {
+        /* Owned by the default tile coding parameters */
+        p_tcp->shares_default = 0;
+        p_tcp->tccps = 00;
+        p_tcp->m_mct_decoding_matrix = 00;
+        p_tcp->m_mct_records = 00;
+        p_tcp->m_nb_mct_records = 0;
+        p_tcp->m_nb_max_mct_records = 0;
+        p_tcp->m_mcc_records = 00;
+        p_tcp->m_nb_mcc_records = 0;
+        p_tcp->m_nb_max_mcc_records = 0;
+    }
+
     if (p_tcp->tccps != 00) {
         opj_free(p_tcp->tccps);
         p_tcp->tccps = 00;
@@ -9227,6 +9709,12 @@ static void opj_j2k_tcp_data_destroy(opj_tcp_t *p_tcp)
         p_tcp->m_data = NULL;
         p_tcp->m_data_size = 0;
     }
+    if (p_tcp->m_packet_lengths) {
+        opj_free(p_tcp->m_packet_lengths);
+        p_tcp->m_packet_lengths = NULL;
+    }
+    p_tcp->m_nb_packet_lengths = 0;
+    p_tcp->m_nb_max_packet_lengths = 0;
 }
 
 static void opj_j2k_cp_destroy(opj_cp_t *p_cp)
@@ -9418,6 +9906,12 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
         while (l_current_marker != J2K_MS_SOD) {
 
             if (opj_stream_get_number_byte_left(p_stream) == 0) {
+                if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                    /* Non strict mode: decode the tiles read so far, as */
+                    /* if the codestream ended here */
+                    l_current_marker = J2K_MS_EOC;
+                    break;
+                }
                 p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_NEOC;
                 break;
             }
@@ -9425,6 +9919,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
             /* Try to read 2 bytes (the marker size) from stream and copy them into the buffer */
             if (opj_stream_read_data(p_stream,
                                      p_j2k->m_specific_param.m_decoder.m_header_data, 2, p_manager) != 2) {
+                if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                    l_current_marker = J2K_MS_EOC;
+                    break;
+                }
                 opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                 return OPJ_FALSE;
             }
@@ -9469,6 +9967,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                 /* If we are here, this means we consider this marker as known & we will read it */
                 /* Check enough bytes left in stream before allocation */
                 if ((OPJ_OFF_T)l_marker_size >  opj_stream_get_number_byte_left(p_stream)) {
+                    if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                        l_current_marker = J2K_MS_EOC;
+                        break;
+                    }
                     opj_event_msg(p_manager, EVT_ERROR,
                                   "Marker size inconsistent with stream length\n");
                     return OPJ_FALSE;
@@ -9490,6 +9992,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
             if (opj_stream_read_data(p_stream,
                                      p_j2k->m_specific_param.m_decoder.m_header_data, l_marker_size,
                                      p_manager) != l_marker_size) {
+                if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                    l_current_marker = J2K_MS_EOC;
+                    break;
+                }
                 opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                 return OPJ_FALSE;
             }
@@ -9530,6 +10036,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                 /* Skip the rest of the tile part header*/
                 if (opj_stream_skip(p_stream, p_j2k->m_specific_param.m_decoder.m_sot_length,
                                     p_manager) != p_j2k->m_specific_param.m_decoder.m_sot_length) {
+                    if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                        l_current_marker = J2K_MS_EOC;
+                        break;
+                    }
                     opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                     return OPJ_FALSE;
                 }
@@ -9538,6 +10048,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                 /* Try to read 2 bytes (the next marker ID) from stream and copy them into the buffer*/
                 if (opj_stream_read_data(p_stream,
                                          p_j2k->m_specific_param.m_decoder.m_header_data, 2, p_manager) != 2) {
+                    if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                        l_current_marker = J2K_MS_EOC;
+                        break;
+                    }
                     opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                     return OPJ_FALSE;
                 }
@@ -9546,6 +10060,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                                &l_current_marker, 2);
             }
         }
+        if (l_current_marker == J2K_MS_EOC) {
+            /* Truncated codestream in non strict mode */
+            break;
+        }
         if (opj_stream_get_number_byte_left(p_stream) == 0
                 && p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_NEOC) {
             break;
@@ -9602,7 +10120,8 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                 if (p_j2k->m_current_tile_number + 1 == l_nb_tiles) {
                     OPJ_UINT32 l_tile_no;
                     for (l_tile_no = 0U; l_tile_no < l_nb_tiles; ++l_tile_no) {
-                        if (p_j2k->m_cp.tcps[l_tile_no].m_current_tile_part_number == 0 &&
+                        if (p_j2k->m_cp.tcps[l_tile_no].initialized &&
+                                p_j2k->m_cp.tcps[l_tile_no].m_current_tile_part_number == 0 &&
                                 p_j2k->m_cp.tcps[l_tile_no].m_nb_tile_parts == 0) {
                             break;
                         }
@@ -9620,6 +10139,10 @@ OPJ_BOOL opj_j2k_read_tile_header(opj_j2k_t * p_j2k,
                     }
                 }
 
+                if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                    l_current_marker = J2K_MS_EOC;
+                    break;
+                }
                 opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                 return OPJ_FALSE;
             }
@@ -9724,6 +10247,12 @@ OPJ_BOOL opj_j2k_decode_tile(opj_j2k_t * p_j2k,
     /* but full tile decoding is done */
     l_image_for_bounds = p_j2k->m_output_image ? p_j2k->m_output_image :
                          p_j2k->m_private_image;
+    p_j2k->m_tcd->cblk_cache = p_j2k->m_cblk_cache;
+    p_j2k->m_tcd->keep_t1_state =
+        p_j2k->m_cp.m_specific_param.m_dec.m_progressive_refinement;
+    p_j2k->m_tcd->max_cblk_passes =
+        p_j2k->m_cp.m_specific_param.m_dec.m_max_passes;
+    p_j2k->m_tcd->interrupt = &p_j2k->m_interrupt;
     if (! opj_tcd_decode_tile(p_j2k->m_tcd,
                               l_image_for_bounds->x0,
                               l_image_for_bounds->y0,
@@ -9745,9 +10274,11 @@ OPJ_BOOL opj_j2k_decode_tile(opj_j2k_t * p_j2k,
     /* itself the TCD data. This is typically the case for whole single */
     /* tile decoding optimization. */
     if (p_data != NULL) {
+        OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
         if (! opj_tcd_update_tile_data(p_j2k->m_tcd, p_data, p_data_size)) {
             return OPJ_FALSE;
         }
+        OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
 
         /* To avoid to destroy the tcp which can be useful when we try to decode a tile decoded before (cf j2k_random_tile_access)
         * we destroy just the data which will be re-read in read_tile_header*/
@@ -9766,6 +10297,13 @@ OPJ_BOOL opj_j2k_decode_tile(opj_j2k_t * p_j2k,
 
     if (p_j2k->m_specific_param.m_decoder.m_state != J2K_STATE_EOC) {
         if (opj_stream_read_data(p_stream, l_data, 2, p_manager) != 2) {
+            if (p_j2k->m_cp.m_specific_param.m_dec.m_allow_truncated) {
+                /* Truncated codestream in non strict mode: decode the other */
+                /* tiles read so far, as if the codestream ended here */
+                p_j2k->m_current_tile_number = 0;
+                p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_EOC;
+                return OPJ_TRUE;
+            }
             opj_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
             return OPJ_FALSE;
         }
@@ -10273,6 +10811,131 @@ OPJ_BOOL opj_j2k_set_decode_area(opj_j2k_t *p_j2k,
     return ret;
 }
 
+OPJ_BOOL opj_j2k_estimate_decode(opj_j2k_t *p_j2k,
+                                 opj_stream_private_t *p_stream,
+                                 opj_image_t* p_image,
+                                 opj_decode_estimate_t* p_estimate,
+                                 opj_event_mgr_t * p_manager)
+{
+    opj_cp_t * l_cp = &(p_j2k->m_cp);
+    const OPJ_UINT64* l_tlm_tile_lengths =
+        p_j2k->m_specific_param.m_decoder.m_tlm_tile_lengths;
+    OPJ_UINT32 l_numcomps_to_decode =
+        p_j2k->m_specific_param.m_decoder.m_numcomps_to_decode;
+    const OPJ_UINT32* l_comps_indices =
+        p_j2k->m_specific_param.m_decoder.m_comps_indices_to_decode;
+    OPJ_UINT32 l_reduce = l_cp->m_specific_param.m_dec.m_reduce;
+    OPJ_UINT64 l_max_tile_memory = 0, l_max_data_memory = 0;
+    OPJ_UINT64 l_max_tile_bytes = 0;
+    OPJ_UINT64 l_bytes_left = 0;
+    OPJ_UINT32 l_nb_threads = 1;
+    OPJ_UINT32 l_nb_tiles;
+    OPJ_UINT32 i, j, compno;
+
+    if (p_j2k->m_tcd == 00 ||
+            (p_j2k->m_specific_param.m_decoder.m_state != J2K_STATE_TPHSOT &&
+             !(l_cp->tw == 1 && l_cp->th == 1 && l_cp->tcps[0].m_data != NULL))) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "The decoding cost can only be estimated after the main header is read and before decoding.\n");
+        return OPJ_FALSE;
+    }
+
+    memset(p_estimate, 0, sizeof(opj_decode_estimate_t));
+
+    /* Decoded image, as computed by opj_j2k_update_image_dimensions() */
+    for (compno = 0; compno < p_image->numcomps; ++compno) {
+        opj_image_comp_t* l_img_comp = &(p_image->comps[compno]);
+        OPJ_UINT32 l_w, l_h;
+
+        if (l_numcomps_to_decode) {
+            for (i = 0; i < l_numcomps_to_decode; ++i) {
+                if (l_comps_indices[i] == compno) {
+                    break;
+                }
+            }
+            if (i == l_numcomps_to_decode) {
+                continue;
+            }
+        }
+        l_w = opj_uint_ceildivpow2(opj_uint_ceildiv(p_image->x1, l_img_comp->dx),
+                                   l_reduce) -
+              opj_uint_ceildivpow2(opj_uint_ceildiv(p_image->x0, l_img_comp->dx),
+                                   l_reduce);
+        l_h = opj_uint_ceildivpow2(opj_uint_ceildiv(p_image->y1, l_img_comp->dy),
+                                   l_reduce) -
+              opj_uint_ceildivpow2(opj_uint_ceildiv(p_image->y0, l_img_comp->dy),
+                                   l_reduce);
+        p_estimate->image_memory += (OPJ_UINT64)l_w * l_h * sizeof(OPJ_INT32);
+    }
+
+    /* Without TLM markers, the tile data is assumed evenly spread in the */
+    /* rest of the stream, when its length is known */
+    l_nb_tiles = l_cp->tw * l_cp->th;
+    if (l_tlm_tile_lengths == 00) {
+        l_bytes_left = (OPJ_UINT64)opj_stream_get_number_byte_left(p_stream);
+    }
+    p_estimate->compressed_bytes_exact = (l_tlm_tile_lengths != 00);
+
+    /* Tiles decoded, see opj_j2k_read_tile_header() */
+    for (j = p_j2k->m_specific_param.m_decoder.m_start_tile_y;
+            j < p_j2k->m_specific_param.m_decoder.m_end_tile_y; ++j) {
+        for (i = p_j2k->m_specific_param.m_decoder.m_start_tile_x;
+                i < p_j2k->m_specific_param.m_decoder.m_end_tile_x; ++i) {
+            OPJ_UINT32 l_tile_no = j * l_cp->tw + i;
+            OPJ_UINT64 l_tile_bytes;
+            opj_tcd_decode_cost_t l_cost;
+
+            /* The parameters of the tile-part headers not read yet are */
+            /* assumed to be the default ones */
+            opj_tcp_t* l_tcp = l_cp->tcps[l_tile_no].initialized ?
+                               &(l_cp->tcps[l_tile_no]) :
+                               p_j2k->m_specific_param.m_decoder.m_default_tcp;
+
+            opj_tcd_estimate_decode_tile(p_j2k->m_tcd, l_tile_no, l_tcp,
+                                         p_image->x0, p_image->y0,
+                                         p_image->x1, p_image->y1,
+                                         l_numcomps_to_decode, l_comps_indices,
+                                         &l_cost);
+            l_tile_bytes = l_tlm_tile_lengths ? l_tlm_tile_lengths[l_tile_no] :
+                           l_bytes_left / l_nb_tiles;
+
+            ++p_estimate->nb_tiles;
+            p_estimate->nb_code_blocks += l_cost.nb_code_blocks;
+            p_estimate->compressed_bytes += l_tile_bytes;
+            if (l_cost.thread_memory > p_estimate->memory_per_thread) {
+                p_estimate->memory_per_thread = l_cost.thread_memory;
+            }
+            if (l_cost.tile_memory > l_max_tile_memory) {
+                l_max_tile_memory = l_cost.tile_memory;
+            }
+            if (l_cost.data_memory > l_max_data_memory) {
+                l_max_data_memory = l_cost.data_memory;
+            }
+            if (l_tile_bytes > l_max_tile_bytes) {
+                l_max_tile_bytes = l_tile_bytes;
+            }
+        }
+    }
+
+    if (p_j2k->m_tp) {
+        l_nb_threads = (OPJ_UINT32)opj_uint_max(1U,
+                       (OPJ_UINT32)opj_thread_pool_get_thread_count(p_j2k->m_tp));
+    }
+
+    /* The image, the structures and samples of the tile being decoded, with */
+    /* its compressed data, and the buffers of each thread. When a single */
+    /* tile covers the image, its samples are handed over to the image */
+    /* instead of being copied (see opj_j2k_update_image_data()) */
+    p_estimate->peak_memory = l_max_tile_memory + l_max_tile_bytes +
+                              (OPJ_UINT64)l_nb_threads * p_estimate->memory_per_thread;
+    if (!(p_estimate->nb_tiles == 1 &&
+            l_max_data_memory == p_estimate->image_memory)) {
+        p_estimate->peak_memory += p_estimate->image_memory;
+    }
+
+    return OPJ_TRUE;
+}
+
 opj_j2k_t* opj_j2k_create_decompress(void)
 {
     opj_j2k_t *l_j2k = (opj_j2k_t*) opj_calloc(1, sizeof(opj_j2k_t));
@@ -10526,9 +11189,10 @@ static OPJ_BOOL opj_j2k_read_SPCod_SPCoc(opj_j2k_t *p_j2k,
     assert(p_header_data != 00);
 
     l_cp = &(p_j2k->m_cp);
-    l_tcp = (p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH) ?
-            &l_cp->tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     /* precondition again */
     assert(compno < p_j2k->m_private_image->numcomps);
@@ -10856,7 +11520,6 @@ static OPJ_BOOL opj_j2k_read_SQcd_SQcc(opj_j2k_t *p_j2k,
 {
     /* loop*/
     OPJ_UINT32 l_band_no;
-    opj_cp_t *l_cp = 00;
     opj_tcp_t *l_tcp = 00;
     opj_tccp_t *l_tccp = 00;
     OPJ_BYTE * l_current_ptr = 00;
@@ -10867,12 +11530,11 @@ static OPJ_BOOL opj_j2k_read_SQcd_SQcc(opj_j2k_t *p_j2k,
     assert(p_manager != 00);
     assert(p_header_data != 00);
 
-    l_cp = &(p_j2k->m_cp);
     /* come from tile part header or main header ?*/
-    l_tcp = (p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_TPH)
-            ?
-            &l_cp->tcps[p_j2k->m_current_tile_number] :
-            p_j2k->m_specific_param.m_decoder.m_default_tcp;
+    l_tcp = opj_j2k_get_tcp_to_update(p_j2k, p_manager);
+    if (! l_tcp) {
+        return OPJ_FALSE;
+    }
 
     /* precondition again*/
     assert(p_comp_no <  p_j2k->m_private_image->numcomps);
@@ -11076,7 +11738,10 @@ void j2k_dump(opj_j2k_t* p_j2k, OPJ_INT32 flag, FILE* out_stream)
         opj_tcp_t * l_tcp = p_j2k->m_cp.tcps;
         if (p_j2k->m_private_image) {
             for (i = 0; i < l_nb_tiles; ++i) {
-                opj_j2k_dump_tile_info(l_tcp, (OPJ_INT32)p_j2k->m_private_image->numcomps,
+                /* Tiles not reached yet use the default parameters */
+                opj_j2k_dump_tile_info((l_tcp->initialized || !p_j2k->m_is_decoder) ? l_tcp :
+                                       p_j2k->m_specific_param.m_decoder.m_default_tcp,
+                                       (OPJ_INT32)p_j2k->m_private_image->numcomps,
                                        out_stream);
                 ++l_tcp;
             }
@@ -11500,6 +12165,13 @@ static OPJ_BOOL opj_j2k_decode_tiles(opj_j2k_t *p_j2k,
     OPJ_INT32 l_tile_x0, l_tile_y0, l_tile_x1, l_tile_y1;
     OPJ_UINT32 l_nb_comps;
     OPJ_UINT32 nr_tiles = 0;
+    /* Number of tiles intersecting the area to decode */
+    OPJ_UINT32 l_nb_area_tiles =
+        (p_j2k->m_specific_param.m_decoder.m_end_tile_x -
+         p_j2k->m_specific_param.m_decoder.m_start_tile_x) *
+        (p_j2k->m_specific_param.m_decoder.m_end_tile_y -
+         p_j2k->m_specific_param.m_decoder.m_start_tile_y);
+    OPJ_BOOL l_deadline_reached = OPJ_FALSE;
 
     /* Particular case for whole single tile decoding */
     /* We can avoid allocating intermediate tile buffers */
@@ -11521,12 +12193,25 @@ static OPJ_BOOL opj_j2k_decode_tiles(opj_j2k_t *p_j2k,
                                        p_manager)) {
             return OPJ_FALSE;
         }
+        if (! l_go_on) {
+            /* Possible with a truncated codestream in non strict mode */
+            opj_event_msg(p_manager, EVT_ERROR, "No data found for tile 1/1\n");
+            return OPJ_FALSE;
+        }
 
         if (! opj_j2k_decode_tile(p_j2k, l_current_tile_no, NULL, 0,
                                   p_stream, p_manager)) {
             opj_event_msg(p_manager, EVT_ERROR, "Failed to decode tile 1/1\n");
             return OPJ_FALSE;
         }
+        if (p_j2k->m_interrupt.cancelled) {
+            opj_event_msg(p_manager, EVT_ERROR, "Decoding cancelled\n");
+            return OPJ_FALSE;
+        }
+        if (p_j2k->m_interrupt.cblks_skipped) {
+            opj_event_msg(p_manager, EVT_WARNING,
+                          "Decoding deadline reached, the image is incomplete\n");
+        }
 
         /* Transfer TCD data to output image data */
         for (i = 0; i < p_j2k->m_output_image->numcomps; i++) {
@@ -11575,10 +12260,12 @@ static OPJ_BOOL opj_j2k_decode_tiles(opj_j2k_t *p_j2k,
         opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n",
                       l_current_tile_no + 1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
 
+        OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
         if (! opj_j2k_update_image_data(p_j2k->m_tcd,
                                         p_j2k->m_output_image)) {
             return OPJ_FALSE;
         }
+        OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
 
         if (p_j2k->m_cp.tw == 1 && p_j2k->m_cp.th == 1 &&
                 !(p_j2k->m_output_image->x0 == p_j2k->m_private_image->x0 &&
@@ -11593,6 +12280,22 @@ static OPJ_BOOL opj_j2k_decode_tiles(opj_j2k_t *p_j2k,
         opj_event_msg(p_manager, EVT_INFO,
                       "Image data has been updated with tile %d.\n\n", l_current_tile_no + 1);
 
+        /* Stop between tiles once cancelled, or past the deadline if tiles */
+        /* are left to decode, with the image decoded so far, whose other */
+        /* tiles are left to zero */
+        if (p_j2k->m_interrupt.cancelled) {
+            opj_event_msg(p_manager, EVT_ERROR, "Decoding cancelled\n");
+            return OPJ_FALSE;
+        }
+        if (nr_tiles + 1 < l_nb_area_tiles &&
+                opj_tcd_is_interrupted(&p_j2k->m_interrupt)) {
+            opj_event_msg(p_manager, EVT_WARNING,
+                          "Decoding deadline reached at tile %d, "
+                          "the image is incomplete\n", l_current_tile_no + 1);
+            l_deadline_reached = OPJ_TRUE;
+            break;
+        }
+
         if (opj_stream_get_number_byte_left(p_stream) == 0
                 && p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_NEOC) {
             break;
@@ -11602,6 +12305,13 @@ static OPJ_BOOL opj_j2k_decode_tiles(opj_j2k_t *p_j2k,
         }
     }
 
+    if (!l_deadline_reached && p_j2k->m_interrupt.cblks_skipped) {
+        /* The deadline was reached while decoding the code-blocks of the */
+        /* last tiles */
+        opj_event_msg(p_manager, EVT_WARNING,
+                      "Decoding deadline reached, the image is incomplete\n");
+    }
+
     if (! opj_j2k_are_all_used_components_decoded(p_j2k, p_manager)) {
         return OPJ_FALSE;
     }
@@ -11682,7 +12392,9 @@ static OPJ_BOOL opj_j2k_decode_one_tile(opj_j2k_t *p_j2k,
     /* ./build/bin/j2k_random_tile_access ./build/tests/tte1.j2k */
     l_nb_tiles = p_j2k->m_cp.tw * p_j2k->m_cp.th;
     for (i = 0; i < l_nb_tiles; ++i) {
-        p_j2k->m_cp.tcps[i].m_current_tile_part_number = -1;
+        if (p_j2k->m_cp.tcps[i].initialized) {
+            p_j2k->m_cp.tcps[i].m_current_tile_part_number = -1;
+        }
     }
 
     for (;;) {
@@ -11706,13 +12418,19 @@ static OPJ_BOOL opj_j2k_decode_one_tile(opj_j2k_t *p_j2k,
                                   p_stream, p_manager)) {
             return OPJ_FALSE;
         }
+        if (p_j2k->m_interrupt.cancelled) {
+            opj_event_msg(p_manager, EVT_ERROR, "Decoding cancelled\n");
+            return OPJ_FALSE;
+        }
         opj_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n",
                       l_current_tile_no + 1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
 
+        OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
         if (! opj_j2k_update_image_data(p_j2k->m_tcd,
                                         p_j2k->m_output_image)) {
             return OPJ_FALSE;
         }
+        OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
         opj_j2k_tcp_data_destroy(&p_j2k->m_cp.tcps[l_current_tile_no]);
 
         opj_event_msg(p_manager, EVT_INFO,
@@ -11866,6 +12584,7 @@ OPJ_BOOL opj_j2k_decode(opj_j2k_t * p_j2k,
     if (!opj_j2k_setup_decoding(p_j2k, p_manager)) {
         return OPJ_FALSE;
     }
+    opj_j2k_start_deadline(p_j2k);
 
     /* Decode the codestream */
     if (! opj_j2k_exec(p_j2k, p_j2k->m_procedure_list, p_stream, p_manager)) {
@@ -11981,6 +12700,7 @@ OPJ_BOOL opj_j2k_get_tile(opj_j2k_t *p_j2k,
     if (!opj_j2k_setup_decoding_tile(p_j2k, p_manager)) {
         return OPJ_FALSE;
     }
+    opj_j2k_start_deadline(p_j2k);
 
     /* Decode the codestream */
     if (! opj_j2k_exec(p_j2k, p_j2k->m_procedure_list, p_stream, p_manager)) {
@@ -12048,6 +12768,16 @@ OPJ_BOOL opj_j2k_encoder_set_extra_options(
                               "Invalid value for option: %s.\n", *p_option_iter);
                 return OPJ_FALSE;
             }
+        } else if (strncmp(*p_option_iter, "LAZY_NO_DISTORTION=", 19) == 0) {
+            if (strcmp(*p_option_iter, "LAZY_NO_DISTORTION=YES") == 0) {
+                p_j2k->m_cp.m_specific_param.m_enc.m_lazy_no_distortion = 1;
+            } else if (strcmp(*p_option_iter, "LAZY_NO_DISTORTION=NO") == 0) {
+                p_j2k->m_cp.m_specific_param.m_enc.m_lazy_no_distortion = 0;
+            } else {
+                opj_event_msg(p_manager, EVT_ERROR,
+                              "Invalid value for option: %s.\n", *p_option_iter);
+                return OPJ_FALSE;
+            }
         } else {
             opj_event_msg(p_manager, EVT_ERROR,
                           "Invalid option: %s.\n", *p_option_iter);
@@ -12092,6 +12822,13 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
 #endif
     }
     for (i = 0; i < l_nb_tiles; ++i) {
+        if (p_j2k->m_interrupt.cancelled) {
+            opj_event_msg(p_manager, EVT_ERROR, "Encoding cancelled\n");
+            if (l_current_data) {
+                opj_free(l_current_data);
+            }
+            return OPJ_FALSE;
+        }
         if (! opj_j2k_pre_write_tile(p_j2k, i, p_stream, p_manager)) {
             if (l_current_data) {
                 opj_free(l_current_data);
@@ -12142,6 +12879,7 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
             /* copy image data (32 bit) to l_current_data as contiguous, all-component, zero offset buffer */
             /* 32 bit components @ 8 bit precision get converted to 8 bit */
             /* 32 bit components @ 16 bit precision get converted to 16 bit */
+            OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
             opj_j2k_get_tile_data(p_j2k->m_tcd, l_current_data);
 
             /* now copy this data into the tile component */
@@ -12152,9 +12890,13 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
                 opj_free(l_current_data);
                 return OPJ_FALSE;
             }
+            OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
         }
 
         if (! opj_j2k_post_write_tile(p_j2k, p_stream, p_manager)) {
+            if (p_j2k->m_interrupt.cancelled) {
+                opj_event_msg(p_manager, EVT_ERROR, "Encoding cancelled\n");
+            }
             if (l_current_data) {
                 opj_free(l_current_data);
             }
@@ -12168,6 +12910,74 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
     return OPJ_TRUE;
 }
 
+OPJ_BOOL opj_j2k_encode_interleaved(opj_j2k_t * p_j2k,
+                                    const opj_interleaved_buffer_t *p_buffer,
+                                    opj_stream_private_t *p_stream,
+                                    opj_event_mgr_t * p_manager)
+{
+    opj_image_t * l_image = p_j2k->m_private_image;
+    OPJ_UINT32 l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
+    OPJ_UINT32 i, j;
+
+    /* preconditions */
+    assert(p_stream != 00);
+    assert(p_manager != 00);
+
+    if (p_buffer->data == 00 ||
+            (p_buffer->bytes_per_sample != 1 && p_buffer->bytes_per_sample != 2) ||
+            p_buffer->samples_per_pixel == 0 ||
+            p_buffer->line_stride < (OPJ_SIZE_T)(l_image->x1 - l_image->x0) *
+            p_buffer->samples_per_pixel * p_buffer->bytes_per_sample) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Invalid interleaved buffer description.\n");
+        return OPJ_FALSE;
+    }
+    for (j = 0; j < l_image->numcomps; ++j) {
+        const opj_image_comp_t * l_img_comp = l_image->comps + j;
+        const OPJ_UINT32 l_sample = p_buffer->comp_mapping ?
+                                    p_buffer->comp_mapping[j] : j;
+        if (l_img_comp->dx != 1 || l_img_comp->dy != 1) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "Interleaved input does not support subsampled components.\n");
+            return OPJ_FALSE;
+        }
+        if (l_sample >= p_buffer->samples_per_pixel) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "Invalid sample index %u for component %u.\n", l_sample, j);
+            return OPJ_FALSE;
+        }
+        if (l_img_comp->prec > 8 * p_buffer->bytes_per_sample) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "Precision of component %u does not fit in %u byte(s).\n",
+                          j, p_buffer->bytes_per_sample);
+            return OPJ_FALSE;
+        }
+    }
+
+    for (i = 0; i < l_nb_tiles; ++i) {
+        if (! opj_j2k_pre_write_tile(p_j2k, i, p_stream, p_manager)) {
+            return OPJ_FALSE;
+        }
+
+        for (j = 0; j < l_image->numcomps; ++j) {
+            opj_tcd_tilecomp_t* l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps + j;
+            if (! opj_alloc_tile_component_data(l_tilec)) {
+                opj_event_msg(p_manager, EVT_ERROR, "Error allocating tile component data.");
+                return OPJ_FALSE;
+            }
+        }
+
+        /* read the samples directly into the tile components, DC shifted */
+        opj_tcd_copy_tile_data_interleaved(p_j2k->m_tcd, i, p_buffer);
+
+        if (! opj_j2k_post_write_tile(p_j2k, p_stream, p_manager)) {
+            return OPJ_FALSE;
+        }
+    }
+
+    return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_j2k_end_compress(opj_j2k_t *p_j2k,
                               opj_stream_private_t *p_stream,
                               opj_event_mgr_t * p_manager)
@@ -12184,6 +12994,29 @@ OPJ_BOOL opj_j2k_end_compress(opj_j2k_t *p_j2k,
     return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_j2k_is_same_image_geometry(const opj_image_t *p_image1,
+        const opj_image_t *p_image2)
+{
+    OPJ_UINT32 compno;
+
+    if (p_image1->x0 != p_image2->x0 || p_image1->y0 != p_image2->y0 ||
+            p_image1->x1 != p_image2->x1 || p_image1->y1 != p_image2->y1 ||
+            p_image1->numcomps != p_image2->numcomps) {
+        return OPJ_FALSE;
+    }
+    for (compno = 0; compno < p_image1->numcomps; ++compno) {
+        const opj_image_comp_t* l_comp1 = &p_image1->comps[compno];
+        const opj_image_comp_t* l_comp2 = &p_image2->comps[compno];
+        if (l_comp1->dx != l_comp2->dx || l_comp1->dy != l_comp2->dy ||
+                l_comp1->w != l_comp2->w || l_comp1->h != l_comp2->h ||
+                l_comp1->x0 != l_comp2->x0 || l_comp1->y0 != l_comp2->y0 ||
+                l_comp1->prec != l_comp2->prec || l_comp1->sgnd != l_comp2->sgnd) {
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
 OPJ_BOOL opj_j2k_start_compress(opj_j2k_t *p_j2k,
                                 opj_stream_private_t *p_stream,
                                 opj_image_t * p_image,
@@ -12194,6 +13027,31 @@ OPJ_BOOL opj_j2k_start_compress(opj_j2k_t *p_j2k,
     assert(p_stream != 00);
     assert(p_manager != 00);
 
+    if (p_j2k->m_private_image) {
+        /* The codec has already been used to compress an image: its coding */
+        /* parameters and tile coder are reused, which requires the same */
+        /* image geometry */
+        if (! opj_j2k_is_same_image_geometry(p_j2k->m_private_image, p_image)) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "The image to compress does not have the same geometry "
+                          "as the previous one.\n");
+            return OPJ_FALSE;
+        }
+        opj_image_destroy(p_j2k->m_private_image);
+        p_j2k->m_private_image = 00;
+
+        /* A previous compression that did not complete may have left */
+        /* the tile coder in the middle of a tile */
+        if (p_j2k->m_tcd && p_j2k->m_tcd->line_encoder) {
+            opj_tcd_destroy(p_j2k->m_tcd);
+            p_j2k->m_tcd = 00;
+        }
+    }
+    p_j2k->m_current_tile_number = 0;
+    p_j2k->m_specific_param.m_encoder.m_current_poc_tile_part_number = 0;
+    p_j2k->m_specific_param.m_encoder.m_current_tile_part_number = 0;
+    p_j2k->m_specific_param.m_encoder.m_strip_nb_lines = 0;
+
     p_j2k->m_private_image = opj_image_create0();
     if (! p_j2k->m_private_image) {
         opj_event_msg(p_manager, EVT_ERROR, "Failed to allocate image header.");
@@ -12213,6 +13071,19 @@ OPJ_BOOL opj_j2k_start_compress(opj_j2k_t *p_j2k,
         }
     }
 
+    if (p_j2k->m_cp.m_specific_param.m_enc.m_lazy_no_distortion) {
+        /* Use the arithmetic coding bypass on all code-blocks. This must be */
+        /* done before the COD/COC marker segments are written */
+        OPJ_UINT32 l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
+        OPJ_UINT32 tileno, compno;
+        for (tileno = 0; tileno < l_nb_tiles; ++tileno) {
+            opj_tcp_t *l_tcp = &p_j2k->m_cp.tcps[tileno];
+            for (compno = 0; compno < p_image->numcomps; ++compno) {
+                l_tcp->tccps[compno].cblksty |= J2K_CCP_CBLKSTY_LAZY;
+            }
+        }
+    }
+
     /* customization of the validation */
     if (! opj_j2k_setup_encoding_validation(p_j2k, p_manager)) {
         return OPJ_FALSE;
@@ -12460,10 +13331,6 @@ static OPJ_BOOL opj_j2k_setup_end_compress(opj_j2k_t *p_j2k,
                                            (opj_procedure)opj_j2k_end_encoding, p_manager)) {
         return OPJ_FALSE;
     }
-    if (! opj_procedure_list_add_procedure(p_j2k->m_procedure_list,
-                                           (opj_procedure)opj_j2k_destroy_header_memory, p_manager)) {
-        return OPJ_FALSE;
-    }
     return OPJ_TRUE;
 }
 
@@ -12835,8 +13702,9 @@ static OPJ_BOOL opj_j2k_end_encoding(opj_j2k_t *p_j2k,
     OPJ_UNUSED(p_stream);
     OPJ_UNUSED(p_manager);
 
-    opj_tcd_destroy(p_j2k->m_tcd);
-    p_j2k->m_tcd = 00;
+    /* The tile coder, m_encoded_tile_data and m_header_tile_data are kept */
+    /* until opj_j2k_destroy(), so that they can be reused if the codec is */
+    /* used to compress another image */
 
     if (p_j2k->m_specific_param.m_encoder.m_tlm_sot_offsets_buffer) {
         opj_free(p_j2k->m_specific_param.m_encoder.m_tlm_sot_offsets_buffer);
@@ -12844,38 +13712,10 @@ static OPJ_BOOL opj_j2k_end_encoding(opj_j2k_t *p_j2k,
         p_j2k->m_specific_param.m_encoder.m_tlm_sot_offsets_current = 0;
     }
 
-    if (p_j2k->m_specific_param.m_encoder.m_encoded_tile_data) {
-        opj_free(p_j2k->m_specific_param.m_encoder.m_encoded_tile_data);
-        p_j2k->m_specific_param.m_encoder.m_encoded_tile_data = 0;
-    }
-
-    p_j2k->m_specific_param.m_encoder.m_encoded_tile_size = 0;
-
-    return OPJ_TRUE;
-}
-
-/**
- * Destroys the memory associated with the decoding of headers.
- */
-static OPJ_BOOL opj_j2k_destroy_header_memory(opj_j2k_t * p_j2k,
-        opj_stream_private_t *p_stream,
-        opj_event_mgr_t * p_manager
-                                             )
-{
-    /* preconditions */
-    assert(p_j2k != 00);
-    assert(p_stream != 00);
-    assert(p_manager != 00);
-
-    OPJ_UNUSED(p_stream);
-    OPJ_UNUSED(p_manager);
-
-    if (p_j2k->m_specific_param.m_encoder.m_header_tile_data) {
-        opj_free(p_j2k->m_specific_param.m_encoder.m_header_tile_data);
-        p_j2k->m_specific_param.m_encoder.m_header_tile_data = 0;
-    }
-
-    p_j2k->m_specific_param.m_encoder.m_header_tile_data_size = 0;
+    opj_free(p_j2k->m_specific_param.m_encoder.m_strip_data);
+    p_j2k->m_specific_param.m_encoder.m_strip_data = 00;
+    p_j2k->m_specific_param.m_encoder.m_strip_data_size = 0;
+    p_j2k->m_specific_param.m_encoder.m_strip_nb_lines = 0;
 
     return OPJ_TRUE;
 }
@@ -12957,6 +13797,12 @@ static OPJ_BOOL opj_j2k_create_tcd(opj_j2k_t *p_j2k,
 
     OPJ_UNUSED(p_stream);
 
+    if (p_j2k->m_tcd) {
+        /* Reuse the tile coder of a previous compression */
+        p_j2k->m_tcd->image = p_j2k->m_private_image;
+        return OPJ_TRUE;
+    }
+
     p_j2k->m_tcd = opj_tcd_create(OPJ_FALSE);
 
     if (! p_j2k->m_tcd) {
@@ -12970,6 +13816,7 @@ static OPJ_BOOL opj_j2k_create_tcd(opj_j2k_t *p_j2k,
         p_j2k->m_tcd = 00;
         return OPJ_FALSE;
     }
+    p_j2k->m_tcd->interrupt = &p_j2k->m_interrupt;
 
     return OPJ_TRUE;
 }
@@ -12998,11 +13845,13 @@ OPJ_BOOL opj_j2k_write_tile(opj_j2k_t * p_j2k,
         }
 
         /* now copy data into the tile component */
+        OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
         if (! opj_tcd_copy_tile_data(p_j2k->m_tcd, p_data, p_data_size)) {
             opj_event_msg(p_manager, EVT_ERROR,
                           "Size mismatch between tile data and sent data.");
             return OPJ_FALSE;
         }
+        OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
         if (! opj_j2k_post_write_tile(p_j2k, p_stream, p_manager)) {
             opj_event_msg(p_manager, EVT_ERROR,
                           "Error while opj_j2k_post_write_tile with tile index = %d\n", p_tile_index);
@@ -13012,3 +13861,294 @@ OPJ_BOOL opj_j2k_write_tile(opj_j2k_t * p_j2k,
 
     return OPJ_TRUE;
 }
+
+/**
+ * Returns the number of bytes used by a sample of the component, as in
+ * opj_write_tile() / opj_write_strip().
+ */
+static OPJ_UINT32 opj_j2k_get_comp_sample_size(const opj_image_comp_t *
+        p_img_comp)
+{
+    OPJ_UINT32 l_size_comp = p_img_comp->prec >> 3; /* (/8) */
+    if (p_img_comp->prec & 7) {
+        l_size_comp += 1;
+    }
+    if (l_size_comp == 3) {
+        l_size_comp = 4;
+    }
+    return l_size_comp;
+}
+
+/**
+ * Fills the tile component data of the current tile from the lines of the
+ * current row of tiles buffered by opj_j2k_write_strip().
+ */
+static void opj_j2k_get_tile_data_from_strip(opj_j2k_t * p_j2k,
+        OPJ_UINT32 p_row_y0,
+        OPJ_UINT32 p_row_height)
+{
+    opj_tcd_t * l_tcd = p_j2k->m_tcd;
+    opj_image_t * l_image = l_tcd->image;
+    const OPJ_BYTE * l_comp_data = p_j2k->m_specific_param.m_encoder.m_strip_data;
+    OPJ_UINT32 compno, i, j;
+
+    for (compno = 0; compno < l_image->numcomps; ++compno) {
+        opj_image_comp_t * l_img_comp = l_image->comps + compno;
+        opj_tcd_tilecomp_t * l_tilec = l_tcd->tcd_image->tiles->comps + compno;
+        const OPJ_UINT32 l_size_comp = opj_j2k_get_comp_sample_size(l_img_comp);
+        const OPJ_UINT32 l_image_width = l_image->x1 - l_image->x0;
+        const OPJ_UINT32 l_width = (OPJ_UINT32)(l_tilec->x1 - l_tilec->x0);
+        const OPJ_UINT32 l_height = (OPJ_UINT32)(l_tilec->y1 - l_tilec->y0);
+        const OPJ_SIZE_T l_src_offset = (OPJ_SIZE_T)((OPJ_UINT32)l_tilec->y0 -
+                                        p_row_y0) * l_image_width +
+                                        ((OPJ_UINT32)l_tilec->x0 - l_image->x0);
+        OPJ_INT32 * l_dest_ptr = l_tilec->data;
+
+        switch (l_size_comp) {
+        case 1: {
+            const OPJ_BYTE * l_src_ptr = l_comp_data + l_src_offset;
+            for (j = 0; j < l_height; ++j) {
+                if (l_img_comp->sgnd) {
+                    for (i = 0; i < l_width; ++i) {
+                        *(l_dest_ptr++) = (OPJ_INT32)(OPJ_CHAR)l_src_ptr[i];
+                    }
+                } else {
+                    for (i = 0; i < l_width; ++i) {
+                        *(l_dest_ptr++) = (OPJ_INT32)l_src_ptr[i];
+                    }
+                }
+                l_src_ptr += l_image_width;
+            }
+        }
+        break;
+        case 2: {
+            const OPJ_INT16 * l_src_ptr = (const OPJ_INT16 *) l_comp_data + l_src_offset;
+            for (j = 0; j < l_height; ++j) {
+                if (l_img_comp->sgnd) {
+                    for (i = 0; i < l_width; ++i) {
+                        *(l_dest_ptr++) = (OPJ_INT32)l_src_ptr[i];
+                    }
+                } else {
+                    for (i = 0; i < l_width; ++i) {
+                        *(l_dest_ptr++) = l_src_ptr[i] & 0xffff;
+                    }
+                }
+                l_src_ptr += l_image_width;
+            }
+        }
+        break;
+        case 4: {
+            const OPJ_INT32 * l_src_ptr = (const OPJ_INT32 *) l_comp_data + l_src_offset;
+            for (j = 0; j < l_height; ++j) {
+                memcpy(l_dest_ptr, l_src_ptr, l_width * sizeof(OPJ_INT32));
+                l_dest_ptr += l_width;
+                l_src_ptr += l_image_width;
+            }
+        }
+        break;
+        }
+
+        l_comp_data += (OPJ_SIZE_T)l_image_width * p_row_height * l_size_comp;
+    }
+}
+
+/**
+ * Implementation of opj_j2k_write_strip() when tiles span the whole image
+ * width: lines are directly given to the line-based tile encoder, so that
+ * neither the row of tiles nor the tile component data need to be stored.
+ */
+static OPJ_BOOL opj_j2k_write_strip_lines(opj_j2k_t * p_j2k,
+        OPJ_UINT32 p_nb_lines,
+        const OPJ_BYTE * p_data,
+        opj_stream_private_t *p_stream,
+        opj_event_mgr_t * p_manager)
+{
+    opj_cp_t * l_cp = &(p_j2k->m_cp);
+    opj_image_t * l_image = p_j2k->m_private_image;
+    opj_j2k_enc_t * l_enc = &(p_j2k->m_specific_param.m_encoder);
+    const OPJ_UINT32 l_nb_tiles = l_cp->tw * l_cp->th;
+    const OPJ_UINT32 l_image_width = l_image->x1 - l_image->x0;
+    const OPJ_BYTE ** l_src;
+    OPJ_UINT32 l_nb_lines_done = 0;
+    OPJ_UINT32 compno;
+    OPJ_BOOL l_ret = OPJ_TRUE;
+
+    l_src = (const OPJ_BYTE **) opj_malloc(l_image->numcomps * sizeof(
+            const OPJ_BYTE *));
+    if (! l_src) {
+        opj_event_msg(p_manager, EVT_ERROR, "Not enough memory to write strip\n");
+        return OPJ_FALSE;
+    }
+
+    while (l_ret && l_nb_lines_done < p_nb_lines) {
+        OPJ_UINT32 l_row_y0, l_row_y1, l_row_height, l_nb_lines;
+        const OPJ_BYTE * l_src_ptr = p_data;
+
+        if (p_j2k->m_current_tile_number >= l_nb_tiles) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "opj_write_strip(): more lines than image height.\n");
+            l_ret = OPJ_FALSE;
+            break;
+        }
+
+        l_row_y0 = opj_uint_max(l_cp->ty0 + p_j2k->m_current_tile_number * l_cp->tdy,
+                                l_image->y0);
+        l_row_y1 = opj_uint_min(l_cp->ty0 + (p_j2k->m_current_tile_number + 1) *
+                                l_cp->tdy, l_image->y1);
+        l_row_height = l_row_y1 - l_row_y0;
+
+        if (l_enc->m_strip_nb_lines == 0) {
+            if (! opj_j2k_pre_write_tile(p_j2k, p_j2k->m_current_tile_number,
+                                         p_stream, p_manager) ||
+                    ! opj_tcd_start_encode_tile_lines(p_j2k->m_tcd,
+                            p_j2k->m_current_tile_number, p_manager)) {
+                l_ret = OPJ_FALSE;
+                break;
+            }
+        }
+
+        l_nb_lines = opj_uint_min(p_nb_lines - l_nb_lines_done,
+                                  l_row_height - l_enc->m_strip_nb_lines);
+
+        for (compno = 0; compno < l_image->numcomps; ++compno) {
+            const OPJ_SIZE_T l_comp_line_size = (OPJ_SIZE_T)l_image_width *
+                                                opj_j2k_get_comp_sample_size(l_image->comps + compno);
+            l_src[compno] = l_src_ptr + l_comp_line_size * l_nb_lines_done;
+            l_src_ptr += l_comp_line_size * p_nb_lines;
+        }
+        if (! opj_tcd_encode_tile_lines(p_j2k->m_tcd, l_nb_lines, l_src,
+                                        p_manager)) {
+            l_ret = OPJ_FALSE;
+            break;
+        }
+        l_enc->m_strip_nb_lines += l_nb_lines;
+        l_nb_lines_done += l_nb_lines;
+
+        if (l_enc->m_strip_nb_lines == l_row_height) {
+            l_enc->m_strip_nb_lines = 0;
+            if (! opj_j2k_post_write_tile(p_j2k, p_stream, p_manager)) {
+                l_ret = OPJ_FALSE;
+            }
+        }
+    }
+
+    opj_free((void*)l_src);
+    return l_ret;
+}
+
+OPJ_BOOL opj_j2k_write_strip(opj_j2k_t * p_j2k,
+                             OPJ_UINT32 p_nb_lines,
+                             const OPJ_BYTE * p_data,
+                             OPJ_SIZE_T p_data_size,
+                             opj_stream_private_t *p_stream,
+                             opj_event_mgr_t * p_manager)
+{
+    opj_cp_t * l_cp = &(p_j2k->m_cp);
+    opj_image_t * l_image = p_j2k->m_private_image;
+    opj_j2k_enc_t * l_enc = &(p_j2k->m_specific_param.m_encoder);
+    const OPJ_UINT32 l_nb_tiles = l_cp->tw * l_cp->th;
+    const OPJ_UINT32 l_image_width = l_image->x1 - l_image->x0;
+    OPJ_SIZE_T l_line_size = 0;
+    OPJ_UINT32 l_nb_lines_done = 0;
+    OPJ_UINT32 compno;
+
+    for (compno = 0; compno < l_image->numcomps; ++compno) {
+        opj_image_comp_t * l_img_comp = l_image->comps + compno;
+        if (l_img_comp->dx != 1 || l_img_comp->dy != 1) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "opj_write_strip() does not support subsampled components.\n");
+            return OPJ_FALSE;
+        }
+        l_line_size += (OPJ_SIZE_T)l_image_width *
+                       opj_j2k_get_comp_sample_size(l_img_comp);
+    }
+
+    if (p_nb_lines == 0 || l_line_size * p_nb_lines != p_data_size) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Size mismatch between strip data and number of lines.\n");
+        return OPJ_FALSE;
+    }
+
+    if (l_cp->tw == 1) {
+        return opj_j2k_write_strip_lines(p_j2k, p_nb_lines, p_data, p_stream,
+                                         p_manager);
+    }
+
+    while (l_nb_lines_done < p_nb_lines) {
+        OPJ_UINT32 l_tile_row, l_row_y0, l_row_y1, l_row_height, l_nb_lines;
+        const OPJ_BYTE * l_src_ptr = p_data;
+        OPJ_BYTE * l_dest_ptr;
+
+        if (p_j2k->m_current_tile_number >= l_nb_tiles) {
+            opj_event_msg(p_manager, EVT_ERROR,
+                          "opj_write_strip(): more lines than image height.\n");
+            return OPJ_FALSE;
+        }
+
+        l_tile_row = p_j2k->m_current_tile_number / l_cp->tw;
+        l_row_y0 = opj_uint_max(l_cp->ty0 + l_tile_row * l_cp->tdy, l_image->y0);
+        l_row_y1 = opj_uint_min(l_cp->ty0 + (l_tile_row + 1) * l_cp->tdy,
+                                l_image->y1);
+        l_row_height = l_row_y1 - l_row_y0;
+
+        if (l_enc->m_strip_data == 00) {
+            /* The first row of tiles may be shorter than the next ones */
+            OPJ_UINT32 l_max_row_height = opj_uint_min(l_cp->tdy,
+                                          l_image->y1 - l_image->y0);
+            l_enc->m_strip_data_size = l_line_size * l_max_row_height;
+            l_enc->m_strip_data = (OPJ_BYTE *) opj_malloc(l_enc->m_strip_data_size);
+            if (! l_enc->m_strip_data) {
+                l_enc->m_strip_data_size = 0;
+                opj_event_msg(p_manager, EVT_ERROR,
+                              "Not enough memory to buffer a row of tiles\n");
+                return OPJ_FALSE;
+            }
+            l_enc->m_strip_nb_lines = 0;
+        }
+
+        l_nb_lines = opj_uint_min(p_nb_lines - l_nb_lines_done,
+                                  l_row_height - l_enc->m_strip_nb_lines);
+
+        /* Append the lines, component by component */
+        l_dest_ptr = l_enc->m_strip_data;
+        for (compno = 0; compno < l_image->numcomps; ++compno) {
+            const OPJ_SIZE_T l_comp_line_size = (OPJ_SIZE_T)l_image_width *
+                                                opj_j2k_get_comp_sample_size(l_image->comps + compno);
+            memcpy(l_dest_ptr + l_comp_line_size * l_enc->m_strip_nb_lines,
+                   l_src_ptr + l_comp_line_size * l_nb_lines_done,
+                   l_comp_line_size * l_nb_lines);
+            l_dest_ptr += l_comp_line_size * l_row_height;
+            l_src_ptr += l_comp_line_size * p_nb_lines;
+        }
+        l_enc->m_strip_nb_lines += l_nb_lines;
+        l_nb_lines_done += l_nb_lines;
+
+        if (l_enc->m_strip_nb_lines == l_row_height) {
+            /* The row of tiles is complete: encode all its tiles */
+            OPJ_UINT32 l_end_tile = (l_tile_row + 1) * l_cp->tw;
+
+            while (p_j2k->m_current_tile_number < l_end_tile) {
+                if (! opj_j2k_pre_write_tile(p_j2k, p_j2k->m_current_tile_number,
+                                             p_stream, p_manager)) {
+                    return OPJ_FALSE;
+                }
+                for (compno = 0; compno < l_image->numcomps; ++compno) {
+                    opj_tcd_tilecomp_t* l_tilec = p_j2k->m_tcd->tcd_image->tiles->comps +
+                                                  compno;
+                    if (! opj_alloc_tile_component_data(l_tilec)) {
+                        opj_event_msg(p_manager, EVT_ERROR,
+                                      "Error allocating tile component data.");
+                        return OPJ_FALSE;
+                    }
+                }
+                opj_j2k_get_tile_data_from_strip(p_j2k, l_row_y0, l_row_height);
+                if (! opj_j2k_post_write_tile(p_j2k, p_stream, p_manager)) {
+                    return OPJ_FALSE;
+                }
+            }
+            l_enc->m_strip_nb_lines = 0;
+        }
+    }
+
+    return OPJ_TRUE;
+}
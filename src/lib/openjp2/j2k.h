@@ -280,6 +280,12 @@ typedef struct opj_tcp {
     OPJ_BYTE *      m_data;
     /** size of data */
     OPJ_UINT32      m_data_size;
+    /** lengths of the packets of m_data, as signalled by PLT markers (decoder only) */
+    OPJ_UINT32 *    m_packet_lengths;
+    /** number of packet lengths in m_packet_lengths */
+    OPJ_UINT32      m_nb_packet_lengths;
+    /** number of packet lengths m_packet_lengths can hold */
+    OPJ_UINT32      m_nb_max_packet_lengths;
     /** encoding norms */
     OPJ_FLOAT64 *   mct_norms;
     /** the mct decoding matrix */
@@ -307,6 +313,10 @@ typedef struct opj_tcp {
     OPJ_BITFIELD ppt : 1;
     /** indicates if a POC marker has been used O:NO, 1:YES */
     OPJ_BITFIELD POC : 1;
+    /** If initialized == 1 --> the parameters of the tile have been set from the default ones (decoder only) */
+    OPJ_BITFIELD initialized : 1;
+    /** If shares_default == 1 --> tccps, the MCT/MCC records and the MCT decoding matrix belong to the default tile parameters, and must be copied before being modified (decoder only) */
+    OPJ_BITFIELD shares_default : 1;
 } opj_tcp_t;
 
 
@@ -329,6 +339,10 @@ typedef struct opj_encoding_param {
     OPJ_BITFIELD m_fixed_quality : 1;
     /** Enabling Tile part generation*/
     OPJ_BITFIELD m_tp_on : 1;
+    /** Selective arithmetic coding bypass on all code-blocks, without
+     * distortion estimation for lossless encoding (LAZY_NO_DISTORTION extra
+     * option), trading compression efficiency for encoding speed */
+    OPJ_BITFIELD m_lazy_no_distortion : 1;
 }
 opj_encoding_param_t;
 
@@ -337,9 +351,31 @@ typedef struct opj_decoding_param {
     OPJ_UINT32 m_reduce;
     /** if != 0, then only the first "layer" layers are decoded; if == 0 or not used, all the quality layers are decoded */
     OPJ_UINT32 m_layer;
+    /** if != 0, the Tier-1 decoding state of code-blocks is kept in the code-block cache, see OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG */
+    OPJ_BOOL m_progressive_refinement;
+    /** if != 0, at most "max_passes" coding passes are decoded per code-block; if == 0, all the coding passes are decoded */
+    OPJ_UINT32 m_max_passes;
+    /** if != 0 (non strict mode), a truncated codestream is decoded up to the end of its data instead of being rejected */
+    OPJ_BOOL m_allow_truncated;
+    /** if != 0, decoding stops "deadline_ms" milliseconds after its start, see opj_decoder_set_deadline() */
+    OPJ_UINT32 m_deadline_ms;
 }
 opj_decoding_param_t;
 
+/**
+ * Requests to stop the decoding or encoding in progress, shared between the
+ * thread running it, its Tier-1 jobs, and the application threads.
+ */
+typedef struct opj_interrupt {
+    /** Set by opj_cancel(), from any thread: the operation fails */
+    volatile OPJ_BOOL cancelled;
+    /** Value of opj_wall_clock() from which no more code-blocks and tiles are decoded, or 0 */
+    OPJ_FLOAT64 deadline;
+    /** Set by the Tier-1 decoding jobs that left code-blocks undecoded because of the deadline */
+    volatile OPJ_BOOL cblks_skipped;
+}
+opj_interrupt_t;
+
 
 /**
  * Coding parameters
@@ -486,6 +522,12 @@ typedef struct opj_j2k_dec {
     OPJ_UINT32   m_numcomps_to_decode;
     OPJ_UINT32  *m_comps_indices_to_decode;
 
+    /** Sum of the tile-part lengths of each tile, read from the TLM markers */
+    /** (NULL if the main header has none) */
+    OPJ_UINT64  *m_tlm_tile_lengths;
+    /** Number of tile-parts described by the TLM markers read so far */
+    OPJ_UINT32   m_tlm_nb_tile_parts;
+
     /** to tell that a tile can be decoded. */
     OPJ_BITFIELD m_can_decode : 1;
     OPJ_BITFIELD m_discard_tiles : 1;
@@ -493,6 +535,8 @@ typedef struct opj_j2k_dec {
     /** TNsot correction : see issue 254 **/
     OPJ_BITFIELD m_nb_tile_parts_correction_checked : 1;
     OPJ_BITFIELD m_nb_tile_parts_correction : 1;
+    /** TLM markers inconsistent with the SIZ marker, m_tlm_tile_lengths ignored */
+    OPJ_BITFIELD m_tlm_invalid : 1;
 
 } opj_j2k_dec_t;
 
@@ -540,6 +584,20 @@ typedef struct opj_j2k_enc {
     /* reserved bytes in m_encoded_tile_size for PLT markers */
     OPJ_UINT32 m_reserved_bytes_for_PLT;
 
+    /* lines of the current row of tiles received by opj_j2k_write_strip() */
+    OPJ_BYTE * m_strip_data;
+
+    /* size of m_strip_data */
+    OPJ_SIZE_T m_strip_data_size;
+
+    /* number of lines of the current row of tiles already in m_strip_data */
+    OPJ_UINT32 m_strip_nb_lines;
+
+    /* rates of the layers of each tile, as set by opj_j2k_setup_encoder(), */
+    /* before their conversion by opj_j2k_update_rates(). Used to restore */
+    /* them when the codec is reused for another image */
+    OPJ_FLOAT32 * m_setup_rates;
+
 } opj_j2k_enc_t;
 
 
@@ -586,6 +644,12 @@ typedef struct opj_j2k {
     /** Thread pool */
     opj_thread_pool_t* m_tp;
 
+    /** Cache of decoded code-blocks (decoder only), or NULL if disabled */
+    struct opj_t1_cblk_cache* m_cblk_cache;
+
+    /** Cancellation and deadline of the operation in progress */
+    opj_interrupt_t m_interrupt;
+
     /** Image width coming from JP2 IHDR box. 0 from a pure codestream */
     OPJ_UINT32 ihdr_w;
 
@@ -614,6 +678,62 @@ void opj_j2k_setup_decoder(opj_j2k_t *j2k, opj_dparameters_t *parameters);
 
 OPJ_BOOL opj_j2k_set_threads(opj_j2k_t *j2k, OPJ_UINT32 num_threads);
 
+/**
+ * Sets the budget of the cache of decoded code-blocks of a decompressor
+ * (see opj_decoder_set_cblk_cache_size()).
+ *
+ * @param j2k       J2K decompressor handle
+ * @param max_size  budget of the cache in bytes, 0 to disable it
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_j2k_set_cblk_cache_size(opj_j2k_t *j2k, OPJ_SIZE_T max_size,
+                                     opj_event_mgr_t * p_manager);
+
+/**
+ * Sets the maximum number of coding passes decoded per code-block
+ * (see opj_decoder_set_max_cblk_passes()).
+ *
+ * @param j2k        J2K decompressor handle
+ * @param max_passes maximum number of coding passes, 0 for no limit
+ * @param p_manager  the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_j2k_set_max_cblk_passes(opj_j2k_t *j2k, OPJ_UINT32 max_passes,
+                                     opj_event_mgr_t * p_manager);
+
+/**
+ * Sets the strict mode of a decompressor (see opj_decoder_set_strict_mode()).
+ *
+ * @param j2k       J2K decompressor handle
+ * @param strict    OPJ_FALSE to decode truncated codestreams as far as possible
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_j2k_set_strict_mode(opj_j2k_t *j2k, OPJ_BOOL strict,
+                                 opj_event_mgr_t * p_manager);
+
+/**
+ * Sets the time after which a decompressor stops decoding
+ * (see opj_decoder_set_deadline()).
+ *
+ * @param j2k         J2K decompressor handle
+ * @param deadline_ms duration of the decoding in milliseconds, 0 for no limit
+ * @param p_manager   the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_j2k_set_deadline(opj_j2k_t *j2k, OPJ_UINT32 deadline_ms,
+                              opj_event_mgr_t * p_manager);
+
+/**
+ * Returns the requests to stop the decoding or encoding in progress, that
+ * opj_cancel() sets.
+ *
+ * @param j2k   J2K codec handle
+ * @return the interruption requests of the codec.
+ */
+opj_interrupt_t* opj_j2k_get_interrupt(opj_j2k_t *j2k);
+
 /**
  * Creates a J2K compression structure
  *
@@ -645,6 +765,36 @@ OPJ_BOOL opj_j2k_end_decompress(opj_j2k_t *j2k,
                                 opj_stream_private_t *p_stream,
                                 opj_event_mgr_t * p_manager);
 
+/**
+ * Resets a decompressor so that it can read another codestream.
+ *
+ * The state linked to the previous codestream is discarded, but the
+ * decoding parameters, the thread pool and the tile decoder are kept, so
+ * that decoding a series of similar codestreams does not need to allocate
+ * them again.
+ *
+ * @param p_j2k     the jpeg2000 codec.
+ * @param p_manager the user event manager.
+ *
+ * @return true if the codec could be reset.
+ */
+OPJ_BOOL opj_j2k_decoder_reset(opj_j2k_t *p_j2k,
+                               opj_event_mgr_t * p_manager);
+
+/**
+ * Parses the SIZ, COD and QCD markers at the beginning of a codestream held
+ * in memory, without allocating anything (see opj_probe_header()).
+ *
+ * @param p_data        the beginning of the codestream (SOC marker).
+ * @param p_data_size   the number of bytes available in p_data.
+ * @param p_info        the structure to fill, whose has_cod and has_qcd members must be cleared.
+ *
+ * @return OPJ_TRUE if a valid SIZ marker was found.
+ */
+OPJ_BOOL opj_j2k_probe_header(const OPJ_BYTE * p_data,
+                              OPJ_SIZE_T p_data_size,
+                              opj_header_info_t * p_info);
+
 /**
  * Reads a jpeg2000 codestream header structure.
  *
@@ -752,6 +902,24 @@ OPJ_BOOL opj_j2k_set_decode_area(opj_j2k_t *p_j2k,
                                  OPJ_INT32 p_end_x, OPJ_INT32 p_end_y,
                                  opj_event_mgr_t * p_manager);
 
+/**
+ * Estimates the resources needed to decode the area set by
+ * opj_j2k_set_decode_area() (see opj_estimate_decode()).
+ *
+ * @param   p_j2k           the jpeg2000 codec.
+ * @param   p_stream        input stream, positioned after the main header.
+ * @param   p_image         the image returned by opj_j2k_read_header(), with the decoded area.
+ * @param   p_estimate      the estimated resources.
+ * @param   p_manager       the user event manager
+ *
+ * @return  true            if the main header has been read.
+ */
+OPJ_BOOL opj_j2k_estimate_decode(opj_j2k_t *p_j2k,
+                                 opj_stream_private_t *p_stream,
+                                 opj_image_t* p_image,
+                                 opj_decode_estimate_t* p_estimate,
+                                 opj_event_mgr_t * p_manager);
+
 /**
  * Creates a J2K decompression structure.
  *
@@ -864,6 +1032,25 @@ OPJ_BOOL opj_j2k_write_tile(opj_j2k_t * p_j2k,
                             opj_stream_private_t *p_stream,
                             opj_event_mgr_t * p_manager);
 
+/**
+ * Writes a strip of image lines. Each time a row of tiles is complete, its
+ * tiles are encoded and written, so that only the lines of the current row of
+ * tiles are kept in memory. When there is a single column of tiles, lines are
+ * given directly to the line-based tile encoder (opj_tcd_encode_tile_lines()).
+ * @param   p_j2k       the jpeg2000 codec.
+ * @param   p_nb_lines  number of image lines in p_data.
+ * @param   p_data      lines for component 0, then for component 1, etc.
+ * @param   p_data_size size of p_data, to check it is consistent.
+ * @param   p_stream    the stream to write data to.
+ * @param   p_manager   the user event manager.
+ */
+OPJ_BOOL opj_j2k_write_strip(opj_j2k_t * p_j2k,
+                             OPJ_UINT32 p_nb_lines,
+                             const OPJ_BYTE * p_data,
+                             OPJ_SIZE_T p_data_size,
+                             opj_stream_private_t *p_stream,
+                             opj_event_mgr_t * p_manager);
+
 /**
  * Encodes an image into a JPEG-2000 codestream
  */
@@ -871,6 +1058,19 @@ OPJ_BOOL opj_j2k_encode(opj_j2k_t * p_j2k,
                         opj_stream_private_t *cio,
                         opj_event_mgr_t * p_manager);
 
+/**
+ * Encodes an image into a JPEG-2000 codestream, reading the samples from an
+ * interleaved buffer instead of the image component planes.
+ * @param   p_j2k       the jpeg2000 codec.
+ * @param   p_buffer    the interleaved input buffer.
+ * @param   cio         the stream to write data to.
+ * @param   p_manager   the user event manager.
+ */
+OPJ_BOOL opj_j2k_encode_interleaved(opj_j2k_t * p_j2k,
+                                    const opj_interleaved_buffer_t *p_buffer,
+                                    opj_stream_private_t *cio,
+                                    opj_event_mgr_t * p_manager);
+
 /**
  * Starts a compression scheme, i.e. validates the codec parameters, writes the header.
  *
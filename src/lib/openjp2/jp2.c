@@ -279,6 +279,11 @@ static OPJ_BOOL opj_jp2_apply_pclr(opj_image_t *image,
 
 static void opj_jp2_free_pclr(opj_jp2_color_t *color);
 
+/**
+ * Frees the data read from the JP2 boxes.
+ */
+static void opj_jp2_free_boxes_data(opj_jp2_t *jp2);
+
 /**
  * Collect palette data
  *
@@ -1906,6 +1911,35 @@ OPJ_BOOL opj_jp2_set_threads(opj_jp2_t *jp2, OPJ_UINT32 num_threads)
     return opj_j2k_set_threads(jp2->j2k, num_threads);
 }
 
+OPJ_BOOL opj_jp2_set_cblk_cache_size(opj_jp2_t *jp2, OPJ_SIZE_T max_size,
+                                     opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_set_cblk_cache_size(jp2->j2k, max_size, p_manager);
+}
+
+OPJ_BOOL opj_jp2_set_max_cblk_passes(opj_jp2_t *jp2, OPJ_UINT32 max_passes,
+                                     opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_set_max_cblk_passes(jp2->j2k, max_passes, p_manager);
+}
+
+OPJ_BOOL opj_jp2_set_strict_mode(opj_jp2_t *jp2, OPJ_BOOL strict,
+                                 opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_set_strict_mode(jp2->j2k, strict, p_manager);
+}
+
+OPJ_BOOL opj_jp2_set_deadline(opj_jp2_t *jp2, OPJ_UINT32 deadline_ms,
+                              opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_set_deadline(jp2->j2k, deadline_ms, p_manager);
+}
+
+opj_interrupt_t* opj_jp2_get_interrupt(opj_jp2_t *jp2)
+{
+    return opj_j2k_get_interrupt(jp2->j2k);
+}
+
 /* ----------------------------------------------------------------------- */
 /* JP2 encoder interface                                             */
 /* ----------------------------------------------------------------------- */
@@ -2104,6 +2138,14 @@ OPJ_BOOL opj_jp2_encode(opj_jp2_t *jp2,
     return opj_j2k_encode(jp2->j2k, stream, p_manager);
 }
 
+OPJ_BOOL opj_jp2_encode_interleaved(opj_jp2_t *jp2,
+                                    const opj_interleaved_buffer_t *p_buffer,
+                                    opj_stream_private_t *stream,
+                                    opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_encode_interleaved(jp2->j2k, p_buffer, stream, p_manager);
+}
+
 OPJ_BOOL opj_jp2_end_decompress(opj_jp2_t *jp2,
                                 opj_stream_private_t *cio,
                                 opj_event_mgr_t * p_manager
@@ -2832,6 +2874,136 @@ static OPJ_BOOL opj_jp2_read_boxhdr_char(opj_jp2_box_t *box,
     return OPJ_TRUE;
 }
 
+/**
+ * Reads the header of the box at p_data for opj_jp2_probe_header().
+ *
+ * @return the size of the box header (8 or 16), or 0 if it is not complete or
+ * invalid. *p_box_length is set to the total length of the box, or to 0 if
+ * the box extends to the end of the file.
+ */
+static OPJ_UINT32 opj_jp2_probe_box(const OPJ_BYTE * p_data,
+                                    OPJ_SIZE_T p_data_size,
+                                    OPJ_UINT64 * p_box_length,
+                                    OPJ_UINT32 * p_box_type)
+{
+    OPJ_UINT32 l_length, l_xl_part;
+
+    if (p_data_size < 8) {
+        return 0;
+    }
+    opj_read_bytes(p_data, &l_length, 4);
+    opj_read_bytes(p_data + 4, p_box_type, 4);
+    if (l_length == 0) {
+        *p_box_length = 0;
+        return 8;
+    }
+    if (l_length != 1) {
+        *p_box_length = l_length;
+        return l_length >= 8 ? 8 : 0;
+    }
+    if (p_data_size < 16) {
+        return 0;
+    }
+    opj_read_bytes(p_data + 8, &l_xl_part, 4);
+    *p_box_length = (OPJ_UINT64)l_xl_part << 32;
+    opj_read_bytes(p_data + 12, &l_xl_part, 4);
+    *p_box_length |= l_xl_part;
+    return *p_box_length >= 16 ? 16 : 0;
+}
+
+OPJ_BOOL opj_jp2_probe_header(const OPJ_BYTE * p_data,
+                              OPJ_SIZE_T p_data_size,
+                              opj_header_info_t * p_info)
+{
+    OPJ_SIZE_T l_pos = 0;
+    OPJ_UINT32 l_nb_boxes = 0;
+    OPJ_BOOL l_has_ihdr = OPJ_FALSE;
+    OPJ_BOOL l_has_colr = OPJ_FALSE;
+
+    p_info->color_space = OPJ_CLRSPC_UNKNOWN;
+
+    for (;;) {
+        OPJ_UINT64 l_box_length;
+        OPJ_UINT32 l_box_type;
+        OPJ_SIZE_T l_box_size;
+        OPJ_UINT32 l_header_size = opj_jp2_probe_box(p_data + l_pos,
+                                   p_data_size - l_pos, &l_box_length, &l_box_type);
+        if (l_header_size == 0) {
+            return OPJ_FALSE;
+        }
+
+        /* The signature box must come first, followed by the file type box */
+        if ((l_nb_boxes == 0 && l_box_type != JP2_JP) ||
+                (l_nb_boxes == 1 && l_box_type != JP2_FTYP)) {
+            return OPJ_FALSE;
+        }
+        ++l_nb_boxes;
+
+        if (l_box_type == JP2_JP2C) {
+            if (!l_has_ihdr) {
+                return OPJ_FALSE;
+            }
+            l_pos += l_header_size;
+            l_box_size = p_data_size - l_pos;
+            if (l_box_length != 0 && l_box_length - l_header_size < l_box_size) {
+                l_box_size = (OPJ_SIZE_T)(l_box_length - l_header_size);
+            }
+            return opj_j2k_probe_header(p_data + l_pos, l_box_size, p_info);
+        }
+
+        /* Other boxes must be complete to go on to the next one */
+        if (l_box_length == 0 || l_box_length > p_data_size - l_pos) {
+            return OPJ_FALSE;
+        }
+        l_box_size = (OPJ_SIZE_T)l_box_length;
+
+        if (l_box_type == JP2_JP2H) {
+            OPJ_SIZE_T l_sub_pos = l_header_size;
+            while (l_sub_pos < l_box_size) {
+                OPJ_UINT64 l_sub_length;
+                OPJ_UINT32 l_sub_type;
+                const OPJ_BYTE * l_sub_data = p_data + l_pos + l_sub_pos;
+                OPJ_UINT32 l_sub_header_size = opj_jp2_probe_box(l_sub_data,
+                                               l_box_size - l_sub_pos, &l_sub_length, &l_sub_type);
+                if (l_sub_header_size == 0 || l_sub_length == 0 ||
+                        l_sub_length > l_box_size - l_sub_pos) {
+                    return OPJ_FALSE;
+                }
+                if (l_sub_type == JP2_IHDR) {
+                    l_has_ihdr = OPJ_TRUE;
+                } else if (l_sub_type == JP2_COLR && !l_has_colr &&
+                           l_sub_length >= l_sub_header_size + 3) {
+                    /* Only the first colour specification box is used, */
+                    /* as in opj_jp2_read_colr() */
+                    OPJ_UINT32 l_meth, l_enumcs;
+                    l_sub_data += l_sub_header_size;
+                    opj_read_bytes(l_sub_data, &l_meth, 1);         /* METH */
+                    if (l_meth == 1 && l_sub_length >= l_sub_header_size + 7) {
+                        opj_read_bytes(l_sub_data + 3, &l_enumcs, 4); /* EnumCS */
+                        /* Same mapping as in opj_jp2_read_header() */
+                        if (l_enumcs == 16) {
+                            p_info->color_space = OPJ_CLRSPC_SRGB;
+                        } else if (l_enumcs == 17) {
+                            p_info->color_space = OPJ_CLRSPC_GRAY;
+                        } else if (l_enumcs == 18) {
+                            p_info->color_space = OPJ_CLRSPC_SYCC;
+                        } else if (l_enumcs == 24) {
+                            p_info->color_space = OPJ_CLRSPC_EYCC;
+                        } else if (l_enumcs == 12) {
+                            p_info->color_space = OPJ_CLRSPC_CMYK;
+                        }
+                    } else if (l_meth == 2) {
+                        p_info->has_icc_profile = OPJ_TRUE;
+                    }
+                    l_has_colr = OPJ_TRUE;
+                }
+                l_sub_pos += (OPJ_SIZE_T)l_sub_length;
+            }
+        }
+        l_pos += l_box_size;
+    }
+}
+
 OPJ_BOOL opj_jp2_read_header(opj_stream_private_t *p_stream,
                              opj_jp2_t *jp2,
                              opj_image_t ** p_image,
@@ -2997,6 +3169,17 @@ OPJ_BOOL opj_jp2_write_tile(opj_jp2_t *p_jp2,
                               p_stream, p_manager);
 }
 
+OPJ_BOOL opj_jp2_write_strip(opj_jp2_t *p_jp2,
+                             OPJ_UINT32 p_nb_lines,
+                             const OPJ_BYTE * p_data,
+                             OPJ_SIZE_T p_data_size,
+                             opj_stream_private_t *p_stream,
+                             opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_write_strip(p_jp2->j2k, p_nb_lines, p_data, p_data_size,
+                               p_stream, p_manager);
+}
+
 OPJ_BOOL opj_jp2_decode_tile(opj_jp2_t * p_jp2,
                              OPJ_UINT32 p_tile_index,
                              OPJ_BYTE * p_data,
@@ -3009,59 +3192,64 @@ OPJ_BOOL opj_jp2_decode_tile(opj_jp2_t * p_jp2,
                                p_stream, p_manager);
 }
 
-void opj_jp2_destroy(opj_jp2_t *jp2)
+static void opj_jp2_free_boxes_data(opj_jp2_t *jp2)
 {
-    if (jp2) {
-        /* destroy the J2K codec */
-        opj_j2k_destroy(jp2->j2k);
-        jp2->j2k = 00;
+    if (jp2->comps) {
+        opj_free(jp2->comps);
+        jp2->comps = 00;
+    }
 
-        if (jp2->comps) {
-            opj_free(jp2->comps);
-            jp2->comps = 00;
-        }
+    if (jp2->cl) {
+        opj_free(jp2->cl);
+        jp2->cl = 00;
+    }
 
-        if (jp2->cl) {
-            opj_free(jp2->cl);
-            jp2->cl = 00;
-        }
+    if (jp2->color.icc_profile_buf) {
+        opj_free(jp2->color.icc_profile_buf);
+        jp2->color.icc_profile_buf = 00;
+    }
 
-        if (jp2->color.icc_profile_buf) {
-            opj_free(jp2->color.icc_profile_buf);
-            jp2->color.icc_profile_buf = 00;
+    if (jp2->color.jp2_cdef) {
+        if (jp2->color.jp2_cdef->info) {
+            opj_free(jp2->color.jp2_cdef->info);
+            jp2->color.jp2_cdef->info = NULL;
         }
 
-        if (jp2->color.jp2_cdef) {
-            if (jp2->color.jp2_cdef->info) {
-                opj_free(jp2->color.jp2_cdef->info);
-                jp2->color.jp2_cdef->info = NULL;
-            }
+        opj_free(jp2->color.jp2_cdef);
+        jp2->color.jp2_cdef = 00;
+    }
 
-            opj_free(jp2->color.jp2_cdef);
-            jp2->color.jp2_cdef = 00;
+    if (jp2->color.jp2_pclr) {
+        if (jp2->color.jp2_pclr->cmap) {
+            opj_free(jp2->color.jp2_pclr->cmap);
+            jp2->color.jp2_pclr->cmap = NULL;
+        }
+        if (jp2->color.jp2_pclr->channel_sign) {
+            opj_free(jp2->color.jp2_pclr->channel_sign);
+            jp2->color.jp2_pclr->channel_sign = NULL;
+        }
+        if (jp2->color.jp2_pclr->channel_size) {
+            opj_free(jp2->color.jp2_pclr->channel_size);
+            jp2->color.jp2_pclr->channel_size = NULL;
+        }
+        if (jp2->color.jp2_pclr->entries) {
+            opj_free(jp2->color.jp2_pclr->entries);
+            jp2->color.jp2_pclr->entries = NULL;
         }
 
-        if (jp2->color.jp2_pclr) {
-            if (jp2->color.jp2_pclr->cmap) {
-                opj_free(jp2->color.jp2_pclr->cmap);
-                jp2->color.jp2_pclr->cmap = NULL;
-            }
-            if (jp2->color.jp2_pclr->channel_sign) {
-                opj_free(jp2->color.jp2_pclr->channel_sign);
-                jp2->color.jp2_pclr->channel_sign = NULL;
-            }
-            if (jp2->color.jp2_pclr->channel_size) {
-                opj_free(jp2->color.jp2_pclr->channel_size);
-                jp2->color.jp2_pclr->channel_size = NULL;
-            }
-            if (jp2->color.jp2_pclr->entries) {
-                opj_free(jp2->color.jp2_pclr->entries);
-                jp2->color.jp2_pclr->entries = NULL;
-            }
+        opj_free(jp2->color.jp2_pclr);
+        jp2->color.jp2_pclr = 00;
+    }
+}
 
-            opj_free(jp2->color.jp2_pclr);
-            jp2->color.jp2_pclr = 00;
-        }
+void opj_jp2_destroy(opj_jp2_t *jp2)
+{
+    if (jp2) {
+        /* destroy the J2K codec */
+        opj_j2k_destroy(jp2->j2k);
+        jp2->j2k = 00;
+
+        opj_jp2_free_boxes_data(jp2);
 
         if (jp2->m_validation_list) {
             opj_procedure_list_destroy(jp2->m_validation_list);
@@ -3077,6 +3265,43 @@ void opj_jp2_destroy(opj_jp2_t *jp2)
     }
 }
 
+OPJ_BOOL opj_jp2_decoder_reset(opj_jp2_t *jp2,
+                               opj_event_mgr_t * p_manager)
+{
+    /* preconditions */
+    assert(jp2 != 00);
+    assert(p_manager != 00);
+
+    opj_procedure_list_clear(jp2->m_procedure_list);
+    opj_procedure_list_clear(jp2->m_validation_list);
+
+    opj_jp2_free_boxes_data(jp2);
+    jp2->w = 0;
+    jp2->h = 0;
+    jp2->numcomps = 0;
+    jp2->bpc = 0;
+    jp2->C = 0;
+    jp2->UnkC = 0;
+    jp2->IPR = 0;
+    jp2->meth = 0;
+    jp2->approx = 0;
+    jp2->enumcs = 0;
+    jp2->precedence = 0;
+    jp2->brand = 0;
+    jp2->minversion = 0;
+    jp2->numcl = 0;
+    jp2->j2k_codestream_offset = 0;
+    jp2->jpip_iptr_offset = 0;
+    jp2->jp2_state = JP2_STATE_NONE;
+    jp2->jp2_img_state = JP2_IMG_STATE_NONE;
+    jp2->color.icc_profile_len = 0;
+    jp2->color.jp2_has_colr = 0;
+    jp2->has_jp2h = 0;
+    jp2->has_ihdr = 0;
+
+    return opj_j2k_decoder_reset(jp2->j2k, p_manager);
+}
+
 OPJ_BOOL opj_jp2_set_decoded_components(opj_jp2_t *p_jp2,
                                         OPJ_UINT32 numcomps,
                                         const OPJ_UINT32* comps_indices,
@@ -3098,6 +3323,16 @@ OPJ_BOOL opj_jp2_set_decode_area(opj_jp2_t *p_jp2,
                                    p_end_x, p_end_y, p_manager);
 }
 
+OPJ_BOOL opj_jp2_estimate_decode(opj_jp2_t *p_jp2,
+                                 opj_stream_private_t *p_stream,
+                                 opj_image_t* p_image,
+                                 opj_decode_estimate_t* p_estimate,
+                                 opj_event_mgr_t * p_manager)
+{
+    return opj_j2k_estimate_decode(p_jp2->j2k, p_stream, p_image, p_estimate,
+                                   p_manager);
+}
+
 OPJ_BOOL opj_jp2_get_tile(opj_jp2_t *p_jp2,
                           opj_stream_private_t *p_stream,
                           opj_image_t* p_image,
@@ -243,6 +243,63 @@ void opj_jp2_setup_decoder(opj_jp2_t *jp2, opj_dparameters_t *parameters);
  */
 OPJ_BOOL opj_jp2_set_threads(opj_jp2_t *jp2, OPJ_UINT32 num_threads);
 
+/** Sets the budget of the cache of decoded code-blocks.
+ *
+ * See opj_j2k_set_cblk_cache_size().
+ *
+ * @param jp2 JP2 decompressor handle
+ * @param max_size budget of the cache in bytes, 0 to disable it
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_jp2_set_cblk_cache_size(opj_jp2_t *jp2, OPJ_SIZE_T max_size,
+                                     opj_event_mgr_t * p_manager);
+
+/** Sets the maximum number of coding passes decoded per code-block.
+ *
+ * See opj_j2k_set_max_cblk_passes().
+ *
+ * @param jp2 JP2 decompressor handle
+ * @param max_passes maximum number of coding passes, 0 for no limit
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_jp2_set_max_cblk_passes(opj_jp2_t *jp2, OPJ_UINT32 max_passes,
+                                     opj_event_mgr_t * p_manager);
+
+/** Sets the strict mode of the decompressor.
+ *
+ * See opj_j2k_set_strict_mode().
+ *
+ * @param jp2 JP2 decompressor handle
+ * @param strict OPJ_FALSE to decode truncated codestreams as far as possible
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_jp2_set_strict_mode(opj_jp2_t *jp2, OPJ_BOOL strict,
+                                 opj_event_mgr_t * p_manager);
+
+/** Sets the time after which the decompressor stops decoding.
+ *
+ * See opj_j2k_set_deadline().
+ *
+ * @param jp2 JP2 decompressor handle
+ * @param deadline_ms duration of the decoding in milliseconds, 0 for no limit
+ * @param p_manager the user event manager
+ * @return OPJ_TRUE in case of success.
+ */
+OPJ_BOOL opj_jp2_set_deadline(opj_jp2_t *jp2, OPJ_UINT32 deadline_ms,
+                              opj_event_mgr_t * p_manager);
+
+/** Returns the requests to stop the decoding or encoding in progress.
+ *
+ * See opj_j2k_get_interrupt().
+ *
+ * @param jp2 JP2 codec handle
+ * @return the interruption requests of the codec.
+ */
+opj_interrupt_t* opj_jp2_get_interrupt(opj_jp2_t *jp2);
+
 /**
  * Decode an image from a JPEG-2000 file stream
  * @param jp2 JP2 decompressor handle
@@ -283,6 +340,20 @@ OPJ_BOOL opj_jp2_encode(opj_jp2_t *jp2,
                         opj_stream_private_t *stream,
                         opj_event_mgr_t * p_manager);
 
+/**
+Encode an image into a JPEG-2000 file stream, reading the samples from an
+interleaved buffer
+@param jp2      JP2 compressor handle
+@param p_buffer  interleaved input buffer
+@param stream    Output buffer stream
+@param p_manager  event manager
+@return Returns true if successful, returns false otherwise
+*/
+OPJ_BOOL opj_jp2_encode_interleaved(opj_jp2_t *jp2,
+                                    const opj_interleaved_buffer_t *p_buffer,
+                                    opj_stream_private_t *stream,
+                                    opj_event_mgr_t * p_manager);
+
 
 /**
  * Starts a compression scheme, i.e. validates the codec parameters, writes the header.
@@ -318,6 +389,33 @@ OPJ_BOOL opj_jp2_end_decompress(opj_jp2_t *jp2,
                                 opj_stream_private_t *cio,
                                 opj_event_mgr_t * p_manager);
 
+/**
+ * Resets a JP2 decompressor so that it can read another file.
+ * See opj_j2k_decoder_reset().
+ *
+ * @param jp2 the jpeg2000 file decompressor.
+ * @param p_manager the user event manager.
+ *
+ * @return true if the codec could be reset.
+ */
+OPJ_BOOL opj_jp2_decoder_reset(opj_jp2_t *jp2,
+                               opj_event_mgr_t * p_manager);
+
+/**
+ * Parses the boxes at the beginning of a JP2 file held in memory, up to the
+ * SIZ, COD and QCD markers of its codestream, without allocating anything
+ * (see opj_probe_header()).
+ *
+ * @param p_data        the beginning of the JP2 file.
+ * @param p_data_size   the number of bytes available in p_data.
+ * @param p_info        the structure to fill, whose has_* members must be cleared.
+ *
+ * @return OPJ_TRUE if the codestream box and a valid SIZ marker were found.
+ */
+OPJ_BOOL opj_jp2_probe_header(const OPJ_BYTE * p_data,
+                              OPJ_SIZE_T p_data_size,
+                              opj_header_info_t * p_info);
+
 /**
  * Reads a jpeg2000 file header structure.
  *
@@ -391,6 +489,23 @@ OPJ_BOOL opj_jp2_write_tile(opj_jp2_t *p_jp2,
                             opj_stream_private_t *p_stream,
                             opj_event_mgr_t * p_manager);
 
+/**
+ * Writes a strip of image lines.
+ *
+ * @param  p_jp2        the jpeg2000 codec.
+ * @param  p_nb_lines   number of image lines in p_data.
+ * @param  p_data       lines for component 0, then for component 1, etc.
+ * @param  p_data_size  size of p_data.
+ * @param  p_stream     the stream to write data to.
+ * @param  p_manager    the user event manager.
+ */
+OPJ_BOOL opj_jp2_write_strip(opj_jp2_t *p_jp2,
+                             OPJ_UINT32 p_nb_lines,
+                             const OPJ_BYTE * p_data,
+                             OPJ_SIZE_T p_data_size,
+                             opj_stream_private_t *p_stream,
+                             opj_event_mgr_t * p_manager);
+
 /**
  * Decode tile data.
  * @param  p_jp2    the jpeg2000 codec.
@@ -442,6 +557,26 @@ OPJ_BOOL opj_jp2_set_decode_area(opj_jp2_t *p_jp2,
                                  OPJ_INT32 p_end_x, OPJ_INT32 p_end_y,
                                  opj_event_mgr_t * p_manager);
 
+/**
+ * Estimates the resources needed to decode the area set by
+ * opj_jp2_set_decode_area().
+ *
+ * See opj_j2k_estimate_decode().
+ *
+ * @param  p_jp2        the jpeg2000 codec.
+ * @param  p_stream     input stream, positioned after the main header.
+ * @param  p_image      the image returned by opj_jp2_read_header(), with the decoded area.
+ * @param  p_estimate   the estimated resources.
+ * @param  p_manager    the user event manager
+ *
+ * @return  true      if the main header has been read.
+ */
+OPJ_BOOL opj_jp2_estimate_decode(opj_jp2_t *p_jp2,
+                                 opj_stream_private_t *p_stream,
+                                 opj_image_t* p_image,
+                                 opj_decode_estimate_t* p_estimate,
+                                 opj_event_mgr_t * p_manager);
+
 /**
 *
 */
@@ -130,6 +130,62 @@ static OPJ_BOOL opj_seek_from_file(OPJ_OFF_T p_nb_bytes, FILE * p_user_data)
     return OPJ_TRUE;
 }
 
+/* ---------------------------------------------------------------------- */
+
+/** Data pushed into a stream created by opj_stream_create_push_stream() */
+typedef struct opj_push_buffer {
+    OPJ_BYTE* m_data;
+    OPJ_SIZE_T m_size;
+    OPJ_SIZE_T m_capacity;
+    /** current read position */
+    OPJ_SIZE_T m_pos;
+} opj_push_buffer_t;
+
+static OPJ_SIZE_T opj_read_from_push_buffer(void * p_buffer,
+        OPJ_SIZE_T p_nb_bytes, opj_push_buffer_t* p_push_buffer)
+{
+    OPJ_SIZE_T l_nb_read;
+
+    if (p_push_buffer->m_pos >= p_push_buffer->m_size) {
+        return (OPJ_SIZE_T) - 1;
+    }
+    l_nb_read = p_push_buffer->m_size - p_push_buffer->m_pos;
+    if (l_nb_read > p_nb_bytes) {
+        l_nb_read = p_nb_bytes;
+    }
+    memcpy(p_buffer, p_push_buffer->m_data + p_push_buffer->m_pos, l_nb_read);
+    p_push_buffer->m_pos += l_nb_read;
+    return l_nb_read;
+}
+
+static OPJ_OFF_T opj_skip_from_push_buffer(OPJ_OFF_T p_nb_bytes,
+        opj_push_buffer_t* p_push_buffer)
+{
+    if (p_nb_bytes < 0 &&
+            (OPJ_SIZE_T)(-p_nb_bytes) > p_push_buffer->m_pos) {
+        return -1;
+    }
+    p_push_buffer->m_pos = (OPJ_SIZE_T)((OPJ_OFF_T)p_push_buffer->m_pos +
+                                        p_nb_bytes);
+    return p_nb_bytes;
+}
+
+static OPJ_BOOL opj_seek_from_push_buffer(OPJ_OFF_T p_nb_bytes,
+        opj_push_buffer_t* p_push_buffer)
+{
+    if (p_nb_bytes < 0 || (OPJ_UINT64)p_nb_bytes > p_push_buffer->m_size) {
+        return OPJ_FALSE;
+    }
+    p_push_buffer->m_pos = (OPJ_SIZE_T)p_nb_bytes;
+    return OPJ_TRUE;
+}
+
+static void opj_free_push_buffer(opj_push_buffer_t* p_push_buffer)
+{
+    opj_free(p_push_buffer->m_data);
+    opj_free(p_push_buffer);
+}
+
 /* ---------------------------------------------------------------------- */
 #ifdef _WIN32
 #ifndef OPJ_STATIC
@@ -233,6 +289,13 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
                          OPJ_INT32, OPJ_INT32, OPJ_INT32, OPJ_INT32,
                          struct opj_event_mgr *)) opj_j2k_set_decode_area;
 
+        l_codec->m_codec_data.m_decompression.opj_estimate_decode =
+            (OPJ_BOOL(*)(void *,
+                         opj_stream_private_t *,
+                         opj_image_t*,
+                         opj_decode_estimate_t*,
+                         struct opj_event_mgr *)) opj_j2k_estimate_decode;
+
         l_codec->m_codec_data.m_decompression.opj_get_decoded_tile =
             (OPJ_BOOL(*)(void *p_codec,
                          opj_stream_private_t *p_cio,
@@ -251,9 +314,36 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
                          const OPJ_UINT32 * comps_indices,
                          struct opj_event_mgr * p_manager)) opj_j2k_set_decoded_components;
 
+        l_codec->m_codec_data.m_decompression.opj_decoder_reset =
+            (OPJ_BOOL(*)(void * p_codec,
+                         struct opj_event_mgr * p_manager)) opj_j2k_decoder_reset;
+
+        l_codec->m_codec_data.m_decompression.opj_set_cblk_cache_size =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_SIZE_T max_size,
+                         struct opj_event_mgr * p_manager)) opj_j2k_set_cblk_cache_size;
+
+        l_codec->m_codec_data.m_decompression.opj_set_max_cblk_passes =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_UINT32 max_passes,
+                         struct opj_event_mgr * p_manager)) opj_j2k_set_max_cblk_passes;
+
+        l_codec->m_codec_data.m_decompression.opj_set_strict_mode =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_BOOL strict,
+                         struct opj_event_mgr * p_manager)) opj_j2k_set_strict_mode;
+
+        l_codec->m_codec_data.m_decompression.opj_set_deadline =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_UINT32 deadline_ms,
+                         struct opj_event_mgr * p_manager)) opj_j2k_set_deadline;
+
         l_codec->opj_set_threads =
             (OPJ_BOOL(*)(void * p_codec, OPJ_UINT32 num_threads)) opj_j2k_set_threads;
 
+        l_codec->opj_get_interrupt =
+            (opj_interrupt_t * (*)(void * p_codec)) opj_j2k_get_interrupt;
+
         l_codec->m_codec = opj_j2k_create_decompress();
 
         if (! l_codec->m_codec) {
@@ -321,6 +411,13 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
                          OPJ_INT32, OPJ_INT32, OPJ_INT32, OPJ_INT32,
                          struct opj_event_mgr *)) opj_jp2_set_decode_area;
 
+        l_codec->m_codec_data.m_decompression.opj_estimate_decode =
+            (OPJ_BOOL(*)(void *,
+                         opj_stream_private_t *,
+                         opj_image_t*,
+                         opj_decode_estimate_t*,
+                         struct opj_event_mgr *)) opj_jp2_estimate_decode;
+
         l_codec->m_codec_data.m_decompression.opj_get_decoded_tile =
             (OPJ_BOOL(*)(void *p_codec,
                          opj_stream_private_t *p_cio,
@@ -339,9 +436,36 @@ opj_codec_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT p_format)
                          const OPJ_UINT32 * comps_indices,
                          struct opj_event_mgr * p_manager)) opj_jp2_set_decoded_components;
 
+        l_codec->m_codec_data.m_decompression.opj_decoder_reset =
+            (OPJ_BOOL(*)(void * p_codec,
+                         struct opj_event_mgr * p_manager)) opj_jp2_decoder_reset;
+
+        l_codec->m_codec_data.m_decompression.opj_set_cblk_cache_size =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_SIZE_T max_size,
+                         struct opj_event_mgr * p_manager)) opj_jp2_set_cblk_cache_size;
+
+        l_codec->m_codec_data.m_decompression.opj_set_max_cblk_passes =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_UINT32 max_passes,
+                         struct opj_event_mgr * p_manager)) opj_jp2_set_max_cblk_passes;
+
+        l_codec->m_codec_data.m_decompression.opj_set_strict_mode =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_BOOL strict,
+                         struct opj_event_mgr * p_manager)) opj_jp2_set_strict_mode;
+
+        l_codec->m_codec_data.m_decompression.opj_set_deadline =
+            (OPJ_BOOL(*)(void * p_codec,
+                         OPJ_UINT32 deadline_ms,
+                         struct opj_event_mgr * p_manager)) opj_jp2_set_deadline;
+
         l_codec->opj_set_threads =
             (OPJ_BOOL(*)(void * p_codec, OPJ_UINT32 num_threads)) opj_jp2_set_threads;
 
+        l_codec->opj_get_interrupt =
+            (opj_interrupt_t * (*)(void * p_codec)) opj_jp2_get_interrupt;
+
         l_codec->m_codec = opj_jp2_create(OPJ_TRUE);
 
         if (! l_codec->m_codec) {
@@ -480,6 +604,7 @@ OPJ_BOOL OPJ_CALLCONV opj_decode(opj_codec_t *p_codec,
             return OPJ_FALSE;
         }
 
+        l_codec->opj_get_interrupt(l_codec->m_codec)->cancelled = OPJ_FALSE;
         return l_codec->m_codec_data.m_decompression.opj_decode(l_codec->m_codec,
                 l_stream,
                 p_image,
@@ -489,6 +614,121 @@ OPJ_BOOL OPJ_CALLCONV opj_decode(opj_codec_t *p_codec,
     return OPJ_FALSE;
 }
 
+/**
+ * Runs the operation started by opj_decode_async() or opj_encode_async(),
+ * then calls its completion callback.
+ *
+ * @param user_data the codec
+ */
+static void opj_codec_async_run(void* user_data)
+{
+    opj_codec_private_t * l_codec = (opj_codec_private_t *) user_data;
+
+    if (l_codec->is_decompressor) {
+        l_codec->m_async.result =
+            l_codec->m_codec_data.m_decompression.opj_decode(l_codec->m_codec,
+                    l_codec->m_async.stream,
+                    l_codec->m_async.image,
+                    &(l_codec->m_event_mgr));
+    } else {
+        l_codec->m_async.result =
+            l_codec->m_codec_data.m_compression.opj_encode(l_codec->m_codec,
+                    l_codec->m_async.stream,
+                    &(l_codec->m_event_mgr));
+    }
+    l_codec->m_async.callback((opj_codec_t)l_codec, l_codec->m_async.result,
+                              l_codec->m_async.client_data);
+}
+
+/**
+ * Starts an asynchronous decoding or encoding in a new thread, or runs it
+ * in the calling thread without thread support.
+ *
+ * @param l_codec       the codec
+ * @param p_stream      the stream of the operation
+ * @param p_image       the image to decode, NULL to encode
+ * @param p_callback    the completion callback
+ * @param client_data   the client data of the callback
+ * @return OPJ_TRUE if the operation has started.
+ */
+static OPJ_BOOL opj_codec_async_start(opj_codec_private_t * l_codec,
+                                      opj_stream_private_t * p_stream,
+                                      opj_image_t * p_image,
+                                      opj_completion_callback p_callback,
+                                      void * client_data)
+{
+    if (l_codec->m_async.thread) {
+        opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                      "An asynchronous operation is already in progress.\n");
+        return OPJ_FALSE;
+    }
+
+    l_codec->m_async.stream = p_stream;
+    l_codec->m_async.image = p_image;
+    l_codec->m_async.callback = p_callback;
+    l_codec->m_async.client_data = client_data;
+    l_codec->opj_get_interrupt(l_codec->m_codec)->cancelled = OPJ_FALSE;
+
+    if (!opj_has_thread_support()) {
+        opj_codec_async_run(l_codec);
+        return OPJ_TRUE;
+    }
+    l_codec->m_async.thread = opj_thread_create(opj_codec_async_run, l_codec);
+    if (l_codec->m_async.thread == NULL) {
+        opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                      "Cannot create the thread of the asynchronous operation.\n");
+        return OPJ_FALSE;
+    }
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decode_async(opj_codec_t *p_codec,
+                                       opj_stream_t *p_stream,
+                                       opj_image_t* p_image,
+                                       opj_completion_callback p_callback,
+                                       void *client_data)
+{
+    if (p_codec && p_stream && p_callback) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+        opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decode_async function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return opj_codec_async_start(l_codec, l_stream, p_image, p_callback,
+                                     client_data);
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_wait_completion(opj_codec_t *p_codec)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (l_codec->m_async.thread) {
+            opj_thread_join(l_codec->m_async.thread);
+            l_codec->m_async.thread = NULL;
+        }
+        return l_codec->m_async.result;
+    }
+
+    return OPJ_FALSE;
+}
+
+void OPJ_CALLCONV opj_cancel(opj_codec_t *p_codec)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        l_codec->opj_get_interrupt(l_codec->m_codec)->cancelled = OPJ_TRUE;
+    }
+}
+
 OPJ_BOOL OPJ_CALLCONV opj_set_decode_area(opj_codec_t *p_codec,
         opj_image_t* p_image,
         OPJ_INT32 p_start_x, OPJ_INT32 p_start_y,
@@ -512,6 +752,31 @@ OPJ_BOOL OPJ_CALLCONV opj_set_decode_area(opj_codec_t *p_codec,
     return OPJ_FALSE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_estimate_decode(opj_codec_t *p_codec,
+        opj_stream_t *p_stream,
+        opj_image_t* p_image,
+        opj_decode_estimate_t* p_estimate)
+{
+    if (p_codec && p_stream && p_image && p_estimate) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+        opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_estimate_decode function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_estimate_decode(
+                   l_codec->m_codec,
+                   l_stream,
+                   p_image,
+                   p_estimate,
+                   &(l_codec->m_event_mgr));
+    }
+    return OPJ_FALSE;
+}
+
 OPJ_BOOL OPJ_CALLCONV opj_read_tile_header(opj_codec_t *p_codec,
         opj_stream_t * p_stream,
         OPJ_UINT32 * p_tile_index,
@@ -628,6 +893,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_j2k_encode;
 
+        l_codec->m_codec_data.m_compression.opj_encode_interleaved = (OPJ_BOOL(*)(
+                    void *,
+                    const opj_interleaved_buffer_t *,
+                    struct opj_stream_private *,
+                    struct opj_event_mgr *)) opj_j2k_encode_interleaved;
+
         l_codec->m_codec_data.m_compression.opj_end_compress = (OPJ_BOOL(*)(void *,
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_j2k_end_compress;
@@ -644,6 +915,13 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_j2k_write_tile;
 
+        l_codec->m_codec_data.m_compression.opj_write_strip = (OPJ_BOOL(*)(void *,
+                OPJ_UINT32,
+                const OPJ_BYTE*,
+                OPJ_SIZE_T,
+                struct opj_stream_private *,
+                struct opj_event_mgr *)) opj_j2k_write_strip;
+
         l_codec->m_codec_data.m_compression.opj_destroy = (void (*)(
                     void *)) opj_j2k_destroy;
 
@@ -660,6 +938,9 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
         l_codec->opj_set_threads =
             (OPJ_BOOL(*)(void * p_codec, OPJ_UINT32 num_threads)) opj_j2k_set_threads;
 
+        l_codec->opj_get_interrupt =
+            (opj_interrupt_t * (*)(void * p_codec)) opj_j2k_get_interrupt;
+
         l_codec->m_codec = opj_j2k_create_compress();
         if (! l_codec->m_codec) {
             opj_free(l_codec);
@@ -674,6 +955,12 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_jp2_encode;
 
+        l_codec->m_codec_data.m_compression.opj_encode_interleaved = (OPJ_BOOL(*)(
+                    void *,
+                    const opj_interleaved_buffer_t *,
+                    struct opj_stream_private *,
+                    struct opj_event_mgr *)) opj_jp2_encode_interleaved;
+
         l_codec->m_codec_data.m_compression.opj_end_compress = (OPJ_BOOL(*)(void *,
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_jp2_end_compress;
@@ -690,6 +977,13 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
                 struct opj_stream_private *,
                 struct opj_event_mgr *)) opj_jp2_write_tile;
 
+        l_codec->m_codec_data.m_compression.opj_write_strip = (OPJ_BOOL(*)(void *,
+                OPJ_UINT32,
+                const OPJ_BYTE*,
+                OPJ_SIZE_T,
+                struct opj_stream_private *,
+                struct opj_event_mgr *)) opj_jp2_write_strip;
+
         l_codec->m_codec_data.m_compression.opj_destroy = (void (*)(
                     void *)) opj_jp2_destroy;
 
@@ -706,6 +1000,9 @@ opj_codec_t* OPJ_CALLCONV opj_create_compress(OPJ_CODEC_FORMAT p_format)
         l_codec->opj_set_threads =
             (OPJ_BOOL(*)(void * p_codec, OPJ_UINT32 num_threads)) opj_jp2_set_threads;
 
+        l_codec->opj_get_interrupt =
+            (opj_interrupt_t * (*)(void * p_codec)) opj_jp2_get_interrupt;
+
         l_codec->m_codec = opj_jp2_create(OPJ_FALSE);
         if (! l_codec->m_codec) {
             opj_free(l_codec);
@@ -851,6 +1148,7 @@ OPJ_BOOL OPJ_CALLCONV opj_encode(opj_codec_t *p_info, opj_stream_t *p_stream)
         opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
 
         if (! l_codec->is_decompressor) {
+            l_codec->opj_get_interrupt(l_codec->m_codec)->cancelled = OPJ_FALSE;
             return l_codec->m_codec_data.m_compression.opj_encode(l_codec->m_codec,
                     l_stream,
                     &(l_codec->m_event_mgr));
@@ -861,6 +1159,48 @@ OPJ_BOOL OPJ_CALLCONV opj_encode(opj_codec_t *p_info, opj_stream_t *p_stream)
 
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_encode_async(opj_codec_t *p_codec,
+                                       opj_stream_t *p_stream,
+                                       opj_completion_callback p_callback,
+                                       void *client_data)
+{
+    if (p_codec && p_stream && p_callback) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+        opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+        if (l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_encode_async function is not a compressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return opj_codec_async_start(l_codec, l_stream, NULL, p_callback,
+                                     client_data);
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_encode_interleaved(opj_codec_t *p_codec,
+        const opj_interleaved_buffer_t *p_buffer,
+        opj_stream_t *p_stream)
+{
+    if (p_codec && p_buffer && p_stream) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+        opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+        if (! l_codec->is_decompressor) {
+            return l_codec->m_codec_data.m_compression.opj_encode_interleaved(
+                       l_codec->m_codec,
+                       p_buffer,
+                       l_stream,
+                       &(l_codec->m_event_mgr));
+        }
+    }
+
+    return OPJ_FALSE;
+}
+
 OPJ_BOOL OPJ_CALLCONV opj_end_compress(opj_codec_t *p_codec,
                                        opj_stream_t *p_stream)
 {
@@ -898,6 +1238,160 @@ OPJ_BOOL OPJ_CALLCONV opj_end_decompress(opj_codec_t *p_codec,
     return OPJ_FALSE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_decoder_reset(opj_codec_t *p_codec)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decoder_reset function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_decoder_reset(
+                   l_codec->m_codec,
+                   &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decoder_set_cblk_cache_size(opj_codec_t *p_codec,
+        OPJ_SIZE_T max_size)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decoder_set_cblk_cache_size function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_set_cblk_cache_size(
+                   l_codec->m_codec,
+                   max_size,
+                   &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decoder_set_deadline(opj_codec_t *p_codec,
+        OPJ_UINT32 milliseconds)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decoder_set_deadline function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_set_deadline(
+                   l_codec->m_codec,
+                   milliseconds,
+                   &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decoder_set_strict_mode(opj_codec_t *p_codec,
+        OPJ_BOOL strict)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decoder_set_strict_mode function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_set_strict_mode(
+                   l_codec->m_codec,
+                   strict,
+                   &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decode_pushed_data(opj_codec_t *p_codec,
+        opj_stream_t *p_stream, opj_image_t **p_image)
+{
+    opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+    opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+    opj_event_mgr_t l_silent_mgr;
+    opj_image_t* l_image = NULL;
+
+    if (! p_codec || ! p_stream || ! p_image) {
+        return OPJ_FALSE;
+    }
+    *p_image = NULL;
+
+    if (! l_codec->is_decompressor) {
+        opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                      "Codec provided to the opj_decode_pushed_data function is not a decompressor handler.\n");
+        return OPJ_FALSE;
+    }
+    if (l_stream->m_read_fn != (opj_stream_read_fn) opj_read_from_push_buffer) {
+        opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                      "Stream provided to the opj_decode_pushed_data function is not a push stream.\n");
+        return OPJ_FALSE;
+    }
+
+    /* Read everything received so far again, from the start of the stream */
+    if (! l_codec->m_codec_data.m_decompression.opj_set_strict_mode(
+                l_codec->m_codec, OPJ_FALSE, &(l_codec->m_event_mgr)) ||
+            ! l_codec->m_codec_data.m_decompression.opj_decoder_reset(
+                l_codec->m_codec, &(l_codec->m_event_mgr)) ||
+            ! opj_stream_read_seek(l_stream, 0, &(l_codec->m_event_mgr))) {
+        return OPJ_FALSE;
+    }
+
+    /* The main header may not be entirely received yet, which is not an error */
+    opj_set_default_event_handler(&l_silent_mgr);
+    if (! l_codec->m_codec_data.m_decompression.opj_read_header(l_stream,
+            l_codec->m_codec, &l_image, &l_silent_mgr)) {
+        opj_image_destroy(l_image);
+        return OPJ_FALSE;
+    }
+
+    if (! l_codec->m_codec_data.m_decompression.opj_decode(l_codec->m_codec,
+            l_stream, l_image, &(l_codec->m_event_mgr))) {
+        opj_image_destroy(l_image);
+        return OPJ_FALSE;
+    }
+
+    *p_image = l_image;
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_decoder_set_max_cblk_passes(opj_codec_t *p_codec,
+        OPJ_UINT32 max_passes)
+{
+    if (p_codec) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+
+        if (! l_codec->is_decompressor) {
+            opj_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                          "Codec provided to the opj_decoder_set_max_cblk_passes function is not a decompressor handler.\n");
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_decompression.opj_set_max_cblk_passes(
+                   l_codec->m_codec,
+                   max_passes,
+                   &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
 OPJ_BOOL OPJ_CALLCONV opj_set_MCT(opj_cparameters_t *parameters,
                                   OPJ_FLOAT32 * pEncodingMatrix,
                                   OPJ_INT32 * p_dc_shift, OPJ_UINT32 pNbComp)
@@ -953,6 +1447,31 @@ OPJ_BOOL OPJ_CALLCONV opj_write_tile(opj_codec_t *p_codec,
     return OPJ_FALSE;
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_write_strip(opj_codec_t *p_codec,
+                                      OPJ_UINT32 p_nb_lines,
+                                      const OPJ_BYTE * p_data,
+                                      OPJ_SIZE_T p_data_size,
+                                      opj_stream_t *p_stream)
+{
+    if (p_codec && p_stream && p_data) {
+        opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
+        opj_stream_private_t * l_stream = (opj_stream_private_t *) p_stream;
+
+        if (l_codec->is_decompressor) {
+            return OPJ_FALSE;
+        }
+
+        return l_codec->m_codec_data.m_compression.opj_write_strip(l_codec->m_codec,
+                p_nb_lines,
+                p_data,
+                p_data_size,
+                l_stream,
+                &(l_codec->m_event_mgr));
+    }
+
+    return OPJ_FALSE;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void OPJ_CALLCONV opj_destroy_codec(opj_codec_t *p_codec)
@@ -960,6 +1479,10 @@ void OPJ_CALLCONV opj_destroy_codec(opj_codec_t *p_codec)
     if (p_codec) {
         opj_codec_private_t * l_codec = (opj_codec_private_t *) p_codec;
 
+        /* The codec must not be destroyed while an asynchronous operation */
+        /* still uses it */
+        opj_wait_completion(p_codec);
+
         if (l_codec->is_decompressor) {
             l_codec->m_codec_data.m_decompression.opj_destroy(l_codec->m_codec);
         } else {
@@ -1036,6 +1559,29 @@ void OPJ_CALLCONV opj_destroy_cstr_index(opj_codestream_index_t **p_cstr_index)
     }
 }
 
+OPJ_BOOL OPJ_CALLCONV opj_probe_header(const OPJ_BYTE *p_data,
+                                       OPJ_SIZE_T p_data_size,
+                                       opj_header_info_t *p_info)
+{
+    /* JP2 signature box */
+    static const OPJ_BYTE l_jp2_magic[] = {
+        0x00, 0x00, 0x00, 0x0C, 0x6A, 0x50, 0x20, 0x20, 0x0D, 0x0A, 0x87, 0x0A
+    };
+
+    if (p_data == NULL || p_info == NULL) {
+        return OPJ_FALSE;
+    }
+    memset(p_info, 0, sizeof(opj_header_info_t));
+
+    if (p_data_size >= sizeof(l_jp2_magic) &&
+            memcmp(p_data, l_jp2_magic, sizeof(l_jp2_magic)) == 0) {
+        p_info->format = OPJ_CODEC_JP2;
+        return opj_jp2_probe_header(p_data, p_data_size, p_info);
+    }
+    p_info->format = OPJ_CODEC_J2K;
+    return opj_j2k_probe_header(p_data, p_data_size, p_info);
+}
+
 opj_stream_t* OPJ_CALLCONV opj_stream_create_default_file_stream(
     const char *fname, OPJ_BOOL p_is_read_stream)
 {
@@ -1087,6 +1633,77 @@ opj_stream_t* OPJ_CALLCONV opj_stream_create_file_stream(
     return l_stream;
 }
 
+opj_stream_t* OPJ_CALLCONV opj_stream_create_push_stream(void)
+{
+    opj_stream_t* l_stream;
+    opj_push_buffer_t* l_push_buffer;
+
+    l_push_buffer = (opj_push_buffer_t*) opj_calloc(1, sizeof(opj_push_buffer_t));
+    if (! l_push_buffer) {
+        return NULL;
+    }
+
+    l_stream = opj_stream_create(OPJ_J2K_STREAM_CHUNK_SIZE, OPJ_TRUE);
+    if (! l_stream) {
+        opj_free(l_push_buffer);
+        return NULL;
+    }
+
+    opj_stream_set_user_data(l_stream, l_push_buffer,
+                             (opj_stream_free_user_data_fn) opj_free_push_buffer);
+    opj_stream_set_user_data_length(l_stream, 0);
+    opj_stream_set_read_function(l_stream,
+                                 (opj_stream_read_fn) opj_read_from_push_buffer);
+    opj_stream_set_skip_function(l_stream,
+                                 (opj_stream_skip_fn) opj_skip_from_push_buffer);
+    opj_stream_set_seek_function(l_stream,
+                                 (opj_stream_seek_fn) opj_seek_from_push_buffer);
+
+    return l_stream;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_stream_push_data(opj_stream_t* p_stream,
+        const void* p_data, OPJ_SIZE_T p_size)
+{
+    opj_stream_private_t* l_stream = (opj_stream_private_t*) p_stream;
+    opj_push_buffer_t* l_push_buffer;
+
+    if (! l_stream ||
+            l_stream->m_read_fn != (opj_stream_read_fn) opj_read_from_push_buffer) {
+        return OPJ_FALSE;
+    }
+    if (p_size == 0) {
+        return OPJ_TRUE;
+    }
+    if (! p_data) {
+        return OPJ_FALSE;
+    }
+
+    l_push_buffer = (opj_push_buffer_t*) l_stream->m_user_data;
+    if (p_size > l_push_buffer->m_capacity - l_push_buffer->m_size) {
+        OPJ_BYTE* l_new_data;
+        OPJ_SIZE_T l_new_capacity = l_push_buffer->m_capacity * 2;
+
+        if (p_size > (OPJ_SIZE_T)(-1) - l_push_buffer->m_size) {
+            return OPJ_FALSE;
+        }
+        if (l_new_capacity < l_push_buffer->m_size + p_size) {
+            l_new_capacity = l_push_buffer->m_size + p_size;
+        }
+        l_new_data = (OPJ_BYTE*) opj_realloc(l_push_buffer->m_data, l_new_capacity);
+        if (! l_new_data) {
+            return OPJ_FALSE;
+        }
+        l_push_buffer->m_data = l_new_data;
+        l_push_buffer->m_capacity = l_new_capacity;
+    }
+    memcpy(l_push_buffer->m_data + l_push_buffer->m_size, p_data, p_size);
+    l_push_buffer->m_size += p_size;
+    l_stream->m_user_data_length = l_push_buffer->m_size;
+
+    return OPJ_TRUE;
+}
+
 
 void* OPJ_CALLCONV opj_image_data_alloc(OPJ_SIZE_T size)
 {
@@ -539,6 +539,11 @@ typedef struct opj_cparameters {
 
 #define OPJ_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG  0x0001
 #define OPJ_DPARAMETERS_DUMP_FLAG 0x0002
+/** Keep the Tier-1 decoding state of code-blocks in the code-block cache
+    (see opj_decoder_set_cblk_cache_size()), so that decoding the same
+    codestream again with more quality layers only decodes the coding passes
+    of the additional layers */
+#define OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG 0x0004
 
 /**
  * Decompression parameters
@@ -611,6 +616,17 @@ typedef struct opj_dparameters {
  * */
 typedef void * opj_codec_t;
 
+/**
+ * Callback function prototype for the completion of an asynchronous
+ * operation, see opj_decode_async() and opj_encode_async()
+ * @param p_codec           Codec that ran the operation
+ * @param success           OPJ_TRUE if the operation was successful
+ * @param client_data       Client object given when starting the operation
+ * @since 2.4.0
+ * */
+typedef void (*opj_completion_callback)(opj_codec_t p_codec,
+                                        OPJ_BOOL success, void *client_data);
+
 /*
 ==========================================================
    I/O stream typedef definitions
@@ -746,6 +762,26 @@ typedef struct opj_image_comptparm {
     OPJ_UINT32 sgnd;
 } opj_image_cmptparm_t;
 
+/**
+ * Description of an interleaved (packed) image buffer, such as a RGB8 or
+ * RGBA16 frame, used as encoder input by opj_encode_interleaved().
+ * @since 2.4.0
+ * */
+typedef struct opj_interleaved_buffer {
+    /** pointer to the first sample of the top-left pixel of the image */
+    const OPJ_BYTE *data;
+    /** number of bytes per sample: 1, or 2 (16-bit native endian samples) */
+    OPJ_UINT32 bytes_per_sample;
+    /** number of samples per pixel (e.g. 3 for RGB, 4 for RGBA) */
+    OPJ_UINT32 samples_per_pixel;
+    /** number of bytes between the start of two consecutive lines */
+    OPJ_SIZE_T line_stride;
+    /** array of image->numcomps values, giving for each image component the
+        index of its sample within a pixel (e.g. {2,1,0} for BGR input).
+        If NULL, component i is read from sample i */
+    const OPJ_UINT32 *comp_mapping;
+} opj_interleaved_buffer_t;
+
 
 /*
 ==========================================================
@@ -1080,6 +1116,142 @@ typedef struct opj_jp2_index {
 
 } opj_jp2_index_t;
 
+/**
+ * Main characteristics of an image, as parsed by opj_probe_header()
+ * @since 2.4.0
+ */
+typedef struct opj_header_info {
+    /** OPJ_CODEC_J2K for a raw codestream, OPJ_CODEC_JP2 for a JP2 file */
+    OPJ_CODEC_FORMAT format;
+    /** capabilities (Rsiz) */
+    OPJ_UINT16 rsiz;
+
+    /** XOsiz: horizontal offset from the origin of the reference grid to the left side of the image area */
+    OPJ_UINT32 x0;
+    /** YOsiz: vertical offset from the origin of the reference grid to the top side of the image area */
+    OPJ_UINT32 y0;
+    /** Xsiz: width of the reference grid */
+    OPJ_UINT32 x1;
+    /** Ysiz: height of the reference grid */
+    OPJ_UINT32 y1;
+
+    /** number of components */
+    OPJ_UINT32 numcomps;
+    /** precision of the first component */
+    OPJ_UINT32 prec;
+    /** signed (1) / unsigned (0) first component */
+    OPJ_UINT32 sgnd;
+    /** XRsiz: horizontal separation of the samples of the first component */
+    OPJ_UINT32 dx;
+    /** YRsiz: vertical separation of the samples of the first component */
+    OPJ_UINT32 dy;
+    /** OPJ_TRUE if all components have the precision, signedness and separation of the first one */
+    OPJ_BOOL same_comps;
+
+    /** tile origin in x = XTOsiz */
+    OPJ_UINT32 tx0;
+    /** tile origin in y = YTOsiz */
+    OPJ_UINT32 ty0;
+    /** tile size in x = XTsiz */
+    OPJ_UINT32 tdx;
+    /** tile size in y = YTsiz */
+    OPJ_UINT32 tdy;
+    /** number of tiles in X */
+    OPJ_UINT32 tw;
+    /** number of tiles in Y */
+    OPJ_UINT32 th;
+
+    /** OPJ_TRUE if the COD marker was found. The fields up to qmfbid are only set in that case */
+    OPJ_BOOL has_cod;
+    /** coding style */
+    OPJ_UINT32 csty;
+    /** progression order */
+    OPJ_PROG_ORDER prg;
+    /** number of layers */
+    OPJ_UINT32 numlayers;
+    /** multi-component transform identifier */
+    OPJ_UINT32 mct;
+    /** number of resolutions */
+    OPJ_UINT32 numresolutions;
+    /** log2 of code-blocks width */
+    OPJ_UINT32 cblkw;
+    /** log2 of code-blocks height */
+    OPJ_UINT32 cblkh;
+    /** code-block coding style */
+    OPJ_UINT32 cblksty;
+    /** discrete wavelet transform identifier: 0 = 9-7 irreversible, 1 = 5-3 reversible */
+    OPJ_UINT32 qmfbid;
+
+    /** OPJ_TRUE if the QCD marker was found. qntsty and numgbits are only set in that case */
+    OPJ_BOOL has_qcd;
+    /** quantisation style */
+    OPJ_UINT32 qntsty;
+    /** number of guard bits */
+    OPJ_UINT32 numgbits;
+
+    /** color space: that of the JP2 colour specification box, or OPJ_CLRSPC_UNSPECIFIED for a raw codestream */
+    OPJ_COLOR_SPACE color_space;
+    /** OPJ_TRUE if the JP2 colour specification box contains an ICC profile */
+    OPJ_BOOL has_icc_profile;
+} opj_header_info_t;
+
+/**
+ * Resources needed by a decode, as predicted by opj_estimate_decode()
+ * @since 2.4.0
+ */
+typedef struct opj_decode_estimate {
+    /** peak of the memory allocated by opj_decode(), on top of the one already held by the codec, in bytes, with the number of threads set by opj_codec_set_threads() */
+    OPJ_UINT64 peak_memory;
+    /** memory added to peak_memory by each decoding thread, in bytes */
+    OPJ_UINT64 memory_per_thread;
+    /** memory of the samples of the decoded image, in bytes (included in peak_memory) */
+    OPJ_UINT64 image_memory;
+    /** number of tiles decoded */
+    OPJ_UINT32 nb_tiles;
+    /** number of code-blocks decoded */
+    OPJ_UINT64 nb_code_blocks;
+    /** number of bytes read from the codestream after the main header */
+    OPJ_UINT64 compressed_bytes;
+    /** OPJ_TRUE if compressed_bytes comes from TLM markers, OPJ_FALSE if it is extrapolated from the length of the stream */
+    OPJ_BOOL compressed_bytes_exact;
+} opj_decode_estimate_t;
+
+/*
+==========================================================
+   Hardware performance counters
+==========================================================
+*/
+
+/**
+ * Stages of the coding pipeline for which opj_get_perf_counters()
+ * reports hardware performance counters
+ */
+typedef enum PERF_STAGE {
+    OPJ_PERF_STAGE_T2 = 0,  /**< Tier-2: reading or writing of packets */
+    OPJ_PERF_STAGE_T1,      /**< Tier-1: decoding or encoding of code-blocks */
+    OPJ_PERF_STAGE_DWT,     /**< discrete wavelet transform */
+    OPJ_PERF_STAGE_MCT,     /**< multi-component transform */
+    OPJ_PERF_STAGE_OUTPUT,  /**< DC level shift, and copy of the samples between the image and the tiles (input stage when encoding) */
+    OPJ_PERF_STAGE_RATE,    /**< rate allocation (encoding only) */
+    OPJ_PERF_NB_STAGES      /**< number of stages */
+} OPJ_PERF_STAGE;
+
+/**
+ * Hardware performance counters of a pipeline stage, summed over all the
+ * threads that worked on it. Only user space execution is counted.
+ * Events that the CPU does not support are reported as 0.
+ */
+typedef struct opj_perf_counters {
+    /** CPU cycles */
+    OPJ_UINT64 cycles;
+    /** retired instructions */
+    OPJ_UINT64 instructions;
+    /** last level cache misses */
+    OPJ_UINT64 llc_misses;
+    /** mispredicted branches */
+    OPJ_UINT64 branch_misses;
+} opj_perf_counters_t;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -1256,6 +1428,33 @@ OPJ_API opj_stream_t* OPJ_CALLCONV opj_stream_create_file_stream(
     OPJ_SIZE_T p_buffer_size,
     OPJ_BOOL p_is_read_stream);
 
+/**
+ * Create an empty read stream, to which the data of a codestream is appended
+ * with opj_stream_push_data() as it is received (e.g. from the network).
+ * The pushed data is kept until opj_stream_destroy() is called.
+ *
+ * Such a stream is decoded with opj_decode_pushed_data(), which can be
+ * called after each chunk of data to get the best image available so far.
+ *
+ * @return a stream object, NULL if there is not enough memory.
+ * @since 2.4.0
+*/
+OPJ_API opj_stream_t* OPJ_CALLCONV opj_stream_create_push_stream(void);
+
+/**
+ * Append data to a stream created by opj_stream_create_push_stream().
+ *
+ * @param p_stream    the stream to append the data to
+ * @param p_data      the data, which is copied
+ * @param p_size      size in bytes of the data
+ *
+ * @return OPJ_TRUE if the data was appended, OPJ_FALSE if the stream is not
+ * a push stream or if there is not enough memory.
+ * @since 2.4.0
+*/
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_stream_push_data(opj_stream_t* p_stream,
+        const void* p_data, OPJ_SIZE_T p_size);
+
 /*
 ==========================================================
    event manager functions definitions
@@ -1319,6 +1518,32 @@ OPJ_API void OPJ_CALLCONV opj_destroy_codec(opj_codec_t * p_codec);
 OPJ_API OPJ_BOOL OPJ_CALLCONV opj_end_decompress(opj_codec_t *p_codec,
         opj_stream_t *p_stream);
 
+/**
+ * Resets a decompressor so that it can decode another codestream.
+ *
+ * This may be called at any time after opj_setup_decoder(), typically after
+ * opj_end_decompress(), to decode a sequence of codestreams (e.g. video
+ * frames) with the same decompressor handle: opj_read_header() and
+ * opj_decode() can then be called with a new stream. The image returned by a
+ * previous opj_read_header() is not affected and must still be destroyed by
+ * the caller.
+ *
+ * Everything read from the previous codestream is discarded. The decoding
+ * parameters of opj_setup_decoder(), the number of threads and the thread
+ * pool with its per-thread code-block decoding contexts are kept. The tile
+ * decoder structures and their buffers are also kept, and reused when the
+ * new codestream has the same number of components, which avoids most
+ * allocations when the codestreams have the same geometry. Settings made
+ * after opj_read_header() (decoded area, decoded components) must be done
+ * again for the new codestream.
+ *
+ * @param   p_codec         the jpeg2000 decompressor.
+ *
+ * @return  true            if the decompressor could be reset.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decoder_reset(opj_codec_t *p_codec);
+
 
 /**
  * Set decoding parameters to default values
@@ -1360,6 +1585,162 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_setup_decoder(opj_codec_t *p_codec,
 OPJ_API OPJ_BOOL OPJ_CALLCONV opj_codec_set_threads(opj_codec_t *p_codec,
         int num_threads);
 
+/**
+ * Waits for the end of the operation started by opj_decode_async() or
+ * opj_encode_async(), after its completion callback has returned.
+ *
+ * This function must be called once per asynchronous operation before any
+ * other function is called on the codec (opj_destroy_codec() calls it), and
+ * must not be called from the completion callback.
+ *
+ * @param p_codec       decompressor or compressor handler
+ *
+ * @return OPJ_TRUE     if the last asynchronous operation was successful.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_wait_completion(opj_codec_t *p_codec);
+
+/**
+ * Requests the decoding or encoding in progress to stop. This function can
+ * be called from any thread.
+ *
+ * The operation stops before the next code-block or tile and fails: the
+ * completion callback of an asynchronous operation is called with success
+ * set to OPJ_FALSE, and opj_decode() or opj_encode() return OPJ_FALSE.
+ * The request is cleared when the next operation starts.
+ *
+ * @param p_codec       decompressor or compressor handler
+ * @since 2.4.0
+ */
+OPJ_API void OPJ_CALLCONV opj_cancel(opj_codec_t *p_codec);
+
+/**
+ * Enables a cache of decoded code-blocks, for applications that decode
+ * overlapping areas of the same codestream repeatedly, such as viewers that
+ * pan or zoom through an image.
+ *
+ * The cache keeps the coefficients of the code-blocks decoded by opj_decode()
+ * or opj_get_decoded_tile(), so that the code-blocks decoded again by a later
+ * call with the same decompressor are not entropy decoded a second time. The
+ * cache is kept by opj_decoder_reset(), so a codestream can be read again
+ * from a new stream to decode another area. An entry is only used if the
+ * compressed data of the code-block is identical to the one it was decoded
+ * from (which takes into account the number of quality layers decoded), so
+ * decoding a different codestream with the same decompressor is safe. To
+ * check this, an entry keeps a copy of that data, which counts towards the
+ * budget along with the coefficients. When the budget is exceeded, the least
+ * recently used code-blocks are evicted.
+ *
+ * By default, there is no cache.
+ *
+ * @param p_codec       decompressor handler
+ * @param max_size      budget of the cache in bytes, 0 to disable and free it.
+ *
+ * @return OPJ_TRUE     if the function is successful.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decoder_set_cblk_cache_size(
+    opj_codec_t *p_codec, OPJ_SIZE_T max_size);
+
+/**
+ * Limits the number of coding passes decoded per code-block, for a fast
+ * preview of the image, for example to build thumbnails of lossless images.
+ *
+ * Each code-block is decoded from its most significant bit-plane, and its
+ * decoding stops after max_passes coding passes, the remaining refinement
+ * being skipped. The first bit-plane of a code-block has a single coding
+ * pass and the next ones have three, so decoding n bit-planes takes
+ * 3 * n - 2 passes. The coefficients are reconstructed at the middle of the
+ * interval left by the passes decoded. Unlike the number of quality layers
+ * decoded, this limits the Tier-1 decoding time even for codestreams with a
+ * single quality layer.
+ *
+ * This function must be called before opj_decode() or opj_get_decoded_tile().
+ * The limit is kept by opj_decoder_reset().
+ *
+ * @param p_codec       decompressor handler
+ * @param max_passes    maximum number of coding passes decoded per
+ *                      code-block, 0 for no limit (the default).
+ *
+ * @return OPJ_TRUE     if the function is successful.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decoder_set_max_cblk_passes(
+    opj_codec_t *p_codec, OPJ_UINT32 max_passes);
+
+/**
+ * Sets whether a truncated codestream is rejected by opj_decode() and
+ * opj_get_decoded_tile() (strict mode, the default), or decoded up to the end
+ * of its data (non strict mode).
+ *
+ * In non strict mode, the tiles whose data is missing are left to zero, and
+ * the packets of a tile after its last complete code-block segment are
+ * decoded as empty, so that depending on the progression order the truncated
+ * tile lacks quality layers, resolutions, components or precincts.
+ *
+ * The setting is kept by opj_decoder_reset().
+ *
+ * @param p_codec       decompressor handler
+ * @param strict        OPJ_TRUE to reject truncated codestreams.
+ *
+ * @return OPJ_TRUE     if the function is successful.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decoder_set_strict_mode(opj_codec_t *p_codec,
+        OPJ_BOOL strict);
+
+/**
+ * Sets a time limit to opj_decode(), opj_decode_async() and
+ * opj_get_decoded_tile(), after which the image decoded so far is returned.
+ *
+ * Once the deadline is past, the remaining code-blocks of the tile being
+ * decoded are left to zero, its decoding is finished, and no other tile is
+ * decoded: their samples are left to zero. The decoding is successful, and
+ * a warning is emitted if the image is incomplete. The first tile decoded
+ * is always finished, so that the image has all its components.
+ *
+ * The setting is kept by opj_decoder_reset().
+ *
+ * @param p_codec       decompressor handler
+ * @param milliseconds  elapsed time from the start of each decoding after
+ *                      which it stops, 0 for no limit (the default).
+ *
+ * @return OPJ_TRUE     if the function is successful.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decoder_set_deadline(opj_codec_t *p_codec,
+        OPJ_UINT32 milliseconds);
+
+/**
+ * Decodes the data received so far in a stream created by
+ * opj_stream_create_push_stream(), to get the best image available before
+ * the whole codestream is received: depending on the progression order, the
+ * tiles, resolutions, quality layers or components received.
+ *
+ * The decompressor is reset, set in non strict mode (see
+ * opj_decoder_set_strict_mode()), and the header and the tiles are read again
+ * from the start of the stream. The decoding parameters of
+ * opj_setup_decoder() (reduce factor, number of quality layers), the number
+ * of threads and the limits set on the decompressor apply, and the whole
+ * image is decoded. To avoid decoding the same code-blocks again after each
+ * chunk, enable the cache of opj_decoder_set_cblk_cache_size() and set
+ * OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG in the decoding parameters:
+ * only the code-blocks that received new data are then entropy decoded.
+ *
+ * Before the main header of the codestream is received, the function
+ * returns OPJ_FALSE without emitting any message.
+ *
+ * @param p_codec       decompressor handler
+ * @param p_stream      stream created by opj_stream_create_push_stream()
+ * @param p_image       set to the decoded image, to be destroyed with
+ *                      opj_image_destroy(), or to NULL in case of failure.
+ *
+ * @return OPJ_TRUE     if an image could be decoded.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode_pushed_data(opj_codec_t *p_codec,
+        opj_stream_t *p_stream, opj_image_t **p_image);
+
 /**
  * Decodes an image header.
  *
@@ -1431,6 +1812,33 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_set_decode_area(opj_codec_t *p_codec,
         OPJ_INT32 p_start_x, OPJ_INT32 p_start_y,
         OPJ_INT32 p_end_x, OPJ_INT32 p_end_y);
 
+/**
+ * Predicts the resources needed by opj_decode(), without decoding nor
+ * allocating anything, so that oversized requests can be rejected and the
+ * number of threads chosen before decoding.
+ *
+ * This function should be called after opj_read_header() and after the
+ * decoding parameters are set: resolution factor and layers (opj_setup_decoder()),
+ * components (opj_set_decoded_components()), area (opj_set_decode_area())
+ * and threads (opj_codec_set_threads()).
+ *
+ * The estimation relies on the coding parameters of the main header.
+ * The compressed bytes come from the TLM markers when the codestream has
+ * some, and are otherwise extrapolated from the length of the stream.
+ *
+ * @param   p_codec         the jpeg2000 codec.
+ * @param   p_stream        input stream, as left by opj_read_header()
+ * @param   p_image         the image returned by opj_read_header()
+ * @param   p_estimate      the predicted resources
+ *
+ * @return  true            if the resources could be estimated.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_estimate_decode(opj_codec_t *p_codec,
+        opj_stream_t *p_stream,
+        opj_image_t* p_image,
+        opj_decode_estimate_t* p_estimate);
+
 /**
  * Decode an image from a JPEG-2000 codestream
  *
@@ -1443,6 +1851,36 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode(opj_codec_t *p_decompressor,
         opj_stream_t *p_stream,
         opj_image_t *p_image);
 
+/**
+ * Starts decoding an image from a JPEG-2000 codestream in a new thread, like
+ * opj_decode(), and returns without waiting for the decoding to finish.
+ *
+ * The thread runs the decoding, whose code-blocks are decoded by the thread
+ * pool of the codec (see opj_codec_set_threads()), then calls p_callback
+ * with the result of the decoding. The event handlers of the codec are called
+ * from that thread. Until the callback is called, the stream and the image
+ * must be kept alive and no function other than opj_cancel() may be called
+ * on the codec. opj_wait_completion() must then be called, outside of the
+ * callback, before using the codec again.
+ *
+ * If the library is built without thread support, the decoding is done and
+ * p_callback is called before this function returns.
+ *
+ * @param p_decompressor    decompressor handle
+ * @param p_stream          Input buffer stream
+ * @param p_image           the decoded image
+ * @param p_callback        function called when the decoding is finished
+ * @param client_data       value passed to p_callback
+ * @return                  true if the decoding has started, otherwise false,
+ *                          in which case p_callback is not called
+ * @since 2.4.0
+ * */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_decode_async(opj_codec_t *p_decompressor,
+        opj_stream_t *p_stream,
+        opj_image_t *p_image,
+        opj_completion_callback p_callback,
+        void *client_data);
+
 /**
  * Get the decoded tile from the codec
  *
@@ -1486,6 +1924,45 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_write_tile(opj_codec_t *p_codec,
         OPJ_UINT32 p_data_size,
         opj_stream_t *p_stream);
 
+/**
+ * Writes a strip of consecutive image lines, as an alternative to
+ * opj_encode() and opj_write_tile() for images that do not fit in memory.
+ *
+ * The image given to opj_start_compress() should be created with
+ * opj_image_tile_create(), i.e. without sample data. Lines must be written
+ * from top to bottom, with any number of lines per call. The library only
+ * buffers the lines of the current row of tiles: once a row of tiles is
+ * complete, its tiles are encoded and written to the stream. The memory used
+ * is thus bounded by the tile height (cp_tdy) times the image width.
+ * When tiles span the whole image width (e.g. a single tile), lines are not
+ * buffered at all: they go through a line-based wavelet transform, and
+ * code-blocks are encoded as soon as their samples are available, so that
+ * the memory used for samples is bounded by a few code-block heights per
+ * resolution level. Only the compressed data of the tile is kept until the
+ * tile is complete.
+ * opj_end_compress() must be called once all the lines have been written.
+ *
+ * Subsampled components (dx or dy != 1) are not supported.
+ *
+ * @param   p_codec             the jpeg2000 codec.
+ * @param   p_nb_lines          number of lines in p_data.
+ * @param   p_data              pointer to the lines to write. Data is arranged in sequence,
+ *                              the p_nb_lines lines of comp0, then those of comp1, then ...
+ *                              NO INTERLEAVING should be set. Each sample is coded
+ *                              on 1, 2 or 4 bytes, as in opj_write_tile().
+ * @param   p_data_size         size of p_data. It must be equal to the sum for each component
+ *                              of image_width * p_nb_lines * component_size.
+ * @param   p_stream            the stream to write data to.
+ *
+ * @return  true if the data could be written.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_write_strip(opj_codec_t *p_codec,
+        OPJ_UINT32 p_nb_lines,
+        const OPJ_BYTE * p_data,
+        OPJ_SIZE_T p_data_size,
+        opj_stream_t *p_stream);
+
 /**
  * Reads a tile header. This function is compulsory and allows one to know the size of the tile that will be decoded.
  * The user may need to refer to the image got by opj_read_header to understand the size being taken by the tile.
@@ -1593,6 +2070,20 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_setup_encoder(opj_codec_t *p_codec,
  * <li>PLT=YES/NO. Defaults to NO. If set to YES, PLT marker segments,
  *     indicating the length of each packet in the tile-part header, will be
  *     written. Since 2.3.2</li>
+ * <li>LAZY_NO_DISTORTION=YES/NO. Defaults to NO. If set to YES, this does
+ *     exactly two things: it sets the selective arithmetic coding bypass
+ *     (LAZY, code-block style 0x01) on all code-blocks, in the COD and COC
+ *     marker segments, and it skips the distortion estimation of each coding
+ *     pass when no quality layer requires rate/distortion optimization
+ *     (lossless encoding). This trades compression efficiency for encoding
+ *     speed: the coding style of the codestream changes, and as the
+ *     significance propagation and magnitude refinement passes of the lower
+ *     bit-planes are written without entropy coding, lossless codestreams
+ *     are larger and lossy codestreams have a lower quality at a given
+ *     rate. The speedup of the block coder is moderate, as the cleanup
+ *     passes remain arithmetic coded. This is not the HT block coder of
+ *     JPEG 2000 Part 15, which is not implemented: the result is a
+ *     JPEG 2000 Part-1 codestream. Since 2.4.0</li>
  * </ul>
  *
  * @param p_codec       Compressor handle
@@ -1608,6 +2099,17 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_encoder_set_extra_options(
 
 /**
  * Start to compress the current image.
+ *
+ * Once opj_end_compress() has returned, the same compressor handle may be
+ * used to compress another image, by calling opj_start_compress() again with
+ * a new image and stream. The new image must have the same geometry (origin,
+ * size, number of components, sub-sampling, precision and signedness) as the
+ * image previously compressed with this handle, otherwise
+ * opj_start_compress() fails. The coding parameters, computed by
+ * opj_setup_encoder() for the first image of the series, the tile coder
+ * structures, thread pool and code-block contexts are then reused, so that
+ * opj_setup_encoder() is only paid once for a series of similar images.
+ *
  * @param p_codec       Compressor handle
  * @param p_image       Input filled image
  * @param p_stream      Input stgream
@@ -1618,6 +2120,10 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_start_compress(opj_codec_t *p_codec,
 
 /**
  * End to compress the current image.
+ *
+ * The tile coder structures are kept until opj_destroy_codec(), so that they
+ * can be reused if another image is compressed (see opj_start_compress()).
+ *
  * @param p_codec       Compressor handle
  * @param p_stream      Input stgream
  */
@@ -1633,6 +2139,54 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_end_compress(opj_codec_t *p_codec,
  */
 OPJ_API OPJ_BOOL OPJ_CALLCONV opj_encode(opj_codec_t *p_codec,
         opj_stream_t *p_stream);
+
+/**
+ * Starts encoding an image into a JPEG-2000 codestream in a new thread, like
+ * opj_encode(), and returns without waiting for the encoding to finish.
+ *
+ * This is to be used instead of opj_encode(), between opj_start_compress()
+ * and opj_end_compress(). The same rules as for opj_decode_async() apply:
+ * p_callback is called from the new thread with the result of the encoding,
+ * and opj_wait_completion() must be called before opj_end_compress().
+ *
+ * @param p_codec       compressor handle
+ * @param p_stream      Output buffer stream
+ * @param p_callback    function called when the encoding is finished
+ * @param client_data   value passed to p_callback
+ *
+ * @return              true if the encoding has started, otherwise false,
+ *                      in which case p_callback is not called
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_encode_async(opj_codec_t *p_codec,
+        opj_stream_t *p_stream,
+        opj_completion_callback p_callback,
+        void *client_data);
+
+/**
+ * Encode an image into a JPEG-2000 codestream, reading the samples directly
+ * from an interleaved buffer instead of the component planes of the image.
+ *
+ * This is to be used instead of opj_encode(), between opj_start_compress()
+ * and opj_end_compress(). The image given to opj_start_compress() only
+ * describes the geometry and should be created without sample data, with
+ * opj_image_tile_create(). Each tile is filled from the buffer with the DC
+ * level shift applied on the fly, which avoids de-interleaving the frame
+ * into 32-bit planes and copying it into the tile buffers.
+ *
+ * Subsampled components (dx or dy != 1) are not supported. The precision of
+ * each component must fit in bytes_per_sample bytes.
+ *
+ * @param p_codec       compressor handle
+ * @param p_buffer      description of the interleaved input buffer
+ * @param p_stream      Output buffer stream
+ *
+ * @return              Returns true if successful, returns false otherwise
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_encode_interleaved(opj_codec_t *p_codec,
+        const opj_interleaved_buffer_t *p_buffer,
+        opj_stream_t *p_stream);
 /*
 ==========================================================
    codec output functions definitions
@@ -1707,6 +2261,30 @@ OPJ_API opj_jp2_metadata_t* OPJ_CALLCONV opj_get_jp2_metadata(
  */
 OPJ_API opj_jp2_index_t* OPJ_CALLCONV opj_get_jp2_index(opj_codec_t *p_codec);
 
+/**
+ * Parses the main characteristics of an image from the beginning of a raw
+ * JPEG 2000 codestream or of a JP2 file held in memory, without creating a
+ * codec. Only the SIZ, COD and QCD markers of the main header (and, for a
+ * JP2 file, the boxes that precede the codestream and the colour
+ * specification box) are looked at, and no memory is allocated, so that
+ * large collections of files can be indexed cheaply.
+ *
+ * The data must at least contain the SIZ marker. COD and QCD are reported
+ * when they are found before the end of the data or the first SOT marker.
+ * Other markers are skipped without being validated, so a successful probe
+ * does not imply that the image can be decoded.
+ *
+ * @param   p_data          the first bytes of the codestream or JP2 file.
+ * @param   p_data_size     the number of bytes available in p_data.
+ * @param   p_info          the structure to fill.
+ *
+ * @return OPJ_TRUE if the header could be parsed.
+ * @since 2.4.0
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_probe_header(const OPJ_BYTE *p_data,
+        OPJ_SIZE_T p_data_size,
+        opj_header_info_t *p_info);
+
 
 /*
 ==========================================================
@@ -1743,6 +2321,36 @@ OPJ_API OPJ_BOOL OPJ_CALLCONV opj_has_thread_support(void);
 /** Return the number of virtual CPUs */
 OPJ_API int OPJ_CALLCONV opj_get_num_cpus(void);
 
+/*
+==========================================================
+   Performance counter functions
+==========================================================
+*/
+
+/**
+ * Gets the hardware performance counters accumulated by each stage of the
+ * coding pipeline, by all the codecs of the process, since the start of
+ * the process or the last call to opj_reset_perf_counters().
+ *
+ * Counters are only collected when the library is built with the
+ * OPJ_USE_PERF_COUNTERS CMake option, on Linux, and when the kernel lets
+ * the process use perf_event_open() (see
+ * /proc/sys/kernel/perf_event_paranoid).
+ *
+ * @param   p_counters  array of OPJ_PERF_NB_STAGES counters, indexed by
+ *                      OPJ_PERF_STAGE, filled by the function.
+ *
+ * @return OPJ_TRUE if counters are collected, OPJ_FALSE otherwise (and
+ *         p_counters is then set to 0).
+ */
+OPJ_API OPJ_BOOL OPJ_CALLCONV opj_get_perf_counters(opj_perf_counters_t
+        *p_counters);
+
+/**
+ * Resets to 0 the hardware performance counters of all the stages.
+ */
+OPJ_API void OPJ_CALLCONV opj_reset_perf_counters(void);
+
 
 #ifdef __cplusplus
 }
@@ -65,3 +65,16 @@ OPJ_FLOAT64 opj_clock(void)
 #endif
 }
 
+OPJ_FLOAT64 opj_wall_clock(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, t ;
+    QueryPerformanceFrequency(&freq) ;
+    QueryPerformanceCounter(& t) ;
+    return ((OPJ_FLOAT64) t.QuadPart / (OPJ_FLOAT64) freq.QuadPart) ;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (OPJ_FLOAT64)tv.tv_sec + (OPJ_FLOAT64)tv.tv_usec * 1e-6;
+#endif
+}
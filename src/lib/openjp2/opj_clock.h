@@ -50,6 +50,13 @@ Difference in successive opj_clock() calls tells you the elapsed time
 */
 OPJ_FLOAT64 opj_clock(void);
 
+/**
+Difference in successive opj_wall_clock() calls tells you the elapsed real
+time, unlike opj_clock() that measures the processor time of the process
+@return Returns time in seconds
+*/
+OPJ_FLOAT64 opj_wall_clock(void);
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
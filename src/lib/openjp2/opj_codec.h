@@ -99,6 +99,13 @@ typedef struct opj_codec_private {
                                            OPJ_INT32 p_end_y,
                                            struct opj_event_mgr * p_manager);
 
+            /** Estimate decoding cost function handler */
+            OPJ_BOOL(*opj_estimate_decode)(void * p_codec,
+                                           opj_stream_private_t * p_cio,
+                                           opj_image_t * p_image,
+                                           opj_decode_estimate_t * p_estimate,
+                                           struct opj_event_mgr * p_manager);
+
             /** Get tile function */
             OPJ_BOOL(*opj_get_decoded_tile)(void *p_codec,
                                             opj_stream_private_t * p_cio,
@@ -116,6 +123,30 @@ typedef struct opj_codec_private {
                                                   OPJ_UINT32 num_comps,
                                                   const OPJ_UINT32* comps_indices,
                                                   opj_event_mgr_t * p_manager);
+
+            /** Reset the decoder to read another codestream */
+            OPJ_BOOL(*opj_decoder_reset)(void * p_codec,
+                                         opj_event_mgr_t * p_manager);
+
+            /** Set the budget of the cache of decoded code-blocks */
+            OPJ_BOOL(*opj_set_cblk_cache_size)(void * p_codec,
+                                               OPJ_SIZE_T max_size,
+                                               opj_event_mgr_t * p_manager);
+
+            /** Set the maximum number of coding passes decoded per code-block */
+            OPJ_BOOL(*opj_set_max_cblk_passes)(void * p_codec,
+                                               OPJ_UINT32 max_passes,
+                                               opj_event_mgr_t * p_manager);
+
+            /** Set whether truncated codestreams are rejected */
+            OPJ_BOOL(*opj_set_strict_mode)(void * p_codec,
+                                           OPJ_BOOL strict,
+                                           opj_event_mgr_t * p_manager);
+
+            /** Set the time after which decoding stops */
+            OPJ_BOOL(*opj_set_deadline)(void * p_codec,
+                                        OPJ_UINT32 deadline_ms,
+                                        opj_event_mgr_t * p_manager);
         } m_decompression;
 
         /**
@@ -131,6 +162,11 @@ typedef struct opj_codec_private {
                                    struct opj_stream_private *p_cio,
                                    struct opj_event_mgr * p_manager);
 
+            OPJ_BOOL(* opj_encode_interleaved)(void * p_codec,
+                                               const opj_interleaved_buffer_t * p_buffer,
+                                               struct opj_stream_private *p_cio,
+                                               struct opj_event_mgr * p_manager);
+
             OPJ_BOOL(* opj_write_tile)(void * p_codec,
                                        OPJ_UINT32 p_tile_index,
                                        OPJ_BYTE * p_data,
@@ -138,6 +174,13 @@ typedef struct opj_codec_private {
                                        struct opj_stream_private * p_cio,
                                        struct opj_event_mgr * p_manager);
 
+            OPJ_BOOL(* opj_write_strip)(void * p_codec,
+                                        OPJ_UINT32 p_nb_lines,
+                                        const OPJ_BYTE * p_data,
+                                        OPJ_SIZE_T p_data_size,
+                                        struct opj_stream_private * p_cio,
+                                        struct opj_event_mgr * p_manager);
+
             OPJ_BOOL(* opj_end_compress)(void * p_codec,
                                          struct opj_stream_private * p_cio,
                                          struct opj_event_mgr * p_manager);
@@ -168,6 +211,25 @@ typedef struct opj_codec_private {
 
     /** Set number of threads */
     OPJ_BOOL(*opj_set_threads)(void * p_codec, OPJ_UINT32 num_threads);
+
+    /** Get the requests to stop the operation in progress */
+    opj_interrupt_t* (*opj_get_interrupt)(void * p_codec);
+
+    /** Asynchronous operation, see opj_decode_async() and opj_encode_async() */
+    struct opj_codec_async {
+        /** Thread running the operation, NULL if none or once joined */
+        opj_thread_t* thread;
+        /** Stream of the operation */
+        opj_stream_private_t* stream;
+        /** Image decoded by the operation, NULL when encoding */
+        opj_image_t* image;
+        /** Function called when the operation is finished */
+        opj_completion_callback callback;
+        /** Client data of callback */
+        void* client_data;
+        /** Result of the last operation */
+        OPJ_BOOL result;
+    } m_async;
 }
 opj_codec_private_t;
 
@@ -228,6 +228,7 @@ typedef unsigned int OPJ_BITFIELD;
 
 #include "thread.h"
 #include "tls_keys.h"
+#include "opj_perf.h"
 
 #include "image.h"
 #include "invert.h"
@@ -0,0 +1,249 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef OPJ_USE_PERF_COUNTERS
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "opj_includes.h"
+
+/** Number of hardware events counted per stage */
+#define OPJ_PERF_NB_EVENTS 4
+
+/** Hardware events, in the order of the fields of opj_perf_counters_t */
+static const OPJ_UINT64 opj_perf_events[OPJ_PERF_NB_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, /* last level cache misses on most CPUs */
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/** Counters of a thread */
+typedef struct opj_perf_thread {
+    /** Number of events opened. Events the CPU does not support are skipped */
+    int nb_events;
+    /** File descriptors of the events, the first one being the group leader */
+    int fds[OPJ_PERF_NB_EVENTS];
+    /** Index in opj_perf_events[] of each opened event */
+    int event_idx[OPJ_PERF_NB_EVENTS];
+    /** Stage being accounted, or -1 */
+    int stage;
+    /** Counts at the start of the stage */
+    OPJ_UINT64 start[OPJ_PERF_NB_EVENTS];
+} opj_perf_thread_t;
+
+static pthread_once_t opj_perf_once = PTHREAD_ONCE_INIT;
+static pthread_key_t opj_perf_key;
+static OPJ_BOOL opj_perf_key_created = OPJ_FALSE;
+static pthread_mutex_t opj_perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Counts per stage, summed over all threads. Protected by opj_perf_mutex */
+static OPJ_UINT64 opj_perf_totals[OPJ_PERF_NB_STAGES][OPJ_PERF_NB_EVENTS];
+
+static void opj_perf_thread_destroy(void* user_data)
+{
+    opj_perf_thread_t* l_thread = (opj_perf_thread_t*) user_data;
+    int i;
+
+    for (i = 0; i < l_thread->nb_events; ++i) {
+        close(l_thread->fds[i]);
+    }
+    opj_free(l_thread);
+}
+
+static void opj_perf_create_key(void)
+{
+    opj_perf_key_created = pthread_key_create(&opj_perf_key,
+                           opj_perf_thread_destroy) == 0;
+}
+
+static int opj_perf_event_open(OPJ_UINT64 event, int group_fd)
+{
+    struct perf_event_attr l_attr;
+    unsigned long l_flags = 0;
+
+    memset(&l_attr, 0, sizeof(l_attr));
+    l_attr.size = sizeof(l_attr);
+    l_attr.type = PERF_TYPE_HARDWARE;
+    l_attr.config = event;
+    l_attr.read_format = PERF_FORMAT_GROUP;
+    /* Only user space, which lets unprivileged processes count their */
+    /* own threads with the default perf_event_paranoid setting */
+    l_attr.exclude_kernel = 1;
+    l_attr.exclude_hv = 1;
+#ifdef PERF_FLAG_FD_CLOEXEC
+    l_flags = PERF_FLAG_FD_CLOEXEC;
+#endif
+    /* Counts the calling thread, on any CPU */
+    return (int)syscall(__NR_perf_event_open, &l_attr, 0, -1, group_fd,
+                        l_flags);
+}
+
+/** Returns the counters of the calling thread, opening them on first use */
+static opj_perf_thread_t* opj_perf_get_thread(void)
+{
+    opj_perf_thread_t* l_thread;
+    int i;
+
+    pthread_once(&opj_perf_once, opj_perf_create_key);
+    if (!opj_perf_key_created) {
+        return NULL;
+    }
+    l_thread = (opj_perf_thread_t*) pthread_getspecific(opj_perf_key);
+    if (l_thread != NULL) {
+        return l_thread;
+    }
+
+    l_thread = (opj_perf_thread_t*) opj_calloc(1, sizeof(opj_perf_thread_t));
+    if (l_thread == NULL) {
+        return NULL;
+    }
+    l_thread->stage = -1;
+    for (i = 0; i < OPJ_PERF_NB_EVENTS; ++i) {
+        int l_fd = opj_perf_event_open(opj_perf_events[i],
+                                       l_thread->nb_events ? l_thread->fds[0] : -1);
+        if (l_fd >= 0) {
+            l_thread->fds[l_thread->nb_events] = l_fd;
+            l_thread->event_idx[l_thread->nb_events] = i;
+            l_thread->nb_events ++;
+        }
+    }
+    if (pthread_setspecific(opj_perf_key, l_thread) != 0) {
+        opj_perf_thread_destroy(l_thread);
+        return NULL;
+    }
+    return l_thread;
+}
+
+/** Reads all the counters of the group of a thread in one system call */
+static OPJ_BOOL opj_perf_read(const opj_perf_thread_t* p_thread,
+                              OPJ_UINT64* p_values)
+{
+    /* Number of events, then their values */
+    OPJ_UINT64 l_buffer[1 + OPJ_PERF_NB_EVENTS];
+    ssize_t l_size = (ssize_t)((1 + (size_t)p_thread->nb_events) *
+                               sizeof(OPJ_UINT64));
+
+    if (read(p_thread->fds[0], l_buffer, (size_t)l_size) != l_size ||
+            l_buffer[0] != (OPJ_UINT64)p_thread->nb_events) {
+        return OPJ_FALSE;
+    }
+    memcpy(p_values, l_buffer + 1,
+           (size_t)p_thread->nb_events * sizeof(OPJ_UINT64));
+    return OPJ_TRUE;
+}
+
+void opj_perf_start(int stage)
+{
+    opj_perf_thread_t* l_thread;
+
+    if (stage < 0 || stage >= OPJ_PERF_NB_STAGES) {
+        return;
+    }
+    l_thread = opj_perf_get_thread();
+    if (l_thread == NULL || l_thread->nb_events == 0) {
+        return;
+    }
+    /* A stage left started by an early error return is simply restarted */
+    l_thread->stage = opj_perf_read(l_thread, l_thread->start) ? stage : -1;
+}
+
+void opj_perf_stop(int stage)
+{
+    opj_perf_thread_t* l_thread;
+    OPJ_UINT64 l_values[OPJ_PERF_NB_EVENTS];
+    int i;
+
+    if (stage < 0) {
+        return;
+    }
+    l_thread = opj_perf_get_thread();
+    if (l_thread == NULL || l_thread->stage != stage) {
+        return;
+    }
+    l_thread->stage = -1;
+    if (!opj_perf_read(l_thread, l_values)) {
+        return;
+    }
+    pthread_mutex_lock(&opj_perf_mutex);
+    for (i = 0; i < l_thread->nb_events; ++i) {
+        opj_perf_totals[stage][l_thread->event_idx[i]] +=
+            l_values[i] - l_thread->start[i];
+    }
+    pthread_mutex_unlock(&opj_perf_mutex);
+}
+
+int opj_perf_current_stage(void)
+{
+    opj_perf_thread_t* l_thread = opj_perf_get_thread();
+    return l_thread != NULL ? l_thread->stage : -1;
+}
+
+OPJ_BOOL OPJ_CALLCONV opj_get_perf_counters(opj_perf_counters_t *p_counters)
+{
+    opj_perf_thread_t* l_thread = opj_perf_get_thread();
+    int i;
+
+    pthread_mutex_lock(&opj_perf_mutex);
+    for (i = 0; i < OPJ_PERF_NB_STAGES; ++i) {
+        p_counters[i].cycles = opj_perf_totals[i][0];
+        p_counters[i].instructions = opj_perf_totals[i][1];
+        p_counters[i].llc_misses = opj_perf_totals[i][2];
+        p_counters[i].branch_misses = opj_perf_totals[i][3];
+    }
+    pthread_mutex_unlock(&opj_perf_mutex);
+    return l_thread != NULL && l_thread->nb_events > 0;
+}
+
+void OPJ_CALLCONV opj_reset_perf_counters(void)
+{
+    pthread_mutex_lock(&opj_perf_mutex);
+    memset(opj_perf_totals, 0, sizeof(opj_perf_totals));
+    pthread_mutex_unlock(&opj_perf_mutex);
+}
+
+#else
+
+#include "opj_includes.h"
+
+OPJ_BOOL OPJ_CALLCONV opj_get_perf_counters(opj_perf_counters_t *p_counters)
+{
+    memset(p_counters, 0, OPJ_PERF_NB_STAGES * sizeof(opj_perf_counters_t));
+    return OPJ_FALSE;
+}
+
+void OPJ_CALLCONV opj_reset_perf_counters(void)
+{
+}
+
+#endif /* OPJ_USE_PERF_COUNTERS */
@@ -0,0 +1,83 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OPJ_PERF_H
+#define OPJ_PERF_H
+/**
+@file opj_perf.h
+@brief Hardware performance counters of the pipeline stages
+
+The functions in this file read, on Linux, the hardware performance counters
+of the calling thread with perf_event_open() at the start and at the end of
+each stage of the coding pipeline, and accumulate the differences per stage.
+They are only compiled in with the OPJ_USE_PERF_COUNTERS CMake option; the
+OPJ_PERF_START() and OPJ_PERF_STOP() macros expand to nothing otherwise.
+
+Jobs run by the threads of a thread pool are accounted to the stage of the
+thread that submitted them, so that a stage sums the work of all threads.
+*/
+
+/** @defgroup PERF PERF - Hardware performance counters */
+/*@{*/
+
+#ifdef OPJ_USE_PERF_COUNTERS
+
+/**
+ * Starts accounting the counters of the calling thread to a stage.
+ * @param stage OPJ_PERF_STAGE value, or -1 to do nothing.
+ */
+void opj_perf_start(int stage);
+
+/**
+ * Stops accounting the counters of the calling thread to a stage, and adds
+ * the counts since the matching opj_perf_start() to the stage.
+ * @param stage OPJ_PERF_STAGE value, or -1 to do nothing.
+ */
+void opj_perf_stop(int stage);
+
+/**
+ * Returns the stage of the calling thread.
+ * @return the OPJ_PERF_STAGE started by the calling thread, or -1.
+ */
+int opj_perf_current_stage(void);
+
+#define OPJ_PERF_START(stage) opj_perf_start(stage)
+#define OPJ_PERF_STOP(stage) opj_perf_stop(stage)
+
+#else
+
+#define OPJ_PERF_START(stage)
+#define OPJ_PERF_STOP(stage)
+
+#endif /* OPJ_USE_PERF_COUNTERS */
+
+/*@}*/
+
+#endif /* OPJ_PERF_H */
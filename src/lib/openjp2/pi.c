@@ -77,6 +77,43 @@ Get next packet in component-precinct-resolution-layer order.
 */
 static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi);
 
+/**
+Allocate the bitmap recording which packets have already been returned.
+@param nb_packets number of packets addressable with the step_l/r/c/p steps
+@return the zero-initialized bitmap, or NULL on failure
+*/
+static OPJ_UINT32 * opj_pi_alloc_include(OPJ_UINT32 nb_packets);
+/**
+Mark a packet as returned by the iterator.
+@param include bitmap allocated with opj_pi_alloc_include()
+@param index index of the packet in the bitmap
+@return true if the packet had not been returned yet
+*/
+static INLINE OPJ_BOOL opj_pi_include_packet(OPJ_UINT32 * include,
+        OPJ_UINT32 index);
+/**
+Get the next position to visit along x (or y) in the RPCL, PCRL and CPRL
+progressions. Instead of walking through every multiple of pi->dx (resp.
+pi->dy), jump to the next such multiple that lies on a precinct boundary of
+one of the given components and resolutions: the others can not start a
+packet. The order of the packets is unchanged.
+@param pi packet iterator
+@param pos current position
+@param vertical OPJ_TRUE for y, OPJ_FALSE for x
+@param compno0 first component
+@param compno1 last component (excluded)
+@param resno0 first resolution
+@param resno1 last resolution (excluded)
+@return the next position, UINT_MAX if there is none
+*/
+static OPJ_UINT32 opj_pi_next_position(const opj_pi_iterator_t * pi,
+                                       OPJ_UINT32 pos,
+                                       OPJ_BOOL vertical,
+                                       OPJ_UINT32 compno0,
+                                       OPJ_UINT32 compno1,
+                                       OPJ_UINT32 resno0,
+                                       OPJ_UINT32 resno1);
+
 /**
  * Updates the coding parameters if the encoding is used with Progression order changes and final (or cinema parameters are used).
  *
@@ -234,6 +271,98 @@ static OPJ_BOOL opj_pi_check_next_level(OPJ_INT32 pos,
 ==========================================================
 */
 
+static OPJ_UINT32 * opj_pi_alloc_include(OPJ_UINT32 nb_packets)
+{
+    /* One bit per packet */
+    return (OPJ_UINT32*) opj_calloc(((OPJ_SIZE_T)nb_packets + 31U) / 32U,
+                                    sizeof(OPJ_UINT32));
+}
+
+static INLINE OPJ_BOOL opj_pi_include_packet(OPJ_UINT32 * include,
+        OPJ_UINT32 index)
+{
+    OPJ_UINT32 * l_word = &include[index >> 5];
+    OPJ_UINT32 l_mask = 1U << (index & 31U);
+    if (*l_word & l_mask) {
+        return OPJ_FALSE;
+    }
+    *l_word |= l_mask;
+    return OPJ_TRUE;
+}
+
+static OPJ_UINT32 opj_pi_gcd(OPJ_UINT32 a, OPJ_UINT32 b)
+{
+    while (b != 0) {
+        OPJ_UINT32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static OPJ_UINT32 opj_pi_next_position(const opj_pi_iterator_t * pi,
+                                       OPJ_UINT32 pos,
+                                       OPJ_BOOL vertical,
+                                       OPJ_UINT32 compno0,
+                                       OPJ_UINT32 compno1,
+                                       OPJ_UINT32 resno0,
+                                       OPJ_UINT32 resno1)
+{
+    OPJ_UINT32 l_step = vertical ? pi->dy : pi->dx;
+    OPJ_BOOL l_step_pow2 = (l_step & (l_step - 1)) == 0;
+    /* Next position of the exhaustive walk */
+    OPJ_UINT64 l_walk_next = l_step_pow2 ? ((OPJ_UINT64)pos | (l_step - 1)) + 1 :
+                             (OPJ_UINT64)pos + (l_step - (pos % l_step));
+    OPJ_UINT64 l_next = 0;
+    OPJ_BOOL l_found = OPJ_FALSE;
+    OPJ_UINT32 compno, resno;
+
+    /* Tile parts of the encoder may start from any multiple of the step, */
+    /* so keep the exhaustive walk in that case */
+    if (pi->tp_on) {
+        return pos + (l_step - (pos % l_step));
+    }
+    for (compno = compno0; compno < compno1; compno++) {
+        const opj_pi_comp_t *comp = &pi->comps[compno];
+        OPJ_UINT32 l_sub = vertical ? comp->dy : comp->dx;
+        /* Finest resolutions first, as they have the smallest precincts */
+        for (resno = opj_uint_min(resno1, comp->numresolutions); resno > resno0;) {
+            const opj_pi_resolution_t *res = &comp->resolutions[--resno];
+            OPJ_UINT32 l_rp = (vertical ? res->pdy : res->pdx) +
+                              comp->numresolutions - 1 - resno;
+            OPJ_UINT32 l_prc_step;
+            OPJ_UINT64 l_lcm, l_candidate;
+            /* Same validity test as the callers, which skip these */
+            if (l_rp >= 31 || ((l_sub << l_rp) >> l_rp) != l_sub) {
+                continue;
+            }
+            l_prc_step = l_sub << l_rp;
+            /* Only the multiples of the lcm of the precinct size and of */
+            /* the step are visited by the walk and start a precinct */
+            if (l_step_pow2 && (l_prc_step & (l_prc_step - 1)) == 0) {
+                l_lcm = opj_uint_max(l_prc_step, l_step);
+                l_candidate = ((OPJ_UINT64)pos | (l_lcm - 1)) + 1;
+            } else {
+                l_lcm = (OPJ_UINT64)(l_prc_step / opj_pi_gcd(l_prc_step, l_step)) *
+                        l_step;
+                l_candidate = ((OPJ_UINT64)pos / l_lcm + 1) * l_lcm;
+            }
+            if (!l_found || l_candidate < l_next) {
+                l_next = l_candidate;
+                l_found = OPJ_TRUE;
+                if (l_next == l_walk_next) {
+                    /* Can not do better */
+                    return l_next > UINT_MAX ? UINT_MAX : (OPJ_UINT32)l_next;
+                }
+            }
+        }
+    }
+    if (!l_found) {
+        l_next = l_walk_next;
+    }
+    return l_next > UINT_MAX ? UINT_MAX : (OPJ_UINT32)l_next;
+}
+
 static OPJ_BOOL opj_pi_next_lrcp(opj_pi_iterator_t * pi)
 {
     opj_pi_comp_t *comp = NULL;
@@ -280,8 +409,7 @@ static OPJ_BOOL opj_pi_next_lrcp(opj_pi_iterator_t * pi)
                         opj_event_msg(pi->manager, EVT_ERROR, "Invalid access to pi->include");
                         return OPJ_FALSE;
                     }
-                    if (!pi->include[index]) {
-                        pi->include[index] = 1;
+                    if (opj_pi_include_packet(pi->include, index)) {
                         return OPJ_TRUE;
                     }
 LABEL_SKIP:
@@ -333,8 +461,7 @@ static OPJ_BOOL opj_pi_next_rlcp(opj_pi_iterator_t * pi)
                         opj_event_msg(pi->manager, EVT_ERROR, "Invalid access to pi->include");
                         return OPJ_FALSE;
                     }
-                    if (!pi->include[index]) {
-                        pi->include[index] = 1;
+                    if (opj_pi_include_packet(pi->include, index)) {
                         return OPJ_TRUE;
                     }
 LABEL_SKIP:
@@ -396,9 +523,13 @@ static OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi)
     }
     for (pi->resno = pi->poc.resno0; pi->resno < pi->poc.resno1; pi->resno++) {
         for (pi->y = (OPJ_UINT32)pi->poc.ty0; pi->y < (OPJ_UINT32)pi->poc.ty1;
-                pi->y += (pi->dy - (pi->y % pi->dy))) {
+                pi->y = opj_pi_next_position(pi, pi->y, OPJ_TRUE,
+                                             pi->poc.compno0, pi->poc.compno1,
+                                             pi->resno, pi->resno + 1)) {
             for (pi->x = (OPJ_UINT32)pi->poc.tx0; pi->x < (OPJ_UINT32)pi->poc.tx1;
-                    pi->x += (pi->dx - (pi->x % pi->dx))) {
+                    pi->x = opj_pi_next_position(pi, pi->x, OPJ_FALSE,
+                                                 pi->poc.compno0, pi->poc.compno1,
+                                                 pi->resno, pi->resno + 1)) {
                 for (pi->compno = pi->poc.compno0; pi->compno < pi->poc.compno1; pi->compno++) {
                     OPJ_UINT32 levelno;
                     OPJ_UINT32 trx0, try0;
@@ -423,10 +554,6 @@ static OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi)
                             (comp->dy << levelno) > INT_MAX) {
                         continue;
                     }
-                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
-                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
-                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
-                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
                     rpx = res->pdx + levelno;
                     rpy = res->pdy + levelno;
 
@@ -441,14 +568,22 @@ static OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi)
 
                     /* See ISO-15441. B.12.1.3 Resolution level-position-component-layer progression */
                     if (!((pi->y % (comp->dy << rpy) == 0) || ((pi->y == pi->ty0) &&
-                            ((try0 << levelno) % (1U << rpy))))) {
+                            ((opj_uint_ceildiv(pi->ty0, (comp->dy << levelno)) << levelno) %
+                             (1U << rpy))))) {
                         continue;
                     }
                     if (!((pi->x % (comp->dx << rpx) == 0) || ((pi->x == pi->tx0) &&
-                            ((trx0 << levelno) % (1U << rpx))))) {
+                            ((opj_uint_ceildiv(pi->tx0, (comp->dx << levelno)) << levelno) %
+                             (1U << rpx))))) {
                         continue;
                     }
 
+                    /* Only computed for the positions on a precinct boundary */
+                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
+                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
+                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
+                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
+
                     if ((res->pw == 0) || (res->ph == 0)) {
                         continue;
                     }
@@ -471,8 +606,7 @@ static OPJ_BOOL opj_pi_next_rpcl(opj_pi_iterator_t * pi)
                             opj_event_msg(pi->manager, EVT_ERROR, "Invalid access to pi->include");
                             return OPJ_FALSE;
                         }
-                        if (!pi->include[index]) {
-                            pi->include[index] = 1;
+                        if (opj_pi_include_packet(pi->include, index)) {
                             return OPJ_TRUE;
                         }
 LABEL_SKIP:
@@ -535,9 +669,13 @@ static OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi)
         pi->poc.tx1 = pi->tx1;
     }
     for (pi->y = (OPJ_UINT32)pi->poc.ty0; pi->y < (OPJ_UINT32)pi->poc.ty1;
-            pi->y += (pi->dy - (pi->y % pi->dy))) {
+            pi->y = opj_pi_next_position(pi, pi->y, OPJ_TRUE,
+                                         pi->poc.compno0, pi->poc.compno1,
+                                         pi->poc.resno0, pi->poc.resno1)) {
         for (pi->x = (OPJ_UINT32)pi->poc.tx0; pi->x < (OPJ_UINT32)pi->poc.tx1;
-                pi->x += (pi->dx - (pi->x % pi->dx))) {
+                pi->x = opj_pi_next_position(pi, pi->x, OPJ_FALSE,
+                                             pi->poc.compno0, pi->poc.compno1,
+                                             pi->poc.resno0, pi->poc.resno1)) {
             for (pi->compno = pi->poc.compno0; pi->compno < pi->poc.compno1; pi->compno++) {
                 comp = &pi->comps[pi->compno];
                 for (pi->resno = pi->poc.resno0;
@@ -561,10 +699,6 @@ static OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi)
                             (comp->dy << levelno) > INT_MAX) {
                         continue;
                     }
-                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
-                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
-                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
-                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
                     rpx = res->pdx + levelno;
                     rpy = res->pdy + levelno;
 
@@ -579,14 +713,22 @@ static OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi)
 
                     /* See ISO-15441. B.12.1.4 Position-component-resolution level-layer progression */
                     if (!((pi->y % (comp->dy << rpy) == 0) || ((pi->y == pi->ty0) &&
-                            ((try0 << levelno) % (1U << rpy))))) {
+                            ((opj_uint_ceildiv(pi->ty0, (comp->dy << levelno)) << levelno) %
+                             (1U << rpy))))) {
                         continue;
                     }
                     if (!((pi->x % (comp->dx << rpx) == 0) || ((pi->x == pi->tx0) &&
-                            ((trx0 << levelno) % (1U << rpx))))) {
+                            ((opj_uint_ceildiv(pi->tx0, (comp->dx << levelno)) << levelno) %
+                             (1U << rpx))))) {
                         continue;
                     }
 
+                    /* Only computed for the positions on a precinct boundary */
+                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
+                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
+                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
+                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
+
                     if ((res->pw == 0) || (res->ph == 0)) {
                         continue;
                     }
@@ -609,8 +751,7 @@ static OPJ_BOOL opj_pi_next_pcrl(opj_pi_iterator_t * pi)
                             opj_event_msg(pi->manager, EVT_ERROR, "Invalid access to pi->include");
                             return OPJ_FALSE;
                         }
-                        if (!pi->include[index]) {
-                            pi->include[index] = 1;
+                        if (opj_pi_include_packet(pi->include, index)) {
                             return OPJ_TRUE;
                         }
 LABEL_SKIP:
@@ -673,9 +814,13 @@ static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi)
             pi->poc.tx1 = pi->tx1;
         }
         for (pi->y = (OPJ_UINT32)pi->poc.ty0; pi->y < (OPJ_UINT32)pi->poc.ty1;
-                pi->y += (pi->dy - (pi->y % pi->dy))) {
+                pi->y = opj_pi_next_position(pi, pi->y, OPJ_TRUE,
+                                             pi->compno, pi->compno + 1,
+                                             pi->poc.resno0, pi->poc.resno1)) {
             for (pi->x = (OPJ_UINT32)pi->poc.tx0; pi->x < (OPJ_UINT32)pi->poc.tx1;
-                    pi->x += (pi->dx - (pi->x % pi->dx))) {
+                    pi->x = opj_pi_next_position(pi, pi->x, OPJ_FALSE,
+                                                 pi->compno, pi->compno + 1,
+                                                 pi->poc.resno0, pi->poc.resno1)) {
                 for (pi->resno = pi->poc.resno0;
                         pi->resno < opj_uint_min(pi->poc.resno1, comp->numresolutions); pi->resno++) {
                     OPJ_UINT32 levelno;
@@ -696,10 +841,6 @@ static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi)
                             (comp->dy << levelno) > INT_MAX) {
                         continue;
                     }
-                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
-                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
-                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
-                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
                     rpx = res->pdx + levelno;
                     rpy = res->pdy + levelno;
 
@@ -714,14 +855,22 @@ static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi)
 
                     /* See ISO-15441. B.12.1.5 Component-position-resolution level-layer progression */
                     if (!((pi->y % (comp->dy << rpy) == 0) || ((pi->y == pi->ty0) &&
-                            ((try0 << levelno) % (1U << rpy))))) {
+                            ((opj_uint_ceildiv(pi->ty0, (comp->dy << levelno)) << levelno) %
+                             (1U << rpy))))) {
                         continue;
                     }
                     if (!((pi->x % (comp->dx << rpx) == 0) || ((pi->x == pi->tx0) &&
-                            ((trx0 << levelno) % (1U << rpx))))) {
+                            ((opj_uint_ceildiv(pi->tx0, (comp->dx << levelno)) << levelno) %
+                             (1U << rpx))))) {
                         continue;
                     }
 
+                    /* Only computed for the positions on a precinct boundary */
+                    trx0 = opj_uint_ceildiv(pi->tx0, (comp->dx << levelno));
+                    try0 = opj_uint_ceildiv(pi->ty0, (comp->dy << levelno));
+                    trx1 = opj_uint_ceildiv(pi->tx1, (comp->dx << levelno));
+                    try1 = opj_uint_ceildiv(pi->ty1, (comp->dy << levelno));
+
                     if ((res->pw == 0) || (res->ph == 0)) {
                         continue;
                     }
@@ -744,8 +893,7 @@ static OPJ_BOOL opj_pi_next_cprl(opj_pi_iterator_t * pi)
                             opj_event_msg(pi->manager, EVT_ERROR, "Invalid access to pi->include");
                             return OPJ_FALSE;
                         }
-                        if (!pi->include[index]) {
-                            pi->include[index] = 1;
+                        if (opj_pi_include_packet(pi->include, index)) {
                             return OPJ_TRUE;
                         }
 LABEL_SKIP:
@@ -1481,8 +1629,7 @@ opj_pi_iterator_t *opj_pi_create_decode(opj_image_t *p_image,
     l_current_pi->include = 00;
     if (l_step_l <= (UINT_MAX / (l_tcp->numlayers + 1U))) {
         l_current_pi->include_size = (l_tcp->numlayers + 1U) * l_step_l;
-        l_current_pi->include = (OPJ_INT16*) opj_calloc(
-                                    l_current_pi->include_size, sizeof(OPJ_INT16));
+        l_current_pi->include = opj_pi_alloc_include(l_current_pi->include_size);
     }
 
     if (!l_current_pi->include) {
@@ -1699,9 +1846,11 @@ opj_pi_iterator_t *opj_pi_initialise_encode(const opj_image_t *p_image,
     l_current_pi = l_pi;
 
     /* memory allocation for include*/
-    l_current_pi->include_size = l_tcp->numlayers * l_step_l;
-    l_current_pi->include = (OPJ_INT16*) opj_calloc(l_current_pi->include_size,
-                            sizeof(OPJ_INT16));
+    l_current_pi->include = 00;
+    if (l_step_l <= (UINT_MAX / l_tcp->numlayers)) {
+        l_current_pi->include_size = l_tcp->numlayers * l_step_l;
+        l_current_pi->include = opj_pi_alloc_include(l_current_pi->include_size);
+    }
     if (!l_current_pi->include) {
         opj_free(l_tmp_data);
         opj_free(l_tmp_ptr);
@@ -73,9 +73,9 @@ Packet iterator
 typedef struct opj_pi_iterator {
     /** Enabling Tile part generation*/
     OPJ_BYTE tp_on;
-    /** precise if the packet has been already used (useful for progression order change) */
-    OPJ_INT16 *include;
-    /** Number of elements in include array */
+    /** bitmap telling if the packet has been already used (useful for progression order change) */
+    OPJ_UINT32 *include;
+    /** Number of packets (bits) in include bitmap */
     OPJ_UINT32 include_size;
     /** layer step used to localize the packet in the include vector */
     OPJ_UINT32 step_l;
@@ -195,7 +195,8 @@ static double opj_t1_encode_cblk(opj_t1_t *t1,
                                  OPJ_UINT32 cblksty,
                                  OPJ_UINT32 numcomps,
                                  const OPJ_FLOAT64 * mct_norms,
-                                 OPJ_UINT32 mct_numcomps);
+                                 OPJ_UINT32 mct_numcomps,
+                                 OPJ_BOOL compute_distortion);
 
 /**
 Decode 1 code-block
@@ -207,6 +208,9 @@ Decode 1 code-block
 @param p_manager the event manager
 @param p_manager_mutex mutex for the event manager
 @param check_pterm whether PTERM correct termination should be checked
+@param resume whether decoding must resume from t1->resume
+@param save_state whether a state to resume from must be saved in t1->resume
+@param max_passes maximum number of coding passes to decode, 0 for no limit
 */
 static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                                    opj_tcd_cblk_dec_t* cblk,
@@ -215,7 +219,10 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                                    OPJ_UINT32 cblksty,
                                    opj_event_mgr_t *p_manager,
                                    opj_mutex_t* p_manager_mutex,
-                                   OPJ_BOOL check_pterm);
+                                   OPJ_BOOL check_pterm,
+                                   OPJ_BOOL resume,
+                                   OPJ_BOOL save_state,
+                                   OPJ_UINT32 max_passes);
 
 static OPJ_BOOL opj_t1_allocate_buffers(opj_t1_t *t1,
                                         OPJ_UINT32 w,
@@ -1561,15 +1568,586 @@ void opj_t1_destroy(opj_t1_t *p_t1)
     }
 
     opj_free(p_t1->cblkdatabuffer);
+    opj_free(p_t1->resume.data);
+    opj_free(p_t1->resume.flags);
 
     opj_free(p_t1);
 }
 
+
+/* ----------------------------------------------------------------------- */
+
+/** Entry of the code-block cache */
+typedef struct opj_t1_cblk_cache_entry {
+    /** Position of the code-block */
+    OPJ_UINT32 tileno;
+    OPJ_UINT32 compno;
+    OPJ_UINT32 resno;
+    OPJ_UINT32 bandno;
+    OPJ_INT32 x0;
+    OPJ_INT32 y0;
+    /** Fingerprint of the codestream data the coefficients were decoded from */
+    OPJ_UINT32 len;
+    OPJ_UINT32 hash;
+    OPJ_UINT32 numpasses;
+    OPJ_UINT32 numbps;
+    OPJ_UINT32 roishift;
+    OPJ_UINT32 cblksty;
+    /** Dimensions of the code-block */
+    OPJ_UINT32 w;
+    OPJ_UINT32 h;
+    /** Memory accounted for the entry */
+    OPJ_SIZE_T size;
+    /** Next entry of the same hash bucket */
+    struct opj_t1_cblk_cache_entry* hash_next;
+    /** Previous (more recently used) and next entry in LRU order */
+    struct opj_t1_cblk_cache_entry* lru_prev;
+    struct opj_t1_cblk_cache_entry* lru_next;
+    /** w * h coefficients, as output by T1 before dequantization */
+    OPJ_INT32* data;
+    /** Copy of the len bytes of codestream data the coefficients were */
+    /** decoded from, as the hash alone could collide */
+    OPJ_BYTE* bytes;
+    /** State to resume decoding from when more passes are available */
+    opj_t1_resume_state_t resume;
+    /** Length and number of passes of each of the resume.segno segments */
+    /** preceding the one to resume from, checked along with the first */
+    /** resume.prefix_len bytes before resuming */
+    OPJ_UINT32* resume_segs;
+} opj_t1_cblk_cache_entry_t;
+
+struct opj_t1_cblk_cache {
+    /** Budget of the cache, in bytes */
+    OPJ_SIZE_T max_size;
+    /** Memory currently used by the entries */
+    OPJ_SIZE_T size;
+    /** Hash table of the entries, nb_buckets being a power of two */
+    opj_t1_cblk_cache_entry_t** buckets;
+    OPJ_UINT32 nb_buckets;
+    OPJ_UINT32 nb_entries;
+    /** Most and least recently used entries */
+    opj_t1_cblk_cache_entry_t* lru_head;
+    opj_t1_cblk_cache_entry_t* lru_tail;
+    /** Protects the cache against concurrent code-block decoding jobs */
+    opj_mutex_t* mutex;
+};
+
+static OPJ_UINT32 opj_t1_cblk_cache_bucket(const opj_t1_cblk_cache_t* cache,
+        const opj_t1_cblk_cache_entry_t* key)
+{
+    OPJ_UINT32 h = key->tileno;
+    h = h * 31U + key->compno;
+    h = h * 31U + key->resno;
+    h = h * 31U + key->bandno;
+    h = h * 0x9E3779B1U + (OPJ_UINT32)key->x0;
+    h = h * 0x9E3779B1U + (OPJ_UINT32)key->y0;
+    h ^= h >> 15;
+    return h & (cache->nb_buckets - 1U);
+}
+
+static OPJ_BOOL opj_t1_cblk_cache_same_position(const opj_t1_cblk_cache_entry_t*
+        a, const opj_t1_cblk_cache_entry_t* b)
+{
+    return a->tileno == b->tileno && a->compno == b->compno &&
+           a->resno == b->resno && a->bandno == b->bandno &&
+           a->x0 == b->x0 && a->y0 == b->y0;
+}
+
+/** Whether the first len bytes of the data of a code-block are bytes. */
+/** Returns OPJ_FALSE if the code-block has less data */
+static OPJ_BOOL opj_t1_cblk_same_bytes(const opj_tcd_cblk_dec_t* cblk,
+                                       const OPJ_BYTE* bytes,
+                                       OPJ_UINT32 len)
+{
+    OPJ_UINT32 i;
+
+    for (i = 0; i < cblk->numchunks && len > 0; ++i) {
+        OPJ_UINT32 l_len = opj_uint_min(cblk->chunks[i].len, len);
+        if (memcmp(cblk->chunks[i].data, bytes, l_len) != 0) {
+            return OPJ_FALSE;
+        }
+        bytes += l_len;
+        len -= l_len;
+    }
+    return len == 0;
+}
+
+/** Whether entry was decoded from the data of the code-block described by */
+/** key. The hashes are compared first, to reject most entries cheaply */
+static OPJ_BOOL opj_t1_cblk_cache_same_data(const opj_t1_cblk_cache_entry_t*
+        entry, const opj_t1_cblk_cache_entry_t* key,
+        const opj_tcd_cblk_dec_t* cblk)
+{
+    return entry->len == key->len && entry->hash == key->hash &&
+           entry->numpasses == key->numpasses && entry->numbps == key->numbps &&
+           entry->roishift == key->roishift && entry->cblksty == key->cblksty &&
+           entry->w == key->w && entry->h == key->h &&
+           opj_t1_cblk_same_bytes(cblk, entry->bytes, entry->len);
+}
+
+static void opj_t1_cblk_cache_lru_unlink(opj_t1_cblk_cache_t* cache,
+        opj_t1_cblk_cache_entry_t* entry)
+{
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void opj_t1_cblk_cache_lru_push_front(opj_t1_cblk_cache_t* cache,
+        opj_t1_cblk_cache_entry_t* entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) {
+        cache->lru_head->lru_prev = entry;
+    } else {
+        cache->lru_tail = entry;
+    }
+    cache->lru_head = entry;
+}
+
+/** Unlinks an entry from the cache and frees it */
+static void opj_t1_cblk_cache_remove(opj_t1_cblk_cache_t* cache,
+                                     opj_t1_cblk_cache_entry_t* entry)
+{
+    opj_t1_cblk_cache_entry_t** link =
+        &cache->buckets[opj_t1_cblk_cache_bucket(cache, entry)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    opj_t1_cblk_cache_lru_unlink(cache, entry);
+    cache->size -= entry->size;
+    cache->nb_entries --;
+    opj_free(entry);
+}
+
+/** Evicts the least recently used entries until size + extra_size fits the budget */
+static void opj_t1_cblk_cache_evict(opj_t1_cblk_cache_t* cache,
+                                    OPJ_SIZE_T extra_size)
+{
+    while (cache->lru_tail && cache->size + extra_size > cache->max_size) {
+        opj_t1_cblk_cache_remove(cache, cache->lru_tail);
+    }
+}
+
+/** Doubles the number of hash buckets. Failure is not fatal */
+static void opj_t1_cblk_cache_grow(opj_t1_cblk_cache_t* cache)
+{
+    OPJ_UINT32 l_old_nb_buckets = cache->nb_buckets;
+    opj_t1_cblk_cache_entry_t** l_old_buckets = cache->buckets;
+    opj_t1_cblk_cache_entry_t** l_buckets;
+    OPJ_UINT32 i;
+
+    if (l_old_nb_buckets > (OPJ_UINT32)INT_MAX / 2) {
+        return;
+    }
+    l_buckets = (opj_t1_cblk_cache_entry_t**) opj_calloc(2U * l_old_nb_buckets,
+                sizeof(opj_t1_cblk_cache_entry_t*));
+    if (!l_buckets) {
+        return;
+    }
+    cache->buckets = l_buckets;
+    cache->nb_buckets = 2U * l_old_nb_buckets;
+    for (i = 0; i < l_old_nb_buckets; ++i) {
+        opj_t1_cblk_cache_entry_t* entry = l_old_buckets[i];
+        while (entry) {
+            opj_t1_cblk_cache_entry_t* next = entry->hash_next;
+            OPJ_UINT32 bucket = opj_t1_cblk_cache_bucket(cache, entry);
+            entry->hash_next = l_buckets[bucket];
+            l_buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    opj_free(l_old_buckets);
+}
+
+opj_t1_cblk_cache_t* opj_t1_cblk_cache_create(OPJ_SIZE_T max_size)
+{
+    opj_t1_cblk_cache_t* cache = (opj_t1_cblk_cache_t*) opj_calloc(1,
+                                 sizeof(opj_t1_cblk_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+    cache->max_size = max_size;
+    cache->nb_buckets = 256;
+    cache->buckets = (opj_t1_cblk_cache_entry_t**) opj_calloc(cache->nb_buckets,
+                     sizeof(opj_t1_cblk_cache_entry_t*));
+    if (!cache->buckets) {
+        opj_free(cache);
+        return NULL;
+    }
+    if (opj_has_thread_support()) {
+        cache->mutex = opj_mutex_create();
+        if (!cache->mutex) {
+            opj_free(cache->buckets);
+            opj_free(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+void opj_t1_cblk_cache_set_max_size(opj_t1_cblk_cache_t* cache,
+                                    OPJ_SIZE_T max_size)
+{
+    cache->max_size = max_size;
+    opj_t1_cblk_cache_evict(cache, 0);
+}
+
+void opj_t1_cblk_cache_destroy(opj_t1_cblk_cache_t* cache)
+{
+    if (!cache) {
+        return;
+    }
+    while (cache->lru_head) {
+        opj_t1_cblk_cache_entry_t* next = cache->lru_head->lru_next;
+        opj_free(cache->lru_head);
+        cache->lru_head = next;
+    }
+    opj_free(cache->buckets);
+    if (cache->mutex) {
+        opj_mutex_destroy(cache->mutex);
+    }
+    opj_free(cache);
+}
+
+/** Fills the position and fingerprint of a code-block, which is the key of */
+/** its cache entry. Its number of passes is the number actually decoded, */
+/** given max_passes. Returns OPJ_FALSE if the code-block has no data, in */
+/** which case decoding it is cheaper than caching it. */
+static OPJ_BOOL opj_t1_cblk_cache_make_key(opj_t1_cblk_cache_entry_t* key,
+        OPJ_UINT32 tileno,
+        OPJ_UINT32 resno,
+        const opj_tcd_cblk_dec_t* cblk,
+        const opj_tcd_band_t* band,
+        const opj_tcd_tilecomp_t* tilec,
+        const opj_tccp_t* tccp,
+        OPJ_UINT32 max_passes)
+{
+    OPJ_UINT32 i, j;
+    /* FNV-1a */
+    OPJ_UINT32 hash = 2166136261U;
+    OPJ_UINT32 len = 0;
+    OPJ_UINT32 numpasses = 0;
+
+    for (i = 0; i < cblk->numchunks; ++i) {
+        const OPJ_BYTE* data = cblk->chunks[i].data;
+        for (j = 0; j < cblk->chunks[i].len; ++j) {
+            hash = (hash ^ data[j]) * 16777619U;
+        }
+        len += cblk->chunks[i].len;
+    }
+    if (len == 0) {
+        return OPJ_FALSE;
+    }
+    for (i = 0; i < cblk->real_num_segs; ++i) {
+        numpasses += cblk->segs[i].real_num_passes;
+    }
+    if (max_passes != 0 && numpasses > max_passes) {
+        numpasses = max_passes;
+    }
+
+    memset(key, 0, sizeof(*key));
+    key->tileno = tileno;
+    key->compno = tilec->compno;
+    key->resno = resno;
+    key->bandno = band->bandno;
+    key->x0 = cblk->x0;
+    key->y0 = cblk->y0;
+    key->len = len;
+    key->hash = hash;
+    key->numpasses = numpasses;
+    key->numbps = cblk->numbps;
+    key->roishift = (OPJ_UINT32)tccp->roishift;
+    key->cblksty = tccp->cblksty;
+    key->w = (OPJ_UINT32)(cblk->x1 - cblk->x0);
+    key->h = (OPJ_UINT32)(cblk->y1 - cblk->y0);
+    return OPJ_TRUE;
+}
+
+/** Number of flags of a code-block, see opj_t1_allocate_buffers() */
+static OPJ_UINT32 opj_t1_flags_count(OPJ_UINT32 w, OPJ_UINT32 h)
+{
+    return ((h + 3U) / 4U + 2U) * (w + 2U);
+}
+
+/** Computes the hash of the first prefix_len bytes of the data of a */
+/** code-block, of the lengths and passes of its first segno segments and */
+/** of passno. Returns OPJ_FALSE if the code-block has less data */
+static OPJ_BOOL opj_t1_cblk_prefix_hash(const opj_tcd_cblk_dec_t* cblk,
+                                        OPJ_UINT32 segno,
+                                        OPJ_UINT32 passno,
+                                        OPJ_UINT32 prefix_len,
+                                        OPJ_UINT32* p_hash)
+{
+    /* FNV-1a */
+    OPJ_UINT32 hash = 2166136261U;
+    OPJ_UINT32 remaining = prefix_len;
+    OPJ_UINT32 i, j;
+
+    if (segno > cblk->real_num_segs) {
+        return OPJ_FALSE;
+    }
+    for (i = 0; i < cblk->numchunks && remaining > 0; ++i) {
+        const OPJ_BYTE* data = cblk->chunks[i].data;
+        OPJ_UINT32 len = opj_uint_min(cblk->chunks[i].len, remaining);
+        for (j = 0; j < len; ++j) {
+            hash = (hash ^ data[j]) * 16777619U;
+        }
+        remaining -= len;
+    }
+    if (remaining > 0) {
+        return OPJ_FALSE;
+    }
+    for (i = 0; i < segno; ++i) {
+        hash = (hash ^ cblk->segs[i].len) * 16777619U;
+        hash = (hash ^ cblk->segs[i].real_num_passes) * 16777619U;
+    }
+    *p_hash = (hash ^ passno) * 16777619U;
+    return OPJ_TRUE;
+}
+
+/** Copies a resume state of a w x h code-block, keeping the buffers of dst */
+static OPJ_BOOL opj_t1_copy_resume_state(opj_t1_resume_state_t* dst,
+        const opj_t1_resume_state_t* src,
+        OPJ_UINT32 w,
+        OPJ_UINT32 h)
+{
+    OPJ_INT32* data = dst->data;
+    opj_flag_t* flags = dst->flags;
+    OPJ_UINT32 datasize = dst->datasize;
+    OPJ_UINT32 flagssize = dst->flagssize;
+
+    if (w * h > datasize) {
+        data = (OPJ_INT32*) opj_realloc(dst->data, w * h * sizeof(OPJ_INT32));
+        if (!data) {
+            return OPJ_FALSE;
+        }
+        dst->data = data;
+        dst->datasize = datasize = w * h;
+    }
+    if (opj_t1_flags_count(w, h) > flagssize) {
+        flags = (opj_flag_t*) opj_realloc(dst->flags,
+                                          opj_t1_flags_count(w, h) * sizeof(opj_flag_t));
+        if (!flags) {
+            return OPJ_FALSE;
+        }
+        dst->flags = flags;
+        dst->flagssize = flagssize = opj_t1_flags_count(w, h);
+    }
+    memcpy(data, src->data, w * h * sizeof(OPJ_INT32));
+    memcpy(flags, src->flags, opj_t1_flags_count(w, h) * sizeof(opj_flag_t));
+    *dst = *src;
+    dst->data = data;
+    dst->flags = flags;
+    dst->datasize = datasize;
+    dst->flagssize = flagssize;
+    return OPJ_TRUE;
+}
+
+/** Whether the state of an entry can be used to resume decoding a new */
+/** version of its code-block, that has more coding passes. The hash of the */
+/** data the state depends on is compared first, to reject most entries */
+/** cheaply, then the data itself */
+static OPJ_BOOL opj_t1_cblk_cache_can_resume(const opj_t1_cblk_cache_entry_t*
+        entry, const opj_t1_cblk_cache_entry_t* key,
+        const opj_tcd_cblk_dec_t* cblk)
+{
+    const opj_t1_resume_state_t* resume = &entry->resume;
+    OPJ_UINT32 hash, i;
+
+    if (!resume->valid || resume->numpasses > key->numpasses ||
+            entry->numbps != key->numbps ||
+            entry->roishift != key->roishift || entry->cblksty != key->cblksty ||
+            entry->w != key->w || entry->h != key->h) {
+        return OPJ_FALSE;
+    }
+    if (resume->has_mqc) {
+        if (resume->segno >= cblk->real_num_segs ||
+                cblk->segs[resume->segno].real_num_passes < resume->passno ||
+                cblk->segs[resume->segno].len <= resume->bp_offset) {
+            return OPJ_FALSE;
+        }
+    }
+    if (!opj_t1_cblk_prefix_hash(cblk, resume->segno, resume->passno,
+                                 resume->prefix_len, &hash) ||
+            hash != resume->prefix_hash ||
+            resume->prefix_len > entry->len ||
+            !opj_t1_cblk_same_bytes(cblk, entry->bytes, resume->prefix_len)) {
+        return OPJ_FALSE;
+    }
+    for (i = 0; i < resume->segno; ++i) {
+        if (cblk->segs[i].len != entry->resume_segs[2 * i] ||
+                cblk->segs[i].real_num_passes != entry->resume_segs[2 * i + 1]) {
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
+/** Result of opj_t1_cblk_cache_lookup() */
+typedef enum {
+    OPJ_T1_CACHE_MISS,
+    OPJ_T1_CACHE_HIT,
+    OPJ_T1_CACHE_RESUME
+} OPJ_T1_CACHE_LOOKUP;
+
+/** Copies the coefficients of the code-block described by key to data if */
+/** they are in the cache. Otherwise, if resume is not NULL, copies to it a */
+/** state from which the decoding of the code-block can resume */
+static OPJ_T1_CACHE_LOOKUP opj_t1_cblk_cache_lookup(opj_t1_cblk_cache_t*
+        cache,
+        const opj_t1_cblk_cache_entry_t* key,
+        const opj_tcd_cblk_dec_t* cblk,
+        OPJ_INT32* data,
+        opj_t1_resume_state_t* resume)
+{
+    opj_t1_cblk_cache_entry_t* entry;
+    OPJ_T1_CACHE_LOOKUP ret = OPJ_T1_CACHE_MISS;
+
+    if (cache->mutex) {
+        opj_mutex_lock(cache->mutex);
+    }
+    for (entry = cache->buckets[opj_t1_cblk_cache_bucket(cache, key)];
+            entry != NULL; entry = entry->hash_next) {
+        if (opj_t1_cblk_cache_same_position(entry, key)) {
+            if (opj_t1_cblk_cache_same_data(entry, key, cblk)) {
+                memcpy(data, entry->data,
+                       (OPJ_SIZE_T)entry->w * entry->h * sizeof(OPJ_INT32));
+                ret = OPJ_T1_CACHE_HIT;
+            } else if (resume != NULL &&
+                       opj_t1_cblk_cache_can_resume(entry, key, cblk) &&
+                       opj_t1_copy_resume_state(resume, &entry->resume, entry->w,
+                                                entry->h)) {
+                ret = OPJ_T1_CACHE_RESUME;
+            }
+            if (ret != OPJ_T1_CACHE_MISS) {
+                opj_t1_cblk_cache_lru_unlink(cache, entry);
+                opj_t1_cblk_cache_lru_push_front(cache, entry);
+            }
+            break;
+        }
+    }
+    if (cache->mutex) {
+        opj_mutex_unlock(cache->mutex);
+    }
+    return ret;
+}
+
+/** Stores the coefficients of the code-block cblk described by key, and */
+/** the state to resume its decoding from if resume is not NULL, replacing */
+/** the entry of a previous version of the code-block. Failure is not fatal */
+static void opj_t1_cblk_cache_insert(opj_t1_cblk_cache_t* cache,
+                                     const opj_t1_cblk_cache_entry_t* key,
+                                     const opj_tcd_cblk_dec_t* cblk,
+                                     const OPJ_INT32* data,
+                                     const opj_t1_resume_state_t* resume)
+{
+    opj_t1_cblk_cache_entry_t* entry;
+    opj_t1_cblk_cache_entry_t* existing;
+    OPJ_SIZE_T data_size = (OPJ_SIZE_T)key->w * key->h * sizeof(OPJ_INT32);
+    OPJ_SIZE_T flags_size = (OPJ_SIZE_T)opj_t1_flags_count(key->w,
+                            key->h) * sizeof(opj_flag_t);
+    OPJ_SIZE_T size = sizeof(opj_t1_cblk_cache_entry_t) + data_size + key->len;
+    OPJ_BYTE* bytes;
+    OPJ_UINT32 bucket, i;
+
+    if (resume) {
+        size += data_size + flags_size +
+                2U * resume->segno * sizeof(OPJ_UINT32);
+    }
+    if (size > cache->max_size) {
+        return;
+    }
+    entry = (opj_t1_cblk_cache_entry_t*) opj_malloc(size);
+    if (!entry) {
+        return;
+    }
+    *entry = *key;
+    entry->size = size;
+    entry->data = (OPJ_INT32*)(entry + 1);
+    memcpy(entry->data, data, data_size);
+    if (resume) {
+        entry->resume = *resume;
+        entry->resume.data = entry->data + (OPJ_SIZE_T)key->w * key->h;
+        entry->resume.flags = (opj_flag_t*)(entry->resume.data +
+                                            (OPJ_SIZE_T)key->w * key->h);
+        memcpy(entry->resume.data, resume->data, data_size);
+        memcpy(entry->resume.flags, resume->flags, flags_size);
+        entry->resume_segs = (OPJ_UINT32*)(entry->resume.flags +
+                                           opj_t1_flags_count(key->w, key->h));
+        for (i = 0; i < resume->segno; ++i) {
+            entry->resume_segs[2 * i] = cblk->segs[i].len;
+            entry->resume_segs[2 * i + 1] = cblk->segs[i].real_num_passes;
+        }
+        entry->bytes = (OPJ_BYTE*)(entry->resume_segs + 2U * resume->segno);
+    } else {
+        entry->bytes = (OPJ_BYTE*)(entry->data + (OPJ_SIZE_T)key->w * key->h);
+    }
+    bytes = entry->bytes;
+    for (i = 0; i < cblk->numchunks; ++i) {
+        memcpy(bytes, cblk->chunks[i].data, cblk->chunks[i].len);
+        bytes += cblk->chunks[i].len;
+    }
+
+    if (cache->mutex) {
+        opj_mutex_lock(cache->mutex);
+    }
+    bucket = opj_t1_cblk_cache_bucket(cache, key);
+    for (existing = cache->buckets[bucket]; existing != NULL;
+            existing = existing->hash_next) {
+        if (opj_t1_cblk_cache_same_position(existing, key)) {
+            opj_t1_cblk_cache_remove(cache, existing);
+            break;
+        }
+    }
+    opj_t1_cblk_cache_evict(cache, size);
+    if (cache->nb_entries >= cache->nb_buckets) {
+        opj_t1_cblk_cache_grow(cache);
+    }
+    bucket = opj_t1_cblk_cache_bucket(cache, entry);
+    entry->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    opj_t1_cblk_cache_lru_push_front(cache, entry);
+    cache->size += size;
+    cache->nb_entries ++;
+    if (cache->mutex) {
+        opj_mutex_unlock(cache->mutex);
+    }
+}
+
+/** Code-block of a Tier-1 decoding job */
+typedef struct {
+    opj_tcd_cblk_dec_t* cblk;
+    opj_tcd_band_t* band;
+    OPJ_UINT32 resno;
+} opj_t1_cblk_decode_ref_t;
+
+/** Tier-1 decoding job: code-blocks of a tile component, decoded in sequence
+ * by the same thread, so that small code-blocks do not each cost a job */
 typedef struct {
     OPJ_BOOL whole_tile_decoding;
+    /* Code-block being decoded */
     OPJ_UINT32 resno;
     opj_tcd_cblk_dec_t* cblk;
     opj_tcd_band_t* band;
+    /* Code-blocks of the job: cblks[0..nb_cblks-1] once the job is */
+    /* submitted, from first_cblk in opj_t1_decode_jobs_t::cblks before */
+    const opj_t1_cblk_decode_ref_t* cblks;
+    OPJ_UINT32 first_cblk;
+    OPJ_UINT32 nb_cblks;
+    /* Number of samples of the code-blocks of the job */
+    OPJ_UINT32 nb_samples;
     opj_tcd_tilecomp_t* tilec;
     opj_tccp_t* tccp;
     OPJ_BOOL mustuse_cblkdatabuffer;
@@ -1577,14 +2155,73 @@ typedef struct {
     opj_event_mgr_t *p_manager;
     opj_mutex_t* p_manager_mutex;
     OPJ_BOOL check_pterm;
+    OPJ_UINT32 tileno;
+    opj_t1_cblk_cache_t* cblk_cache;
+    OPJ_BOOL keep_t1_state;
+    OPJ_UINT32 max_passes;
+    opj_interrupt_t* interrupt;
 } opj_t1_cblk_decode_processing_job_t;
 
+/** Tier-1 decoding jobs of a tile, collected by opj_t1_decode_cblks() and
+ * run by opj_t1_run_decode_jobs(). The arrays are kept from tile to tile,
+ * instead of allocating a job descriptor per code-block */
+struct opj_t1_decode_jobs {
+    opj_t1_cblk_decode_processing_job_t* jobs;
+    OPJ_UINT32 nb_jobs;
+    OPJ_UINT32 max_jobs;
+    opj_t1_cblk_decode_ref_t* cblks;
+    OPJ_UINT32 nb_cblks;
+    OPJ_UINT32 max_cblks;
+    /* Number of samples of all the code-blocks */
+    OPJ_UINT64 nb_samples;
+};
+
 static void opj_t1_destroy_wrapper(void* t1)
 {
     opj_t1_destroy((opj_t1_t*) t1);
 }
 
-static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
+/** Sets to zero the samples of the tile component where the code-block of
+ * a skipped whole tile decoding job would have been written.
+ *
+ * @param job the decoding job
+ */
+static void opj_t1_clear_cblk_in_tile(const opj_t1_cblk_decode_processing_job_t*
+                                      job)
+{
+    const opj_tcd_cblk_dec_t* cblk = job->cblk;
+    const opj_tcd_band_t* band = job->band;
+    const opj_tcd_tilecomp_t* tilec = job->tilec;
+    const OPJ_UINT32 tile_w = (OPJ_UINT32)(
+                                  tilec->resolutions[tilec->minimum_num_resolutions - 1].x1 -
+                                  tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
+    const OPJ_UINT32 cblk_w = (OPJ_UINT32)(cblk->x1 - cblk->x0);
+    const OPJ_UINT32 cblk_h = (OPJ_UINT32)(cblk->y1 - cblk->y0);
+    OPJ_INT32 x = cblk->x0 - band->x0;
+    OPJ_INT32 y = cblk->y0 - band->y0;
+    OPJ_UINT32 j;
+
+    if (band->bandno & 1) {
+        opj_tcd_resolution_t* pres = &tilec->resolutions[job->resno - 1];
+        x += pres->x1 - pres->x0;
+    }
+    if (band->bandno & 2) {
+        opj_tcd_resolution_t* pres = &tilec->resolutions[job->resno - 1];
+        y += pres->y1 - pres->y0;
+    }
+    for (j = 0; j < cblk_h; ++j) {
+        memset(&tilec->data[((OPJ_SIZE_T)y + j) * tile_w + (OPJ_SIZE_T)x], 0,
+               cblk_w * sizeof(OPJ_INT32));
+    }
+}
+
+/** Decodes the code-block job->cblk of a decoding job.
+ *
+ * @param job the decoding job
+ * @param tls TLS handle
+ */
+static void opj_t1_clbl_decode_cblk(opj_t1_cblk_decode_processing_job_t* job,
+                                    opj_tls_t* tls)
 {
     opj_tcd_cblk_dec_t* cblk;
     opj_tcd_band_t* band;
@@ -1594,15 +2231,26 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
     OPJ_UINT32 cblk_w, cblk_h;
     OPJ_INT32 x, y;
     OPJ_UINT32 i, j;
-    opj_t1_cblk_decode_processing_job_t* job;
     opj_t1_t* t1;
     OPJ_UINT32 resno;
     OPJ_UINT32 tile_w;
-
-    job = (opj_t1_cblk_decode_processing_job_t*) user_data;
+    opj_t1_cblk_cache_entry_t cache_key;
+    OPJ_BOOL use_cache;
+    OPJ_T1_CACHE_LOOKUP lookup = OPJ_T1_CACHE_MISS;
+    OPJ_BOOL cached;
 
     cblk = job->cblk;
 
+    if (opj_tcd_is_interrupted(job->interrupt)) {
+        /* Cancelled or past the deadline: the code-block is left to zero. */
+        /* In partial decoding, it is decoded by the next call if needed */
+        if (job->whole_tile_decoding && *(job->pret)) {
+            opj_t1_clear_cblk_in_tile(job);
+        }
+        job->interrupt->cblks_skipped = OPJ_TRUE;
+        return;
+    }
+
     if (!job->whole_tile_decoding) {
         cblk_w = (OPJ_UINT32)(cblk->x1 - cblk->x0);
         cblk_h = (OPJ_UINT32)(cblk->y1 - cblk->y0);
@@ -1619,7 +2267,6 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
                 opj_mutex_unlock(job->p_manager_mutex);
             }
             *(job->pret) = OPJ_FALSE;
-            opj_free(job);
             return;
         }
         /* Zero-init required */
@@ -1640,7 +2287,6 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
                           tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
 
     if (!*(job->pret)) {
-        opj_free(job);
         return;
     }
 
@@ -1651,7 +2297,6 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
             opj_event_msg(job->p_manager, EVT_ERROR,
                           "Cannot allocate Tier 1 handle\n");
             *(job->pret) = OPJ_FALSE;
-            opj_free(job);
             return;
         }
         if (!opj_tls_set(tls, OPJ_TLS_KEY_T1, t1, opj_t1_destroy_wrapper)) {
@@ -1659,13 +2304,27 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
                           "Unable to set t1 handle as TLS\n");
             opj_t1_destroy(t1);
             *(job->pret) = OPJ_FALSE;
-            opj_free(job);
             return;
         }
     }
     t1->mustuse_cblkdatabuffer = job->mustuse_cblkdatabuffer;
 
-    if (OPJ_FALSE == opj_t1_decode_cblk(
+    use_cache = job->cblk_cache != NULL &&
+                opj_t1_cblk_cache_make_key(&cache_key, job->tileno, resno, cblk,
+                                           band, tilec, tccp, job->max_passes);
+    if (use_cache) {
+        if (!cblk->decoded_data &&
+                !opj_t1_allocate_buffers(t1, cache_key.w, cache_key.h)) {
+            *(job->pret) = OPJ_FALSE;
+            return;
+        }
+        lookup = opj_t1_cblk_cache_lookup(job->cblk_cache, &cache_key, cblk,
+                                          cblk->decoded_data ? cblk->decoded_data : t1->data,
+                                          job->keep_t1_state ? &t1->resume : NULL);
+    }
+    cached = (lookup == OPJ_T1_CACHE_HIT);
+
+    if (!cached && OPJ_FALSE == opj_t1_decode_cblk(
                 t1,
                 cblk,
                 band->bandno,
@@ -1673,9 +2332,11 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
                 tccp->cblksty,
                 job->p_manager,
                 job->p_manager_mutex,
-                job->check_pterm)) {
+                job->check_pterm,
+                lookup == OPJ_T1_CACHE_RESUME,
+                use_cache && job->keep_t1_state,
+                job->max_passes)) {
         *(job->pret) = OPJ_FALSE;
-        opj_free(job);
         return;
     }
 
@@ -1691,10 +2352,15 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
     }
 
     datap = cblk->decoded_data ? cblk->decoded_data : t1->data;
-    cblk_w = t1->w;
-    cblk_h = t1->h;
+    if (cached) {
+        cblk_w = cache_key.w;
+        cblk_h = cache_key.h;
+    } else {
+        cblk_w = t1->w;
+        cblk_h = t1->h;
+    }
 
-    if (tccp->roishift) {
+    if (tccp->roishift && !cached) {
         if (tccp->roishift >= 31) {
             for (j = 0; j < cblk_h; ++j) {
                 for (i = 0; i < cblk_w; ++i) {
@@ -1716,6 +2382,11 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
         }
     }
 
+    if (use_cache && !cached) {
+        opj_t1_cblk_cache_insert(job->cblk_cache, &cache_key, cblk, datap,
+                                 (job->keep_t1_state && t1->resume.valid) ? &t1->resume : NULL);
+    }
+
     /* Both can be non NULL if for example decoding a full tile and then */
     /* partially a tile. In which case partial decoding should be the */
     /* priority */
@@ -1791,10 +2462,131 @@ static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
             tiledp += tile_w;
         }
     }
+}
 
-    opj_free(job);
+
+static void opj_t1_clbl_decode_processor(void* user_data, opj_tls_t* tls)
+{
+    opj_t1_cblk_decode_processing_job_t* job =
+        (opj_t1_cblk_decode_processing_job_t*) user_data;
+    OPJ_UINT32 i;
+
+    for (i = 0; i < job->nb_cblks; ++i) {
+        job->cblk = job->cblks[i].cblk;
+        job->band = job->cblks[i].band;
+        job->resno = job->cblks[i].resno;
+        opj_t1_clbl_decode_cblk(job, tls);
+    }
 }
 
+/** Adds a code-block to decode to the last job of the tile, or to a new job
+ * if the last one is for another tile component or has enough samples.
+ *
+ * @param tcd   TCD handle
+ * @param model job with the parameters of the tile component
+ * @param cblk  code-block to decode
+ * @param band  band of the code-block
+ * @param resno resolution of the code-block
+ * @return OPJ_FALSE if the job descriptors cannot be allocated.
+ */
+static OPJ_BOOL opj_t1_add_decode_job(opj_tcd_t* tcd,
+                                      const opj_t1_cblk_decode_processing_job_t* model,
+                                      opj_tcd_cblk_dec_t* cblk,
+                                      opj_tcd_band_t* band,
+                                      OPJ_UINT32 resno)
+{
+    opj_t1_decode_jobs_t* jobs = tcd->t1_decode_jobs;
+    opj_t1_cblk_decode_processing_job_t* job;
+    opj_t1_cblk_decode_ref_t* ref;
+    OPJ_UINT32 nb_samples = (OPJ_UINT32)(cblk->x1 - cblk->x0) *
+                            (OPJ_UINT32)(cblk->y1 - cblk->y0);
+
+    if (jobs == NULL) {
+        jobs = (opj_t1_decode_jobs_t*) opj_calloc(1, sizeof(opj_t1_decode_jobs_t));
+        if (!jobs) {
+            return OPJ_FALSE;
+        }
+        tcd->t1_decode_jobs = jobs;
+    }
+
+    job = jobs->nb_jobs ? &jobs->jobs[jobs->nb_jobs - 1] : NULL;
+    if (job == NULL || job->tilec != model->tilec ||
+            job->nb_samples >= OPJ_T1_MIN_SAMPLES_PER_JOB) {
+        if (jobs->nb_jobs == jobs->max_jobs) {
+            OPJ_UINT32 new_max = jobs->max_jobs ? 2 * jobs->max_jobs : 16;
+            opj_t1_cblk_decode_processing_job_t* new_jobs =
+                (opj_t1_cblk_decode_processing_job_t*) opj_realloc(jobs->jobs,
+                        new_max * sizeof(opj_t1_cblk_decode_processing_job_t));
+            if (!new_jobs) {
+                return OPJ_FALSE;
+            }
+            jobs->jobs = new_jobs;
+            jobs->max_jobs = new_max;
+        }
+        job = &jobs->jobs[jobs->nb_jobs ++];
+        *job = *model;
+        job->first_cblk = jobs->nb_cblks;
+    }
+
+    if (jobs->nb_cblks == jobs->max_cblks) {
+        OPJ_UINT32 new_max = jobs->max_cblks ? 2 * jobs->max_cblks : 64;
+        opj_t1_cblk_decode_ref_t* new_cblks = (opj_t1_cblk_decode_ref_t*)
+                                              opj_realloc(jobs->cblks, new_max * sizeof(opj_t1_cblk_decode_ref_t));
+        if (!new_cblks) {
+            return OPJ_FALSE;
+        }
+        jobs->cblks = new_cblks;
+        jobs->max_cblks = new_max;
+    }
+    ref = &jobs->cblks[jobs->nb_cblks ++];
+    ref->cblk = cblk;
+    ref->band = band;
+    ref->resno = resno;
+    job->nb_cblks ++;
+    job->nb_samples += nb_samples;
+    jobs->nb_samples += nb_samples;
+    return OPJ_TRUE;
+}
+
+void opj_t1_run_decode_jobs(opj_tcd_t* tcd)
+{
+    opj_t1_decode_jobs_t* jobs = tcd->t1_decode_jobs;
+    opj_thread_pool_t* tp = tcd->thread_pool;
+    OPJ_BOOL inline_run;
+    OPJ_UINT32 i;
+
+    if (jobs == NULL || jobs->nb_jobs == 0) {
+        return;
+    }
+
+    /* A stage with too little work is faster in the calling thread than */
+    /* handed off to the thread pool */
+    inline_run = jobs->nb_jobs == 1 ||
+                 jobs->nb_samples < 2 * OPJ_T1_MIN_SAMPLES_PER_JOB;
+    for (i = 0; i < jobs->nb_jobs; ++i) {
+        opj_t1_cblk_decode_processing_job_t* job = &jobs->jobs[i];
+        job->cblks = jobs->cblks + job->first_cblk;
+        if (inline_run) {
+            opj_thread_pool_run_job(tp, opj_t1_clbl_decode_processor, job);
+        } else {
+            opj_thread_pool_submit_job(tp, opj_t1_clbl_decode_processor, job);
+        }
+    }
+    opj_thread_pool_wait_completion(tp, 0);
+
+    jobs->nb_jobs = 0;
+    jobs->nb_cblks = 0;
+    jobs->nb_samples = 0;
+}
+
+void opj_t1_destroy_decode_jobs(opj_t1_decode_jobs_t* jobs)
+{
+    if (jobs) {
+        opj_free(jobs->jobs);
+        opj_free(jobs->cblks);
+        opj_free(jobs);
+    }
+}
 
 void opj_t1_decode_cblks(opj_tcd_t* tcd,
                          volatile OPJ_BOOL* pret,
@@ -1807,12 +2599,28 @@ void opj_t1_decode_cblks(opj_tcd_t* tcd,
 {
     opj_thread_pool_t* tp = tcd->thread_pool;
     OPJ_UINT32 resno, bandno, precno, cblkno;
+    opj_t1_cblk_decode_processing_job_t model;
 
 #ifdef DEBUG_VERBOSE
     OPJ_UINT32 codeblocks_decoded = 0;
     printf("Enter opj_t1_decode_cblks()\n");
 #endif
 
+    memset(&model, 0, sizeof(model));
+    model.whole_tile_decoding = tcd->whole_tile_decoding;
+    model.tilec = tilec;
+    model.tccp = tccp;
+    model.pret = pret;
+    model.p_manager_mutex = p_manager_mutex;
+    model.p_manager = p_manager;
+    model.check_pterm = check_pterm;
+    model.tileno = tcd->tcd_tileno;
+    model.cblk_cache = tcd->cblk_cache;
+    model.keep_t1_state = tcd->keep_t1_state;
+    model.max_passes = tcd->max_cblk_passes;
+    model.interrupt = tcd->interrupt;
+    model.mustuse_cblkdatabuffer = opj_thread_pool_get_thread_count(tp) > 1;
+
     for (resno = 0; resno < tilec->minimum_num_resolutions; ++resno) {
         opj_tcd_resolution_t* res = &tilec->resolutions[resno];
 
@@ -1846,7 +2654,6 @@ void opj_t1_decode_cblks(opj_tcd_t* tcd,
 
                 for (cblkno = 0; cblkno < precinct->cw * precinct->ch; ++cblkno) {
                     opj_tcd_cblk_dec_t* cblk = &precinct->cblks.dec[cblkno];
-                    opj_t1_cblk_decode_processing_job_t* job;
 
                     if (!opj_tcd_is_subband_area_of_interest(tcd,
                             tilec->compno,
@@ -1886,30 +2693,13 @@ void opj_t1_decode_cblks(opj_tcd_t* tcd,
 #endif
                     }
 
-                    job = (opj_t1_cblk_decode_processing_job_t*) opj_calloc(1,
-                            sizeof(opj_t1_cblk_decode_processing_job_t));
-                    if (!job) {
+                    if (!opj_t1_add_decode_job(tcd, &model, cblk, band, resno)) {
                         *pret = OPJ_FALSE;
                         return;
                     }
-                    job->whole_tile_decoding = tcd->whole_tile_decoding;
-                    job->resno = resno;
-                    job->cblk = cblk;
-                    job->band = band;
-                    job->tilec = tilec;
-                    job->tccp = tccp;
-                    job->pret = pret;
-                    job->p_manager_mutex = p_manager_mutex;
-                    job->p_manager = p_manager;
-                    job->check_pterm = check_pterm;
-                    job->mustuse_cblkdatabuffer = opj_thread_pool_get_thread_count(tp) > 1;
-                    opj_thread_pool_submit_job(tp, opj_t1_clbl_decode_processor, job);
 #ifdef DEBUG_VERBOSE
                     codeblocks_decoded ++;
 #endif
-                    if (!(*pret)) {
-                        return;
-                    }
                 } /* cblkno */
             } /* precno */
         } /* bandno */
@@ -1922,6 +2712,98 @@ void opj_t1_decode_cblks(opj_tcd_t* tcd,
 }
 
 
+/**
+Saves in t1->resume the state of the decoder of a code-block, so that a
+later decoding of the same code-block with more passes can start from it.
+The state is only saved when it does not depend on data that may still
+change, that is either:
+- at the end of a terminated segment (all its passes are decoded), or
+- inside an MQ coded segment, while the MQ decoder has not read beyond
+  the data of the segment: its state would then be the same if the segment
+  had more passes.
+Otherwise, or if memory is missing, t1->resume is left unchanged.
+@param t1 T1 handle, after decoding the pass
+@param cblk Code-block being decoded
+@param segno Index of the segment of the pass
+@param passno Number of passes of segment segno decoded
+@param numpasses Number of passes of the code-block decoded
+@param seg_start Offset of the data of segment segno in the code-block data
+@param type Coding of segment segno (T1_TYPE_MQ or T1_TYPE_RAW)
+@param bpno_plus_one Bit-plane of the next pass, plus one
+@param passtype Type of the next pass (0: significance propagation,
+                1: magnitude refinement, 2: cleanup)
+*/
+static void opj_t1_save_resume_state(opj_t1_t *t1,
+                                     const opj_tcd_cblk_dec_t* cblk,
+                                     OPJ_UINT32 segno,
+                                     OPJ_UINT32 passno,
+                                     OPJ_UINT32 numpasses,
+                                     OPJ_UINT32 seg_start,
+                                     OPJ_BYTE type,
+                                     OPJ_INT32 bpno_plus_one,
+                                     OPJ_UINT32 passtype)
+{
+    const opj_mqc_t *mqc = &(t1->mqc);
+    const opj_tcd_seg_t *seg = &cblk->segs[segno];
+    opj_t1_resume_state_t* resume = &t1->resume;
+    OPJ_UINT32 datasize = t1->w * t1->h;
+    OPJ_UINT32 prefix_len;
+    OPJ_UINT32 prefix_hash;
+
+    if (passno == seg->real_num_passes && passno == seg->maxpasses) {
+        segno ++;
+        passno = 0;
+        prefix_len = seg_start + seg->len;
+    } else if (type == T1_TYPE_MQ && mqc->end_of_byte_stream_counter == 0 &&
+               mqc->bp < mqc->end) {
+        prefix_len = seg_start + (OPJ_UINT32)(mqc->bp - mqc->start) + 1U;
+    } else {
+        return;
+    }
+    if (!opj_t1_cblk_prefix_hash(cblk, segno, passno, prefix_len, &prefix_hash)) {
+        return;
+    }
+
+    if (datasize > resume->datasize) {
+        OPJ_INT32* data = (OPJ_INT32*) opj_realloc(resume->data,
+                          datasize * sizeof(OPJ_INT32));
+        if (!data) {
+            return;
+        }
+        resume->data = data;
+        resume->datasize = datasize;
+    }
+    if (t1->flagssize > resume->flagssize) {
+        opj_flag_t* flags = (opj_flag_t*) opj_realloc(resume->flags,
+                            t1->flagssize * sizeof(opj_flag_t));
+        if (!flags) {
+            return;
+        }
+        resume->flags = flags;
+        resume->flagssize = t1->flagssize;
+    }
+    memcpy(resume->data, t1->data, datasize * sizeof(OPJ_INT32));
+    memcpy(resume->flags, t1->flags, t1->flagssize * sizeof(opj_flag_t));
+
+    resume->valid = OPJ_TRUE;
+    resume->segno = segno;
+    resume->passno = passno;
+    resume->numpasses = numpasses;
+    resume->bpno_plus_one = bpno_plus_one;
+    resume->passtype = passtype;
+    resume->prefix_len = prefix_len;
+    resume->prefix_hash = prefix_hash;
+    resume->has_mqc = (passno != 0);
+    if (resume->has_mqc) {
+        resume->a = mqc->a;
+        resume->c = mqc->c;
+        resume->ct = mqc->ct;
+        resume->bp_offset = (OPJ_UINT32)(mqc->bp - mqc->start);
+    }
+    /* Contexts are kept from one segment to the next one */
+    memcpy(resume->ctxs, mqc->ctxs, sizeof(resume->ctxs));
+}
+
 static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                                    opj_tcd_cblk_dec_t* cblk,
                                    OPJ_UINT32 orient,
@@ -1929,7 +2811,10 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                                    OPJ_UINT32 cblksty,
                                    opj_event_mgr_t *p_manager,
                                    opj_mutex_t* p_manager_mutex,
-                                   OPJ_BOOL check_pterm)
+                                   OPJ_BOOL check_pterm,
+                                   OPJ_BOOL resume,
+                                   OPJ_BOOL save_state,
+                                   OPJ_UINT32 max_passes)
 {
     opj_mqc_t *mqc = &(t1->mqc);   /* MQC component */
 
@@ -1940,9 +2825,16 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
     OPJ_UINT32 cblkdataindex = 0;
     OPJ_BYTE type = T1_TYPE_MQ; /* BYPASS mode */
     OPJ_INT32* original_t1_data = NULL;
+    OPJ_UINT32 numpasses = 0;
+    OPJ_UINT32 passes_done = 0;
+    OPJ_BOOL truncated = OPJ_FALSE;
 
     mqc->lut_ctxno_zc_orient = lut_ctxno_zc + (orient << 9);
 
+    if (!resume) {
+        t1->resume.valid = OPJ_FALSE;
+    }
+
     if (!opj_t1_allocate_buffers(
                 t1,
                 (OPJ_UINT32)(cblk->x1 - cblk->x0),
@@ -2017,14 +2909,53 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
         t1->data = cblk->decoded_data;
     }
 
+    /* Restore the samples, flags and contexts of the state to resume from */
+    if (resume) {
+        memcpy(t1->data, t1->resume.data, t1->w * t1->h * sizeof(OPJ_INT32));
+        memcpy(t1->flags, t1->resume.flags, t1->flagssize * sizeof(opj_flag_t));
+        memcpy(mqc->ctxs, t1->resume.ctxs, sizeof(mqc->ctxs));
+        bpno_plus_one = t1->resume.bpno_plus_one;
+        passtype = t1->resume.passtype;
+    }
     for (segno = 0; segno < cblk->real_num_segs; ++segno) {
+        numpasses += cblk->segs[segno].real_num_passes;
+    }
+    /* Skip the refinement beyond max_passes. The samples decoded so far */
+    /* are already at the middle of their interval of uncertainty */
+    if (max_passes != 0 && numpasses > max_passes) {
+        numpasses = max_passes;
+        truncated = OPJ_TRUE;
+    }
+
+    for (segno = 0; segno < cblk->real_num_segs && passes_done < numpasses;
+            ++segno) {
         opj_tcd_seg_t *seg = &cblk->segs[segno];
+        OPJ_UINT32 seg_start = cblkdataindex;
+
+        if (resume && segno < t1->resume.segno) {
+            cblkdataindex += seg->len;
+            passes_done += seg->real_num_passes;
+            continue;
+        }
 
         /* BYPASS mode */
         type = ((bpno_plus_one <= ((OPJ_INT32)(cblk->numbps)) - 4) && (passtype < 2) &&
                 (cblksty & J2K_CCP_CBLKSTY_LAZY)) ? T1_TYPE_RAW : T1_TYPE_MQ;
 
-        if (type == T1_TYPE_RAW) {
+        passno = 0;
+        if (resume && segno == t1->resume.segno && t1->resume.has_mqc) {
+            /* Resume in the middle of a MQ segment */
+            opj_mqc_init_dec(mqc, cblkdata + cblkdataindex, seg->len,
+                             OPJ_COMMON_CBLK_DATA_EXTRA);
+            type = T1_TYPE_MQ;
+            mqc->a = t1->resume.a;
+            mqc->c = t1->resume.c;
+            mqc->ct = t1->resume.ct;
+            mqc->bp = mqc->start + t1->resume.bp_offset;
+            mqc->end_of_byte_stream_counter = 0;
+            passno = t1->resume.passno;
+            passes_done += passno;
+        } else if (type == T1_TYPE_RAW) {
             opj_mqc_raw_init_dec(mqc, cblkdata + cblkdataindex, seg->len,
                                  OPJ_COMMON_CBLK_DATA_EXTRA);
         } else {
@@ -2033,7 +2964,7 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
         }
         cblkdataindex += seg->len;
 
-        for (passno = 0; (passno < seg->real_num_passes) &&
+        for (; (passno < seg->real_num_passes) && (passes_done < numpasses) &&
                 (bpno_plus_one >= 1); ++passno) {
             switch (passtype) {
             case 0:
@@ -2065,12 +2996,19 @@ static OPJ_BOOL opj_t1_decode_cblk(opj_t1_t *t1,
                 passtype = 0;
                 bpno_plus_one--;
             }
+
+            /* The decoder usually reads beyond the data of the last passes, */
+            /* so only those are candidates to resume from */
+            if (++passes_done + 3 >= numpasses && save_state) {
+                opj_t1_save_resume_state(t1, cblk, segno, passno + 1, passes_done,
+                                         seg_start, type, bpno_plus_one, passtype);
+            }
         }
 
         opq_mqc_finish_dec(mqc);
     }
 
-    if (check_pterm) {
+    if (check_pterm && !truncated) {
         if (mqc->bp + 2 < mqc->end) {
             if (p_manager_mutex) {
                 opj_mutex_lock(p_manager_mutex);
@@ -2115,8 +3053,15 @@ typedef struct {
     opj_tccp_t* tccp;
     const OPJ_FLOAT64 * mct_norms;
     OPJ_UINT32 mct_numcomps;
+    OPJ_BOOL compute_distortion;
+    /* When not NULL, samples of the stripe of the band containing the */
+    /* code-block, to use instead of the tile component data */
+    const OPJ_INT32* stripe_data;
+    OPJ_INT32 stripe_y0;
+    OPJ_UINT32 stripe_stride;
     volatile OPJ_BOOL* pret;
     opj_mutex_t* mutex;
+    const opj_interrupt_t* interrupt;
 } opj_t1_cblk_encode_processing_job_t;
 
 /** Procedure to deal with a asynchronous code-block encoding job.
@@ -2134,9 +3079,9 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
     const opj_tccp_t* tccp = job->tccp;
     const OPJ_UINT32 resno = job->resno;
     opj_t1_t* t1;
-    const OPJ_UINT32 tile_w = (OPJ_UINT32)(tilec->x1 - tilec->x0);
+    OPJ_UINT32 tile_w = (OPJ_UINT32)(tilec->x1 - tilec->x0);
 
-    OPJ_INT32* OPJ_RESTRICT tiledp;
+    const OPJ_INT32* OPJ_RESTRICT tiledp;
     OPJ_UINT32 cblk_w;
     OPJ_UINT32 cblk_h;
     OPJ_UINT32 i, j;
@@ -2148,6 +3093,11 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
         opj_free(job);
         return;
     }
+    if (job->interrupt && job->interrupt->cancelled) {
+        *(job->pret) = OPJ_FALSE;
+        opj_free(job);
+        return;
+    }
 
     t1 = (opj_t1_t*) opj_tls_get(tls, OPJ_TLS_KEY_T1);
     if (t1 == NULL) {
@@ -2155,16 +3105,22 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
         opj_tls_set(tls, OPJ_TLS_KEY_T1, t1, opj_t1_destroy_wrapper);
     }
 
-    if (band->bandno & 1) {
-        opj_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
-        x += pres->x1 - pres->x0;
-    }
-    if (band->bandno & 2) {
-        opj_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
-        y += pres->y1 - pres->y0;
+    if (job->stripe_data) {
+        y = cblk->y0 - job->stripe_y0;
+        tile_w = job->stripe_stride;
+    } else {
+        if (band->bandno & 1) {
+            opj_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
+            x += pres->x1 - pres->x0;
+        }
+        if (band->bandno & 2) {
+            opj_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
+            y += pres->y1 - pres->y0;
+        }
     }
 
-    if (!opj_t1_allocate_buffers(
+    if (!opj_tcd_code_block_enc_allocate_data(cblk) ||
+            !opj_t1_allocate_buffers(
                 t1,
                 (OPJ_UINT32)(cblk->x1 - cblk->x0),
                 (OPJ_UINT32)(cblk->y1 - cblk->y0))) {
@@ -2176,7 +3132,11 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
     cblk_w = t1->w;
     cblk_h = t1->h;
 
-    tiledp = &tilec->data[(OPJ_SIZE_T)y * tile_w + (OPJ_SIZE_T)x];
+    if (job->stripe_data) {
+        tiledp = &job->stripe_data[(OPJ_SIZE_T)y * tile_w + (OPJ_SIZE_T)x];
+    } else {
+        tiledp = &tilec->data[(OPJ_SIZE_T)y * tile_w + (OPJ_SIZE_T)x];
+    }
 
     if (tccp->qmfbid == 1) {
         /* Do multiplication on unsigned type, even if the
@@ -2187,7 +3147,7 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
             * representation
             * Fixes https://github.com/uclouvain/openjpeg/issues/1053
             */
-        OPJ_UINT32* OPJ_RESTRICT tiledp_u = (OPJ_UINT32*) tiledp;
+        const OPJ_UINT32* OPJ_RESTRICT tiledp_u = (const OPJ_UINT32*) tiledp;
         OPJ_UINT32* OPJ_RESTRICT t1data = (OPJ_UINT32*) t1->data;
         /* Change from "natural" order to "zigzag" order of T1 passes */
         for (j = 0; j < (cblk_h & ~3U); j += 4) {
@@ -2209,7 +3169,7 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
             }
         }
     } else {        /* if (tccp->qmfbid == 0) */
-        OPJ_FLOAT32* OPJ_RESTRICT tiledp_f = (OPJ_FLOAT32*) tiledp;
+        const OPJ_FLOAT32* OPJ_RESTRICT tiledp_f = (const OPJ_FLOAT32*) tiledp;
         OPJ_INT32* OPJ_RESTRICT t1data = t1->data;
         /* Change from "natural" order to "zigzag" order of T1 passes */
         for (j = 0; j < (cblk_h & ~3U); j += 4) {
@@ -2250,7 +3210,8 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
                 tccp->cblksty,
                 job->tile->numcomps,
                 job->mct_norms,
-                job->mct_numcomps);
+                job->mct_numcomps,
+                job->compute_distortion);
         if (job->mutex) {
             opj_mutex_lock(job->mutex);
         }
@@ -2260,6 +3221,12 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
         }
     }
 
+    if (job->stripe_data) {
+        /* Only keep the compressed bytes, so that memory does not scale */
+        /* with the tile area */
+        opj_tcd_code_block_enc_shrink_data(cblk);
+    }
+
     opj_free(job);
 }
 
@@ -2268,7 +3235,8 @@ OPJ_BOOL opj_t1_encode_cblks(opj_tcd_t* tcd,
                              opj_tcd_tile_t *tile,
                              opj_tcp_t *tcp,
                              const OPJ_FLOAT64 * mct_norms,
-                             OPJ_UINT32 mct_numcomps
+                             OPJ_UINT32 mct_numcomps,
+                             OPJ_BOOL compute_distortion
                             )
 {
     volatile OPJ_BOOL ret = OPJ_TRUE;
@@ -2314,8 +3282,10 @@ OPJ_BOOL opj_t1_encode_cblks(opj_tcd_t* tcd,
                         job->tccp = tccp;
                         job->mct_norms = mct_norms;
                         job->mct_numcomps = mct_numcomps;
+                        job->compute_distortion = compute_distortion;
                         job->pret = &ret;
                         job->mutex = mutex;
+                        job->interrupt = tcd->interrupt;
                         opj_thread_pool_submit_job(tp, opj_t1_cblk_encode_processor, job);
 
                     } /* cblkno */
@@ -2333,6 +3303,92 @@ end:
     return ret;
 }
 
+OPJ_BOOL opj_t1_encode_cblks_stripe(opj_tcd_t* tcd,
+                                    opj_tcd_tile_t *tile,
+                                    opj_tcp_t *tcp,
+                                    OPJ_UINT32 compno,
+                                    OPJ_UINT32 resno,
+                                    OPJ_UINT32 bandno,
+                                    const OPJ_INT32* stripe_data,
+                                    OPJ_INT32 stripe_y0,
+                                    OPJ_INT32 stripe_y1,
+                                    OPJ_UINT32 stripe_stride,
+                                    const OPJ_FLOAT64 * mct_norms,
+                                    OPJ_UINT32 mct_numcomps,
+                                    OPJ_BOOL compute_distortion)
+{
+    volatile OPJ_BOOL ret = OPJ_TRUE;
+    opj_thread_pool_t* tp = tcd->thread_pool;
+    opj_tcd_tilecomp_t* tilec = &tile->comps[compno];
+    opj_tccp_t* tccp = &tcp->tccps[compno];
+    opj_tcd_resolution_t *res = &tilec->resolutions[resno];
+    opj_tcd_band_t* OPJ_RESTRICT band = &res->bands[bandno];
+    OPJ_UINT32 precno, cblkno, cblk_row;
+    opj_mutex_t* mutex;
+
+    if (opj_tcd_is_band_empty(band)) {
+        return OPJ_TRUE;
+    }
+
+    mutex = opj_mutex_create();
+
+    for (precno = 0; precno < res->pw * res->ph; ++precno) {
+        opj_tcd_precinct_t *prc = &band->precincts[precno];
+
+        if (prc->y1 <= stripe_y0 || prc->y0 >= stripe_y1) {
+            continue;
+        }
+        for (cblk_row = 0; cblk_row < prc->ch; ++cblk_row) {
+            const opj_tcd_cblk_enc_t* first_cblk = &prc->cblks.enc[cblk_row * prc->cw];
+
+            if (first_cblk->y0 >= stripe_y1) {
+                break;
+            }
+            if (first_cblk->y0 < stripe_y0) {
+                continue;
+            }
+            assert(first_cblk->y1 <= stripe_y1);
+
+            for (cblkno = cblk_row * prc->cw; cblkno < (cblk_row + 1) * prc->cw;
+                    ++cblkno) {
+                opj_t1_cblk_encode_processing_job_t* job =
+                    (opj_t1_cblk_encode_processing_job_t*) opj_calloc(1,
+                            sizeof(opj_t1_cblk_encode_processing_job_t));
+                if (!job) {
+                    ret = OPJ_FALSE;
+                    goto end;
+                }
+                job->compno = compno;
+                job->tile = tile;
+                job->resno = resno;
+                job->cblk = &prc->cblks.enc[cblkno];
+                job->band = band;
+                job->tilec = tilec;
+                job->tccp = tccp;
+                job->mct_norms = mct_norms;
+                job->mct_numcomps = mct_numcomps;
+                job->compute_distortion = compute_distortion;
+                job->stripe_data = stripe_data;
+                job->stripe_y0 = stripe_y0;
+                job->stripe_stride = stripe_stride;
+                job->pret = &ret;
+                job->mutex = mutex;
+                job->interrupt = tcd->interrupt;
+                opj_thread_pool_submit_job(tp, opj_t1_cblk_encode_processor, job);
+            }
+        }
+    }
+
+end:
+    /* The stripe is reused by the caller once this function returns */
+    opj_thread_pool_wait_completion(tcd->thread_pool, 0);
+    if (mutex) {
+        opj_mutex_destroy(mutex);
+    }
+
+    return ret;
+}
+
 /* Returns whether the pass (bpno, passtype) is terminated */
 static int opj_t1_enc_is_term_pass(opj_tcd_cblk_enc_t* cblk,
                                    OPJ_UINT32 cblksty,
@@ -2375,7 +3431,8 @@ static OPJ_FLOAT64 opj_t1_encode_cblk(opj_t1_t *t1,
                                       OPJ_UINT32 cblksty,
                                       OPJ_UINT32 numcomps,
                                       const OPJ_FLOAT64 * mct_norms,
-                                      OPJ_UINT32 mct_numcomps)
+                                      OPJ_UINT32 mct_numcomps,
+                                      OPJ_BOOL compute_distortion)
 {
     OPJ_FLOAT64 cumwmsedec = 0.0;
 
@@ -2462,9 +3519,11 @@ static OPJ_FLOAT64 opj_t1_encode_cblk(opj_t1_t *t1,
         }
 
         /* fixed_quality */
-        tempwmsedec = opj_t1_getwmsedec(nmsedec, compno, level, orient, bpno, qmfbid,
-                                        stepsize, numcomps, mct_norms, mct_numcomps) ;
-        cumwmsedec += tempwmsedec;
+        if (compute_distortion) {
+            tempwmsedec = opj_t1_getwmsedec(nmsedec, compno, level, orient, bpno, qmfbid,
+                                            stepsize, numcomps, mct_norms, mct_numcomps) ;
+            cumwmsedec += tempwmsedec;
+        }
         pass->distortiondec = cumwmsedec;
 
         if (opj_t1_enc_is_term_pass(cblk, cblksty, bpno, passtype)) {
@@ -70,6 +70,9 @@ in T1.C are used by some function in TCD.C.
 #define T1_TYPE_MQ 0    /**< Normal coding using entropy coder */
 #define T1_TYPE_RAW 1   /**< No encoding the information is store under raw format in codestream (mode switch RAW)*/
 
+/** Minimum number of samples of the code-blocks of a Tier-1 decoding job */
+#define OPJ_T1_MIN_SAMPLES_PER_JOB 16384
+
 /* BEGINNING of flags that apply to opj_flag_t */
 /** We hold the state of individual data points for the T1 encoder using
  *  a single 32-bit flags word to hold the state of 4 data points.  This corresponds
@@ -178,6 +181,41 @@ in T1.C are used by some function in TCD.C.
 /** Flags for 4 consecutive rows of a column */
 typedef OPJ_UINT32 opj_flag_t;
 
+/**
+State of the Tier-1 decoder of a code-block at a coding pass boundary, from
+which decoding can resume once the code-block has more coding passes
+*/
+typedef struct opj_t1_resume_state {
+    /** Whether the state is set */
+    OPJ_BOOL valid;
+    /** Segment to resume from, and number of its passes already decoded */
+    OPJ_UINT32 segno;
+    OPJ_UINT32 passno;
+    /** Number of coding passes of the code-block decoded in the state */
+    OPJ_UINT32 numpasses;
+    /** Bit-plane and type of the next pass */
+    OPJ_INT32 bpno_plus_one;
+    OPJ_UINT32 passtype;
+    /** Number of bytes of code-block data the state depends on, and their */
+    /** hash (which also covers the lengths and passes of the segments) */
+    OPJ_UINT32 prefix_len;
+    OPJ_UINT32 prefix_hash;
+    /** Contexts of the MQ decoder */
+    const opj_mqc_state_t *ctxs[MQC_NUMCTXS];
+    /** Whether the registers of the MQ decoder must be restored (passno != 0) */
+    OPJ_BOOL has_mqc;
+    OPJ_UINT32 a;
+    OPJ_UINT32 c;
+    OPJ_UINT32 ct;
+    /** Position of the MQ decoder from the start of segment segno */
+    OPJ_UINT32 bp_offset;
+    /** Copies of the decoded samples and of the flags */
+    OPJ_INT32 *data;
+    opj_flag_t *flags;
+    OPJ_UINT32 datasize;
+    OPJ_UINT32 flagssize;
+} opj_t1_resume_state_t;
+
 /**
 Tier-1 coding (coding of code-block coefficients)
 */
@@ -207,8 +245,22 @@ typedef struct opj_t1 {
     OPJ_BYTE    *cblkdatabuffer;
     /* Maximum size available in cblkdatabuffer */
     OPJ_UINT32   cblkdatabuffersize;
+    /* Only used by the decoder, with OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG: */
+    /* state to resume decoding from, and state saved by the last decoding */
+    opj_t1_resume_state_t resume;
 } opj_t1_t;
 
+/**
+Cache of decoded code-blocks, shared by the successive decodings of a
+decompressor (see opj_decoder_set_cblk_cache_size())
+*/
+typedef struct opj_t1_cblk_cache opj_t1_cblk_cache_t;
+
+/**
+Tier-1 decoding jobs of a tile, kept by the TCD from tile to tile
+*/
+typedef struct opj_t1_decode_jobs opj_t1_decode_jobs_t;
+
 /** @name Exported functions */
 /*@{*/
 /* ----------------------------------------------------------------------- */
@@ -220,15 +272,55 @@ Encode the code-blocks of a tile
 @param tcp Tile coding parameters
 @param mct_norms  FIXME DOC
 @param mct_numcomps Number of components used for MCT
+@param compute_distortion Whether the per-pass distortion decrease must be
+                          computed (only needed by rate/distortion allocation)
 */
 OPJ_BOOL opj_t1_encode_cblks(opj_tcd_t* tcd,
                              opj_tcd_tile_t *tile,
                              opj_tcp_t *tcp,
                              const OPJ_FLOAT64 * mct_norms,
-                             OPJ_UINT32 mct_numcomps);
+                             OPJ_UINT32 mct_numcomps,
+                             OPJ_BOOL compute_distortion);
+
+/**
+Encode the code-blocks of a band lying in a stripe of rows of that band,
+taking their samples from the stripe instead of the tile component data.
+The tile distortion is accumulated into tile->distotile, which is not reset.
+@param tcd TCD handle
+@param tile The tile to encode
+@param tcp Tile coding parameters
+@param compno Component number
+@param resno Resolution number
+@param bandno Index of the band in the resolution
+@param stripe_data Samples of the stripe, starting at column band->x0 of row stripe_y0
+@param stripe_y0 First row of the stripe, in band coordinates
+@param stripe_y1 Row following the last row of the stripe, in band coordinates
+@param stripe_stride Number of samples between two rows of stripe_data
+@param mct_norms  FIXME DOC
+@param mct_numcomps Number of components used for MCT
+@param compute_distortion Whether the per-pass distortion decrease must be
+                          computed (only needed by rate/distortion allocation)
+*/
+OPJ_BOOL opj_t1_encode_cblks_stripe(opj_tcd_t* tcd,
+                                    opj_tcd_tile_t *tile,
+                                    opj_tcp_t *tcp,
+                                    OPJ_UINT32 compno,
+                                    OPJ_UINT32 resno,
+                                    OPJ_UINT32 bandno,
+                                    const OPJ_INT32* stripe_data,
+                                    OPJ_INT32 stripe_y0,
+                                    OPJ_INT32 stripe_y1,
+                                    OPJ_UINT32 stripe_stride,
+                                    const OPJ_FLOAT64 * mct_norms,
+                                    OPJ_UINT32 mct_numcomps,
+                                    OPJ_BOOL compute_distortion);
 
 /**
 Decode the code-blocks of a tile
+
+The code-blocks are grouped into jobs of at least
+OPJ_T1_MIN_SAMPLES_PER_JOB samples, that are only run by
+opj_t1_run_decode_jobs().
 @param tcd TCD handle
 @param pret Pointer to return value
 @param tilec The tile to decode
@@ -245,7 +337,52 @@ void opj_t1_decode_cblks(opj_tcd_t* tcd,
                          opj_mutex_t* p_manager_mutex,
                          OPJ_BOOL check_pterm);
 
+/**
+Run the decoding jobs collected by opj_t1_decode_cblks() for the tile, and
+wait for their completion. When there is too little work to benefit from
+several threads, the jobs are run by the calling thread.
+@param tcd TCD handle
+*/
+void opj_t1_run_decode_jobs(opj_tcd_t* tcd);
 
+/**
+Destroy the decoding jobs of a TCD
+@param jobs jobs to destroy, or NULL
+*/
+void opj_t1_destroy_decode_jobs(opj_t1_decode_jobs_t* jobs);
+
+
+
+/**
+ * Creates a cache of decoded code-blocks.
+ *
+ * Entries are keyed by the position of the code-block (tile, component,
+ * resolution, band and code-block) and hold its coefficients as decoded by
+ * Tier 1, together with a fingerprint of the codestream data they were
+ * decoded from, so that an entry is only used when the same data is decoded
+ * again. The least recently used entries are evicted to stay in budget.
+ *
+ * @param max_size  budget of the cache, in bytes
+ * @return a new cache, or NULL in case of memory allocation failure
+*/
+opj_t1_cblk_cache_t* opj_t1_cblk_cache_create(OPJ_SIZE_T max_size);
+
+/**
+ * Changes the budget of a code-block cache, evicting entries if needed.
+ * Must not be called while code-blocks are being decoded.
+ *
+ * @param cache     code-block cache
+ * @param max_size  new budget of the cache, in bytes
+*/
+void opj_t1_cblk_cache_set_max_size(opj_t1_cblk_cache_t* cache,
+                                    OPJ_SIZE_T max_size);
+
+/**
+ * Destroys a code-block cache and its entries
+ *
+ * @param cache code-block cache to destroy (may be NULL)
+*/
+void opj_t1_cblk_cache_destroy(opj_t1_cblk_cache_t* cache);
 
 /**
  * Creates a new Tier 1 handle
@@ -94,6 +94,9 @@ Decode a packet of a tile from a source buffer
 @param data_read   FIXME DOC
 @param max_length  FIXME DOC
 @param pack_info Packet information
+@param p_truncated if not NULL (non strict mode), set to OPJ_TRUE when the
+packet is truncated, instead of failing. Only its complete code-block
+segments are then kept.
 @param p_manager the user event manager
 
 @return  FIXME DOC
@@ -106,6 +109,7 @@ static OPJ_BOOL opj_t2_decode_packet(opj_t2_t* t2,
                                      OPJ_UINT32 * data_read,
                                      OPJ_UINT32 max_length,
                                      opj_packet_info_t *pack_info,
+                                     OPJ_BOOL *p_truncated,
                                      opj_event_mgr_t *p_manager);
 
 static OPJ_BOOL opj_t2_skip_packet(opj_t2_t* p_t2,
@@ -116,6 +120,7 @@ static OPJ_BOOL opj_t2_skip_packet(opj_t2_t* p_t2,
                                    OPJ_UINT32 * p_data_read,
                                    OPJ_UINT32 p_max_length,
                                    opj_packet_info_t *p_pack_info,
+                                   OPJ_BOOL *p_truncated,
                                    opj_event_mgr_t *p_manager);
 
 static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
@@ -127,6 +132,7 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
         OPJ_UINT32 * p_data_read,
         OPJ_UINT32 p_max_length,
         opj_packet_info_t *p_pack_info,
+        OPJ_BOOL *p_truncated,
         opj_event_mgr_t *p_manager);
 
 static OPJ_BOOL opj_t2_read_packet_data(opj_t2_t* p_t2,
@@ -136,6 +142,7 @@ static OPJ_BOOL opj_t2_read_packet_data(opj_t2_t* p_t2,
                                         OPJ_UINT32 * p_data_read,
                                         OPJ_UINT32 p_max_length,
                                         opj_packet_info_t *pack_info,
+                                        OPJ_BOOL *p_truncated,
                                         opj_event_mgr_t *p_manager);
 
 static OPJ_BOOL opj_t2_skip_packet_data(opj_t2_t* p_t2,
@@ -144,8 +151,33 @@ static OPJ_BOOL opj_t2_skip_packet_data(opj_t2_t* p_t2,
                                         OPJ_UINT32 * p_data_read,
                                         OPJ_UINT32 p_max_length,
                                         opj_packet_info_t *pack_info,
+                                        OPJ_BOOL *p_truncated,
                                         opj_event_mgr_t *p_manager);
 
+/**
+Saves in p_t2->precinct_state the part of the state of the code-blocks and
+tag trees of a precinct that reading a packet header updates: the number of
+segments, of length bits, of bit-planes and of new passes of each
+code-block, and the nodes of the inclusion and IMSB tag trees.
+@param p_t2 T2 handle
+@param p_res Resolution of the precinct
+@param p_precno Index of the precinct
+@return OPJ_FALSE if memory is missing
+*/
+static OPJ_BOOL opj_t2_save_precinct_state(opj_t2_t* p_t2,
+        opj_tcd_resolution_t* p_res,
+        OPJ_UINT32 p_precno);
+
+/**
+Restores the state saved by opj_t2_save_precinct_state().
+@param p_t2 T2 handle
+@param p_res Resolution of the precinct
+@param p_precno Index of the precinct
+*/
+static void opj_t2_restore_precinct_state(const opj_t2_t* p_t2,
+        opj_tcd_resolution_t* p_res,
+        OPJ_UINT32 p_precno);
+
 /**
 @param cblk
 @param index
@@ -157,6 +189,49 @@ static OPJ_BOOL opj_t2_init_seg(opj_tcd_cblk_dec_t* cblk,
                                 OPJ_UINT32 cblksty,
                                 OPJ_UINT32 first);
 
+/**
+Check whether a packet is only parsed, and its data skipped, because of
+the number of layers or resolutions to decode or of the area of interest.
+@param tcd TCD handle
+@param p_tcp Tile coding parameters
+@param p_tile Tile for which the packets are decoded
+@param p_pi Packet identity
+@return OPJ_TRUE if the data of the packet must be skipped
+*/
+static OPJ_BOOL opj_t2_is_packet_skipped(opj_tcd_t* tcd,
+        opj_tcp_t *p_tcp,
+        opj_tcd_tile_t *p_tile,
+        opj_pi_iterator_t *p_pi);
+
+/**
+Decode the packets of a tile in parallel on the thread pool of the TCD,
+using the packet lengths signalled by the PLT markers to locate them.
+Packets of distinct precincts are independent once located, so each job
+decodes all the packets of a group of precincts.
+
+Nothing is decoded and OPJ_FALSE is returned if less than 2 threads are
+available, if the packet headers are in PPM/PPT markers or if the PLT
+markers do not describe the packets of the tile. If decoding in parallel
+fails or emits any message, the state of the code-blocks is reset and
+OPJ_FALSE is returned, so that opj_t2_decode_packets() decodes the packets
+sequentially, with the usual error reporting.
+@param tcd TCD handle
+@param p_t2 T2 handle
+@param p_tile_no number that identifies the tile for which to decode the packets
+@param p_tile tile for which to decode the packets
+@param p_src the source buffer
+@param p_data_read number of bytes of the source buffer read
+@param p_max_len length of the source buffer
+@return OPJ_TRUE if all the packets have been decoded
+*/
+static OPJ_BOOL opj_t2_decode_packets_mt(opj_tcd_t* tcd,
+        opj_t2_t *p_t2,
+        OPJ_UINT32 p_tile_no,
+        opj_tcd_tile_t *p_tile,
+        OPJ_BYTE *p_src,
+        OPJ_UINT32 * p_data_read,
+        OPJ_UINT32 p_max_len);
+
 /*@}*/
 
 /*@}*/
@@ -175,10 +250,21 @@ static void opj_t2_putcommacode(opj_bio_t *bio, OPJ_INT32 n)
 static OPJ_UINT32 opj_t2_getcommacode(opj_bio_t *bio)
 {
     OPJ_UINT32 n = 0;
-    while (opj_bio_read(bio, 1)) {
-        ++n;
+    for (;;) {
+        /* Count the leading 1 bits of the next 32 bits */
+        OPJ_UINT32 l_bits = opj_bio_peek(bio, 32);
+        OPJ_UINT32 l_ones = 0;
+        while (l_ones < 32 && (l_bits & (0x80000000U >> l_ones))) {
+            ++l_ones;
+        }
+        n += l_ones;
+        if (l_ones < 32) {
+            /* Also consume the terminating 0 bit */
+            opj_bio_skip(bio, l_ones + 1);
+            return n;
+        }
+        opj_bio_skip(bio, 32);
     }
-    return n;
 }
 
 static void opj_t2_putnumpasses(opj_bio_t *bio, OPJ_UINT32 n)
@@ -198,20 +284,27 @@ static void opj_t2_putnumpasses(opj_bio_t *bio, OPJ_UINT32 n)
 
 static OPJ_UINT32 opj_t2_getnumpasses(opj_bio_t *bio)
 {
+    /* The longest code is 16 bits long: decode it from a single peek */
+    OPJ_UINT32 l_bits = opj_bio_peek(bio, 16);
     OPJ_UINT32 n;
-    if (!opj_bio_read(bio, 1)) {
+    if (!(l_bits & 0x8000)) {
+        opj_bio_skip(bio, 1);
         return 1;
     }
-    if (!opj_bio_read(bio, 1)) {
+    if (!(l_bits & 0x4000)) {
+        opj_bio_skip(bio, 2);
         return 2;
     }
-    if ((n = opj_bio_read(bio, 2)) != 3) {
+    if ((n = (l_bits >> 12) & 3) != 3) {
+        opj_bio_skip(bio, 4);
         return (3 + n);
     }
-    if ((n = opj_bio_read(bio, 5)) != 31) {
+    if ((n = (l_bits >> 7) & 31) != 31) {
+        opj_bio_skip(bio, 9);
         return (6 + n);
     }
-    return (37 + opj_bio_read(bio, 7));
+    opj_bio_skip(bio, 16);
+    return (37 + (l_bits & 127));
 }
 
 /* ----------------------------------------------------------------------- */
@@ -390,6 +483,349 @@ static void opj_null_jas_fprintf(FILE* file, const char * format, ...)
 #define JAS_FPRINTF opj_null_jas_fprintf
 #endif
 
+static OPJ_BOOL opj_t2_is_packet_skipped(opj_tcd_t* tcd,
+        opj_tcp_t *p_tcp,
+        opj_tcd_tile_t *p_tile,
+        opj_pi_iterator_t *p_pi)
+{
+    OPJ_UINT32 bandno;
+    opj_tcd_tilecomp_t *tilec;
+    opj_tcd_resolution_t *res;
+
+    /* If the packet layer is greater or equal than the maximum */
+    /* number of layers, skip the packet */
+    if (p_pi->layno >= p_tcp->num_layers_to_decode) {
+        return OPJ_TRUE;
+    }
+    /* If the packet resolution number is greater than the minimum */
+    /* number of resolution allowed, skip the packet */
+    if (p_pi->resno >= p_tile->comps[p_pi->compno].minimum_num_resolutions) {
+        return OPJ_TRUE;
+    }
+
+    /* If no precincts of any band intersects the area of interest, */
+    /* skip the packet */
+    tilec = &p_tile->comps[p_pi->compno];
+    res = &tilec->resolutions[p_pi->resno];
+    for (bandno = 0; bandno < res->numbands; ++bandno) {
+        opj_tcd_band_t* band = &res->bands[bandno];
+        opj_tcd_precinct_t* prec = &band->precincts[p_pi->precno];
+
+        if (opj_tcd_is_subband_area_of_interest(tcd,
+                                                p_pi->compno,
+                                                p_pi->resno,
+                                                band->bandno,
+                                                (OPJ_UINT32)prec->x0,
+                                                (OPJ_UINT32)prec->y0,
+                                                (OPJ_UINT32)prec->x1,
+                                                (OPJ_UINT32)prec->y1)) {
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
+/** Packet located with the PLT markers */
+typedef struct {
+    /** progression order change the packet belongs to */
+    OPJ_UINT32 pino;
+    OPJ_UINT32 compno;
+    OPJ_UINT32 resno;
+    OPJ_UINT32 precno;
+    OPJ_UINT32 layno;
+    /** index of the precinct among all the precincts of the tile */
+    OPJ_UINT32 precinct;
+    /** offset of the packet in the tile data */
+    OPJ_UINT32 offset;
+    /** length of the packet, as signalled by the PLT markers */
+    OPJ_UINT32 length;
+    OPJ_BOOL skip;
+} opj_t2_located_packet_t;
+
+typedef struct {
+    opj_t2_t* t2;
+    opj_tcd_tile_t *tile;
+    opj_tcp_t *tcp;
+    const opj_t2_located_packet_t *packets;
+    /** indices of the packets, sorted by precinct then codestream order */
+    const OPJ_UINT32 *order;
+    /** range of order to decode */
+    OPJ_UINT32 first;
+    OPJ_UINT32 last;
+    OPJ_BYTE *src;
+    OPJ_UINT32 max_len;
+    opj_event_mgr_t *p_manager;
+    volatile OPJ_BOOL* pret;
+} opj_t2_decode_packets_job_t;
+
+static void opj_t2_decode_packets_msg_callback(const char *msg,
+        void *client_data)
+{
+    OPJ_ARG_NOT_USED(msg);
+    *((volatile OPJ_BOOL*)client_data) = OPJ_FALSE;
+}
+
+static void opj_t2_decode_packets_processor(void* user_data, opj_tls_t* tls)
+{
+    opj_t2_decode_packets_job_t* job = (opj_t2_decode_packets_job_t*)user_data;
+    OPJ_UINT32 i;
+
+    OPJ_ARG_NOT_USED(tls);
+
+    for (i = job->first; i < job->last && *(job->pret); ++i) {
+        const opj_t2_located_packet_t* l_packet = &job->packets[job->order[i]];
+        opj_pi_iterator_t l_pi;
+        OPJ_UINT32 l_nb_bytes_read = 0;
+        OPJ_BOOL l_ok;
+
+        memset(&l_pi, 0, sizeof(l_pi));
+        l_pi.compno = l_packet->compno;
+        l_pi.resno = l_packet->resno;
+        l_pi.precno = l_packet->precno;
+        l_pi.layno = l_packet->layno;
+
+        if (l_packet->skip) {
+            l_ok = opj_t2_skip_packet(job->t2, job->tile, job->tcp, &l_pi,
+                                      job->src + l_packet->offset, &l_nb_bytes_read,
+                                      job->max_len - l_packet->offset, 00, 00, job->p_manager);
+        } else {
+            l_ok = opj_t2_decode_packet(job->t2, job->tile, job->tcp, &l_pi,
+                                        job->src + l_packet->offset, &l_nb_bytes_read,
+                                        job->max_len - l_packet->offset, 00, 00, job->p_manager);
+        }
+        if (!l_ok || l_nb_bytes_read != l_packet->length) {
+            *(job->pret) = OPJ_FALSE;
+        }
+    }
+
+    opj_free(job);
+}
+
+/** Forget the segments and data chunks attached to the code-blocks */
+static void opj_t2_reset_cblks(opj_tcd_tile_t *p_tile)
+{
+    OPJ_UINT32 compno, resno, bandno, precno, cblkno;
+
+    for (compno = 0; compno < p_tile->numcomps; ++compno) {
+        opj_tcd_tilecomp_t *l_tilec = &p_tile->comps[compno];
+        for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
+            opj_tcd_resolution_t *l_res = &l_tilec->resolutions[resno];
+            for (bandno = 0; bandno < l_res->numbands; ++bandno) {
+                opj_tcd_band_t *l_band = &l_res->bands[bandno];
+                OPJ_UINT32 l_nb_precincts = (OPJ_UINT32)(l_band->precincts_data_size /
+                                            sizeof(opj_tcd_precinct_t));
+                for (precno = 0; precno < l_nb_precincts; ++precno) {
+                    opj_tcd_precinct_t *l_prc = &l_band->precincts[precno];
+                    opj_tcd_cblk_dec_t *l_cblk = l_prc->cblks.dec;
+                    if (!l_cblk) {
+                        continue;
+                    }
+                    for (cblkno = 0; cblkno < l_prc->cw * l_prc->ch; ++cblkno, ++l_cblk) {
+                        l_cblk->numsegs = 0;
+                        l_cblk->real_num_segs = 0;
+                        l_cblk->numchunks = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static OPJ_BOOL opj_t2_decode_packets_mt(opj_tcd_t* tcd,
+        opj_t2_t *p_t2,
+        OPJ_UINT32 p_tile_no,
+        opj_tcd_tile_t *p_tile,
+        OPJ_BYTE *p_src,
+        OPJ_UINT32 * p_data_read,
+        OPJ_UINT32 p_max_len)
+{
+    opj_thread_pool_t* tp = tcd->thread_pool;
+    opj_image_t *l_image = p_t2->image;
+    opj_cp_t *l_cp = p_t2->cp;
+    opj_tcp_t *l_tcp = &(l_cp->tcps[p_tile_no]);
+    OPJ_UINT32 l_nb_pocs = l_tcp->numpocs + 1;
+    OPJ_UINT32 l_nb_packets = 0, l_nb_precincts = 0, l_offset = 0;
+    OPJ_UINT32 l_job_size, l_first, pino, compno, resno, i;
+    opj_pi_iterator_t *l_pi = 00;
+    opj_pi_iterator_t *l_current_pi;
+    opj_t2_located_packet_t *l_packets = 00;
+    OPJ_UINT32 *l_res_precincts = 00;
+    OPJ_UINT32 *l_order = 00;
+    OPJ_UINT32 *l_counts = 00;
+    OPJ_BOOL *l_first_pass_failed = 00;
+    opj_event_mgr_t l_manager;
+    volatile OPJ_BOOL l_ret = OPJ_FALSE;
+
+    if (opj_thread_pool_get_thread_count(tp) <= 1 ||
+            l_tcp->m_nb_packet_lengths == 0 || l_cp->ppm == 1 || l_tcp->ppt == 1) {
+        return OPJ_FALSE;
+    }
+
+    /* Messages of the parallel decoding are not forwarded: any of them */
+    /* makes it fail, and the sequential decoding report it instead */
+    memset(&l_manager, 0, sizeof(l_manager));
+    l_manager.error_handler = opj_t2_decode_packets_msg_callback;
+    l_manager.warning_handler = opj_t2_decode_packets_msg_callback;
+    l_manager.info_handler = opj_t2_decode_packets_msg_callback;
+    l_manager.m_error_data = (void*)&l_ret;
+    l_manager.m_warning_data = (void*)&l_ret;
+    l_manager.m_info_data = (void*)&l_ret;
+
+    /* Index of the first precinct of each resolution of each component */
+    l_res_precincts = (OPJ_UINT32*)opj_malloc(p_tile->numcomps *
+                      OPJ_J2K_MAXRLVLS * sizeof(OPJ_UINT32));
+    l_packets = (opj_t2_located_packet_t*)opj_malloc(l_tcp->m_nb_packet_lengths *
+                sizeof(opj_t2_located_packet_t));
+    l_order = (OPJ_UINT32*)opj_malloc(l_tcp->m_nb_packet_lengths * sizeof(
+                                          OPJ_UINT32));
+    l_first_pass_failed = (OPJ_BOOL*)opj_malloc(l_image->numcomps * sizeof(
+                              OPJ_BOOL));
+    if (!l_res_precincts || !l_packets || !l_order || !l_first_pass_failed) {
+        goto cleanup;
+    }
+    for (compno = 0; compno < p_tile->numcomps; ++compno) {
+        opj_tcd_tilecomp_t *l_tilec = &p_tile->comps[compno];
+        for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
+            opj_tcd_resolution_t *l_res = &l_tilec->resolutions[resno];
+            l_res_precincts[compno * OPJ_J2K_MAXRLVLS + resno] = l_nb_precincts;
+            if (l_res->pw * l_res->ph > UINT_MAX - l_nb_precincts) {
+                goto cleanup;
+            }
+            l_nb_precincts += l_res->pw * l_res->ph;
+        }
+    }
+
+    /* Locate the packets, and check that they match the PLT markers */
+    l_pi = opj_pi_create_decode(l_image, l_cp, p_tile_no, &l_manager);
+    if (!l_pi) {
+        goto cleanup;
+    }
+    for (pino = 0, l_current_pi = l_pi; pino < l_nb_pocs; ++pino, ++l_current_pi) {
+        if (l_current_pi->poc.prg == OPJ_PROG_UNKNOWN) {
+            goto cleanup;
+        }
+        while (opj_pi_next(l_current_pi)) {
+            opj_t2_located_packet_t *l_packet = &l_packets[l_nb_packets];
+            opj_tcd_tilecomp_t *l_tilec = &p_tile->comps[l_current_pi->compno];
+            OPJ_UINT32 l_length;
+
+            if (l_nb_packets == l_tcp->m_nb_packet_lengths) {
+                goto cleanup;
+            }
+            l_length = l_tcp->m_packet_lengths[l_nb_packets];
+            if (l_length > p_max_len - l_offset ||
+                    l_current_pi->resno >= l_tilec->numresolutions ||
+                    l_current_pi->precno >= l_tilec->resolutions[l_current_pi->resno].pw *
+                    l_tilec->resolutions[l_current_pi->resno].ph) {
+                goto cleanup;
+            }
+            l_packet->pino = pino;
+            l_packet->compno = l_current_pi->compno;
+            l_packet->resno = l_current_pi->resno;
+            l_packet->precno = l_current_pi->precno;
+            l_packet->layno = l_current_pi->layno;
+            l_packet->precinct = l_res_precincts[l_packet->compno * OPJ_J2K_MAXRLVLS +
+                                                 l_packet->resno] + l_packet->precno;
+            l_packet->offset = l_offset;
+            l_packet->length = l_length;
+            l_packet->skip = opj_t2_is_packet_skipped(tcd, l_tcp, p_tile, l_current_pi);
+            l_offset += l_length;
+            ++l_nb_packets;
+        }
+    }
+    if (l_nb_packets != l_tcp->m_nb_packet_lengths) {
+        goto cleanup;
+    }
+
+    /* Sort the packets by precinct, keeping the codestream order of the */
+    /* packets of each precinct */
+    l_counts = (OPJ_UINT32*)opj_calloc((OPJ_SIZE_T)l_nb_precincts + 1,
+                                       sizeof(OPJ_UINT32));
+    if (!l_counts) {
+        goto cleanup;
+    }
+    for (i = 0; i < l_nb_packets; ++i) {
+        ++l_counts[l_packets[i].precinct + 1];
+    }
+    for (i = 0; i < l_nb_precincts; ++i) {
+        l_counts[i + 1] += l_counts[i];
+    }
+    for (i = 0; i < l_nb_packets; ++i) {
+        l_order[l_counts[l_packets[i].precinct]++] = i;
+    }
+    /* l_counts[i] is now the end of the packets of precinct i in l_order */
+
+    /* Submit jobs of whole precincts, about 4 per thread */
+    l_ret = OPJ_TRUE;
+    l_job_size = l_nb_packets / (4U * (OPJ_UINT32)opj_thread_pool_get_thread_count(
+                                     tp)) + 1U;
+    l_first = 0;
+    for (i = 0; i < l_nb_precincts && l_first < l_nb_packets; ++i) {
+        opj_t2_decode_packets_job_t* job;
+
+        if (l_counts[i] - l_first < l_job_size && l_counts[i] != l_nb_packets) {
+            continue;
+        }
+        job = (opj_t2_decode_packets_job_t*) opj_calloc(1,
+                sizeof(opj_t2_decode_packets_job_t));
+        if (!job) {
+            l_ret = OPJ_FALSE;
+            break;
+        }
+        job->t2 = p_t2;
+        job->tile = p_tile;
+        job->tcp = l_tcp;
+        job->packets = l_packets;
+        job->order = l_order;
+        job->first = l_first;
+        job->last = l_counts[i];
+        job->src = p_src;
+        job->max_len = p_max_len;
+        job->p_manager = &l_manager;
+        job->pret = &l_ret;
+        opj_thread_pool_submit_job(tp, opj_t2_decode_packets_processor, job);
+        l_first = l_counts[i];
+    }
+    opj_thread_pool_wait_completion(tp, 0);
+
+    if (!l_ret) {
+        opj_t2_reset_cblks(p_tile);
+        goto cleanup;
+    }
+
+    /* Same update of the number of decoded resolutions as in */
+    /* opj_t2_decode_packets() */
+    for (i = 0; i < l_nb_packets; ++i) {
+        const opj_t2_located_packet_t *l_packet = &l_packets[i];
+        opj_image_comp_t* l_img_comp = &(l_image->comps[l_packet->compno]);
+
+        if (i == 0 || l_packet->pino != l_packets[i - 1].pino) {
+            memset(l_first_pass_failed, OPJ_TRUE, l_image->numcomps * sizeof(OPJ_BOOL));
+        }
+        if (!l_packet->skip) {
+            l_first_pass_failed[l_packet->compno] = OPJ_FALSE;
+            l_img_comp->resno_decoded = opj_uint_max(l_packet->resno,
+                                        l_img_comp->resno_decoded);
+        }
+        if (l_first_pass_failed[l_packet->compno] && l_img_comp->resno_decoded == 0) {
+            l_img_comp->resno_decoded =
+                p_tile->comps[l_packet->compno].minimum_num_resolutions - 1;
+        }
+    }
+    *p_data_read = l_offset;
+
+cleanup:
+    if (l_pi) {
+        opj_pi_destroy(l_pi, l_nb_pocs);
+    }
+    opj_free(l_res_precincts);
+    opj_free(l_packets);
+    opj_free(l_order);
+    opj_free(l_counts);
+    opj_free(l_first_pass_failed);
+    return l_ret;
+}
+
 OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
                                opj_t2_t *p_t2,
                                OPJ_UINT32 p_tile_no,
@@ -415,6 +851,10 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
 #endif
     opj_packet_info_t *l_pack_info = 00;
     opj_image_comp_t* l_img_comp = 00;
+    OPJ_BOOL l_truncated = OPJ_FALSE;
+    /* In non strict mode, a truncated tile is decoded up to its last packet */
+    OPJ_BOOL* l_truncated_ptr = l_cp->m_specific_param.m_dec.m_allow_truncated ?
+                                &l_truncated : 00;
 
     OPJ_ARG_NOT_USED(p_cstr_index);
 
@@ -424,6 +864,11 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
     }
 #endif
 
+    if (opj_t2_decode_packets_mt(tcd, p_t2, p_tile_no, p_tile, p_src,
+                                 p_data_read, p_max_len)) {
+        return OPJ_TRUE;
+    }
+
     /* create a packet iterator */
     l_pi = opj_pi_create_decode(l_image, l_cp, p_tile_no, p_manager);
     if (!l_pi) {
@@ -456,52 +901,13 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
         memset(first_pass_failed, OPJ_TRUE, l_image->numcomps * sizeof(OPJ_BOOL));
 
         while (opj_pi_next(l_current_pi)) {
-            OPJ_BOOL skip_packet = OPJ_FALSE;
+            OPJ_BOOL skip_packet;
             JAS_FPRINTF(stderr,
                         "packet offset=00000166 prg=%d cmptno=%02d rlvlno=%02d prcno=%03d lyrno=%02d\n\n",
                         l_current_pi->poc.prg1, l_current_pi->compno, l_current_pi->resno,
                         l_current_pi->precno, l_current_pi->layno);
 
-            /* If the packet layer is greater or equal than the maximum */
-            /* number of layers, skip the packet */
-            if (l_current_pi->layno >= l_tcp->num_layers_to_decode) {
-                skip_packet = OPJ_TRUE;
-            }
-            /* If the packet resolution number is greater than the minimum */
-            /* number of resolution allowed, skip the packet */
-            else if (l_current_pi->resno >=
-                     p_tile->comps[l_current_pi->compno].minimum_num_resolutions) {
-                skip_packet = OPJ_TRUE;
-            } else {
-                /* If no precincts of any band intersects the area of interest, */
-                /* skip the packet */
-                OPJ_UINT32 bandno;
-                opj_tcd_tilecomp_t *tilec = &p_tile->comps[l_current_pi->compno];
-                opj_tcd_resolution_t *res = &tilec->resolutions[l_current_pi->resno];
-
-                skip_packet = OPJ_TRUE;
-                for (bandno = 0; bandno < res->numbands; ++bandno) {
-                    opj_tcd_band_t* band = &res->bands[bandno];
-                    opj_tcd_precinct_t* prec = &band->precincts[l_current_pi->precno];
-
-                    if (opj_tcd_is_subband_area_of_interest(tcd,
-                                                            l_current_pi->compno,
-                                                            l_current_pi->resno,
-                                                            band->bandno,
-                                                            (OPJ_UINT32)prec->x0,
-                                                            (OPJ_UINT32)prec->y0,
-                                                            (OPJ_UINT32)prec->x1,
-                                                            (OPJ_UINT32)prec->y1)) {
-                        skip_packet = OPJ_FALSE;
-                        break;
-                    }
-                }
-                /*
-                                printf("packet cmptno=%02d rlvlno=%02d prcno=%03d lyrno=%02d -> %s\n",
-                                    l_current_pi->compno, l_current_pi->resno,
-                                    l_current_pi->precno, l_current_pi->layno, skip_packet ? "skipped" : "kept");
-                */
-            }
+            skip_packet = opj_t2_is_packet_skipped(tcd, l_tcp, p_tile, l_current_pi);
 
             if (!skip_packet) {
                 l_nb_bytes_read = 0;
@@ -509,11 +915,15 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
                 first_pass_failed[l_current_pi->compno] = OPJ_FALSE;
 
                 if (! opj_t2_decode_packet(p_t2, p_tile, l_tcp, l_current_pi, l_current_data,
-                                           &l_nb_bytes_read, p_max_len, l_pack_info, p_manager)) {
+                                           &l_nb_bytes_read, p_max_len, l_pack_info, l_truncated_ptr,
+                                           p_manager)) {
                     opj_pi_destroy(l_pi, l_nb_pocs);
                     opj_free(first_pass_failed);
                     return OPJ_FALSE;
                 }
+                if (l_truncated) {
+                    break;
+                }
 
                 l_img_comp = &(l_image->comps[l_current_pi->compno]);
                 l_img_comp->resno_decoded = opj_uint_max(l_current_pi->resno,
@@ -521,11 +931,15 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
             } else {
                 l_nb_bytes_read = 0;
                 if (! opj_t2_skip_packet(p_t2, p_tile, l_tcp, l_current_pi, l_current_data,
-                                         &l_nb_bytes_read, p_max_len, l_pack_info, p_manager)) {
+                                         &l_nb_bytes_read, p_max_len, l_pack_info, l_truncated_ptr,
+                                         p_manager)) {
                     opj_pi_destroy(l_pi, l_nb_pocs);
                     opj_free(first_pass_failed);
                     return OPJ_FALSE;
                 }
+                if (l_truncated) {
+                    break;
+                }
             }
 
             if (first_pass_failed[l_current_pi->compno]) {
@@ -571,6 +985,22 @@ OPJ_BOOL opj_t2_decode_packets(opj_tcd_t* tcd,
         ++l_current_pi;
 
         opj_free(first_pass_failed);
+        if (l_truncated) {
+            break;
+        }
+    }
+
+    if (l_truncated) {
+        OPJ_UINT32 compno;
+        opj_event_msg(p_manager, EVT_WARNING,
+                      "Tile %u is truncated, only its first packets are decoded\n",
+                      p_tile_no);
+        /* The missing packets are decoded as empty, at the resolution */
+        /* that the complete tile would have */
+        for (compno = 0; compno < l_image->numcomps; ++compno) {
+            l_image->comps[compno].resno_decoded =
+                p_tile->comps[compno].minimum_num_resolutions - 1;
+        }
     }
     /* INDEX >> */
 #ifdef TODO_MSD
@@ -614,10 +1044,123 @@ opj_t2_t* opj_t2_create(opj_image_t *p_image, opj_cp_t *p_cp)
 void opj_t2_destroy(opj_t2_t *t2)
 {
     if (t2) {
+        opj_free(t2->precinct_state);
         opj_free(t2);
     }
 }
 
+/** Number of words of a tag tree in the state of a precinct */
+static OPJ_SIZE_T opj_t2_tgt_state_size(const opj_tgt_tree_t* p_tree)
+{
+    return p_tree ? 3U * (OPJ_SIZE_T)p_tree->numnodes : 0U;
+}
+
+static OPJ_UINT32* opj_t2_save_tgt_state(const opj_tgt_tree_t* p_tree,
+        OPJ_UINT32* p_state)
+{
+    OPJ_UINT32 i;
+    if (p_tree) {
+        for (i = 0; i < p_tree->numnodes; ++i) {
+            *p_state++ = (OPJ_UINT32)p_tree->nodes[i].value;
+            *p_state++ = (OPJ_UINT32)p_tree->nodes[i].low;
+            *p_state++ = p_tree->nodes[i].known;
+        }
+    }
+    return p_state;
+}
+
+static const OPJ_UINT32* opj_t2_restore_tgt_state(opj_tgt_tree_t* p_tree,
+        const OPJ_UINT32* p_state)
+{
+    OPJ_UINT32 i;
+    if (p_tree) {
+        for (i = 0; i < p_tree->numnodes; ++i) {
+            p_tree->nodes[i].value = (OPJ_INT32)*p_state++;
+            p_tree->nodes[i].low = (OPJ_INT32)*p_state++;
+            p_tree->nodes[i].known = *p_state++;
+        }
+    }
+    return p_state;
+}
+
+static OPJ_BOOL opj_t2_save_precinct_state(opj_t2_t* p_t2,
+        opj_tcd_resolution_t* p_res,
+        OPJ_UINT32 p_precno)
+{
+    OPJ_SIZE_T l_size = 0;
+    OPJ_UINT32 bandno, cblkno;
+    OPJ_UINT32* l_state;
+
+    for (bandno = 0; bandno < p_res->numbands; ++bandno) {
+        opj_tcd_band_t* l_band = &p_res->bands[bandno];
+        const opj_tcd_precinct_t* l_prc;
+        if (opj_tcd_is_band_empty(l_band)) {
+            continue;
+        }
+        l_prc = &l_band->precincts[p_precno];
+        l_size += 4U * (OPJ_SIZE_T)l_prc->cw * l_prc->ch +
+                  opj_t2_tgt_state_size(l_prc->incltree) +
+                  opj_t2_tgt_state_size(l_prc->imsbtree);
+    }
+    if (l_size > p_t2->precinct_state_size) {
+        OPJ_UINT32* l_new_state = (OPJ_UINT32*) opj_realloc(p_t2->precinct_state,
+                                  l_size * sizeof(OPJ_UINT32));
+        if (!l_new_state) {
+            return OPJ_FALSE;
+        }
+        p_t2->precinct_state = l_new_state;
+        p_t2->precinct_state_size = l_size;
+    }
+
+    l_state = p_t2->precinct_state;
+    for (bandno = 0; bandno < p_res->numbands; ++bandno) {
+        opj_tcd_band_t* l_band = &p_res->bands[bandno];
+        const opj_tcd_precinct_t* l_prc;
+        const opj_tcd_cblk_dec_t* l_cblk;
+        if (opj_tcd_is_band_empty(l_band)) {
+            continue;
+        }
+        l_prc = &l_band->precincts[p_precno];
+        l_cblk = l_prc->cblks.dec;
+        for (cblkno = 0; cblkno < l_prc->cw * l_prc->ch; ++cblkno, ++l_cblk) {
+            *l_state++ = l_cblk->numsegs;
+            *l_state++ = l_cblk->numlenbits;
+            *l_state++ = l_cblk->numbps;
+            *l_state++ = l_cblk->numnewpasses;
+        }
+        l_state = opj_t2_save_tgt_state(l_prc->incltree, l_state);
+        l_state = opj_t2_save_tgt_state(l_prc->imsbtree, l_state);
+    }
+    return OPJ_TRUE;
+}
+
+static void opj_t2_restore_precinct_state(const opj_t2_t* p_t2,
+        opj_tcd_resolution_t* p_res,
+        OPJ_UINT32 p_precno)
+{
+    const OPJ_UINT32* l_state = p_t2->precinct_state;
+    OPJ_UINT32 bandno, cblkno;
+
+    for (bandno = 0; bandno < p_res->numbands; ++bandno) {
+        opj_tcd_band_t* l_band = &p_res->bands[bandno];
+        opj_tcd_precinct_t* l_prc;
+        opj_tcd_cblk_dec_t* l_cblk;
+        if (opj_tcd_is_band_empty(l_band)) {
+            continue;
+        }
+        l_prc = &l_band->precincts[p_precno];
+        l_cblk = l_prc->cblks.dec;
+        for (cblkno = 0; cblkno < l_prc->cw * l_prc->ch; ++cblkno, ++l_cblk) {
+            l_cblk->numsegs = *l_state++;
+            l_cblk->numlenbits = *l_state++;
+            l_cblk->numbps = *l_state++;
+            l_cblk->numnewpasses = *l_state++;
+        }
+        l_state = opj_t2_restore_tgt_state(l_prc->incltree, l_state);
+        l_state = opj_t2_restore_tgt_state(l_prc->imsbtree, l_state);
+    }
+}
+
 static OPJ_BOOL opj_t2_decode_packet(opj_t2_t* p_t2,
                                      opj_tcd_tile_t *p_tile,
                                      opj_tcp_t *p_tcp,
@@ -626,6 +1169,7 @@ static OPJ_BOOL opj_t2_decode_packet(opj_t2_t* p_t2,
                                      OPJ_UINT32 * p_data_read,
                                      OPJ_UINT32 p_max_length,
                                      opj_packet_info_t *p_pack_info,
+                                     OPJ_BOOL *p_truncated,
                                      opj_event_mgr_t *p_manager)
 {
     OPJ_BOOL l_read_data;
@@ -635,7 +1179,8 @@ static OPJ_BOOL opj_t2_decode_packet(opj_t2_t* p_t2,
     *p_data_read = 0;
 
     if (! opj_t2_read_packet_header(p_t2, p_tile, p_tcp, p_pi, &l_read_data, p_src,
-                                    &l_nb_bytes_read, p_max_length, p_pack_info, p_manager)) {
+                                    &l_nb_bytes_read, p_max_length, p_pack_info, p_truncated,
+                                    p_manager)) {
         return OPJ_FALSE;
     }
 
@@ -648,7 +1193,7 @@ static OPJ_BOOL opj_t2_decode_packet(opj_t2_t* p_t2,
         l_nb_bytes_read = 0;
 
         if (! opj_t2_read_packet_data(p_t2, p_tile, p_pi, p_src, &l_nb_bytes_read,
-                                      p_max_length, p_pack_info, p_manager)) {
+                                      p_max_length, p_pack_info, p_truncated, p_manager)) {
             return OPJ_FALSE;
         }
 
@@ -1012,6 +1557,7 @@ static OPJ_BOOL opj_t2_skip_packet(opj_t2_t* p_t2,
                                    OPJ_UINT32 * p_data_read,
                                    OPJ_UINT32 p_max_length,
                                    opj_packet_info_t *p_pack_info,
+                                   OPJ_BOOL *p_truncated,
                                    opj_event_mgr_t *p_manager)
 {
     OPJ_BOOL l_read_data;
@@ -1021,7 +1567,8 @@ static OPJ_BOOL opj_t2_skip_packet(opj_t2_t* p_t2,
     *p_data_read = 0;
 
     if (! opj_t2_read_packet_header(p_t2, p_tile, p_tcp, p_pi, &l_read_data, p_src,
-                                    &l_nb_bytes_read, p_max_length, p_pack_info, p_manager)) {
+                                    &l_nb_bytes_read, p_max_length, p_pack_info, p_truncated,
+                                    p_manager)) {
         return OPJ_FALSE;
     }
 
@@ -1034,7 +1581,7 @@ static OPJ_BOOL opj_t2_skip_packet(opj_t2_t* p_t2,
         l_nb_bytes_read = 0;
 
         if (! opj_t2_skip_packet_data(p_t2, p_tile, p_pi, &l_nb_bytes_read,
-                                      p_max_length, p_pack_info, p_manager)) {
+                                      p_max_length, p_pack_info, p_truncated, p_manager)) {
             return OPJ_FALSE;
         }
 
@@ -1055,6 +1602,7 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
         OPJ_UINT32 * p_data_read,
         OPJ_UINT32 p_max_length,
         opj_packet_info_t *p_pack_info,
+        OPJ_BOOL *p_truncated,
         opj_event_mgr_t *p_manager)
 
 {
@@ -1152,8 +1700,15 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
 
     opj_bio_init_dec(l_bio, l_header_data, *l_modified_length_ptr);
 
-    l_present = opj_bio_read(l_bio, 1);
+    l_present = opj_bio_read_bit(l_bio);
     JAS_FPRINTF(stderr, "present=%d \n", l_present);
+    if (p_truncated && opj_bio_past_end(l_bio)) {
+        opj_bio_destroy(l_bio);
+        *p_truncated = OPJ_TRUE;
+        *p_is_data_present = OPJ_FALSE;
+        *p_data_read = 0;
+        return OPJ_TRUE;
+    }
     if (!l_present) {
         /* TODO MSD: no test to control the output of this function*/
         opj_bio_inalign(l_bio);
@@ -1190,6 +1745,16 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
         return OPJ_TRUE;
     }
 
+    /* In non strict mode, the header may be truncated: keep the state it */
+    /* updates, to restore it in that case */
+    if (p_truncated &&
+            !opj_t2_save_precinct_state(p_t2, l_res, p_pi->precno)) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Not enough memory to save the state of a precinct\n");
+        opj_bio_destroy(l_bio);
+        return OPJ_FALSE;
+    }
+
     l_band = l_res->bands;
     for (bandno = 0; bandno < l_res->numbands; ++bandno, ++l_band) {
         opj_tcd_precinct_t *l_prc = &(l_band->precincts[p_pi->precno]);
@@ -1210,7 +1775,7 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
                                             (OPJ_INT32)(p_pi->layno + 1));
                 /* else one bit */
             } else {
-                l_included = opj_bio_read(l_bio, 1);
+                l_included = opj_bio_read_bit(l_bio);
             }
 
             /* if cblk not included */
@@ -1291,6 +1856,19 @@ static OPJ_BOOL opj_t2_read_packet_header(opj_t2_t* p_t2,
         }
     }
 
+    if (p_truncated && opj_bio_past_end(l_bio)) {
+        /* The partial header has already updated the number of segments, */
+        /* of length bits and of bit-planes of code-blocks, and the tag */
+        /* trees: restore them, so that the packet header can be read again */
+        /* once complete, and that no segment is added from it */
+        opj_t2_restore_precinct_state(p_t2, l_res, p_pi->precno);
+        opj_bio_destroy(l_bio);
+        *p_truncated = OPJ_TRUE;
+        *p_is_data_present = OPJ_FALSE;
+        *p_data_read = 0;
+        return OPJ_TRUE;
+    }
+
     if (!opj_bio_inalign(l_bio)) {
         opj_bio_destroy(l_bio);
         return OPJ_FALSE;
@@ -1339,6 +1917,7 @@ static OPJ_BOOL opj_t2_read_packet_data(opj_t2_t* p_t2,
                                         OPJ_UINT32 * p_data_read,
                                         OPJ_UINT32 p_max_length,
                                         opj_packet_info_t *pack_info,
+                                        OPJ_BOOL *p_truncated,
                                         opj_event_mgr_t* p_manager)
 {
     OPJ_UINT32 bandno, cblkno;
@@ -1390,6 +1969,14 @@ static OPJ_BOOL opj_t2_read_packet_data(opj_t2_t* p_t2,
                 if ((((OPJ_SIZE_T)l_current_data + (OPJ_SIZE_T)l_seg->newlen) <
                         (OPJ_SIZE_T)l_current_data) ||
                         (l_current_data + l_seg->newlen > p_src_data + p_max_length)) {
+                    if (p_truncated) {
+                        /* Only keep the segments whose data is complete */
+                        l_cblk->real_num_segs = (OPJ_UINT32)(l_seg - l_cblk->segs) +
+                                                (l_seg->real_num_passes ? 1U : 0U);
+                        *p_truncated = OPJ_TRUE;
+                        *(p_data_read) = (OPJ_UINT32)(l_current_data - p_src_data);
+                        return OPJ_TRUE;
+                    }
                     opj_event_msg(p_manager, EVT_ERROR,
                                   "read: segment too long (%d) with max (%d) for codeblock %d (p=%d, b=%d, r=%d, c=%d)\n",
                                   l_seg->newlen, p_max_length, cblkno, p_pi->precno, bandno, p_pi->resno,
@@ -1468,6 +2055,7 @@ static OPJ_BOOL opj_t2_skip_packet_data(opj_t2_t* p_t2,
                                         OPJ_UINT32 * p_data_read,
                                         OPJ_UINT32 p_max_length,
                                         opj_packet_info_t *pack_info,
+                                        OPJ_BOOL *p_truncated,
                                         opj_event_mgr_t *p_manager)
 {
     OPJ_UINT32 bandno, cblkno;
@@ -1519,6 +2107,10 @@ static OPJ_BOOL opj_t2_skip_packet_data(opj_t2_t* p_t2,
                 /* Check possible overflow then size */
                 if (((*p_data_read + l_seg->newlen) < (*p_data_read)) ||
                         ((*p_data_read + l_seg->newlen) > p_max_length)) {
+                    if (p_truncated) {
+                        *p_truncated = OPJ_TRUE;
+                        return OPJ_TRUE;
+                    }
                     opj_event_msg(p_manager, EVT_ERROR,
                                   "skip: segment too long (%d) with max (%d) for codeblock %d (p=%d, b=%d, r=%d, c=%d)\n",
                                   l_seg->newlen, p_max_length, cblkno, p_pi->precno, bandno, p_pi->resno,
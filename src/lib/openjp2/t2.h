@@ -57,6 +57,11 @@ typedef struct opj_t2 {
     opj_image_t *image;
     /** pointer to the image coding parameters */
     opj_cp_t *cp;
+    /** Decoding, non strict mode: state of the code-blocks and tag trees of
+     * the precinct whose packet header is read, restored if the header is
+     * truncated (see opj_t2_save_precinct_state()) */
+    OPJ_UINT32 *precinct_state;
+    OPJ_SIZE_T precinct_state_size;
 } opj_t2_t;
 
 /** @name Exported functions */
@@ -132,12 +132,6 @@ static void opj_tcd_code_block_dec_deallocate(opj_tcd_precinct_t * p_precinct);
 static OPJ_BOOL opj_tcd_code_block_enc_allocate(opj_tcd_cblk_enc_t *
         p_code_block);
 
-/**
- * Allocates data for an encoding code block
- */
-static OPJ_BOOL opj_tcd_code_block_enc_allocate_data(opj_tcd_cblk_enc_t *
-        p_code_block);
-
 /**
  * Deallocates the encoding data of the given precinct.
  */
@@ -161,6 +155,19 @@ static OPJ_BOOL opj_tcd_t2_decode(opj_tcd_t *p_tcd,
 static OPJ_BOOL opj_tcd_t1_decode(opj_tcd_t *p_tcd,
                                   opj_event_mgr_t *p_manager);
 
+/**
+Processing of a tile component by a stage of the tile pipeline.
+@param p_tcd TCD handle
+@param compno Index of the tile component
+@param tp Thread pool over which the processing may be split, or NULL to
+run it in the calling thread
+*/
+typedef OPJ_BOOL(*opj_tcd_comp_fn)(opj_tcd_t *p_tcd, OPJ_UINT32 compno,
+                                   opj_thread_pool_t* tp);
+
+static OPJ_BOOL opj_tcd_run_per_component(opj_tcd_t *p_tcd,
+        opj_tcd_comp_fn p_fn);
+
 static OPJ_BOOL opj_tcd_dwt_decode(opj_tcd_t *p_tcd);
 
 static OPJ_BOOL opj_tcd_mct_decode(opj_tcd_t *p_tcd,
@@ -177,6 +184,11 @@ static OPJ_BOOL opj_tcd_dwt_encode(opj_tcd_t *p_tcd);
 
 static OPJ_BOOL opj_tcd_t1_encode(opj_tcd_t *p_tcd);
 
+static OPJ_BOOL opj_tcd_end_encode_tile_lines(opj_tcd_t *p_tcd,
+        opj_event_mgr_t *p_manager);
+
+static void opj_tcd_line_encoder_destroy(opj_tcd_line_encoder_t* p_encoder);
+
 static OPJ_BOOL opj_tcd_t2_encode(opj_tcd_t *p_tcd,
                                   OPJ_BYTE * p_dest_data,
                                   OPJ_UINT32 * p_data_written,
@@ -197,6 +209,87 @@ static OPJ_BOOL opj_tcd_is_whole_tilecomp_decoding(opj_tcd_t *tcd,
 
 /* ----------------------------------------------------------------------- */
 
+typedef struct {
+    opj_tcd_t* tcd;
+    opj_tcd_comp_fn fn;
+    OPJ_UINT32 compno;
+    volatile OPJ_BOOL* pret;
+} opj_tcd_comp_job_t;
+
+static void opj_tcd_comp_job_func(void* user_data, opj_tls_t* tls)
+{
+    opj_tcd_comp_job_t* job = (opj_tcd_comp_job_t*) user_data;
+
+    (void)tls;
+    if (*(job->pret) && !job->fn(job->tcd, job->compno, NULL)) {
+        *(job->pret) = OPJ_FALSE;
+    }
+}
+
+/**
+Runs a stage of the tile pipeline on each tile component to process.
+
+When there are at least as many components as threads, the components are
+processed concurrently, one job per component, so that the stage has a
+single synchronization point. Otherwise they are processed in turn, each
+one being split across the threads, which keeps all of them busy.
+*/
+static OPJ_BOOL opj_tcd_run_per_component(opj_tcd_t *p_tcd,
+        opj_tcd_comp_fn p_fn)
+{
+    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+    opj_thread_pool_t* tp = p_tcd->thread_pool;
+    const int num_threads = opj_thread_pool_get_thread_count(tp);
+    OPJ_UINT32 compno, l_nb_comps = 0;
+
+    for (compno = 0; compno < l_tile->numcomps; ++compno) {
+        if (p_tcd->used_component != NULL && !p_tcd->used_component[compno]) {
+            continue;
+        }
+        ++l_nb_comps;
+    }
+
+    if (num_threads > 1 && l_nb_comps > 1 &&
+            l_nb_comps >= (OPJ_UINT32)num_threads) {
+        opj_tcd_comp_job_t* l_jobs = (opj_tcd_comp_job_t*) opj_malloc(
+                                         l_nb_comps * sizeof(opj_tcd_comp_job_t));
+        if (l_jobs) {
+            volatile OPJ_BOOL ret = OPJ_TRUE;
+            OPJ_UINT32 l_nb_jobs = 0;
+
+            for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                opj_tcd_comp_job_t* l_job;
+                if (p_tcd->used_component != NULL && !p_tcd->used_component[compno]) {
+                    continue;
+                }
+                l_job = &l_jobs[l_nb_jobs ++];
+                l_job->tcd = p_tcd;
+                l_job->fn = p_fn;
+                l_job->compno = compno;
+                l_job->pret = &ret;
+                if (!opj_thread_pool_submit_job(tp, opj_tcd_comp_job_func, l_job)) {
+                    ret = OPJ_FALSE;
+                    break;
+                }
+            }
+            opj_thread_pool_wait_completion(tp, 0);
+            opj_free(l_jobs);
+            return ret;
+        }
+        /* Otherwise process the components in turn */
+    }
+
+    for (compno = 0; compno < l_tile->numcomps; ++compno) {
+        if (p_tcd->used_component != NULL && !p_tcd->used_component[compno]) {
+            continue;
+        }
+        if (!p_fn(p_tcd, compno, tp)) {
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
 /**
 Create a new TCD handle
 */
@@ -676,6 +769,7 @@ Destroy a previously created TCD handle
 void opj_tcd_destroy(opj_tcd_t *tcd)
 {
     if (tcd) {
+        opj_tcd_line_encoder_destroy(tcd->line_encoder);
         opj_tcd_free_tile(tcd);
 
         if (tcd->tcd_image) {
@@ -684,6 +778,7 @@ void opj_tcd_destroy(opj_tcd_t *tcd)
         }
 
         opj_free(tcd->used_component);
+        opj_t1_destroy_decode_jobs(tcd->t1_decode_jobs);
 
         opj_free(tcd);
     }
@@ -720,6 +815,295 @@ OPJ_BOOL opj_alloc_tile_component_data(opj_tcd_tilecomp_t *l_tilec)
 
 /* ----------------------------------------------------------------------- */
 
+/**
+ * Partition of a resolution into precincts and code-blocks, in the
+ * coordinates of its sub-bands, see opj_tcd_init_res_partition()
+ */
+typedef struct opj_tcd_res_partition {
+    /** top left corner of the first precinct */
+    OPJ_INT32 cbg_x_start, cbg_y_start;
+    /** log2 of the width and height of the precincts */
+    OPJ_UINT32 cbgw_expn, cbgh_expn;
+    /** log2 of the width and height of the code-blocks */
+    OPJ_UINT32 cblkw_expn, cblkh_expn;
+} opj_tcd_res_partition_t;
+
+/**
+ * Computes the bounds of a tile on the reference grid.
+ *
+ * @param p_cp      Coding parameters.
+ * @param p_image   Image header.
+ * @param p_tile_no Index of the tile.
+ * @param p_tile    Tile whose x0, y0, x1 and y1 are set.
+ * @param p_manager Event manager, may be NULL.
+ * @return OPJ_FALSE if the bounds do not fit in the tile coordinates
+ */
+static OPJ_BOOL opj_tcd_init_tile_bounds(const opj_cp_t *p_cp,
+        const opj_image_t *p_image,
+        OPJ_UINT32 p_tile_no,
+        opj_tcd_tile_t *p_tile,
+        opj_event_mgr_t *p_manager)
+{
+    OPJ_UINT32 p = p_tile_no % p_cp->tw;       /* tile coordinates */
+    OPJ_UINT32 q = p_tile_no / p_cp->tw;
+    OPJ_UINT32 l_tx0, l_ty0;
+
+    /* 4 borders of the tile rescale on the image if necessary */
+    l_tx0 = p_cp->tx0 + p *
+            p_cp->tdx; /* can't be greater than p_image->x1 so won't overflow */
+    p_tile->x0 = (OPJ_INT32)opj_uint_max(l_tx0, p_image->x0);
+    p_tile->x1 = (OPJ_INT32)opj_uint_min(opj_uint_adds(l_tx0, p_cp->tdx),
+                                         p_image->x1);
+    /* all those OPJ_UINT32 are casted to OPJ_INT32, let's do some sanity check */
+    if ((p_tile->x0 < 0) || (p_tile->x1 <= p_tile->x0)) {
+        opj_event_msg(p_manager, EVT_ERROR, "Tile X coordinates are not supported\n");
+        return OPJ_FALSE;
+    }
+    l_ty0 = p_cp->ty0 + q *
+            p_cp->tdy; /* can't be greater than p_image->y1 so won't overflow */
+    p_tile->y0 = (OPJ_INT32)opj_uint_max(l_ty0, p_image->y0);
+    p_tile->y1 = (OPJ_INT32)opj_uint_min(opj_uint_adds(l_ty0, p_cp->tdy),
+                                         p_image->y1);
+    /* all those OPJ_UINT32 are casted to OPJ_INT32, let's do some sanity check */
+    if ((p_tile->y0 < 0) || (p_tile->y1 <= p_tile->y0)) {
+        opj_event_msg(p_manager, EVT_ERROR, "Tile Y coordinates are not supported\n");
+        return OPJ_FALSE;
+    }
+    return OPJ_TRUE;
+}
+
+/**
+ * Computes the bounds of a tile-component, from those of its tile.
+ */
+static void opj_tcd_init_tilecomp_bounds(const opj_tcd_tile_t *p_tile,
+        const opj_image_comp_t *p_image_comp,
+        opj_tcd_tilecomp_t *p_tilec)
+{
+    /* border of each tile component (global) */
+    p_tilec->x0 = opj_int_ceildiv(p_tile->x0, (OPJ_INT32)p_image_comp->dx);
+    p_tilec->y0 = opj_int_ceildiv(p_tile->y0, (OPJ_INT32)p_image_comp->dy);
+    p_tilec->x1 = opj_int_ceildiv(p_tile->x1, (OPJ_INT32)p_image_comp->dx);
+    p_tilec->y1 = opj_int_ceildiv(p_tile->y1, (OPJ_INT32)p_image_comp->dy);
+}
+
+/**
+ * Computes the bounds of a resolution of a tile-component, whose bounds and
+ * numresolutions are set.
+ */
+static void opj_tcd_init_res_bounds(const opj_tcd_tilecomp_t *p_tilec,
+                                    OPJ_UINT32 p_resno,
+                                    opj_tcd_resolution_t *p_res)
+{
+    OPJ_UINT32 l_level_no = p_tilec->numresolutions - 1 - p_resno;
+
+    /* border for each resolution level (global) */
+    p_res->x0 = opj_int_ceildivpow2(p_tilec->x0, (OPJ_INT32)l_level_no);
+    p_res->y0 = opj_int_ceildivpow2(p_tilec->y0, (OPJ_INT32)l_level_no);
+    p_res->x1 = opj_int_ceildivpow2(p_tilec->x1, (OPJ_INT32)l_level_no);
+    p_res->y1 = opj_int_ceildivpow2(p_tilec->y1, (OPJ_INT32)l_level_no);
+}
+
+/**
+ * Computes the number of precincts and sub-bands of a resolution, whose
+ * bounds are set, and its partition into precincts and code-blocks.
+ *
+ * @param p_tccp    Coding parameters of the tile-component.
+ * @param p_resno   Resolution number.
+ * @param p_res     Resolution whose pw, ph and numbands are set.
+ * @param p_part    Partition of the resolution.
+ * @param p_manager Event manager, may be NULL.
+ * @return OPJ_FALSE if the precincts exceed the integer ranges
+ */
+static OPJ_BOOL opj_tcd_init_res_partition(const opj_tccp_t *p_tccp,
+        OPJ_UINT32 p_resno,
+        opj_tcd_resolution_t *p_res,
+        opj_tcd_res_partition_t *p_part,
+        opj_event_mgr_t *p_manager)
+{
+    /* p. 35, table A-23, ISO/IEC FDIS154444-1 : 2000 (18 august 2000) */
+    OPJ_UINT32 l_pdx = p_tccp->prcw[p_resno];
+    OPJ_UINT32 l_pdy = p_tccp->prch[p_resno];
+    /* extent of precincts , top left, bottom right**/
+    OPJ_INT32 l_tl_prc_x_start, l_tl_prc_y_start, l_br_prc_x_end, l_br_prc_y_end;
+
+    /* p. 64, B.6, ISO/IEC FDIS15444-1 : 2000 (18 august 2000)  */
+    l_tl_prc_x_start = opj_int_floordivpow2(p_res->x0, (OPJ_INT32)l_pdx) << l_pdx;
+    l_tl_prc_y_start = opj_int_floordivpow2(p_res->y0, (OPJ_INT32)l_pdy) << l_pdy;
+    {
+        OPJ_UINT32 tmp = ((OPJ_UINT32)opj_int_ceildivpow2(p_res->x1,
+                          (OPJ_INT32)l_pdx)) << l_pdx;
+        if (tmp > (OPJ_UINT32)INT_MAX) {
+            opj_event_msg(p_manager, EVT_ERROR, "Integer overflow\n");
+            return OPJ_FALSE;
+        }
+        l_br_prc_x_end = (OPJ_INT32)tmp;
+    }
+    {
+        OPJ_UINT32 tmp = ((OPJ_UINT32)opj_int_ceildivpow2(p_res->y1,
+                          (OPJ_INT32)l_pdy)) << l_pdy;
+        if (tmp > (OPJ_UINT32)INT_MAX) {
+            opj_event_msg(p_manager, EVT_ERROR, "Integer overflow\n");
+            return OPJ_FALSE;
+        }
+        l_br_prc_y_end = (OPJ_INT32)tmp;
+    }
+    /*fprintf(stderr, "\t\t\tprc_x_start=%d, prc_y_start=%d, br_prc_x_end=%d, br_prc_y_end=%d \n", l_tl_prc_x_start, l_tl_prc_y_start, l_br_prc_x_end ,l_br_prc_y_end );*/
+
+    p_res->pw = (p_res->x0 == p_res->x1) ? 0U : (OPJ_UINT32)((
+                    l_br_prc_x_end - l_tl_prc_x_start) >> l_pdx);
+    p_res->ph = (p_res->y0 == p_res->y1) ? 0U : (OPJ_UINT32)((
+                    l_br_prc_y_end - l_tl_prc_y_start) >> l_pdy);
+    /*fprintf(stderr, "\t\t\tres_pw=%d, res_ph=%d\n", p_res->pw, p_res->ph );*/
+
+    if ((p_res->pw != 0U) && ((((OPJ_UINT32) - 1) / p_res->pw) < p_res->ph)) {
+        opj_event_msg(p_manager, EVT_ERROR, "Size of tile data exceeds system limits\n");
+        return OPJ_FALSE;
+    }
+
+    if (p_resno == 0) {
+        p_part->cbg_x_start = l_tl_prc_x_start;
+        p_part->cbg_y_start = l_tl_prc_y_start;
+        p_part->cbgw_expn = l_pdx;
+        p_part->cbgh_expn = l_pdy;
+        p_res->numbands = 1;
+    } else {
+        p_part->cbg_x_start = opj_int_ceildivpow2(l_tl_prc_x_start, 1);
+        p_part->cbg_y_start = opj_int_ceildivpow2(l_tl_prc_y_start, 1);
+        p_part->cbgw_expn = l_pdx - 1;
+        p_part->cbgh_expn = l_pdy - 1;
+        p_res->numbands = 3;
+    }
+
+    p_part->cblkw_expn = opj_uint_min(p_tccp->cblkw, p_part->cbgw_expn);
+    p_part->cblkh_expn = opj_uint_min(p_tccp->cblkh, p_part->cbgh_expn);
+    return OPJ_TRUE;
+}
+
+/**
+ * Computes the bounds and the band number of a sub-band.
+ *
+ * @param p_tilec   Tile-component, whose bounds and numresolutions are set.
+ * @param p_resno   Resolution number.
+ * @param p_bandno  Index of the sub-band in the resolution.
+ * @param p_band    Sub-band whose bandno, x0, y0, x1 and y1 are set.
+ */
+static void opj_tcd_init_band_bounds(const opj_tcd_tilecomp_t *p_tilec,
+                                     OPJ_UINT32 p_resno,
+                                     OPJ_UINT32 p_bandno,
+                                     opj_tcd_band_t *p_band)
+{
+    OPJ_UINT32 l_level_no = p_tilec->numresolutions - 1 - p_resno;
+
+    if (p_resno == 0) {
+        p_band->bandno = 0 ;
+        p_band->x0 = opj_int_ceildivpow2(p_tilec->x0, (OPJ_INT32)l_level_no);
+        p_band->y0 = opj_int_ceildivpow2(p_tilec->y0, (OPJ_INT32)l_level_no);
+        p_band->x1 = opj_int_ceildivpow2(p_tilec->x1, (OPJ_INT32)l_level_no);
+        p_band->y1 = opj_int_ceildivpow2(p_tilec->y1, (OPJ_INT32)l_level_no);
+    } else {
+        OPJ_INT32 l_x0b, l_y0b;
+
+        p_band->bandno = p_bandno + 1;
+        /* x0b = 1 if bandno = 1 or 3 */
+        l_x0b = p_band->bandno & 1;
+        /* y0b = 1 if bandno = 2 or 3 */
+        l_y0b = (OPJ_INT32)((p_band->bandno) >> 1);
+        /* band border (global) */
+        p_band->x0 = opj_int64_ceildivpow2(p_tilec->x0 - ((OPJ_INT64)l_x0b <<
+                                           l_level_no), (OPJ_INT32)(l_level_no + 1));
+        p_band->y0 = opj_int64_ceildivpow2(p_tilec->y0 - ((OPJ_INT64)l_y0b <<
+                                           l_level_no), (OPJ_INT32)(l_level_no + 1));
+        p_band->x1 = opj_int64_ceildivpow2(p_tilec->x1 - ((OPJ_INT64)l_x0b <<
+                                           l_level_no), (OPJ_INT32)(l_level_no + 1));
+        p_band->y1 = opj_int64_ceildivpow2(p_tilec->y1 - ((OPJ_INT64)l_y0b <<
+                                           l_level_no), (OPJ_INT32)(l_level_no + 1));
+    }
+}
+
+/**
+ * Computes the bounds of a precinct of a sub-band, and its number of
+ * code-blocks.
+ *
+ * @param p_res         Resolution, whose pw is set.
+ * @param p_part        Partition of the resolution.
+ * @param p_band        Sub-band, whose bounds are set.
+ * @param p_precno      Index of the precinct.
+ * @param p_prc         Precinct whose x0, y0, x1, y1, cw and ch are set.
+ * @param p_tl_cblk_x   Left of the first code-block of the precinct.
+ * @param p_tl_cblk_y   Top of the first code-block of the precinct.
+ */
+static void opj_tcd_init_precinct_bounds(const opj_tcd_resolution_t *p_res,
+        const opj_tcd_res_partition_t *p_part,
+        const opj_tcd_band_t *p_band,
+        OPJ_UINT32 p_precno,
+        opj_tcd_precinct_t *p_prc,
+        OPJ_INT32 *p_tl_cblk_x,
+        OPJ_INT32 *p_tl_cblk_y)
+{
+    OPJ_INT32 brcblkxend, brcblkyend;
+    OPJ_INT32 cbgxstart = p_part->cbg_x_start + (OPJ_INT32)(p_precno % p_res->pw) *
+                          (1 << p_part->cbgw_expn);
+    OPJ_INT32 cbgystart = p_part->cbg_y_start + (OPJ_INT32)(p_precno / p_res->pw) *
+                          (1 << p_part->cbgh_expn);
+    OPJ_INT32 cbgxend = cbgxstart + (1 << p_part->cbgw_expn);
+    OPJ_INT32 cbgyend = cbgystart + (1 << p_part->cbgh_expn);
+
+    /* precinct size (global) */
+    p_prc->x0 = opj_int_max(cbgxstart, p_band->x0);
+    p_prc->y0 = opj_int_max(cbgystart, p_band->y0);
+    p_prc->x1 = opj_int_min(cbgxend, p_band->x1);
+    p_prc->y1 = opj_int_min(cbgyend, p_band->y1);
+    /*fprintf(stderr, "\t prc_x0=%d; prc_y0=%d, prc_x1=%d; prc_y1=%d\n",p_prc->x0, p_prc->y0 ,p_prc->x1, p_prc->y1);*/
+
+    *p_tl_cblk_x = opj_int_floordivpow2(p_prc->x0,
+                                        (OPJ_INT32)p_part->cblkw_expn) << p_part->cblkw_expn;
+    *p_tl_cblk_y = opj_int_floordivpow2(p_prc->y0,
+                                        (OPJ_INT32)p_part->cblkh_expn) << p_part->cblkh_expn;
+    brcblkxend = opj_int_ceildivpow2(p_prc->x1,
+                                     (OPJ_INT32)p_part->cblkw_expn) << p_part->cblkw_expn;
+    brcblkyend = opj_int_ceildivpow2(p_prc->y1,
+                                     (OPJ_INT32)p_part->cblkh_expn) << p_part->cblkh_expn;
+    p_prc->cw = (OPJ_UINT32)((brcblkxend - *p_tl_cblk_x) >> p_part->cblkw_expn);
+    p_prc->ch = (OPJ_UINT32)((brcblkyend - *p_tl_cblk_y) >> p_part->cblkh_expn);
+}
+
+/**
+ * Computes the bounds of a code-block of a precinct.
+ *
+ * @param p_prc         Precinct, whose bounds and cw are set.
+ * @param p_part        Partition of the resolution.
+ * @param p_tl_cblk_x   Left of the first code-block of the precinct.
+ * @param p_tl_cblk_y   Top of the first code-block of the precinct.
+ * @param p_cblkno      Index of the code-block in the precinct.
+ * @param p_x0          Left of the code-block.
+ * @param p_y0          Top of the code-block.
+ * @param p_x1          Right of the code-block.
+ * @param p_y1          Bottom of the code-block.
+ */
+static void opj_tcd_get_cblk_bounds(const opj_tcd_precinct_t *p_prc,
+                                    const opj_tcd_res_partition_t *p_part,
+                                    OPJ_INT32 p_tl_cblk_x,
+                                    OPJ_INT32 p_tl_cblk_y,
+                                    OPJ_UINT32 p_cblkno,
+                                    OPJ_INT32 *p_x0, OPJ_INT32 *p_y0,
+                                    OPJ_INT32 *p_x1, OPJ_INT32 *p_y1)
+{
+    OPJ_INT32 cblkxstart = p_tl_cblk_x + (OPJ_INT32)(p_cblkno % p_prc->cw) *
+                           (1 << p_part->cblkw_expn);
+    OPJ_INT32 cblkystart = p_tl_cblk_y + (OPJ_INT32)(p_cblkno / p_prc->cw) *
+                           (1 << p_part->cblkh_expn);
+    OPJ_INT32 cblkxend = cblkxstart + (1 << p_part->cblkw_expn);
+    OPJ_INT32 cblkyend = cblkystart + (1 << p_part->cblkh_expn);
+
+    /* code-block size (global) */
+    *p_x0 = opj_int_max(cblkxstart, p_prc->x0);
+    *p_y0 = opj_int_max(cblkystart, p_prc->y0);
+    *p_x1 = opj_int_min(cblkxend, p_prc->x1);
+    *p_y1 = opj_int_min(cblkyend, p_prc->y1);
+}
+
+/* ----------------------------------------------------------------------- */
+
 static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
         OPJ_BOOL isEncoder, OPJ_SIZE_T sizeof_block,
         opj_event_mgr_t* manager)
@@ -735,14 +1119,6 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
     opj_tcd_band_t *l_band = 00;
     opj_stepsize_t * l_step_size = 00;
     opj_tcd_precinct_t *l_current_precinct = 00;
-    opj_image_t *l_image = 00;
-    OPJ_UINT32 p, q;
-    OPJ_UINT32 l_level_no;
-    OPJ_UINT32 l_pdx, l_pdy;
-    OPJ_INT32 l_x0b, l_y0b;
-    OPJ_UINT32 l_tx0, l_ty0;
-    /* extent of precincts , top left, bottom right**/
-    OPJ_INT32 l_tl_prc_x_start, l_tl_prc_y_start, l_br_prc_x_end, l_br_prc_y_end;
     /* number of precinct for a resolution */
     OPJ_UINT32 l_nb_precincts;
     /* room needed to store l_nb_precinct precinct for a resolution */
@@ -759,35 +1135,12 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
     l_tile = p_tcd->tcd_image->tiles;
     l_tccp = l_tcp->tccps;
     l_tilec = l_tile->comps;
-    l_image = p_tcd->image;
     l_image_comp = p_tcd->image->comps;
 
-    p = p_tile_no % l_cp->tw;       /* tile coordinates */
-    q = p_tile_no / l_cp->tw;
-    /*fprintf(stderr, "Tile coordinate = %d,%d\n", p, q);*/
-
-    /* 4 borders of the tile rescale on the image if necessary */
-    l_tx0 = l_cp->tx0 + p *
-            l_cp->tdx; /* can't be greater than l_image->x1 so won't overflow */
-    l_tile->x0 = (OPJ_INT32)opj_uint_max(l_tx0, l_image->x0);
-    l_tile->x1 = (OPJ_INT32)opj_uint_min(opj_uint_adds(l_tx0, l_cp->tdx),
-                                         l_image->x1);
-    /* all those OPJ_UINT32 are casted to OPJ_INT32, let's do some sanity check */
-    if ((l_tile->x0 < 0) || (l_tile->x1 <= l_tile->x0)) {
-        opj_event_msg(manager, EVT_ERROR, "Tile X coordinates are not supported\n");
+    if (!opj_tcd_init_tile_bounds(l_cp, p_tcd->image, p_tile_no, l_tile,
+                                  manager)) {
         return OPJ_FALSE;
     }
-    l_ty0 = l_cp->ty0 + q *
-            l_cp->tdy; /* can't be greater than l_image->y1 so won't overflow */
-    l_tile->y0 = (OPJ_INT32)opj_uint_max(l_ty0, l_image->y0);
-    l_tile->y1 = (OPJ_INT32)opj_uint_min(opj_uint_adds(l_ty0, l_cp->tdy),
-                                         l_image->y1);
-    /* all those OPJ_UINT32 are casted to OPJ_INT32, let's do some sanity check */
-    if ((l_tile->y0 < 0) || (l_tile->y1 <= l_tile->y0)) {
-        opj_event_msg(manager, EVT_ERROR, "Tile Y coordinates are not supported\n");
-        return OPJ_FALSE;
-    }
-
 
     /* testcase 1888.pdf.asan.35.988 */
     if (l_tccp->numresolutions == 0) {
@@ -800,11 +1153,7 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
     for (compno = 0; compno < l_tile->numcomps; ++compno) {
         /*fprintf(stderr, "compno = %d/%d\n", compno, l_tile->numcomps);*/
         l_image_comp->resno_decoded = 0;
-        /* border of each l_tile component (global) */
-        l_tilec->x0 = opj_int_ceildiv(l_tile->x0, (OPJ_INT32)l_image_comp->dx);
-        l_tilec->y0 = opj_int_ceildiv(l_tile->y0, (OPJ_INT32)l_image_comp->dy);
-        l_tilec->x1 = opj_int_ceildiv(l_tile->x1, (OPJ_INT32)l_image_comp->dx);
-        l_tilec->y1 = opj_int_ceildiv(l_tile->y1, (OPJ_INT32)l_image_comp->dy);
+        opj_tcd_init_tilecomp_bounds(l_tile, l_image_comp, l_tilec);
         l_tilec->compno = compno;
         /*fprintf(stderr, "\tTile compo border = %d,%d,%d,%d\n", l_tilec->x0, l_tilec->y0,l_tilec->x1,l_tilec->y1);*/
 
@@ -874,61 +1223,16 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
             l_tilec->resolutions_size = l_data_size;
         }
 
-        l_level_no = l_tilec->numresolutions;
         l_res = l_tilec->resolutions;
         l_step_size = l_tccp->stepsizes;
-        /*fprintf(stderr, "\tlevel_no=%d\n",l_level_no);*/
 
         for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
             /*fprintf(stderr, "\t\tresno = %d/%d\n", resno, l_tilec->numresolutions);*/
-            OPJ_INT32 tlcbgxstart, tlcbgystart /*, brcbgxend, brcbgyend*/;
-            OPJ_UINT32 cbgwidthexpn, cbgheightexpn;
-            OPJ_UINT32 cblkwidthexpn, cblkheightexpn;
-
-            --l_level_no;
-
-            /* border for each resolution level (global) */
-            l_res->x0 = opj_int_ceildivpow2(l_tilec->x0, (OPJ_INT32)l_level_no);
-            l_res->y0 = opj_int_ceildivpow2(l_tilec->y0, (OPJ_INT32)l_level_no);
-            l_res->x1 = opj_int_ceildivpow2(l_tilec->x1, (OPJ_INT32)l_level_no);
-            l_res->y1 = opj_int_ceildivpow2(l_tilec->y1, (OPJ_INT32)l_level_no);
+            opj_tcd_res_partition_t l_part;
 
+            opj_tcd_init_res_bounds(l_tilec, resno, l_res);
             /*fprintf(stderr, "\t\t\tres_x0= %d, res_y0 =%d, res_x1=%d, res_y1=%d\n", l_res->x0, l_res->y0, l_res->x1, l_res->y1);*/
-            /* p. 35, table A-23, ISO/IEC FDIS154444-1 : 2000 (18 august 2000) */
-            l_pdx = l_tccp->prcw[resno];
-            l_pdy = l_tccp->prch[resno];
-            /*fprintf(stderr, "\t\t\tpdx=%d, pdy=%d\n", l_pdx, l_pdy);*/
-            /* p. 64, B.6, ISO/IEC FDIS15444-1 : 2000 (18 august 2000)  */
-            l_tl_prc_x_start = opj_int_floordivpow2(l_res->x0, (OPJ_INT32)l_pdx) << l_pdx;
-            l_tl_prc_y_start = opj_int_floordivpow2(l_res->y0, (OPJ_INT32)l_pdy) << l_pdy;
-            {
-                OPJ_UINT32 tmp = ((OPJ_UINT32)opj_int_ceildivpow2(l_res->x1,
-                                  (OPJ_INT32)l_pdx)) << l_pdx;
-                if (tmp > (OPJ_UINT32)INT_MAX) {
-                    opj_event_msg(manager, EVT_ERROR, "Integer overflow\n");
-                    return OPJ_FALSE;
-                }
-                l_br_prc_x_end = (OPJ_INT32)tmp;
-            }
-            {
-                OPJ_UINT32 tmp = ((OPJ_UINT32)opj_int_ceildivpow2(l_res->y1,
-                                  (OPJ_INT32)l_pdy)) << l_pdy;
-                if (tmp > (OPJ_UINT32)INT_MAX) {
-                    opj_event_msg(manager, EVT_ERROR, "Integer overflow\n");
-                    return OPJ_FALSE;
-                }
-                l_br_prc_y_end = (OPJ_INT32)tmp;
-            }
-            /*fprintf(stderr, "\t\t\tprc_x_start=%d, prc_y_start=%d, br_prc_x_end=%d, br_prc_y_end=%d \n", l_tl_prc_x_start, l_tl_prc_y_start, l_br_prc_x_end ,l_br_prc_y_end );*/
-
-            l_res->pw = (l_res->x0 == l_res->x1) ? 0U : (OPJ_UINT32)((
-                            l_br_prc_x_end - l_tl_prc_x_start) >> l_pdx);
-            l_res->ph = (l_res->y0 == l_res->y1) ? 0U : (OPJ_UINT32)((
-                            l_br_prc_y_end - l_tl_prc_y_start) >> l_pdy);
-            /*fprintf(stderr, "\t\t\tres_pw=%d, res_ph=%d\n", l_res->pw, l_res->ph );*/
-
-            if ((l_res->pw != 0U) && ((((OPJ_UINT32) - 1) / l_res->pw) < l_res->ph)) {
-                opj_event_msg(manager, EVT_ERROR, "Size of tile data exceeds system limits\n");
+            if (!opj_tcd_init_res_partition(l_tccp, resno, l_res, &l_part, manager)) {
                 return OPJ_FALSE;
             }
             l_nb_precincts = l_res->pw * l_res->ph;
@@ -940,53 +1244,12 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
             }
             l_nb_precinct_size = l_nb_precincts * (OPJ_UINT32)sizeof(opj_tcd_precinct_t);
 
-            if (resno == 0) {
-                tlcbgxstart = l_tl_prc_x_start;
-                tlcbgystart = l_tl_prc_y_start;
-                /*brcbgxend = l_br_prc_x_end;*/
-                /* brcbgyend = l_br_prc_y_end;*/
-                cbgwidthexpn = l_pdx;
-                cbgheightexpn = l_pdy;
-                l_res->numbands = 1;
-            } else {
-                tlcbgxstart = opj_int_ceildivpow2(l_tl_prc_x_start, 1);
-                tlcbgystart = opj_int_ceildivpow2(l_tl_prc_y_start, 1);
-                /*brcbgxend = opj_int_ceildivpow2(l_br_prc_x_end, 1);*/
-                /*brcbgyend = opj_int_ceildivpow2(l_br_prc_y_end, 1);*/
-                cbgwidthexpn = l_pdx - 1;
-                cbgheightexpn = l_pdy - 1;
-                l_res->numbands = 3;
-            }
-
-            cblkwidthexpn = opj_uint_min(l_tccp->cblkw, cbgwidthexpn);
-            cblkheightexpn = opj_uint_min(l_tccp->cblkh, cbgheightexpn);
             l_band = l_res->bands;
 
             for (bandno = 0; bandno < l_res->numbands; ++bandno, ++l_band, ++l_step_size) {
                 /*fprintf(stderr, "\t\t\tband_no=%d/%d\n", bandno, l_res->numbands );*/
 
-                if (resno == 0) {
-                    l_band->bandno = 0 ;
-                    l_band->x0 = opj_int_ceildivpow2(l_tilec->x0, (OPJ_INT32)l_level_no);
-                    l_band->y0 = opj_int_ceildivpow2(l_tilec->y0, (OPJ_INT32)l_level_no);
-                    l_band->x1 = opj_int_ceildivpow2(l_tilec->x1, (OPJ_INT32)l_level_no);
-                    l_band->y1 = opj_int_ceildivpow2(l_tilec->y1, (OPJ_INT32)l_level_no);
-                } else {
-                    l_band->bandno = bandno + 1;
-                    /* x0b = 1 if bandno = 1 or 3 */
-                    l_x0b = l_band->bandno & 1;
-                    /* y0b = 1 if bandno = 2 or 3 */
-                    l_y0b = (OPJ_INT32)((l_band->bandno) >> 1);
-                    /* l_band border (global) */
-                    l_band->x0 = opj_int64_ceildivpow2(l_tilec->x0 - ((OPJ_INT64)l_x0b <<
-                                                       l_level_no), (OPJ_INT32)(l_level_no + 1));
-                    l_band->y0 = opj_int64_ceildivpow2(l_tilec->y0 - ((OPJ_INT64)l_y0b <<
-                                                       l_level_no), (OPJ_INT32)(l_level_no + 1));
-                    l_band->x1 = opj_int64_ceildivpow2(l_tilec->x1 - ((OPJ_INT64)l_x0b <<
-                                                       l_level_no), (OPJ_INT32)(l_level_no + 1));
-                    l_band->y1 = opj_int64_ceildivpow2(l_tilec->y1 - ((OPJ_INT64)l_y0b <<
-                                                       l_level_no), (OPJ_INT32)(l_level_no + 1));
-                }
+                opj_tcd_init_band_bounds(l_tilec, resno, bandno, l_band);
 
                 if (isEncoder) {
                     /* Skip empty bands */
@@ -1053,41 +1316,10 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 
                 l_current_precinct = l_band->precincts;
                 for (precno = 0; precno < l_nb_precincts; ++precno) {
-                    OPJ_INT32 tlcblkxstart, tlcblkystart, brcblkxend, brcblkyend;
-                    OPJ_INT32 cbgxstart = tlcbgxstart + (OPJ_INT32)(precno % l_res->pw) *
-                                          (1 << cbgwidthexpn);
-                    OPJ_INT32 cbgystart = tlcbgystart + (OPJ_INT32)(precno / l_res->pw) *
-                                          (1 << cbgheightexpn);
-                    OPJ_INT32 cbgxend = cbgxstart + (1 << cbgwidthexpn);
-                    OPJ_INT32 cbgyend = cbgystart + (1 << cbgheightexpn);
-                    /*fprintf(stderr, "\t precno=%d; bandno=%d, resno=%d; compno=%d\n", precno, bandno , resno, compno);*/
-                    /*fprintf(stderr, "\t tlcbgxstart(=%d) + (precno(=%d) percent res->pw(=%d)) * (1 << cbgwidthexpn(=%d)) \n",tlcbgxstart,precno,l_res->pw,cbgwidthexpn);*/
-
-                    /* precinct size (global) */
-                    /*fprintf(stderr, "\t cbgxstart=%d, l_band->x0 = %d \n",cbgxstart, l_band->x0);*/
-
-                    l_current_precinct->x0 = opj_int_max(cbgxstart, l_band->x0);
-                    l_current_precinct->y0 = opj_int_max(cbgystart, l_band->y0);
-                    l_current_precinct->x1 = opj_int_min(cbgxend, l_band->x1);
-                    l_current_precinct->y1 = opj_int_min(cbgyend, l_band->y1);
-                    /*fprintf(stderr, "\t prc_x0=%d; prc_y0=%d, prc_x1=%d; prc_y1=%d\n",l_current_precinct->x0, l_current_precinct->y0 ,l_current_precinct->x1, l_current_precinct->y1);*/
-
-                    tlcblkxstart = opj_int_floordivpow2(l_current_precinct->x0,
-                                                        (OPJ_INT32)cblkwidthexpn) << cblkwidthexpn;
-                    /*fprintf(stderr, "\t tlcblkxstart =%d\n",tlcblkxstart );*/
-                    tlcblkystart = opj_int_floordivpow2(l_current_precinct->y0,
-                                                        (OPJ_INT32)cblkheightexpn) << cblkheightexpn;
-                    /*fprintf(stderr, "\t tlcblkystart =%d\n",tlcblkystart );*/
-                    brcblkxend = opj_int_ceildivpow2(l_current_precinct->x1,
-                                                     (OPJ_INT32)cblkwidthexpn) << cblkwidthexpn;
-                    /*fprintf(stderr, "\t brcblkxend =%d\n",brcblkxend );*/
-                    brcblkyend = opj_int_ceildivpow2(l_current_precinct->y1,
-                                                     (OPJ_INT32)cblkheightexpn) << cblkheightexpn;
-                    /*fprintf(stderr, "\t brcblkyend =%d\n",brcblkyend );*/
-                    l_current_precinct->cw = (OPJ_UINT32)((brcblkxend - tlcblkxstart) >>
-                                                          cblkwidthexpn);
-                    l_current_precinct->ch = (OPJ_UINT32)((brcblkyend - tlcblkystart) >>
-                                                          cblkheightexpn);
+                    OPJ_INT32 tlcblkxstart, tlcblkystart;
+
+                    opj_tcd_init_precinct_bounds(l_res, &l_part, l_band, precno,
+                                                 l_current_precinct, &tlcblkxstart, &tlcblkystart);
 
                     l_nb_code_blocks = l_current_precinct->cw * l_current_precinct->ch;
                     /*fprintf(stderr, "\t\t\t\t precinct_cw = %d x recinct_ch = %d\n",l_current_precinct->cw, l_current_precinct->ch);      */
@@ -1148,39 +1380,28 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
                     }
 
                     for (cblkno = 0; cblkno < l_nb_code_blocks; ++cblkno) {
-                        OPJ_INT32 cblkxstart = tlcblkxstart + (OPJ_INT32)(cblkno %
-                                               l_current_precinct->cw) * (1 << cblkwidthexpn);
-                        OPJ_INT32 cblkystart = tlcblkystart + (OPJ_INT32)(cblkno /
-                                               l_current_precinct->cw) * (1 << cblkheightexpn);
-                        OPJ_INT32 cblkxend = cblkxstart + (1 << cblkwidthexpn);
-                        OPJ_INT32 cblkyend = cblkystart + (1 << cblkheightexpn);
-
                         if (isEncoder) {
                             opj_tcd_cblk_enc_t* l_code_block = l_current_precinct->cblks.enc + cblkno;
 
                             if (! opj_tcd_code_block_enc_allocate(l_code_block)) {
                                 return OPJ_FALSE;
                             }
-                            /* code-block size (global) */
-                            l_code_block->x0 = opj_int_max(cblkxstart, l_current_precinct->x0);
-                            l_code_block->y0 = opj_int_max(cblkystart, l_current_precinct->y0);
-                            l_code_block->x1 = opj_int_min(cblkxend, l_current_precinct->x1);
-                            l_code_block->y1 = opj_int_min(cblkyend, l_current_precinct->y1);
-
-                            if (! opj_tcd_code_block_enc_allocate_data(l_code_block)) {
-                                return OPJ_FALSE;
-                            }
+                            opj_tcd_get_cblk_bounds(l_current_precinct, &l_part,
+                                                    tlcblkxstart, tlcblkystart, cblkno,
+                                                    &l_code_block->x0, &l_code_block->y0,
+                                                    &l_code_block->x1, &l_code_block->y1);
+                            /* data is allocated by the T1 encoder, right */
+                            /* before encoding the code-block */
                         } else {
                             opj_tcd_cblk_dec_t* l_code_block = l_current_precinct->cblks.dec + cblkno;
 
                             if (! opj_tcd_code_block_dec_allocate(l_code_block)) {
                                 return OPJ_FALSE;
                             }
-                            /* code-block size (global) */
-                            l_code_block->x0 = opj_int_max(cblkxstart, l_current_precinct->x0);
-                            l_code_block->y0 = opj_int_max(cblkystart, l_current_precinct->y0);
-                            l_code_block->x1 = opj_int_min(cblkxend, l_current_precinct->x1);
-                            l_code_block->y1 = opj_int_min(cblkyend, l_current_precinct->y1);
+                            opj_tcd_get_cblk_bounds(l_current_precinct, &l_part,
+                                                    tlcblkxstart, tlcblkystart, cblkno,
+                                                    &l_code_block->x0, &l_code_block->y0,
+                                                    &l_code_block->x1, &l_code_block->y1);
                         }
                     }
                     ++l_current_precinct;
@@ -1198,6 +1419,9 @@ static INLINE OPJ_BOOL opj_tcd_init_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
 OPJ_BOOL opj_tcd_init_encode_tile(opj_tcd_t *p_tcd, OPJ_UINT32 p_tile_no,
                                   opj_event_mgr_t* p_manager)
 {
+    /* Whatever the way the samples of the previous tile were read, those */
+    /* of this one are not DC level shifted yet */
+    p_tcd->dc_level_shift_done = OPJ_FALSE;
     return opj_tcd_init_tile(p_tcd, p_tile_no, OPJ_TRUE,
                              sizeof(opj_tcd_cblk_enc_t), p_manager);
 }
@@ -1233,10 +1457,7 @@ static OPJ_BOOL opj_tcd_code_block_enc_allocate(opj_tcd_cblk_enc_t *
     return OPJ_TRUE;
 }
 
-/**
- * Allocates data memory for an encoding code block.
- */
-static OPJ_BOOL opj_tcd_code_block_enc_allocate_data(opj_tcd_cblk_enc_t *
+OPJ_BOOL opj_tcd_code_block_enc_allocate_data(opj_tcd_cblk_enc_t *
         p_code_block)
 {
     OPJ_UINT32 l_data_size;
@@ -1276,6 +1497,26 @@ static OPJ_BOOL opj_tcd_code_block_enc_allocate_data(opj_tcd_cblk_enc_t *
     return OPJ_TRUE;
 }
 
+void opj_tcd_code_block_enc_shrink_data(opj_tcd_cblk_enc_t * p_code_block)
+{
+    OPJ_UINT32 l_data_size = 0;
+    OPJ_UINT32 passno;
+    OPJ_BYTE * l_data;
+
+    for (passno = 0; passno < p_code_block->totalpasses; ++passno) {
+        l_data_size = opj_uint_max(l_data_size, p_code_block->passes[passno].rate);
+    }
+    if (p_code_block->data == 00 || l_data_size >= p_code_block->data_size) {
+        return;
+    }
+    /* A failure to shrink leaves the current buffer valid */
+    l_data = (OPJ_BYTE *) opj_realloc(p_code_block->data - 1, l_data_size + 1);
+    if (l_data) {
+        p_code_block->data = l_data + 1;
+        p_code_block->data_size = l_data_size;
+    }
+}
+
 
 void opj_tcd_reinit_segment(opj_tcd_seg_t* seg)
 {
@@ -1422,37 +1663,46 @@ OPJ_BOOL opj_tcd_encode_tile(opj_tcd_t *p_tcd,
         }
         /* << INDEX */
 
-        /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
-        /*---------------TILE-------------------*/
-        if (! opj_tcd_dc_level_shift_encode(p_tcd)) {
-            return OPJ_FALSE;
-        }
-        /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
+        if (p_tcd->line_encoder) {
+            /* DC level shift, MCT, DWT and T1 were done as lines arrived */
+            if (! opj_tcd_end_encode_tile_lines(p_tcd, p_manager)) {
+                return OPJ_FALSE;
+            }
+        } else {
+            OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
+            /*---------------TILE-------------------*/
+            /* Unless already done while reading interleaved input */
+            if (! p_tcd->dc_level_shift_done &&
+                    ! opj_tcd_dc_level_shift_encode(p_tcd)) {
+                return OPJ_FALSE;
+            }
+            OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
 
-        /* FIXME _ProfStart(PGROUP_MCT); */
-        if (! opj_tcd_mct_encode(p_tcd)) {
-            return OPJ_FALSE;
-        }
-        /* FIXME _ProfStop(PGROUP_MCT); */
+            OPJ_PERF_START(OPJ_PERF_STAGE_MCT);
+            if (! opj_tcd_mct_encode(p_tcd)) {
+                return OPJ_FALSE;
+            }
+            OPJ_PERF_STOP(OPJ_PERF_STAGE_MCT);
 
-        /* FIXME _ProfStart(PGROUP_DWT); */
-        if (! opj_tcd_dwt_encode(p_tcd)) {
-            return OPJ_FALSE;
-        }
-        /* FIXME  _ProfStop(PGROUP_DWT); */
+            OPJ_PERF_START(OPJ_PERF_STAGE_DWT);
+            if (! opj_tcd_dwt_encode(p_tcd)) {
+                return OPJ_FALSE;
+            }
+            OPJ_PERF_STOP(OPJ_PERF_STAGE_DWT);
 
-        /* FIXME  _ProfStart(PGROUP_T1); */
-        if (! opj_tcd_t1_encode(p_tcd)) {
-            return OPJ_FALSE;
+            OPJ_PERF_START(OPJ_PERF_STAGE_T1);
+            if (! opj_tcd_t1_encode(p_tcd)) {
+                return OPJ_FALSE;
+            }
+            OPJ_PERF_STOP(OPJ_PERF_STAGE_T1);
         }
-        /* FIXME _ProfStop(PGROUP_T1); */
 
-        /* FIXME _ProfStart(PGROUP_RATE); */
+        OPJ_PERF_START(OPJ_PERF_STAGE_RATE);
         if (! opj_tcd_rate_allocate_encode(p_tcd, p_dest, p_max_length,
                                            p_cstr_info, p_manager)) {
             return OPJ_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_RATE); */
+        OPJ_PERF_STOP(OPJ_PERF_STAGE_RATE);
 
     }
     /*--------------TIER2------------------*/
@@ -1461,13 +1711,13 @@ OPJ_BOOL opj_tcd_encode_tile(opj_tcd_t *p_tcd,
     if (p_cstr_info) {
         p_cstr_info->index_write = 1;
     }
-    /* FIXME _ProfStart(PGROUP_T2); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_T2);
 
     if (! opj_tcd_t2_encode(p_tcd, p_dest, p_data_written, p_max_length,
                             p_cstr_info, p_marker_info, p_manager)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_T2); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_T2);
 
     /*---------------CLEAN-------------------*/
 
@@ -1640,21 +1890,21 @@ OPJ_BOOL opj_tcd_decode_tile(opj_tcd_t *p_tcd,
 #endif
 
     /*--------------TIER2------------------*/
-    /* FIXME _ProfStart(PGROUP_T2); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_T2);
     l_data_read = 0;
     if (! opj_tcd_t2_decode(p_tcd, p_src, &l_data_read, p_max_length, p_cstr_index,
                             p_manager)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_T2); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_T2);
 
     /*------------------TIER1-----------------*/
 
-    /* FIXME _ProfStart(PGROUP_T1); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_T1);
     if (! opj_tcd_t1_decode(p_tcd, p_manager)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_T1); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_T1);
 
 
     /* For subtile decoding, now we know the resno_decoded, we can allocate */
@@ -1701,27 +1951,27 @@ OPJ_BOOL opj_tcd_decode_tile(opj_tcd_t *p_tcd,
 
     /*----------------DWT---------------------*/
 
-    /* FIXME _ProfStart(PGROUP_DWT); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_DWT);
     if
     (! opj_tcd_dwt_decode(p_tcd)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_DWT); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_DWT);
 
     /*----------------MCT-------------------*/
-    /* FIXME _ProfStart(PGROUP_MCT); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_MCT);
     if
     (! opj_tcd_mct_decode(p_tcd, p_manager)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_MCT); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_MCT);
 
-    /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
+    OPJ_PERF_START(OPJ_PERF_STAGE_OUTPUT);
     if
     (! opj_tcd_dc_level_shift_decode(p_tcd)) {
         return OPJ_FALSE;
     }
-    /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
+    OPJ_PERF_STOP(OPJ_PERF_STAGE_OUTPUT);
 
 
     /*---------------TILE-------------------*/
@@ -2004,7 +2254,7 @@ static OPJ_BOOL opj_tcd_t1_decode(opj_tcd_t *p_tcd, opj_event_mgr_t *p_manager)
         }
     }
 
-    opj_thread_pool_wait_completion(p_tcd->thread_pool, 0);
+    opj_t1_run_decode_jobs(p_tcd);
     if (p_manager_mutex) {
         opj_mutex_destroy(p_manager_mutex);
     }
@@ -2012,35 +2262,24 @@ static OPJ_BOOL opj_tcd_t1_decode(opj_tcd_t *p_tcd, opj_event_mgr_t *p_manager)
 }
 
 
-static OPJ_BOOL opj_tcd_dwt_decode(opj_tcd_t *p_tcd)
+static OPJ_BOOL opj_tcd_dwt_decode_comp(opj_tcd_t *p_tcd, OPJ_UINT32 compno,
+                                        opj_thread_pool_t* tp)
 {
-    OPJ_UINT32 compno;
-    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
-    opj_tcd_tilecomp_t * l_tile_comp = l_tile->comps;
-    opj_tccp_t * l_tccp = p_tcd->tcp->tccps;
-    opj_image_comp_t * l_img_comp = p_tcd->image->comps;
-
-    for (compno = 0; compno < l_tile->numcomps;
-            compno++, ++l_tile_comp, ++l_img_comp, ++l_tccp) {
-        if (p_tcd->used_component != NULL && !p_tcd->used_component[compno]) {
-            continue;
-        }
-
-        if (l_tccp->qmfbid == 1) {
-            if (! opj_dwt_decode(p_tcd, l_tile_comp,
-                                 l_img_comp->resno_decoded + 1)) {
-                return OPJ_FALSE;
-            }
-        } else {
-            if (! opj_dwt_decode_real(p_tcd, l_tile_comp,
-                                      l_img_comp->resno_decoded + 1)) {
-                return OPJ_FALSE;
-            }
-        }
+    opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps + compno;
+    opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
+    opj_image_comp_t * l_img_comp = p_tcd->image->comps + compno;
 
+    if (l_tccp->qmfbid == 1) {
+        return opj_dwt_decode(p_tcd, tp, l_tile_comp,
+                              l_img_comp->resno_decoded + 1);
     }
+    return opj_dwt_decode_real(p_tcd, tp, l_tile_comp,
+                               l_img_comp->resno_decoded + 1);
+}
 
-    return OPJ_TRUE;
+static OPJ_BOOL opj_tcd_dwt_decode(opj_tcd_t *p_tcd)
+{
+    return opj_tcd_run_per_component(p_tcd, opj_tcd_dwt_decode_comp);
 }
 
 static OPJ_BOOL opj_tcd_mct_decode(opj_tcd_t *p_tcd, opj_event_mgr_t *p_manager)
@@ -2194,94 +2433,87 @@ static OPJ_BOOL opj_tcd_mct_decode(opj_tcd_t *p_tcd, opj_event_mgr_t *p_manager)
 }
 
 
-static OPJ_BOOL opj_tcd_dc_level_shift_decode(opj_tcd_t *p_tcd)
+static OPJ_BOOL opj_tcd_dc_level_shift_decode_comp(opj_tcd_t *p_tcd,
+        OPJ_UINT32 compno, opj_thread_pool_t* tp)
 {
-    OPJ_UINT32 compno;
-    opj_tcd_tilecomp_t * l_tile_comp = 00;
-    opj_tccp_t * l_tccp = 00;
-    opj_image_comp_t * l_img_comp = 00;
+    opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps + compno;
+    opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
+    opj_image_comp_t * l_img_comp = p_tcd->image->comps + compno;
     opj_tcd_resolution_t* l_res = 00;
-    opj_tcd_tile_t * l_tile;
     OPJ_UINT32 l_width, l_height, i, j;
     OPJ_INT32 * l_current_ptr;
     OPJ_INT32 l_min, l_max;
     OPJ_UINT32 l_stride;
 
-    l_tile = p_tcd->tcd_image->tiles;
-    l_tile_comp = l_tile->comps;
-    l_tccp = p_tcd->tcp->tccps;
-    l_img_comp = p_tcd->image->comps;
-
-    for (compno = 0; compno < l_tile->numcomps;
-            compno++, ++l_img_comp, ++l_tccp, ++l_tile_comp) {
-
-        if (p_tcd->used_component != NULL && !p_tcd->used_component[compno]) {
-            continue;
-        }
+    (void)tp;
 
-        l_res = l_tile_comp->resolutions + l_img_comp->resno_decoded;
+    l_res = l_tile_comp->resolutions + l_img_comp->resno_decoded;
 
-        if (!p_tcd->whole_tile_decoding) {
-            l_width = l_res->win_x1 - l_res->win_x0;
-            l_height = l_res->win_y1 - l_res->win_y0;
-            l_stride = 0;
-            l_current_ptr = l_tile_comp->data_win;
-        } else {
-            l_width = (OPJ_UINT32)(l_res->x1 - l_res->x0);
-            l_height = (OPJ_UINT32)(l_res->y1 - l_res->y0);
-            l_stride = (OPJ_UINT32)(
-                           l_tile_comp->resolutions[l_tile_comp->minimum_num_resolutions - 1].x1 -
-                           l_tile_comp->resolutions[l_tile_comp->minimum_num_resolutions - 1].x0)
-                       - l_width;
-            l_current_ptr = l_tile_comp->data;
+    if (!p_tcd->whole_tile_decoding) {
+        l_width = l_res->win_x1 - l_res->win_x0;
+        l_height = l_res->win_y1 - l_res->win_y0;
+        l_stride = 0;
+        l_current_ptr = l_tile_comp->data_win;
+    } else {
+        l_width = (OPJ_UINT32)(l_res->x1 - l_res->x0);
+        l_height = (OPJ_UINT32)(l_res->y1 - l_res->y0);
+        l_stride = (OPJ_UINT32)(
+                       l_tile_comp->resolutions[l_tile_comp->minimum_num_resolutions - 1].x1 -
+                       l_tile_comp->resolutions[l_tile_comp->minimum_num_resolutions - 1].x0)
+                   - l_width;
+        l_current_ptr = l_tile_comp->data;
 
-            assert(l_height == 0 ||
-                   l_width + l_stride <= l_tile_comp->data_size / l_height); /*MUPDF*/
-        }
+        assert(l_height == 0 ||
+               l_width + l_stride <= l_tile_comp->data_size / l_height); /*MUPDF*/
+    }
 
-        if (l_img_comp->sgnd) {
-            l_min = -(1 << (l_img_comp->prec - 1));
-            l_max = (1 << (l_img_comp->prec - 1)) - 1;
-        } else {
-            l_min = 0;
-            l_max = (OPJ_INT32)((1U << l_img_comp->prec) - 1);
-        }
+    if (l_img_comp->sgnd) {
+        l_min = -(1 << (l_img_comp->prec - 1));
+        l_max = (1 << (l_img_comp->prec - 1)) - 1;
+    } else {
+        l_min = 0;
+        l_max = (OPJ_INT32)((1U << l_img_comp->prec) - 1);
+    }
 
 
-        if (l_tccp->qmfbid == 1) {
-            for (j = 0; j < l_height; ++j) {
-                for (i = 0; i < l_width; ++i) {
-                    /* TODO: do addition on int64 ? */
-                    *l_current_ptr = opj_int_clamp(*l_current_ptr + l_tccp->m_dc_level_shift, l_min,
-                                                   l_max);
-                    ++l_current_ptr;
-                }
-                l_current_ptr += l_stride;
+    if (l_tccp->qmfbid == 1) {
+        for (j = 0; j < l_height; ++j) {
+            for (i = 0; i < l_width; ++i) {
+                /* TODO: do addition on int64 ? */
+                *l_current_ptr = opj_int_clamp(*l_current_ptr + l_tccp->m_dc_level_shift, l_min,
+                                               l_max);
+                ++l_current_ptr;
             }
-        } else {
-            for (j = 0; j < l_height; ++j) {
-                for (i = 0; i < l_width; ++i) {
-                    OPJ_FLOAT32 l_value = *((OPJ_FLOAT32 *) l_current_ptr);
-                    if (l_value > INT_MAX) {
-                        *l_current_ptr = l_max;
-                    } else if (l_value < INT_MIN) {
-                        *l_current_ptr = l_min;
-                    } else {
-                        /* Do addition on int64 to avoid overflows */
-                        OPJ_INT64 l_value_int = (OPJ_INT64)opj_lrintf(l_value);
-                        *l_current_ptr = (OPJ_INT32)opj_int64_clamp(
-                                             l_value_int + l_tccp->m_dc_level_shift, l_min, l_max);
-                    }
-                    ++l_current_ptr;
+            l_current_ptr += l_stride;
+        }
+    } else {
+        for (j = 0; j < l_height; ++j) {
+            for (i = 0; i < l_width; ++i) {
+                OPJ_FLOAT32 l_value = *((OPJ_FLOAT32 *) l_current_ptr);
+                if (l_value > INT_MAX) {
+                    *l_current_ptr = l_max;
+                } else if (l_value < INT_MIN) {
+                    *l_current_ptr = l_min;
+                } else {
+                    /* Do addition on int64 to avoid overflows */
+                    OPJ_INT64 l_value_int = (OPJ_INT64)opj_lrintf(l_value);
+                    *l_current_ptr = (OPJ_INT32)opj_int64_clamp(
+                                         l_value_int + l_tccp->m_dc_level_shift, l_min, l_max);
                 }
-                l_current_ptr += l_stride;
+                ++l_current_ptr;
             }
+            l_current_ptr += l_stride;
         }
     }
 
     return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_tcd_dc_level_shift_decode(opj_tcd_t *p_tcd)
+{
+    return opj_tcd_run_per_component(p_tcd, opj_tcd_dc_level_shift_decode_comp);
+}
+
 
 
 /**
@@ -2395,47 +2627,41 @@ OPJ_SIZE_T opj_tcd_get_encoder_input_buffer_size(opj_tcd_t *p_tcd)
     return l_data_size;
 }
 
-static OPJ_BOOL opj_tcd_dc_level_shift_encode(opj_tcd_t *p_tcd)
+static OPJ_BOOL opj_tcd_dc_level_shift_encode_comp(opj_tcd_t *p_tcd,
+        OPJ_UINT32 compno, opj_thread_pool_t* tp)
 {
-    OPJ_UINT32 compno;
-    opj_tcd_tilecomp_t * l_tile_comp = 00;
-    opj_tccp_t * l_tccp = 00;
-    opj_image_comp_t * l_img_comp = 00;
-    opj_tcd_tile_t * l_tile;
+    opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps + compno;
+    opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
     OPJ_SIZE_T l_nb_elem, i;
     OPJ_INT32 * l_current_ptr;
 
-    l_tile = p_tcd->tcd_image->tiles;
-    l_tile_comp = l_tile->comps;
-    l_tccp = p_tcd->tcp->tccps;
-    l_img_comp = p_tcd->image->comps;
+    (void)tp;
 
-    for (compno = 0; compno < l_tile->numcomps; compno++) {
-        l_current_ptr = l_tile_comp->data;
-        l_nb_elem = (OPJ_SIZE_T)(l_tile_comp->x1 - l_tile_comp->x0) *
-                    (OPJ_SIZE_T)(l_tile_comp->y1 - l_tile_comp->y0);
+    l_current_ptr = l_tile_comp->data;
+    l_nb_elem = (OPJ_SIZE_T)(l_tile_comp->x1 - l_tile_comp->x0) *
+                (OPJ_SIZE_T)(l_tile_comp->y1 - l_tile_comp->y0);
 
-        if (l_tccp->qmfbid == 1) {
-            for (i = 0; i < l_nb_elem; ++i) {
-                *l_current_ptr -= l_tccp->m_dc_level_shift ;
-                ++l_current_ptr;
-            }
-        } else {
-            for (i = 0; i < l_nb_elem; ++i) {
-                *((OPJ_FLOAT32 *) l_current_ptr) = (OPJ_FLOAT32)(*l_current_ptr -
-                                                   l_tccp->m_dc_level_shift);
-                ++l_current_ptr;
-            }
+    if (l_tccp->qmfbid == 1) {
+        for (i = 0; i < l_nb_elem; ++i) {
+            *l_current_ptr -= l_tccp->m_dc_level_shift ;
+            ++l_current_ptr;
+        }
+    } else {
+        for (i = 0; i < l_nb_elem; ++i) {
+            *((OPJ_FLOAT32 *) l_current_ptr) = (OPJ_FLOAT32)(*l_current_ptr -
+                                               l_tccp->m_dc_level_shift);
+            ++l_current_ptr;
         }
-
-        ++l_img_comp;
-        ++l_tccp;
-        ++l_tile_comp;
     }
 
     return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_tcd_dc_level_shift_encode(opj_tcd_t *p_tcd)
+{
+    return opj_tcd_run_per_component(p_tcd, opj_tcd_dc_level_shift_encode_comp);
+}
+
 static OPJ_BOOL opj_tcd_mct_encode(opj_tcd_t *p_tcd)
 {
     opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
@@ -2494,53 +2720,87 @@ static OPJ_BOOL opj_tcd_mct_encode(opj_tcd_t *p_tcd)
     return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_tcd_dwt_encode_comp(opj_tcd_t *p_tcd, OPJ_UINT32 compno,
+                                        opj_thread_pool_t* tp)
+{
+    opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps + compno;
+    opj_tccp_t * l_tccp = p_tcd->tcp->tccps + compno;
+
+    if (l_tccp->qmfbid == 1) {
+        return opj_dwt_encode(p_tcd, tp, l_tile_comp);
+    } else if (l_tccp->qmfbid == 0) {
+        return opj_dwt_encode_real(p_tcd, tp, l_tile_comp);
+    }
+    return OPJ_TRUE;
+}
+
 static OPJ_BOOL opj_tcd_dwt_encode(opj_tcd_t *p_tcd)
 {
-    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
-    opj_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps;
-    opj_tccp_t * l_tccp = p_tcd->tcp->tccps;
-    OPJ_UINT32 compno;
+    return opj_tcd_run_per_component(p_tcd, opj_tcd_dwt_encode_comp);
+}
 
-    for (compno = 0; compno < l_tile->numcomps; ++compno) {
-        if (l_tccp->qmfbid == 1) {
-            if (! opj_dwt_encode(p_tcd, l_tile_comp)) {
-                return OPJ_FALSE;
-            }
-        } else if (l_tccp->qmfbid == 0) {
-            if (! opj_dwt_encode_real(p_tcd, l_tile_comp)) {
-                return OPJ_FALSE;
+/**
+ * Returns whether the rate allocation of the current tile will make use of
+ * the per-pass distortion decrease computed by the code-block encoder.
+ */
+static OPJ_BOOL opj_tcd_t1_encode_needs_distortion(opj_tcd_t *p_tcd)
+{
+    opj_cp_t * l_cp = p_tcd->cp;
+    opj_tcp_t * l_tcp = p_tcd->tcp;
+    OPJ_UINT32 layno;
+
+    if (!l_cp->m_specific_param.m_enc.m_lazy_no_distortion) {
+        return OPJ_TRUE;
+    }
+
+    /* Mirrors the decision done in opj_tcd_rateallocate() to use all passes */
+    if (l_cp->m_specific_param.m_enc.m_disto_alloc ||
+            l_cp->m_specific_param.m_enc.m_fixed_quality) {
+        for (layno = 0; layno < l_tcp->numlayers; layno++) {
+            if ((l_cp->m_specific_param.m_enc.m_disto_alloc &&
+                    l_tcp->rates[layno] > 0.0f) ||
+                    (l_cp->m_specific_param.m_enc.m_fixed_quality &&
+                     l_tcp->distoratio[layno] > 0.0)) {
+                return OPJ_TRUE;
             }
         }
-
-        ++l_tile_comp;
-        ++l_tccp;
     }
 
-    return OPJ_TRUE;
+    return OPJ_FALSE;
 }
 
-static OPJ_BOOL opj_tcd_t1_encode(opj_tcd_t *p_tcd)
+/**
+ * Returns the MCT norms used by the code-block encoder for the current tile.
+ */
+static const OPJ_FLOAT64 * opj_tcd_t1_encode_mct_norms(opj_tcd_t *p_tcd,
+        OPJ_UINT32 * p_mct_numcomps)
 {
-    const OPJ_FLOAT64 * l_mct_norms;
-    OPJ_UINT32 l_mct_numcomps = 0U;
     opj_tcp_t * l_tcp = p_tcd->tcp;
 
     if (l_tcp->mct == 1) {
-        l_mct_numcomps = 3U;
+        *p_mct_numcomps = 3U;
         /* irreversible encoding */
         if (l_tcp->tccps->qmfbid == 0) {
-            l_mct_norms = opj_mct_get_mct_norms_real();
-        } else {
-            l_mct_norms = opj_mct_get_mct_norms();
+            return opj_mct_get_mct_norms_real();
         }
-    } else {
-        l_mct_numcomps = p_tcd->image->numcomps;
-        l_mct_norms = (const OPJ_FLOAT64 *)(l_tcp->mct_norms);
+        return opj_mct_get_mct_norms();
     }
+    *p_mct_numcomps = p_tcd->image->numcomps;
+    return (const OPJ_FLOAT64 *)(l_tcp->mct_norms);
+}
+
+static OPJ_BOOL opj_tcd_t1_encode(opj_tcd_t *p_tcd)
+{
+    const OPJ_FLOAT64 * l_mct_norms;
+    OPJ_UINT32 l_mct_numcomps = 0U;
+    opj_tcp_t * l_tcp = p_tcd->tcp;
+
+    l_mct_norms = opj_tcd_t1_encode_mct_norms(p_tcd, &l_mct_numcomps);
 
     return opj_t1_encode_cblks(p_tcd,
                                p_tcd->tcd_image->tiles, l_tcp, l_mct_norms,
-                               l_mct_numcomps);
+                               l_mct_numcomps,
+                               opj_tcd_t1_encode_needs_distortion(p_tcd));
 
     return OPJ_TRUE;
 }
@@ -2704,13 +2964,437 @@ OPJ_BOOL opj_tcd_copy_tile_data(opj_tcd_t *p_tcd,
     return OPJ_TRUE;
 }
 
+/**
+ * Reads one component of the current tile from an interleaved buffer.
+ * SAMPLE_T is the type of a sample in the buffer, DEST_T the type of the tile
+ * data (OPJ_INT32 for the reversible path, OPJ_FLOAT32 for the irreversible
+ * one).
+ */
+#define OPJ_TCD_DEINTERLEAVE(SAMPLE_T, DEST_T)                               \
+    {                                                                         \
+        OPJ_UINT32 i, j;                                                      \
+        DEST_T* l_dest = (DEST_T*)l_tilec->data;                              \
+        for (j = 0; j < l_height; ++j) {                                      \
+            const SAMPLE_T* l_src = (const SAMPLE_T*)(l_src_line) + l_sample; \
+            for (i = 0; i < l_width; ++i) {                                   \
+                l_dest[i] = (DEST_T)((OPJ_INT32)l_src[0] - l_dc_shift);       \
+                l_src += l_spp;                                               \
+            }                                                                 \
+            l_dest += l_width;                                                \
+            l_src_line += p_buffer->line_stride;                              \
+        }                                                                     \
+    }
+
+void opj_tcd_copy_tile_data_interleaved(opj_tcd_t *p_tcd,
+                                        OPJ_UINT32 p_tile_no,
+                                        const opj_interleaved_buffer_t *p_buffer)
+{
+    opj_image_t * l_image = p_tcd->image;
+    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+    opj_tccp_t * l_tccp = p_tcd->cp->tcps[p_tile_no].tccps;
+    const OPJ_UINT32 l_spp = p_buffer->samples_per_pixel;
+    OPJ_UINT32 compno;
+
+    for (compno = 0; compno < l_tile->numcomps; ++compno, ++l_tccp) {
+        opj_tcd_tilecomp_t * l_tilec = &l_tile->comps[compno];
+        const opj_image_comp_t * l_img_comp = &l_image->comps[compno];
+        const OPJ_UINT32 l_width = (OPJ_UINT32)(l_tilec->x1 - l_tilec->x0);
+        const OPJ_UINT32 l_height = (OPJ_UINT32)(l_tilec->y1 - l_tilec->y0);
+        const OPJ_UINT32 l_sample = p_buffer->comp_mapping ?
+                                    p_buffer->comp_mapping[compno] : compno;
+        const OPJ_INT32 l_dc_shift = l_tccp->m_dc_level_shift;
+        const OPJ_BYTE * l_src_line = p_buffer->data +
+                                      (OPJ_SIZE_T)((OPJ_UINT32)l_tilec->y0 - l_image->y0) * p_buffer->line_stride +
+                                      (OPJ_SIZE_T)((OPJ_UINT32)l_tilec->x0 - l_image->x0) * l_spp *
+                                      p_buffer->bytes_per_sample;
+
+        if (p_buffer->bytes_per_sample == 1) {
+            if (l_img_comp->sgnd) {
+                if (l_tccp->qmfbid == 1) {
+                    OPJ_TCD_DEINTERLEAVE(signed char, OPJ_INT32)
+                } else {
+                    OPJ_TCD_DEINTERLEAVE(signed char, OPJ_FLOAT32)
+                }
+            } else {
+                if (l_tccp->qmfbid == 1) {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_BYTE, OPJ_INT32)
+                } else {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_BYTE, OPJ_FLOAT32)
+                }
+            }
+        } else {
+            if (l_img_comp->sgnd) {
+                if (l_tccp->qmfbid == 1) {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_INT16, OPJ_INT32)
+                } else {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_INT16, OPJ_FLOAT32)
+                }
+            } else {
+                if (l_tccp->qmfbid == 1) {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_UINT16, OPJ_INT32)
+                } else {
+                    OPJ_TCD_DEINTERLEAVE(OPJ_UINT16, OPJ_FLOAT32)
+                }
+            }
+        }
+    }
+
+    p_tcd->dc_level_shift_done = OPJ_TRUE;
+}
+
+#undef OPJ_TCD_DEINTERLEAVE
+
+/* ----------------------------------------------------------------------- */
+
+/** Rows of a sub-band waiting for their code-blocks to be complete */
+typedef struct opj_tcd_line_band {
+    /** Rows of the current stripe, band width samples each */
+    OPJ_INT32* data;
+    /** Height of a stripe, i.e. of the code-blocks of the band */
+    OPJ_UINT32 cblk_h;
+    /** First row of the current stripe, in band coordinates */
+    OPJ_INT32 y0;
+    /** Number of rows of the current stripe received */
+    OPJ_UINT32 nb_rows;
+} opj_tcd_line_band_t;
+
+typedef struct opj_tcd_line_comp {
+    opj_tcd_line_encoder_t* encoder;
+    OPJ_UINT32 compno;
+    opj_dwt_lines_encoder_t* dwt;
+    /** Sub-bands of the component, indexed by 3 * resno + bandno */
+    opj_tcd_line_band_t* bands;
+} opj_tcd_line_comp_t;
+
+struct opj_tcd_line_encoder {
+    opj_tcd_t* tcd;
+    /** Number of lines of the tile received */
+    OPJ_UINT32 nb_lines;
+    /** Current line of each component, after DC level shift */
+    OPJ_INT32** lines;
+    opj_tcd_line_comp_t* comps;
+    const OPJ_FLOAT64 * mct_norms;
+    OPJ_UINT32 mct_numcomps;
+    OPJ_BOOL compute_distortion;
+};
+
+static void opj_tcd_line_encoder_destroy(opj_tcd_line_encoder_t* p_encoder)
+{
+    OPJ_UINT32 compno, i;
+    opj_tcd_tile_t * l_tile;
+
+    if (!p_encoder) {
+        return;
+    }
+    l_tile = p_encoder->tcd->tcd_image->tiles;
+    if (p_encoder->comps) {
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+            opj_tcd_line_comp_t* l_comp = &p_encoder->comps[compno];
+            opj_dwt_lines_encoder_destroy(l_comp->dwt);
+            if (l_comp->bands) {
+                for (i = 0; i < 3 * l_tile->comps[compno].numresolutions; ++i) {
+                    opj_free(l_comp->bands[i].data);
+                }
+                opj_free(l_comp->bands);
+            }
+        }
+        opj_free(p_encoder->comps);
+    }
+    if (p_encoder->lines) {
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+            opj_free(p_encoder->lines[compno]);
+        }
+        opj_free(p_encoder->lines);
+    }
+    opj_free(p_encoder);
+}
+
+/** Receives a sub-band row from the line-based DWT, and encodes the */
+/** code-blocks of the stripe once it is complete. */
+static OPJ_BOOL opj_tcd_line_band_row(void *user_data,
+                                      OPJ_UINT32 resno,
+                                      OPJ_UINT32 bandno,
+                                      const OPJ_INT32 *row)
+{
+    opj_tcd_line_comp_t* l_comp = (opj_tcd_line_comp_t*)user_data;
+    opj_tcd_line_encoder_t* l_encoder = l_comp->encoder;
+    opj_tcd_t* l_tcd = l_encoder->tcd;
+    opj_tcd_tile_t * l_tile = l_tcd->tcd_image->tiles;
+    opj_tcd_band_t* l_band =
+        &l_tile->comps[l_comp->compno].resolutions[resno].bands[bandno];
+    opj_tcd_line_band_t* l_line_band = &l_comp->bands[3 * resno + bandno];
+    const OPJ_UINT32 l_width = (OPJ_UINT32)(l_band->x1 - l_band->x0);
+    OPJ_INT32 l_y1;
+
+    if (opj_tcd_is_band_empty(l_band)) {
+        return OPJ_TRUE;
+    }
+
+    memcpy(l_line_band->data + (OPJ_SIZE_T)l_line_band->nb_rows * l_width, row,
+           (OPJ_SIZE_T)l_width * sizeof(OPJ_INT32));
+    l_line_band->nb_rows ++;
+
+    l_y1 = l_line_band->y0 + (OPJ_INT32)l_line_band->nb_rows;
+    if (l_y1 == l_band->y1 ||
+            ((OPJ_UINT32)l_y1 & (l_line_band->cblk_h - 1U)) == 0) {
+        if (! opj_t1_encode_cblks_stripe(l_tcd, l_tile, l_tcd->tcp,
+                                         l_comp->compno, resno, bandno,
+                                         l_line_band->data,
+                                         l_line_band->y0, l_y1, l_width,
+                                         l_encoder->mct_norms,
+                                         l_encoder->mct_numcomps,
+                                         l_encoder->compute_distortion)) {
+            return OPJ_FALSE;
+        }
+        l_line_band->y0 = l_y1;
+        l_line_band->nb_rows = 0;
+    }
+    return OPJ_TRUE;
+}
+
+OPJ_BOOL opj_tcd_start_encode_tile_lines(opj_tcd_t *p_tcd,
+        OPJ_UINT32 p_tile_no,
+        opj_event_mgr_t *p_manager)
+{
+    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+    opj_tcd_line_encoder_t* l_encoder;
+    OPJ_UINT32 compno, resno, bandno;
+
+    assert(p_tcd->line_encoder == 00);
+
+    p_tcd->tcd_tileno = p_tile_no;
+    p_tcd->tcp = &p_tcd->cp->tcps[p_tile_no];
+    l_tile->distotile = 0;
+
+    l_encoder = (opj_tcd_line_encoder_t*) opj_calloc(1,
+                sizeof(opj_tcd_line_encoder_t));
+    if (!l_encoder) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Not enough memory for line-based encoding\n");
+        return OPJ_FALSE;
+    }
+    l_encoder->tcd = p_tcd;
+    l_encoder->mct_norms = opj_tcd_t1_encode_mct_norms(p_tcd,
+                           &l_encoder->mct_numcomps);
+    l_encoder->compute_distortion = opj_tcd_t1_encode_needs_distortion(p_tcd);
+    l_encoder->lines = (OPJ_INT32**) opj_calloc(l_tile->numcomps,
+                       sizeof(OPJ_INT32*));
+    l_encoder->comps = (opj_tcd_line_comp_t*) opj_calloc(l_tile->numcomps,
+                       sizeof(opj_tcd_line_comp_t));
+    if (!l_encoder->lines || !l_encoder->comps) {
+        goto error;
+    }
+
+    for (compno = 0; compno < l_tile->numcomps; ++compno) {
+        opj_tcd_tilecomp_t * l_tilec = &l_tile->comps[compno];
+        opj_tccp_t * l_tccp = &p_tcd->tcp->tccps[compno];
+        opj_tcd_line_comp_t* l_comp = &l_encoder->comps[compno];
+        const OPJ_UINT32 l_width = (OPJ_UINT32)(l_tilec->x1 - l_tilec->x0);
+
+        l_encoder->lines[compno] = (OPJ_INT32*) opj_malloc((OPJ_SIZE_T)opj_uint_max(
+                                       l_width, 1) * sizeof(OPJ_INT32));
+        if (!l_encoder->lines[compno]) {
+            goto error;
+        }
+
+        l_comp->encoder = l_encoder;
+        l_comp->compno = compno;
+        l_comp->bands = (opj_tcd_line_band_t*) opj_calloc(3 *
+                        l_tilec->numresolutions, sizeof(opj_tcd_line_band_t));
+        if (!l_comp->bands) {
+            goto error;
+        }
+        for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
+            opj_tcd_resolution_t * l_res = &l_tilec->resolutions[resno];
+            /* Same code-block height as in opj_tcd_init_tile() */
+            const OPJ_UINT32 l_cbgheightexpn = (resno == 0) ? l_tccp->prch[resno] :
+                                               l_tccp->prch[resno] - 1;
+            const OPJ_UINT32 l_cblkheightexpn = opj_uint_min(l_tccp->cblkh,
+                                                l_cbgheightexpn);
+
+            for (bandno = 0; bandno < l_res->numbands; ++bandno) {
+                opj_tcd_band_t * l_band = &l_res->bands[bandno];
+                opj_tcd_line_band_t * l_line_band = &l_comp->bands[3 * resno + bandno];
+
+                if (opj_tcd_is_band_empty(l_band)) {
+                    continue;
+                }
+                l_line_band->cblk_h = 1U << l_cblkheightexpn;
+                l_line_band->y0 = l_band->y0;
+                l_line_band->data = (OPJ_INT32*) opj_malloc((OPJ_SIZE_T)(
+                                        l_band->x1 - l_band->x0) * l_line_band->cblk_h * sizeof(OPJ_INT32));
+                if (!l_line_band->data) {
+                    goto error;
+                }
+            }
+        }
+
+        l_comp->dwt = opj_dwt_lines_encoder_create(l_tilec, l_tccp->qmfbid == 1,
+                      opj_tcd_line_band_row, l_comp);
+        if (!l_comp->dwt) {
+            goto error;
+        }
+    }
+
+    p_tcd->line_encoder = l_encoder;
+    return OPJ_TRUE;
+
+error:
+    opj_tcd_line_encoder_destroy(l_encoder);
+    opj_event_msg(p_manager, EVT_ERROR,
+                  "Not enough memory for line-based encoding\n");
+    return OPJ_FALSE;
+}
+
+OPJ_BOOL opj_tcd_encode_tile_lines(opj_tcd_t *p_tcd,
+                                   OPJ_UINT32 p_nb_lines,
+                                   const OPJ_BYTE * const * p_src,
+                                   opj_event_mgr_t *p_manager)
+{
+    opj_tcd_line_encoder_t* l_encoder = p_tcd->line_encoder;
+    opj_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+    opj_tcp_t * l_tcp = p_tcd->tcp;
+    const OPJ_UINT32 l_width = (OPJ_UINT32)(l_tile->comps[0].x1 -
+                               l_tile->comps[0].x0);
+    const OPJ_UINT32 l_height = (OPJ_UINT32)(l_tile->comps[0].y1 -
+                                l_tile->comps[0].y0);
+    OPJ_UINT32 compno, i, j;
+
+    if (l_encoder == 00 || l_encoder->nb_lines + p_nb_lines > l_height) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Too many lines given to the line-based encoder\n");
+        return OPJ_FALSE;
+    }
+
+    for (j = 0; j < p_nb_lines; ++j) {
+        /* Read the line of each component and apply the DC level shift */
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+            const opj_image_comp_t * l_img_comp = &p_tcd->image->comps[compno];
+            const opj_tccp_t * l_tccp = &l_tcp->tccps[compno];
+            const OPJ_INT32 l_dc_shift = l_tccp->m_dc_level_shift;
+            OPJ_INT32 * l_line = l_encoder->lines[compno];
+            OPJ_UINT32 l_size_comp = (l_img_comp->prec + 7) >> 3;
+
+            if (l_size_comp == 3) {
+                l_size_comp = 4;
+            }
+            switch (l_size_comp) {
+            case 1: {
+                const OPJ_BYTE * l_src = p_src[compno] + (OPJ_SIZE_T)j * l_width;
+                if (l_img_comp->sgnd) {
+                    for (i = 0; i < l_width; ++i) {
+                        l_line[i] = (OPJ_INT32)(OPJ_CHAR)l_src[i];
+                    }
+                } else {
+                    for (i = 0; i < l_width; ++i) {
+                        l_line[i] = (OPJ_INT32)l_src[i];
+                    }
+                }
+            }
+            break;
+            case 2: {
+                const OPJ_INT16 * l_src = (const OPJ_INT16 *)p_src[compno] +
+                                          (OPJ_SIZE_T)j * l_width;
+                if (l_img_comp->sgnd) {
+                    for (i = 0; i < l_width; ++i) {
+                        l_line[i] = (OPJ_INT32)l_src[i];
+                    }
+                } else {
+                    for (i = 0; i < l_width; ++i) {
+                        l_line[i] = l_src[i] & 0xffff;
+                    }
+                }
+            }
+            break;
+            default: {
+                const OPJ_INT32 * l_src = (const OPJ_INT32 *)p_src[compno] +
+                                          (OPJ_SIZE_T)j * l_width;
+                memcpy(l_line, l_src, (OPJ_SIZE_T)l_width * sizeof(OPJ_INT32));
+            }
+            break;
+            }
+
+            if (l_tccp->qmfbid == 1) {
+                for (i = 0; i < l_width; ++i) {
+                    l_line[i] -= l_dc_shift;
+                }
+            } else {
+                for (i = 0; i < l_width; ++i) {
+                    ((OPJ_FLOAT32 *)l_line)[i] = (OPJ_FLOAT32)(l_line[i] - l_dc_shift);
+                }
+            }
+        }
+
+        /* Same as opj_tcd_mct_encode(), on a single line */
+        if (l_tcp->mct == 2) {
+            if (l_tcp->m_mct_coding_matrix &&
+                    ! opj_mct_encode_custom((OPJ_BYTE*) l_tcp->m_mct_coding_matrix,
+                                            l_width, (OPJ_BYTE**) l_encoder->lines,
+                                            l_tile->numcomps, p_tcd->image->comps->sgnd)) {
+                return OPJ_FALSE;
+            }
+        } else if (l_tcp->mct == 1) {
+            if (l_tcp->tccps->qmfbid == 0) {
+                opj_mct_encode_real((OPJ_FLOAT32*)l_encoder->lines[0],
+                                    (OPJ_FLOAT32*)l_encoder->lines[1],
+                                    (OPJ_FLOAT32*)l_encoder->lines[2], l_width);
+            } else {
+                opj_mct_encode(l_encoder->lines[0], l_encoder->lines[1],
+                               l_encoder->lines[2], l_width);
+            }
+        }
+
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+            if (! opj_dwt_lines_encoder_push_row(l_encoder->comps[compno].dwt,
+                                                 l_encoder->lines[compno])) {
+                opj_event_msg(p_manager, EVT_ERROR,
+                              "Line-based encoding of tile %d failed\n", p_tcd->tcd_tileno);
+                return OPJ_FALSE;
+            }
+        }
+        l_encoder->nb_lines ++;
+    }
+
+    return OPJ_TRUE;
+}
+
+/**
+ * Ends the line-based encoding of the current tile.
+ */
+static OPJ_BOOL opj_tcd_end_encode_tile_lines(opj_tcd_t *p_tcd,
+        opj_event_mgr_t *p_manager)
+{
+    opj_tcd_tilecomp_t * l_tilec = p_tcd->tcd_image->tiles->comps;
+    const OPJ_UINT32 l_height = (OPJ_UINT32)(l_tilec->y1 - l_tilec->y0);
+    OPJ_BOOL l_ret = (p_tcd->line_encoder->nb_lines == l_height);
+
+    if (! l_ret) {
+        opj_event_msg(p_manager, EVT_ERROR,
+                      "Tile %d is incomplete: %d lines given out of %d\n",
+                      p_tcd->tcd_tileno, p_tcd->line_encoder->nb_lines, l_height);
+    }
+    opj_tcd_line_encoder_destroy(p_tcd->line_encoder);
+    p_tcd->line_encoder = 00;
+    return l_ret;
+}
+
 OPJ_BOOL opj_tcd_is_band_empty(opj_tcd_band_t* band)
 {
     return (band->x1 - band->x0 == 0) || (band->y1 - band->y0 == 0);
 }
 
-OPJ_BOOL opj_tcd_is_subband_area_of_interest(opj_tcd_t *tcd,
-        OPJ_UINT32 compno,
+/**
+ * Returns whether a sub-band region contributes to the area of interest
+ * (see opj_tcd_is_subband_area_of_interest()), for a tile-component of
+ * numresolutions resolutions and a transform qmfbid, the area of interest
+ * being already intersected with the tile-component.
+ */
+static OPJ_BOOL opj_tcd_is_subband_region_of_interest(OPJ_UINT32 qmfbid,
+        OPJ_UINT32 numresolutions,
+        OPJ_UINT32 tcx0,
+        OPJ_UINT32 tcy0,
+        OPJ_UINT32 tcx1,
+        OPJ_UINT32 tcy1,
         OPJ_UINT32 resno,
         OPJ_UINT32 bandno,
         OPJ_UINT32 band_x0,
@@ -2726,27 +3410,11 @@ OPJ_BOOL opj_tcd_is_subband_area_of_interest(opj_tcd_t *tcd,
     /* needed to be bumped to 4, in case inconsistencies are found while */
     /* decoding parts of irreversible coded images. */
     /* See opj_dwt_decode_partial_53 and opj_dwt_decode_partial_97 as well */
-    OPJ_UINT32 filter_margin = (tcd->tcp->tccps[compno].qmfbid == 1) ? 2 : 3;
-    opj_tcd_tilecomp_t *tilec = &(tcd->tcd_image->tiles->comps[compno]);
-    opj_image_comp_t* image_comp = &(tcd->image->comps[compno]);
-    /* Compute the intersection of the area of interest, expressed in tile coordinates */
-    /* with the tile coordinates */
-    OPJ_UINT32 tcx0 = opj_uint_max(
-                          (OPJ_UINT32)tilec->x0,
-                          opj_uint_ceildiv(tcd->win_x0, image_comp->dx));
-    OPJ_UINT32 tcy0 = opj_uint_max(
-                          (OPJ_UINT32)tilec->y0,
-                          opj_uint_ceildiv(tcd->win_y0, image_comp->dy));
-    OPJ_UINT32 tcx1 = opj_uint_min(
-                          (OPJ_UINT32)tilec->x1,
-                          opj_uint_ceildiv(tcd->win_x1, image_comp->dx));
-    OPJ_UINT32 tcy1 = opj_uint_min(
-                          (OPJ_UINT32)tilec->y1,
-                          opj_uint_ceildiv(tcd->win_y1, image_comp->dy));
+    OPJ_UINT32 filter_margin = (qmfbid == 1) ? 2 : 3;
     /* Compute number of decomposition for this band. See table F-1 */
     OPJ_UINT32 nb = (resno == 0) ?
-                    tilec->numresolutions - 1 :
-                    tilec->numresolutions - resno;
+                    numresolutions - 1 :
+                    numresolutions - resno;
     /* Map above tile-based coordinates to sub-band-based coordinates per */
     /* equation B-15 of the standard */
     OPJ_UINT32 x0b = bandno & 1;
@@ -2782,14 +3450,78 @@ OPJ_BOOL opj_tcd_is_subband_area_of_interest(opj_tcd_t *tcd,
                  band_y1 > tby0;
 
 #ifdef DEBUG_VERBOSE
-    printf("compno=%u resno=%u nb=%u bandno=%u x0b=%u y0b=%u band=%u,%u,%u,%u tb=%u,%u,%u,%u -> %u\n",
-           compno, resno, nb, bandno, x0b, y0b,
+    printf("resno=%u nb=%u bandno=%u x0b=%u y0b=%u band=%u,%u,%u,%u tb=%u,%u,%u,%u -> %u\n",
+           resno, nb, bandno, x0b, y0b,
            band_x0, band_y0, band_x1, band_y1,
            tbx0, tby0, tbx1, tby1, intersects);
 #endif
     return intersects;
 }
 
+OPJ_BOOL opj_tcd_is_interrupted(const opj_interrupt_t* p_interrupt)
+{
+    if (p_interrupt == NULL) {
+        return OPJ_FALSE;
+    }
+    return p_interrupt->cancelled ||
+           (p_interrupt->deadline != 0 && opj_wall_clock() >= p_interrupt->deadline);
+}
+
+OPJ_BOOL opj_tcd_is_subband_area_of_interest(opj_tcd_t *tcd,
+        OPJ_UINT32 compno,
+        OPJ_UINT32 resno,
+        OPJ_UINT32 bandno,
+        OPJ_UINT32 band_x0,
+        OPJ_UINT32 band_y0,
+        OPJ_UINT32 band_x1,
+        OPJ_UINT32 band_y1)
+{
+    opj_tcd_tilecomp_t *tilec = &(tcd->tcd_image->tiles->comps[compno]);
+    opj_image_comp_t* image_comp = &(tcd->image->comps[compno]);
+    /* Compute the intersection of the area of interest, expressed in tile coordinates */
+    /* with the tile coordinates */
+    OPJ_UINT32 tcx0 = opj_uint_max(
+                          (OPJ_UINT32)tilec->x0,
+                          opj_uint_ceildiv(tcd->win_x0, image_comp->dx));
+    OPJ_UINT32 tcy0 = opj_uint_max(
+                          (OPJ_UINT32)tilec->y0,
+                          opj_uint_ceildiv(tcd->win_y0, image_comp->dy));
+    OPJ_UINT32 tcx1 = opj_uint_min(
+                          (OPJ_UINT32)tilec->x1,
+                          opj_uint_ceildiv(tcd->win_x1, image_comp->dx));
+    OPJ_UINT32 tcy1 = opj_uint_min(
+                          (OPJ_UINT32)tilec->y1,
+                          opj_uint_ceildiv(tcd->win_y1, image_comp->dy));
+
+    return opj_tcd_is_subband_region_of_interest(
+               tcd->tcp->tccps[compno].qmfbid, tilec->numresolutions,
+               tcx0, tcy0, tcx1, tcy1, resno, bandno,
+               band_x0, band_y0, band_x1, band_y1);
+}
+
+/** Returns whether the intersection tcx0..tcy1 of the area of interest with
+ * the tile component x0..y1 covers it, within the precision of the decoded
+ * resolution, which is shift levels below the full one.
+ */
+static OPJ_BOOL opj_tcd_is_whole_region(OPJ_UINT32 x0, OPJ_UINT32 y0,
+                                        OPJ_UINT32 x1, OPJ_UINT32 y1,
+                                        OPJ_UINT32 tcx0, OPJ_UINT32 tcy0,
+                                        OPJ_UINT32 tcx1, OPJ_UINT32 tcy1,
+                                        OPJ_UINT32 shift)
+{
+    /* Tolerate small margin within the reduced resolution factor to consider if */
+    /* the whole tile path must be taken */
+    return (tcx0 >= x0 &&
+            tcy0 >= y0 &&
+            tcx1 <= x1 &&
+            tcy1 <= y1 &&
+            (shift >= 32 ||
+             (((tcx0 - x0) >> shift) == 0 &&
+              ((tcy0 - y0) >> shift) == 0 &&
+              ((x1 - tcx1) >> shift) == 0 &&
+              ((y1 - tcy1) >> shift) == 0)));
+}
+
 /** Returns whether a tile componenent is fully decoded, taking into account
  * p_tcd->win_* members.
  *
@@ -2817,18 +3549,279 @@ static OPJ_BOOL opj_tcd_is_whole_tilecomp_decoding(opj_tcd_t *p_tcd,
                           (OPJ_UINT32)tilec->y1,
                           opj_uint_ceildiv(p_tcd->win_y1, image_comp->dy));
 
-    OPJ_UINT32 shift = tilec->numresolutions - tilec->minimum_num_resolutions;
-    /* Tolerate small margin within the reduced resolution factor to consider if */
-    /* the whole tile path must be taken */
-    return (tcx0 >= (OPJ_UINT32)tilec->x0 &&
-            tcy0 >= (OPJ_UINT32)tilec->y0 &&
-            tcx1 <= (OPJ_UINT32)tilec->x1 &&
-            tcy1 <= (OPJ_UINT32)tilec->y1 &&
-            (shift >= 32 ||
-             (((tcx0 - (OPJ_UINT32)tilec->x0) >> shift) == 0 &&
-              ((tcy0 - (OPJ_UINT32)tilec->y0) >> shift) == 0 &&
-              (((OPJ_UINT32)tilec->x1 - tcx1) >> shift) == 0 &&
-              (((OPJ_UINT32)tilec->y1 - tcy1) >> shift) == 0)));
+    return opj_tcd_is_whole_region((OPJ_UINT32)tilec->x0, (OPJ_UINT32)tilec->y0,
+                                   (OPJ_UINT32)tilec->x1, (OPJ_UINT32)tilec->y1,
+                                   tcx0, tcy0, tcx1, tcy1,
+                                   tilec->numresolutions - tilec->minimum_num_resolutions);
+}
+
+/** Returns the memory taken by a tag tree of w x h leaves (see opj_tgt_create()) */
+static OPJ_UINT64 opj_tcd_tgt_memory(OPJ_UINT32 w, OPJ_UINT32 h)
+{
+    OPJ_UINT64 l_numnodes = 0;
+    OPJ_UINT64 n;
+
+    do {
+        n = (OPJ_UINT64)w * h;
+        l_numnodes += n;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    } while (n > 1);
+    return sizeof(opj_tgt_tree_t) + l_numnodes * sizeof(opj_tgt_node_t);
+}
+
+/** Returns the number of blocks of a sparse array of block_size samples */
+/** along a dimension of max_size samples touched by a segment of size samples */
+static OPJ_UINT32 opj_tcd_sparse_array_span(OPJ_UINT32 size,
+        OPJ_UINT32 block_size, OPJ_UINT32 max_size)
+{
+    /* The segment is assumed not to be aligned on blocks */
+    return opj_uint_min(size / block_size + 2,
+                        opj_uint_ceildiv(max_size, block_size));
+}
+
+/** Returns whether component compno is in the list of decoded components */
+static OPJ_BOOL opj_tcd_is_component_decoded(OPJ_UINT32 compno,
+        OPJ_UINT32 numcomps_to_decode,
+        const OPJ_UINT32 *comps_indices)
+{
+    OPJ_UINT32 i;
+
+    if (numcomps_to_decode == 0) {
+        return OPJ_TRUE;
+    }
+    for (i = 0; i < numcomps_to_decode; ++i) {
+        if (comps_indices[i] == compno) {
+            return OPJ_TRUE;
+        }
+    }
+    return OPJ_FALSE;
+}
+
+void opj_tcd_estimate_decode_tile(opj_tcd_t *p_tcd,
+                                  OPJ_UINT32 p_tile_no,
+                                  opj_tcp_t *p_tcp,
+                                  OPJ_UINT32 win_x0,
+                                  OPJ_UINT32 win_y0,
+                                  OPJ_UINT32 win_x1,
+                                  OPJ_UINT32 win_y1,
+                                  OPJ_UINT32 numcomps_to_decode,
+                                  const OPJ_UINT32 *comps_indices,
+                                  opj_tcd_decode_cost_t *p_cost)
+{
+    opj_image_t * l_image = p_tcd->image;
+    OPJ_UINT32 l_reduce = p_tcd->cp->m_specific_param.m_dec.m_reduce;
+    opj_tcd_tile_t l_tile;
+    OPJ_BOOL l_whole_tile_decoding = OPJ_TRUE;
+    OPJ_UINT32 compno, resno, bandno, precno, cblkno;
+    OPJ_UINT32 l_pass;
+
+    memset(p_cost, 0, sizeof(opj_tcd_decode_cost_t));
+
+    if (!opj_tcd_init_tile_bounds(p_tcd->cp, l_image, p_tile_no, &l_tile,
+                                  NULL)) {
+        /* opj_tcd_init_decode_tile() will reject the tile */
+        return;
+    }
+
+    /* The first pass finds whether the tile is decoded as a whole, as in */
+    /* opj_tcd_decode_tile(), the second one walks the geometry built by */
+    /* opj_tcd_init_tile(), with the same helpers */
+    for (l_pass = 0; l_pass < 2; ++l_pass) {
+        for (compno = 0; compno < l_image->numcomps; ++compno) {
+            opj_image_comp_t * l_image_comp = &(l_image->comps[compno]);
+            opj_tccp_t * l_tccp = &(p_tcp->tccps[compno]);
+            OPJ_UINT32 l_numres = l_tccp->numresolutions;
+            OPJ_UINT32 l_minres = (l_numres < l_reduce) ? 1 : l_numres - l_reduce;
+            OPJ_BOOL l_decoded = opj_tcd_is_component_decoded(compno,
+                                 numcomps_to_decode, comps_indices);
+            opj_tcd_tilecomp_t l_tilec;
+            opj_tcd_resolution_t l_res;
+            opj_tcd_band_t l_band;
+            opj_tcd_precinct_t l_prc;
+            /* intersection of the tile-component with the area of interest */
+            OPJ_UINT32 tcx0, tcy0, tcx1, tcy1;
+            OPJ_UINT32 l_max_res_size = 0;
+            OPJ_UINT32 l_max_cblk_w = 0, l_max_cblk_h = 0;
+            /* sparse array of the partial DWT, see opj_dwt_init_sparse_array() */
+            OPJ_UINT32 l_res_w, l_res_h, l_block_w, l_block_h;
+            /* size of the previous resolution, the low-pass part of the */
+            /* current one */
+            OPJ_UINT32 l_low_w = 0, l_low_h = 0;
+            OPJ_UINT64 l_nb_blocks = 0;
+            OPJ_UINT64 l_data_size;
+
+            if (l_numres == 0) {
+                continue;
+            }
+            opj_tcd_init_tilecomp_bounds(&l_tile, l_image_comp, &l_tilec);
+            l_tilec.numresolutions = l_numres;
+            tcx0 = opj_uint_max((OPJ_UINT32)l_tilec.x0,
+                                opj_uint_ceildiv(win_x0, l_image_comp->dx));
+            tcy0 = opj_uint_max((OPJ_UINT32)l_tilec.y0,
+                                opj_uint_ceildiv(win_y0, l_image_comp->dy));
+            tcx1 = opj_uint_min((OPJ_UINT32)l_tilec.x1,
+                                opj_uint_ceildiv(win_x1, l_image_comp->dx));
+            tcy1 = opj_uint_min((OPJ_UINT32)l_tilec.y1,
+                                opj_uint_ceildiv(win_y1, l_image_comp->dy));
+
+            if (l_pass == 0) {
+                if (l_decoded && !opj_tcd_is_whole_region(
+                            (OPJ_UINT32)l_tilec.x0, (OPJ_UINT32)l_tilec.y0,
+                            (OPJ_UINT32)l_tilec.x1, (OPJ_UINT32)l_tilec.y1,
+                            tcx0, tcy0, tcx1, tcy1, l_numres - l_minres)) {
+                    l_whole_tile_decoding = OPJ_FALSE;
+                }
+                continue;
+            }
+
+            opj_tcd_init_res_bounds(&l_tilec, l_minres - 1, &l_res);
+            l_res_w = (OPJ_UINT32)(l_res.x1 - l_res.x0);
+            l_res_h = (OPJ_UINT32)(l_res.y1 - l_res.y0);
+            l_block_w = opj_uint_min(l_res_w, OPJ_DWT_SPARSE_ARRAY_BLOCK_SIZE);
+            l_block_h = opj_uint_min(l_res_h, OPJ_DWT_SPARSE_ARRAY_BLOCK_SIZE);
+
+            for (resno = 0; resno < l_numres; ++resno) {
+                OPJ_UINT32 l_level_no = l_numres - 1 - resno;
+                opj_tcd_res_partition_t l_part;
+                OPJ_UINT32 l_rw, l_rh;
+
+                opj_tcd_init_res_bounds(&l_tilec, resno, &l_res);
+                if (!opj_tcd_init_res_partition(l_tccp, resno, &l_res, &l_part,
+                                                NULL)) {
+                    /* opj_tcd_init_decode_tile() will reject the tile */
+                    return;
+                }
+                l_rw = (OPJ_UINT32)(l_res.x1 - l_res.x0);
+                l_rh = (OPJ_UINT32)(l_res.y1 - l_res.y0);
+
+                if (resno > 0 && resno < l_minres) {
+                    l_max_res_size = opj_uint_max(l_max_res_size, opj_uint_max(l_rw, l_rh));
+                    if (l_decoded && !l_whole_tile_decoding) {
+                        /* Rows of the horizontal pass, then window of the */
+                        /* vertical one, written by opj_dwt_decode_partial_tile() */
+                        /* for the window grown by the filter */
+                        OPJ_UINT32 l_filter_width = (l_tccp->qmfbid == 1) ?
+                                                    OPJ_DWT_FILTER_WIDTH_53 : OPJ_DWT_FILTER_WIDTH_97;
+                        OPJ_UINT32 l_win_w = opj_uint_min(opj_uint_ceildivpow2(tcx1, l_level_no) -
+                                                          opj_uint_ceildivpow2(tcx0, l_level_no) + 4 * l_filter_width, l_rw);
+                        OPJ_UINT32 l_win_h = opj_uint_min(opj_uint_ceildivpow2(tcy1, l_level_no) -
+                                                          opj_uint_ceildivpow2(tcy0, l_level_no) + 4 * l_filter_width, l_rh);
+
+                        l_nb_blocks += (OPJ_UINT64)opj_tcd_sparse_array_span(l_win_w,
+                                       l_block_w, l_res_w) *
+                                       (2 * opj_tcd_sparse_array_span(l_win_h / 2, l_block_h, l_res_h) +
+                                        opj_tcd_sparse_array_span(l_win_h, l_block_h, l_res_h));
+                    }
+                }
+
+                for (bandno = 0; bandno < l_res.numbands; ++bandno) {
+                    opj_tcd_init_band_bounds(&l_tilec, resno, bandno, &l_band);
+
+                    p_cost->tile_memory += (OPJ_UINT64)l_res.pw * l_res.ph *
+                                           sizeof(opj_tcd_precinct_t);
+
+                    for (precno = 0; precno < l_res.pw * l_res.ph; ++precno) {
+                        OPJ_INT32 l_tl_cblk_x, l_tl_cblk_y;
+
+                        opj_tcd_init_precinct_bounds(&l_res, &l_part, &l_band, precno,
+                                                     &l_prc, &l_tl_cblk_x, &l_tl_cblk_y);
+
+                        /* code-blocks, with their default segments, and */
+                        /* inclusion and IMSB tag trees of the precinct */
+                        p_cost->tile_memory += (OPJ_UINT64)l_prc.cw * l_prc.ch *
+                                               (sizeof(opj_tcd_cblk_dec_t) +
+                                                OPJ_J2K_DEFAULT_NB_SEGS * sizeof(opj_tcd_seg_t)) +
+                                               2 * opj_tcd_tgt_memory(l_prc.cw, l_prc.ch);
+
+                        if (!l_decoded || resno >= l_minres ||
+                                !opj_tcd_is_subband_region_of_interest(l_tccp->qmfbid,
+                                        l_numres, tcx0, tcy0, tcx1, tcy1, resno, l_band.bandno,
+                                        (OPJ_UINT32)l_prc.x0, (OPJ_UINT32)l_prc.y0,
+                                        (OPJ_UINT32)l_prc.x1, (OPJ_UINT32)l_prc.y1)) {
+                            continue;
+                        }
+
+                        for (cblkno = 0; cblkno < l_prc.cw * l_prc.ch; ++cblkno) {
+                            OPJ_INT32 cblkx0, cblky0, cblkx1, cblky1;
+                            OPJ_UINT32 l_cblk_w, l_cblk_h;
+
+                            opj_tcd_get_cblk_bounds(&l_prc, &l_part, l_tl_cblk_x,
+                                                    l_tl_cblk_y, cblkno,
+                                                    &cblkx0, &cblky0, &cblkx1, &cblky1);
+                            if (cblkx1 <= cblkx0 || cblky1 <= cblky0 ||
+                                    !opj_tcd_is_subband_region_of_interest(l_tccp->qmfbid,
+                                            l_numres, tcx0, tcy0, tcx1, tcy1, resno, l_band.bandno,
+                                            (OPJ_UINT32)cblkx0, (OPJ_UINT32)cblky0,
+                                            (OPJ_UINT32)cblkx1, (OPJ_UINT32)cblky1)) {
+                                continue;
+                            }
+                            l_cblk_w = (OPJ_UINT32)(cblkx1 - cblkx0);
+                            l_cblk_h = (OPJ_UINT32)(cblky1 - cblky0);
+                            ++p_cost->nb_code_blocks;
+                            l_max_cblk_w = opj_uint_max(l_max_cblk_w, l_cblk_w);
+                            l_max_cblk_h = opj_uint_max(l_max_cblk_h, l_cblk_h);
+                            if (!l_whole_tile_decoding) {
+                                /* decoded samples of the code-block, and */
+                                /* their copy in the sparse array of the DWT, */
+                                /* next to the lower resolution for the */
+                                /* high-pass bands */
+                                OPJ_UINT32 sx = (OPJ_UINT32)(cblkx0 - l_band.x0);
+                                OPJ_UINT32 sy = (OPJ_UINT32)(cblky0 - l_band.y0);
+
+                                if (l_band.bandno & 1) {
+                                    sx += l_low_w;
+                                }
+                                if (l_band.bandno & 2) {
+                                    sy += l_low_h;
+                                }
+                                p_cost->tile_memory += (OPJ_UINT64)l_cblk_w * l_cblk_h *
+                                                       sizeof(OPJ_INT32);
+                                l_nb_blocks += (OPJ_UINT64)((sx + l_cblk_w - 1) / l_block_w -
+                                                            sx / l_block_w + 1) *
+                                               ((sy + l_cblk_h - 1) / l_block_h - sy / l_block_h + 1);
+                            }
+                        }
+                    }
+                }
+                l_low_w = l_rw;
+                l_low_h = l_rh;
+            }
+
+            if (!l_decoded) {
+                continue;
+            }
+
+            if (!l_whole_tile_decoding && l_block_w > 0 && l_block_h > 0) {
+                p_cost->tile_memory += l_nb_blocks * l_block_w * l_block_h *
+                                       sizeof(OPJ_INT32) +
+                                       (OPJ_UINT64)opj_uint_ceildiv(l_res_w, l_block_w) *
+                                       opj_uint_ceildiv(l_res_h, l_block_h) * sizeof(OPJ_INT32*);
+            }
+
+            /* Samples of the tile-component at the decoded resolution */
+            if (l_whole_tile_decoding) {
+                l_data_size = (OPJ_UINT64)l_res_w * l_res_h;
+            } else {
+                l_data_size = (OPJ_UINT64)(opj_uint_ceildivpow2(tcx1, l_numres - l_minres) -
+                                           opj_uint_ceildivpow2(tcx0, l_numres - l_minres)) *
+                              (opj_uint_ceildivpow2(tcy1, l_numres - l_minres) -
+                               opj_uint_ceildivpow2(tcy0, l_numres - l_minres));
+            }
+            p_cost->data_memory += l_data_size * sizeof(OPJ_INT32);
+
+            /* Tier-1 buffers of a code-block (see opj_t1_allocate_buffers()), */
+            /* and DWT buffers, processing up to 16 columns at a time */
+            l_data_size = (OPJ_UINT64)l_max_cblk_w * l_max_cblk_h * sizeof(OPJ_INT32) +
+                          (OPJ_UINT64)(l_max_cblk_w + 2) * ((l_max_cblk_h + 3) / 4 + 2) *
+                          sizeof(opj_flag_t) +
+                          (OPJ_UINT64)l_max_res_size * 16 * sizeof(OPJ_INT32);
+            if (l_data_size > p_cost->thread_memory) {
+                p_cost->thread_memory = l_data_size;
+            }
+        }
+    }
+    p_cost->tile_memory += p_cost->data_memory;
 }
 
 /* ----------------------------------------------------------------------- */
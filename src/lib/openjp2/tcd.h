@@ -245,6 +245,9 @@ typedef struct opj_tcd_image {
 opj_tcd_image_t;
 
 
+/** Line-based encoding state of a tile (see opj_tcd_start_encode_tile_lines()) */
+typedef struct opj_tcd_line_encoder opj_tcd_line_encoder_t;
+
 /**
 Tile coder/decoder
 */
@@ -282,6 +285,20 @@ typedef struct opj_tcd {
     OPJ_BOOL   whole_tile_decoding;
     /* Array of size image->numcomps indicating if a component must be decoded. NULL if all components must be decoded */
     OPJ_BOOL* used_component;
+    /** Only valid for decoding. Cache of decoded code-blocks, or NULL. Owned by the codec */
+    struct opj_t1_cblk_cache* cblk_cache;
+    /** Only valid for decoding. Tier-1 decoding jobs of the tile, or NULL */
+    struct opj_t1_decode_jobs* t1_decode_jobs;
+    /** Only valid for decoding. Whether the Tier-1 decoding state of code-blocks must be kept in cblk_cache */
+    OPJ_BOOL keep_t1_state;
+    /** Only valid for decoding. Maximum number of coding passes decoded per code-block, 0 for no limit */
+    OPJ_UINT32 max_cblk_passes;
+    /** Only valid for encoding. Whether the data of the current tile has already been DC level shifted by opj_tcd_copy_tile_data_interleaved(). Cleared by opj_tcd_init_encode_tile() */
+    OPJ_BOOL   dc_level_shift_done;
+    /** Only valid for encoding. Line-based encoding state of the current tile, or NULL */
+    opj_tcd_line_encoder_t* line_encoder;
+    /** Requests to stop the operation in progress, or NULL. Not const, as Tier-1 decoding records in it the code-blocks it skipped */
+    opj_interrupt_t* interrupt;
 } opj_tcd_t;
 
 /**
@@ -475,6 +492,62 @@ OPJ_BOOL opj_tcd_copy_tile_data(opj_tcd_t *p_tcd,
                                 OPJ_BYTE * p_src,
                                 OPJ_SIZE_T p_src_length);
 
+/**
+ * Fills the tile component data of the current tile from an interleaved
+ * buffer covering the whole image, and applies the DC level shift (and the
+ * conversion to float for the irreversible transform) at the same time.
+ *
+ * The tile component data of tile p_tile_no must have been allocated.
+ */
+void opj_tcd_copy_tile_data_interleaved(opj_tcd_t *p_tcd,
+                                        OPJ_UINT32 p_tile_no,
+                                        const opj_interleaved_buffer_t *p_buffer);
+
+/**
+ * Starts the line-based encoding of a tile, as an alternative to filling the
+ * tile component data. The lines are then given with
+ * opj_tcd_encode_tile_lines(): DC level shift, MCT, DWT and T1 are done as
+ * they arrive, so that only a few code-block heights of samples are kept in
+ * memory, and opj_tcd_encode_tile() only performs the rate allocation and T2.
+ *
+ * The tile must have been initialized with opj_tcd_init_encode_tile(), and
+ * its components must not be subsampled.
+ *
+ * @param   p_tcd       TCD handle.
+ * @param   p_tile_no   current tile index to encode.
+ * @param   p_manager   the event manager.
+ * @return OPJ_FALSE in case of memory allocation failure.
+ */
+OPJ_BOOL opj_tcd_start_encode_tile_lines(opj_tcd_t *p_tcd,
+        OPJ_UINT32 p_tile_no,
+        opj_event_mgr_t *p_manager);
+
+/**
+ * Gives the next lines of the tile being encoded by the line-based encoder.
+ *
+ * @param   p_tcd       TCD handle.
+ * @param   p_nb_lines  number of lines.
+ * @param   p_src       for each component, p_nb_lines consecutive lines of
+ *                      the tile component, with the same sample size as in
+ *                      opj_tcd_copy_tile_data().
+ * @param   p_manager   the event manager.
+ */
+OPJ_BOOL opj_tcd_encode_tile_lines(opj_tcd_t *p_tcd,
+                                   OPJ_UINT32 p_nb_lines,
+                                   const OPJ_BYTE * const * p_src,
+                                   opj_event_mgr_t *p_manager);
+
+/**
+ * Allocates data for an encoding code block, if not already large enough.
+ */
+OPJ_BOOL opj_tcd_code_block_enc_allocate_data(opj_tcd_cblk_enc_t *
+        p_code_block);
+
+/**
+ * Reduces the data of an encoded code block to its compressed bytes.
+ */
+void opj_tcd_code_block_enc_shrink_data(opj_tcd_cblk_enc_t * p_code_block);
+
 /**
  * Allocates tile component data
  *
@@ -515,6 +588,58 @@ OPJ_BOOL opj_tcd_is_subband_area_of_interest(opj_tcd_t *tcd,
         OPJ_UINT32 x1,
         OPJ_UINT32 y1);
 
+/** Returns whether the operation in progress must stop: it has been
+ * cancelled, or its deadline is past.
+ *
+ * @param p_interrupt the interruption requests, or NULL
+ * @return OPJ_TRUE if no more code-blocks and tiles must be processed.
+ */
+OPJ_BOOL opj_tcd_is_interrupted(const opj_interrupt_t* p_interrupt);
+
+/**
+ * Resources needed to decode a tile, as estimated by
+ * opj_tcd_estimate_decode_tile()
+ */
+typedef struct opj_tcd_decode_cost {
+    /** number of code-blocks decoded by Tier-1 */
+    OPJ_UINT64 nb_code_blocks;
+    /** memory of the tile structures and samples, in bytes */
+    OPJ_UINT64 tile_memory;
+    /** part of tile_memory taken by the samples at the decoded resolution */
+    OPJ_UINT64 data_memory;
+    /** memory of the Tier-1 and DWT buffers of each thread, in bytes */
+    OPJ_UINT64 thread_memory;
+} opj_tcd_decode_cost_t;
+
+/**
+ * Estimates the resources needed to decode a tile, from the coding
+ * parameters known so far, without allocating anything.
+ *
+ * @param p_tcd             TCD handle, initialized with opj_tcd_init().
+ * @param p_tile_no         Index of the tile.
+ * @param p_tcp             Coding parameters of the tile.
+ * @param win_x0            Upper left x of region to decode (in grid coordinates)
+ * @param win_y0            Upper left y of region to decode (in grid coordinates)
+ * @param win_x1            Lower right x of region to decode (in grid coordinates)
+ * @param win_y1            Lower right y of region to decode (in grid coordinates)
+ * @param numcomps_to_decode  Size of the comps_indices array, or 0 to decode all components.
+ * @param comps_indices     Array of numcomps values representing the indices
+ *                          of the components to decode (relative to the
+ *                          codestream, starting at 0). Or NULL if all components
+ *                          must be decoded.
+ * @param p_cost            Estimated resources.
+ */
+void opj_tcd_estimate_decode_tile(opj_tcd_t *p_tcd,
+                                  OPJ_UINT32 p_tile_no,
+                                  opj_tcp_t *p_tcp,
+                                  OPJ_UINT32 win_x0,
+                                  OPJ_UINT32 win_y0,
+                                  OPJ_UINT32 win_x1,
+                                  OPJ_UINT32 win_y1,
+                                  OPJ_UINT32 numcomps_to_decode,
+                                  const OPJ_UINT32 *comps_indices,
+                                  opj_tcd_decode_cost_t *p_cost);
+
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
@@ -315,6 +315,14 @@ OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree,
     stkptr = stk;
     node = &tree->nodes[leafno];
     while (node->parent) {
+        /* The value of a node is lower bounded by node->low, and so are */
+        /* the values of its descendants. Once node->low has reached the */
+        /* threshold, no more bits can be read for this threshold, by this */
+        /* node nor by its ancestors (whose value is then known or whose low */
+        /* is at least as large) */
+        if (node->low >= threshold) {
+            return (tree->nodes[leafno].value < threshold) ? 1 : 0;
+        }
         *stkptr++ = node;
         node = node->parent;
     }
@@ -326,11 +334,26 @@ OPJ_UINT32 opj_tgt_decode(opj_bio_t *bio, opj_tgt_tree_t *tree,
         } else {
             low = node->low;
         }
+        /* Read the run of 0 bits, up to the first 1 bit, that raises low */
+        /* up to the value of the node, stopping at the threshold */
         while (low < threshold && low < node->value) {
-            if (opj_bio_read(bio, 1)) {
+            OPJ_UINT32 l_nb_bits = (OPJ_UINT32)(opj_int_min(threshold,
+                                                node->value) - low);
+            OPJ_UINT32 l_bits, l_zeros = 0;
+            if (l_nb_bits > 32) {
+                l_nb_bits = 32;
+            }
+            l_bits = opj_bio_peek(bio, l_nb_bits);
+            while (l_zeros < l_nb_bits &&
+                    !(l_bits & (1U << (l_nb_bits - 1 - l_zeros)))) {
+                ++l_zeros;
+            }
+            low += (OPJ_INT32)l_zeros;
+            if (l_zeros < l_nb_bits) {
+                opj_bio_skip(bio, l_zeros + 1);
                 node->value = low;
             } else {
-                ++low;
+                opj_bio_skip(bio, l_zeros);
             }
         }
         node->low = low;
@@ -573,6 +573,10 @@ OPJ_BOOL opj_tls_set(opj_tls_t* tls, int key, void* value,
 typedef struct {
     opj_job_fn          job_fn;
     void               *user_data;
+#ifdef OPJ_USE_PERF_COUNTERS
+    /** Pipeline stage of the thread that submitted the job, or -1 */
+    int                 perf_stage;
+#endif
 } opj_worker_thread_job_t;
 
 typedef struct {
@@ -591,7 +595,7 @@ typedef enum {
 } opj_worker_thread_state;
 
 struct opj_job_list_t {
-    opj_worker_thread_job_t* job;
+    opj_worker_thread_job_t job;
     struct opj_job_list_t* next;
 };
 typedef struct opj_job_list_t opj_job_list_t;
@@ -609,6 +613,8 @@ struct opj_thread_pool_t {
     opj_mutex_t*                     mutex;
     volatile opj_worker_thread_state state;
     opj_job_list_t*                  job_queue;
+    /* Descriptors of finished jobs, recycled by opj_thread_pool_submit_job() */
+    opj_job_list_t*                  free_jobs;
     volatile int                     pending_jobs_count;
     opj_worker_thread_list_t*        waiting_worker_thread_list;
     int                              waiting_worker_thread_count;
@@ -617,10 +623,10 @@ struct opj_thread_pool_t {
 };
 
 static OPJ_BOOL opj_thread_pool_setup(opj_thread_pool_t* tp, int num_threads);
-static opj_worker_thread_job_t* opj_thread_pool_get_next_job(
+static opj_job_list_t* opj_thread_pool_get_next_job(
     opj_thread_pool_t* tp,
     opj_worker_thread_t* worker_thread,
-    OPJ_BOOL signal_job_finished);
+    opj_job_list_t* finished_job);
 
 opj_thread_pool_t* opj_thread_pool_create(int num_threads)
 {
@@ -632,17 +638,19 @@ opj_thread_pool_t* opj_thread_pool_create(int num_threads)
     }
     tp->state = OPJWTS_OK;
 
+    /* Also used by opj_thread_pool_run_job() when there are worker threads */
+    tp->tls = opj_tls_new();
+    if (!tp->tls) {
+        opj_free(tp);
+        return NULL;
+    }
     if (num_threads <= 0) {
-        tp->tls = opj_tls_new();
-        if (!tp->tls) {
-            opj_free(tp);
-            tp = NULL;
-        }
         return tp;
     }
 
     tp->mutex = opj_mutex_create();
     if (!tp->mutex) {
+        opj_tls_destroy(tp->tls);
         opj_free(tp);
         return NULL;
     }
@@ -658,24 +666,30 @@ static void opj_worker_thread_function(void* user_data)
     opj_worker_thread_t* worker_thread;
     opj_thread_pool_t* tp;
     opj_tls_t* tls;
-    OPJ_BOOL job_finished = OPJ_FALSE;
+    opj_job_list_t* item = NULL;
 
     worker_thread = (opj_worker_thread_t*) user_data;
     tp = worker_thread->tp;
     tls = opj_tls_new();
 
     while (OPJ_TRUE) {
-        opj_worker_thread_job_t* job = opj_thread_pool_get_next_job(tp, worker_thread,
-                                       job_finished);
-        if (job == NULL) {
+        opj_worker_thread_job_t* job;
+
+        item = opj_thread_pool_get_next_job(tp, worker_thread, item);
+        if (item == NULL) {
             break;
         }
+        job = &item->job;
 
         if (job->job_fn) {
+#ifdef OPJ_USE_PERF_COUNTERS
+            opj_perf_start(job->perf_stage);
+#endif
             job->job_fn(job->user_data, tls);
+#ifdef OPJ_USE_PERF_COUNTERS
+            opj_perf_stop(job->perf_stage);
+#endif
         }
-        opj_free(job);
-        job_finished = OPJ_TRUE;
     }
 
     opj_tls_destroy(tls);
@@ -754,18 +768,20 @@ void opj_waiting()
 }
 */
 
-static opj_worker_thread_job_t* opj_thread_pool_get_next_job(
+static opj_job_list_t* opj_thread_pool_get_next_job(
     opj_thread_pool_t* tp,
     opj_worker_thread_t* worker_thread,
-    OPJ_BOOL signal_job_finished)
+    opj_job_list_t* finished_job)
 {
     while (OPJ_TRUE) {
         opj_job_list_t* top_job_iter;
 
         opj_mutex_lock(tp->mutex);
 
-        if (signal_job_finished) {
-            signal_job_finished = OPJ_FALSE;
+        if (finished_job) {
+            finished_job->next = tp->free_jobs;
+            tp->free_jobs = finished_job;
+            finished_job = NULL;
             tp->pending_jobs_count --;
             /*printf("tp=%p, remaining jobs: %d\n", tp, tp->pending_jobs_count);*/
             if (tp->pending_jobs_count <= tp->signaling_threshold) {
@@ -779,13 +795,9 @@ static opj_worker_thread_job_t* opj_thread_pool_get_next_job(
         }
         top_job_iter = tp->job_queue;
         if (top_job_iter) {
-            opj_worker_thread_job_t* job;
             tp->job_queue = top_job_iter->next;
-
-            job = top_job_iter->job;
             opj_mutex_unlock(tp->mutex);
-            opj_free(top_job_iter);
-            return job;
+            return top_job_iter;
         }
 
         /* opj_waiting(); */
@@ -828,7 +840,6 @@ OPJ_BOOL opj_thread_pool_submit_job(opj_thread_pool_t* tp,
                                     opj_job_fn job_fn,
                                     void* user_data)
 {
-    opj_worker_thread_job_t* job;
     opj_job_list_t* item;
 
     if (tp->mutex == NULL) {
@@ -836,20 +847,6 @@ OPJ_BOOL opj_thread_pool_submit_job(opj_thread_pool_t* tp,
         return OPJ_TRUE;
     }
 
-    job = (opj_worker_thread_job_t*)opj_malloc(sizeof(opj_worker_thread_job_t));
-    if (job == NULL) {
-        return OPJ_FALSE;
-    }
-    job->job_fn = job_fn;
-    job->user_data = user_data;
-
-    item = (opj_job_list_t*) opj_malloc(sizeof(opj_job_list_t));
-    if (item == NULL) {
-        opj_free(job);
-        return OPJ_FALSE;
-    }
-    item->job = job;
-
     opj_mutex_lock(tp->mutex);
 
     tp->signaling_threshold = 100 * tp->worker_threads_count;
@@ -859,6 +856,22 @@ OPJ_BOOL opj_thread_pool_submit_job(opj_thread_pool_t* tp,
         /* printf("...%d jobs enqueued.\n", tp->pending_jobs_count); */
     }
 
+    item = tp->free_jobs;
+    if (item != NULL) {
+        tp->free_jobs = item->next;
+    } else {
+        item = (opj_job_list_t*) opj_malloc(sizeof(opj_job_list_t));
+        if (item == NULL) {
+            opj_mutex_unlock(tp->mutex);
+            return OPJ_FALSE;
+        }
+    }
+    item->job.job_fn = job_fn;
+    item->job.user_data = user_data;
+#ifdef OPJ_USE_PERF_COUNTERS
+    item->job.perf_stage = opj_perf_current_stage();
+#endif
+
     item->next = tp->job_queue;
     tp->job_queue = item;
     tp->pending_jobs_count ++;
@@ -891,6 +904,13 @@ OPJ_BOOL opj_thread_pool_submit_job(opj_thread_pool_t* tp,
     return OPJ_TRUE;
 }
 
+void opj_thread_pool_run_job(opj_thread_pool_t* tp,
+                             opj_job_fn job_fn,
+                             void* user_data)
+{
+    job_fn(user_data, tp->tls);
+}
+
 void opj_thread_pool_wait_completion(opj_thread_pool_t* tp,
                                      int max_remaining_jobs)
 {
@@ -946,6 +966,12 @@ void opj_thread_pool_destroy(opj_thread_pool_t* tp)
             tp->waiting_worker_thread_list = next;
         }
 
+        while (tp->free_jobs != NULL) {
+            opj_job_list_t* next = tp->free_jobs->next;
+            opj_free(tp->free_jobs);
+            tp->free_jobs = next;
+        }
+
         opj_cond_destroy(tp->cond);
     }
     opj_mutex_destroy(tp->mutex);
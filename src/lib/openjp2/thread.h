@@ -225,6 +225,18 @@ typedef void (*opj_job_fn)(void* user_data, opj_tls_t* tls);
 OPJ_BOOL opj_thread_pool_submit_job(opj_thread_pool_t* tp, opj_job_fn job_fn,
                                     void* user_data);
 
+/** Run a job in the calling thread, with the thread local storage that the
+ * thread pool reserves for it. Used when a job is too small to be worth
+ * handing off to a worker thread. The calling thread must be the one that
+ * submits the jobs of the thread pool.
+ *
+ * @param tp the thread pool handle.
+ * @param job_fn Function to run. Must not be NULL.
+ * @param user_data User data provided to thread_fn.
+ */
+void opj_thread_pool_run_job(opj_thread_pool_t* tp, opj_job_fn job_fn,
+                             void* user_data);
+
 /** Wait that no more than max_remaining_jobs jobs are remaining in the queue of
  * the thread pool. The aim of this function is to avoid submitting too many
  * jobs while the thread pool cannot cope fast enough with them, which would
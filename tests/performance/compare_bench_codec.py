@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Compares the JSON outputs of bench_codec for two builds, and flags the
+# stages whose time, or the peak memory, regressed beyond a threshold.
+
+import json
+import sys
+
+
+def Usage():
+    print('Usage: compare_bench_codec.py [-noise_threshold val_in_pct]')
+    print('                              [-error_threshold val_in_pct]')
+    print('                              [-memory_threshold val_in_pct]')
+    print('                              [-min_delta_ms val]')
+    print('                              ref.json new.json')
+    sys.exit(1)
+
+ref_filename = None
+new_filename = None
+noise_threshold = 2
+error_threshold = 5
+memory_threshold = 10
+# Variations of less than that are noise, whatever their percentage
+min_delta_ms = 0.5
+i = 1
+while i < len(sys.argv):
+    if sys.argv[i] == '-noise_threshold' and i + 1 < len(sys.argv):
+        i += 1
+        noise_threshold = float(sys.argv[i])
+    elif sys.argv[i] == '-error_threshold' and i + 1 < len(sys.argv):
+        i += 1
+        error_threshold = float(sys.argv[i])
+    elif sys.argv[i] == '-memory_threshold' and i + 1 < len(sys.argv):
+        i += 1
+        memory_threshold = float(sys.argv[i])
+    elif sys.argv[i] == '-min_delta_ms' and i + 1 < len(sys.argv):
+        i += 1
+        min_delta_ms = float(sys.argv[i])
+    elif sys.argv[i][0] == '-':
+        Usage()
+    elif ref_filename is None:
+        ref_filename = sys.argv[i]
+    elif new_filename is None:
+        new_filename = sys.argv[i]
+    else:
+        Usage()
+    i += 1
+if ref_filename is None or new_filename is None:
+    Usage()
+
+assert noise_threshold < error_threshold
+
+ref = json.load(open(ref_filename, 'rt'))
+new = json.load(open(new_filename, 'rt'))
+if ref['image'] != new['image']:
+    raise Exception('files are not comparable: images differ')
+
+config_keys = ('num_threads', 'tile_size', 'cblk_size', 'mode', 'layers',
+               'region')
+stages = ('encode_ms', 'read_header_ms', 'decode_ms', 'region_decode_ms')
+
+
+def config_of(result):
+    return tuple(str(result.get(k)) for k in config_keys)
+
+new_results = {}
+for result in new['results']:
+    new_results[config_of(result)] = result
+
+ret_code = 0
+for result_ref in ref['results']:
+    config = config_of(result_ref)
+    display = ', '.join('%s=%s' % (k, v) for k, v in zip(config_keys, config)
+                        if v != 'None')
+    if config not in new_results:
+        print('%s: missing in %s' % (display, new_filename))
+        ret_code = 1
+        continue
+    result_new = new_results[config]
+    for stage in stages:
+        if stage not in result_ref or stage not in result_new:
+            continue
+        time_ref = result_ref[stage]
+        time_new = result_new[stage]
+        line = '%s, %s: ref %.3f ms, new %.3f ms' % (display, stage,
+                                                     time_ref, time_new)
+        if time_ref <= 0:
+            print(line)
+            continue
+        var_pct = 100.0 * (time_new - time_ref) / time_ref
+        stable = abs(var_pct) <= noise_threshold or \
+            abs(time_new - time_ref) <= min_delta_ms
+        if stable:
+            line += ', (stable) %0.1f %%' % var_pct
+        elif var_pct < 0:
+            line += ', (improvement) %0.1f %%' % var_pct
+        else:
+            line += ', (regression) %0.1f %%' % var_pct
+        if not stable and var_pct > error_threshold:
+            line += ', ERROR_THRESHOLD'
+            ret_code = 1
+        print(line)
+    if result_ref['codestream_bytes'] != result_new['codestream_bytes']:
+        print('%s: codestream size changed from %d to %d bytes' %
+              (display, result_ref['codestream_bytes'],
+               result_new['codestream_bytes']))
+    rss_ref = result_ref['peak_rss_kb']
+    rss_new = result_new['peak_rss_kb']
+    if rss_ref > 0 and rss_new > 0:
+        var_pct = 100.0 * (rss_new - rss_ref) / rss_ref
+        line = '%s, peak_rss: ref %d kB, new %d kB, %0.1f %%' % \
+            (display, rss_ref, rss_new, var_pct)
+        if var_pct > memory_threshold:
+            line += ', ERROR_THRESHOLD'
+            ret_code = 1
+        print(line)
+
+sys.exit(ret_code)
@@ -0,0 +1,383 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks opj_encode_async() and opj_decode_async(), and the interruption of */
+/* an operation by opj_cancel() and by the deadline of */
+/* opj_decoder_set_deadline(). */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+#define IMAGE_SIZE 256
+#define TILE_SIZE 64
+#define NB_TILES ((IMAGE_SIZE / TILE_SIZE) * (IMAGE_SIZE / TILE_SIZE))
+#define NUMCOMPS 3
+
+typedef struct {
+    int nb_calls;
+    OPJ_BOOL success;
+} completion_t;
+
+/* Actions triggered by the messages of the codec */
+static opj_codec_t* g_codec_to_cancel = NULL;
+/* Beginning of the message after which the decoding waits, or NULL, and */
+/* the duration of the wait */
+static const char* g_wait_after_tile = NULL;
+static clock_t g_wait_duration = CLOCKS_PER_SEC / 20;
+static OPJ_BOOL g_deadline_reached = OPJ_FALSE;
+
+static void completion_callback(opj_codec_t p_codec, OPJ_BOOL success,
+                                void *client_data)
+{
+    completion_t* l_completion = (completion_t*)client_data;
+    (void)p_codec;
+    l_completion->nb_calls ++;
+    l_completion->success = success;
+}
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    if (strstr(msg, "cancelled") == NULL) {
+        fprintf(stdout, "[ERROR] %s", msg);
+    }
+}
+
+static void warning_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    if (strstr(msg, "deadline") != NULL) {
+        g_deadline_reached = OPJ_TRUE;
+    }
+}
+
+static void info_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    if (g_codec_to_cancel && strncmp(msg, "Tile 1/", 7) == 0) {
+        opj_cancel(g_codec_to_cancel);
+    }
+    if (g_wait_after_tile &&
+            strncmp(msg, g_wait_after_tile, strlen(g_wait_after_tile)) == 0) {
+        /* Busy wait, so that the processor time is also elapsed time */
+        clock_t l_start = clock();
+        while (clock() - l_start < g_wait_duration) {
+        }
+    }
+}
+
+/* Cancels the encoding once the first tile has been written */
+static OPJ_SIZE_T write_and_cancel(void * p_buffer, OPJ_SIZE_T p_nb_bytes,
+                                   void * p_user_data)
+{
+    OPJ_SIZE_T* l_written = (OPJ_SIZE_T*)p_user_data;
+    (void)p_buffer;
+    *l_written += p_nb_bytes;
+    if (*l_written > 1000 && g_codec_to_cancel) {
+        opj_cancel(g_codec_to_cancel);
+    }
+    return p_nb_bytes;
+}
+
+static opj_image_t* create_image(void)
+{
+    opj_image_cmptparm_t l_params[NUMCOMPS];
+    opj_image_t * l_image;
+    OPJ_UINT32 compno, i;
+
+    memset(l_params, 0, sizeof(l_params));
+    for (compno = 0; compno < NUMCOMPS; ++compno) {
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = IMAGE_SIZE;
+        l_params[compno].h = IMAGE_SIZE;
+        l_params[compno].prec = 8;
+    }
+    l_image = opj_image_create(NUMCOMPS, l_params, OPJ_CLRSPC_SRGB);
+    if (!l_image) {
+        return NULL;
+    }
+    l_image->x1 = IMAGE_SIZE;
+    l_image->y1 = IMAGE_SIZE;
+    for (compno = 0; compno < NUMCOMPS; ++compno) {
+        for (i = 0; i < IMAGE_SIZE * IMAGE_SIZE; ++i) {
+            /* Never 0 once decoded */
+            l_image->comps[compno].data[i] = (OPJ_INT32)(1 + ((i * (compno + 3) +
+                                             (i >> 7)) % 255));
+        }
+    }
+    return l_image;
+}
+
+/* Encodes the image asynchronously, into filename or, if filename is NULL, */
+/* into a stream that cancels the encoding after its first tile */
+static OPJ_BOOL encode(const char* filename, completion_t* p_completion)
+{
+    opj_cparameters_t l_param;
+    opj_codec_t * l_codec;
+    opj_image_t * l_image;
+    opj_stream_t * l_stream;
+    OPJ_SIZE_T l_written = 0;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tile_size_on = OPJ_TRUE;
+    l_param.cp_tdx = TILE_SIZE;
+    l_param.cp_tdy = TILE_SIZE;
+
+    l_image = create_image();
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    l_codec = opj_create_compress(OPJ_CODEC_J2K);
+    opj_set_error_handler(l_codec, error_callback, 00);
+    if (filename) {
+        l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    } else {
+        l_stream = opj_stream_create(256, OPJ_FALSE);
+        opj_stream_set_write_function(l_stream, write_and_cancel);
+        opj_stream_set_user_data(l_stream, &l_written, NULL);
+        g_codec_to_cancel = l_codec;
+    }
+    if (l_stream &&
+            opj_setup_encoder(l_codec, &l_param, l_image) &&
+            opj_start_compress(l_codec, l_image, l_stream) &&
+            opj_encode_async(l_codec, l_stream, completion_callback, p_completion)) {
+        ret = opj_wait_completion(l_codec) == p_completion->success &&
+              (!p_completion->success || opj_end_compress(l_codec, l_stream));
+    }
+    g_codec_to_cancel = NULL;
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+/* Decodes filename synchronously, or asynchronously if p_completion is not */
+/* NULL, with the given deadline, and cancelling the decoding after the */
+/* first tile if cancel is set */
+static opj_image_t* decode(const char* filename, completion_t* p_completion,
+                           OPJ_UINT32 deadline_ms, OPJ_BOOL cancel)
+{
+    opj_dparameters_t l_param;
+    opj_image_t* l_image = NULL;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    OPJ_BOOL l_ok = OPJ_FALSE;
+
+    l_codec = opj_create_decompress(OPJ_CODEC_J2K);
+    if (!l_codec) {
+        return NULL;
+    }
+    opj_set_error_handler(l_codec, error_callback, 00);
+    opj_set_warning_handler(l_codec, warning_callback, 00);
+    opj_set_info_handler(l_codec, info_callback, 00);
+    opj_set_default_decoder_parameters(&l_param);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (cancel) {
+        g_codec_to_cancel = l_codec;
+    }
+    if (l_stream &&
+            opj_setup_decoder(l_codec, &l_param) &&
+            (opj_has_thread_support() ? opj_codec_set_threads(l_codec, 2) : OPJ_TRUE) &&
+            opj_decoder_set_deadline(l_codec, deadline_ms) &&
+            opj_read_header(l_stream, l_codec, &l_image)) {
+        if (p_completion) {
+            l_ok = opj_decode_async(l_codec, l_stream, l_image, completion_callback,
+                                    p_completion) &&
+                   opj_wait_completion(l_codec);
+        } else {
+            l_ok = opj_decode(l_codec, l_stream, l_image);
+        }
+        l_ok = l_ok && opj_end_decompress(l_codec, l_stream);
+    }
+    g_codec_to_cancel = NULL;
+    if (!l_ok) {
+        opj_image_destroy(l_image);
+        l_image = NULL;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return l_image;
+}
+
+/* Returns the number of samples of the tile that differ in the two images */
+static OPJ_UINT32 diff_tile(const opj_image_t* image1, const opj_image_t* image2,
+                            OPJ_UINT32 tileno)
+{
+    OPJ_UINT32 compno, x, y, diff = 0;
+    OPJ_UINT32 x0 = (tileno % (IMAGE_SIZE / TILE_SIZE)) * TILE_SIZE;
+    OPJ_UINT32 y0 = (tileno / (IMAGE_SIZE / TILE_SIZE)) * TILE_SIZE;
+    for (compno = 0; compno < NUMCOMPS; ++compno) {
+        for (y = y0; y < y0 + TILE_SIZE; ++y) {
+            for (x = x0; x < x0 + TILE_SIZE; ++x) {
+                if (image1->comps[compno].data[y * IMAGE_SIZE + x] !=
+                        image2->comps[compno].data[y * IMAGE_SIZE + x]) {
+                    diff ++;
+                }
+            }
+        }
+    }
+    return diff;
+}
+
+int main(void)
+{
+    const char* filename = "test_async_codec.j2k";
+    completion_t l_completion;
+    opj_image_t* l_ref;
+    opj_image_t* l_image;
+    opj_image_t* l_zero;
+    OPJ_UINT32 tileno, compno;
+    char l_last_tile_msg[32];
+    int ret = 0;
+
+    sprintf(l_last_tile_msg, "Tile %d/", NB_TILES);
+
+    memset(&l_completion, 0, sizeof(l_completion));
+    if (!encode(filename, &l_completion) || l_completion.nb_calls != 1 ||
+            !l_completion.success) {
+        fprintf(stderr, "Asynchronous encoding failed\n");
+        return 1;
+    }
+    memset(&l_completion, 0, sizeof(l_completion));
+    if (!encode(NULL, &l_completion) || l_completion.nb_calls != 1 ||
+            l_completion.success) {
+        fprintf(stderr, "Asynchronous encoding not cancelled\n");
+        return 1;
+    }
+
+    l_ref = decode(filename, NULL, 0, OPJ_FALSE);
+    if (!l_ref) {
+        fprintf(stderr, "Decoding failed\n");
+        return 1;
+    }
+    l_zero = create_image();
+    for (compno = 0; compno < NUMCOMPS; ++compno) {
+        memset(l_zero->comps[compno].data, 0,
+               IMAGE_SIZE * IMAGE_SIZE * sizeof(OPJ_INT32));
+    }
+
+    /* Same image as with opj_decode() */
+    memset(&l_completion, 0, sizeof(l_completion));
+    l_image = decode(filename, &l_completion, 0, OPJ_FALSE);
+    if (!l_image || l_completion.nb_calls != 1 || !l_completion.success) {
+        fprintf(stderr, "Asynchronous decoding failed\n");
+        ret = 1;
+    } else {
+        for (tileno = 0; tileno < NB_TILES; ++tileno) {
+            if (diff_tile(l_ref, l_image, tileno) != 0) {
+                fprintf(stderr, "Asynchronous decoding differs in tile %u\n", tileno);
+                ret = 1;
+                break;
+            }
+        }
+    }
+    opj_image_destroy(l_image);
+
+    /* Cancelled after the first tile */
+    memset(&l_completion, 0, sizeof(l_completion));
+    l_image = decode(filename, &l_completion, 0, OPJ_TRUE);
+    if (l_image || l_completion.nb_calls != 1 || l_completion.success) {
+        fprintf(stderr, "Asynchronous decoding not cancelled\n");
+        ret = 1;
+    }
+    opj_image_destroy(l_image);
+    l_image = decode(filename, NULL, 0, OPJ_TRUE);
+    if (l_image) {
+        fprintf(stderr, "Decoding not cancelled\n");
+        ret = 1;
+    }
+    opj_image_destroy(l_image);
+
+    /* Deadline reached after the first tile: the image is returned, with */
+    /* the tiles after the first one left to zero */
+    g_wait_after_tile = "Tile 1/";
+    memset(&l_completion, 0, sizeof(l_completion));
+    l_image = decode(filename, &l_completion, 10, OPJ_FALSE);
+    if (!l_image || l_completion.nb_calls != 1 || !l_completion.success ||
+            !g_deadline_reached) {
+        fprintf(stderr, "Decoding with a deadline failed\n");
+        ret = 1;
+    } else {
+        for (tileno = 1; tileno < NB_TILES; ++tileno) {
+            if (diff_tile(l_zero, l_image, tileno) != 0) {
+                fprintf(stderr, "Tile %u decoded after the deadline\n", tileno);
+                ret = 1;
+                break;
+            }
+        }
+    }
+    opj_image_destroy(l_image);
+
+    /* Deadline reached after the last tile: the image is complete, without */
+    /* warning */
+    g_wait_after_tile = l_last_tile_msg;
+    g_wait_duration = CLOCKS_PER_SEC / 2;
+    g_deadline_reached = OPJ_FALSE;
+    l_image = decode(filename, NULL, 300, OPJ_FALSE);
+    if (!l_image || g_deadline_reached) {
+        fprintf(stderr, "Decoding with a deadline after the last tile failed\n");
+        ret = 1;
+    } else {
+        for (tileno = 0; tileno < NB_TILES; ++tileno) {
+            if (diff_tile(l_ref, l_image, tileno) != 0) {
+                fprintf(stderr, "Tile %u not decoded before the deadline\n",
+                        tileno);
+                ret = 1;
+                break;
+            }
+        }
+    }
+    opj_image_destroy(l_image);
+    g_wait_after_tile = NULL;
+    g_wait_duration = CLOCKS_PER_SEC / 20;
+
+    /* A deadline that is not reached does not change the image */
+    g_deadline_reached = OPJ_FALSE;
+    l_image = decode(filename, NULL, 60000, OPJ_FALSE);
+    if (!l_image || g_deadline_reached) {
+        fprintf(stderr, "Decoding with a distant deadline failed\n");
+        ret = 1;
+    } else if (diff_tile(l_ref, l_image, NB_TILES - 1) != 0) {
+        fprintf(stderr, "Decoding with a distant deadline differs\n");
+        ret = 1;
+    }
+    opj_image_destroy(l_image);
+
+    opj_image_destroy(l_zero);
+    opj_image_destroy(l_ref);
+    return ret;
+}
@@ -0,0 +1,233 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that decoding a series of overlapping areas with a decompressor */
+/* whose code-block cache is enabled, reset with opj_decoder_reset() between */
+/* them, gives the same images as decoding each area with a new */
+/* decompressor, including when the decoding parameters or the codestream */
+/* change from one area to the next. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define IMAGE_WIDTH 301
+#define IMAGE_HEIGHT 203
+
+typedef struct {
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int irreversible;
+    int roi_shift; /* 0 for no ROI */
+} stream_desc_t;
+
+typedef struct {
+    OPJ_INT32 x0, y0, x1, y1; /* all 0 for the whole image */
+    OPJ_UINT32 reduce;
+    OPJ_UINT32 layers;
+    OPJ_UINT32 seed; /* of the codestream to decode */
+} area_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    /* The bottom right quarter is the same for all seeds */
+    if (x > IMAGE_WIDTH / 2 && y > IMAGE_HEIGHT / 2) {
+        seed = 0;
+    }
+    return (OPJ_INT32)((x * (compno + 1) + y * (seed + 2) + ((x * y + seed) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc,
+                       OPJ_UINT32 seed)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    int layno;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 4;
+    l_param.cp_disto_alloc = 1;
+    for (layno = 0; layno < l_param.tcp_numlayers; ++layno) {
+        l_param.tcp_rates[layno] = (float)(40 >> layno);
+    }
+    if (!desc->irreversible) {
+        l_param.tcp_rates[l_param.tcp_numlayers - 1] = 0;
+    }
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 32;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+    if (desc->roi_shift) {
+        l_param.roi_compno = 0;
+        l_param.roi_shift = desc->roi_shift;
+    }
+
+    l_image = test_create_image(3, IMAGE_WIDTH, IMAGE_HEIGHT, 8, OPJ_FALSE,
+                                sample, seed);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static opj_image_t* decode(opj_codec_t* p_codec, const char* filename,
+                           const area_desc_t* area)
+{
+    opj_dparameters_t l_param;
+    OPJ_INT32 l_area[4];
+
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.cp_reduce = area->reduce;
+    l_param.cp_layer = area->layers;
+    l_area[0] = area->x0;
+    l_area[1] = area->y0;
+    l_area[2] = area->x1;
+    l_area[3] = area->y1;
+    return test_decode(p_codec, filename, &l_param, l_area);
+}
+
+static int test(const stream_desc_t* desc, OPJ_SIZE_T cache_size,
+                int num_threads)
+{
+    static const area_desc_t areas[] = {
+        { 10, 20, 150, 120, 0, 0, 0 },
+        { 60, 40, 200, 150, 0, 0, 0 },
+        { 10, 20, 150, 120, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 0 },
+        { 100, 70, 280, 190, 0, 2, 0 },
+        { 100, 70, 280, 190, 0, 0, 0 },
+        { 30, 30, 250, 180, 1, 0, 0 },
+        { 60, 40, 200, 150, 0, 0, 1 },
+        { 160, 110, 301, 203, 0, 0, 1 },
+        { 0, 0, 0, 0, 0, 0, 1 },
+        { 0, 0, 0, 0, 0, 0, 0 }
+    };
+    const OPJ_UINT32 nb_areas = sizeof(areas) / sizeof(areas[0]);
+    const char* filenames[] = { "test_cblk_cache_0.j2k", "test_cblk_cache_1.j2k" };
+    opj_codec_t* l_cached_codec;
+    OPJ_UINT32 i;
+    int ret = 1;
+
+    if (!encode(filenames[0], desc, 0) || !encode(filenames[1], desc, 1)) {
+        fprintf(stderr, "Encoding failed\n");
+        return 1;
+    }
+
+    l_cached_codec = test_create_decompress(filenames[0], NULL, num_threads);
+    if (!l_cached_codec) {
+        return 1;
+    }
+    if (!opj_decoder_set_cblk_cache_size(l_cached_codec, cache_size)) {
+        fprintf(stderr, "opj_decoder_set_cblk_cache_size() failed\n");
+        goto end;
+    }
+
+    for (i = 0; i < nb_areas; ++i) {
+        const char* filename = filenames[areas[i].seed];
+        opj_codec_t* l_codec;
+        opj_image_t* l_image_ref;
+        opj_image_t* l_image;
+        OPJ_BOOL l_same;
+
+        l_codec = test_create_decompress(filename, NULL, 0);
+        if (!l_codec) {
+            goto end;
+        }
+        l_image_ref = decode(l_codec, filename, &areas[i]);
+        opj_destroy_codec(l_codec);
+        if (!l_image_ref) {
+            fprintf(stderr, "Decoding of area %u failed without cache\n", i);
+            goto end;
+        }
+
+        if (i > 0 && !opj_decoder_reset(l_cached_codec)) {
+            fprintf(stderr, "opj_decoder_reset() failed before area %u\n", i);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+        l_image = decode(l_cached_codec, filename, &areas[i]);
+        if (!l_image) {
+            fprintf(stderr, "Decoding of area %u failed with the cache\n", i);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+
+        l_same = test_same_images(l_image_ref, l_image);
+        opj_image_destroy(l_image_ref);
+        opj_image_destroy(l_image);
+        if (!l_same) {
+            fprintf(stderr, "Area %u differs with the cache (tile_size=%u, "
+                    "irreversible=%d, roi_shift=%d, cache_size=%u, threads=%d)\n",
+                    i, desc->tile_size, desc->irreversible, desc->roi_shift,
+                    (unsigned)cache_size, num_threads);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    opj_destroy_codec(l_cached_codec);
+    return ret;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { 128, 1, 0 },
+        { 0, 0, 0 },
+        { 100, 0, 5 }
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    OPJ_UINT32 i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        /* A budget large enough for all code-blocks, and one small enough */
+        /* to evict some of them */
+        if (test(&streams[i], 64 * 1024 * 1024, 0) != 0 ||
+                test(&streams[i], 100 * 1024, 0) != 0 ||
+                test(&streams[i], 64 * 1024 * 1024, 4) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "test_common.h"
+
+void test_error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[ERROR] %s", msg);
+}
+
+OPJ_CODEC_FORMAT test_codec_format(const char* filename)
+{
+    size_t l_len = strlen(filename);
+    if (l_len >= 4 && strcmp(filename + l_len - 4, ".jp2") == 0) {
+        return OPJ_CODEC_JP2;
+    }
+    return OPJ_CODEC_J2K;
+}
+
+opj_image_t* test_create_image(OPJ_UINT32 numcomps, OPJ_UINT32 width,
+                               OPJ_UINT32 height, OPJ_UINT32 prec,
+                               OPJ_BOOL sgnd, test_sample_fn p_sample,
+                               OPJ_UINT32 seed)
+{
+    opj_image_cmptparm_t* l_params;
+    opj_image_t* l_image;
+    OPJ_UINT32 compno, x, y;
+
+    l_params = (opj_image_cmptparm_t*)calloc(numcomps,
+               sizeof(opj_image_cmptparm_t));
+    if (!l_params) {
+        return NULL;
+    }
+    for (compno = 0; compno < numcomps; ++compno) {
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = width;
+        l_params[compno].h = height;
+        l_params[compno].prec = prec;
+        l_params[compno].sgnd = sgnd ? 1 : 0;
+    }
+    l_image = opj_image_create(numcomps, l_params,
+                               numcomps >= 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    free(l_params);
+    if (!l_image) {
+        return NULL;
+    }
+    l_image->x1 = width;
+    l_image->y1 = height;
+    for (compno = 0; compno < numcomps; ++compno) {
+        OPJ_INT32* l_data = l_image->comps[compno].data;
+        for (y = 0; y < height; ++y) {
+            for (x = 0; x < width; ++x) {
+                l_data[(size_t)y * width + x] = p_sample(compno, x, y, seed);
+            }
+        }
+    }
+    return l_image;
+}
+
+OPJ_BOOL test_encode(const char* filename, opj_image_t* p_image,
+                     opj_cparameters_t* p_param,
+                     const char* const* p_options)
+{
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    l_codec = opj_create_compress(test_codec_format(filename));
+    if (!l_codec) {
+        return OPJ_FALSE;
+    }
+    opj_set_error_handler(l_codec, test_error_callback, 00);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    if (l_stream &&
+            opj_setup_encoder(l_codec, p_param, p_image) &&
+            (p_options == NULL ||
+             opj_encoder_set_extra_options(l_codec, p_options)) &&
+            opj_start_compress(l_codec, p_image, l_stream) &&
+            opj_encode(l_codec, l_stream) &&
+            opj_end_compress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+opj_codec_t* test_create_decompress(const char* filename,
+                                    const opj_dparameters_t* p_param,
+                                    int num_threads)
+{
+    opj_dparameters_t l_param;
+    opj_codec_t* l_codec = opj_create_decompress(test_codec_format(filename));
+    if (!l_codec) {
+        return NULL;
+    }
+    opj_set_error_handler(l_codec, test_error_callback, 00);
+    if (p_param) {
+        l_param = *p_param;
+    } else {
+        opj_set_default_decoder_parameters(&l_param);
+    }
+    if (!opj_setup_decoder(l_codec, &l_param) ||
+            (num_threads > 0 && opj_has_thread_support() &&
+             !opj_codec_set_threads(l_codec, num_threads))) {
+        opj_destroy_codec(l_codec);
+        return NULL;
+    }
+    return l_codec;
+}
+
+opj_image_t* test_decode(opj_codec_t* p_codec, const char* filename,
+                         const opj_dparameters_t* p_param,
+                         const OPJ_INT32* p_area)
+{
+    opj_dparameters_t l_param;
+    opj_image_t* l_image = NULL;
+    opj_stream_t* l_stream;
+
+    if (p_param) {
+        l_param = *p_param;
+        if (!opj_setup_decoder(p_codec, &l_param)) {
+            return NULL;
+        }
+    }
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (!l_stream) {
+        return NULL;
+    }
+    if (!opj_read_header(l_stream, p_codec, &l_image) ||
+            (p_area != NULL &&
+             !opj_set_decode_area(p_codec, l_image, p_area[0], p_area[1],
+                                  p_area[2], p_area[3])) ||
+            !opj_decode(p_codec, l_stream, l_image) ||
+            !opj_end_decompress(p_codec, l_stream)) {
+        opj_image_destroy(l_image);
+        l_image = NULL;
+    }
+    opj_stream_destroy(l_stream);
+    return l_image;
+}
+
+opj_image_t* test_decode_once(const char* filename,
+                              const opj_dparameters_t* p_param,
+                              const OPJ_INT32* p_area, int num_threads)
+{
+    opj_codec_t* l_codec;
+    opj_image_t* l_image;
+
+    l_codec = test_create_decompress(filename, p_param, num_threads);
+    if (!l_codec) {
+        return NULL;
+    }
+    l_image = test_decode(l_codec, filename, NULL, p_area);
+    opj_destroy_codec(l_codec);
+    return l_image;
+}
+
+OPJ_BOOL test_same_images(const opj_image_t* image1,
+                          const opj_image_t* image2)
+{
+    OPJ_UINT32 compno;
+    if (image1->numcomps != image2->numcomps ||
+            image1->x0 != image2->x0 || image1->y0 != image2->y0 ||
+            image1->x1 != image2->x1 || image1->y1 != image2->y1 ||
+            image1->color_space != image2->color_space) {
+        return OPJ_FALSE;
+    }
+    for (compno = 0; compno < image1->numcomps; ++compno) {
+        const opj_image_comp_t* comp1 = &image1->comps[compno];
+        const opj_image_comp_t* comp2 = &image2->comps[compno];
+        if (comp1->w != comp2->w || comp1->h != comp2->h ||
+                comp1->prec != comp2->prec || comp1->sgnd != comp2->sgnd ||
+                comp1->resno_decoded != comp2->resno_decoded ||
+                memcmp(comp1->data, comp2->data,
+                       (size_t)comp1->w * comp1->h * sizeof(OPJ_INT32)) != 0) {
+            return OPJ_FALSE;
+        }
+    }
+    return OPJ_TRUE;
+}
+
+unsigned char* test_read_file(const char* filename, size_t* p_size)
+{
+    FILE* f = fopen(filename, "rb");
+    unsigned char* l_data = NULL;
+    long l_size;
+
+    if (!f) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (l_size = ftell(f)) > 0 &&
+            fseek(f, 0, SEEK_SET) == 0) {
+        l_data = (unsigned char*)malloc((size_t)l_size);
+        if (l_data && fread(l_data, 1, (size_t)l_size, f) != (size_t)l_size) {
+            free(l_data);
+            l_data = NULL;
+        }
+        *p_size = (size_t)l_size;
+    }
+    fclose(f);
+    return l_data;
+}
+
+OPJ_BOOL test_write_file(const char* filename, const unsigned char* p_data,
+                         size_t p_size)
+{
+    FILE* f = fopen(filename, "wb");
+    OPJ_BOOL ret;
+
+    if (!f) {
+        return OPJ_FALSE;
+    }
+    ret = fwrite(p_data, 1, p_size, f) == p_size;
+    ret = (fclose(f) == 0) && ret;
+    return ret;
+}
@@ -0,0 +1,102 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Helpers shared by the tests that encode synthetic images and decode them */
+/* back with the library API. */
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stddef.h>
+
+#include "openjpeg.h"
+
+/** Returns the value of the sample (x, y) of component compno of a synthetic
+ * image. seed lets a test generate different images of the same geometry. */
+typedef OPJ_INT32(*test_sample_fn)(OPJ_UINT32 compno, OPJ_UINT32 x,
+                                   OPJ_UINT32 y, OPJ_UINT32 seed);
+
+/** Error handler of the codecs created by the tests: prints the message */
+void test_error_callback(const char *msg, void *client_data);
+
+/** Returns OPJ_CODEC_JP2 for a file name ending with .jp2, OPJ_CODEC_J2K
+ * otherwise. */
+OPJ_CODEC_FORMAT test_codec_format(const char* filename);
+
+/** Creates a width x height image of numcomps unsubsampled components, sRGB
+ * when there are at least 3 components and grayscale otherwise, whose
+ * samples are given by p_sample. Returns NULL on failure. */
+opj_image_t* test_create_image(OPJ_UINT32 numcomps, OPJ_UINT32 width,
+                               OPJ_UINT32 height, OPJ_UINT32 prec,
+                               OPJ_BOOL sgnd, test_sample_fn p_sample,
+                               OPJ_UINT32 seed);
+
+/** Encodes p_image into filename, in the format given by its extension.
+ * p_options are extra options (see opj_encoder_set_extra_options()), or
+ * NULL. */
+OPJ_BOOL test_encode(const char* filename, opj_image_t* p_image,
+                     opj_cparameters_t* p_param,
+                     const char* const* p_options);
+
+/** Creates a decompressor for the format of filename, reporting errors with
+ * test_error_callback(), set up with p_param, or the default parameters if
+ * it is NULL, and using num_threads threads if it is positive and the
+ * library has thread support. */
+opj_codec_t* test_create_decompress(const char* filename,
+                                    const opj_dparameters_t* p_param,
+                                    int num_threads);
+
+/** Decodes filename with p_codec, set up again with p_param if it is not
+ * NULL. p_area is the area to decode as x0, y0, x1, y1, or NULL for the
+ * whole image. Returns NULL on failure. */
+opj_image_t* test_decode(opj_codec_t* p_codec, const char* filename,
+                         const opj_dparameters_t* p_param,
+                         const OPJ_INT32* p_area);
+
+/** Same as test_decode(), with a new decompressor using num_threads
+ * threads. */
+opj_image_t* test_decode_once(const char* filename,
+                              const opj_dparameters_t* p_param,
+                              const OPJ_INT32* p_area, int num_threads);
+
+/** Returns whether two images have the same geometry, component parameters
+ * and samples. */
+OPJ_BOOL test_same_images(const opj_image_t* image1,
+                          const opj_image_t* image2);
+
+/** Reads a whole file into a buffer to release with free(). Returns NULL on
+ * failure. */
+unsigned char* test_read_file(const char* filename, size_t* p_size);
+
+/** Writes a buffer to a file */
+OPJ_BOOL test_write_file(const char* filename, const unsigned char* p_data,
+                         size_t p_size);
+
+#endif /* TEST_COMMON_H */
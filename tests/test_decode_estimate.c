@@ -0,0 +1,317 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks the numbers of tiles and code-blocks and the compressed bytes */
+/* predicted by opj_estimate_decode() for various decoding parameters, on */
+/* a codestream with and without TLM markers. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+/* 256x256 image, in 64x64 tiles, with 3 resolutions and 32x32 code-blocks: */
+/* each tile-component has 1 code-block per sub-band */
+#define IMAGE_SIZE 256
+#define TILE_SIZE 64
+#define NB_TILES ((IMAGE_SIZE / TILE_SIZE) * (IMAGE_SIZE / TILE_SIZE))
+#define NUMCOMPS 3
+#define CBLKS_PER_TILECOMP 7
+
+typedef struct {
+    OPJ_UINT32 reduce;
+    OPJ_UINT32 numcomps; /* 0 for all */
+    OPJ_INT32 x0, y0, x1, y1; /* all 0 for the whole image */
+    OPJ_UINT32 expected_tiles;
+    OPJ_UINT64 expected_code_blocks;
+} request_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    OPJ_UINT32 i = y * IMAGE_SIZE + x;
+    (void)seed;
+    return (OPJ_INT32)((i * (compno + 3) + (i >> 7)) & 255);
+}
+
+static OPJ_BOOL encode(const char* filename)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 1;
+    l_param.tcp_rates[0] = 4;
+    l_param.cp_disto_alloc = 1;
+    l_param.numresolution = 3;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 32;
+    l_param.tile_size_on = OPJ_TRUE;
+    l_param.cp_tdx = TILE_SIZE;
+    l_param.cp_tdy = TILE_SIZE;
+
+    l_image = test_create_image(NUMCOMPS, IMAGE_SIZE, IMAGE_SIZE, 8, OPJ_FALSE,
+                                sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static OPJ_UINT32 read_uint(const unsigned char* p, int n)
+{
+    OPJ_UINT32 v = 0;
+    int i;
+    for (i = 0; i < n; ++i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/* Rewrites the codestream in filename with a TLM marker, with 16-bit tile */
+/* indices and 32-bit lengths, at the end of its main header. Returns the */
+/* length of the tile-parts of each tile in tile_lengths, and in */
+/* first_sot the position of the first SOT marker of the input */
+static OPJ_BOOL add_tlm(const char* filename, OPJ_UINT64* tile_lengths,
+                        size_t* first_sot)
+{
+    FILE* f;
+    unsigned char* l_data;
+    unsigned char l_tlm[4 + 2 + 6 * NB_TILES];
+    size_t l_size = 0, l_pos, l_tlm_size = 6;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    l_data = test_read_file(filename, &l_size);
+    if (!l_data) {
+        return OPJ_FALSE;
+    }
+
+    /* Main header markers, up to the first SOT */
+    l_pos = 2;
+    while (l_pos + 4 <= l_size && read_uint(l_data + l_pos, 2) != 0xff90) {
+        l_pos += 2 + read_uint(l_data + l_pos + 2, 2);
+    }
+    *first_sot = l_pos;
+
+    /* Tile-parts */
+    memset(tile_lengths, 0, NB_TILES * sizeof(OPJ_UINT64));
+    while (l_pos + 12 <= l_size && read_uint(l_data + l_pos, 2) == 0xff90 &&
+            l_tlm_size + 6 <= sizeof(l_tlm)) {
+        OPJ_UINT32 l_isot = read_uint(l_data + l_pos + 4, 2);
+        OPJ_UINT32 l_psot = read_uint(l_data + l_pos + 6, 4);
+        if (l_isot >= NB_TILES || l_psot == 0) {
+            break;
+        }
+        tile_lengths[l_isot] += l_psot;
+        memcpy(l_tlm + l_tlm_size, l_data + l_pos + 4, 2);
+        memcpy(l_tlm + l_tlm_size + 2, l_data + l_pos + 6, 4);
+        l_tlm_size += 6;
+        l_pos += l_psot;
+    }
+    if (l_pos + 2 == l_size && read_uint(l_data + l_pos, 2) == 0xffd9) {
+        l_tlm[0] = 0xff;
+        l_tlm[1] = 0x55;
+        l_tlm[2] = (unsigned char)((l_tlm_size - 2) >> 8);
+        l_tlm[3] = (unsigned char)(l_tlm_size - 2);
+        l_tlm[4] = 0;    /* Ztlm */
+        l_tlm[5] = 0x60; /* Stlm: ST=2, SP=1 */
+        f = fopen(filename, "wb");
+        if (f) {
+            ret = fwrite(l_data, 1, *first_sot, f) == *first_sot &&
+                  fwrite(l_tlm, 1, l_tlm_size, f) == l_tlm_size &&
+                  fwrite(l_data + *first_sot, 1, l_size - *first_sot, f) ==
+                  l_size - *first_sot;
+            ret = (fclose(f) == 0) && ret;
+        }
+    }
+    free(l_data);
+    return ret;
+}
+
+static OPJ_BOOL estimate(const char* filename, const request_desc_t* request,
+                         opj_decode_estimate_t* p_estimate)
+{
+    static const OPJ_UINT32 comps_indices[] = { 2, 0 };
+    opj_dparameters_t l_param;
+    opj_image_t* l_image = NULL;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.cp_reduce = request->reduce;
+    l_codec = test_create_decompress(filename, &l_param, 0);
+    if (!l_codec) {
+        return OPJ_FALSE;
+    }
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (l_stream &&
+            opj_read_header(l_stream, l_codec, &l_image) &&
+            (request->numcomps == 0 ||
+             opj_set_decoded_components(l_codec, request->numcomps, comps_indices,
+                                        OPJ_FALSE)) &&
+            opj_set_decode_area(l_codec, l_image, request->x0, request->y0,
+                                request->x1, request->y1) &&
+            opj_estimate_decode(l_codec, l_stream, l_image, p_estimate) &&
+            /* The estimation must leave the codec ready to decode */
+            opj_decode(l_codec, l_stream, l_image) &&
+            opj_end_decompress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_image_destroy(l_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+static int check(const char* filename, const request_desc_t* request,
+                 const OPJ_UINT64* tile_lengths, size_t stream_bytes)
+{
+    opj_decode_estimate_t l_estimate;
+    OPJ_UINT64 l_expected_bytes = 0;
+    OPJ_UINT32 l_numcomps = request->numcomps ? request->numcomps : NUMCOMPS;
+    OPJ_UINT32 l_size = (IMAGE_SIZE >> request->reduce);
+    OPJ_UINT32 tileno;
+
+    if (!estimate(filename, request, &l_estimate)) {
+        fprintf(stderr, "%s: estimation failed\n", filename);
+        return 1;
+    }
+    if (l_estimate.nb_tiles != request->expected_tiles ||
+            l_estimate.nb_code_blocks != request->expected_code_blocks) {
+        fprintf(stderr, "%s: %u tiles and %lu code-blocks estimated instead of "
+                "%u and %lu (reduce=%u, numcomps=%u, area=%d,%d,%d,%d)\n", filename,
+                l_estimate.nb_tiles, (unsigned long)l_estimate.nb_code_blocks,
+                request->expected_tiles, (unsigned long)request->expected_code_blocks,
+                request->reduce, request->numcomps,
+                request->x0, request->y0, request->x1, request->y1);
+        return 1;
+    }
+    if (request->x1 == 0 &&
+            l_estimate.image_memory != (OPJ_UINT64)l_numcomps * l_size * l_size * 4) {
+        fprintf(stderr, "%s: image memory estimated to %lu bytes\n", filename,
+                (unsigned long)l_estimate.image_memory);
+        return 1;
+    }
+    if (l_estimate.peak_memory < l_estimate.image_memory ||
+            l_estimate.memory_per_thread == 0) {
+        fprintf(stderr, "%s: inconsistent memory estimation\n", filename);
+        return 1;
+    }
+
+    if (tile_lengths) {
+        /* Exact tile lengths from the TLM marker */
+        for (tileno = 0; tileno < NB_TILES; ++tileno) {
+            OPJ_INT32 tx = (OPJ_INT32)(tileno % (IMAGE_SIZE / TILE_SIZE)) * TILE_SIZE;
+            OPJ_INT32 ty = (OPJ_INT32)(tileno / (IMAGE_SIZE / TILE_SIZE)) * TILE_SIZE;
+            if (request->x1 == 0 ||
+                    (tx < request->x1 && tx + TILE_SIZE > request->x0 &&
+                     ty < request->y1 && ty + TILE_SIZE > request->y0)) {
+                l_expected_bytes += tile_lengths[tileno];
+            }
+        }
+        if (!l_estimate.compressed_bytes_exact ||
+                l_estimate.compressed_bytes != l_expected_bytes) {
+            fprintf(stderr, "%s: %lu compressed bytes estimated instead of %lu\n",
+                    filename, (unsigned long)l_estimate.compressed_bytes,
+                    (unsigned long)l_expected_bytes);
+            return 1;
+        }
+    } else if (l_estimate.compressed_bytes_exact ||
+               l_estimate.compressed_bytes > stream_bytes ||
+               (request->x1 == 0 && l_estimate.compressed_bytes == 0)) {
+        fprintf(stderr, "%s: %lu compressed bytes estimated without TLM\n",
+                filename, (unsigned long)l_estimate.compressed_bytes);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const request_desc_t requests[] = {
+        /* whole image */
+        { 0, 0, 0, 0, 0, 0, NB_TILES, NB_TILES * NUMCOMPS * CBLKS_PER_TILECOMP },
+        /* the highest resolution adds 3 code-blocks per tile-component */
+        { 1, 0, 0, 0, 0, 0, NB_TILES, NB_TILES * NUMCOMPS * (CBLKS_PER_TILECOMP - 3) },
+        { 0, 2, 0, 0, 0, 0, NB_TILES, NB_TILES * 2 * CBLKS_PER_TILECOMP },
+        /* exactly the first tile */
+        { 0, 0, 0, 0, TILE_SIZE, TILE_SIZE, 1, NUMCOMPS * CBLKS_PER_TILECOMP },
+        /* inside the last tile */
+        {
+            0, 1, IMAGE_SIZE - 50, IMAGE_SIZE - 50, IMAGE_SIZE - 10, IMAGE_SIZE - 10,
+            1, CBLKS_PER_TILECOMP
+        },
+        /* across 4 tiles */
+        {
+            0, 0, TILE_SIZE - 8, TILE_SIZE - 8, TILE_SIZE + 8, TILE_SIZE + 8,
+            4, 4 * NUMCOMPS * CBLKS_PER_TILECOMP
+        }
+    };
+    const size_t nb_requests = sizeof(requests) / sizeof(requests[0]);
+    const char* filename = "test_decode_estimate.j2k";
+    OPJ_UINT64 tile_lengths[NB_TILES];
+    size_t first_sot, i;
+    FILE* f;
+    long stream_bytes;
+
+    if (!encode(filename)) {
+        fprintf(stderr, "Encoding failed\n");
+        return 1;
+    }
+    f = fopen(filename, "rb");
+    if (!f || fseek(f, 0, SEEK_END) != 0 || (stream_bytes = ftell(f)) <= 0) {
+        fprintf(stderr, "Cannot read %s\n", filename);
+        return 1;
+    }
+    fclose(f);
+    for (i = 0; i < nb_requests; ++i) {
+        if (check(filename, &requests[i], NULL, (size_t)stream_bytes) != 0) {
+            return 1;
+        }
+    }
+
+    if (!add_tlm(filename, tile_lengths, &first_sot)) {
+        fprintf(stderr, "Cannot add a TLM marker to %s\n", filename);
+        return 1;
+    }
+    for (i = 0; i < nb_requests; ++i) {
+        if (check(filename, &requests[i], tile_lengths, (size_t)stream_bytes) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
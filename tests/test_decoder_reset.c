@@ -0,0 +1,171 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that decoding a sequence of codestreams with a single decompressor, */
+/* reset with opj_decoder_reset() between them, gives the same images as */
+/* decoding each of them with a new decompressor, including when the */
+/* geometry changes from one codestream to the next. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+typedef struct {
+    OPJ_UINT32 numcomps;
+    OPJ_UINT32 width;
+    OPJ_UINT32 height;
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int irreversible;
+} frame_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    return (OPJ_INT32)((x * (compno + 1) + y * (seed + 2) + ((x * y + seed) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const frame_desc_t* desc,
+                       OPJ_UINT32 seed)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 2;
+    l_param.cp_disto_alloc = 1;
+    l_param.tcp_rates[0] = 20;
+    l_param.tcp_rates[1] = desc->irreversible ? 5 : 0;
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 4;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+
+    l_image = test_create_image(desc->numcomps, desc->width, desc->height, 8,
+                                OPJ_FALSE, sample, seed);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static int test(const char* extension, OPJ_UINT32 reduce, int num_threads)
+{
+    /* The first frames have the same geometry, the following ones exercise */
+    /* the fallback paths */
+    static const frame_desc_t frames[] = {
+        { 3, 200, 150, 0, 0 },
+        { 3, 200, 150, 0, 1 },
+        { 3, 200, 150, 0, 0 },
+        { 3, 200, 150, 64, 0 },
+        { 3, 200, 150, 64, 1 },
+        { 1, 97, 131, 0, 0 },
+        { 4, 256, 64, 48, 0 },
+        { 3, 200, 150, 0, 1 }
+    };
+    const OPJ_UINT32 nb_frames = sizeof(frames) / sizeof(frames[0]);
+    char filename[64];
+    opj_dparameters_t l_param;
+    opj_codec_t* l_reused_codec;
+    OPJ_UINT32 i;
+    int ret = 1;
+
+    sprintf(filename, "test_decoder_reset.%s", extension);
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.cp_reduce = reduce;
+    l_reused_codec = test_create_decompress(filename, &l_param, num_threads);
+    if (!l_reused_codec) {
+        return 1;
+    }
+
+    for (i = 0; i < nb_frames; ++i) {
+        opj_image_t* l_image_ref;
+        opj_image_t* l_image;
+        OPJ_BOOL l_same;
+
+        if (!encode(filename, &frames[i], i)) {
+            fprintf(stderr, "Encoding of frame %u failed\n", i);
+            goto end;
+        }
+
+        l_image_ref = test_decode_once(filename, &l_param, NULL, 0);
+        if (!l_image_ref) {
+            fprintf(stderr, "Decoding of frame %u failed with a new codec\n", i);
+            goto end;
+        }
+
+        if (i > 0 && !opj_decoder_reset(l_reused_codec)) {
+            fprintf(stderr, "opj_decoder_reset() failed before frame %u\n", i);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+        l_image = test_decode(l_reused_codec, filename, NULL, NULL);
+        if (!l_image) {
+            fprintf(stderr, "Decoding of frame %u failed with the reset codec\n", i);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+
+        l_same = test_same_images(l_image_ref, l_image);
+        opj_image_destroy(l_image_ref);
+        opj_image_destroy(l_image);
+        if (!l_same) {
+            fprintf(stderr, "Frame %u differs (%s, reduce=%u)\n", i, extension,
+                    reduce);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    opj_destroy_codec(l_reused_codec);
+    return ret;
+}
+
+int main(void)
+{
+    if (test("j2k", 0, 0) != 0 ||
+            test("jp2", 0, 0) != 0 ||
+            test("j2k", 1, 0) != 0 ||
+            test("jp2", 0, 4) != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that encoding an interleaved buffer with opj_encode_interleaved() */
+/* produces exactly the same codestream as encoding the equivalent planar */
+/* image with opj_encode(). */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+#define NUM_COMPS 3
+#define SAMPLES_PER_PIXEL 4 /* BGRA-like input, alpha is not encoded */
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[ERROR] %s", msg);
+}
+
+static OPJ_INT32 get_sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                            OPJ_UINT32 prec, OPJ_UINT32 sgnd)
+{
+    OPJ_INT32 v = (OPJ_INT32)((x * (compno + 2) + y * 5 + ((x * y) & 15)) &
+                              ((1U << prec) - 1U));
+    if (sgnd) {
+        v -= 1 << (prec - 1);
+    }
+    return v;
+}
+
+static OPJ_BOOL encode(const char* filename,
+                       OPJ_UINT32 width, OPJ_UINT32 height,
+                       OPJ_UINT32 prec, OPJ_UINT32 sgnd,
+                       int irreversible,
+                       const opj_interleaved_buffer_t* p_buffer)
+{
+    opj_cparameters_t l_param;
+    opj_image_cmptparm_t l_params[NUM_COMPS];
+    opj_codec_t * l_codec;
+    opj_image_t * l_image;
+    opj_stream_t * l_stream;
+    OPJ_UINT32 compno, x, y;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 1;
+    l_param.cp_disto_alloc = 1;
+    l_param.tcp_rates[0] = irreversible ? 10 : 0;
+    l_param.irreversible = irreversible;
+    l_param.tile_size_on = OPJ_TRUE;
+    l_param.cp_tdx = 128;
+    l_param.cp_tdy = 96;
+    l_param.numresolution = 4;
+
+    memset(l_params, 0, sizeof(l_params));
+    for (compno = 0; compno < NUM_COMPS; ++compno) {
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = width;
+        l_params[compno].h = height;
+        l_params[compno].prec = prec;
+        l_params[compno].sgnd = sgnd;
+    }
+
+    if (p_buffer) {
+        l_image = opj_image_tile_create(NUM_COMPS, l_params, OPJ_CLRSPC_SRGB);
+    } else {
+        l_image = opj_image_create(NUM_COMPS, l_params, OPJ_CLRSPC_SRGB);
+    }
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    l_image->x1 = width;
+    l_image->y1 = height;
+    if (!p_buffer) {
+        for (compno = 0; compno < NUM_COMPS; ++compno) {
+            for (y = 0; y < height; ++y) {
+                for (x = 0; x < width; ++x) {
+                    l_image->comps[compno].data[y * width + x] =
+                        get_sample(compno, x, y, prec, sgnd);
+                }
+            }
+        }
+    }
+
+    l_codec = opj_create_compress(OPJ_CODEC_J2K);
+    opj_set_error_handler(l_codec, error_callback, 00);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    if (l_stream &&
+            opj_setup_encoder(l_codec, &l_param, l_image) &&
+            opj_start_compress(l_codec, l_image, l_stream) &&
+            (p_buffer ? opj_encode_interleaved(l_codec, p_buffer, l_stream) :
+             opj_encode(l_codec, l_stream)) &&
+            opj_end_compress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static OPJ_BOOL same_files(const char* filename1, const char* filename2)
+{
+    FILE* f1 = fopen(filename1, "rb");
+    FILE* f2 = fopen(filename2, "rb");
+    OPJ_BOOL ret = (f1 != NULL && f2 != NULL);
+    while (ret) {
+        int c1 = fgetc(f1);
+        int c2 = fgetc(f2);
+        if (c1 != c2) {
+            ret = OPJ_FALSE;
+        } else if (c1 == EOF) {
+            break;
+        }
+    }
+    if (f1) {
+        fclose(f1);
+    }
+    if (f2) {
+        fclose(f2);
+    }
+    return ret;
+}
+
+static int test(OPJ_UINT32 prec, OPJ_UINT32 sgnd, int irreversible)
+{
+    const OPJ_UINT32 width = 301;
+    const OPJ_UINT32 height = 203;
+    const OPJ_UINT32 bytes_per_sample = prec > 8 ? 2 : 1;
+    /* input is stored in reverse component order, with padded lines */
+    const OPJ_UINT32 mapping[NUM_COMPS] = { 2, 1, 0 };
+    opj_interleaved_buffer_t l_buffer;
+    OPJ_BYTE* l_data;
+    OPJ_UINT32 compno, x, y;
+    int ret = 1;
+
+    memset(&l_buffer, 0, sizeof(l_buffer));
+    l_buffer.bytes_per_sample = bytes_per_sample;
+    l_buffer.samples_per_pixel = SAMPLES_PER_PIXEL;
+    l_buffer.line_stride = (OPJ_SIZE_T)width * SAMPLES_PER_PIXEL *
+                           bytes_per_sample + 16;
+    l_buffer.comp_mapping = mapping;
+    l_data = (OPJ_BYTE*)calloc(1, l_buffer.line_stride * height);
+    if (!l_data) {
+        return 1;
+    }
+    for (y = 0; y < height; ++y) {
+        for (x = 0; x < width; ++x) {
+            OPJ_BYTE* l_pixel = l_data + y * l_buffer.line_stride +
+                                x * SAMPLES_PER_PIXEL * bytes_per_sample;
+            for (compno = 0; compno < NUM_COMPS; ++compno) {
+                OPJ_INT32 v = get_sample(compno, x, y, prec, sgnd);
+                OPJ_BYTE* l_sample = l_pixel + mapping[compno] * bytes_per_sample;
+                if (bytes_per_sample == 1) {
+                    *l_sample = (OPJ_BYTE)v;
+                } else {
+                    OPJ_UINT16 v16 = (OPJ_UINT16)v;
+                    memcpy(l_sample, &v16, 2);
+                }
+            }
+            /* alpha, not encoded */
+            l_pixel[3 * bytes_per_sample] = 0xAB;
+        }
+    }
+    l_buffer.data = l_data;
+
+    if (!encode("test_encode_interleaved_planar.j2k", width, height, prec, sgnd,
+                irreversible, NULL) ||
+            !encode("test_encode_interleaved_packed.j2k", width, height, prec, sgnd,
+                    irreversible, &l_buffer)) {
+        fprintf(stderr, "Encoding failed for prec=%u sgnd=%u irreversible=%d\n",
+                prec, sgnd, irreversible);
+    } else if (!same_files("test_encode_interleaved_planar.j2k",
+                           "test_encode_interleaved_packed.j2k")) {
+        fprintf(stderr, "Codestreams differ for prec=%u sgnd=%u irreversible=%d\n",
+                prec, sgnd, irreversible);
+    } else {
+        ret = 0;
+    }
+
+    free(l_data);
+    return ret;
+}
+
+int main(void)
+{
+    int irreversible;
+    for (irreversible = 0; irreversible <= 1; ++irreversible) {
+        if (test(8, 0, irreversible) != 0 ||
+                test(8, 1, irreversible) != 0 ||
+                test(12, 0, irreversible) != 0 ||
+                test(16, 1, irreversible) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that compressing several images with the same compressor handle */
+/* produces exactly the same codestreams as compressing each of them with a */
+/* new compressor, and that an image of a different geometry is rejected. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+#define NUM_COMPS 3
+#define NUM_IMAGES 4
+#define WIDTH 211
+#define HEIGHT 157
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[ERROR] %s", msg);
+}
+
+static opj_image_t* create_image(OPJ_UINT32 seed, OPJ_UINT32 width)
+{
+    opj_image_cmptparm_t l_params[NUM_COMPS];
+    opj_image_t* l_image;
+    OPJ_UINT32 compno, x, y;
+
+    memset(l_params, 0, sizeof(l_params));
+    for (compno = 0; compno < NUM_COMPS; ++compno) {
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = width;
+        l_params[compno].h = HEIGHT;
+        l_params[compno].prec = 8;
+    }
+    l_image = opj_image_create(NUM_COMPS, l_params, OPJ_CLRSPC_SRGB);
+    if (!l_image) {
+        return NULL;
+    }
+    l_image->x1 = width;
+    l_image->y1 = HEIGHT;
+    for (compno = 0; compno < NUM_COMPS; ++compno) {
+        for (y = 0; y < HEIGHT; ++y) {
+            for (x = 0; x < width; ++x) {
+                l_image->comps[compno].data[y * width + x] = (OPJ_INT32)
+                        ((x * (compno + seed + 1) + y * (seed + 3) + ((x * y * seed) & 31)) & 255);
+            }
+        }
+    }
+    return l_image;
+}
+
+static void set_parameters(opj_cparameters_t* p_param, int irreversible)
+{
+    opj_set_default_encoder_parameters(p_param);
+    p_param->tcp_numlayers = 3;
+    p_param->cp_disto_alloc = 1;
+    p_param->tcp_rates[0] = 40;
+    p_param->tcp_rates[1] = 10;
+    p_param->tcp_rates[2] = irreversible ? 4 : 0;
+    p_param->irreversible = irreversible;
+    p_param->tcp_mct = 1;
+    p_param->tile_size_on = OPJ_TRUE;
+    p_param->cp_tdx = 128;
+    p_param->cp_tdy = 64;
+    p_param->numresolution = 4;
+    p_param->tp_on = 1;
+    p_param->tp_flag = 'R';
+}
+
+static opj_codec_t* create_codec(opj_cparameters_t* p_param,
+                                 opj_image_t* p_image, OPJ_CODEC_FORMAT format)
+{
+    const char* const l_options[] = { "PLT=YES", NULL };
+    opj_codec_t* l_codec = opj_create_compress(format);
+    if (!l_codec) {
+        return NULL;
+    }
+    opj_set_error_handler(l_codec, error_callback, 00);
+    if (!opj_setup_encoder(l_codec, p_param, p_image) ||
+            !opj_encoder_set_extra_options(l_codec, l_options)) {
+        opj_destroy_codec(l_codec);
+        return NULL;
+    }
+    return l_codec;
+}
+
+static OPJ_BOOL compress(opj_codec_t* p_codec, opj_image_t* p_image,
+                         const char* filename)
+{
+    OPJ_BOOL ret = OPJ_FALSE;
+    opj_stream_t* l_stream = opj_stream_create_default_file_stream(filename,
+                             OPJ_FALSE);
+    if (l_stream &&
+            opj_start_compress(p_codec, p_image, l_stream) &&
+            opj_encode(p_codec, l_stream) &&
+            opj_end_compress(p_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_stream_destroy(l_stream);
+    return ret;
+}
+
+static OPJ_BOOL same_files(const char* filename1, const char* filename2)
+{
+    FILE* f1 = fopen(filename1, "rb");
+    FILE* f2 = fopen(filename2, "rb");
+    OPJ_BOOL ret = (f1 != NULL && f2 != NULL);
+    while (ret) {
+        int c1 = fgetc(f1);
+        int c2 = fgetc(f2);
+        if (c1 != c2) {
+            ret = OPJ_FALSE;
+        } else if (c1 == EOF) {
+            break;
+        }
+    }
+    if (f1) {
+        fclose(f1);
+    }
+    if (f2) {
+        fclose(f2);
+    }
+    return ret;
+}
+
+static int test(int irreversible, OPJ_CODEC_FORMAT format)
+{
+    const char* reused_file = format == OPJ_CODEC_JP2 ?
+                              "test_encoder_reuse_reused.jp2" :
+                              "test_encoder_reuse_reused.j2k";
+    const char* new_file = format == OPJ_CODEC_JP2 ?
+                           "test_encoder_reuse_new.jp2" :
+                           "test_encoder_reuse_new.j2k";
+    opj_cparameters_t l_param;
+    opj_codec_t* l_reused_codec;
+    opj_image_t* l_image;
+    OPJ_UINT32 i;
+    int ret = 1;
+
+    set_parameters(&l_param, irreversible);
+    l_image = create_image(0, WIDTH);
+    if (!l_image) {
+        return 1;
+    }
+    l_reused_codec = create_codec(&l_param, l_image, format);
+    opj_image_destroy(l_image);
+    if (!l_reused_codec) {
+        return 1;
+    }
+
+    for (i = 0; i < NUM_IMAGES; ++i) {
+        opj_codec_t* l_codec;
+        OPJ_BOOL l_ok;
+
+        /* with a new codec */
+        set_parameters(&l_param, irreversible);
+        l_image = create_image(i, WIDTH);
+        if (!l_image) {
+            goto end;
+        }
+        l_codec = create_codec(&l_param, l_image, format);
+        l_ok = l_codec != NULL && compress(l_codec, l_image, new_file);
+        opj_destroy_codec(l_codec);
+        opj_image_destroy(l_image);
+        if (!l_ok) {
+            fprintf(stderr, "Encoding failed with a new codec for image %u\n", i);
+            goto end;
+        }
+
+        /* with the reused codec */
+        l_image = create_image(i, WIDTH);
+        if (!l_image) {
+            goto end;
+        }
+        l_ok = compress(l_reused_codec, l_image, reused_file);
+        opj_image_destroy(l_image);
+        if (!l_ok) {
+            fprintf(stderr, "Encoding failed with the reused codec for image %u\n", i);
+            goto end;
+        }
+
+        if (!same_files(new_file, reused_file)) {
+            fprintf(stderr, "Codestreams differ for image %u (irreversible=%d)\n",
+                    i, irreversible);
+            goto end;
+        }
+    }
+
+    /* An image of a different geometry must be rejected */
+    l_image = create_image(0, WIDTH + 1);
+    if (!l_image) {
+        goto end;
+    }
+    if (compress(l_reused_codec, l_image, reused_file)) {
+        fprintf(stderr, "Image of a different geometry was not rejected\n");
+    } else {
+        ret = 0;
+    }
+    opj_image_destroy(l_image);
+
+end:
+    opj_destroy_codec(l_reused_codec);
+    return ret;
+}
+
+int main(void)
+{
+    if (test(0, OPJ_CODEC_J2K) != 0 ||
+            test(1, OPJ_CODEC_J2K) != 0 ||
+            test(1, OPJ_CODEC_JP2) != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that the LAZY_NO_DISTORTION extra option of the encoder sets the */
+/* selective arithmetic coding bypass in the code-block style of the COD */
+/* and COC marker segments, keeping the other styles, and that the */
+/* codestreams decode back to the original image when encoded losslessly. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define IMAGE_WIDTH 203
+#define IMAGE_HEIGHT 157
+
+typedef struct {
+    OPJ_UINT32 numcomps;
+    int mode; /* code-block style given to the encoder */
+    OPJ_BOOL lossless;
+    const char* option; /* NULL for none */
+    OPJ_UINT32 expected_cblksty;
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 1) + y * 7 + ((x * y * 5 + compno) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, opj_image_t* p_image,
+                       const stream_desc_t* desc)
+{
+    const char* l_options[2];
+    opj_cparameters_t l_param;
+
+    opj_set_default_encoder_parameters(&l_param);
+    if (!desc->lossless) {
+        l_param.tcp_numlayers = 2;
+        l_param.tcp_rates[0] = 20;
+        l_param.tcp_rates[1] = 5;
+        l_param.cp_disto_alloc = 1;
+    }
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 32;
+    l_param.mode = desc->mode;
+    l_options[0] = desc->option;
+    l_options[1] = NULL;
+    return test_encode(filename, p_image, &l_param,
+                       desc->option ? l_options : NULL);
+}
+
+static OPJ_UINT32 read_uint(const unsigned char* p, int n)
+{
+    OPJ_UINT32 v = 0;
+    int i;
+    for (i = 0; i < n; ++i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/* Checks the code-block style of the COD and COC marker segments of the */
+/* main header */
+static int check_markers(const char* filename, const stream_desc_t* desc)
+{
+    unsigned char* l_data;
+    size_t l_size = 0, l_pos = 2;
+    OPJ_UINT32 l_nb_cod = 0;
+    int ret = 0;
+
+    l_data = test_read_file(filename, &l_size);
+    if (!l_data) {
+        fprintf(stderr, "Cannot read %s\n", filename);
+        return 1;
+    }
+    while (ret == 0 && l_pos + 4 <= l_size &&
+            read_uint(l_data + l_pos, 2) != 0xff90) {
+        OPJ_UINT32 l_marker = read_uint(l_data + l_pos, 2);
+        OPJ_UINT32 l_len = read_uint(l_data + l_pos + 2, 2);
+        size_t l_cblksty_pos = 0;
+
+        if (l_marker == 0xff52) {
+            /* Lcod, Scod, SGcod (4 bytes), then decompositions, xcb, ycb */
+            l_cblksty_pos = l_pos + 12;
+            ++l_nb_cod;
+        } else if (l_marker == 0xff53) {
+            /* Lcoc, Ccoc (1 byte for less than 257 components), Scoc, */
+            /* then decompositions, xcb, ycb */
+            l_cblksty_pos = l_pos + 9 + (desc->numcomps >= 257 ? 1 : 0);
+        }
+        if (l_cblksty_pos != 0 && (l_cblksty_pos >= l_size ||
+                                   l_data[l_cblksty_pos] != desc->expected_cblksty)) {
+            fprintf(stderr, "Wrong code-block style in marker 0x%x\n", l_marker);
+            ret = 1;
+        }
+        l_pos += 2 + l_len;
+    }
+    if (ret == 0 && l_nb_cod != 1) {
+        fprintf(stderr, "%u COD marker segments in the main header\n", l_nb_cod);
+        ret = 1;
+    }
+    free(l_data);
+    return ret;
+}
+
+/* Checks the code-block style of each component as seen by the decoder */
+static int check_decoder_styles(const char* filename,
+                                const stream_desc_t* desc)
+{
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    opj_image_t* l_image = NULL;
+    opj_codestream_info_v2_t* l_info = NULL;
+    OPJ_UINT32 compno;
+    int ret = 1;
+
+    l_codec = test_create_decompress(filename, NULL, 0);
+    if (!l_codec) {
+        return 1;
+    }
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (l_stream && opj_read_header(l_stream, l_codec, &l_image)) {
+        l_info = opj_get_cstr_info(l_codec);
+    }
+    if (l_info && l_info->nbcomps == desc->numcomps) {
+        ret = 0;
+        for (compno = 0; compno < desc->numcomps; ++compno) {
+            OPJ_UINT32 l_cblksty = l_info->m_default_tile_info.tccp_info[compno].cblksty;
+            if (l_cblksty != desc->expected_cblksty) {
+                fprintf(stderr, "Code-block style of component %u is 0x%x\n",
+                        compno, l_cblksty);
+                ret = 1;
+            }
+        }
+    }
+    opj_destroy_cstr_info(&l_info);
+    opj_image_destroy(l_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+static int test(const stream_desc_t* desc)
+{
+    const char* filename = "test_lazy_no_distortion.j2k";
+    opj_image_t* l_image;
+    opj_image_t* l_image_decoded;
+    int ret = 1;
+
+    l_image = test_create_image(desc->numcomps, IMAGE_WIDTH, IMAGE_HEIGHT, 8,
+                                OPJ_FALSE, sample, 0);
+    if (!l_image) {
+        return 1;
+    }
+    if (!encode(filename, l_image, desc)) {
+        fprintf(stderr, "Encoding failed\n");
+        goto end;
+    }
+    if (check_markers(filename, desc) != 0 ||
+            check_decoder_styles(filename, desc) != 0) {
+        goto end;
+    }
+    l_image_decoded = test_decode_once(filename, NULL, NULL, 0);
+    if (!l_image_decoded || l_image_decoded->numcomps != desc->numcomps ||
+            l_image_decoded->comps[0].w != IMAGE_WIDTH ||
+            l_image_decoded->comps[0].h != IMAGE_HEIGHT) {
+        fprintf(stderr, "Decoding failed\n");
+        opj_image_destroy(l_image_decoded);
+        goto end;
+    }
+    if (desc->lossless) {
+        OPJ_UINT32 compno, x, y;
+        for (compno = 0; compno < desc->numcomps; ++compno) {
+            const OPJ_INT32* l_data = l_image_decoded->comps[compno].data;
+            for (y = 0; y < IMAGE_HEIGHT; ++y) {
+                for (x = 0; x < IMAGE_WIDTH; ++x) {
+                    if (l_data[y * IMAGE_WIDTH + x] != sample(compno, x, y, 0)) {
+                        fprintf(stderr, "Lossless decoding differs from the "
+                                "original at %u,%u\n", x, y);
+                        opj_image_destroy(l_image_decoded);
+                        goto end;
+                    }
+                }
+            }
+        }
+    }
+    opj_image_destroy(l_image_decoded);
+    ret = 0;
+
+end:
+    if (ret != 0) {
+        fprintf(stderr, "Failure with numcomps=%u, mode=%d, lossless=%d, "
+                "option=%s\n", desc->numcomps, desc->mode, desc->lossless,
+                desc->option ? desc->option : "none");
+    }
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { 3, 0, OPJ_TRUE, NULL, 0 },
+        { 3, 0, OPJ_TRUE, "LAZY_NO_DISTORTION=NO", 0 },
+        { 3, 0, OPJ_TRUE, "LAZY_NO_DISTORTION=YES", 0x01 },
+        { 1, 0, OPJ_TRUE, "LAZY_NO_DISTORTION=YES", 0x01 },
+        { 3, 2 | 32, OPJ_TRUE, "LAZY_NO_DISTORTION=YES", 0x01 | 0x02 | 0x20 },
+        { 4, 4, OPJ_TRUE, "LAZY_NO_DISTORTION=YES", 0x01 | 0x04 },
+        /* Distortion still estimated for the rate allocation */
+        { 3, 0, OPJ_FALSE, "LAZY_NO_DISTORTION=YES", 0x01 }
+    };
+    const size_t nb_streams = sizeof(streams) / sizeof(streams[0]);
+    const char* const l_invalid[] = { "LAZY_NO_DISTORTION=MAYBE", NULL };
+    opj_cparameters_t l_param;
+    opj_codec_t* l_codec;
+    opj_image_t* l_image;
+    OPJ_BOOL l_accepted;
+    size_t i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        if (test(&streams[i]) != 0) {
+            return 1;
+        }
+    }
+
+    /* Invalid values are rejected */
+    l_image = test_create_image(1, 16, 16, 8, OPJ_FALSE, sample, 0);
+    l_codec = opj_create_compress(OPJ_CODEC_J2K);
+    if (!l_image || !l_codec) {
+        return 1;
+    }
+    opj_set_default_encoder_parameters(&l_param);
+    l_accepted = opj_setup_encoder(l_codec, &l_param, l_image) &&
+                 opj_encoder_set_extra_options(l_codec, l_invalid);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    if (l_accepted) {
+        fprintf(stderr, "%s was accepted\n", l_invalid[0]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that limiting the number of coding passes decoded per code-block */
+/* gives images that get closer to the full decoding as the limit grows, and */
+/* that the code-block cache, with or without */
+/* OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG, never mixes code-blocks */
+/* decoded with different limits. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define IMAGE_WIDTH 257
+#define IMAGE_HEIGHT 179
+
+typedef struct {
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int irreversible;
+    int mode; /* code-block style */
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 1) + y * 3 + ((x * y * 7 + compno) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    if (desc->irreversible) {
+        l_param.tcp_numlayers = 1;
+        l_param.tcp_rates[0] = 4;
+        l_param.cp_disto_alloc = 1;
+    }
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 32;
+    l_param.mode = desc->mode;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+
+    l_image = test_create_image(3, IMAGE_WIDTH, IMAGE_HEIGHT, 8, OPJ_FALSE,
+                                sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static opj_image_t* decode(opj_codec_t* p_codec, const char* filename,
+                           OPJ_UINT32 max_passes, OPJ_BOOL window,
+                           unsigned int flags)
+{
+    static const OPJ_INT32 l_area[4] = { 37, 21, 211, 160 };
+    opj_dparameters_t l_param;
+
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.flags = flags;
+    if (!opj_setup_decoder(p_codec, &l_param) ||
+            !opj_decoder_set_max_cblk_passes(p_codec, max_passes)) {
+        return NULL;
+    }
+    return test_decode(p_codec, filename, NULL, window ? l_area : NULL);
+}
+
+static opj_image_t* decode_once(const char* filename, OPJ_UINT32 max_passes,
+                                OPJ_BOOL window)
+{
+    opj_codec_t* l_codec;
+    opj_image_t* l_image;
+
+    l_codec = test_create_decompress(filename, NULL, 0);
+    if (!l_codec) {
+        return NULL;
+    }
+    l_image = decode(l_codec, filename, max_passes, window, 0);
+    opj_destroy_codec(l_codec);
+    return l_image;
+}
+
+/* Returns the sum of the squared differences of two images of the same */
+/* dimensions, or -1 if they differ in dimensions */
+static double squared_error(const opj_image_t* image1,
+                            const opj_image_t* image2)
+{
+    OPJ_UINT32 compno;
+    size_t i;
+    double sum = 0;
+    if (image1->numcomps != image2->numcomps) {
+        return -1;
+    }
+    for (compno = 0; compno < image1->numcomps; ++compno) {
+        const opj_image_comp_t* comp1 = &image1->comps[compno];
+        const opj_image_comp_t* comp2 = &image2->comps[compno];
+        if (comp1->w != comp2->w || comp1->h != comp2->h) {
+            return -1;
+        }
+        for (i = 0; i < (size_t)comp1->w * comp1->h; ++i) {
+            double diff = (double)comp1->data[i] - comp2->data[i];
+            sum += diff * diff;
+        }
+    }
+    return sum;
+}
+
+/* Decodes with limits of an increasing number of bit-planes, which must */
+/* get closer to the full decoding */
+static int test_limits(const char* filename, OPJ_BOOL window)
+{
+    opj_image_t* l_image_ref;
+    double l_last_error = -1;
+    OPJ_UINT32 bitplanes;
+    int ret = 1;
+
+    l_image_ref = decode_once(filename, 0, window);
+    if (!l_image_ref) {
+        fprintf(stderr, "Decoding of %s failed\n", filename);
+        return 1;
+    }
+    for (bitplanes = 1; bitplanes <= 12; ++bitplanes) {
+        opj_image_t* l_image = decode_once(filename, 3 * bitplanes - 2, window);
+        double l_error;
+        if (!l_image) {
+            fprintf(stderr, "Decoding of %u bit-planes failed\n", bitplanes);
+            goto end;
+        }
+        l_error = squared_error(l_image_ref, l_image);
+        opj_image_destroy(l_image);
+        if (l_error < 0 || (bitplanes == 1 && l_error == 0) ||
+                (l_last_error >= 0 && l_error > l_last_error)) {
+            fprintf(stderr, "Unexpected error with %u bit-planes: %f "
+                    "(previous: %f, window=%d)\n", bitplanes, l_error,
+                    l_last_error, window);
+            goto end;
+        }
+        l_last_error = l_error;
+    }
+    if (l_last_error != 0) {
+        fprintf(stderr, "12 bit-planes should decode the whole image\n");
+        goto end;
+    }
+    ret = 0;
+
+end:
+    opj_image_destroy(l_image_ref);
+    return ret;
+}
+
+/* Decodes with different limits with the same decompressor, which caches */
+/* code-blocks, and checks that the images match the ones decoded from */
+/* scratch */
+static int test_cache(const char* filename, OPJ_BOOL window,
+                      unsigned int flags, int num_threads)
+{
+    static const OPJ_UINT32 limits[] = { 4, 0, 4, 10, 7, 0, 1 };
+    opj_codec_t* l_cached_codec;
+    OPJ_UINT32 i;
+    int ret = 1;
+
+    l_cached_codec = test_create_decompress(filename, NULL, num_threads);
+    if (!l_cached_codec) {
+        return 1;
+    }
+    if (!opj_decoder_set_cblk_cache_size(l_cached_codec, 64 * 1024 * 1024)) {
+        fprintf(stderr, "opj_decoder_set_cblk_cache_size() failed\n");
+        goto end;
+    }
+
+    for (i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+        opj_image_t* l_image_ref;
+        opj_image_t* l_image;
+        double l_error;
+
+        l_image_ref = decode_once(filename, limits[i], window);
+        if (!l_image_ref) {
+            fprintf(stderr, "Decoding of %u passes failed\n", limits[i]);
+            goto end;
+        }
+        if (i > 0 && !opj_decoder_reset(l_cached_codec)) {
+            fprintf(stderr, "opj_decoder_reset() failed\n");
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+        l_image = decode(l_cached_codec, filename, limits[i], window, flags);
+        if (!l_image) {
+            fprintf(stderr, "Cached decoding of %u passes failed\n", limits[i]);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+        l_error = squared_error(l_image_ref, l_image);
+        opj_image_destroy(l_image_ref);
+        opj_image_destroy(l_image);
+        if (l_error != 0) {
+            fprintf(stderr, "Cached decoding of %u passes differs (window=%d, "
+                    "flags=%u, threads=%d)\n", limits[i], window, flags,
+                    num_threads);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    opj_destroy_codec(l_cached_codec);
+    return ret;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { 0, 0, 0 },
+        { 100, 0, 1 }, /* LAZY */
+        { 0, 0, 2 | 32 }, /* RESET, SEGSYM */
+        { 0, 0, 1 | 4 }, /* LAZY, RESTART */
+        { 128, 1, 0 }
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    const char* filename = "test_max_cblk_passes.j2k";
+    OPJ_UINT32 i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        if (!encode(filename, &streams[i])) {
+            fprintf(stderr, "Encoding of stream %u failed\n", i);
+            return 1;
+        }
+        if (test_limits(filename, OPJ_FALSE) != 0 ||
+                test_limits(filename, OPJ_TRUE) != 0 ||
+                test_cache(filename, OPJ_FALSE, 0, 0) != 0 ||
+                test_cache(filename, OPJ_TRUE,
+                           OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG, 0) != 0 ||
+                test_cache(filename, OPJ_FALSE,
+                           OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG, 4) != 0) {
+            fprintf(stderr, "Failure with stream %u\n", i);
+            return 1;
+        }
+    }
+    return 0;
+}
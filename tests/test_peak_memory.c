@@ -0,0 +1,400 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that the peak heap usage of encoding and decoding representative */
+/* codestreams stays within a budget per case, to catch memory regressions */
+/* in the allocation paths of tcd.c and j2k.c, and that opj_estimate_decode() */
+/* predicts the memory allocated by the decoding. The heap is measured by */
+/* replacing the malloc() family of glibc in this executable, which also */
+/* serves the allocations of the library. */
+/* Usage: test_peak_memory [case_name] (all cases by default) */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+/* Return code for the cases that cannot be measured on this platform, */
+/* which ctest reports as skipped */
+#define SKIP_RETURN_CODE 77
+
+typedef struct {
+    const char* name;
+    OPJ_UINT32 width;
+    OPJ_UINT32 height;
+    OPJ_UINT32 numcomps;
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    OPJ_UINT32 region_size; /* size of a centered area to decode, or 0 */
+    /* Budgets for the peak heap usage, in KiB. 0 to not check the encoding */
+    size_t encode_budget_kb;
+    size_t decode_budget_kb;
+} case_desc_t;
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && \
+    !defined(__SANITIZE_THREAD__)
+
+#include <errno.h>
+#include <malloc.h>
+
+/* Entry points of the allocator of glibc */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static volatile size_t heap_current = 0;
+static volatile size_t heap_peak = 0;
+
+static void heap_add(void* ptr)
+{
+    if (ptr != NULL) {
+        size_t l_current = __sync_add_and_fetch(&heap_current,
+                                                malloc_usable_size(ptr));
+        size_t l_peak = heap_peak;
+        while (l_current > l_peak) {
+            l_peak = __sync_val_compare_and_swap(&heap_peak, l_peak, l_current);
+        }
+    }
+}
+
+static void heap_remove(void* ptr)
+{
+    if (ptr != NULL) {
+        __sync_sub_and_fetch(&heap_current, malloc_usable_size(ptr));
+    }
+}
+
+void* malloc(size_t size)
+{
+    void* ptr = __libc_malloc(size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    void* ptr = __libc_calloc(nmemb, size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    size_t l_old_size = ptr != NULL ? malloc_usable_size(ptr) : 0;
+    void* new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr != NULL || size == 0) {
+        __sync_sub_and_fetch(&heap_current, l_old_size);
+        heap_add(new_ptr);
+    }
+    return new_ptr;
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    void* ptr = __libc_memalign(alignment, size);
+    heap_add(ptr);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+    void* ptr;
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    ptr = memalign(alignment, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    heap_remove(ptr);
+    __libc_free(ptr);
+}
+
+/* Starts a measurement, and returns the heap usage at its start */
+static size_t heap_reset_peak(void)
+{
+    size_t l_current = heap_current;
+    heap_peak = l_current;
+    return l_current;
+}
+
+#define HEAP_MEASURED 1
+
+#endif /* __GLIBC__ */
+
+#ifdef HEAP_MEASURED
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[ERROR] %s", msg);
+}
+
+static opj_image_t* create_image(const case_desc_t* desc)
+{
+    opj_image_cmptparm_t* l_params;
+    opj_image_t* l_image;
+    OPJ_UINT32 compno, x, y;
+
+    l_params = (opj_image_cmptparm_t*) calloc(desc->numcomps,
+               sizeof(opj_image_cmptparm_t));
+    if (!l_params) {
+        return NULL;
+    }
+    for (compno = 0; compno < desc->numcomps; ++compno) {
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = desc->width;
+        l_params[compno].h = desc->height;
+        l_params[compno].prec = 8;
+    }
+    l_image = opj_image_create(desc->numcomps, l_params,
+                               desc->numcomps == 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    free(l_params);
+    if (!l_image) {
+        return NULL;
+    }
+    l_image->x1 = desc->width;
+    l_image->y1 = desc->height;
+    for (compno = 0; compno < desc->numcomps; ++compno) {
+        OPJ_INT32* l_data = l_image->comps[compno].data;
+        for (y = 0; y < desc->height; ++y) {
+            for (x = 0; x < desc->width; ++x) {
+                l_data[(size_t)y * desc->width + x] = (OPJ_INT32)
+                                                      ((x * (compno + 1) + y * 3 + ((x * y * 7 + compno) & 31)) & 255);
+            }
+        }
+    }
+    return l_image;
+}
+
+static OPJ_BOOL encode(const char* filename, const case_desc_t* desc,
+                       opj_image_t* image)
+{
+    opj_cparameters_t l_param;
+    opj_codec_t * l_codec;
+    opj_stream_t * l_stream;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 3;
+    l_param.cp_disto_alloc = 1;
+    l_param.tcp_rates[0] = 40;
+    l_param.tcp_rates[1] = 10;
+    l_param.tcp_rates[2] = 0;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+        while (l_param.numresolution > 1 &&
+                (desc->tile_size >> (l_param.numresolution - 1)) == 0) {
+            l_param.numresolution --;
+        }
+    }
+
+    l_codec = opj_create_compress(OPJ_CODEC_J2K);
+    opj_set_error_handler(l_codec, error_callback, 00);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    if (l_stream &&
+            opj_setup_encoder(l_codec, &l_param, image) &&
+            opj_start_compress(l_codec, image, l_stream) &&
+            opj_encode(l_codec, l_stream) &&
+            opj_end_compress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+/* Tolerance of the prediction of opj_estimate_decode(), in percent */
+#define ESTIMATE_TOLERANCE 25
+
+static OPJ_BOOL decode(const char* filename, const case_desc_t* desc)
+{
+    opj_dparameters_t l_param;
+    opj_decode_estimate_t l_estimate;
+    opj_image_t* l_image = NULL;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    l_codec = opj_create_decompress(OPJ_CODEC_J2K);
+    if (!l_codec) {
+        return OPJ_FALSE;
+    }
+    opj_set_error_handler(l_codec, error_callback, 00);
+    opj_set_default_decoder_parameters(&l_param);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (l_stream &&
+            opj_setup_decoder(l_codec, &l_param) &&
+            opj_read_header(l_stream, l_codec, &l_image)) {
+        OPJ_INT32 x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        if (desc->region_size) {
+            x0 = (OPJ_INT32)((desc->width - desc->region_size) / 2);
+            y0 = (OPJ_INT32)((desc->height - desc->region_size) / 2);
+            x1 = x0 + (OPJ_INT32)desc->region_size;
+            y1 = y0 + (OPJ_INT32)desc->region_size;
+        }
+        if (opj_set_decode_area(l_codec, l_image, x0, y0, x1, y1) &&
+                opj_estimate_decode(l_codec, l_stream, l_image, &l_estimate)) {
+            /* The estimate excludes what is already allocated */
+            size_t l_header_peak = heap_peak;
+            size_t l_start = heap_reset_peak();
+            size_t l_peak;
+
+            ret = opj_decode(l_codec, l_stream, l_image) &&
+                  opj_end_decompress(l_codec, l_stream);
+            l_peak = heap_peak - l_start;
+            if (l_header_peak > heap_peak) {
+                heap_peak = l_header_peak;
+            }
+            printf("%s: decoding estimated to %lu KiB, %lu KiB allocated\n",
+                   desc->name, (unsigned long)(l_estimate.peak_memory / 1024),
+                   (unsigned long)(l_peak / 1024));
+            if (ret && (l_estimate.peak_memory * 100 <
+                        (OPJ_UINT64)l_peak * (100 - ESTIMATE_TOLERANCE) ||
+                        l_estimate.peak_memory * 100 >
+                        (OPJ_UINT64)l_peak * (100 + ESTIMATE_TOLERANCE))) {
+                fprintf(stderr, "%s: decoding memory badly estimated\n", desc->name);
+                ret = OPJ_FALSE;
+            }
+        }
+    }
+    opj_image_destroy(l_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+static int check_budget(const char* case_name, const char* operation,
+                        size_t peak, size_t budget_kb)
+{
+    size_t l_peak_kb = (peak + 1023) / 1024;
+
+    printf("%s: %s peak heap %lu KiB, budget %lu KiB\n", case_name, operation,
+           (unsigned long)l_peak_kb, (unsigned long)budget_kb);
+    if (l_peak_kb > budget_kb) {
+        fprintf(stderr, "%s: %s peak heap exceeds its budget by %lu KiB\n",
+                case_name, operation, (unsigned long)(l_peak_kb - budget_kb));
+        return 1;
+    }
+    return 0;
+}
+
+static int run_case(const case_desc_t* desc)
+{
+    /* One file per case, as ctest may run the cases in parallel */
+    char filename[64];
+    opj_image_t* l_image;
+    size_t l_start;
+    int ret = 0;
+
+    sprintf(filename, "test_peak_memory_%.32s.j2k", desc->name);
+
+    /* The input image belongs to the caller of the encoder, and is not */
+    /* accounted to it */
+    l_image = create_image(desc);
+    if (!l_image) {
+        fprintf(stderr, "%s: cannot create image\n", desc->name);
+        return 1;
+    }
+    l_start = heap_reset_peak();
+    if (!encode(filename, desc, l_image)) {
+        fprintf(stderr, "%s: encoding failed\n", desc->name);
+        opj_image_destroy(l_image);
+        return 1;
+    }
+    if (desc->encode_budget_kb) {
+        ret |= check_budget(desc->name, "encoding", heap_peak - l_start,
+                            desc->encode_budget_kb);
+    }
+    opj_image_destroy(l_image);
+
+    l_start = heap_reset_peak();
+    if (!decode(filename, desc)) {
+        fprintf(stderr, "%s: decoding failed\n", desc->name);
+        return 1;
+    }
+    ret |= check_budget(desc->name, "decoding", heap_peak - l_start,
+                        desc->decode_budget_kb);
+    return ret;
+}
+
+#endif /* HEAP_MEASURED */
+
+int main(int argc, char* argv[])
+{
+    /* Budgets are about 10% above the usage measured on x86_64 */
+    static const case_desc_t cases[] = {
+        { "single_tile", 3000, 2000, 1, 0, 0, 44300, 31300 },
+        { "small_tiles", 1024, 1024, 3, 32, 0, 11300, 23800 },
+        { "many_components", 128, 128, 100, 0, 0, 19900, 10700 },
+        /* Only the decoding of a small area is of interest */
+        { "region", 2048, 2048, 1, 0, 256, 0, 9800 }
+    };
+    const size_t nb_cases = sizeof(cases) / sizeof(cases[0]);
+    size_t i;
+    int ret = 0;
+    OPJ_BOOL found = OPJ_FALSE;
+
+    for (i = 0; i < nb_cases; ++i) {
+        if (argc > 1 && strcmp(argv[1], cases[i].name) != 0) {
+            continue;
+        }
+        found = OPJ_TRUE;
+#ifdef HEAP_MEASURED
+        ret |= run_case(&cases[i]);
+#endif
+    }
+    if (!found) {
+        fprintf(stderr, "Unknown case %s\n", argv[1]);
+        return 1;
+    }
+#ifndef HEAP_MEASURED
+    printf("Heap usage can only be measured with glibc, without sanitizers\n");
+    ret = SKIP_RETURN_CODE;
+#endif
+    return ret;
+}
@@ -0,0 +1,202 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that codestreams with PLT markers, whose packets can be decoded in */
+/* parallel, decode with several threads to the same images as with a single */
+/* thread, including when the PLT markers are inconsistent with the packets. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define IMAGE_WIDTH 237
+#define IMAGE_HEIGHT 181
+
+typedef struct {
+    OPJ_UINT32 numcomps;
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    OPJ_PROG_ORDER prog_order;
+    int csty;
+    char tp_flag; /* 0 for a single tile-part per tile */
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 1) + y * 3 + ((x * y * 7 + compno) & 31)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc)
+{
+    const char* const l_options[] = { "PLT=YES", NULL };
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    int layno;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 6;
+    l_param.cp_disto_alloc = 1;
+    for (layno = 0; layno < l_param.tcp_numlayers; ++layno) {
+        l_param.tcp_rates[layno] = (float)(160 >> layno);
+    }
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 16;
+    l_param.cblockh_init = 16;
+    l_param.csty = desc->csty | 0x01;
+    l_param.res_spec = 1;
+    l_param.prcw_init[0] = 32;
+    l_param.prch_init[0] = 32;
+    l_param.prog_order = desc->prog_order;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+    if (desc->tp_flag) {
+        l_param.tp_on = 1;
+        l_param.tp_flag = desc->tp_flag;
+    }
+
+    l_image = test_create_image(desc->numcomps, IMAGE_WIDTH, IMAGE_HEIGHT, 8,
+                                OPJ_FALSE, sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, l_options);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+/* Make the length of the first packet of the first PLT marker wrong, */
+/* without making the marker itself invalid */
+static OPJ_BOOL corrupt_plt(const char* filename)
+{
+    FILE* f = fopen(filename, "rb+");
+    unsigned char l_buffer[4096];
+    size_t l_size, i;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    if (!f) {
+        return OPJ_FALSE;
+    }
+    l_size = fread(l_buffer, 1, sizeof(l_buffer), f);
+    for (i = 0; i + 5 < l_size; ++i) {
+        /* PLT marker, then Lplt (2 bytes) and Zplt (1 byte) */
+        if (l_buffer[i] == 0xff && l_buffer[i + 1] == 0x58) {
+            unsigned char* l_iplt = &l_buffer[i + 5];
+            *l_iplt = (unsigned char)((*l_iplt & 0x80) | ((*l_iplt + 1) & 0x7f));
+            ret = fseek(f, (long)(i + 5), SEEK_SET) == 0 &&
+                  fwrite(l_iplt, 1, 1, f) == 1;
+            break;
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+static opj_image_t* decode(const char* filename, OPJ_UINT32 reduce,
+                           OPJ_UINT32 layers, int num_threads)
+{
+    opj_dparameters_t l_param;
+
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.cp_reduce = reduce;
+    l_param.cp_layer = layers;
+    return test_decode_once(filename, &l_param, NULL, num_threads);
+}
+
+static int test(const char* filename, OPJ_UINT32 reduce, OPJ_UINT32 layers)
+{
+    opj_image_t* l_image_ref;
+    opj_image_t* l_image;
+    OPJ_BOOL l_same;
+
+    l_image_ref = decode(filename, reduce, layers, 1);
+    if (!l_image_ref) {
+        fprintf(stderr, "Decoding of %s failed with 1 thread\n", filename);
+        return 1;
+    }
+    l_image = decode(filename, reduce, layers, 4);
+    if (!l_image) {
+        fprintf(stderr, "Decoding of %s failed with 4 threads\n", filename);
+        opj_image_destroy(l_image_ref);
+        return 1;
+    }
+    l_same = test_same_images(l_image_ref, l_image);
+    opj_image_destroy(l_image_ref);
+    opj_image_destroy(l_image);
+    if (!l_same) {
+        fprintf(stderr, "%s decodes differently with 4 threads "
+                "(reduce=%u, layers=%u)\n", filename, reduce, layers);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { 3, 0, OPJ_LRCP, 0, 0 },
+        { 1, 0, OPJ_RPCL, 0x02 | 0x04, 0 },
+        { 3, 64, OPJ_PCRL, 0, 0 },
+        { 3, 100, OPJ_CPRL, 0x02, 'R' },
+        { 3, 0, OPJ_RLCP, 0x04, 'L' }
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    const char* filename = "test_plt_decoding.j2k";
+    OPJ_UINT32 i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        if (!encode(filename, &streams[i])) {
+            fprintf(stderr, "Encoding of stream %u failed\n", i);
+            return 1;
+        }
+        if (test(filename, 0, 0) != 0 ||
+                test(filename, 1, 0) != 0 ||
+                test(filename, 0, 2) != 0) {
+            return 1;
+        }
+        if (!corrupt_plt(filename)) {
+            fprintf(stderr, "No PLT marker in stream %u\n", i);
+            return 1;
+        }
+        if (test(filename, 0, 0) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that opj_probe_header() reports the same characteristics as */
+/* opj_read_header() and opj_get_cstr_info(), and that it fails cleanly on */
+/* truncated or invalid data. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define FILENAME_J2K "test_probe_header.j2k"
+#define FILENAME_JP2 "test_probe_header.jp2"
+
+typedef struct {
+    OPJ_UINT32 numcomps;
+    OPJ_UINT32 width;
+    OPJ_UINT32 height;
+    OPJ_UINT32 prec;
+    OPJ_UINT32 sgnd;
+    OPJ_UINT32 dx_last; /* subsampling of the last component */
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int irreversible;
+    OPJ_PROG_ORDER prog_order;
+} image_desc_t;
+
+static OPJ_BOOL encode(const char* filename, const image_desc_t* desc)
+{
+    opj_cparameters_t l_param;
+    opj_image_cmptparm_t l_params[4];
+    opj_image_t * l_image;
+    OPJ_UINT32 compno, i;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 3;
+    l_param.cp_disto_alloc = 1;
+    l_param.tcp_rates[0] = 40;
+    l_param.tcp_rates[1] = 10;
+    l_param.tcp_rates[2] = desc->irreversible ? 2 : 0;
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 5;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 16;
+    l_param.prog_order = desc->prog_order;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+
+    /* The last component may be subsampled, which test_create_image() */
+    /* does not do */
+    memset(l_params, 0, sizeof(l_params));
+    for (compno = 0; compno < desc->numcomps; ++compno) {
+        l_params[compno].dx = compno + 1 == desc->numcomps ? desc->dx_last : 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = (desc->width + l_params[compno].dx - 1) /
+                             l_params[compno].dx;
+        l_params[compno].h = desc->height;
+        l_params[compno].prec = desc->prec;
+        l_params[compno].sgnd = desc->sgnd;
+    }
+    l_image = opj_image_create(desc->numcomps, l_params,
+                               desc->numcomps >= 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    l_image->x1 = desc->width;
+    l_image->y1 = desc->height;
+    for (compno = 0; compno < desc->numcomps; ++compno) {
+        opj_image_comp_t* l_comp = &l_image->comps[compno];
+        for (i = 0; i < l_comp->w * l_comp->h; ++i) {
+            l_comp->data[i] = (OPJ_INT32)((i * (compno + 7)) % (1U << (desc->prec - 1)));
+        }
+    }
+
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+#define CHECK(cond) \
+    if (!(cond)) { \
+        fprintf(stderr, "%s: check failed: %s\n", filename, #cond); \
+        ret = 1; \
+    }
+
+static int compare_with_decoder(const char* filename,
+                                const opj_header_info_t* info)
+{
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    opj_image_t* l_image = NULL;
+    opj_codestream_info_v2_t* l_cstr_info;
+    const opj_tccp_info_t* l_tccp;
+    int ret = 0;
+
+    l_codec = test_create_decompress(filename, NULL, 0);
+    if (!l_codec) {
+        return 1;
+    }
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_TRUE);
+    if (!l_stream || !opj_read_header(l_stream, l_codec, &l_image)) {
+        opj_stream_destroy(l_stream);
+        opj_destroy_codec(l_codec);
+        return 1;
+    }
+    l_cstr_info = opj_get_cstr_info(l_codec);
+    /* The JP2 colour space is only applied to the image when decoding */
+    if (!opj_decode(l_codec, l_stream, l_image)) {
+        ret = 1;
+    }
+    l_tccp = &l_cstr_info->m_default_tile_info.tccp_info[0];
+
+    CHECK(info->x0 == l_image->x0);
+    CHECK(info->y0 == l_image->y0);
+    CHECK(info->x1 == l_image->x1);
+    CHECK(info->y1 == l_image->y1);
+    CHECK(info->numcomps == l_image->numcomps);
+    CHECK(info->prec == l_image->comps[0].prec);
+    CHECK(info->sgnd == l_image->comps[0].sgnd);
+    CHECK(info->dx == l_image->comps[0].dx);
+    CHECK(info->dy == l_image->comps[0].dy);
+    CHECK(info->same_comps == (l_image->comps[l_image->numcomps - 1].dx ==
+                               l_image->comps[0].dx));
+    CHECK(info->color_space == l_image->color_space);
+    CHECK(info->tx0 == l_cstr_info->tx0);
+    CHECK(info->ty0 == l_cstr_info->ty0);
+    CHECK(info->tdx == l_cstr_info->tdx);
+    CHECK(info->tdy == l_cstr_info->tdy);
+    CHECK(info->tw == l_cstr_info->tw);
+    CHECK(info->th == l_cstr_info->th);
+    CHECK(info->has_cod);
+    CHECK(info->csty == l_cstr_info->m_default_tile_info.csty);
+    CHECK(info->prg == l_cstr_info->m_default_tile_info.prg);
+    CHECK(info->numlayers == l_cstr_info->m_default_tile_info.numlayers);
+    CHECK(info->mct == l_cstr_info->m_default_tile_info.mct);
+    CHECK(info->numresolutions == l_tccp->numresolutions);
+    CHECK(info->cblkw == l_tccp->cblkw);
+    CHECK(info->cblkh == l_tccp->cblkh);
+    CHECK(info->cblksty == l_tccp->cblksty);
+    CHECK(info->qmfbid == l_tccp->qmfbid);
+    CHECK(info->has_qcd);
+    CHECK(info->qntsty == l_tccp->qntsty);
+    CHECK(info->numgbits == l_tccp->numgbits);
+
+    opj_destroy_cstr_info(&l_cstr_info);
+    opj_image_destroy(l_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+static int test(const char* filename, const image_desc_t* desc)
+{
+    opj_header_info_t l_info;
+    OPJ_BYTE* l_data;
+    size_t l_size;
+    OPJ_SIZE_T l_prefix;
+    OPJ_BOOL l_ok;
+    int ret = 0;
+
+    if (!encode(filename, desc)) {
+        fprintf(stderr, "%s: encoding failed\n", filename);
+        return 1;
+    }
+    l_data = test_read_file(filename, &l_size);
+    if (!l_data) {
+        return 1;
+    }
+
+    if (!opj_probe_header(l_data, l_size, &l_info)) {
+        fprintf(stderr, "%s: probe failed\n", filename);
+        free(l_data);
+        return 1;
+    }
+    CHECK(l_info.format == test_codec_format(filename));
+    ret |= compare_with_decoder(filename, &l_info);
+
+    /* Truncated data: the probe either fails or reports the same image */
+    for (l_prefix = 0; l_prefix < l_size && l_prefix < 400; ++l_prefix) {
+        opj_header_info_t l_partial_info;
+        OPJ_BYTE* l_copy = (OPJ_BYTE*)malloc(l_prefix + 1);
+        memcpy(l_copy, l_data, l_prefix);
+        l_ok = opj_probe_header(l_copy, l_prefix, &l_partial_info);
+        free(l_copy);
+        if (l_ok) {
+            CHECK(l_partial_info.x1 == l_info.x1 && l_partial_info.y1 == l_info.y1 &&
+                  l_partial_info.numcomps == l_info.numcomps &&
+                  l_partial_info.tw == l_info.tw && l_partial_info.th == l_info.th);
+            CHECK(!l_partial_info.has_cod || l_partial_info.numlayers == l_info.numlayers);
+        }
+    }
+
+    /* Corrupted signature */
+    l_data[l_info.format == OPJ_CODEC_JP2 ? 11 : 1] ^= 0x55;
+    CHECK(!opj_probe_header(l_data, l_size, &l_info));
+
+    free(l_data);
+    return ret;
+}
+
+int main(void)
+{
+    static const image_desc_t descs[] = {
+        { 3, 300, 200, 8, 0, 1, 0, 0, OPJ_LRCP },
+        { 3, 300, 200, 8, 0, 1, 128, 1, OPJ_RPCL },
+        { 1, 77, 1000, 12, 1, 1, 64, 0, OPJ_CPRL },
+        { 4, 256, 256, 16, 0, 2, 100, 1, OPJ_PCRL }
+    };
+    OPJ_UINT32 i;
+    int ret = 0;
+
+    for (i = 0; i < sizeof(descs) / sizeof(descs[0]); ++i) {
+        ret |= test(FILENAME_J2K, &descs[i]);
+        ret |= test(FILENAME_JP2, &descs[i]);
+    }
+    return ret;
+}
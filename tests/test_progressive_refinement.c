@@ -0,0 +1,208 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that decoding a codestream with an increasing number of quality */
+/* layers, with OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG so that the */
+/* decoding of code-blocks resumes from the passes of the previous layers, */
+/* gives the same images as decoding each number of layers from scratch. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define NUM_LAYERS 6
+#define IMAGE_WIDTH 257
+#define IMAGE_HEIGHT 179
+
+typedef struct {
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int irreversible;
+    int mode; /* code-block style */
+    int roi_shift; /* 0 for no ROI */
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 1) + y * 3 + ((x * y * 7 + compno) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    int layno;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = NUM_LAYERS;
+    l_param.cp_disto_alloc = 1;
+    for (layno = 0; layno < NUM_LAYERS; ++layno) {
+        l_param.tcp_rates[layno] = (float)(200 >> layno);
+    }
+    if (!desc->irreversible) {
+        l_param.tcp_rates[NUM_LAYERS - 1] = 0;
+    }
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 32;
+    l_param.cblockh_init = 32;
+    l_param.mode = desc->mode;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+    if (desc->roi_shift) {
+        l_param.roi_compno = 0;
+        l_param.roi_shift = desc->roi_shift;
+    }
+
+    l_image = test_create_image(3, IMAGE_WIDTH, IMAGE_HEIGHT, 8, OPJ_FALSE,
+                                sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static opj_image_t* decode(opj_codec_t* p_codec, const char* filename,
+                           OPJ_UINT32 layers, OPJ_BOOL window,
+                           unsigned int flags)
+{
+    static const OPJ_INT32 l_area[4] = { 37, 21, 211, 160 };
+    opj_dparameters_t l_param;
+
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.cp_layer = layers;
+    l_param.flags = flags;
+    return test_decode(p_codec, filename, &l_param, window ? l_area : NULL);
+}
+
+static int test(const stream_desc_t* desc, OPJ_BOOL window, int num_threads)
+{
+    const char* filename = "test_progressive_refinement.j2k";
+    opj_codec_t* l_refined_codec;
+    OPJ_UINT32 layers;
+    int ret = 1;
+
+    if (!encode(filename, desc)) {
+        fprintf(stderr, "Encoding failed\n");
+        return 1;
+    }
+
+    l_refined_codec = test_create_decompress(filename, NULL, num_threads);
+    if (!l_refined_codec) {
+        return 1;
+    }
+    if (!opj_decoder_set_cblk_cache_size(l_refined_codec, 64 * 1024 * 1024)) {
+        fprintf(stderr, "opj_decoder_set_cblk_cache_size() failed\n");
+        goto end;
+    }
+
+    for (layers = 1; layers <= NUM_LAYERS; ++layers) {
+        opj_codec_t* l_codec;
+        opj_image_t* l_image_ref;
+        opj_image_t* l_image;
+        OPJ_BOOL l_same;
+
+        l_codec = test_create_decompress(filename, NULL, 0);
+        if (!l_codec) {
+            goto end;
+        }
+        l_image_ref = decode(l_codec, filename, layers, window, 0);
+        opj_destroy_codec(l_codec);
+        if (!l_image_ref) {
+            fprintf(stderr, "Decoding of %u layers failed\n", layers);
+            goto end;
+        }
+
+        if (layers > 1 && !opj_decoder_reset(l_refined_codec)) {
+            fprintf(stderr, "opj_decoder_reset() failed\n");
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+        l_image = decode(l_refined_codec, filename, layers, window,
+                         OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG);
+        if (!l_image) {
+            fprintf(stderr, "Refinement to %u layers failed\n", layers);
+            opj_image_destroy(l_image_ref);
+            goto end;
+        }
+
+        l_same = test_same_images(l_image_ref, l_image);
+        opj_image_destroy(l_image_ref);
+        opj_image_destroy(l_image);
+        if (!l_same) {
+            fprintf(stderr, "Refinement to %u layers differs (tile_size=%u, "
+                    "irreversible=%d, mode=%d, roi_shift=%d, window=%d, "
+                    "threads=%d)\n", layers, desc->tile_size, desc->irreversible,
+                    desc->mode, desc->roi_shift, window, num_threads);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    opj_destroy_codec(l_refined_codec);
+    return ret;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { 0, 0, 0, 0 },
+        { 128, 1, 0, 0 },
+        { 0, 1, 1 | 2 | 4 | 8 | 16 | 32, 0 }, /* all code-block styles */
+        { 100, 0, 1, 0 }, /* LAZY */
+        { 0, 0, 2 | 32, 0 }, /* RESET, SEGSYM */
+        { 0, 0, 4, 0 }, /* RESTART */
+        { 0, 1, 16, 4 } /* ERTERM, ROI */
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    OPJ_UINT32 i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        if (test(&streams[i], OPJ_FALSE, 0) != 0 ||
+                test(&streams[i], OPJ_TRUE, 0) != 0 ||
+                test(&streams[i], OPJ_FALSE, 4) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
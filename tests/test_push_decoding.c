@@ -0,0 +1,301 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that pushing a codestream by chunks and decoding the data received */
+/* after each chunk gives the same images as decoding each truncated */
+/* codestream from scratch, and the complete image at the end, and that */
+/* truncated codestreams are still rejected in strict mode. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+#define IMAGE_WIDTH 213
+#define IMAGE_HEIGHT 167
+#define NUM_CHUNKS 16
+/* Size of the first chunk, which does not contain the whole main header */
+#define FIRST_CHUNK_SIZE 20
+
+typedef struct {
+    OPJ_BOOL jp2;
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    OPJ_PROG_ORDER prog_order;
+    int csty;
+    char tp_flag; /* 0 for a single tile-part per tile */
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 2) + y * 5 + ((x * y * 3 + compno) & 63)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc)
+{
+    opj_cparameters_t l_param;
+    opj_image_t * l_image;
+    int layno;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 5;
+    l_param.cp_disto_alloc = 1;
+    for (layno = 0; layno < l_param.tcp_numlayers; ++layno) {
+        l_param.tcp_rates[layno] = (float)(80 >> layno);
+    }
+    l_param.numresolution = 4;
+    l_param.cblockw_init = 16;
+    l_param.cblockh_init = 16;
+    l_param.csty = desc->csty;
+    l_param.prog_order = desc->prog_order;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+    if (desc->tp_flag) {
+        l_param.tp_on = 1;
+        l_param.tp_flag = desc->tp_flag;
+    }
+
+    l_image = test_create_image(3, IMAGE_WIDTH, IMAGE_HEIGHT, 8, OPJ_FALSE,
+                                sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+/* Decodes a file with a file stream */
+static opj_image_t* decode_file(const char* filename, OPJ_BOOL strict)
+{
+    opj_image_t* l_image = NULL;
+    opj_codec_t* l_codec;
+
+    l_codec = test_create_decompress(filename, NULL, 0);
+    if (!l_codec) {
+        return NULL;
+    }
+    if (opj_decoder_set_strict_mode(l_codec, strict)) {
+        l_image = test_decode(l_codec, filename, NULL, NULL);
+    }
+    opj_destroy_codec(l_codec);
+    return l_image;
+}
+
+/* Decodes data pushed at once into a new push stream, with a new codec */
+static opj_image_t* decode_pushed_at_once(const unsigned char* p_data,
+        size_t p_size, OPJ_CODEC_FORMAT format)
+{
+    opj_dparameters_t l_param;
+    opj_image_t* l_image = NULL;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+
+    l_codec = opj_create_decompress(format);
+    if (!l_codec) {
+        return NULL;
+    }
+    opj_set_default_decoder_parameters(&l_param);
+    l_stream = opj_stream_create_push_stream();
+    if (!l_stream ||
+            !opj_setup_decoder(l_codec, &l_param) ||
+            !opj_stream_push_data(l_stream, p_data, p_size) ||
+            !opj_decode_pushed_data(l_codec, l_stream, &l_image)) {
+        l_image = NULL;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return l_image;
+}
+
+/* Pushes the codestream by chunks, and checks the image decoded after each */
+/* chunk */
+static int test(const char* filename, const char* truncated_filename)
+{
+    const OPJ_CODEC_FORMAT format = test_codec_format(filename);
+    opj_dparameters_t l_param;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream;
+    opj_image_t* l_image_ref;
+    unsigned char* l_data;
+    size_t l_size = 0, l_pushed = 0, l_chunk;
+    OPJ_BOOL l_decoded_once = OPJ_FALSE;
+    int ret = 1;
+
+    l_data = test_read_file(filename, &l_size);
+    l_image_ref = decode_file(filename, OPJ_TRUE);
+    if (!l_data || !l_image_ref) {
+        fprintf(stderr, "Decoding of %s failed\n", filename);
+        free(l_data);
+        opj_image_destroy(l_image_ref);
+        return 1;
+    }
+
+    l_codec = opj_create_decompress(format);
+    opj_set_error_handler(l_codec, test_error_callback, 00);
+    opj_set_default_decoder_parameters(&l_param);
+    l_param.flags |= OPJ_DPARAMETERS_PROGRESSIVE_REFINEMENT_FLAG;
+    l_stream = opj_stream_create_push_stream();
+    if (!l_stream ||
+            !opj_setup_decoder(l_codec, &l_param) ||
+            (opj_has_thread_support() && !opj_codec_set_threads(l_codec, 4)) ||
+            !opj_decoder_set_cblk_cache_size(l_codec, 64 * 1024 * 1024)) {
+        fprintf(stderr, "Cannot create the push decoder\n");
+        goto cleanup;
+    }
+
+    /* Odd sized chunks, so that the codestream is cut anywhere */
+    l_chunk = l_size / NUM_CHUNKS + 7;
+    while (l_pushed < l_size) {
+        opj_image_t* l_image = NULL;
+        opj_image_t* l_image_scratch;
+        size_t l_nb = l_pushed == 0 ? FIRST_CHUNK_SIZE : l_chunk;
+
+        if (l_nb > l_size - l_pushed) {
+            l_nb = l_size - l_pushed;
+        }
+
+        if (!opj_stream_push_data(l_stream, l_data + l_pushed, l_nb)) {
+            fprintf(stderr, "opj_stream_push_data() failed\n");
+            goto cleanup;
+        }
+        l_pushed += l_nb;
+
+        if (!opj_decode_pushed_data(l_codec, l_stream, &l_image)) {
+            if (l_image) {
+                fprintf(stderr, "%s: image not set to NULL\n", filename);
+                goto cleanup;
+            }
+            if (l_decoded_once) {
+                fprintf(stderr, "%s: decoding failed with %u bytes after a "
+                        "successful decoding\n", filename, (unsigned)l_pushed);
+                goto cleanup;
+            }
+            continue;
+        }
+        if (l_pushed == FIRST_CHUNK_SIZE) {
+            fprintf(stderr, "%s: decoding succeeded without the main header\n",
+                    filename);
+            opj_image_destroy(l_image);
+            goto cleanup;
+        }
+        l_decoded_once = OPJ_TRUE;
+
+        l_image_scratch = decode_pushed_at_once(l_data, l_pushed, format);
+        if (!l_image_scratch || !test_same_images(l_image, l_image_scratch)) {
+            fprintf(stderr, "%s: decoding of %u bytes differs from scratch\n",
+                    filename, (unsigned)l_pushed);
+            opj_image_destroy(l_image);
+            opj_image_destroy(l_image_scratch);
+            goto cleanup;
+        }
+        opj_image_destroy(l_image_scratch);
+
+        if (l_pushed < l_size) {
+            opj_image_t* l_image_strict;
+            opj_image_t* l_image_non_strict;
+
+            /* A truncated file is only decoded in non strict mode */
+            if (!test_write_file(truncated_filename, l_data, l_pushed)) {
+                opj_image_destroy(l_image);
+                goto cleanup;
+            }
+            l_image_strict = decode_file(truncated_filename, OPJ_TRUE);
+            l_image_non_strict = decode_file(truncated_filename, OPJ_FALSE);
+            if (l_image_strict || !l_image_non_strict ||
+                    !test_same_images(l_image, l_image_non_strict)) {
+                fprintf(stderr, "%s: wrong decoding of the file truncated to "
+                        "%u bytes\n", filename, (unsigned)l_pushed);
+                opj_image_destroy(l_image);
+                opj_image_destroy(l_image_strict);
+                opj_image_destroy(l_image_non_strict);
+                goto cleanup;
+            }
+            opj_image_destroy(l_image_non_strict);
+        } else if (!test_same_images(l_image, l_image_ref)) {
+            fprintf(stderr, "%s: decoding of the pushed data differs from the "
+                    "decoding of the file\n", filename);
+            opj_image_destroy(l_image);
+            goto cleanup;
+        }
+        opj_image_destroy(l_image);
+    }
+    if (!l_decoded_once) {
+        fprintf(stderr, "%s: the pushed data was never decoded\n", filename);
+        goto cleanup;
+    }
+    ret = 0;
+
+cleanup:
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image_ref);
+    free(l_data);
+    return ret;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        { OPJ_FALSE, 0, OPJ_LRCP, 0, 0 },
+        { OPJ_FALSE, 0, OPJ_RLCP, 0x02 | 0x04, 0 },
+        { OPJ_FALSE, 64, OPJ_RPCL, 0, 0 },
+        { OPJ_FALSE, 100, OPJ_CPRL, 0x02, 'R' },
+        { OPJ_TRUE, 0, OPJ_LRCP, 0, 0 }
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    OPJ_UINT32 i;
+
+    for (i = 0; i < nb_streams; ++i) {
+        const char* filename = streams[i].jp2 ? "test_push_decoding.jp2" :
+                               "test_push_decoding.j2k";
+        const char* truncated_filename = streams[i].jp2 ?
+                                         "test_push_decoding_truncated.jp2" :
+                                         "test_push_decoding_truncated.j2k";
+        if (!encode(filename, &streams[i])) {
+            fprintf(stderr, "Encoding of stream %u failed\n", i);
+            return 1;
+        }
+        if (test(filename, truncated_filename) != 0) {
+            fprintf(stderr, "Test of stream %u failed\n", i);
+            return 1;
+        }
+    }
+    return 0;
+}
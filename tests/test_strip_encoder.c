@@ -0,0 +1,382 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Encodes an image with opj_write_strip(), checks that the codestream is */
+/* identical to the one produced by opj_encode() on the same image, decodes */
+/* it back and checks that the decoded samples are identical (lossless */
+/* encoding). */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+
+/* -------------------------------------------------------------------------- */
+
+static void error_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[ERROR] %s", msg);
+}
+
+static void warning_callback(const char *msg, void *client_data)
+{
+    (void)client_data;
+    fprintf(stdout, "[WARNING] %s", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+
+static OPJ_UINT32 get_sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                             OPJ_UINT32 prec)
+{
+    return ((x * (compno + 1) + y * 3 + ((x ^ y) & 7)) & ((1U << prec) - 1U));
+}
+
+static opj_codec_t* create_compress(const char* filename)
+{
+    opj_codec_t * l_codec;
+    if (strlen(filename) > 4 &&
+            strcmp(filename + strlen(filename) - 4, ".jp2") == 0) {
+        l_codec = opj_create_compress(OPJ_CODEC_JP2);
+    } else {
+        l_codec = opj_create_compress(OPJ_CODEC_J2K);
+    }
+    if (l_codec) {
+        opj_set_warning_handler(l_codec, warning_callback, 00);
+        opj_set_error_handler(l_codec, error_callback, 00);
+    }
+    return l_codec;
+}
+
+/* Encodes the whole image with opj_encode() */
+static OPJ_BOOL encode_reference(const char* filename,
+                                 opj_cparameters_t* p_param,
+                                 opj_image_cmptparm_t* p_params,
+                                 OPJ_UINT32 num_comps,
+                                 OPJ_UINT32 image_width,
+                                 OPJ_UINT32 image_height,
+                                 OPJ_UINT32 comp_prec,
+                                 OPJ_UINT32 offsety)
+{
+    opj_codec_t * l_codec;
+    opj_image_t * l_image;
+    opj_stream_t * l_stream;
+    OPJ_UINT32 compno, x, y;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    l_image = opj_image_create(num_comps, p_params,
+                               num_comps >= 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    l_image->x0 = 0;
+    l_image->y0 = offsety;
+    l_image->x1 = image_width;
+    l_image->y1 = offsety + image_height;
+    for (compno = 0; compno < num_comps; ++compno) {
+        for (y = 0; y < image_height; ++y) {
+            for (x = 0; x < image_width; ++x) {
+                l_image->comps[compno].data[y * image_width + x] =
+                    (OPJ_INT32)get_sample(compno, x, y, comp_prec);
+            }
+        }
+    }
+
+    l_codec = create_compress(filename);
+    l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    if (l_codec && l_stream &&
+            opj_setup_encoder(l_codec, p_param, l_image) &&
+            opj_start_compress(l_codec, l_image, l_stream) &&
+            opj_encode(l_codec, l_stream) &&
+            opj_end_compress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static OPJ_BOOL same_files(const char* filename1, const char* filename2)
+{
+    FILE* f1 = fopen(filename1, "rb");
+    FILE* f2 = fopen(filename2, "rb");
+    OPJ_BOOL ret = (f1 != NULL && f2 != NULL);
+    while (ret) {
+        int c1 = fgetc(f1);
+        int c2 = fgetc(f2);
+        if (c1 != c2) {
+            ret = OPJ_FALSE;
+        } else if (c1 == EOF) {
+            break;
+        }
+    }
+    if (f1) {
+        fclose(f1);
+    }
+    if (f2) {
+        fclose(f2);
+    }
+    return ret;
+}
+
+#define NUM_COMPS_MAX 4
+int main(int argc, char *argv[])
+{
+    opj_cparameters_t l_param;
+    opj_dparameters_t l_dparam;
+    opj_codec_t * l_codec;
+    opj_image_t * l_image;
+    opj_image_t * l_decoded_image = NULL;
+    opj_image_cmptparm_t l_params [NUM_COMPS_MAX];
+    opj_stream_t * l_stream;
+    OPJ_UINT32 num_comps = 3;
+    OPJ_UINT32 image_width = 1000;
+    OPJ_UINT32 image_height = 700;
+    OPJ_UINT32 tile_width = 256;
+    OPJ_UINT32 tile_height = 192;
+    OPJ_UINT32 comp_prec = 8;
+    OPJ_UINT32 strip_height = 37;
+    OPJ_UINT32 offsety = 0;
+    int irreversible = 0;
+    const char *output_file = "test_strip_encoder.j2k";
+    char reference_file[256];
+    OPJ_UINT32 l_sample_size;
+    OPJ_BYTE *l_data;
+    OPJ_UINT32 compno, x, y, y0;
+    int ret = 1;
+
+    /* test_strip_encoder [num_comps width height tile_w tile_h prec strip_h output [offsety [irreversible]]] */
+    if (argc >= 9) {
+        num_comps = (OPJ_UINT32)atoi(argv[1]);
+        image_width = (OPJ_UINT32)atoi(argv[2]);
+        image_height = (OPJ_UINT32)atoi(argv[3]);
+        tile_width = (OPJ_UINT32)atoi(argv[4]);
+        tile_height = (OPJ_UINT32)atoi(argv[5]);
+        comp_prec = (OPJ_UINT32)atoi(argv[6]);
+        strip_height = (OPJ_UINT32)atoi(argv[7]);
+        output_file = argv[8];
+        if (argc >= 10) {
+            offsety = (OPJ_UINT32)atoi(argv[9]);
+        }
+        if (argc >= 11) {
+            irreversible = atoi(argv[10]);
+        }
+    }
+    if (num_comps > NUM_COMPS_MAX || comp_prec == 0 || comp_prec > 16 ||
+            strip_height == 0 || strlen(output_file) + 5 > sizeof(reference_file)) {
+        return 1;
+    }
+    /* "foo.j2k" -> "foo.ref.j2k" */
+    strcpy(reference_file, output_file);
+    strcpy(reference_file + strlen(output_file) - 4, ".ref");
+    strcat(reference_file, output_file + strlen(output_file) - 4);
+    l_sample_size = (comp_prec + 7) / 8;
+
+    l_data = (OPJ_BYTE*) malloc((size_t)image_width * strip_height * num_comps *
+                                l_sample_size);
+    if (l_data == NULL) {
+        return 1;
+    }
+
+    opj_set_default_encoder_parameters(&l_param);
+    l_param.tcp_numlayers = 1;
+    l_param.cp_disto_alloc = 1;
+    l_param.tcp_rates[0] = irreversible ? 20 : 0;
+    l_param.irreversible = irreversible;
+    l_param.cp_tx0 = 0;
+    l_param.cp_ty0 = 0;
+    l_param.tile_size_on = OPJ_TRUE;
+    l_param.cp_tdx = (int)tile_width;
+    l_param.cp_tdy = (int)tile_height;
+    l_param.numresolution = 4;
+
+    for (compno = 0; compno < num_comps; ++compno) {
+        memset(&l_params[compno], 0, sizeof(l_params[compno]));
+        l_params[compno].dx = 1;
+        l_params[compno].dy = 1;
+        l_params[compno].w = image_width;
+        l_params[compno].h = image_height;
+        l_params[compno].x0 = 0;
+        l_params[compno].y0 = offsety;
+        l_params[compno].sgnd = 0;
+        l_params[compno].prec = comp_prec;
+    }
+
+    l_codec = create_compress(output_file);
+    if (!l_codec) {
+        free(l_data);
+        return 1;
+    }
+
+    l_image = opj_image_tile_create(num_comps, l_params,
+                                    num_comps >= 3 ? OPJ_CLRSPC_SRGB : OPJ_CLRSPC_GRAY);
+    if (! l_image) {
+        opj_destroy_codec(l_codec);
+        free(l_data);
+        return 1;
+    }
+    l_image->x0 = 0;
+    l_image->y0 = offsety;
+    l_image->x1 = image_width;
+    l_image->y1 = offsety + image_height;
+
+    if (! opj_setup_encoder(l_codec, &l_param, l_image)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to setup the codec!\n");
+        goto cleanup_encoder;
+    }
+
+    l_stream = opj_stream_create_default_file_stream(output_file, OPJ_FALSE);
+    if (! l_stream) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to create %s!\n",
+                output_file);
+        goto cleanup_encoder;
+    }
+
+    if (! opj_start_compress(l_codec, l_image, l_stream)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to start compress!\n");
+        opj_stream_destroy(l_stream);
+        goto cleanup_encoder;
+    }
+
+    for (y0 = 0; y0 < image_height; y0 += strip_height) {
+        OPJ_UINT32 l_nb_lines = image_height - y0 < strip_height ?
+                                image_height - y0 : strip_height;
+        OPJ_BYTE * l_ptr = l_data;
+        for (compno = 0; compno < num_comps; ++compno) {
+            for (y = y0; y < y0 + l_nb_lines; ++y) {
+                for (x = 0; x < image_width; ++x) {
+                    OPJ_UINT32 v = get_sample(compno, x, y, comp_prec);
+                    if (l_sample_size == 1) {
+                        *l_ptr++ = (OPJ_BYTE)v;
+                    } else {
+                        OPJ_UINT16 v16 = (OPJ_UINT16)v;
+                        memcpy(l_ptr, &v16, 2);
+                        l_ptr += 2;
+                    }
+                }
+            }
+        }
+        if (! opj_write_strip(l_codec, l_nb_lines, l_data,
+                              (OPJ_SIZE_T)(l_ptr - l_data), l_stream)) {
+            fprintf(stderr, "ERROR -> test_strip_encoder: failed to write strip %u!\n",
+                    y0);
+            opj_stream_destroy(l_stream);
+            goto cleanup_encoder;
+        }
+    }
+
+    if (! opj_end_compress(l_codec, l_stream)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to end compress!\n");
+        opj_stream_destroy(l_stream);
+        goto cleanup_encoder;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    free(l_data);
+
+    /* Compare with the codestream produced by opj_encode() */
+    if (! encode_reference(reference_file, &l_param, l_params, num_comps,
+                           image_width, image_height, comp_prec, offsety)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to encode %s!\n",
+                reference_file);
+        return 1;
+    }
+    if (! same_files(output_file, reference_file)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: %s and %s differ!\n",
+                output_file, reference_file);
+        return 1;
+    }
+    if (irreversible) {
+        return 0;
+    }
+
+    /* Decode and check */
+    l_stream = opj_stream_create_default_file_stream(output_file, OPJ_TRUE);
+    if (! l_stream) {
+        return 1;
+    }
+    if (strlen(output_file) > 4 &&
+            strcmp(output_file + strlen(output_file) - 4, ".jp2") == 0) {
+        l_codec = opj_create_decompress(OPJ_CODEC_JP2);
+    } else {
+        l_codec = opj_create_decompress(OPJ_CODEC_J2K);
+    }
+    opj_set_warning_handler(l_codec, warning_callback, 00);
+    opj_set_error_handler(l_codec, error_callback, 00);
+    opj_set_default_decoder_parameters(&l_dparam);
+    if (! opj_setup_decoder(l_codec, &l_dparam) ||
+            ! opj_read_header(l_stream, l_codec, &l_decoded_image) ||
+            ! opj_decode(l_codec, l_stream, l_decoded_image) ||
+            ! opj_end_decompress(l_codec, l_stream)) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: failed to decode %s!\n",
+                output_file);
+        goto cleanup_decoder;
+    }
+
+    if (l_decoded_image->numcomps != num_comps ||
+            l_decoded_image->y0 != offsety ||
+            l_decoded_image->x1 != image_width ||
+            l_decoded_image->y1 != offsety + image_height) {
+        fprintf(stderr, "ERROR -> test_strip_encoder: wrong decoded dimensions!\n");
+        goto cleanup_decoder;
+    }
+    for (compno = 0; compno < num_comps; ++compno) {
+        const OPJ_INT32* l_comp_data = l_decoded_image->comps[compno].data;
+        for (y = 0; y < image_height; ++y) {
+            for (x = 0; x < image_width; ++x) {
+                if ((OPJ_UINT32)l_comp_data[y * image_width + x] !=
+                        get_sample(compno, x, y, comp_prec)) {
+                    fprintf(stderr,
+                            "ERROR -> test_strip_encoder: mismatch at comp=%u x=%u y=%u!\n",
+                            compno, x, y);
+                    goto cleanup_decoder;
+                }
+            }
+        }
+    }
+    ret = 0;
+
+cleanup_decoder:
+    opj_image_destroy(l_decoded_image);
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+
+cleanup_encoder:
+    opj_destroy_codec(l_codec);
+    opj_image_destroy(l_image);
+    free(l_data);
+    return ret;
+}
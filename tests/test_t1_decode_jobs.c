@@ -0,0 +1,159 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that the batching of the Tier-1 decoding of code-blocks into jobs */
+/* sized to the amount of work gives, with several numbers of threads, the */
+/* same images as the decoding with a single thread, both for tiles with */
+/* few code-blocks, run in the calling thread, and for tiles with many, */
+/* possibly tiny, code-blocks, run by the thread pool. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+typedef struct {
+    OPJ_UINT32 numcomps;
+    OPJ_UINT32 width;
+    OPJ_UINT32 height;
+    OPJ_UINT32 tile_size; /* 0 for a single tile */
+    int cblk_size;
+    int irreversible;
+} stream_desc_t;
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    (void)seed;
+    return (OPJ_INT32)((x * (compno + 3) + y * 5 + ((x * y * 11 + compno) & 127)) &
+                       255);
+}
+
+static OPJ_BOOL encode(const char* filename, const stream_desc_t* desc)
+{
+    opj_cparameters_t l_param;
+    opj_image_t* l_image;
+    OPJ_BOOL ret;
+
+    opj_set_default_encoder_parameters(&l_param);
+    if (desc->irreversible) {
+        l_param.tcp_numlayers = 1;
+        l_param.tcp_rates[0] = 8;
+        l_param.cp_disto_alloc = 1;
+    }
+    l_param.irreversible = desc->irreversible;
+    l_param.numresolution = 4;
+    l_param.cblockw_init = desc->cblk_size;
+    l_param.cblockh_init = desc->cblk_size;
+    if (desc->tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)desc->tile_size;
+        l_param.cp_tdy = (int)desc->tile_size;
+    }
+
+    l_image = test_create_image(desc->numcomps, desc->width, desc->height, 8,
+                                OPJ_FALSE, sample, 0);
+    if (!l_image) {
+        return OPJ_FALSE;
+    }
+    ret = test_encode(filename, l_image, &l_param, NULL);
+    opj_image_destroy(l_image);
+    return ret;
+}
+
+static int test(const stream_desc_t* desc)
+{
+    static const int num_threads[] = { 2, 3, 4, 7 };
+    static const OPJ_INT32 l_area[4] = { 13, 7, 181, 97 };
+    const char* filename = "test_t1_decode_jobs.j2k";
+    OPJ_UINT32 i, window;
+
+    if (!encode(filename, desc)) {
+        fprintf(stderr, "Encoding failed\n");
+        return 1;
+    }
+    for (window = 0; window < 2; ++window) {
+        const OPJ_INT32* p_area = window ? l_area : NULL;
+        opj_image_t* l_image_ref = test_decode_once(filename, NULL, p_area, 1);
+        if (!l_image_ref) {
+            fprintf(stderr, "Decoding with 1 thread failed\n");
+            return 1;
+        }
+        for (i = 0; i < sizeof(num_threads) / sizeof(num_threads[0]); ++i) {
+            opj_image_t* l_image = test_decode_once(filename, NULL, p_area,
+                                                    num_threads[i]);
+            OPJ_BOOL l_same = l_image && test_same_images(l_image_ref, l_image);
+            opj_image_destroy(l_image);
+            if (!l_same) {
+                fprintf(stderr, "Decoding with %d threads differs (%ux%u, "
+                        "numcomps=%u, tile_size=%u, cblk_size=%d, "
+                        "irreversible=%d, window=%u)\n", num_threads[i],
+                        desc->width, desc->height, desc->numcomps,
+                        desc->tile_size, desc->cblk_size, desc->irreversible,
+                        window);
+                opj_image_destroy(l_image_ref);
+                return 1;
+            }
+        }
+        opj_image_destroy(l_image_ref);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const stream_desc_t streams[] = {
+        /* A few code-blocks per tile: decoded in the calling thread */
+        { 1, 200, 100, 0, 64, 0 },
+        { 3, 200, 100, 32, 16, 1 },
+        /* Many code-blocks: several jobs run by the thread pool */
+        { 3, 640, 480, 0, 64, 0 },
+        { 1, 640, 480, 0, 32, 1 },
+        /* Many tiny code-blocks batched into each job */
+        { 3, 320, 240, 0, 4, 0 },
+        { 2, 400, 300, 256, 8, 1 }
+    };
+    const OPJ_UINT32 nb_streams = sizeof(streams) / sizeof(streams[0]);
+    OPJ_UINT32 i;
+
+    if (!opj_has_thread_support()) {
+        printf("Thread support is not available: nothing to test\n");
+        return 0;
+    }
+    for (i = 0; i < nb_streams; ++i) {
+        if (test(&streams[i]) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
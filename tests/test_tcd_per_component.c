@@ -0,0 +1,177 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Checks that running the DC level shift and the wavelet transform of the */
+/* tile components either one job per component or one component at a */
+/* time split across the threads gives, with several numbers of threads, */
+/* the same codestream and the same decoded image as with a single thread. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "opj_config.h"
+#include "openjpeg.h"
+#include "test_common.h"
+
+static OPJ_INT32 sample(OPJ_UINT32 compno, OPJ_UINT32 x, OPJ_UINT32 y,
+                        OPJ_UINT32 seed)
+{
+    return (OPJ_INT32)((x * (compno + 2) + y * (seed + 7) +
+                        ((x * y * 13 + compno + seed) & 63)) & 255);
+}
+
+static OPJ_BOOL encode(const char* filename, opj_image_t* p_image,
+                       OPJ_UINT32 tile_size, int irreversible,
+                       int num_threads)
+{
+    opj_cparameters_t l_param;
+    opj_codec_t* l_codec;
+    opj_stream_t* l_stream = NULL;
+    OPJ_BOOL ret = OPJ_FALSE;
+
+    opj_set_default_encoder_parameters(&l_param);
+    if (irreversible) {
+        l_param.tcp_numlayers = 1;
+        l_param.tcp_rates[0] = 10;
+        l_param.cp_disto_alloc = 1;
+    }
+    l_param.irreversible = irreversible;
+    l_param.numresolution = 5;
+    if (tile_size) {
+        l_param.tile_size_on = OPJ_TRUE;
+        l_param.cp_tdx = (int)tile_size;
+        l_param.cp_tdy = (int)tile_size;
+    }
+
+    l_codec = opj_create_compress(test_codec_format(filename));
+    if (l_codec) {
+        opj_set_error_handler(l_codec, test_error_callback, 00);
+        l_stream = opj_stream_create_default_file_stream(filename, OPJ_FALSE);
+    }
+    if (l_stream &&
+            opj_setup_encoder(l_codec, &l_param, p_image) &&
+            opj_codec_set_threads(l_codec, num_threads) &&
+            opj_start_compress(l_codec, p_image, l_stream) &&
+            opj_encode(l_codec, l_stream) &&
+            opj_end_compress(l_codec, l_stream)) {
+        ret = OPJ_TRUE;
+    }
+    opj_stream_destroy(l_stream);
+    opj_destroy_codec(l_codec);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int num_threads[] = { 2, 3, 4, 8 };
+    OPJ_UINT32 numcomps, width, height, tile_size, seed;
+    int irreversible;
+    const char* output_file;
+    unsigned char* l_ref_data = NULL;
+    size_t l_ref_size = 0;
+    opj_image_t* l_image_ref = NULL;
+    OPJ_UINT32 i;
+    int ret = 0;
+
+    /* should be test_tcd_per_component 8 160 120 0 0 2 tpc2.j2k */
+    /* (numcomps width height tile_size irreversible seed output_file) */
+    if (argc >= 8) {
+        numcomps = (OPJ_UINT32)atoi(argv[1]);
+        width = (OPJ_UINT32)atoi(argv[2]);
+        height = (OPJ_UINT32)atoi(argv[3]);
+        tile_size = (OPJ_UINT32)atoi(argv[4]);
+        irreversible = atoi(argv[5]);
+        seed = (OPJ_UINT32)atoi(argv[6]);
+        output_file = argv[7];
+    } else {
+        numcomps = 3;
+        width = 257;
+        height = 131;
+        tile_size = 0;
+        irreversible = 1;
+        seed = 0;
+        output_file = "test_tcd_per_component.j2k";
+    }
+
+    if (!opj_has_thread_support()) {
+        printf("Thread support is not available: nothing to test\n");
+        return 0;
+    }
+
+    for (i = 0; ret == 0 && i <= sizeof(num_threads) / sizeof(num_threads[0]);
+            ++i) {
+        /* The first iteration encodes and decodes the reference, with a */
+        /* single thread */
+        const int l_num_threads = i ? num_threads[i - 1] : 1;
+        opj_image_t* l_image = test_create_image(numcomps, width, height, 8,
+                               OPJ_FALSE, sample, seed);
+        unsigned char* l_data = NULL;
+        size_t l_size = 0;
+
+        if (!l_image ||
+                !encode(output_file, l_image, tile_size, irreversible,
+                        l_num_threads) ||
+                (l_data = test_read_file(output_file, &l_size)) == NULL) {
+            fprintf(stderr, "Encoding with %d threads failed\n", l_num_threads);
+            ret = 1;
+        } else if (i == 0) {
+            l_ref_data = l_data;
+            l_ref_size = l_size;
+            l_data = NULL;
+        } else if (l_size != l_ref_size ||
+                   memcmp(l_data, l_ref_data, l_size) != 0) {
+            fprintf(stderr, "Encoding with %d threads differs\n", l_num_threads);
+            ret = 1;
+        }
+        opj_image_destroy(l_image);
+        free(l_data);
+        if (ret != 0) {
+            break;
+        }
+
+        l_image = test_decode_once(output_file, NULL, NULL, l_num_threads);
+        if (!l_image) {
+            fprintf(stderr, "Decoding with %d threads failed\n", l_num_threads);
+            ret = 1;
+        } else if (i == 0) {
+            l_image_ref = l_image;
+            l_image = NULL;
+        } else if (!test_same_images(l_image_ref, l_image)) {
+            fprintf(stderr, "Decoding with %d threads differs\n", l_num_threads);
+            ret = 1;
+        }
+        opj_image_destroy(l_image);
+    }
+
+    free(l_ref_data);
+    opj_image_destroy(l_image_ref);
+    return ret;
+}
@@ -0,0 +1,266 @@
+/*
+ * The copyright in this software is being made available under the 2-clauses
+ * BSD License, included below. This software may be subject to other third
+ * party and contributor rights, including patent rights, and no such rights
+ * are granted under this license.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS `AS IS'
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Writes random sequences of bit fields with the BIO encoder, as packet */
+/* headers are, and checks that the BIO decoder reads them back, through */
+/* all its read functions, with fields of up to 32 bits and 0xFF bytes */
+/* followed by stuffed bits, and that opj_bio_inalign() leaves it at the */
+/* end of each header, including when it ends with a 0xFF byte. */
+
+#include "opj_includes.h"
+
+#define NB_HEADERS 4000
+#define MAX_FIELDS 24
+#define HEADER_MAX_SIZE (MAX_FIELDS * 5 + 2)
+
+typedef struct {
+    OPJ_UINT32 nb_fields;
+    OPJ_UINT32 values[MAX_FIELDS];
+    OPJ_UINT32 nbits[MAX_FIELDS];
+    /* Offset of the end of the header in the stream */
+    OPJ_UINT32 end;
+} header_t;
+
+static OPJ_UINT32 rand_state = 1;
+
+static OPJ_UINT32 next_rand(void)
+{
+    rand_state = rand_state * 1103515245U + 12345U;
+    return rand_state >> 8;
+}
+
+/* Random fields, often made of one bits, so that many 0xFF bytes are */
+/* written, and many of 32 bits */
+static void generate_header(header_t* header)
+{
+    OPJ_UINT32 i;
+    header->nb_fields = 1 + next_rand() % MAX_FIELDS;
+    for (i = 0; i < header->nb_fields; ++i) {
+        OPJ_UINT32 n;
+        OPJ_UINT32 v;
+        switch (next_rand() % 4) {
+        case 0:
+            n = 32;
+            break;
+        case 1:
+            n = 1;
+            break;
+        default:
+            n = 1 + next_rand() % 32;
+            break;
+        }
+        switch (next_rand() % 3) {
+        case 0:
+            v = 0xFFFFFFFFU;
+            break;
+        case 1:
+            v = (next_rand() << 16) ^ next_rand();
+            break;
+        default:
+            v = next_rand() % 4 == 0 ? 0U : (next_rand() | 0xFF00FF00U);
+            break;
+        }
+        header->nbits[i] = n;
+        header->values[i] = n == 32 ? v : (v & ((1U << n) - 1U));
+    }
+}
+
+/* Writes the headers one after the other, each with its own encoder and */
+/* flushed, as opj_t2_encode_packet() does */
+static OPJ_UINT32 encode_headers(header_t* headers, OPJ_BYTE* buffer,
+                                 OPJ_UINT32 size)
+{
+    opj_bio_t* bio = opj_bio_create();
+    OPJ_UINT32 pos = 0;
+    OPJ_UINT32 h, i;
+
+    if (!bio) {
+        return 0;
+    }
+    for (h = 0; h < NB_HEADERS; ++h) {
+        header_t* header = &headers[h];
+        opj_bio_init_enc(bio, buffer + pos, size - pos);
+        for (i = 0; i < header->nb_fields; ++i) {
+            opj_bio_write(bio, header->values[i], header->nbits[i]);
+        }
+        if (!opj_bio_flush(bio)) {
+            opj_bio_destroy(bio);
+            return 0;
+        }
+        pos += (OPJ_UINT32)opj_bio_numbytes(bio);
+        header->end = pos;
+    }
+    opj_bio_destroy(bio);
+    return pos;
+}
+
+/* Reads a field with one of the read functions of the decoder */
+static OPJ_UINT32 read_field(opj_bio_t* bio, OPJ_UINT32 n, OPJ_UINT32 method)
+{
+    OPJ_UINT32 v, i;
+    switch (method) {
+    case 0:
+        return opj_bio_read(bio, n);
+    case 1:
+        v = opj_bio_peek(bio, n);
+        opj_bio_skip(bio, n);
+        return v;
+    default:
+        v = 0;
+        for (i = 0; i < n; ++i) {
+            v = (v << 1) | opj_bio_read_bit(bio);
+        }
+        return v;
+    }
+}
+
+/* Reads all the headers with a single decoder, realigned after each */
+/* header */
+static int decode_headers(const header_t* headers, OPJ_BYTE* buffer,
+                          OPJ_UINT32 size)
+{
+    opj_bio_t* bio = opj_bio_create();
+    OPJ_UINT32 h, i;
+    int ret = 1;
+
+    if (!bio) {
+        return 1;
+    }
+    opj_bio_init_dec(bio, buffer, size);
+    for (h = 0; h < NB_HEADERS; ++h) {
+        const header_t* header = &headers[h];
+        for (i = 0; i < header->nb_fields; ++i) {
+            OPJ_UINT32 v = read_field(bio, header->nbits[i], (h + i) % 3);
+            if (v != header->values[i]) {
+                fprintf(stderr, "Header %u, field %u of %u bits: read 0x%x "
+                        "instead of 0x%x\n", h, i, header->nbits[i], v,
+                        header->values[i]);
+                goto end;
+            }
+        }
+        if (opj_bio_past_end(bio)) {
+            fprintf(stderr, "Header %u: read past the end\n", h);
+            goto end;
+        }
+        if (!opj_bio_inalign(bio) ||
+                opj_bio_numbytes(bio) != (ptrdiff_t)header->end) {
+            fprintf(stderr, "Header %u: realigned at byte %ld instead of %u "
+                    "(last byte 0x%x)\n", h, (long)opj_bio_numbytes(bio),
+                    header->end, buffer[header->end - 1]);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    opj_bio_destroy(bio);
+    return ret;
+}
+
+/* Checks the reading of bytes given by hand */
+static int test_fixed(void)
+{
+    /* 0xFF is followed by a stuffed bit, 0x7F only has 7 bits left, then */
+    /* the header ends with 0xFF and the byte of its stuffed bit */
+    OPJ_BYTE buffer[] = { 0xFF, 0x7F, 0x80, 0x12, 0xFF, 0x00, 0xA5 };
+    opj_bio_t* bio = opj_bio_create();
+    int ret = 1;
+
+    if (!bio) {
+        return 1;
+    }
+    opj_bio_init_dec(bio, buffer, sizeof(buffer));
+    if (opj_bio_read(bio, 8) != 0xFF || opj_bio_read(bio, 7) != 0x7F ||
+            opj_bio_read(bio, 16) != 0x8012 || opj_bio_read(bio, 4) != 0xF ||
+            !opj_bio_inalign(bio) || opj_bio_numbytes(bio) != 6 ||
+            opj_bio_read(bio, 8) != 0xA5 || opj_bio_past_end(bio)) {
+        fprintf(stderr, "Wrong reading of the fixed bytes\n");
+        goto end;
+    }
+    /* Zero bits are read past the end */
+    if (opj_bio_read(bio, 32) != 0 || !opj_bio_past_end(bio)) {
+        fprintf(stderr, "Wrong reading past the end\n");
+        goto end;
+    }
+
+    /* A header ending with 0xFF without the byte of its stuffed bit */
+    opj_bio_init_dec(bio, buffer, 5);
+    if (opj_bio_read(bio, 8) != 0xFF || opj_bio_read(bio, 7) != 0x7F ||
+            opj_bio_read(bio, 16) != 0x8012 || opj_bio_read(bio, 8) != 0xFF ||
+            opj_bio_inalign(bio)) {
+        fprintf(stderr, "Truncated header not detected\n");
+        goto end;
+    }
+    ret = 0;
+
+end:
+    opj_bio_destroy(bio);
+    return ret;
+}
+
+int main(void)
+{
+    header_t* headers;
+    OPJ_BYTE* buffer;
+    OPJ_UINT32 size;
+    OPJ_UINT32 nb_ff = 0, i;
+    int ret = 1;
+
+    if (test_fixed() != 0) {
+        return 1;
+    }
+
+    headers = (header_t*)opj_calloc(NB_HEADERS, sizeof(header_t));
+    buffer = (OPJ_BYTE*)opj_malloc(NB_HEADERS * HEADER_MAX_SIZE);
+    if (!headers || !buffer) {
+        goto end;
+    }
+    for (i = 0; i < NB_HEADERS; ++i) {
+        generate_header(&headers[i]);
+    }
+    size = encode_headers(headers, buffer, NB_HEADERS * HEADER_MAX_SIZE);
+    if (size == 0) {
+        fprintf(stderr, "Encoding failed\n");
+        goto end;
+    }
+    for (i = 0; i < size; ++i) {
+        nb_ff += buffer[i] == 0xFF;
+    }
+    if (nb_ff < NB_HEADERS) {
+        fprintf(stderr, "Only %u 0xFF bytes written\n", nb_ff);
+        goto end;
+    }
+    ret = decode_headers(headers, buffer, size);
+
+end:
+    opj_free(headers);
+    opj_free(buffer);
+    return ret;
+}